@@ -228,6 +228,276 @@ module cmi_fortran_library
 
   end interface c_subroutines
 
+  !-
+  !> @brief Routines declared in the CMI library that need to be exposed to
+  !> Fortran and that cannot be part of the generic interface above, since
+  !> their signatures are not distinguishable from the ones in there.
+  !-
+  interface
+
+    !-
+    !> @brief Fortran interface for
+    !> CMILibrary::cmi_compute_neutral_fraction_async_dp().
+    !>
+    !> The computation runs in the background. nH is only filled once
+    !> cmi_wait() returns or cmi_test() returns 1, and should stay valid (and
+    !> be contiguous) until then.
+    !>
+    !> @param x X coordinates (in internal length units).
+    !> @param y Y coordinates (in internal length units).
+    !> @param z Z coordinates (in internal length units).
+    !> @param h Smoothing lengths (in internal length units).
+    !> @param m Masses (in internal mass units).
+    !> @param nH Neutral fraction array to compute.
+    !> @param N Size of all arrays.
+    !-
+    subroutine cmi_compute_neutral_fraction_async_dp(x, y, z, h, m, nH, &
+                                                     N) &
+      bind(C, name = "cmi_compute_neutral_fraction_async_dp")
+
+      use iso_c_binding
+      implicit none
+
+      real (kind = c_double), intent(in) :: x(N)
+      real (kind = c_double), intent(in) :: y(N)
+      real (kind = c_double), intent(in) :: z(N)
+      real (kind = c_double), intent(in) :: h(N)
+      real (kind = c_double), intent(in) :: m(N)
+      real (kind = c_double), intent(inout), asynchronous :: nH(N)
+      integer (kind = c_size_t), intent(in), value :: N
+
+    end subroutine cmi_compute_neutral_fraction_async_dp
+
+    !-
+    !> @brief Fortran interface for
+    !> CMILibrary::cmi_compute_neutral_fraction_async_mp().
+    !>
+    !> The computation runs in the background. nH is only filled once
+    !> cmi_wait() returns or cmi_test() returns 1, and should stay valid (and
+    !> be contiguous) until then.
+    !>
+    !> @param x X coordinates (in internal length units).
+    !> @param y Y coordinates (in internal length units).
+    !> @param z Z coordinates (in internal length units).
+    !> @param h Smoothing lengths (in internal length units).
+    !> @param m Masses (in internal mass units).
+    !> @param nH Neutral fraction array to compute.
+    !> @param N Size of all arrays.
+    !-
+    subroutine cmi_compute_neutral_fraction_async_mp(x, y, z, h, m, nH, &
+                                                     N) &
+      bind(C, name = "cmi_compute_neutral_fraction_async_mp")
+
+      use iso_c_binding
+      implicit none
+
+      real (kind = c_double), intent(in) :: x(N)
+      real (kind = c_double), intent(in) :: y(N)
+      real (kind = c_double), intent(in) :: z(N)
+      real (kind = c_float), intent(in) :: h(N)
+      real (kind = c_float), intent(in) :: m(N)
+      real (kind = c_float), intent(inout), asynchronous :: nH(N)
+      integer (kind = c_size_t), intent(in), value :: N
+
+    end subroutine cmi_compute_neutral_fraction_async_mp
+
+    !-
+    !> @brief Fortran interface for
+    !> CMILibrary::cmi_compute_neutral_fraction_async_sp().
+    !>
+    !> The computation runs in the background. nH is only filled once
+    !> cmi_wait() returns or cmi_test() returns 1, and should stay valid (and
+    !> be contiguous) until then.
+    !>
+    !> @param x X coordinates (in internal length units).
+    !> @param y Y coordinates (in internal length units).
+    !> @param z Z coordinates (in internal length units).
+    !> @param h Smoothing lengths (in internal length units).
+    !> @param m Masses (in internal mass units).
+    !> @param nH Neutral fraction array to compute.
+    !> @param N Size of all arrays.
+    !-
+    subroutine cmi_compute_neutral_fraction_async_sp(x, y, z, h, m, nH, &
+                                                     N) &
+      bind(C, name = "cmi_compute_neutral_fraction_async_sp")
+
+      use iso_c_binding
+      implicit none
+
+      real (kind = c_float), intent(in) :: x(N)
+      real (kind = c_float), intent(in) :: y(N)
+      real (kind = c_float), intent(in) :: z(N)
+      real (kind = c_float), intent(in) :: h(N)
+      real (kind = c_float), intent(in) :: m(N)
+      real (kind = c_float), intent(inout), asynchronous :: nH(N)
+      integer (kind = c_size_t), intent(in), value :: N
+
+    end subroutine cmi_compute_neutral_fraction_async_sp
+
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_set_number_of_particles().
+    !>
+    !> @param N Number of particles.
+    !-
+    subroutine cmi_set_number_of_particles(N) &
+      bind(C, name = "cmi_set_number_of_particles")
+
+      use iso_c_binding
+      implicit none
+
+      integer (kind = c_size_t), intent(in), value :: N
+
+    end subroutine cmi_set_number_of_particles
+
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_push_particles_dp().
+    !>
+    !> Does not wait for a running computation; the values are used by the
+    !> next cmi_start_computation_dp() or cmi_start_computation_sp() call.
+    !>
+    !> @param offset Index (starting from 0) of the first particle to update.
+    !> @param x X coordinates (in internal length units).
+    !> @param y Y coordinates (in internal length units).
+    !> @param z Z coordinates (in internal length units).
+    !> @param h Smoothing lengths (in internal length units).
+    !> @param m Masses (in internal mass units).
+    !> @param N Size of all arrays.
+    !-
+    subroutine cmi_push_particles_dp(offset, x, y, z, h, m, N) &
+      bind(C, name = "cmi_push_particles_dp")
+
+      use iso_c_binding
+      implicit none
+
+      integer (kind = c_size_t), intent(in), value :: offset
+      real (kind = c_double), intent(in) :: x(N)
+      real (kind = c_double), intent(in) :: y(N)
+      real (kind = c_double), intent(in) :: z(N)
+      real (kind = c_double), intent(in) :: h(N)
+      real (kind = c_double), intent(in) :: m(N)
+      integer (kind = c_size_t), intent(in), value :: N
+
+    end subroutine cmi_push_particles_dp
+
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_push_particles_mp().
+    !>
+    !> Does not wait for a running computation; the values are used by the
+    !> next cmi_start_computation_dp() or cmi_start_computation_sp() call.
+    !>
+    !> @param offset Index (starting from 0) of the first particle to update.
+    !> @param x X coordinates (in internal length units).
+    !> @param y Y coordinates (in internal length units).
+    !> @param z Z coordinates (in internal length units).
+    !> @param h Smoothing lengths (in internal length units).
+    !> @param m Masses (in internal mass units).
+    !> @param N Size of all arrays.
+    !-
+    subroutine cmi_push_particles_mp(offset, x, y, z, h, m, N) &
+      bind(C, name = "cmi_push_particles_mp")
+
+      use iso_c_binding
+      implicit none
+
+      integer (kind = c_size_t), intent(in), value :: offset
+      real (kind = c_double), intent(in) :: x(N)
+      real (kind = c_double), intent(in) :: y(N)
+      real (kind = c_double), intent(in) :: z(N)
+      real (kind = c_float), intent(in) :: h(N)
+      real (kind = c_float), intent(in) :: m(N)
+      integer (kind = c_size_t), intent(in), value :: N
+
+    end subroutine cmi_push_particles_mp
+
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_push_particles_sp().
+    !>
+    !> Does not wait for a running computation; the values are used by the
+    !> next cmi_start_computation_dp() or cmi_start_computation_sp() call.
+    !>
+    !> @param offset Index (starting from 0) of the first particle to update.
+    !> @param x X coordinates (in internal length units).
+    !> @param y Y coordinates (in internal length units).
+    !> @param z Z coordinates (in internal length units).
+    !> @param h Smoothing lengths (in internal length units).
+    !> @param m Masses (in internal mass units).
+    !> @param N Size of all arrays.
+    !-
+    subroutine cmi_push_particles_sp(offset, x, y, z, h, m, N) &
+      bind(C, name = "cmi_push_particles_sp")
+
+      use iso_c_binding
+      implicit none
+
+      integer (kind = c_size_t), intent(in), value :: offset
+      real (kind = c_float), intent(in) :: x(N)
+      real (kind = c_float), intent(in) :: y(N)
+      real (kind = c_float), intent(in) :: z(N)
+      real (kind = c_float), intent(in) :: h(N)
+      real (kind = c_float), intent(in) :: m(N)
+      integer (kind = c_size_t), intent(in), value :: N
+
+    end subroutine cmi_push_particles_sp
+
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_start_computation_dp().
+    !>
+    !> The computation runs in the background. nH is only filled once
+    !> cmi_wait() returns or cmi_test() returns 1, and should stay valid (and
+    !> be contiguous) until then.
+    !>
+    !> @param nH Neutral fraction array to compute.
+    !-
+    subroutine cmi_start_computation_dp(nH) &
+      bind(C, name = "cmi_start_computation_dp")
+
+      use iso_c_binding
+      implicit none
+
+      real (kind = c_double), intent(inout), asynchronous :: nH(*)
+
+    end subroutine cmi_start_computation_dp
+
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_start_computation_sp().
+    !>
+    !> The computation runs in the background. nH is only filled once
+    !> cmi_wait() returns or cmi_test() returns 1, and should stay valid (and
+    !> be contiguous) until then.
+    !>
+    !> @param nH Neutral fraction array to compute.
+    !-
+    subroutine cmi_start_computation_sp(nH) &
+      bind(C, name = "cmi_start_computation_sp")
+
+      use iso_c_binding
+      implicit none
+
+      real (kind = c_float), intent(inout), asynchronous :: nH(*)
+
+    end subroutine cmi_start_computation_sp
+
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_test().
+    !>
+    !> @return 1 if the last asynchronous computation has finished, 0
+    !> otherwise.
+    !-
+    integer (kind = c_int) function cmi_test() bind(C, name = "cmi_test")
+
+      use iso_c_binding
+      implicit none
+
+    end function cmi_test
+
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_wait().
+    !-
+    subroutine cmi_wait() bind(C, name = "cmi_wait")
+    end subroutine cmi_wait
+
+  end interface
+
   contains
 
     !-
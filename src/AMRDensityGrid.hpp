@@ -40,6 +40,10 @@
 
 /**
  * @brief AMR density grid.
+ *
+ * The grid structure is stored in a hierarchical AMRGrid, which is used to
+ * refine cells. Photon traversal uses a flattened copy of that structure, which
+ * is rebuilt every time the grid is refined.
  */
 class AMRDensityGrid : public DensityGrid {
 private:
@@ -49,6 +53,10 @@ private:
   /*! @brief Convenient cell list used for faster cell indexing. */
   std::vector< AMRGridCell< cellsize_t > * > _cells;
 
+  /*! @brief Cell index of each lowest level cell in the flattened AMRGrid
+   *  storage, used during photon traversal. */
+  std::vector< cellsize_t > _flat_cell_indices;
+
   /*! @brief AMRRefinementScheme used to refine cells. */
   AMRRefinementScheme *_refinement_scheme;
 
@@ -88,6 +96,19 @@ private:
     return number / get_largest_odd_factor(number);
   }
 
+  /**
+   * @brief Set the neighbour relations in the AMRGrid and rebuild the
+   * flattened storage used for photon traversal.
+   */
+  inline void finalize_grid_structure() {
+    _grid.set_ngbs(_periodicity_flags);
+    _grid.flatten();
+    _flat_cell_indices.resize(_grid.get_number_of_flat_cells());
+    for (amrflatindex_t i = 0; i < _flat_cell_indices.size(); ++i) {
+      _flat_cell_indices[i] = _grid.get_flat_cell(i).value();
+    }
+  }
+
   /**
    * @brief Check if the cell with the given index should be refined, using the
    * given AMRRefinementScheme. Apply the refinement if necessary, using the
@@ -352,8 +373,8 @@ public:
       time_log->end("Mesh refinement");
     }
 
-    // finalize grid: set neighbour relations
-    _grid.set_ngbs(_periodicity_flags);
+    // finalize grid: set neighbour relations and flatten the grid structure
+    finalize_grid_structure();
 
     // make sure all values are correctly initialized (also in refined cells)
     // the refinement procedure itself only reads the density from the density
@@ -396,8 +417,8 @@ public:
             "Number of cells after reset: ", _grid.get_number_of_cells(), ".");
       }
 
-      // reset the ngbs
-      _grid.set_ngbs(_periodicity_flags);
+      // reset the ngbs and the flattened grid structure
+      finalize_grid_structure();
     }
 
     // make sure all cells are correctly reset (also the new ones, if any)
@@ -454,9 +475,9 @@ public:
    *
    * @param photon_origin Current position of the photon (in m).
    * @param photon_direction Direction the photon is travelling in.
-   * @param box Geometry of the cell in which the photon currently resides.
-   * @param cell Pointer to the current cell, is updated to the
-   * neighbouring cell that is next in the algorithm.
+   * @param cell Flat index of the current cell, is updated to the flat index
+   * of the neighbouring cell that is next in the algorithm
+   * (AMRGRID_FLAT_NONE if the photon leaves the box).
    * @param ds Distance covered from the photon position to the intersection
    * point (in m).
    * @param periodic_correction CoordinateVector used to store periodic
@@ -467,11 +488,12 @@ public:
    */
   inline CoordinateVector<>
   get_wall_intersection(CoordinateVector<> &photon_origin,
-                        CoordinateVector<> &photon_direction, Box<> &box,
-                        AMRGridCell< cellsize_t > *&cell, double &ds,
+                        CoordinateVector<> &photon_direction,
+                        amrflatindex_t &cell, double &ds,
                         CoordinateVector<> &periodic_correction) {
-    CoordinateVector<> cell_bottom_anchor = box.get_anchor();
-    CoordinateVector<> cell_top_anchor = box.get_top_anchor();
+    const CoordinateVector<> cell_bottom_anchor = _grid.get_flat_anchor(cell);
+    const CoordinateVector<> cell_top_anchor =
+        cell_bottom_anchor + _grid.get_flat_sides(cell);
 
     CoordinateVector< int_fast8_t > next_direction;
 
@@ -582,11 +604,13 @@ public:
     // ds contains the squared norm, take the square root
     ds = sqrt(ds);
 
-    AMRGridCell< cellsize_t > *next_cell = cell->get_ngb(ngbposition);
-    if (next_cell != nullptr) {
+    // find the (lowest level) neighbouring cell containing the new position
+    const amrflatindex_t next_cell =
+        _grid.get_flat_ngb(cell, ngbposition, next_wall);
+    if (next_cell != AMRGRID_FLAT_NONE) {
       // calculate periodic boundary corrections (if any)
       if (_periodicity_flags.x()) {
-        CoordinateVector<> nm = next_cell->get_geometry().get_anchor();
+        const CoordinateVector<> &nm = _grid.get_flat_anchor(next_cell);
         if (next_direction[0] > 0. && nm.x() < cell_bottom_anchor.x()) {
           periodic_correction[0] = -_box.get_sides().x();
         } else if (next_direction[0] < 0. && nm.x() > cell_bottom_anchor.x()) {
@@ -594,7 +618,7 @@ public:
         }
       }
       if (_periodicity_flags.y()) {
-        CoordinateVector<> nm = next_cell->get_geometry().get_anchor();
+        const CoordinateVector<> &nm = _grid.get_flat_anchor(next_cell);
         if (next_direction[1] > 0. && nm.y() < cell_bottom_anchor.y()) {
           periodic_correction[1] = -_box.get_sides().y();
         } else if (next_direction[1] < 0. && nm.y() > cell_bottom_anchor.y()) {
@@ -602,17 +626,13 @@ public:
         }
       }
       if (_periodicity_flags.z()) {
-        CoordinateVector<> nm = next_cell->get_geometry().get_anchor();
+        const CoordinateVector<> &nm = _grid.get_flat_anchor(next_cell);
         if (next_direction[2] > 0. && nm.z() < cell_bottom_anchor.z()) {
           periodic_correction[2] = -_box.get_sides().z();
         } else if (next_direction[2] < 0. && nm.z() > cell_bottom_anchor.z()) {
           periodic_correction[2] = _box.get_sides().z();
         }
       }
-      // find the child cell containing the new position
-      while (!next_cell->is_single_cell()) {
-        next_cell = next_cell->get_child(next_wall);
-      }
     }
     cell = next_cell;
 
@@ -646,25 +666,23 @@ public:
     CoordinateVector<> photon_origin = photon.get_position();
     CoordinateVector<> photon_direction = photon.get_direction();
 
-    cellsize_t index = get_cell_index(photon_origin);
-    AMRGridCell< cellsize_t > *current_cell = _cells[index];
+    amrflatindex_t current_cell = _grid.get_flat_index(photon_origin);
 
     // while the photon has not exceeded the optical depth and is still in the
     // box
     DensityGrid::iterator last_cell = end();
-    while (current_cell != nullptr && optical_depth > 0.) {
-      Box<> cell = current_cell->get_geometry();
+    while (current_cell != AMRGRID_FLAT_NONE && optical_depth > 0.) {
 
       double ds = 0.;
-      AMRGridCell< cellsize_t > *old_cell = current_cell;
+      const amrflatindex_t old_cell = current_cell;
       CoordinateVector<> periodic_correction;
       CoordinateVector<> next_wall =
-          get_wall_intersection(photon_origin, photon_direction, cell,
-                                current_cell, ds, periodic_correction);
+          get_wall_intersection(photon_origin, photon_direction, current_cell,
+                                ds, periodic_correction);
 
       // get the optical depth of the path from the current photon location to
       // the cell wall, update S
-      DensityGrid::iterator it(old_cell->value(), *this);
+      DensityGrid::iterator it(_flat_cell_indices[old_cell], *this);
       last_cell = it;
 
       // Helium abundance. Should be a parameter.
@@ -693,7 +711,7 @@ public:
 
     photon.set_position(photon_origin);
 
-    if (current_cell == nullptr) {
+    if (current_cell == AMRGRID_FLAT_NONE) {
       last_cell = end();
     }
 
@@ -714,19 +732,17 @@ public:
                                     EmissionLine line) {
     double S = 0.;
 
-    cellsize_t index = get_cell_index(origin);
-    AMRGridCell< cellsize_t > *current_cell = _cells[index];
+    amrflatindex_t current_cell = _grid.get_flat_index(origin);
 
-    while (current_cell != nullptr) {
-      Box<> cell = current_cell->get_geometry();
+    while (current_cell != AMRGRID_FLAT_NONE) {
 
       double ds = 0.;
-      AMRGridCell< cellsize_t > *old_cell = current_cell;
+      const amrflatindex_t old_cell = current_cell;
       CoordinateVector<> periodic_correction;
       CoordinateVector<> next_wall = get_wall_intersection(
-          origin, direction, cell, current_cell, ds, periodic_correction);
+          origin, direction, current_cell, ds, periodic_correction);
 
-      DensityGrid::iterator it(old_cell->value(), *this);
+      DensityGrid::iterator it(_flat_cell_indices[old_cell], *this);
 
       origin = next_wall;
 
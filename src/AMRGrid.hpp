@@ -31,13 +31,25 @@
 #include "CoordinateVector.hpp"
 
 #include <ostream>
+#include <unordered_map>
+#include <vector>
 
 /*! @brief The maximal value a key can take. */
 #define AMRGRID_MAXKEY 0xffffffffffffffff
 
+/*! @brief Flag that marks a flat index that points to a node (a cell with
+ *  children) rather than to a lowest level cell. */
+#define AMRGRID_FLAT_NODE 0x80000000
+
+/*! @brief Flat index value used for cells that do not exist. */
+#define AMRGRID_FLAT_NONE 0xffffffff
+
 /*! @brief Size of a key variable. Has to be exactly 64 bits. */
 typedef uint64_t amrkey_t;
 
+/*! @brief Index into the flattened storage of the grid. */
+typedef uint32_t amrflatindex_t;
+
 /**
  * @brief Hierarchical AMR grid.
  */
@@ -52,6 +64,101 @@ private:
   /*! @brief Top level blocks of the grid. */
   AMRGridCell< _CellContents_ > ****_top_level;
 
+  /*! @brief Lowest level cells, in Morton order (only set by flatten()). */
+  std::vector< AMRGridCell< _CellContents_ > * > _flat_cells;
+
+  /*! @brief Anchors of the lowest level cells, in Morton order. */
+  std::vector< CoordinateVector<> > _flat_anchors;
+
+  /*! @brief Side lengths of the lowest level cells, in Morton order. */
+  std::vector< CoordinateVector<> > _flat_sides;
+
+  /*! @brief Flat indices of the neighbours of the lowest level cells, 6 per
+   *  cell, in AMRNgbPosition order. */
+  std::vector< amrflatindex_t > _flat_ngbs;
+
+  /*! @brief Midpoints of the nodes (cells with children). */
+  std::vector< CoordinateVector<> > _flat_node_midpoints;
+
+  /*! @brief Flat indices of the children of the nodes, 8 per node, in
+   *  AMRChildPosition order. */
+  std::vector< amrflatindex_t > _flat_node_children;
+
+  /*! @brief Flat indices of the top level blocks. */
+  std::vector< amrflatindex_t > _flat_top_level;
+
+  /**
+   * @brief Recursively add the given cell and its children to the flattened
+   * storage.
+   *
+   * Lowest level cells are added in depth first order, which for our child
+   * numbering corresponds to Morton order.
+   *
+   * @param cell Cell to add (can be a nullptr).
+   * @param flat_indices Map that links cell pointers to their flat index.
+   * @return Flat index of the cell.
+   */
+  inline amrflatindex_t flatten_cell(
+      AMRGridCell< _CellContents_ > *cell,
+      std::unordered_map< const AMRGridCell< _CellContents_ > *,
+                          amrflatindex_t > &flat_indices) {
+
+    if (cell == nullptr) {
+      return AMRGRID_FLAT_NONE;
+    }
+
+    amrflatindex_t flat_index;
+    if (cell->is_single_cell()) {
+      flat_index = _flat_cells.size();
+      _flat_cells.push_back(cell);
+      const Box<> geometry = cell->get_geometry();
+      _flat_anchors.push_back(geometry.get_anchor());
+      _flat_sides.push_back(geometry.get_sides());
+    } else {
+      const amrflatindex_t node = _flat_node_midpoints.size();
+      flat_index = node | AMRGRID_FLAT_NODE;
+      _flat_node_midpoints.push_back(cell->get_midpoint());
+      _flat_node_children.resize(_flat_node_children.size() + 8,
+                                 AMRGRID_FLAT_NONE);
+      for (uint_fast8_t i = 0; i < 8; ++i) {
+        // the vector might be reallocated by the recursive call, so we cannot
+        // store a reference into it
+        const amrflatindex_t child =
+            flatten_cell(cell->get_child(i), flat_indices);
+        _flat_node_children[8 * node + i] = child;
+      }
+    }
+    flat_indices[cell] = flat_index;
+    return flat_index;
+  }
+
+  /**
+   * @brief Descend from the given flat index to the lowest level cell that
+   * contains the given position.
+   *
+   * As for AMRGridCell::get_child(), the position does not need to be inside
+   * the node, we only check its position w.r.t. the node midpoints.
+   *
+   * @param flat_index Flat index of a lowest level cell or a node.
+   * @param position Position.
+   * @return Flat index of the lowest level cell.
+   */
+  inline amrflatindex_t descend(amrflatindex_t flat_index,
+                                const CoordinateVector<> &position) const {
+    while (flat_index != AMRGRID_FLAT_NONE &&
+           (flat_index & AMRGRID_FLAT_NODE)) {
+      const amrflatindex_t node = flat_index & ~AMRGRID_FLAT_NODE;
+      const CoordinateVector<> &midpoint = _flat_node_midpoints[node];
+      const uint_fast8_t child = 4 * (position.x() > midpoint.x()) +
+                                 2 * (position.y() > midpoint.y()) +
+                                 (position.z() > midpoint.z());
+      flat_index = _flat_node_children[8 * node + child];
+      cmac_assert_message(flat_index != AMRGRID_FLAT_NONE,
+                          "Cell does not exist!");
+    }
+    return flat_index;
+  }
+
   /**
    * @brief Get the block that contains the given key.
    *
@@ -160,6 +267,7 @@ public:
   inline void operator=(const AMRGrid &grid) {
     _box = grid._box;
     _ncell = grid._ncell;
+    clear_flat_storage();
     CoordinateVector<> sides;
     sides[0] = _box.get_sides().x() / _ncell.x();
     sides[1] = _box.get_sides().y() / _ncell.y();
@@ -523,6 +631,146 @@ public:
     }
   }
 
+  /**
+   * @brief Clear the flattened storage.
+   */
+  inline void clear_flat_storage() {
+    _flat_cells.clear();
+    _flat_anchors.clear();
+    _flat_sides.clear();
+    _flat_ngbs.clear();
+    _flat_node_midpoints.clear();
+    _flat_node_children.clear();
+    _flat_top_level.clear();
+  }
+
+  /**
+   * @brief Build a flattened, linear copy of the grid structure.
+   *
+   * The lowest level cells are stored in Morton order in contiguous arrays,
+   * together with their geometry and the flat indices of their neighbours.
+   * Cells that have children (nodes) are stored in a separate table that only
+   * contains their midpoint and the flat indices of their children. Traversing
+   * the grid using the flat indices only involves index arithmetic on
+   * contiguous arrays, rather than walking the tree from the top level.
+   *
+   * The flattened storage is a snapshot: it needs to be rebuilt whenever the
+   * grid structure changes, and has to be built after set_ngbs() was called.
+   */
+  inline void flatten() {
+
+    clear_flat_storage();
+
+    std::unordered_map< const AMRGridCell< _CellContents_ > *, amrflatindex_t >
+        flat_indices;
+    _flat_top_level.reserve(_ncell.x() * _ncell.y() * _ncell.z());
+    for (uint_fast32_t ix = 0; ix < _ncell.x(); ++ix) {
+      for (uint_fast32_t iy = 0; iy < _ncell.y(); ++iy) {
+        for (uint_fast32_t iz = 0; iz < _ncell.z(); ++iz) {
+          _flat_top_level.push_back(
+              flatten_cell(_top_level[ix][iy][iz], flat_indices));
+        }
+      }
+    }
+    cmac_assert_message(_flat_cells.size() < AMRGRID_FLAT_NODE &&
+                            _flat_node_midpoints.size() < AMRGRID_FLAT_NODE,
+                        "Too many cells for flat storage!");
+
+    _flat_ngbs.resize(6 * _flat_cells.size(), AMRGRID_FLAT_NONE);
+    for (size_t i = 0; i < _flat_cells.size(); ++i) {
+      for (uint_fast8_t j = 0; j < 6; ++j) {
+        const AMRGridCell< _CellContents_ > *ngb =
+            _flat_cells[i]->get_ngb(static_cast< AMRNgbPosition >(j));
+        if (ngb != nullptr) {
+          _flat_ngbs[6 * i + j] = flat_indices[ngb];
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Get the number of lowest level cells in the flattened storage.
+   *
+   * @return Number of lowest level cells in the flattened storage (0 if
+   * flatten() was not called).
+   */
+  inline amrflatindex_t get_number_of_flat_cells() const {
+    return _flat_cells.size();
+  }
+
+  /**
+   * @brief Get the flat index of the lowest level cell that contains the given
+   * position.
+   *
+   * @param position CoordinateVector specifying a position within the box.
+   * @return Flat index of the lowest level cell containing that position.
+   */
+  inline amrflatindex_t
+  get_flat_index(const CoordinateVector<> &position) const {
+    const uint_fast32_t ix = _ncell.x() *
+                             (position.x() - _box.get_anchor().x()) /
+                             _box.get_sides().x();
+    const uint_fast32_t iy = _ncell.y() *
+                             (position.y() - _box.get_anchor().y()) /
+                             _box.get_sides().y();
+    const uint_fast32_t iz = _ncell.z() *
+                             (position.z() - _box.get_anchor().z()) /
+                             _box.get_sides().z();
+    return descend(
+        _flat_top_level[(ix * _ncell.y() + iy) * _ncell.z() + iz], position);
+  }
+
+  /**
+   * @brief Get the flat index of the lowest level cell on the other side of
+   * the given face of the given lowest level cell that contains the given
+   * position.
+   *
+   * @param flat_index Flat index of a lowest level cell.
+   * @param position AMRNgbPosition of the face.
+   * @param ngb_position Position on or beyond the face.
+   * @return Flat index of the neighbouring lowest level cell, or
+   * AMRGRID_FLAT_NONE if there is no neighbour.
+   */
+  inline amrflatindex_t
+  get_flat_ngb(const amrflatindex_t flat_index, const AMRNgbPosition position,
+               const CoordinateVector<> &ngb_position) const {
+    return descend(_flat_ngbs[6 * flat_index + position], ngb_position);
+  }
+
+  /**
+   * @brief Get the lowest level cell with the given flat index.
+   *
+   * @param flat_index Flat index of a lowest level cell.
+   * @return Corresponding cell.
+   */
+  inline AMRGridCell< _CellContents_ > &
+  get_flat_cell(const amrflatindex_t flat_index) const {
+    return *_flat_cells[flat_index];
+  }
+
+  /**
+   * @brief Get the anchor of the lowest level cell with the given flat index.
+   *
+   * @param flat_index Flat index of a lowest level cell.
+   * @return Anchor of the cell.
+   */
+  inline const CoordinateVector<> &
+  get_flat_anchor(const amrflatindex_t flat_index) const {
+    return _flat_anchors[flat_index];
+  }
+
+  /**
+   * @brief Get the side lengths of the lowest level cell with the given flat
+   * index.
+   *
+   * @param flat_index Flat index of a lowest level cell.
+   * @return Side lengths of the cell.
+   */
+  inline const CoordinateVector<> &
+  get_flat_sides(const amrflatindex_t flat_index) const {
+    return _flat_sides[flat_index];
+  }
+
   /**
    * @brief Get the number of lowest level cells in the grid.
    *
@@ -28,6 +28,7 @@
 
 #include "CoordinateVector.hpp"
 #include "DensityGrid.hpp"
+#include "DensitySubGrid.hpp"
 
 /**
  * @brief General interface for schemes used to refine an AMRDensityGrid.
@@ -35,6 +36,10 @@
  * We provide empty implementations for all routines, although in practice
  * every implementation should implement the refine() method, as otherwise the
  * implementation is completely useless.
+ *
+ * The same schemes are used to set the refinement level of the subgrids in a
+ * DensitySubGridCreator, for which the refine() method that takes a
+ * DensitySubGrid::iterator is used.
  */
 class AMRRefinementScheme {
 public:
@@ -54,6 +59,18 @@ public:
     return false;
   }
 
+  /**
+   * @brief Decide if the given subgrid cell should be refined or not.
+   *
+   * @param level Current refinement level of the subgrid containing the cell.
+   * @param cell DensitySubGrid::iterator pointing to a cell.
+   * @return True if the cell should be refined.
+   */
+  virtual bool refine(uint_fast8_t level,
+                      DensitySubGrid::iterator &cell) const {
+    return false;
+  }
+
   /**
    * @brief Decide if the given cells should be replaced by a single cell or
    * not.
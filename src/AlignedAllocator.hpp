@@ -0,0 +1,116 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file AlignedAllocator.hpp
+ *
+ * @brief Standard library compatible allocator that returns memory with a
+ * given alignment.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef ALIGNEDALLOCATOR_HPP
+#define ALIGNEDALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/**
+ * @brief Standard library compatible allocator that returns memory with a
+ * given alignment.
+ *
+ * C++11 containers ignore the alignment of over-aligned types when allocating
+ * memory; this allocator can be used to enforce it, e.g. to make sure elements
+ * of a std::vector start on a cache line boundary.
+ *
+ * @tparam _type_ Type of the allocated elements.
+ * @tparam _alignment_ Alignment of the allocated memory (in bytes, should be a
+ * power of 2 and a multiple of sizeof(void*)).
+ */
+template < typename _type_, size_t _alignment_ > class AlignedAllocator {
+public:
+  /*! @brief Type of the allocated elements. */
+  typedef _type_ value_type;
+
+  /**
+   * @brief Rebind the allocator to another element type.
+   */
+  template < typename _other_type_ > struct rebind {
+    /*! @brief Allocator for the other element type. */
+    typedef AlignedAllocator< _other_type_, _alignment_ > other;
+  };
+
+  /**
+   * @brief Empty constructor.
+   */
+  inline AlignedAllocator() {}
+
+  /**
+   * @brief Copy constructor for an allocator of another element type.
+   */
+  template < typename _other_type_ >
+  inline AlignedAllocator(
+      const AlignedAllocator< _other_type_, _alignment_ > &) {}
+
+  /**
+   * @brief Allocate memory for the given number of elements.
+   *
+   * @param number_of_elements Number of elements.
+   * @return Pointer to the aligned memory.
+   */
+  inline _type_ *allocate(const size_t number_of_elements) {
+    void *memory = nullptr;
+    if (posix_memalign(&memory, _alignment_,
+                       number_of_elements * sizeof(_type_)) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast< _type_ * >(memory);
+  }
+
+  /**
+   * @brief Free memory allocated by allocate().
+   *
+   * @param memory Pointer to the memory.
+   */
+  inline void deallocate(_type_ *memory, const size_t) { free(memory); }
+
+  /**
+   * @brief Allocators are stateless, so all instances compare equal.
+   *
+   * @return True.
+   */
+  template < typename _other_type_ >
+  inline bool
+  operator==(const AlignedAllocator< _other_type_, _alignment_ > &) const {
+    return true;
+  }
+
+  /**
+   * @brief Allocators are stateless, so all instances compare equal.
+   *
+   * @return False.
+   */
+  template < typename _other_type_ >
+  inline bool
+  operator!=(const AlignedAllocator< _other_type_, _alignment_ > &) const {
+    return false;
+  }
+};
+
+#endif // ALIGNEDALLOCATOR_HPP
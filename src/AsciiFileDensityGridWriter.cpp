@@ -97,6 +97,10 @@ void AsciiFileDensityGridWriter::write(DensityGrid &grid,
 /**
  * @brief Write a snapshot for a split grid.
  *
+ * If the grid is distributed over multiple MPI processes, every process only
+ * writes its own subgrids, to a file with the rank of the process added to the
+ * file name (e.g. prefix000.1.txt for the process with rank 1).
+ *
  * @param grid_creator Grid.
  * @param counter Counter value to add to the snapshot file name.
  * @param params ParameterFile containing the run parameters that should be
@@ -107,14 +111,21 @@ void AsciiFileDensityGridWriter::write(
     DensitySubGridCreator< DensitySubGrid > &grid_creator,
     const uint_fast32_t counter, ParameterFile &params, double time) {
 
-  std::string filename =
-      Utilities::compose_filename(_output_folder, _prefix, "txt", counter, 3);
+  std::string extension = "txt";
+  if (grid_creator.is_distributed()) {
+    extension = Utilities::to_string(grid_creator.get_MPI_rank()) + ".txt";
+  }
+  std::string filename = Utilities::compose_filename(_output_folder, _prefix,
+                                                     extension, counter, 3);
   std::ofstream file(filename);
 
   file << "#x (m)\ty (m)\tz (m)\tn (m^-3)\tvolume (m^3)\tneutral H fraction\n";
 
   for (auto gridit = grid_creator.begin();
        gridit != grid_creator.original_end(); ++gridit) {
+    if (!grid_creator.is_local(gridit.get_index())) {
+      continue;
+    }
     for (auto cellit = (*gridit).begin(); cellit != (*gridit).end(); ++cellit) {
       const CoordinateVector<> x = cellit.get_cell_midpoint();
       const double n = cellit.get_ionization_variables().get_number_density();
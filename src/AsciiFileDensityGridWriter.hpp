@@ -43,6 +43,17 @@ public:
   AsciiFileDensityGridWriter(std::string output_folder, ParameterFile &params,
                              Log *log = nullptr);
 
+  /**
+   * @brief Check if the writer can write snapshots for a split grid that is
+   * distributed over multiple MPI processes.
+   *
+   * Every process writes its own subgrids to a file with the process rank
+   * added to the snapshot file name.
+   *
+   * @return True.
+   */
+  virtual bool supports_distributed_output() const { return true; }
+
   virtual void write(DensityGrid &grid, uint_fast32_t iteration,
                      ParameterFile &params, double time = 0.,
                      const InternalHydroUnits *hydro_units = nullptr);
@@ -24,15 +24,285 @@
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
 #include "CMILibrary.hpp"
+#include "AtomicValue.hpp"
+#include "DensityGrid.hpp"
+#include "Error.hpp"
 #include "IonizationSimulation.hpp"
 #include "SPHArrayInterface.hpp"
 #include "TerminalLog.hpp"
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 IonizationSimulation *global_ionization_simulation = nullptr;
 SPHArrayInterface *global_interface = nullptr;
 
 Log *global_log = nullptr;
 
+/*! @brief Background thread that runs asynchronous computations. */
+static std::thread global_computation_thread;
+
+/*! @brief Flag signalling that the last computation has finished. */
+static AtomicValue< bool > global_computation_done(true);
+
+/*! @brief Temperatures and ionic fractions of all cells at the end of the last
+ *  computation, used as initial condition for the next computation if warm
+ *  starts are enabled. */
+static std::vector< double > global_ionization_state;
+
+/**
+ * @brief Particle data pushed by the calling code that have not been handed
+ * over to the global SPHArrayInterface yet.
+ *
+ * Pushes only write to this staging copy and hence never have to wait for a
+ * running asynchronous computation. The next computation transfers the range
+ * of particles that was pushed since the previous computation to the
+ * SPHArrayInterface, which only rebuilds its Octree if positions actually
+ * changed.
+ */
+class CMIParticleSession {
+private:
+  /*! @brief Staged x coordinates (in internal units). */
+  std::vector< double > _x;
+
+  /*! @brief Staged y coordinates (in internal units). */
+  std::vector< double > _y;
+
+  /*! @brief Staged z coordinates (in internal units). */
+  std::vector< double > _z;
+
+  /*! @brief Staged smoothing lengths (in internal units). */
+  std::vector< double > _h;
+
+  /*! @brief Staged masses (in internal units). */
+  std::vector< double > _m;
+
+  /*! @brief Index of the first particle that was pushed since the last
+   *  transfer. */
+  size_t _first_pushed;
+
+  /*! @brief Index one past the last particle that was pushed since the last
+   *  transfer. */
+  size_t _end_pushed;
+
+public:
+  /**
+   * @brief Constructor.
+   */
+  CMIParticleSession() : _first_pushed(0), _end_pushed(0) {}
+
+  /**
+   * @brief Set the number of particles.
+   *
+   * @param N New number of particles.
+   */
+  inline void set_number_of_particles(const size_t N) {
+    _x.resize(N, 0.);
+    _y.resize(N, 0.);
+    _z.resize(N, 0.);
+    _h.resize(N, 0.);
+    _m.resize(N, 0.);
+    _end_pushed = std::min(_end_pushed, N);
+    _first_pushed = std::min(_first_pushed, _end_pushed);
+  }
+
+  /**
+   * @brief Copy the given particle data into the staging arrays.
+   *
+   * @param offset Index of the first particle to update.
+   * @param x X coordinates (in internal units).
+   * @param y Y coordinates (in internal units).
+   * @param z Z coordinates (in internal units).
+   * @param h Smoothing lengths (in internal units).
+   * @param m Masses (in internal units).
+   * @param N Number of elements in each array.
+   */
+  template < typename _position_type_, typename _property_type_ >
+  inline void push(const size_t offset, const _position_type_ *x,
+                   const _position_type_ *y, const _position_type_ *z,
+                   const _property_type_ *h, const _property_type_ *m,
+                   const size_t N) {
+
+    if (N == 0) {
+      return;
+    }
+    if (offset + N > _x.size()) {
+      cmac_error("Pushed particles %zu to %zu, but only %zu particles are "
+                 "available!",
+                 offset, offset + N - 1, _x.size());
+    }
+    std::copy(x, x + N, _x.begin() + offset);
+    std::copy(y, y + N, _y.begin() + offset);
+    std::copy(z, z + N, _z.begin() + offset);
+    std::copy(h, h + N, _h.begin() + offset);
+    std::copy(m, m + N, _m.begin() + offset);
+    if (_end_pushed == _first_pushed) {
+      _first_pushed = offset;
+      _end_pushed = offset + N;
+    } else {
+      _first_pushed = std::min(_first_pushed, offset);
+      _end_pushed = std::max(_end_pushed, offset + N);
+    }
+  }
+
+  /**
+   * @brief Hand over the pushed particles to the given SPHArrayInterface.
+   *
+   * Must only be called while no computation is running.
+   *
+   * @param interface SPHArrayInterface to update.
+   */
+  inline void transfer(SPHArrayInterface &interface) {
+    interface.set_number_of_particles(_x.size());
+    if (_end_pushed > _first_pushed) {
+      const size_t i = _first_pushed;
+      interface.update_particles(i, &_x[i], &_y[i], &_z[i], &_h[i], &_m[i],
+                                 _end_pushed - i);
+    }
+    _first_pushed = 0;
+    _end_pushed = 0;
+  }
+};
+
+/*! @brief Particle data pushed since the last computation. */
+static CMIParticleSession global_session;
+
+/**
+ * @brief Should computations start from the ionization state at the end of the
+ * previous computation?
+ *
+ * The value is read from the parameter "CMILibrary:warm start" in the parameter
+ * file of the global IonizationSimulation (default: false, every computation
+ * starts from a neutral grid at 8000 K).
+ *
+ * @return True if warm starts are enabled.
+ */
+static bool get_warm_start_flag() {
+  return global_ionization_simulation->get_parameter_file().get_value< bool >(
+      "CMILibrary:warm start", false);
+}
+
+/**
+ * @brief Store the temperatures and ionic fractions of all cells in the grid of
+ * the global IonizationSimulation.
+ */
+static void save_ionization_state() {
+
+  DensityGrid &grid = global_ionization_simulation->get_density_grid();
+  global_ionization_state.resize(grid.get_number_of_cells() *
+                                 (NUMBER_OF_IONNAMES + 1));
+  size_t index = 0;
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    const IonizationVariables &vars = it.get_ionization_variables();
+    global_ionization_state[index] = vars.get_temperature();
+    ++index;
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      global_ionization_state[index] = vars.get_ionic_fraction(ion);
+      ++index;
+    }
+  }
+}
+
+/**
+ * @brief Reset the temperatures and ionic fractions of all cells in the grid of
+ * the global IonizationSimulation to the values stored by
+ * save_ionization_state().
+ *
+ * Does nothing if no state was stored yet.
+ */
+static void restore_ionization_state() {
+
+  DensityGrid &grid = global_ionization_simulation->get_density_grid();
+  if (global_ionization_state.size() !=
+      grid.get_number_of_cells() * (NUMBER_OF_IONNAMES + 1)) {
+    return;
+  }
+  size_t index = 0;
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    IonizationVariables &vars = it.get_ionization_variables();
+    vars.set_temperature(global_ionization_state[index]);
+    ++index;
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      vars.set_ionic_fraction(ion, global_ionization_state[index]);
+      ++index;
+    }
+  }
+}
+
+/**
+ * @brief Compute the neutral fractions for the SPH density field that is
+ * currently stored in the global SPHArrayInterface and store them in the given
+ * array.
+ *
+ * @param nH Array to store the resulting neutral fractions in.
+ */
+template < typename _datatype_ >
+static void compute_neutral_fraction(_datatype_ *nH) {
+
+  const bool warm_start = get_warm_start_flag();
+  global_ionization_simulation->initialize(global_interface);
+  if (warm_start) {
+    restore_ionization_state();
+  }
+  global_ionization_simulation->run(global_interface);
+  if (warm_start) {
+    save_ionization_state();
+  }
+  global_interface->fill_array(nH);
+  global_computation_done.set(true);
+}
+
+/**
+ * @brief Launch compute_neutral_fraction() on the background thread.
+ *
+ * @param nH Array to store the resulting neutral fractions in.
+ */
+template < typename _datatype_ >
+static void start_computation(_datatype_ *nH) {
+  global_computation_done.set(false);
+  global_computation_thread =
+      std::thread(compute_neutral_fraction< _datatype_ >, nH);
+}
+
+/**
+ * @brief Replace all particles by the given particles and hand them over to
+ * the global SPHArrayInterface.
+ *
+ * Waits for any ongoing asynchronous computation to finish first.
+ *
+ * @param x X coordinates (in internal units).
+ * @param y Y coordinates (in internal units).
+ * @param z Z coordinates (in internal units).
+ * @param h Smoothing lengths (in internal units).
+ * @param m Masses (in internal units).
+ * @param N Number of elements in each array.
+ */
+template < typename _position_type_, typename _property_type_ >
+static void set_particles(const _position_type_ *x, const _position_type_ *y,
+                          const _position_type_ *z, const _property_type_ *h,
+                          const _property_type_ *m, const size_t N) {
+  global_session.set_number_of_particles(N);
+  global_session.push(0, x, y, z, h, m, N);
+  cmi_wait();
+  global_session.transfer(*global_interface);
+}
+
+/**
+ * @brief Get the name of the file used to cache the SPHArrayInterface gridding
+ * table in between library initializations.
+ *
+ * The name is read from the parameter "CMILibrary:gridding cache file" in the
+ * parameter file of the global IonizationSimulation (default: empty string,
+ * no caching).
+ *
+ * @return Name of the gridding cache file.
+ */
+static std::string get_gridding_cache_file_name() {
+  return global_ionization_simulation->get_parameter_file()
+      .get_value< std::string >("CMILibrary:gridding cache file", "");
+}
+
 /**
  * @brief Initialize the CMI library.
  *
@@ -56,7 +326,8 @@ void cmi_init(const char *parameter_file, const int num_thread,
   global_ionization_simulation = new IonizationSimulation(
       true, false, false, num_thread, parameter_file, nullptr, global_log);
   global_interface =
-      new SPHArrayInterface(unit_length_in_SI, unit_mass_in_SI, mapping_type);
+      new SPHArrayInterface(unit_length_in_SI, unit_mass_in_SI, mapping_type,
+                            get_gridding_cache_file_name());
 }
 
 /**
@@ -87,8 +358,9 @@ void cmi_init_periodic_dp(const char *parameter_file, const int num_thread,
 
   global_ionization_simulation = new IonizationSimulation(
       true, false, false, num_thread, parameter_file, nullptr, global_log);
-  global_interface = new SPHArrayInterface(unit_length_in_SI, unit_mass_in_SI,
-                                           box_anchor, box_sides, mapping_type);
+  global_interface = new SPHArrayInterface(
+      unit_length_in_SI, unit_mass_in_SI, box_anchor, box_sides, mapping_type,
+      get_gridding_cache_file_name());
 }
 
 /**
@@ -119,14 +391,18 @@ void cmi_init_periodic_sp(const char *parameter_file, const int num_thread,
 
   global_ionization_simulation = new IonizationSimulation(
       true, false, false, num_thread, parameter_file, nullptr, global_log);
-  global_interface = new SPHArrayInterface(unit_length_in_SI, unit_mass_in_SI,
-                                           box_anchor, box_sides, mapping_type);
+  global_interface = new SPHArrayInterface(
+      unit_length_in_SI, unit_mass_in_SI, box_anchor, box_sides, mapping_type,
+      get_gridding_cache_file_name());
 }
 
 /**
  * @brief Free up the memory used by the CMI library.
  */
 void cmi_destroy() {
+  cmi_wait();
+  global_ionization_state.clear();
+  global_session = CMIParticleSession();
   delete global_ionization_simulation;
   delete global_interface;
   delete global_log;
@@ -136,6 +412,8 @@ void cmi_destroy() {
  * @brief Compute the neutral fractions for the given SPH density field and
  * store them in the given array.
  *
+ * Waits for any ongoing asynchronous computation to finish first.
+ *
  * Double precision version.
  *
  * @param x X coordinates (in internal units).
@@ -151,16 +429,16 @@ void cmi_compute_neutral_fraction_dp(const double *x, const double *y,
                                      const double *m, double *nH,
                                      const size_t N) {
 
-  global_interface->reset(x, y, z, h, m, N);
-  global_ionization_simulation->initialize(global_interface);
-  global_ionization_simulation->run(global_interface);
-  global_interface->fill_array(nH);
+  set_particles(x, y, z, h, m, N);
+  compute_neutral_fraction(nH);
 }
 
 /**
  * @brief Compute the neutral fractions for the given SPH density field and
  * store them in the given array.
  *
+ * Waits for any ongoing asynchronous computation to finish first.
+ *
  * Mixed precision version.
  *
  * @param x X coordinates (in internal units).
@@ -176,16 +454,16 @@ void cmi_compute_neutral_fraction_mp(const double *x, const double *y,
                                      const float *m, float *nH,
                                      const size_t N) {
 
-  global_interface->reset(x, y, z, h, m, N);
-  global_ionization_simulation->initialize(global_interface);
-  global_ionization_simulation->run(global_interface);
-  global_interface->fill_array(nH);
+  set_particles(x, y, z, h, m, N);
+  compute_neutral_fraction(nH);
 }
 
 /**
  * @brief Compute the neutral fractions for the given SPH density field and
  * store them in the given array.
  *
+ * Waits for any ongoing asynchronous computation to finish first.
+ *
  * Single precision version.
  *
  * @param x X coordinates (in internal units).
@@ -201,8 +479,212 @@ void cmi_compute_neutral_fraction_sp(const float *x, const float *y,
                                      const float *m, float *nH,
                                      const size_t N) {
 
-  global_interface->reset(x, y, z, h, m, N);
-  global_ionization_simulation->initialize(global_interface);
-  global_ionization_simulation->run(global_interface);
-  global_interface->fill_array(nH);
+  set_particles(x, y, z, h, m, N);
+  compute_neutral_fraction(nH);
+}
+
+/**
+ * @brief Start the computation of the neutral fractions for the given SPH
+ * density field on a background thread.
+ *
+ * Double precision version.
+ *
+ * The particle data are copied before this function returns, so the input
+ * arrays can be changed while the computation runs. The neutral fraction array
+ * is only written to at the end of the computation and should stay valid until
+ * cmi_wait() returns or cmi_test() returns 1. Waits for any ongoing
+ * asynchronous computation to finish first.
+ *
+ * @param x X coordinates (in internal units).
+ * @param y Y coordinates (in internal units).
+ * @param z Z coordinates (in internal units).
+ * @param h Smoothing lengths (in internal units).
+ * @param m Masses (in internal units).
+ * @param nH Array to store the resulting neutral fractions in.
+ * @param N Number of elements in each array.
+ */
+void cmi_compute_neutral_fraction_async_dp(const double *x, const double *y,
+                                           const double *z, const double *h,
+                                           const double *m, double *nH,
+                                           const size_t N) {
+
+  set_particles(x, y, z, h, m, N);
+  start_computation(nH);
+}
+
+/**
+ * @brief Start the computation of the neutral fractions for the given SPH
+ * density field on a background thread.
+ *
+ * Mixed precision version; see cmi_compute_neutral_fraction_async_dp().
+ *
+ * @param x X coordinates (in internal units).
+ * @param y Y coordinates (in internal units).
+ * @param z Z coordinates (in internal units).
+ * @param h Smoothing lengths (in internal units).
+ * @param m Masses (in internal units).
+ * @param nH Array to store the resulting neutral fractions in.
+ * @param N Number of elements in each array.
+ */
+void cmi_compute_neutral_fraction_async_mp(const double *x, const double *y,
+                                           const double *z, const float *h,
+                                           const float *m, float *nH,
+                                           const size_t N) {
+
+  set_particles(x, y, z, h, m, N);
+  start_computation(nH);
+}
+
+/**
+ * @brief Start the computation of the neutral fractions for the given SPH
+ * density field on a background thread.
+ *
+ * Single precision version; see cmi_compute_neutral_fraction_async_dp().
+ *
+ * @param x X coordinates (in internal units).
+ * @param y Y coordinates (in internal units).
+ * @param z Z coordinates (in internal units).
+ * @param h Smoothing lengths (in internal units).
+ * @param m Masses (in internal units).
+ * @param nH Array to store the resulting neutral fractions in.
+ * @param N Number of elements in each array.
+ */
+void cmi_compute_neutral_fraction_async_sp(const float *x, const float *y,
+                                           const float *z, const float *h,
+                                           const float *m, float *nH,
+                                           const size_t N) {
+
+  set_particles(x, y, z, h, m, N);
+  start_computation(nH);
+}
+
+/**
+ * @brief Set the number of particles used by the next computation that is
+ * started with cmi_start_computation_dp() or cmi_start_computation_sp().
+ *
+ * Particles that already exist keep their pushed values. This function does
+ * not wait for an ongoing asynchronous computation.
+ *
+ * @param N Number of particles.
+ */
+void cmi_set_number_of_particles(const size_t N) {
+  global_session.set_number_of_particles(N);
+}
+
+/**
+ * @brief Push new data values for a range of particles.
+ *
+ * The values are copied into a staging area before this function returns and
+ * are only used by the next computation that is started with
+ * cmi_start_computation_dp() or cmi_start_computation_sp(). This function does
+ * not wait for an ongoing asynchronous computation, so that the calling code
+ * can push the next step while the current step is being computed. Only pushed
+ * particles are handed over when the computation starts, and the neighbour
+ * search tree is only rebuilt if particle positions changed.
+ *
+ * Double precision version.
+ *
+ * @param offset Index of the first particle to update.
+ * @param x X coordinates (in internal units).
+ * @param y Y coordinates (in internal units).
+ * @param z Z coordinates (in internal units).
+ * @param h Smoothing lengths (in internal units).
+ * @param m Masses (in internal units).
+ * @param N Number of elements in each array.
+ */
+void cmi_push_particles_dp(const size_t offset, const double *x,
+                           const double *y, const double *z, const double *h,
+                           const double *m, const size_t N) {
+  global_session.push(offset, x, y, z, h, m, N);
+}
+
+/**
+ * @brief Push new data values for a range of particles.
+ *
+ * Mixed precision version; see cmi_push_particles_dp().
+ *
+ * @param offset Index of the first particle to update.
+ * @param x X coordinates (in internal units).
+ * @param y Y coordinates (in internal units).
+ * @param z Z coordinates (in internal units).
+ * @param h Smoothing lengths (in internal units).
+ * @param m Masses (in internal units).
+ * @param N Number of elements in each array.
+ */
+void cmi_push_particles_mp(const size_t offset, const double *x,
+                           const double *y, const double *z, const float *h,
+                           const float *m, const size_t N) {
+  global_session.push(offset, x, y, z, h, m, N);
+}
+
+/**
+ * @brief Push new data values for a range of particles.
+ *
+ * Single precision version; see cmi_push_particles_dp().
+ *
+ * @param offset Index of the first particle to update.
+ * @param x X coordinates (in internal units).
+ * @param y Y coordinates (in internal units).
+ * @param z Z coordinates (in internal units).
+ * @param h Smoothing lengths (in internal units).
+ * @param m Masses (in internal units).
+ * @param N Number of elements in each array.
+ */
+void cmi_push_particles_sp(const size_t offset, const float *x, const float *y,
+                           const float *z, const float *h, const float *m,
+                           const size_t N) {
+  global_session.push(offset, x, y, z, h, m, N);
+}
+
+/**
+ * @brief Start the computation of the neutral fractions for the pushed
+ * particles on a background thread.
+ *
+ * Waits for any ongoing asynchronous computation to finish first. The neutral
+ * fraction array should stay valid until cmi_wait() returns or cmi_test()
+ * returns 1.
+ *
+ * Double precision version.
+ *
+ * @param nH Array to store the resulting neutral fractions in.
+ */
+void cmi_start_computation_dp(double *nH) {
+  cmi_wait();
+  global_session.transfer(*global_interface);
+  start_computation(nH);
+}
+
+/**
+ * @brief Start the computation of the neutral fractions for the pushed
+ * particles on a background thread.
+ *
+ * Single precision version; see cmi_start_computation_dp().
+ *
+ * @param nH Array to store the resulting neutral fractions in.
+ */
+void cmi_start_computation_sp(float *nH) {
+  cmi_wait();
+  global_session.transfer(*global_interface);
+  start_computation(nH);
+}
+
+/**
+ * @brief Check whether the last asynchronous computation has finished.
+ *
+ * This function does not block.
+ *
+ * @return 1 if the neutral fractions of the last computation are available, 0
+ * otherwise.
+ */
+int cmi_test() { return global_computation_done.value() ? 1 : 0; }
+
+/**
+ * @brief Wait for the last asynchronous computation to finish.
+ *
+ * Returns immediately if no computation is running.
+ */
+void cmi_wait() {
+  if (global_computation_thread.joinable()) {
+    global_computation_thread.join();
+  }
 }
@@ -69,6 +69,34 @@ void cmi_compute_neutral_fraction_mp(const double *x, const double *y,
 void cmi_compute_neutral_fraction_sp(const float *x, const float *y,
                                      const float *z, const float *h,
                                      const float *m, float *nH, const size_t N);
+
+void cmi_compute_neutral_fraction_async_dp(const double *x, const double *y,
+                                           const double *z, const double *h,
+                                           const double *m, double *nH,
+                                           const size_t N);
+void cmi_compute_neutral_fraction_async_mp(const double *x, const double *y,
+                                           const double *z, const float *h,
+                                           const float *m, float *nH,
+                                           const size_t N);
+void cmi_compute_neutral_fraction_async_sp(const float *x, const float *y,
+                                           const float *z, const float *h,
+                                           const float *m, float *nH,
+                                           const size_t N);
+void cmi_set_number_of_particles(const size_t N);
+void cmi_push_particles_dp(const size_t offset, const double *x,
+                           const double *y, const double *z, const double *h,
+                           const double *m, const size_t N);
+void cmi_push_particles_mp(const size_t offset, const double *x,
+                           const double *y, const double *z, const float *h,
+                           const float *m, const size_t N);
+void cmi_push_particles_sp(const size_t offset, const float *x, const float *y,
+                           const float *z, const float *h, const float *m,
+                           const size_t N);
+void cmi_start_computation_dp(double *nH);
+void cmi_start_computation_sp(float *nH);
+
+int cmi_test();
+void cmi_wait();
 }
 
 #endif // CMILIBRARY_HPP
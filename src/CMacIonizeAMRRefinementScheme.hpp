@@ -38,6 +38,27 @@ class Log;
  * CMacIonize snapshot.
  */
 class CMacIonizeAMRRefinementScheme : public AMRRefinementScheme {
+private:
+  /**
+   * @brief Should the cell with the given properties be refined?
+   *
+   * This function works closely together with the
+   * CMacIonizeSnapshotDensityFunction to make sure that all cells in the
+   * reconstructed AMRDensityGrid have the same refinement as in the snapshot.
+   * To this end, the CMacIonizeSnapshotDensityFunction returns a negative
+   * density value for cells that are not at the right level.
+   *
+   * @tparam _cell_iterator_ Cell iterator type.
+   * @param level Current depth level of the cell.
+   * @param cell Iterator pointing to a cell (DensityGrid::iterator or
+   * DensitySubGrid::iterator).
+   * @return True if the cell should be split in 8 smaller cells.
+   */
+  template < typename _cell_iterator_ >
+  inline bool refine_cell(uint_fast8_t level, _cell_iterator_ &cell) const {
+    return cell.get_ionization_variables().get_number_density() < 0.;
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -63,7 +84,25 @@ public:
    * @return True if the cell should be split in 8 smaller cells.
    */
   virtual bool refine(uint_fast8_t level, DensityGrid::iterator &cell) const {
-    return cell.get_ionization_variables().get_number_density() < 0.;
+    return refine_cell(level, cell);
+  }
+
+  /**
+   * @brief Should the cell with the given properties be refined?
+   *
+   * This function works closely together with the
+   * CMacIonizeSnapshotDensityFunction to make sure that all cells in the
+   * reconstructed AMRDensityGrid have the same refinement as in the snapshot.
+   * To this end, the CMacIonizeSnapshotDensityFunction returns a negative
+   * density value for cells that are not at the right level.
+   *
+   * @param level Current depth level of the cell.
+   * @param cell DensitySubGrid::iterator pointing to a cell.
+   * @return True if the cell should be split in 8 smaller cells.
+   */
+  virtual bool refine(uint_fast8_t level,
+                      DensitySubGrid::iterator &cell) const {
+    return refine_cell(level, cell);
   }
 };
 
@@ -32,6 +32,7 @@
 // implementations
 #include "BimodalCrossSections.hpp"
 #include "FixedValueCrossSections.hpp"
+#include "TabulatedCrossSections.hpp"
 #include "VernerCrossSections.hpp"
 
 /**
@@ -49,6 +50,8 @@ public:
    *    FixedValueDiffuseReemissionHandler to set different cross sections for
    *    diffuse radiation).
    *  - FixedValue: Implementation that uses user specified cross sections.
+   *  - TabulatedVerner: Implementation that interpolates on a precomputed
+   *    table of the Verner cross sections (see TabulatedCrossSections).
    *  - Verner: Implementation that uses the Verner & Yakovlev (1995) and Verner
    *    et al. (1996) cross sections.
    *
@@ -70,6 +73,8 @@ public:
       return new BiModalCrossSections(params);
     } else if (type == "FixedValue") {
       return new FixedValueCrossSections(params);
+    } else if (type == "TabulatedVerner") {
+      return new TabulatedCrossSections(new VernerCrossSections(), params, log);
     } else if (type == "Verner") {
       return new VernerCrossSections();
     } else {
@@ -29,6 +29,10 @@
 #include "Cell.hpp"
 #include "DensityValues.hpp"
 
+#include <utility>
+
+class DensityGrid;
+
 /**
  * @brief Interface for functors that can be used to fill a DensityGrid.
  */
@@ -49,6 +53,26 @@ public:
    */
   virtual void initialize() {}
 
+  /**
+   * @brief Prepare the density function for the initialization of the given
+   * block of cells in the given DensityGrid.
+   *
+   * This routine is called by the DensityGrid before operator() is called for
+   * the cells in the block, at a point where the geometry of all cells is
+   * known. It does not need to be implemented by all implementations, but can
+   * be used by implementations that compute the cell values by looping over
+   * their own elements rather than over the cells (e.g. SPH interfaces that
+   * scatter particle masses onto the grid).
+   *
+   * @param grid DensityGrid that is being initialized.
+   * @param block Range of cell indices that will be initialized.
+   * @param worksize Number of shared memory threads that can be used. If a
+   * negative number is given, all available threads can be used.
+   */
+  virtual void prepare(DensityGrid &grid,
+                       const std::pair< size_t, size_t > &block,
+                       const int_fast32_t worksize) {}
+
   /**
    * @brief Free up the memory used by the density function. After this,
    * operator() will no longer work.
@@ -62,6 +86,22 @@ public:
    * @return Initial physical field values for that cell.
    */
   virtual DensityValues operator()(const Cell &cell) = 0;
+
+  /**
+   * @brief Function that gives the density for the cell with the given index in
+   * the DensityGrid that was last passed on to prepare().
+   *
+   * Implementations that compute the cell values in prepare() can use the
+   * index to look them up. By default, this simply calls operator().
+   *
+   * @param cell Geometrical information about the cell.
+   * @param index Index of the cell in the DensityGrid.
+   * @return Initial physical field values for that cell.
+   */
+  virtual DensityValues get_prepared_values(const Cell &cell,
+                                            const size_t index) {
+    return (*this)(cell);
+  }
 };
 
 #endif // DENSITYFUNCTION_HPP
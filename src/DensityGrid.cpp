@@ -30,7 +30,8 @@
  * @brief Initialize the cells in the grid.
  *
  * All implementations should call this method in their initialization()
- * routine.
+ * routine. The DensityFunction is given the chance to prepare for the block
+ * before it is evaluated for the individual cells.
  *
  * @param block Continuous block of indices to initialize.
  * @param function DensityFunction that sets the density.
@@ -41,6 +42,8 @@ void DensityGrid::set_densities(std::pair< cellsize_t, cellsize_t > &block,
                                 DensityFunction &function,
                                 int_fast32_t worksize) {
 
+  function.prepare(*this, block, worksize);
+
   DensityGridInitializationFunction init(function, _has_hydro);
   WorkDistributor<
       DensityGridTraversalJobMarket< DensityGridInitializationFunction >,
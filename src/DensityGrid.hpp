@@ -774,7 +774,8 @@ public:
      */
     inline void operator()(iterator it) {
 
-      DensityValues vals = _function(it);
+      DensityValues vals =
+          _function.get_prepared_values(it, it.get_index());
       IonizationVariables &ionization_variables = it.get_ionization_variables();
       ionization_variables.set_number_density(vals.get_number_density());
       ionization_variables.set_temperature(vals.get_temperature());
@@ -83,6 +83,17 @@ public:
    */
   virtual ~DensityGridWriter() {}
 
+  /**
+   * @brief Check if the writer can write snapshots for a split grid that is
+   * distributed over multiple MPI processes.
+   *
+   * Writers that support this write a separate file for every process, that
+   * only contains the subgrids owned by that process.
+   *
+   * @return False, unless a child class overrides this function.
+   */
+  virtual bool supports_distributed_output() const { return false; }
+
   /**
    * @brief Write a snapshot.
    *
@@ -71,6 +71,22 @@ enum DensityGridFieldType {
   DENSITYGRIDFIELDTYPE_NUMBER
 };
 
+/**
+ * @brief Precisions with which output fields can be written.
+ */
+enum DensityGridFieldPrecision {
+  /*! @brief Full double precision. */
+  DENSITYGRIDFIELDPRECISION_DOUBLE = 0,
+  /*! @brief Single precision (32-bit floating point). */
+  DENSITYGRIDFIELDPRECISION_FLOAT32,
+  /*! @brief Half precision (16-bit floating point). */
+  DENSITYGRIDFIELDPRECISION_FLOAT16,
+  /*! @brief Lossy quantisation with a fixed number of decimal digits. */
+  DENSITYGRIDFIELDPRECISION_QUANTISED,
+  /*! @brief Lossy rounding to a fixed number of significant digits. */
+  DENSITYGRIDFIELDPRECISION_SIGNIFICANT
+};
+
 /**
  * @brief Functionality to handle DensityGridFields and DensityGridFieldTypes.
  */
@@ -714,6 +730,38 @@ private:
   /*! @brief Number of active fields of each type. */
   uint_least8_t _field_count[DENSITYGRIDFIELDTYPE_NUMBER];
 
+  /*! @brief DensityGridFieldPrecision for each DensityGridField. */
+  uint_least8_t _field_precision[DENSITYGRIDFIELD_NUMBER];
+
+  /*! @brief Number of decimal digits that is kept for each quantised
+   *  DensityGridField. */
+  uint_least8_t _field_decimal_digits[DENSITYGRIDFIELD_NUMBER];
+
+  /**
+   * @brief Get the DensityGridFieldPrecision corresponding to the given
+   * string.
+   *
+   * @param precision std::string representation of a
+   * DensityGridFieldPrecision.
+   * @return Corresponding DensityGridFieldPrecision.
+   */
+  inline static int_fast32_t get_precision(const std::string precision) {
+    if (precision == "double") {
+      return DENSITYGRIDFIELDPRECISION_DOUBLE;
+    } else if (precision == "float32") {
+      return DENSITYGRIDFIELDPRECISION_FLOAT32;
+    } else if (precision == "float16") {
+      return DENSITYGRIDFIELDPRECISION_FLOAT16;
+    } else if (precision == "quantised") {
+      return DENSITYGRIDFIELDPRECISION_QUANTISED;
+    } else if (precision == "significant") {
+      return DENSITYGRIDFIELDPRECISION_SIGNIFICANT;
+    } else {
+      cmac_error("Unknown output precision: %s!", precision.c_str());
+      return DENSITYGRIDFIELDPRECISION_DOUBLE;
+    }
+  }
+
   /**
    * @brief Return the number of 1 bits in the given sequence.
    *
@@ -747,6 +795,8 @@ public:
          ++property) {
       _field_flag[property] = default_flag(property, hydro);
       _field_count[get_type(property)] += bit_count(_field_flag[property]);
+      _field_precision[property] = DENSITYGRIDFIELDPRECISION_DOUBLE;
+      _field_decimal_digits[property] = 0;
     }
   }
 
@@ -768,6 +818,8 @@ public:
          ++property) {
       _field_flag[property] = flags[property];
       _field_count[get_type(property)] += bit_count(_field_flag[property]);
+      _field_precision[property] = DENSITYGRIDFIELDPRECISION_DOUBLE;
+      _field_decimal_digits[property] = 0;
     }
   }
 
@@ -781,6 +833,8 @@ public:
     for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
          ++property) {
       _field_flag[property] = copy._field_flag[property];
+      _field_precision[property] = copy._field_precision[property];
+      _field_decimal_digits[property] = copy._field_decimal_digits[property];
     }
 
     for (int_fast32_t type = 0; type < DENSITYGRIDFIELDTYPE_NUMBER; ++type) {
@@ -791,6 +845,24 @@ public:
   /**
    * @brief ParameterFile constructor.
    *
+   * For every field name (e.g. NumberDensity or NeutralFractionH), a flag
+   * parameter with the same name determines whether or not the field is
+   * written. For every active field, the following parameters can be used to
+   * reduce the size of the output (fields with multiple variables, like
+   * NeutralFraction, use the same precision for all their variables):
+   *  - <field> precision: precision used to store the field: double, float32,
+   *    float16 (only suitable for values in the range [6e-5, 6e4]), quantised
+   *    or significant (default: double)
+   *  - <field> decimal digits: number of decimal digits that is kept for a
+   *    quantised field; note that this is an absolute precision, so that
+   *    quantisation is only suitable for fields with values of order unity or
+   *    larger and not for e.g. NeutralFraction (no default, required for
+   *    quantised fields)
+   *  - <field> significant digits: number of significant digits that is kept
+   *    for a significant field; this is a relative precision that is suitable
+   *    for fields that span many orders of magnitude (no default, required
+   *    for significant fields)
+   *
    * @param params ParameterFile to read from.
    * @param hydro Flag specifying whether or not hydro is active.
    */
@@ -832,8 +904,41 @@ public:
               default_flag(property, hydro));
         }
         _field_count[get_type(property)] += bit_count(_field_flag[property]);
+        _field_precision[property] = DENSITYGRIDFIELDPRECISION_DOUBLE;
+        _field_decimal_digits[property] = 0;
+        if (_field_flag[property] > 0) {
+          _field_precision[property] =
+              get_precision(params.get_value< std::string >(
+                  "DensityGridWriterFields:" + prop_name + " precision",
+                  "double"));
+          if (_field_precision[property] ==
+                  DENSITYGRIDFIELDPRECISION_QUANTISED ||
+              _field_precision[property] ==
+                  DENSITYGRIDFIELDPRECISION_SIGNIFICANT) {
+            // there is no sensible default for the number of digits: an
+            // absolute precision that works for a temperature removes all
+            // information from a neutral fraction
+            const std::string digits_name =
+                "DensityGridWriterFields:" + prop_name +
+                ((_field_precision[property] ==
+                  DENSITYGRIDFIELDPRECISION_QUANTISED)
+                     ? " decimal digits"
+                     : " significant digits");
+            if (!params.has_value(digits_name)) {
+              cmac_error("No value given for \"%s\"!", digits_name.c_str());
+            }
+            _field_decimal_digits[property] =
+                params.get_value< uint_fast8_t >(digits_name);
+            if (_field_decimal_digits[property] == 0) {
+              cmac_error("\"%s\" should be at least 1!",
+                         digits_name.c_str());
+            }
+          }
+        }
       } else {
         _field_flag[property] = false;
+        _field_precision[property] = DENSITYGRIDFIELDPRECISION_DOUBLE;
+        _field_decimal_digits[property] = 0;
       }
     }
   }
@@ -882,6 +987,60 @@ public:
   inline uint_fast32_t get_field_count(const int_fast32_t type) const {
     return _field_count[type];
   }
+
+  /**
+   * @brief Get the precision with which the given field should be output.
+   *
+   * @param field_name DensityGridField.
+   * @return DensityGridFieldPrecision for the field.
+   */
+  inline int_fast32_t get_field_precision(const int_fast32_t field_name) const {
+    return _field_precision[field_name];
+  }
+
+  /**
+   * @brief Get the number of decimal digits that is kept for the given
+   * quantised field, or the number of significant digits that is kept for the
+   * given significant field.
+   *
+   * @param field_name DensityGridField.
+   * @return Number of decimal or significant digits.
+   */
+  inline uint_fast8_t
+  get_field_decimal_digits(const int_fast32_t field_name) const {
+    return _field_decimal_digits[field_name];
+  }
+
+  /**
+   * @brief Set the precision with which the given field should be output.
+   *
+   * @param field_name DensityGridField.
+   * @param precision DensityGridFieldPrecision.
+   * @param decimal_digits Number of decimal digits that is kept if the field
+   * is quantised, or number of significant digits that is kept if the field is
+   * significant (required for both).
+   */
+  inline void set_field_precision(const int_fast32_t field_name,
+                                  const int_fast32_t precision,
+                                  const uint_fast8_t decimal_digits = 0) {
+    cmac_assert_message(
+        decimal_digits > 0 ||
+            (precision != DENSITYGRIDFIELDPRECISION_QUANTISED &&
+             precision != DENSITYGRIDFIELDPRECISION_SIGNIFICANT),
+        "No number of digits given for a reduced precision field!");
+    _field_precision[field_name] = precision;
+    _field_decimal_digits[field_name] = decimal_digits;
+  }
+
+  /**
+   * @brief Disable output for the given field.
+   *
+   * @param field_name DensityGridField.
+   */
+  inline void disable_field(const int_fast32_t field_name) {
+    _field_count[get_type(field_name)] -= bit_count(_field_flag[field_name]);
+    _field_flag[field_name] = 0;
+  }
 };
 
 #endif // DENSITYGRIDWRITERFIELDS_HPP
@@ -48,6 +48,7 @@
 #include <cmath>
 #include <iostream>
 #include <ostream>
+#include <vector>
 
 #ifdef HAVE_MPI
 #include <mpi.h>
@@ -61,6 +62,10 @@ class DensityValues;
 /*! @brief Enable this to activate cell locking. */
 //#define SUBGRID_CELL_LOCK
 
+/*! @brief Number of photon packets that are traversed in lockstep by
+ *  DensitySubGrid::interact_batch(). */
+#define DENSITYSUBGRID_BATCH_SIZE 8
+
 /**
  * @brief Variables needed for cell locking.
  */
@@ -119,12 +124,19 @@ class DensityValues;
    4 * sizeof(int_least32_t) +                                                 \
    TRAVELDIRECTION_NUMBER * sizeof(uint_least32_t))
 
+/*! @brief Number of cell variables that are communicated for every cell: the
+ *  number density, the temperature, the ionic fractions, the mean intensities
+ *  and the heating terms. */
+#define DENSITYSUBGRID_CELL_MPI_NUMBER                                         \
+  (2 + 2 * NUMBER_OF_IONNAMES + NUMBER_OF_HEATINGTERMS)
+
 /*! @brief Size of all DensitySubGrid variables whose size is known at compile
  *  time. */
 #define DENSITYSUBGRID_FIXED_SIZE sizeof(DensitySubGrid)
 
 /*! @brief Size of a single cell of the subgrid. */
-#define DENSITYSUBGRID_ELEMENT_SIZE sizeof(IonizationVariables)
+#define DENSITYSUBGRID_ELEMENT_SIZE                                            \
+  (sizeof(IonizationVariables) + NUMBER_OF_TRAVERSALINPUTS * sizeof(double))
 
 /**
  * @brief Small fraction of a density grid that acts as an individual density
@@ -186,14 +198,64 @@ protected:
   /*! @brief Size of the largest active buffer. */
   uint_least32_t _largest_buffer_size;
 
+  /*! @brief Whether or not any of the cells has a tracker. */
+  bool _has_trackers;
+
   /// PHOTOIONIZATION VARIABLES
 
-  /*! @brief Ionization calculation variables. */
+  /**
+   * @brief Number density and ionic fractions of all cells.
+   *
+   * These are read during every photon traversal step and are stored as
+   * NUMBER_OF_TRAVERSALINPUTS arrays with one element per cell, in the order
+   * set by TraversalInputOffset.
+   */
+  double *_traversal_inputs;
+
+  /*! @brief Ionization calculation variables. The number density and ionic
+   *  fractions of each cell are stored in _traversal_inputs. */
   IonizationVariables *_ionization_variables;
 
   /*! @brief Cell locks (if active). */
   subgrid_cell_lock_variables();
 
+  /**
+   * @brief Allocate the cell variables for the given number of cells.
+   *
+   * @param number_of_cells Number of cells.
+   */
+  inline void allocate_cell_variables(const int_fast32_t number_of_cells) {
+    _traversal_inputs = new double[NUMBER_OF_TRAVERSALINPUTS * number_of_cells];
+    _ionization_variables = new IonizationVariables[number_of_cells];
+    for (int_fast32_t i = 0; i < number_of_cells; ++i) {
+      _ionization_variables[i].set_traversal_inputs(&_traversal_inputs[i],
+                                                    number_of_cells);
+    }
+  }
+
+  /**
+   * @brief Free the cell variables.
+   */
+  inline void free_cell_variables() {
+    delete[] _ionization_variables;
+    delete[] _traversal_inputs;
+  }
+
+  /**
+   * @brief Get the traversal input with the given offset for the cell with
+   * the given index.
+   *
+   * @param cell Index of the cell.
+   * @param offset TraversalInputOffset.
+   * @return Value of the traversal input.
+   */
+  inline double get_traversal_input(const int_fast32_t cell,
+                                    const int_fast32_t offset) const {
+    return _traversal_inputs[offset * _number_of_cells[0] *
+                                 _number_of_cells[3] +
+                             cell];
+  }
+
   /**
    * @brief Convert the given 3 indices to a single index.
    *
@@ -546,39 +608,61 @@ protected:
   }
 
   /**
-   * @brief Get the optical depth corresponding to the given distance for the
-   * given photon packet and cell.
+   * @brief Get the optical depth corresponding to the given distance through
+   * the given cell, for the given photoionization cross sections.
    *
    * @param active_cell Index of the cell.
    * @param distance Distance travelled through the cell (in m).
-   * @param photon Photon packet that travels through the cell.
+   * @param sigma_H Photoionization cross section for hydrogen (in m^2).
+   * @param sigma_He Photoionization cross section for helium (in m^2; only
+   * used if HAS_HELIUM is defined).
    * @return Corresponding optical depth.
    */
   inline double get_optical_depth(const int_fast32_t active_cell,
-                                  const double distance,
-                                  const PhotonPacket &photon) const {
+                                  const double distance, const double sigma_H,
+                                  const double sigma_He) const {
+    const double number_density =
+        get_traversal_input(active_cell, TRAVERSALINPUT_NUMBER_DENSITY);
+    const double xH = get_traversal_input(
+        active_cell, TRAVERSALINPUT_IONIC_FRACTION + ION_H_n);
 #ifdef HAS_HELIUM
+    const double xHe = get_traversal_input(
+        active_cell, TRAVERSALINPUT_IONIC_FRACTION + ION_He_n);
 #ifdef VARIABLE_ABUNDANCES
-    return distance * _ionization_variables[active_cell].get_number_density() *
-           (photon.get_photoionization_cross_section(ION_H_n) *
-                _ionization_variables[active_cell].get_ionic_fraction(ION_H_n) +
+    return distance * number_density *
+           (sigma_H * xH +
             _ionization_variables[active_cell].get_abundances().get_abundance(
                 ELEMENT_He) *
-                photon.get_photoionization_cross_section(ION_He_n) *
-                _ionization_variables[active_cell].get_ionic_fraction(
-                    ION_He_n));
+                sigma_He * xHe);
+#else
+    return distance * number_density * (sigma_H * xH + sigma_He * xHe);
+#endif
 #else
-    return distance * _ionization_variables[active_cell].get_number_density() *
-           (photon.get_photoionization_cross_section(ION_H_n) *
-                _ionization_variables[active_cell].get_ionic_fraction(ION_H_n) +
-            photon.get_photoionization_cross_section(ION_He_n) *
-                _ionization_variables[active_cell].get_ionic_fraction(
-                    ION_He_n));
+    return distance * number_density * sigma_H * xH;
 #endif
+  }
+
+  /**
+   * @brief Get the optical depth corresponding to the given distance for the
+   * given photon packet and cell.
+   *
+   * @param active_cell Index of the cell.
+   * @param distance Distance travelled through the cell (in m).
+   * @param photon Photon packet that travels through the cell.
+   * @return Corresponding optical depth.
+   */
+  inline double get_optical_depth(const int_fast32_t active_cell,
+                                  const double distance,
+                                  const PhotonPacket &photon) const {
+#ifdef HAS_HELIUM
+    return get_optical_depth(
+        active_cell, distance,
+        photon.get_photoionization_cross_section(ION_H_n),
+        photon.get_photoionization_cross_section(ION_He_n));
 #else
-    return distance * _ionization_variables[active_cell].get_number_density() *
-           photon.get_photoionization_cross_section(ION_H_n) *
-           _ionization_variables[active_cell].get_ionic_fraction(ION_H_n);
+    return get_optical_depth(active_cell, distance,
+                             photon.get_photoionization_cross_section(ION_H_n),
+                             0.);
 #endif
   }
 
@@ -611,14 +695,152 @@ protected:
         dmean_intensity[ION_He_n] * (photon.get_energy() - 5.948e15));
 #endif
 
-    Tracker *tracker = _ionization_variables[active_cell].get_tracker();
-    if (tracker != nullptr) {
-      tracker->count_photon(photon, dmean_intensity);
+    if (_has_trackers) {
+      Tracker *tracker = _ionization_variables[active_cell].get_tracker();
+      if (tracker != nullptr) {
+        tracker->count_photon(photon, dmean_intensity);
+      }
     }
 
     subgrid_cell_lock_unlock(active_cell);
   }
 
+  /**
+   * @brief Update the intensity counters with the contributions of all batch
+   * lanes that moved through a cell during the last traversal step.
+   *
+   * Lanes that moved through the same cell are merged into a single update of
+   * that cell.
+   *
+   * @param lane_moved Flags indicating which lanes moved during the last step.
+   * @param lane_cell Index of the cell each lane moved through.
+   * @param lane_distance Distance each lane travelled through its cell (in m).
+   * @param lane_photon Index of the photon packet in each lane.
+   * @param photons Photon packets.
+   */
+  inline void
+  update_intensity_counters(const bool *lane_moved,
+                            const int_fast32_t *lane_cell,
+                            const double *lane_distance,
+                            const uint_fast32_t *lane_photon,
+                            const PhotonPacket *photons) {
+
+    bool lane_done[DENSITYSUBGRID_BATCH_SIZE];
+    for (uint_fast32_t ilane = 0; ilane < DENSITYSUBGRID_BATCH_SIZE; ++ilane) {
+      lane_done[ilane] = !lane_moved[ilane];
+    }
+    for (uint_fast32_t ilane = 0; ilane < DENSITYSUBGRID_BATCH_SIZE; ++ilane) {
+      if (lane_done[ilane]) {
+        continue;
+      }
+      const int_fast32_t active_cell = lane_cell[ilane];
+      double dmean_intensity[NUMBER_OF_IONNAMES];
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        dmean_intensity[ion] = 0.;
+      }
+      double heating_H = 0.;
+#ifdef HAS_HELIUM
+      double heating_He = 0.;
+#endif
+      uint_fast32_t cell_lanes[DENSITYSUBGRID_BATCH_SIZE];
+      uint_fast32_t number_of_cell_lanes = 0;
+      for (uint_fast32_t jlane = ilane; jlane < DENSITYSUBGRID_BATCH_SIZE;
+           ++jlane) {
+        if (lane_done[jlane] || lane_cell[jlane] != active_cell) {
+          continue;
+        }
+        lane_done[jlane] = true;
+        cell_lanes[number_of_cell_lanes] = jlane;
+        ++number_of_cell_lanes;
+        const PhotonPacket &photon = photons[lane_photon[jlane]];
+        double dmean_intensity_lane[NUMBER_OF_IONNAMES];
+        for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+          dmean_intensity_lane[ion] =
+              lane_distance[jlane] *
+              photon.get_photoionization_cross_section(ion) *
+              photon.get_weight();
+          dmean_intensity[ion] += dmean_intensity_lane[ion];
+        }
+        heating_H +=
+            dmean_intensity_lane[ION_H_n] * (photon.get_energy() - 3.288e15);
+#ifdef HAS_HELIUM
+        heating_He +=
+            dmean_intensity_lane[ION_He_n] * (photon.get_energy() - 5.948e15);
+#endif
+      }
+
+      subgrid_cell_lock_lock(active_cell);
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        _ionization_variables[active_cell].increase_mean_intensity(
+            ion, dmean_intensity[ion]);
+      }
+      _ionization_variables[active_cell].increase_heating(HEATINGTERM_H,
+                                                          heating_H);
+#ifdef HAS_HELIUM
+      _ionization_variables[active_cell].increase_heating(HEATINGTERM_He,
+                                                          heating_He);
+#endif
+      // trackers are not thread safe, so they are updated under the same
+      // lock as the counters
+      Tracker *tracker =
+          _has_trackers ? _ionization_variables[active_cell].get_tracker()
+                        : nullptr;
+      if (tracker != nullptr) {
+        for (uint_fast32_t icell_lane = 0; icell_lane < number_of_cell_lanes;
+             ++icell_lane) {
+          const uint_fast32_t jlane = cell_lanes[icell_lane];
+          const PhotonPacket &photon = photons[lane_photon[jlane]];
+          double dmean_intensity_lane[NUMBER_OF_IONNAMES];
+          for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+            dmean_intensity_lane[ion] =
+                lane_distance[jlane] *
+                photon.get_photoionization_cross_section(ion) *
+                photon.get_weight();
+          }
+          tracker->count_photon(photon, dmean_intensity_lane);
+        }
+      }
+      subgrid_cell_lock_unlock(active_cell);
+    }
+  }
+
+  /**
+   * @brief Store the final state of a photon packet that finished its
+   * traversal through this subgrid.
+   *
+   * @param photon Photon packet.
+   * @param position Final position of the photon packet, relative w.r.t. the
+   * anchor of the subgrid (in m).
+   * @param three_index Final 3 index of the photon packet.
+   * @param tau_done Optical depth covered in this subgrid.
+   * @param tau_target Target optical depth upon entering this subgrid.
+   * @param direction Direction of the photon packet.
+   * @return TravelDirection of the photon after it has traversed this grid.
+   */
+  inline int_fast32_t
+  finalize_photon(PhotonPacket &photon, const CoordinateVector<> position,
+                  const CoordinateVector< int_fast32_t > three_index,
+                  const double tau_done, const double tau_target,
+                  const CoordinateVector<> direction) const {
+    // update photon quantities
+    photon.set_target_optical_depth(tau_target - tau_done);
+    photon.set_position(position + _anchor);
+    // get the outgoing direction
+    int_fast32_t output_direction;
+    if (tau_done >= tau_target) {
+      output_direction = TRAVELDIRECTION_INSIDE;
+    } else {
+      output_direction = get_output_direction(three_index);
+    }
+
+    cmac_assert_message(TravelDirections::is_compatible_output_direction(
+                            direction, output_direction),
+                        "wrong output direction!");
+    (void)direction;
+
+    return output_direction;
+  }
+
 public:
   /**
    * @brief Get the index (and 3 index) of the cell containing the given
@@ -741,7 +963,7 @@ public:
         _inv_cell_size{ncell[0] / box[3], ncell[1] / box[4], ncell[2] / box[5]},
         _number_of_cells{ncell[0], ncell[1], ncell[2], ncell[1] * ncell[2]},
         _owning_thread(0), _largest_buffer_index(TRAVELDIRECTION_NUMBER),
-        _largest_buffer_size(0) {
+        _largest_buffer_size(0), _has_trackers(false) {
 
 #ifdef DENSITYGRID_EDGECOST
     // initialize edge communication costs
@@ -752,7 +974,7 @@ public:
 
     // allocate memory for data arrays
     const int_fast32_t tot_ncell = _number_of_cells[3] * ncell[0];
-    _ionization_variables = new IonizationVariables[tot_ncell];
+    allocate_cell_variables(tot_ncell);
     subgrid_cell_lock_init(tot_ncell);
   }
 
@@ -769,7 +991,8 @@ public:
             original._number_of_cells[0], original._number_of_cells[1],
             original._number_of_cells[2], original._number_of_cells[3]},
         _owning_thread(original._owning_thread),
-        _largest_buffer_index(TRAVELDIRECTION_NUMBER), _largest_buffer_size(0) {
+        _largest_buffer_index(TRAVELDIRECTION_NUMBER), _largest_buffer_size(0),
+        _has_trackers(false) {
 
 #ifdef DENSITYGRID_EDGECOST
     // initialize edge communication costs
@@ -779,7 +1002,7 @@ public:
 #endif
 
     const int_fast32_t tot_ncell = _number_of_cells[3] * _number_of_cells[0];
-    _ionization_variables = new IonizationVariables[tot_ncell];
+    allocate_cell_variables(tot_ncell);
     subgrid_cell_lock_init(tot_ncell);
 
     // copy data arrays
@@ -793,7 +1016,7 @@ public:
    */
   virtual ~DensitySubGrid() {
     // deallocate data arrays
-    delete[] _ionization_variables;
+    free_cell_variables();
     subgrid_cell_lock_destroy();
   }
 
@@ -983,11 +1206,20 @@ public:
     const int_fast32_t tot_num_cells =
         _number_of_cells[0] * _number_of_cells[3];
     for (int_fast32_t i = 0; i < tot_num_cells; ++i) {
-      double vals[3] = {_ionization_variables[i].get_number_density(),
-                        _ionization_variables[i].get_ionic_fraction(ION_H_n),
-                        _ionization_variables[i].get_mean_intensity(ION_H_n)};
-      MPI_Pack(vals, 3, MPI_DOUBLE, buffer, buffer_size, &buffer_position,
-               MPI_COMM_WORLD);
+      const IonizationVariables &vars = _ionization_variables[i];
+      double vals[DENSITYSUBGRID_CELL_MPI_NUMBER];
+      vals[0] = vars.get_number_density();
+      vals[1] = vars.get_temperature();
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        vals[2 + ion] = vars.get_ionic_fraction(ion);
+        vals[2 + NUMBER_OF_IONNAMES + ion] = vars.get_mean_intensity(ion);
+      }
+      for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
+           ++heating) {
+        vals[2 + 2 * NUMBER_OF_IONNAMES + heating] = vars.get_heating(heating);
+      }
+      MPI_Pack(vals, DENSITYSUBGRID_CELL_MPI_NUMBER, MPI_DOUBLE, buffer,
+               buffer_size, &buffer_position, MPI_COMM_WORLD);
     }
   }
 
@@ -1037,16 +1269,24 @@ public:
       _number_of_cells[1] = new_number_of_cells[1];
       _number_of_cells[2] = new_number_of_cells[2];
       _number_of_cells[3] = new_number_of_cells[3];
-      delete[] _ionization_variables;
-      _ionization_variables = new IonizationVariables[tot_num_cells];
+      free_cell_variables();
+      allocate_cell_variables(tot_num_cells);
     }
     for (int_fast32_t i = 0; i < tot_num_cells; ++i) {
-      double vals[3];
-      MPI_Unpack(buffer, buffer_size, &buffer_position, vals, 3, MPI_DOUBLE,
-                 MPI_COMM_WORLD);
-      _ionization_variables[i].set_number_density(vals[0]);
-      _ionization_variables[i].set_ionic_fraction(ION_H_n, vals[1]);
-      _ionization_variables[i].set_mean_intensity(ION_H_n, vals[2]);
+      double vals[DENSITYSUBGRID_CELL_MPI_NUMBER];
+      MPI_Unpack(buffer, buffer_size, &buffer_position, vals,
+                 DENSITYSUBGRID_CELL_MPI_NUMBER, MPI_DOUBLE, MPI_COMM_WORLD);
+      IonizationVariables &vars = _ionization_variables[i];
+      vars.set_number_density(vals[0]);
+      vars.set_temperature(vals[1]);
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        vars.set_ionic_fraction(ion, vals[2 + ion]);
+        vars.set_mean_intensity(ion, vals[2 + NUMBER_OF_IONNAMES + ion]);
+      }
+      for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
+           ++heating) {
+        vars.set_heating(heating, vals[2 + 2 * NUMBER_OF_IONNAMES + heating]);
+      }
     }
   }
 #endif
@@ -1255,22 +1495,252 @@ public:
       // update the cell index
       active_cell = get_one_index(three_index);
     }
-    // update photon quantities
-    photon.set_target_optical_depth(tau_target - tau_done);
-    photon.set_position(position + _anchor);
-    // get the outgoing direction
-    int_fast32_t output_direction;
-    if (tau_done >= tau_target) {
-      output_direction = TRAVELDIRECTION_INSIDE;
-    } else {
-      output_direction = get_output_direction(three_index);
+    return finalize_photon(photon, position, three_index, tau_done,
+                           tau_target, direction);
+  }
+
+  /**
+   * @brief Let the given photon packets travel through the density grid.
+   *
+   * The photon packets are traversed in lockstep, in DENSITYSUBGRID_BATCH_SIZE
+   * lanes. A lane whose photon packet is absorbed or leaves the subgrid is
+   * refilled with the next photon packet. The wall distance and optical depth
+   * computations are done for all lanes at once in a branch-free loop that
+   * can be vectorised by the compiler, and intensity counter updates for lanes
+   * that move through the same cell are merged.
+   *
+   * The arithmetic for an individual photon packet is the same as in
+   * interact(), so that photon packets end up in the same state. The order in
+   * which contributions are added to the intensity counters however differs.
+   * In verification mode, contributions are stored and added afterwards in
+   * the same order as interact() would add them, so that the result is
+   * bit-compatible with the scalar traversal (unless the compiler is allowed
+   * to reorder floating point operations, e.g. with -ffast-math).
+   *
+   * @param photons Photon packets.
+   * @param number_of_photons Number of photon packets.
+   * @param input_direction Direction from which the photons enter the grid.
+   * @param output_directions Array to store the TravelDirection of each photon
+   * after it has traversed this grid in (of size number_of_photons).
+   * @param verify Whether or not to run in verification mode.
+   */
+  inline void interact_batch(PhotonPacket *photons,
+                             const uint_fast32_t number_of_photons,
+                             const int_fast32_t input_direction,
+                             int_fast32_t *output_directions,
+                             const bool verify = false) {
+
+    cmac_assert_message(input_direction >= 0 &&
+                            input_direction < TRAVELDIRECTION_NUMBER,
+                        "input_direction: %" PRIiFAST32, input_direction);
+
+    // lane variables
+    uint_fast32_t lane_photon[DENSITYSUBGRID_BATCH_SIZE];
+    bool lane_active[DENSITYSUBGRID_BATCH_SIZE];
+    int_fast32_t lane_cell[DENSITYSUBGRID_BATCH_SIZE];
+    int_fast32_t lane_index[3][DENSITYSUBGRID_BATCH_SIZE];
+    double lane_position[3][DENSITYSUBGRID_BATCH_SIZE];
+    double lane_direction[3][DENSITYSUBGRID_BATCH_SIZE];
+    double lane_inverse_direction[3][DENSITYSUBGRID_BATCH_SIZE];
+    double lane_tau_done[DENSITYSUBGRID_BATCH_SIZE];
+    double lane_tau_target[DENSITYSUBGRID_BATCH_SIZE];
+    double lane_sigma_H[DENSITYSUBGRID_BATCH_SIZE];
+    double lane_sigma_He[DENSITYSUBGRID_BATCH_SIZE];
+    // variables for a single traversal step
+    double lane_wall[3][DENSITYSUBGRID_BATCH_SIZE];
+    double lane_l[3][DENSITYSUBGRID_BATCH_SIZE];
+    double lane_lmin[DENSITYSUBGRID_BATCH_SIZE];
+    double lane_tau[DENSITYSUBGRID_BATCH_SIZE];
+    bool lane_moved[DENSITYSUBGRID_BATCH_SIZE];
+    int_fast32_t lane_step_cell[DENSITYSUBGRID_BATCH_SIZE];
+
+    // path segments of each photon packet (only used in verification mode)
+    std::vector< std::vector< std::pair< int_fast32_t, double > > > path;
+    if (verify) {
+      path.resize(number_of_photons);
     }
 
-    cmac_assert_message(TravelDirections::is_compatible_output_direction(
-                            direction, output_direction),
-                        "wrong output direction!");
+    for (uint_fast32_t ilane = 0; ilane < DENSITYSUBGRID_BATCH_SIZE; ++ilane) {
+      lane_active[ilane] = false;
+      lane_photon[ilane] = 0;
+      lane_cell[ilane] = 0;
+      lane_step_cell[ilane] = 0;
+      for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+        lane_index[idim][ilane] = 0;
+        lane_position[idim][ilane] = 0.;
+        lane_direction[idim][ilane] = 0.;
+        lane_inverse_direction[idim][ilane] = 0.;
+      }
+      lane_tau_done[ilane] = 0.;
+      lane_tau_target[ilane] = 0.;
+      lane_sigma_H[ilane] = 0.;
+      lane_sigma_He[ilane] = 0.;
+    }
 
-    return output_direction;
+    uint_fast32_t next_photon = 0;
+    bool any_active = true;
+    while (any_active) {
+
+      // (re)fill inactive lanes, using the same initialisation as interact()
+      for (uint_fast32_t ilane = 0; ilane < DENSITYSUBGRID_BATCH_SIZE;
+           ++ilane) {
+        while (!lane_active[ilane] && next_photon < number_of_photons) {
+
+          const uint_fast32_t iphoton = next_photon;
+          ++next_photon;
+          PhotonPacket &photon = photons[iphoton];
+
+          const CoordinateVector<> direction = photon.get_direction();
+
+          cmac_assert_message(
+              TravelDirections::is_compatible_input_direction(direction,
+                                                              input_direction),
+              "direction: %g %g %g, input_direction: %" PRIiFAST32,
+              direction[0], direction[1], direction[2], input_direction);
+
+          const CoordinateVector<> inverse_direction = 1. / direction;
+          CoordinateVector<> position = photon.get_position() - _anchor;
+          const double tau_target = photon.get_target_optical_depth();
+
+          cmac_assert_message(0. < tau_target, "tau_done: 0, target: %g",
+                              tau_target);
+
+          update_photon_position(input_direction, position);
+          CoordinateVector< int_fast32_t > three_index;
+          const int_fast32_t active_cell =
+              get_start_index(position, input_direction, three_index);
+
+          if (!(0. < tau_target && is_inside(three_index))) {
+            output_directions[iphoton] = finalize_photon(
+                photon, position, three_index, 0., tau_target, direction);
+            continue;
+          }
+
+          lane_active[ilane] = true;
+          lane_photon[ilane] = iphoton;
+          lane_cell[ilane] = active_cell;
+          for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+            lane_index[idim][ilane] = three_index[idim];
+            lane_position[idim][ilane] = position[idim];
+            lane_direction[idim][ilane] = direction[idim];
+            lane_inverse_direction[idim][ilane] = inverse_direction[idim];
+          }
+          lane_tau_done[ilane] = 0.;
+          lane_tau_target[ilane] = tau_target;
+          lane_sigma_H[ilane] =
+              photon.get_photoionization_cross_section(ION_H_n);
+#ifdef HAS_HELIUM
+          lane_sigma_He[ilane] =
+              photon.get_photoionization_cross_section(ION_He_n);
+#else
+          lane_sigma_He[ilane] = 0.;
+#endif
+        }
+      }
+
+      // compute the wall distances and optical depths for all lanes
+      // inactive lanes use a dummy cell index, so that this loop does not
+      // need any branches
+      for (uint_fast32_t ilane = 0; ilane < DENSITYSUBGRID_BATCH_SIZE;
+           ++ilane) {
+        for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+          const double cell_low = lane_index[idim][ilane] * _cell_size[idim];
+          const double cell_high =
+              (lane_index[idim][ilane] + 1.) * _cell_size[idim];
+          const double direction = lane_direction[idim][ilane];
+          lane_wall[idim][ilane] = (direction > 0.) ? cell_high : cell_low;
+          const double l =
+              (lane_wall[idim][ilane] - lane_position[idim][ilane]) *
+              lane_inverse_direction[idim][ilane];
+          lane_l[idim][ilane] = (direction != 0.) ? l : DBL_MAX;
+        }
+        lane_lmin[ilane] = std::min(
+            lane_l[0][ilane], std::min(lane_l[1][ilane], lane_l[2][ilane]));
+        const int_fast32_t cell = lane_active[ilane] ? lane_cell[ilane] : 0;
+        lane_tau[ilane] = get_optical_depth(
+            cell, lane_lmin[ilane], lane_sigma_H[ilane], lane_sigma_He[ilane]);
+      }
+
+      // advance the active lanes
+      any_active = false;
+      for (uint_fast32_t ilane = 0; ilane < DENSITYSUBGRID_BATCH_SIZE;
+           ++ilane) {
+        lane_moved[ilane] = lane_active[ilane];
+        if (!lane_active[ilane]) {
+          continue;
+        }
+
+        cmac_assert_message(lane_lmin[ilane] >= 0., "lmin: %g",
+                            lane_lmin[ilane]);
+
+        double lmin = lane_lmin[ilane];
+        const double tau = lane_tau[ilane];
+        lane_tau_done[ilane] += tau;
+        if (lane_tau_done[ilane] >= lane_tau_target[ilane]) {
+          const double correction =
+              (lane_tau_done[ilane] - lane_tau_target[ilane]) / tau;
+          lmin *= (1. - correction);
+        } else {
+          for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+            if (lane_l[idim][ilane] == lmin) {
+              lane_index[idim][ilane] +=
+                  (lane_direction[idim][ilane] > 0.) ? 1 : -1;
+            }
+          }
+        }
+        lane_step_cell[ilane] = lane_cell[ilane];
+        lane_lmin[ilane] = lmin;
+        if (verify) {
+          path[lane_photon[ilane]].push_back(
+              std::make_pair(lane_cell[ilane], lmin));
+        }
+        for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+          lane_position[idim][ilane] =
+              (lane_l[idim][ilane] == lmin)
+                  ? lane_wall[idim][ilane]
+                  : lane_position[idim][ilane] +
+                        lmin * lane_direction[idim][ilane];
+        }
+        const CoordinateVector< int_fast32_t > three_index(
+            lane_index[0][ilane], lane_index[1][ilane], lane_index[2][ilane]);
+        lane_cell[ilane] = get_one_index(three_index);
+
+        if (lane_tau_done[ilane] < lane_tau_target[ilane] &&
+            is_inside(three_index)) {
+          any_active = true;
+        } else {
+          const uint_fast32_t iphoton = lane_photon[ilane];
+          const CoordinateVector<> position(lane_position[0][ilane],
+                                            lane_position[1][ilane],
+                                            lane_position[2][ilane]);
+          const CoordinateVector<> direction(lane_direction[0][ilane],
+                                             lane_direction[1][ilane],
+                                             lane_direction[2][ilane]);
+          output_directions[iphoton] = finalize_photon(
+              photons[iphoton], position, three_index, lane_tau_done[ilane],
+              lane_tau_target[ilane], direction);
+          lane_active[ilane] = false;
+        }
+      }
+
+      if (!verify) {
+        update_intensity_counters(lane_moved, lane_step_cell, lane_lmin,
+                                  lane_photon, photons);
+      }
+
+      any_active = any_active || next_photon < number_of_photons;
+    }
+
+    if (verify) {
+      // add the intensity contributions in the scalar traversal order
+      for (uint_fast32_t iphoton = 0; iphoton < number_of_photons; ++iphoton) {
+        for (size_t istep = 0; istep < path[iphoton].size(); ++istep) {
+          update_intensity_counters(path[iphoton][istep].first,
+                                    path[iphoton][istep].second,
+                                    photons[iphoton]);
+        }
+      }
+    }
   }
 
   /**
@@ -1638,6 +2108,13 @@ public:
    */
   inline ThreadLock *get_dependency() { return &_dependency; }
 
+  /**
+   * @brief Signal that at least one cell of this subgrid has a tracker.
+   *
+   * Photon traversal only checks the cell trackers after this was called.
+   */
+  inline void enable_trackers() { _has_trackers = true; }
+
   /**
    * @brief Get the id of the thread that owns this subgrid.
    *
@@ -1700,13 +2177,26 @@ public:
               other._ionization_variables[i].get_number_density(),
           "Number density not the same!");
       cmac_assert_message(
-          _ionization_variables[i].get_ionic_fraction(ION_H_n) ==
-              other._ionization_variables[i].get_ionic_fraction(ION_H_n),
-          "Neutral fraction not the same!");
-      cmac_assert_message(
-          _ionization_variables[i].get_mean_intensity(ION_H_n) ==
-              other._ionization_variables[i].get_mean_intensity(ION_H_n),
-          "Intensity integral not the same!");
+          _ionization_variables[i].get_temperature() ==
+              other._ionization_variables[i].get_temperature(),
+          "Temperature not the same!");
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        cmac_assert_message(
+            _ionization_variables[i].get_ionic_fraction(ion) ==
+                other._ionization_variables[i].get_ionic_fraction(ion),
+            "Ionic fraction not the same!");
+        cmac_assert_message(
+            _ionization_variables[i].get_mean_intensity(ion) ==
+                other._ionization_variables[i].get_mean_intensity(ion),
+            "Intensity integral not the same!");
+      }
+      for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
+           ++heating) {
+        cmac_assert_message(_ionization_variables[i].get_heating(heating) ==
+                                other._ionization_variables[i].get_heating(
+                                    heating),
+                            "Heating term not the same!");
+      }
     }
   }
 
@@ -1964,9 +2454,10 @@ public:
     _owning_thread = restart_reader.read< int_least32_t >();
     _largest_buffer_index = TRAVELDIRECTION_NUMBER;
     _largest_buffer_size = 0;
+    _has_trackers = false;
     const int_fast32_t number_of_cells =
         _number_of_cells[0] * _number_of_cells[1] * _number_of_cells[2];
-    _ionization_variables = new IonizationVariables[number_of_cells];
+    allocate_cell_variables(number_of_cells);
     for (int_fast32_t i = 0; i < number_of_cells; ++i) {
       _ionization_variables[i] = IonizationVariables(restart_reader);
     }
@@ -27,16 +27,23 @@
 #ifndef DENSITYSUBGRIDCREATOR_HPP
 #define DENSITYSUBGRIDCREATOR_HPP
 
+#include "AMRRefinementScheme.hpp"
 #include "Box.hpp"
 #include "DensityFunction.hpp"
 #include "DensitySubGrid.hpp"
 #include "Error.hpp"
+#include "MPICommunicator.hpp"
 #include "OpenMP.hpp"
 #include "ParameterFile.hpp"
 
+#include <algorithm>
 #include <cinttypes>
 #include <vector>
 
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
 /**
  * @brief Class responsible for creating DensitySubGrid instances that make up
  * a larger grid.
@@ -68,6 +75,24 @@ private:
   /*! @brief Periodicity flags. */
   const CoordinateVector< bool > _periodicity;
 
+  /*! @brief Maximum refinement level of a single subgrid. */
+  const uint_fast8_t _maximum_refinement_level;
+
+  /*! @brief Refinement level of each original subgrid. A subgrid on level
+   *  \f$l\f$ has \f$2^l\f$ times more cells in each coordinate direction
+   *  than a subgrid on level 0, but covers the same volume. */
+  std::vector< uint_fast8_t > _refinement_levels;
+
+  /*! @brief Rank of the MPI process that owns each original subgrid (empty if
+   *  the grid is not distributed over multiple processes). */
+  std::vector< int_fast32_t > _subgrid_ranks;
+
+  /*! @brief Rank of the local MPI process. */
+  int_fast32_t _MPI_rank;
+
+  /*! @brief Total number of MPI processes. */
+  int_fast32_t _MPI_size;
+
 public:
   /**
    * @brief Constructor.
@@ -76,11 +101,14 @@ public:
    * @param number_of_cells Number of cells in each coordinate direction.
    * @param number_of_subgrids Number of subgrids in each coordinate direction.
    * @param periodicity Periodicity flags.
+   * @param maximum_refinement_level Maximum refinement level of a single
+   * subgrid.
    */
   inline DensitySubGridCreator(
       const Box<> box, const CoordinateVector< int_fast32_t > number_of_cells,
       const CoordinateVector< int_fast32_t > number_of_subgrids,
-      const CoordinateVector< bool > periodicity)
+      const CoordinateVector< bool > periodicity,
+      const uint_fast8_t maximum_refinement_level = 0)
       : _box(box), _subgrid_sides(box.get_sides()[0] / number_of_subgrids[0],
                                   box.get_sides()[1] / number_of_subgrids[1],
                                   box.get_sides()[2] / number_of_subgrids[2]),
@@ -89,7 +117,9 @@ public:
         _subgrid_number_of_cells(number_of_cells[0] / number_of_subgrids[0],
                                  number_of_cells[1] / number_of_subgrids[1],
                                  number_of_cells[2] / number_of_subgrids[2]),
-        _periodicity(periodicity) {
+        _periodicity(periodicity),
+        _maximum_refinement_level(maximum_refinement_level), _MPI_rank(0),
+        _MPI_size(1) {
 
     for (uint_fast8_t i = 0; i < 3; ++i) {
       if (number_of_cells[i] % number_of_subgrids[i] != 0) {
@@ -101,6 +131,7 @@ public:
                          _number_of_subgrids[2],
                      nullptr);
     _copies.resize(_subgrids.size(), 0xffffffff);
+    _refinement_levels.resize(_subgrids.size(), 0);
   }
 
   /**
@@ -111,6 +142,9 @@ public:
    *    direction (default: [64, 64, 64])
    *  - number of subgrids: number of subgrids in each coordinate direction
    *    (default: [8, 8, 8])
+   *  - periodicity: periodicity flags (default: [false, false, false])
+   *  - maximum refinement level: maximum refinement level of a single subgrid
+   *    when an AMRRefinementScheme is passed on to initialize() (default: 3)
    *
    * @param box Dimensions of the simulation box (in m).
    * @param params ParameterFile to read from.
@@ -126,7 +160,9 @@ public:
                 CoordinateVector< int_fast32_t >(8)),
             params.get_value< CoordinateVector< bool > >(
                 "DensitySubGridCreator:periodicity",
-                CoordinateVector< bool >(false))) {}
+                CoordinateVector< bool >(false)),
+            params.get_value< uint_fast8_t >(
+                "DensitySubGridCreator:maximum refinement level", 3)) {}
 
   /**
    * @brief Destructor.
@@ -162,8 +198,42 @@ public:
    * @return Total number of cells.
    */
   inline uint_fast64_t number_of_cells() const {
-    return number_of_original_subgrids() * _subgrid_number_of_cells.x() *
-           _subgrid_number_of_cells.y() * _subgrid_number_of_cells.z();
+    const uint_fast64_t base_number_of_cells = _subgrid_number_of_cells.x() *
+                                               _subgrid_number_of_cells.y() *
+                                               _subgrid_number_of_cells.z();
+    uint_fast64_t total_number_of_cells = 0;
+    for (size_t i = 0; i < _refinement_levels.size(); ++i) {
+      // every refinement level multiplies the number of cells by 8
+      total_number_of_cells += base_number_of_cells
+                               << (3 * _refinement_levels[i]);
+    }
+    return total_number_of_cells;
+  }
+
+  /**
+   * @brief Get the index of the first cell of each original subgrid within the
+   * entire grid.
+   *
+   * Subgrids on different refinement levels contain a different number of
+   * cells, so that the offset of a subgrid is the total number of cells in all
+   * subgrids that precede it. Combined with the index of a cell within its
+   * subgrid, this gives a cell index that is unique within the entire grid
+   * and smaller than number_of_cells().
+   *
+   * @return Offset of the first cell of each original subgrid.
+   */
+  inline std::vector< uint_fast64_t > get_cell_offsets() const {
+    const uint_fast64_t base_number_of_cells = _subgrid_number_of_cells.x() *
+                                               _subgrid_number_of_cells.y() *
+                                               _subgrid_number_of_cells.z();
+    std::vector< uint_fast64_t > cell_offsets(_refinement_levels.size(), 0);
+    for (size_t i = 1; i < _refinement_levels.size(); ++i) {
+      // every refinement level multiplies the number of cells by 8
+      cell_offsets[i] =
+          cell_offsets[i - 1] +
+          (base_number_of_cells << (3 * _refinement_levels[i - 1]));
+    }
+    return cell_offsets;
   }
 
   /**
@@ -178,12 +248,149 @@ public:
   /**
    * @brief Get the number of cells in each coordinate direction per subgrid.
    *
+   * For a refined grid, this is the number of cells in a subgrid on
+   * refinement level 0.
+   *
    * @return Number of cells in each coordinate direction per subgrid.
    */
   inline CoordinateVector< int_fast32_t > get_subgrid_cell_layout() const {
     return _subgrid_number_of_cells;
   }
 
+  /**
+   * @brief Get the refinement level of the subgrid with the given index.
+   *
+   * Copies have the same refinement level as their original.
+   *
+   * @param index Subgrid index (original or copy).
+   * @return Refinement level of the subgrid.
+   */
+  inline uint_fast8_t get_refinement_level(const size_t index) const {
+    if (index < _refinement_levels.size()) {
+      return _refinement_levels[index];
+    } else {
+      return _refinement_levels[_originals[index - _refinement_levels.size()]];
+    }
+  }
+
+  /**
+   * @brief Does the grid contain subgrids on different refinement levels?
+   *
+   * @return True if at least one subgrid is refined.
+   */
+  inline bool is_refined() const {
+    for (size_t i = 0; i < _refinement_levels.size(); ++i) {
+      if (_refinement_levels[i] > 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Distribute the original subgrids over the given number of MPI
+   * processes.
+   *
+   * Every process owns a contiguous block of original subgrids (a slab along
+   * the x axis) and all copies of these subgrids. Only the subgrids owned by
+   * the local process are allocated by initialize() and create_copies(). This
+   * function needs to be called before initialize().
+   *
+   * @param rank Rank of the local MPI process.
+   * @param size Total number of MPI processes.
+   */
+  inline void set_domain_decomposition(const int_fast32_t rank,
+                                       const int_fast32_t size) {
+
+    _MPI_rank = rank;
+    _MPI_size = size;
+    _subgrid_ranks.clear();
+    if (size > 1) {
+      const size_t number_of_originals = number_of_original_subgrids();
+      _subgrid_ranks.resize(number_of_originals, 0);
+      for (int_fast32_t irank = 0; irank < size; ++irank) {
+        const std::pair< size_t, size_t > block =
+            MPICommunicator::distribute_block(irank, size, 0,
+                                              number_of_originals);
+        for (size_t i = block.first; i < block.second; ++i) {
+          _subgrid_ranks[i] = irank;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Is the grid distributed over multiple MPI processes?
+   *
+   * @return True if subgrids are owned by different processes.
+   */
+  inline bool is_distributed() const { return !_subgrid_ranks.empty(); }
+
+  /**
+   * @brief Get the rank of the MPI process that owns the subgrid with the
+   * given index.
+   *
+   * Copies are owned by the process that owns their original.
+   *
+   * @param index Subgrid index (original or copy).
+   * @return Rank of the owning MPI process.
+   */
+  inline int_fast32_t get_rank(const size_t index) const {
+    if (_subgrid_ranks.empty()) {
+      return _MPI_rank;
+    }
+    if (index < _copies.size()) {
+      return _subgrid_ranks[index];
+    } else {
+      return _subgrid_ranks[_originals[index - _copies.size()]];
+    }
+  }
+
+  /**
+   * @brief Is the subgrid with the given index owned by the local process?
+   *
+   * @param index Subgrid index (original or copy).
+   * @return True if the subgrid is stored in local memory.
+   */
+  inline bool is_local(const size_t index) const {
+    return get_rank(index) == _MPI_rank;
+  }
+
+  /**
+   * @brief Get the rank of the local MPI process.
+   *
+   * @return Rank of the local MPI process.
+   */
+  inline int_fast32_t get_MPI_rank() const { return _MPI_rank; }
+
+  /**
+   * @brief Get the total number of MPI processes the grid is distributed over.
+   *
+   * @return Number of MPI processes.
+   */
+  inline int_fast32_t get_MPI_size() const { return _MPI_size; }
+
+  /**
+   * @brief Get the number of cells in the original subgrids that are owned by
+   * the local process.
+   *
+   * @return Number of local cells.
+   */
+  inline uint_fast64_t number_of_local_cells() const {
+    const std::vector< uint_fast64_t > cell_offsets = get_cell_offsets();
+    const uint_fast64_t total_number_of_cells = number_of_cells();
+    uint_fast64_t number_of_local_cells = 0;
+    for (size_t i = 0; i < cell_offsets.size(); ++i) {
+      if (is_local(i)) {
+        const uint_fast64_t next_offset = (i + 1 < cell_offsets.size())
+                                              ? cell_offsets[i + 1]
+                                              : total_number_of_cells;
+        number_of_local_cells += next_offset - cell_offsets[i];
+      }
+    }
+    return number_of_local_cells;
+  }
+
   /**
    * @brief Get the dimensions of the box containing the grid.
    *
@@ -328,8 +535,12 @@ public:
         _subgrid_sides[0],
         _subgrid_sides[1],
         _subgrid_sides[2]};
-    _subgrid_type_ *this_grid =
-        new _subgrid_type_(subgrid_box, _subgrid_number_of_cells);
+    const uint_fast8_t level = _refinement_levels[index];
+    const CoordinateVector< int_fast32_t > ncell(
+        _subgrid_number_of_cells[0] << level,
+        _subgrid_number_of_cells[1] << level,
+        _subgrid_number_of_cells[2] << level);
+    _subgrid_type_ *this_grid = new _subgrid_type_(subgrid_box, ncell);
     for (int_fast32_t i = 0; i < TRAVELDIRECTION_NUMBER; ++i) {
       this_grid->set_neighbour(i, NEIGHBOUR_OUTSIDE);
       this_grid->set_active_buffer(i, NEIGHBOUR_OUTSIDE);
@@ -377,9 +588,7 @@ public:
             //  - 0 --> in range --> inside
             //  - ncell --> upper limit
             const CoordinateVector< int_fast32_t > three_index(
-                nix * _subgrid_number_of_cells[0],
-                niy * _subgrid_number_of_cells[1],
-                niz * _subgrid_number_of_cells[2]);
+                nix * ncell[0], niy * ncell[1], niz * ncell[2]);
             const int_fast32_t ngbi =
                 this_grid->get_output_direction(three_index);
             // now get the actual ngb index
@@ -395,34 +604,143 @@ public:
     return this_grid;
   }
 
+  /**
+   * @brief Create the DensitySubGrid with the given index and initialize its
+   * cell variables using the given DensityFunction.
+   *
+   * @param index Index of the subgrid.
+   * @param density_function DensityFunction to use to initialize the cell
+   * variables.
+   * @return Pointer to a newly created DensitySubGrid instance. Memory
+   * management for the pointer is transferred to the caller.
+   */
+  inline _subgrid_type_ *
+  create_initialized_subgrid(const uint_fast32_t index,
+                             DensityFunction &density_function) const {
+
+    _subgrid_type_ *this_grid = create_subgrid(index);
+    for (auto it = this_grid->begin(); it != this_grid->end(); ++it) {
+      DensityValues values = density_function(it);
+      it.get_ionization_variables().set_number_density(
+          values.get_number_density());
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        it.get_ionization_variables().set_ionic_fraction(
+            ion, values.get_ionic_fraction(ion));
+      }
+      it.get_ionization_variables().set_temperature(values.get_temperature());
+      this_grid->initialize_hydro(it.get_index(), values);
+    }
+    return this_grid;
+  }
+
+  /**
+   * @brief Check if the given subgrid needs to be refined.
+   *
+   * @param subgrid Subgrid.
+   * @param level Current refinement level of the subgrid.
+   * @param refinement_scheme AMRRefinementScheme that decides which cells
+   * need to be refined.
+   * @return True if at least one cell of the subgrid needs to be refined.
+   */
+  inline static bool
+  needs_refinement(_subgrid_type_ &subgrid, const uint_fast8_t level,
+                   const AMRRefinementScheme &refinement_scheme) {
+
+    for (auto it = subgrid.begin(); it != subgrid.end(); ++it) {
+      if (refinement_scheme.refine(level, it)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   /**
    * @brief Initialize the subgrids that make up the grid.
    *
+   * If the grid is distributed, only the subgrids owned by the local process
+   * are created.
+   *
+   * If an AMRRefinementScheme is given, every subgrid is refined (up to the
+   * maximum refinement level) until the refinement scheme no longer wants to
+   * refine any of its cells. The refinement level of a cell that is passed on
+   * to the refinement scheme is the refinement level of its subgrid, so that
+   * the refinement levels have the same meaning as for an AMRDensityGrid with
+   * the same number of top level cells. Afterwards, we make sure that the
+   * refinement levels of neighbouring subgrids differ by at most one level,
+   * so that every cell at a level boundary borders exactly 4 cells on the
+   * other side. For a distributed grid, all processes need to call this
+   * function.
+   *
    * @param density_function DensityFunction to use to initialize the cell
    * variables.
+   * @param refinement_scheme AMRRefinementScheme used to decide on the
+   * refinement level of each subgrid (no refinement if nullptr).
    */
-  inline void initialize(DensityFunction &density_function) {
+  inline void
+  initialize(DensityFunction &density_function,
+             const AMRRefinementScheme *refinement_scheme = nullptr) {
     AtomicValue< size_t > igrid(0);
 #ifdef HAVE_OPENMP
 #pragma omp parallel default(shared)
 #endif
     while (igrid.value() < _subgrids.size()) {
       const size_t this_igrid = igrid.post_increment();
-      if (this_igrid < _subgrids.size()) {
-        _subgrids[this_igrid] = create_subgrid(this_igrid);
-        _subgrids[this_igrid]->set_owning_thread(get_thread_index());
-        for (auto it = _subgrids[this_igrid]->begin();
-             it != _subgrids[this_igrid]->end(); ++it) {
-          DensityValues values = density_function(it);
-          it.get_ionization_variables().set_number_density(
-              values.get_number_density());
-          for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-            it.get_ionization_variables().set_ionic_fraction(
-                ion, values.get_ionic_fraction(ion));
+      if (this_igrid < _subgrids.size() && is_local(this_igrid)) {
+        _subgrids[this_igrid] =
+            create_initialized_subgrid(this_igrid, density_function);
+        if (refinement_scheme != nullptr) {
+          while (_refinement_levels[this_igrid] < _maximum_refinement_level &&
+                 needs_refinement(*_subgrids[this_igrid],
+                                  _refinement_levels[this_igrid],
+                                  *refinement_scheme)) {
+            delete _subgrids[this_igrid];
+            ++_refinement_levels[this_igrid];
+            _subgrids[this_igrid] =
+                create_initialized_subgrid(this_igrid, density_function);
           }
-          it.get_ionization_variables().set_temperature(
-              values.get_temperature());
-          _subgrids[this_igrid]->initialize_hydro(it.get_index(), values);
+        }
+        _subgrids[this_igrid]->set_owning_thread(get_thread_index());
+      }
+    }
+
+    if (refinement_scheme == nullptr) {
+      return;
+    }
+
+#ifdef HAVE_MPI
+    if (is_distributed()) {
+      // every process only knows the levels of its own subgrids; the other
+      // levels are 0
+      std::vector< int > global_levels(_refinement_levels.begin(),
+                                       _refinement_levels.end());
+      MPI_Allreduce(MPI_IN_PLACE, &global_levels[0], global_levels.size(),
+                    MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+      for (size_t i = 0; i < global_levels.size(); ++i) {
+        _refinement_levels[i] = global_levels[i];
+      }
+    }
+#endif
+
+    // neighbouring levels are subject to the same restriction as neighbouring
+    // copy levels
+    std::vector< uint_fast8_t > balanced_levels(_refinement_levels);
+    impose_copy_restrictions(balanced_levels);
+    igrid.set(0);
+#ifdef HAVE_OPENMP
+#pragma omp parallel default(shared)
+#endif
+    while (igrid.value() < _subgrids.size()) {
+      const size_t this_igrid = igrid.post_increment();
+      if (this_igrid < _subgrids.size() &&
+          balanced_levels[this_igrid] != _refinement_levels[this_igrid]) {
+        _refinement_levels[this_igrid] = balanced_levels[this_igrid];
+        if (is_local(this_igrid)) {
+          const int_fast32_t owning_thread =
+              _subgrids[this_igrid]->get_owning_thread();
+          delete _subgrids[this_igrid];
+          _subgrids[this_igrid] =
+              create_initialized_subgrid(this_igrid, density_function);
+          _subgrids[this_igrid]->set_owning_thread(owning_thread);
         }
       }
     }
@@ -458,14 +776,21 @@ public:
       if (number_of_copies > 1) {
         _copies[i] = _subgrids.size();
       }
+      // copies of subgrids owned by other processes are not allocated, but
+      // still get an index, so that all processes agree on the indices
+      const bool local = is_local(i);
       for (uint_fast32_t j = 1; j < number_of_copies; ++j) {
-        _subgrids.push_back(new _subgrid_type_(*_subgrids[i]));
+        _subgrids.push_back(local ? new _subgrid_type_(*_subgrids[i])
+                                  : nullptr);
         _originals.push_back(i);
       }
     }
 
     // neighbour setting
     for (int_fast32_t i = 0; i < number_of_unique_subgrids; ++i) {
+      if (!is_local(i)) {
+        continue;
+      }
       const uint_fast8_t level = copy_levels[i];
       const uint_fast32_t number_of_copies = 1 << level;
       // first do the self-reference for each copy (if there are copies)
@@ -545,10 +870,221 @@ public:
     }
     _subgrids.resize(original_number);
     _originals.clear();
+    // subgrids that no longer have copies should not refer to old copies
+    _copies.assign(original_number, 0xffffffff);
 
     create_copies(copy_levels);
   }
 
+  /**
+   * @brief Get the copy level of the given original subgrid.
+   *
+   * @param index Index of an original subgrid.
+   * @return Copy level of that subgrid (the subgrid has 2^level - 1 copies).
+   */
+  inline uint_fast8_t get_copy_level(const size_t index) const {
+
+    if (_copies[index] == 0xffffffff) {
+      return 0;
+    }
+    const size_t number_of_originals = _copies.size();
+    uint_fast32_t number_of_copies = 1;
+    size_t copy_index = _copies[index];
+    while (copy_index < _subgrids.size() &&
+           _originals[copy_index - number_of_originals] == index) {
+      ++number_of_copies;
+      ++copy_index;
+    }
+    uint_fast8_t level = 0;
+    while ((1u << level) < number_of_copies) {
+      ++level;
+    }
+    return level;
+  }
+
+  /**
+   * @brief Make sure the copy levels of neighbouring subgrids differ by at
+   * most one level, by increasing the level of neighbours where necessary.
+   *
+   * @param copy_levels Copy level for each original subgrid.
+   */
+  inline void
+  impose_copy_restrictions(std::vector< uint_fast8_t > &copy_levels) const {
+
+    uint_fast8_t max_level = 0;
+    const size_t levelsize = copy_levels.size();
+    for (size_t i = 0; i < levelsize; ++i) {
+      max_level = std::max(max_level, copy_levels[i]);
+    }
+
+    size_t ngbs[6];
+    while (max_level > 0) {
+      for (size_t i = 0; i < levelsize; ++i) {
+        if (copy_levels[i] == max_level) {
+          const uint_fast8_t numngbs = get_neighbours(i, ngbs);
+          for (uint_fast8_t ingb = 0; ingb < numngbs; ++ingb) {
+            const size_t ngbi = ngbs[ingb];
+            if (copy_levels[ngbi] < copy_levels[i] - 1) {
+              copy_levels[ngbi] = copy_levels[i] - 1;
+            }
+          }
+        }
+      }
+      --max_level;
+    }
+  }
+
+  /**
+   * @brief Get the load imbalance for the given per thread loads.
+   *
+   * The load imbalance is the ratio of the largest and the average load,
+   * minus one, so that a perfectly balanced load has an imbalance of 0.
+   *
+   * @param loads Load for each thread.
+   * @return Load imbalance.
+   */
+  inline static double get_load_imbalance(const std::vector< double > &loads) {
+
+    double max_load = 0.;
+    double total_load = 0.;
+    for (size_t i = 0; i < loads.size(); ++i) {
+      max_load = std::max(max_load, loads[i]);
+      total_load += loads[i];
+    }
+    if (total_load == 0.) {
+      return 0.;
+    }
+    return max_load * loads.size() / total_load - 1.;
+  }
+
+  /**
+   * @brief Redistribute the subgrid copies and the thread ownership of all
+   * local subgrids based on their measured computational cost.
+   *
+   * The cost of every original subgrid (summed over all its copies) is used
+   * to compute a new copy level: a subgrid is copied until the expected cost
+   * of a single copy is at most the given fraction of the average thread
+   * load, with an upper limit set by the given maximum copy level. If the
+   * resulting levels (after imposing the copy restrictions) differ from the
+   * current ones, the copies are recreated. All local subgrids are then
+   * assigned to threads in order of decreasing expected cost, each time
+   * picking the thread with the lowest load.
+   *
+   * The old imbalance is computed from the measured cost of every subgrid and
+   * its current owning thread, the new imbalance is the expected imbalance of
+   * the new distribution. The computational costs are not reset.
+   *
+   * For a distributed grid, all processes need to call this function, since
+   * the copy levels are computed from the global costs.
+   *
+   * @param maximum_level Maximum allowed copy level.
+   * @param cost_fraction Maximum expected cost of a single copy, as a fraction
+   * of the average thread load.
+   * @param number_of_threads Number of threads on the local process.
+   * @param old_imbalance Load imbalance before the redistribution.
+   * @param new_imbalance Expected load imbalance after the redistribution.
+   * @return True if the copies were recreated, in which case everything that
+   * stores copy indices (e.g. a DistributedPhotonSource) needs to be updated
+   * as well.
+   */
+  inline bool rebalance_copies(const uint_fast8_t maximum_level,
+                               const double cost_fraction,
+                               const uint_fast32_t number_of_threads,
+                               double &old_imbalance, double &new_imbalance) {
+
+    const size_t number_of_originals = number_of_original_subgrids();
+    std::vector< uint_fast64_t > costs(number_of_originals, 0);
+    std::vector< double > loads(number_of_threads, 0.);
+    for (size_t i = 0; i < _subgrids.size(); ++i) {
+      if (!is_local(i)) {
+        continue;
+      }
+      const uint_fast64_t cost = _subgrids[i]->get_computational_cost();
+      const size_t original =
+          (i < number_of_originals) ? i : _originals[i - number_of_originals];
+      costs[original] += cost;
+      loads[_subgrids[i]->get_owning_thread() % number_of_threads] += cost;
+    }
+    old_imbalance = get_load_imbalance(loads);
+
+    uint_fast32_t total_number_of_threads = number_of_threads;
+#ifdef HAVE_MPI
+    if (is_distributed()) {
+      MPI_Allreduce(MPI_IN_PLACE, &costs[0], number_of_originals,
+                    MPI_UINT_FAST64_T, MPI_SUM, MPI_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &total_number_of_threads, 1,
+                    MPI_UINT_FAST32_T, MPI_SUM, MPI_COMM_WORLD);
+    }
+#endif
+
+    uint_fast64_t total_cost = 0;
+    for (size_t i = 0; i < number_of_originals; ++i) {
+      total_cost += costs[i];
+    }
+    if (total_cost == 0) {
+      new_imbalance = old_imbalance;
+      return false;
+    }
+
+    // compute the new copy levels
+    const double target_cost =
+        cost_fraction * total_cost / total_number_of_threads;
+    std::vector< uint_fast8_t > levels(number_of_originals, 0);
+    for (size_t i = 0; i < number_of_originals; ++i) {
+      double copy_cost = costs[i];
+      while (levels[i] < maximum_level && copy_cost > target_cost) {
+        copy_cost *= 0.5;
+        ++levels[i];
+      }
+    }
+    impose_copy_restrictions(levels);
+
+    bool changed = false;
+    for (size_t i = 0; i < number_of_originals; ++i) {
+      if (levels[i] != get_copy_level(i)) {
+        changed = true;
+        break;
+      }
+    }
+    if (changed) {
+      update_copies(levels);
+    }
+
+    // assign the local subgrids to threads, most expensive subgrids first
+    std::vector< std::pair< double, size_t > > subgrid_costs;
+    for (size_t i = 0; i < _subgrids.size(); ++i) {
+      if (!is_local(i)) {
+        continue;
+      }
+      const size_t original =
+          (i < number_of_originals) ? i : _originals[i - number_of_originals];
+      subgrid_costs.push_back(std::make_pair(
+          static_cast< double >(costs[original]) / (1 << levels[original]),
+          i));
+    }
+    // sort on decreasing cost, equal costs are sorted on increasing index
+    std::sort(subgrid_costs.begin(), subgrid_costs.end(),
+              [](const std::pair< double, size_t > &a,
+                 const std::pair< double, size_t > &b) {
+                return a.first > b.first ||
+                       (a.first == b.first && a.second < b.second);
+              });
+    std::fill(loads.begin(), loads.end(), 0.);
+    for (size_t i = 0; i < subgrid_costs.size(); ++i) {
+      uint_fast32_t thread = 0;
+      for (uint_fast32_t j = 1; j < number_of_threads; ++j) {
+        if (loads[j] < loads[thread]) {
+          thread = j;
+        }
+      }
+      loads[thread] += subgrid_costs[i].first;
+      _subgrids[subgrid_costs[i].second]->set_owning_thread(thread);
+    }
+    new_imbalance = get_load_imbalance(loads);
+
+    return changed;
+  }
+
   /**
    * @brief Update the counters of all original subgrids with the contributions
    * from their copies.
@@ -561,7 +1097,7 @@ public:
     while (ioriginal.value() < _copies.size()) {
       const size_t this_ioriginal = ioriginal.post_increment();
       if (this_ioriginal < _copies.size() &&
-          _copies[this_ioriginal] != 0xffffffff) {
+          _copies[this_ioriginal] != 0xffffffff && is_local(this_ioriginal)) {
         size_t copy_index = _copies[this_ioriginal] - _copies.size();
         while (copy_index < _originals.size() &&
                _originals[copy_index] == this_ioriginal) {
@@ -585,7 +1121,7 @@ public:
     while (ioriginal.value() < _copies.size()) {
       const size_t this_ioriginal = ioriginal.post_increment();
       if (this_ioriginal < _copies.size() &&
-          _copies[this_ioriginal] != 0xffffffff) {
+          _copies[this_ioriginal] != 0xffffffff && is_local(this_ioriginal)) {
         size_t copy_index = _copies[this_ioriginal] - _copies.size();
         while (copy_index < _originals.size() &&
                _originals[copy_index] == this_ioriginal) {
@@ -780,12 +1316,17 @@ public:
    */
   inline void write_restart_file(RestartWriter &restart_writer) const {
 
+    cmac_assert_message(!is_distributed(),
+                        "Restart files are not supported for distributed "
+                        "grids!");
+
     // const members
     _box.write_restart_file(restart_writer);
     _subgrid_sides.write_restart_file(restart_writer);
     _number_of_subgrids.write_restart_file(restart_writer);
     _subgrid_number_of_cells.write_restart_file(restart_writer);
     _periodicity.write_restart_file(restart_writer);
+    restart_writer.write(_maximum_refinement_level);
 
     const size_t number_of_subgrids = _subgrids.size();
     restart_writer.write(number_of_subgrids);
@@ -802,6 +1343,9 @@ public:
     for (size_t i = 0; i < number_of_originals; ++i) {
       restart_writer.write(_copies[i]);
     }
+    for (size_t i = 0; i < number_of_originals; ++i) {
+      restart_writer.write(_refinement_levels[i]);
+    }
   }
 
   /**
@@ -812,7 +1356,9 @@ public:
   inline DensitySubGridCreator(RestartReader &restart_reader)
       : _box(restart_reader), _subgrid_sides(restart_reader),
         _number_of_subgrids(restart_reader),
-        _subgrid_number_of_cells(restart_reader), _periodicity(restart_reader) {
+        _subgrid_number_of_cells(restart_reader), _periodicity(restart_reader),
+        _maximum_refinement_level(restart_reader.read< uint_fast8_t >()),
+        _MPI_rank(0), _MPI_size(1) {
 
     const size_t number_of_subgrids = restart_reader.read< size_t >();
     _subgrids.resize(number_of_subgrids, nullptr);
@@ -829,6 +1375,10 @@ public:
     for (size_t i = 0; i < number_of_originals; ++i) {
       _copies[i] = restart_reader.read< size_t >();
     }
+    _refinement_levels.resize(number_of_originals, 0);
+    for (size_t i = 0; i < number_of_originals; ++i) {
+      _refinement_levels[i] = restart_reader.read< uint_fast8_t >();
+    }
   }
 };
 
@@ -33,6 +33,13 @@
 #include "PhotonSource.hpp"
 #include "RandomGenerator.hpp"
 
+/*! @brief Number of uniform random numbers that is drawn in bulk at the start
+ *  of every photon packet if a counter-based random generator is used. Every
+ *  photon packet needs at least 4: two for the direction, one for the forced
+ *  first interaction and one for the interaction after the first scattering
+ *  event. */
+#define DUSTPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE 4
+
 /**
  * @brief Job implementation that shoots photons through a dusty DensityGrid.
  */
@@ -56,6 +63,42 @@ private:
   /*! @brief Number of photons to propagate through the DensityGrid. */
   uint_fast64_t _numphoton;
 
+  /*! @brief Iteration number used to select random number streams. */
+  uint_fast32_t _iteration;
+
+  /*! @brief Index of the first photon packet for the next execution of the
+   *  job (used to select random number streams). */
+  uint_fast64_t _first_photon_index;
+
+  /*! @brief Uniform random numbers drawn in bulk for the current photon
+   *  packet. */
+  double _random_block[DUSTPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE];
+
+  /*! @brief Index of the next unused element of _random_block. */
+  uint_fast32_t _random_block_index;
+
+  /**
+   * @brief Get a uniform random number for the current photon packet.
+   *
+   * For counter-based random generators, the number is taken from a block
+   * that is drawn in bulk from the stream of the photon packet, and that is
+   * refilled from the same stream when it runs out. For the sequential
+   * generator, we simply draw a single random number.
+   *
+   * @return Uniform random number.
+   */
+  inline double get_uniform_random_double() {
+    if (!_random_generator.is_counter_based()) {
+      return _random_generator.get_uniform_random_double();
+    }
+    if (_random_block_index == DUSTPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE) {
+      _random_generator.get_uniform_random_doubles(
+          _random_block, DUSTPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE);
+      _random_block_index = 0;
+    }
+    return _random_block[_random_block_index++];
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -67,21 +110,36 @@ public:
    * thread.
    * @param density_grid DensityGrid through which photons are propagated.
    * @param image CCDImage to construct.
+   * @param random_generator_type Type of random number generator to use.
    */
   inline DustPhotonShootJob(PhotonSource &photon_source,
                             const DustScattering &dust_scattering,
                             int_fast32_t random_seed, DensityGrid &density_grid,
-                            const CCDImage &image)
+                            const CCDImage &image,
+                            const RandomGeneratorType random_generator_type =
+                                RANDOMGENERATORTYPE_RANLUX)
       : _photon_source(photon_source), _dust_scattering(dust_scattering),
-        _random_generator(random_seed), _density_grid(density_grid),
-        _image(image), _numphoton(0) {}
+        _random_generator(random_seed, random_generator_type),
+        _density_grid(density_grid), _image(image), _numphoton(0),
+        _iteration(0), _first_photon_index(0),
+        _random_block_index(DUSTPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE) {}
 
   /**
    * @brief Set the number of photons for the next execution of the job.
    *
    * @param numphoton New number of photons.
+   * @param iteration Iteration number (only used for counter-based random
+   * generators).
+   * @param first_photon_index Index of the first photon packet (only used for
+   * counter-based random generators).
    */
-  inline void set_numphoton(uint_fast64_t numphoton) { _numphoton = numphoton; }
+  inline void set_numphoton(uint_fast64_t numphoton,
+                            const uint_fast32_t iteration = 0,
+                            const uint_fast64_t first_photon_index = 0) {
+    _numphoton = numphoton;
+    _iteration = iteration;
+    _first_photon_index = first_photon_index;
+  }
 
   /**
    * @brief Update the given CCDImage.
@@ -103,18 +161,29 @@ public:
 
   /**
    * @brief Shoot _numphoton photons from _photon_source through _density_grid.
+   *
+   * If a counter-based random generator is used, every photon packet uses its
+   * own random number stream, selected by the iteration number and the index
+   * of the photon packet. The random numbers for the direction and the first
+   * interactions are then drawn in bulk.
    */
   inline void execute() {
     // parameter
     const double band_albedo = _dust_scattering.get_albedo();
 
     for (uint_fast64_t i = 0; i < _numphoton; ++i) {
+      if (_random_generator.is_counter_based()) {
+        _random_generator.set_stream(_iteration, _first_photon_index + i);
+        _random_generator.get_uniform_random_doubles(
+            _random_block, DUSTPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE);
+        _random_block_index = 0;
+      }
       Photon photon = _photon_source.get_random_photon(_random_generator);
       // overwrite direction: we need the direction components to speed things
       // up in other parts of the algorithm
-      double cost = 2. * _random_generator.get_uniform_random_double() - 1.;
+      double cost = 2. * get_uniform_random_double() - 1.;
       double sint = std::sqrt(std::max(1. - cost * cost, 0.));
-      double phi = 2. * M_PI * _random_generator.get_uniform_random_double();
+      double phi = 2. * M_PI * get_uniform_random_double();
       double cosp = std::cos(phi);
       double sinp = std::sin(phi);
       const CoordinateVector<> direction(sint * cosp, sint * sinp, cost);
@@ -135,8 +204,7 @@ public:
       // interaction
       const double tau_max = _density_grid.integrate_optical_depth(photon);
       const double weight = (1. - std::exp(-tau_max));
-      double tau = -std::log(
-          1. - _random_generator.get_uniform_random_double() * weight);
+      double tau = -std::log(1. - get_uniform_random_double() * weight);
       DensityGrid::iterator it = _density_grid.interact(photon, tau);
       while (it != _density_grid.end()) {
 
@@ -157,7 +225,7 @@ public:
                           weight_new * fq, weight_new * fu);
 
         _dust_scattering.scatter(photon, _random_generator);
-        tau = -std::log(_random_generator.get_uniform_random_double());
+        tau = -std::log(get_uniform_random_double());
         it = _density_grid.interact(photon, tau);
       }
     }
@@ -55,6 +55,14 @@ private:
   /*! @brief Number of photons to shoot during a single DustPhotonShootJob. */
   const uint_fast64_t _jobsize;
 
+  /*! @brief Number of times the number of photons was set (used to select
+   *  random number streams). */
+  uint_fast32_t _iteration;
+
+  /*! @brief Index of the first photon packet of the next job (used to select
+   *  random number streams). */
+  uint_fast64_t _next_photon_index;
+
   /*! @brief Lock used to ensure safe access to the internal photon number
    *  counters. */
   Lock _lock;
@@ -74,21 +82,30 @@ public:
    * @param jobsize Number of photons to shoot during a single
    * DustPhotonShootJob.
    * @param worksize Number of threads used in the calculation.
+   * @param random_generator_type Type of random number generator to use.
    */
-  inline DustPhotonShootJobMarket(PhotonSource &photon_source,
-                                  const DustScattering &dust_scattering,
-                                  int_fast32_t random_seed,
-                                  DensityGrid &density_grid,
-                                  uint_fast64_t numphoton,
-                                  const CCDImage &image, uint_fast64_t jobsize,
-                                  int_fast32_t worksize)
-      : _worksize(worksize), _numphoton(numphoton), _jobsize(jobsize) {
+  inline DustPhotonShootJobMarket(
+      PhotonSource &photon_source, const DustScattering &dust_scattering,
+      int_fast32_t random_seed, DensityGrid &density_grid,
+      uint_fast64_t numphoton, const CCDImage &image, uint_fast64_t jobsize,
+      int_fast32_t worksize,
+      const RandomGeneratorType random_generator_type =
+          RANDOMGENERATORTYPE_RANLUX)
+      : _worksize(worksize), _numphoton(numphoton), _jobsize(jobsize),
+        _iteration(0), _next_photon_index(0) {
 
     // create a separate RandomGenerator for each thread.
     // create a single PhotonShootJob for each thread.
     for (int_fast32_t i = 0; i < _worksize; ++i) {
-      _jobs[i] = new DustPhotonShootJob(photon_source, dust_scattering,
-                                        random_seed + i, density_grid, image);
+      // counter-based generators select independent streams per photon
+      // packet, so all threads need to use the same seed
+      const int_fast32_t thread_seed =
+          (random_generator_type == RANDOMGENERATORTYPE_RANLUX)
+              ? random_seed + i
+              : random_seed;
+      _jobs[i] =
+          new DustPhotonShootJob(photon_source, dust_scattering, thread_seed,
+                                 density_grid, image, random_generator_type);
     }
   }
 
@@ -117,9 +134,20 @@ public:
    * This routine can be used to reset a DustPhotonShootJobMarket that was used
    * before.
    *
+   * Every call selects a new set of random number streams for counter-based
+   * random generators.
+   *
    * @param numphoton New number of photons.
+   * @param first_photon_index Index of the first photon packet that is
+   * propagated by this process (for counter-based random generators, this
+   * selects the random number stream of the photon packets).
    */
-  inline void set_numphoton(uint_fast64_t numphoton) { _numphoton = numphoton; }
+  inline void set_numphoton(uint_fast64_t numphoton,
+                            const uint_fast64_t first_photon_index = 0) {
+    _numphoton = numphoton;
+    _next_photon_index = first_photon_index;
+    ++_iteration;
+  }
 
   /**
    * @brief Update the given CCDImage.
@@ -146,9 +174,11 @@ public:
       jobsize = _numphoton;
     }
     _numphoton -= jobsize;
+    const uint_fast64_t first_photon_index = _next_photon_index;
+    _next_photon_index += jobsize;
     _lock.unlock();
     if (jobsize > 0) {
-      _jobs[thread_id]->set_numphoton(jobsize);
+      _jobs[thread_id]->set_numphoton(jobsize, _iteration, first_photon_index);
       return _jobs[thread_id];
     } else {
       return nullptr;
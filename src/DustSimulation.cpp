@@ -54,6 +54,9 @@
  *
  * This method reads the following parameters from the parameter file:
  *  - random seed: Seed for the random number generator (default: 42)
+ *  - random generator: Type of random number generator to use (RANLUX/Philox,
+ *    default: RANLUX). The counter-based Philox generator uses an independent
+ *    random number stream for every photon packet.
  *  - output folder: Folder where all output files will be placed (default: .)
  *  - number of photons: Number of photons to use (default: 5e5)
  *
@@ -84,6 +87,9 @@ int DustSimulation::do_simulation(CommandLineParser &parser, bool write_output,
 
   int_fast32_t random_seed =
       params.get_value< int_fast32_t >("DustSimulation:random seed", 42);
+  const RandomGeneratorType random_generator_type =
+      RandomGenerator::get_type(params.get_value< std::string >(
+          "DustSimulation:random generator", "RANLUX"));
 
   SpiralGalaxyContinuousPhotonSource continuoussource(simulation_box.get_box(),
                                                       params, log);
@@ -149,7 +155,8 @@ int DustSimulation::do_simulation(CommandLineParser &parser, bool write_output,
                       " for photon shooting.");
   }
   DustPhotonShootJobMarket dustphotonshootjobs(
-      source, dust_scattering, random_seed, grid, 0, dust_image, 100, worksize);
+      source, dust_scattering, random_seed, grid, 0, dust_image, 100, worksize,
+      random_generator_type);
 
   if (log) {
     log->write_status("Start shooting ", numphoton, " photons...");
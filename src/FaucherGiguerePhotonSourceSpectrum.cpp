@@ -160,6 +160,11 @@ FaucherGiguerePhotonSourceSpectrum::FaucherGiguerePhotonSourceSpectrum(
     _total_flux = 0.;
   }
 
+  // set up the guide table used to sample the cumulative distribution
+  _cumulative_distribution_guide.initialize(
+      _cumulative_distribution.data(),
+      FAUCHERGIGUEREPHOTONSOURCESPECTRUM_NUMFREQ);
+
   if (log) {
     log->write_status(
         "Constructed FaucherGiguerePhotonSourceSpectrum at redshift ", redshift,
@@ -235,9 +240,8 @@ double FaucherGiguerePhotonSourceSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
   const double x = random_generator.get_uniform_random_double();
-  const uint_fast32_t inu =
-      Utilities::locate(x, _cumulative_distribution.data(),
-                        FAUCHERGIGUEREPHOTONSOURCESPECTRUM_NUMFREQ);
+  const uint_fast32_t inu = _cumulative_distribution_guide.locate(
+      x, _cumulative_distribution.data());
   const double frequency =
       _frequencies[inu] +
       (_frequencies[inu + 1] - _frequencies[inu]) *
@@ -27,6 +27,7 @@
 #ifndef FAUCHERGIGUEREPHOTONSOURCESPECTRUM_HPP
 #define FAUCHERGIGUEREPHOTONSOURCESPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 
 #include <string>
@@ -62,6 +63,9 @@ private:
   /*! @brief Cumulative distribution of the spectrum. */
   std::vector< double > _cumulative_distribution;
 
+  /*! @brief Guide table used to sample the cumulative distribution function. */
+  GuideTable _cumulative_distribution_guide;
+
   /*! @brief Total ionizing flux of the spectrum (in m^-2 s^-1). */
   double _total_flux;
 
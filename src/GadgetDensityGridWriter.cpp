@@ -39,6 +39,31 @@
 
 #include <vector>
 
+/**
+ * @brief Get the HDF5Tools::HDF5Precision that corresponds to the given
+ * DensityGridFieldPrecision.
+ *
+ * @param precision DensityGridFieldPrecision.
+ * @return Corresponding HDF5Tools::HDF5Precision.
+ */
+static int_fast32_t get_hdf5_precision(const int_fast32_t precision) {
+  switch (precision) {
+  case DENSITYGRIDFIELDPRECISION_DOUBLE:
+    return HDF5Tools::HDF5PRECISION_DOUBLE;
+  case DENSITYGRIDFIELDPRECISION_FLOAT32:
+    return HDF5Tools::HDF5PRECISION_FLOAT32;
+  case DENSITYGRIDFIELDPRECISION_FLOAT16:
+    return HDF5Tools::HDF5PRECISION_FLOAT16;
+  case DENSITYGRIDFIELDPRECISION_QUANTISED:
+    return HDF5Tools::HDF5PRECISION_QUANTISED;
+  case DENSITYGRIDFIELDPRECISION_SIGNIFICANT:
+    return HDF5Tools::HDF5PRECISION_SIGNIFICANT;
+  default:
+    cmac_error("Unknown DensityGridFieldPrecision: %" PRIiFAST32, precision);
+    return HDF5Tools::HDF5PRECISION_DOUBLE;
+  }
+}
+
 /**
  * @brief Constructor.
  *
@@ -50,13 +75,27 @@
  * @param log Log to write logging information to.
  * @param padding Number of digits used for the counter in the filenames.
  * @param compression Compress the HDF5 output?
+ * @param asynchronous Write snapshots for split grids with hydro
+ * asynchronously?
+ * @param coordinates_once Only write the coordinates to the first snapshot?
+ * @param compression_level Deflate compression level used for compressed
+ * output (1: fastest, 9: smallest files).
  */
 GadgetDensityGridWriter::GadgetDensityGridWriter(
     std::string prefix, std::string output_folder, const bool hydro,
     const DensityGridWriterFields fields, Log *log, uint_fast8_t padding,
-    const bool compression)
+    const bool compression, const bool asynchronous,
+    const bool coordinates_once, const int_fast32_t compression_level)
     : DensityGridWriter(output_folder, hydro, fields, log), _prefix(prefix),
-      _padding(padding), _compression(compression) {
+      _padding(padding), _compression(compression),
+      _compression_level(compression_level), _asynchronous(asynchronous),
+      _next_staged_snapshot(0), _coordinates_once(coordinates_once) {
+
+  if (_compression && (_compression_level < 1 || _compression_level > 9)) {
+    cmac_error("Invalid compression level: %" PRIiFAST32
+               " (should be in the range [1, 9])!",
+               _compression_level);
+  }
 
   // turn off default HDF5 error handling: we catch errors ourselves
   HDF5Tools::initialize();
@@ -64,10 +103,17 @@ GadgetDensityGridWriter::GadgetDensityGridWriter(
     _log->write_status("Set up GadgetDensityGridWriter with prefix \"", _prefix,
                        "\".");
     if (_compression) {
-      _log->write_status("Compression enabled.");
+      _log->write_status("Compression enabled (level ", _compression_level,
+                         ").");
     } else {
       _log->write_status("Compression disabled.");
     }
+    if (_asynchronous) {
+      _log->write_status("Asynchronous output enabled.");
+    }
+    if (_coordinates_once) {
+      _log->write_status("Coordinates will only be written once.");
+    }
   }
 }
 
@@ -78,6 +124,13 @@ GadgetDensityGridWriter::GadgetDensityGridWriter(
  *  - prefix: Prefix to prepend to all snapshot file names (default: snapshot)
  *  - padding: Number of digits to use in the output file names (default: 3)
  *  - compression: Compress HDF5 datasets? (default: false)
+ *  - compression level: Deflate compression level used for compressed
+ *    datasets, from 1 (fastest) to 9 (smallest files) (default: 9)
+ *  - asynchronous output: Write snapshots for split grids with hydro on a
+ *    separate output thread? (default: false)
+ *  - coordinates once: Only write the coordinates to the first snapshot and
+ *    link to them from all other snapshots? Only use this for grids that do
+ *    not move (default: false)
  *
  * @param output_folder Name of the folder where output files should be placed.
  * @param params ParameterFile to read.
@@ -92,7 +145,67 @@ GadgetDensityGridWriter::GadgetDensityGridWriter(std::string output_folder,
                                           "snapshot"),
           output_folder, hydro, DensityGridWriterFields(params, hydro), log,
           params.get_value< uint_fast8_t >("DensityGridWriter:padding", 3),
-          params.get_value< bool >("DensityGridWriter:compression", false)) {}
+          params.get_value< bool >("DensityGridWriter:compression", false),
+          params.get_value< bool >("DensityGridWriter:asynchronous output",
+                                   false),
+          params.get_value< bool >("DensityGridWriter:coordinates once",
+                                   false),
+          params.get_value< int_fast32_t >(
+              "DensityGridWriter:compression level", 9)) {}
+
+/**
+ * @brief Destructor.
+ *
+ * Waits for pending asynchronous output to finish.
+ */
+GadgetDensityGridWriter::~GadgetDensityGridWriter() { wait_for_output(); }
+
+/**
+ * @brief Wait for the output thread to finish writing the current asynchronous
+ * snapshot (if any).
+ */
+void GadgetDensityGridWriter::wait_for_output() {
+  if (_output_thread.joinable()) {
+    _output_thread.join();
+  }
+}
+
+/**
+ * @brief Get the fields that should be written to the snapshot with the given
+ * counter value.
+ *
+ * If coordinates are only written once, the first snapshot that is written
+ * contains the coordinates, while all other snapshots link to them.
+ *
+ * @param counter Counter value of the snapshot.
+ * @param extension Extension of the snapshot file name.
+ * @param coordinates_link Variable to store the name of the file that contains
+ * the coordinates in if the snapshot should link to it (empty otherwise).
+ * @return Fields to write to the snapshot.
+ */
+DensityGridWriterFields
+GadgetDensityGridWriter::get_snapshot_fields(const uint_fast32_t counter,
+                                             const std::string extension,
+                                             std::string &coordinates_link) {
+
+  DensityGridWriterFields fields(_fields);
+  coordinates_link = "";
+  if (_coordinates_once && fields.field_present(DENSITYGRIDFIELD_COORDINATES)) {
+    // the snapshots all live in the same folder, so we do not store the folder
+    // name in the link
+    const std::string name =
+        Utilities::compose_filename("", _prefix, extension, counter, _padding);
+    // a snapshot that overwrites the file with the coordinates cannot link to
+    // itself
+    if (_coordinates_file.empty() || _coordinates_file == name) {
+      _coordinates_file = name;
+    } else {
+      fields.disable_field(DENSITYGRIDFIELD_COORDINATES);
+      coordinates_link = _coordinates_file;
+    }
+  }
+  return fields;
+}
 
 /**
  * @brief Write the file.
@@ -108,6 +221,9 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
                                     ParameterFile &params, double time,
                                     const InternalHydroUnits *hydro_units) {
 
+  // HDF5 calls from different threads are not safe
+  wait_for_output();
+
   std::string filename = Utilities::compose_filename(
       _output_folder, _prefix, "hdf5", iteration, _padding);
 
@@ -115,6 +231,10 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
     _log->write_status("Writing file \"", filename, "\".");
   }
 
+  std::string coordinates_link;
+  const DensityGridWriterFields fields =
+      get_snapshot_fields(iteration, "hdf5", coordinates_link);
+
   HDF5Tools::HDF5File file =
       HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_WRITE);
 
@@ -206,41 +326,56 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
   // to limit memory usage, we first create all datasets, and then add the data
   // in small blocks
   group = HDF5Tools::create_group(file, "PartType0");
+  if (!coordinates_link.empty()) {
+    HDF5Tools::create_external_link(group, "Coordinates", coordinates_link,
+                                    "/PartType0/Coordinates");
+  }
   for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
        ++property) {
-    if (_fields.field_present(property)) {
+    if (fields.field_present(property)) {
       const std::string name = DensityGridWriterFields::get_name(property);
+      const int_fast32_t precision =
+          get_hdf5_precision(fields.get_field_precision(property));
+      const int_fast32_t decimal_digits =
+          fields.get_field_decimal_digits(property);
       if (DensityGridWriterFields::get_type(property) ==
           DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
-        HDF5Tools::create_dataset< CoordinateVector<> >(group, name, numpart[0],
-                                                        _compression);
+        HDF5Tools::create_dataset< CoordinateVector<> >(
+            group, name, numpart[0], _compression, precision, decimal_digits,
+            _compression_level);
       } else {
         if (DensityGridWriterFields::is_ion_property(property)) {
           for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-            if (_fields.ion_present(property, ion)) {
+            if (fields.ion_present(property, ion)) {
               const std::string prop_name = name + get_ion_name(ion);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
+              HDF5Tools::create_dataset< double >(
+                  group, prop_name, numpart[0], _compression, precision,
+                  decimal_digits, _compression_level);
             }
           }
         } else if (DensityGridWriterFields::is_heating_property(property)) {
           for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
                ++heating) {
-            if (_fields.heatingterm_present(property, heating)) {
+            if (fields.heatingterm_present(property, heating)) {
               const std::string prop_name = name + get_ion_name(heating);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
+              HDF5Tools::create_dataset< double >(
+                  group, prop_name, numpart[0], _compression, precision,
+                  decimal_digits, _compression_level);
             }
           }
         } else {
-          HDF5Tools::create_dataset< double >(group, name, numpart[0],
-                                              _compression);
+          HDF5Tools::create_dataset< double >(
+              group, name, numpart[0], _compression, precision, decimal_digits,
+              _compression_level);
         }
       }
     }
   }
 
-  const uint_fast32_t blocksize = 10000;
+  // blocks consist of a whole number of HDF5 chunks (of 1024 cells), so that
+  // compressed blocks can be written chunk by chunk (see
+  // HDF5Tools::write_chunks())
+  const uint_fast32_t blocksize = 10240;
   const uint_fast32_t numblock =
       numpart[0] / blocksize + (numpart[0] % blocksize > 0);
   for (uint_fast32_t iblock = 0; iblock < numblock; ++iblock) {
@@ -250,10 +385,10 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
     const uint_fast32_t thisblocksize = upper_limit - offset;
 
     std::vector< std::vector< CoordinateVector<> > > vector_props(
-        _fields.get_field_count(DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE),
+        fields.get_field_count(DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE),
         std::vector< CoordinateVector<> >(thisblocksize));
     std::vector< std::vector< double > > scalar_props(
-        _fields.get_field_count(DENSITYGRIDFIELDTYPE_SCALAR_DOUBLE),
+        fields.get_field_count(DENSITYGRIDFIELDTYPE_SCALAR_DOUBLE),
         std::vector< double >(thisblocksize));
 
     size_t index = 0;
@@ -263,7 +398,7 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
       uint_fast8_t scalar_index = 0;
       for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
            ++property) {
-        if (_fields.field_present(property)) {
+        if (fields.field_present(property)) {
           if (DensityGridWriterFields::get_type(property) ==
               DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
             vector_props[vector_index][index] =
@@ -273,7 +408,7 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
           } else {
             if (DensityGridWriterFields::is_ion_property(property)) {
               for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-                if (_fields.ion_present(property, ion)) {
+                if (fields.ion_present(property, ion)) {
                   scalar_props[scalar_index][index] =
                       DensityGridWriterFields::get_scalar_double_ion_value(
                           property, ion, it);
@@ -283,7 +418,7 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
             } else if (DensityGridWriterFields::is_heating_property(property)) {
               for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
                    ++heating) {
-                if (_fields.heatingterm_present(property, heating)) {
+                if (fields.heatingterm_present(property, heating)) {
                   scalar_props[scalar_index][index] =
                       DensityGridWriterFields::get_scalar_double_heating_value(
                           property, heating, it);
@@ -306,7 +441,7 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
     uint_fast8_t scalar_index = 0;
     for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
          ++property) {
-      if (_fields.field_present(property)) {
+      if (fields.field_present(property)) {
         const std::string name = DensityGridWriterFields::get_name(property);
         if (DensityGridWriterFields::get_type(property) ==
             DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
@@ -316,7 +451,7 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
         } else {
           if (DensityGridWriterFields::is_ion_property(property)) {
             for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-              if (_fields.ion_present(property, ion)) {
+              if (fields.ion_present(property, ion)) {
                 const std::string prop_name = name + get_ion_name(ion);
                 HDF5Tools::append_dataset< double >(group, prop_name, offset,
                                                     scalar_props[scalar_index]);
@@ -326,7 +461,7 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
           } else if (DensityGridWriterFields::is_heating_property(property)) {
             for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
                  ++heating) {
-              if (_fields.heatingterm_present(property, heating)) {
+              if (fields.heatingterm_present(property, heating)) {
                 const std::string prop_name = name + get_ion_name(heating);
                 HDF5Tools::append_dataset< double >(group, prop_name, offset,
                                                     scalar_props[scalar_index]);
@@ -351,6 +486,10 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
 /**
  * @brief Write a snapshot for a split grid.
  *
+ * If the grid is distributed over multiple MPI processes, every process writes
+ * its own subgrids to a separate file, following the Gadget multi-file
+ * convention (prefix000.0.hdf5, prefix000.1.hdf5...).
+ *
  * @param grid_creator Grid.
  * @param counter Counter value to add to the snapshot file name.
  * @param params ParameterFile containing the run parameters that should be
@@ -361,8 +500,15 @@ void GadgetDensityGridWriter::write(
     DensitySubGridCreator< DensitySubGrid > &grid_creator,
     const uint_fast32_t counter, ParameterFile &params, double time) {
 
-  std::string filename = Utilities::compose_filename(_output_folder, _prefix,
-                                                     "hdf5", counter, _padding);
+  // HDF5 calls from different threads are not safe
+  wait_for_output();
+
+  std::string extension = "hdf5";
+  if (grid_creator.is_distributed()) {
+    extension = Utilities::to_string(grid_creator.get_MPI_rank()) + ".hdf5";
+  }
+  std::string filename = Utilities::compose_filename(
+      _output_folder, _prefix, extension, counter, _padding);
 
   if (_log) {
     _log->write_status("Writing file \"", filename, "\".");
@@ -380,7 +526,9 @@ void GadgetDensityGridWriter::write(
   //  field_flags[DENSITYGRIDFIELD_NEUTRAL_FRACTION] = 1;
   //  const DensityGridWriterFields fields(field_flags);
   // this line is what we actually want...
-  const DensityGridWriterFields &fields = _fields;
+  std::string coordinates_link;
+  const DensityGridWriterFields fields =
+      get_snapshot_fields(counter, extension, coordinates_link);
 
   HDF5Tools::HDF5File file =
       HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_WRITE);
@@ -397,17 +545,19 @@ void GadgetDensityGridWriter::write(
   std::vector< double > masstable(6, 0.);
   HDF5Tools::write_attribute< std::vector< double > >(group, "MassTable",
                                                       masstable);
-  int32_t numfiles = 1;
+  int32_t numfiles = grid_creator.get_MPI_size();
   HDF5Tools::write_attribute< int32_t >(group, "NumFilesPerSnapshot", numfiles);
   const uint64_t number_of_cells = grid_creator.number_of_cells();
   std::vector< uint32_t > numpart(6, 0);
-  numpart[0] = static_cast< uint32_t >(number_of_cells);
+  numpart[0] = static_cast< uint32_t >(grid_creator.number_of_local_cells());
+  std::vector< uint32_t > numpart_total(6, 0);
+  numpart_total[0] = static_cast< uint32_t >(number_of_cells);
   std::vector< uint32_t > numpart_high(6, 0);
   numpart_high[0] = static_cast< uint32_t >(number_of_cells >> 32);
   HDF5Tools::write_attribute< std::vector< uint32_t > >(
       group, "NumPart_ThisFile", numpart);
   HDF5Tools::write_attribute< std::vector< uint32_t > >(group, "NumPart_Total",
-                                                        numpart);
+                                                        numpart_total);
   HDF5Tools::write_attribute< std::vector< uint32_t > >(
       group, "NumPart_Total_HighWord", numpart_high);
   HDF5Tools::write_attribute< double >(group, "Time", time);
@@ -474,21 +624,31 @@ void GadgetDensityGridWriter::write(
   // to limit memory usage, we first create all datasets, and then add the data
   // in small blocks
   group = HDF5Tools::create_group(file, "PartType0");
+  if (!coordinates_link.empty()) {
+    HDF5Tools::create_external_link(group, "Coordinates", coordinates_link,
+                                    "/PartType0/Coordinates");
+  }
   for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
        ++property) {
     if (fields.field_present(property)) {
       const std::string name = DensityGridWriterFields::get_name(property);
+      const int_fast32_t precision =
+          get_hdf5_precision(fields.get_field_precision(property));
+      const int_fast32_t decimal_digits =
+          fields.get_field_decimal_digits(property);
       if (DensityGridWriterFields::get_type(property) ==
           DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
-        HDF5Tools::create_dataset< CoordinateVector<> >(group, name, numpart[0],
-                                                        _compression);
+        HDF5Tools::create_dataset< CoordinateVector<> >(
+            group, name, numpart[0], _compression, precision, decimal_digits,
+            _compression_level);
       } else {
         if (DensityGridWriterFields::is_ion_property(property)) {
           for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
             if (fields.ion_present(property, ion)) {
               const std::string prop_name = name + get_ion_name(ion);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
+              HDF5Tools::create_dataset< double >(
+                  group, prop_name, numpart[0], _compression, precision,
+                  decimal_digits, _compression_level);
             }
           }
         } else if (DensityGridWriterFields::is_heating_property(property)) {
@@ -496,23 +656,33 @@ void GadgetDensityGridWriter::write(
                ++heating) {
             if (fields.heatingterm_present(property, heating)) {
               const std::string prop_name = name + get_ion_name(heating);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
+              HDF5Tools::create_dataset< double >(
+                  group, prop_name, numpart[0], _compression, precision,
+                  decimal_digits, _compression_level);
             }
           }
         } else {
-          HDF5Tools::create_dataset< double >(group, name, numpart[0],
-                                              _compression);
+          HDF5Tools::create_dataset< double >(
+              group, name, numpart[0], _compression, precision, decimal_digits,
+              _compression_level);
         }
       }
     }
   }
 
-  const uint_fast32_t blocksize = 10000;
+  // blocks consist of a whole number of HDF5 chunks (of 1024 cells), so that
+  // compressed blocks can be written chunk by chunk if the number of cells in
+  // a subgrid is a multiple of the chunk size (see HDF5Tools::write_chunks())
+  const uint_fast32_t blocksize = 10240;
   uint_fast32_t block_offset = 0;
   for (auto gridit = grid_creator.begin();
        gridit != grid_creator.original_end(); ++gridit) {
 
+    // subgrids owned by other processes are written by those processes
+    if (!grid_creator.is_local(gridit.get_index())) {
+      continue;
+    }
+
     const uint_fast32_t numblock =
         (*gridit).get_number_of_cells() / blocksize +
         ((*gridit).get_number_of_cells() % blocksize > 0);
@@ -629,45 +799,25 @@ void GadgetDensityGridWriter::write(
 }
 
 /**
- * @brief Write a snapshot for a split grid with hydro.
+ * @brief Write the Header, Code, Configuration, Parameters, RuntimePars and
+ * Units groups of a snapshot for a split grid.
  *
- * @param grid_creator Grid.
- * @param counter Counter value to add to the snapshot file name.
- * @param params ParameterFile containing the run parameters that should be
- * written to the file.
+ * @param file Open snapshot file.
+ * @param boxsize Side lengths of the simulation box (in m).
+ * @param number_of_cells Number of cells in the snapshot.
  * @param time Simulation time (in s).
+ * @param counter Counter value of the snapshot.
+ * @param timestamp Creation time stamp.
+ * @param parameters Parameter key-value pairs.
  */
-void GadgetDensityGridWriter::write(
-    DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
-    const uint_fast32_t counter, ParameterFile &params, double time) {
-
-  std::string filename = Utilities::compose_filename(_output_folder, _prefix,
-                                                     "hdf5", counter, _padding);
-
-  if (_log) {
-    _log->write_status("Writing file \"", filename, "\".");
-  }
-
-  const Box<> box = grid_creator.get_box();
-
-  // we force output of the required fields for now
-  //  uint_fast32_t field_flags[DENSITYGRIDFIELD_NUMBER];
-  //  for (uint_fast32_t i = 0; i < DENSITYGRIDFIELD_NUMBER; ++i) {
-  //    field_flags[i] = 0;
-  //  }
-  //  field_flags[DENSITYGRIDFIELD_COORDINATES] = 1;
-  //  field_flags[DENSITYGRIDFIELD_NUMBER_DENSITY] = 1;
-  //  field_flags[DENSITYGRIDFIELD_NEUTRAL_FRACTION] = 1;
-  //  const DensityGridWriterFields fields(field_flags);
-  // this line is what we actually want...
-  const DensityGridWriterFields &fields = _fields;
-
-  HDF5Tools::HDF5File file =
-      HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_WRITE);
+static void write_split_grid_header(
+    HDF5Tools::HDF5File file, CoordinateVector<> boxsize,
+    const uint64_t number_of_cells, double time, const uint_fast32_t counter,
+    std::string timestamp,
+    const std::vector< std::pair< std::string, std::string > > &parameters) {
 
   // write header
   HDF5Tools::HDF5Group group = HDF5Tools::create_group(file, "Header");
-  CoordinateVector<> boxsize = box.get_sides();
   HDF5Tools::write_attribute< CoordinateVector<> >(group, "BoxSize", boxsize);
   int32_t dimension = 3;
   HDF5Tools::write_attribute< int32_t >(group, "Dimension", dimension);
@@ -679,7 +829,6 @@ void GadgetDensityGridWriter::write(
                                                       masstable);
   int32_t numfiles = 1;
   HDF5Tools::write_attribute< int32_t >(group, "NumFilesPerSnapshot", numfiles);
-  const uint64_t number_of_cells = grid_creator.number_of_cells();
   std::vector< uint32_t > numpart(6, 0);
   numpart[0] = static_cast< uint32_t >(number_of_cells);
   std::vector< uint32_t > numpart_high(6, 0);
@@ -714,16 +863,14 @@ void GadgetDensityGridWriter::write(
 
   // write parameters
   group = HDF5Tools::create_group(file, "Parameters");
-  for (auto it = params.begin(); it != params.end(); ++it) {
-    std::string key = it.get_key();
-    std::string value = it.get_value();
-    HDF5Tools::write_attribute< std::string >(group, key, value);
+  for (auto it = parameters.begin(); it != parameters.end(); ++it) {
+    std::string value = it->second;
+    HDF5Tools::write_attribute< std::string >(group, it->first, value);
   }
   HDF5Tools::close_group(group);
 
   // write runtime parameters
   group = HDF5Tools::create_group(file, "RuntimePars");
-  std::string timestamp = Utilities::get_timestamp();
   HDF5Tools::write_attribute< std::string >(group, "Creation time", timestamp);
   // an uint_fast32_t does not necessarily have the expected 32-bit size, while
   // we really need a 32-bit variable to write to the file
@@ -749,26 +896,105 @@ void GadgetDensityGridWriter::write(
   HDF5Tools::write_attribute< double >(group, "Unit time in cgs (U_t)",
                                        unit_time_in_cgs);
   HDF5Tools::close_group(group);
+}
+
+/**
+ * @brief Write a snapshot for a split grid with hydro.
+ *
+ * @param grid_creator Grid.
+ * @param counter Counter value to add to the snapshot file name.
+ * @param params ParameterFile containing the run parameters that should be
+ * written to the file.
+ * @param time Simulation time (in s).
+ */
+void GadgetDensityGridWriter::write(
+    DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+    const uint_fast32_t counter, ParameterFile &params, double time) {
+
+  std::string filename = Utilities::compose_filename(_output_folder, _prefix,
+                                                     "hdf5", counter, _padding);
+
+  if (_log) {
+    _log->write_status("Writing file \"", filename, "\".");
+  }
+
+  const Box<> box = grid_creator.get_box();
+
+  // we force output of the required fields for now
+  //  uint_fast32_t field_flags[DENSITYGRIDFIELD_NUMBER];
+  //  for (uint_fast32_t i = 0; i < DENSITYGRIDFIELD_NUMBER; ++i) {
+  //    field_flags[i] = 0;
+  //  }
+  //  field_flags[DENSITYGRIDFIELD_COORDINATES] = 1;
+  //  field_flags[DENSITYGRIDFIELD_NUMBER_DENSITY] = 1;
+  //  field_flags[DENSITYGRIDFIELD_NEUTRAL_FRACTION] = 1;
+  //  const DensityGridWriterFields fields(field_flags);
+  // this line is what we actually want...
+  std::string coordinates_link;
+  const DensityGridWriterFields fields =
+      get_snapshot_fields(counter, "hdf5", coordinates_link);
+
+  if (_asynchronous) {
+    // copy the data into the next free staging area while the previous
+    // snapshot (that used the other staging area) is possibly still being
+    // written
+    StagedSnapshot &snapshot = _staged_snapshots[_next_staged_snapshot];
+    snapshot._filename = filename;
+    snapshot._coordinates_link = coordinates_link;
+    stage_snapshot(grid_creator, fields, counter, params, time, snapshot);
+    // only one snapshot can be written at a time
+    wait_for_output();
+    _output_thread = std::thread(write_staged_snapshot, std::ref(snapshot),
+                                 _compression, _compression_level);
+    _next_staged_snapshot = 1 - _next_staged_snapshot;
+    return;
+  }
+
+  // HDF5 calls from different threads are not safe
+  wait_for_output();
+
+  HDF5Tools::HDF5File file =
+      HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_WRITE);
+
+  // write header, code info, configuration info, parameters, runtime
+  // parameters and units
+  std::vector< std::pair< std::string, std::string > > parameters;
+  for (auto it = params.begin(); it != params.end(); ++it) {
+    parameters.push_back(std::make_pair(it.get_key(), it.get_value()));
+  }
+  const uint64_t number_of_cells = grid_creator.number_of_cells();
+  write_split_grid_header(file, box.get_sides(), number_of_cells, time, counter,
+                          Utilities::get_timestamp(), parameters);
 
   // write particles
   // to limit memory usage, we first create all datasets, and then add the data
   // in small blocks
-  group = HDF5Tools::create_group(file, "PartType0");
+  HDF5Tools::HDF5Group group = HDF5Tools::create_group(file, "PartType0");
+  if (!coordinates_link.empty()) {
+    HDF5Tools::create_external_link(group, "Coordinates", coordinates_link,
+                                    "/PartType0/Coordinates");
+  }
   for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
        ++property) {
     if (fields.field_present(property)) {
       const std::string name = DensityGridWriterFields::get_name(property);
+      const int_fast32_t precision =
+          get_hdf5_precision(fields.get_field_precision(property));
+      const int_fast32_t decimal_digits =
+          fields.get_field_decimal_digits(property);
       if (DensityGridWriterFields::get_type(property) ==
           DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
-        HDF5Tools::create_dataset< CoordinateVector<> >(group, name, numpart[0],
-                                                        _compression);
+        HDF5Tools::create_dataset< CoordinateVector<> >(
+            group, name, number_of_cells, _compression, precision,
+            decimal_digits, _compression_level);
       } else {
         if (DensityGridWriterFields::is_ion_property(property)) {
           for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
             if (fields.ion_present(property, ion)) {
               const std::string prop_name = name + get_ion_name(ion);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
+              HDF5Tools::create_dataset< double >(
+                  group, prop_name, number_of_cells, _compression, precision,
+                  decimal_digits, _compression_level);
             }
           }
         } else if (DensityGridWriterFields::is_heating_property(property)) {
@@ -776,19 +1002,24 @@ void GadgetDensityGridWriter::write(
                ++heating) {
             if (fields.heatingterm_present(property, heating)) {
               const std::string prop_name = name + get_ion_name(heating);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
+              HDF5Tools::create_dataset< double >(
+                  group, prop_name, number_of_cells, _compression, precision,
+                  decimal_digits, _compression_level);
             }
           }
         } else {
-          HDF5Tools::create_dataset< double >(group, name, numpart[0],
-                                              _compression);
+          HDF5Tools::create_dataset< double >(
+              group, name, number_of_cells, _compression, precision,
+              decimal_digits, _compression_level);
         }
       }
     }
   }
 
-  const uint_fast32_t blocksize = 10000;
+  // blocks consist of a whole number of HDF5 chunks (of 1024 cells), so that
+  // compressed blocks can be written chunk by chunk if the number of cells in
+  // a subgrid is a multiple of the chunk size (see HDF5Tools::write_chunks())
+  const uint_fast32_t blocksize = 10240;
   uint_fast32_t block_offset = 0;
   for (auto gridit = grid_creator.begin();
        gridit != grid_creator.original_end(); ++gridit) {
@@ -907,3 +1138,189 @@ void GadgetDensityGridWriter::write(
   // close file
   HDF5Tools::close_file(file);
 }
+
+/**
+ * @brief Copy all data for a snapshot of a split grid with hydro into the
+ * given staging area.
+ *
+ * The field order is the same as in the synchronous write, so that both
+ * produce identical snapshot files.
+ *
+ * @param grid_creator Grid.
+ * @param fields Fields to write to the snapshot.
+ * @param counter Counter value of the snapshot.
+ * @param params ParameterFile containing the run parameters that should be
+ * written to the file.
+ * @param time Simulation time (in s).
+ * @param snapshot Staging area to fill.
+ */
+void GadgetDensityGridWriter::stage_snapshot(
+    DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+    const DensityGridWriterFields &fields, const uint_fast32_t counter,
+    ParameterFile &params, const double time, StagedSnapshot &snapshot) const {
+
+  const Box<> box = grid_creator.get_box();
+  const uint64_t number_of_cells = grid_creator.number_of_cells();
+
+  snapshot._box_sides = box.get_sides();
+  snapshot._number_of_cells = number_of_cells;
+  snapshot._time = time;
+  snapshot._counter = counter;
+  snapshot._timestamp = Utilities::get_timestamp();
+  snapshot._parameters.clear();
+  for (auto it = params.begin(); it != params.end(); ++it) {
+    snapshot._parameters.push_back(
+        std::make_pair(it.get_key(), it.get_value()));
+  }
+
+  snapshot._vector_names.clear();
+  snapshot._vector_precisions.clear();
+  snapshot._scalar_names.clear();
+  snapshot._scalar_precisions.clear();
+  for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
+       ++property) {
+    if (fields.field_present(property)) {
+      const std::string name = DensityGridWriterFields::get_name(property);
+      const std::pair< int_fast32_t, int_fast32_t > precision =
+          std::make_pair(
+              get_hdf5_precision(fields.get_field_precision(property)),
+              fields.get_field_decimal_digits(property));
+      if (DensityGridWriterFields::get_type(property) ==
+          DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
+        snapshot._vector_names.push_back(name);
+        snapshot._vector_precisions.push_back(precision);
+      } else {
+        if (DensityGridWriterFields::is_ion_property(property)) {
+          for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+            if (fields.ion_present(property, ion)) {
+              snapshot._scalar_names.push_back(name + get_ion_name(ion));
+              snapshot._scalar_precisions.push_back(precision);
+            }
+          }
+        } else if (DensityGridWriterFields::is_heating_property(property)) {
+          for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
+               ++heating) {
+            if (fields.heatingterm_present(property, heating)) {
+              snapshot._scalar_names.push_back(name + get_ion_name(heating));
+              snapshot._scalar_precisions.push_back(precision);
+            }
+          }
+        } else {
+          snapshot._scalar_names.push_back(name);
+          snapshot._scalar_precisions.push_back(precision);
+        }
+      }
+    }
+  }
+
+  // the staging area keeps its memory in between snapshots, so that we do
+  // not need to reallocate it every time
+  snapshot._vector_values.resize(snapshot._vector_names.size());
+  for (size_t i = 0; i < snapshot._vector_values.size(); ++i) {
+    snapshot._vector_values[i].resize(number_of_cells);
+  }
+  snapshot._scalar_values.resize(snapshot._scalar_names.size());
+  for (size_t i = 0; i < snapshot._scalar_values.size(); ++i) {
+    snapshot._scalar_values[i].resize(number_of_cells);
+  }
+
+  size_t index = 0;
+  for (auto gridit = grid_creator.begin();
+       gridit != grid_creator.original_end(); ++gridit) {
+    for (auto cellit = (*gridit).hydro_begin();
+         cellit != (*gridit).hydro_end(); ++cellit) {
+      uint_fast8_t vector_index = 0;
+      uint_fast8_t scalar_index = 0;
+      for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
+           ++property) {
+        if (fields.field_present(property)) {
+          if (DensityGridWriterFields::get_type(property) ==
+              DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
+            snapshot._vector_values[vector_index][index] =
+                DensityGridWriterFields::get_vector_double_value(
+                    property, cellit, box.get_anchor());
+            ++vector_index;
+          } else {
+            if (DensityGridWriterFields::is_ion_property(property)) {
+              for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+                if (fields.ion_present(property, ion)) {
+                  snapshot._scalar_values[scalar_index][index] =
+                      DensityGridWriterFields::get_scalar_double_ion_value(
+                          property, ion, cellit);
+                  ++scalar_index;
+                }
+              }
+            } else if (DensityGridWriterFields::is_heating_property(
+                           property)) {
+              for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
+                   ++heating) {
+                if (fields.heatingterm_present(property, heating)) {
+                  snapshot._scalar_values[scalar_index][index] =
+                      DensityGridWriterFields::get_scalar_double_heating_value(
+                          property, heating, cellit);
+                  ++scalar_index;
+                }
+              }
+            } else {
+              snapshot._scalar_values[scalar_index][index] =
+                  DensityGridWriterFields::get_scalar_double_value(property,
+                                                                   cellit);
+              ++scalar_index;
+            }
+          }
+        }
+      }
+      ++index;
+    }
+  }
+}
+
+/**
+ * @brief Write the given staged snapshot to its file.
+ *
+ * This function is executed by the output thread and does not access any
+ * simulation data. The output thread runs concurrently with the OpenMP threads
+ * of the simulation, so it compresses the data serially.
+ *
+ * @param snapshot Staged snapshot.
+ * @param compression Compress the HDF5 output?
+ * @param compression_level Deflate compression level used for compressed
+ * output.
+ */
+void GadgetDensityGridWriter::write_staged_snapshot(
+    StagedSnapshot &snapshot, const bool compression,
+    const int_fast32_t compression_level) {
+
+  HDF5Tools::HDF5File file =
+      HDF5Tools::open_file(snapshot._filename, HDF5Tools::HDF5FILEMODE_WRITE);
+
+  write_split_grid_header(file, snapshot._box_sides, snapshot._number_of_cells,
+                          snapshot._time, snapshot._counter,
+                          snapshot._timestamp, snapshot._parameters);
+
+  HDF5Tools::HDF5Group group = HDF5Tools::create_group(file, "PartType0");
+  if (!snapshot._coordinates_link.empty()) {
+    HDF5Tools::create_external_link(group, "Coordinates",
+                                    snapshot._coordinates_link,
+                                    "/PartType0/Coordinates");
+  }
+  for (size_t i = 0; i < snapshot._vector_names.size(); ++i) {
+    HDF5Tools::create_dataset< CoordinateVector<> >(
+        group, snapshot._vector_names[i], snapshot._number_of_cells,
+        compression, snapshot._vector_precisions[i].first,
+        snapshot._vector_precisions[i].second, compression_level);
+    HDF5Tools::append_dataset< CoordinateVector<> >(
+        group, snapshot._vector_names[i], 0, snapshot._vector_values[i], 1);
+  }
+  for (size_t i = 0; i < snapshot._scalar_names.size(); ++i) {
+    HDF5Tools::create_dataset< double >(
+        group, snapshot._scalar_names[i], snapshot._number_of_cells,
+        compression, snapshot._scalar_precisions[i].first,
+        snapshot._scalar_precisions[i].second, compression_level);
+    HDF5Tools::append_dataset< double >(group, snapshot._scalar_names[i], 0,
+                                        snapshot._scalar_values[i], 1);
+  }
+  HDF5Tools::close_group(group);
+
+  HDF5Tools::close_file(file);
+}
@@ -26,17 +26,88 @@
 #ifndef GADGETDENSITYGRIDWRITER_HPP
 #define GADGETDENSITYGRIDWRITER_HPP
 
+#include "CoordinateVector.hpp"
 #include "DensityGridWriter.hpp"
 
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 class ParameterFile;
 
 /**
  * @brief HDF5-file writer for the DensityGrid.
+ *
+ * For split grids with hydro, the writer can optionally write snapshots
+ * asynchronously: all output fields are copied into a staging area on the
+ * calling thread, after which a dedicated output thread writes (and
+ * compresses) the snapshot, while the simulation continues. There are two
+ * staging areas, so that the next snapshot can be copied while the previous
+ * one is still being written. The writer waits for the output thread to finish
+ * before it starts a new write and when it is destroyed. No other HDF5 calls
+ * should be made while an asynchronous write is in progress, unless the HDF5
+ * library was built with thread safety enabled.
+ *
+ * The precision of the output fields is set using the DensityGridWriterFields.
+ * Reduced precision fields are converted back to double precision by HDF5 when
+ * they are read, so that they are transparent to analysis scripts. For static
+ * grids, the coordinates can be written to the first snapshot only; all later
+ * snapshots then contain an HDF5 external link to these coordinates.
  */
 class GadgetDensityGridWriter : public DensityGridWriter {
 private:
+  /**
+   * @brief Copy of all data in a snapshot, waiting to be written by the output
+   * thread.
+   */
+  struct StagedSnapshot {
+    /*! @brief Name of the snapshot file. */
+    std::string _filename;
+
+    /*! @brief Side lengths of the simulation box (in m). */
+    CoordinateVector<> _box_sides;
+
+    /*! @brief Number of cells in the snapshot. */
+    uint64_t _number_of_cells;
+
+    /*! @brief Simulation time (in s). */
+    double _time;
+
+    /*! @brief Counter value of the snapshot. */
+    uint32_t _counter;
+
+    /*! @brief Time stamp at the time the snapshot was taken. */
+    std::string _timestamp;
+
+    /*! @brief Parameter key-value pairs. */
+    std::vector< std::pair< std::string, std::string > > _parameters;
+
+    /*! @brief Name of the file that contains the coordinates, if the
+     *  coordinates are linked rather than written (empty otherwise). */
+    std::string _coordinates_link;
+
+    /*! @brief Names of the vector datasets. */
+    std::vector< std::string > _vector_names;
+
+    /*! @brief Values of the vector datasets. */
+    std::vector< std::vector< CoordinateVector<> > > _vector_values;
+
+    /*! @brief HDF5Precision and number of decimal digits for the vector
+     *  datasets. */
+    std::vector< std::pair< int_fast32_t, int_fast32_t > > _vector_precisions;
+
+    /*! @brief Names of the scalar datasets. */
+    std::vector< std::string > _scalar_names;
+
+    /*! @brief Values of the scalar datasets. */
+    std::vector< std::vector< double > > _scalar_values;
+
+    /*! @brief HDF5Precision and number of decimal digits for the scalar
+     *  datasets. */
+    std::vector< std::pair< int_fast32_t, int_fast32_t > > _scalar_precisions;
+  };
+
   /*! @brief Prefix of the name for the file to write. */
   const std::string _prefix;
 
@@ -46,16 +117,70 @@ private:
   /*! @brief Compress the HDF5 output? */
   const bool _compression;
 
+  /*! @brief Deflate compression level used for compressed output. */
+  const int_fast32_t _compression_level;
+
+  /*! @brief Write snapshots for split grids with hydro asynchronously? */
+  const bool _asynchronous;
+
+  /*! @brief Staging areas for asynchronous output. */
+  StagedSnapshot _staged_snapshots[2];
+
+  /*! @brief Index of the staging area that will be used for the next
+   *  asynchronous write. */
+  uint_fast8_t _next_staged_snapshot;
+
+  /*! @brief Output thread used for asynchronous writes. */
+  std::thread _output_thread;
+
+  /*! @brief Only write the coordinates to the first snapshot? */
+  const bool _coordinates_once;
+
+  /*! @brief Name of the snapshot file that contains the coordinates (relative
+   *  to the output folder; empty if no coordinates were written yet). */
+  std::string _coordinates_file;
+
+  DensityGridWriterFields get_snapshot_fields(const uint_fast32_t counter,
+                                              const std::string extension,
+                                              std::string &coordinates_link);
+
+  void stage_snapshot(
+      DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+      const DensityGridWriterFields &fields, const uint_fast32_t counter,
+      ParameterFile &params, const double time,
+      StagedSnapshot &snapshot) const;
+
+  static void write_staged_snapshot(StagedSnapshot &snapshot,
+                                    const bool compression,
+                                    const int_fast32_t compression_level);
+
 public:
   GadgetDensityGridWriter(
       std::string prefix, std::string output_folder = std::string("."),
       const bool hydro = false,
       const DensityGridWriterFields fields = DensityGridWriterFields(false),
       Log *log = nullptr, uint_fast8_t padding = 3,
-      const bool compression = false);
+      const bool compression = false, const bool asynchronous = false,
+      const bool coordinates_once = false,
+      const int_fast32_t compression_level = 9);
   GadgetDensityGridWriter(std::string output_folder, ParameterFile &params,
                           const bool hydro, Log *log = nullptr);
 
+  virtual ~GadgetDensityGridWriter();
+
+  void wait_for_output();
+
+  /**
+   * @brief Check if the writer can write snapshots for a split grid that is
+   * distributed over multiple MPI processes.
+   *
+   * Every process writes its own subgrids to a file with the process rank
+   * added to the snapshot file name.
+   *
+   * @return True.
+   */
+  virtual bool supports_distributed_output() const { return true; }
+
   virtual void write(DensityGrid &grid, uint_fast32_t iteration,
                      ParameterFile &params, double time = 0.,
                      const InternalHydroUnits *hydro_units = nullptr);
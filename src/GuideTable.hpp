@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file GuideTable.hpp
+ *
+ * @brief Guide table that speeds up locating values in an ordered array.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef GUIDETABLE_HPP
+#define GUIDETABLE_HPP
+
+#include "Error.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Guide table that speeds up locating values in an ordered array.
+ *
+ * The guide table divides the range of the ordered array in a number of equal
+ * width guide bins, and stores the index of the array element at the lower
+ * edge of every guide bin. A value is located by computing its guide bin and
+ * walking from the stored index to the correct array element. If the number of
+ * guide bins is similar to the number of array elements, only a few steps are
+ * needed on average, so that locating a value is essentially a constant time
+ * operation, as opposed to the logarithmic cost of bisection (Chen, H.-C. &
+ * Asau, Y. 1974, Annals of the Institute of Statistical Mathematics, 26, 273;
+ * https://doi.org/10.1007/BF02479823).
+ *
+ * The result of locate() is always identical to the result of
+ * Utilities::locate() for the same array, so that a guide table can be used as
+ * a drop-in replacement for sampling cumulative distribution functions.
+ *
+ * The guide table does not store the array itself, so that a single guide table
+ * implementation can be used for arrays stored in any kind of container. The
+ * array should be passed on to every call of locate() and should not change
+ * after the guide table was initialized.
+ */
+class GuideTable {
+private:
+  /*! @brief Index of the array element at the lower edge of each guide bin. */
+  std::vector< uint_fast32_t > _guide;
+
+  /*! @brief First value in the array. */
+  double _minimum;
+
+  /*! @brief Inverse width of a single guide bin. */
+  double _inverse_width;
+
+  /*! @brief Length of the array. */
+  uint_fast32_t _length;
+
+public:
+  /**
+   * @brief Empty constructor.
+   *
+   * The guide table needs to be initialized using initialize() before it can
+   * be used.
+   */
+  inline GuideTable() : _minimum(0.), _inverse_width(0.), _length(0) {}
+
+  /**
+   * @brief Constructor.
+   *
+   * @param values Ordered array.
+   * @param length Length of the array.
+   * @param number_of_guides Number of guide bins (default: same as the length
+   * of the array).
+   */
+  inline GuideTable(const double *values, const uint_fast32_t length,
+                    const uint_fast32_t number_of_guides = 0) {
+    initialize(values, length, number_of_guides);
+  }
+
+  /**
+   * @brief (Re)initialize the guide table for the given ordered array.
+   *
+   * @param values Ordered array.
+   * @param length Length of the array.
+   * @param number_of_guides Number of guide bins (default: same as the length
+   * of the array).
+   */
+  inline void initialize(const double *values, const uint_fast32_t length,
+                         uint_fast32_t number_of_guides = 0) {
+
+    cmac_assert_message(length >= 2, "Guide tables need at least 2 values!");
+
+    if (number_of_guides == 0) {
+      number_of_guides = length;
+    }
+
+    _length = length;
+    _minimum = values[0];
+    const double range = values[length - 1] - values[0];
+    if (range > 0.) {
+      _inverse_width = number_of_guides / range;
+    } else {
+      _inverse_width = 0.;
+      number_of_guides = 1;
+    }
+
+    _guide.resize(number_of_guides);
+    uint_fast32_t index = 0;
+    for (uint_fast32_t i = 0; i < number_of_guides; ++i) {
+      const double lower_edge = _minimum + i * range / number_of_guides;
+      while (index < _length - 2 && values[index + 1] < lower_edge) {
+        ++index;
+      }
+      _guide[i] = index;
+    }
+  }
+
+  /**
+   * @brief Get the index of the last element in the given ordered array that
+   * is smaller than the given value.
+   *
+   * Like Utilities::locate(), this function always returns a value in the
+   * range [0, length-2], even if the given value is outside the array.
+   *
+   * @param x Value to locate.
+   * @param values Ordered array that was used to initialize the guide table.
+   * @return Index of the last element in the ordered array that is smaller than
+   * the given value, i.e. value is in between values[index] and
+   * values[index+1].
+   */
+  inline uint_fast32_t locate(const double x, const double *values) const {
+
+    cmac_assert_message(_length >= 2, "Guide table was not initialized!");
+
+    const double guide_position = (x - _minimum) * _inverse_width;
+    uint_fast32_t guide_index = 0;
+    if (guide_position >= _guide.size()) {
+      guide_index = _guide.size() - 1;
+    } else if (guide_position > 0.) {
+      guide_index = guide_position;
+    }
+
+    // the stored index is only a guess (round off can affect the guide bin
+    // edges), so we walk in both directions to make sure the result is
+    // identical to bisection
+    uint_fast32_t index = _guide[guide_index];
+    while (index > 0 && !(x > values[index])) {
+      --index;
+    }
+    while (index < _length - 2 && x > values[index + 1]) {
+      ++index;
+    }
+    return index;
+  }
+};
+
+#endif // GUIDETABLE_HPP
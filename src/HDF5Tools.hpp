@@ -27,16 +27,34 @@
 #ifndef HDF5TOOLS_HPP
 #define HDF5TOOLS_HPP
 
+#include "Configuration.hpp"
 #include "CoordinateVector.hpp"
 #include "Error.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cinttypes>
+#include <cmath>
+#include <cstring>
 #include <hdf5.h>
 #include <map>
 #include <string>
 #include <vector>
 
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+// we can only write compressed chunks directly if we can compress them
+// ourselves and if the HDF5 library supports direct chunk writes (HDF5 1.10.3
+// and newer)
+#if defined(HAVE_ZLIB) && !defined(HDF5_OLD_API)
+#if H5_VERSION_GE(1, 10, 3)
+#define HDF5TOOLS_DIRECT_CHUNK_WRITE
+#include <zlib.h>
+#endif
+#endif
+
 /**
  * @brief Custom wrappers around some HDF5 library functions that feel more like
  * C++.
@@ -59,6 +77,23 @@ enum HDF5FileMode {
   HDF5FILEMODE_APPEND
 };
 
+/*! @brief Precisions with which a floating point dataset can be stored. */
+enum HDF5Precision {
+  /*! @brief Full double precision. */
+  HDF5PRECISION_DOUBLE = 0,
+  /*! @brief 32-bit single precision floating point values. */
+  HDF5PRECISION_FLOAT32,
+  /*! @brief 16-bit half precision floating point values. */
+  HDF5PRECISION_FLOAT16,
+  /*! @brief Double precision values that are quantised with a fixed number of
+   *  decimal digits using the HDF5 scale-offset filter. */
+  HDF5PRECISION_QUANTISED,
+  /*! @brief Double precision values that are rounded to a fixed number of
+   *  significant decimal digits (a relative precision), so that the trailing
+   *  mantissa bits are zero and compress well. */
+  HDF5PRECISION_SIGNIFICANT
+};
+
 /**
  * @brief Turn off default HDF5 error handling.
  */
@@ -184,6 +219,34 @@ inline void close_group(hid_t group) {
   }
 }
 
+/**
+ * @brief Create a link with the given name in the given group that points to
+ * an object in another HDF5 file.
+ *
+ * The linked object can be accessed as if it were part of the group. If the
+ * given file name is a relative path, HDF5 looks for the file in the current
+ * working directory and in the directory of the file that contains the link.
+ *
+ * @param group HDF5Group handle to an open group.
+ * @param name Name of the link.
+ * @param filename Name of the file that contains the linked object.
+ * @param object_name Full path of the linked object within that file.
+ */
+inline void create_external_link(hid_t group, std::string name,
+                                 std::string filename,
+                                 std::string object_name) {
+#ifdef HDF5_OLD_API
+  cmac_error("External links are not supported by this HDF5 version!");
+#else
+  const herr_t hdf5status =
+      H5Lcreate_external(filename.c_str(), object_name.c_str(), group,
+                         name.c_str(), H5P_DEFAULT, H5P_DEFAULT);
+  if (hdf5status < 0) {
+    cmac_error("Failed to create external link \"%s\"!", name.c_str());
+  }
+#endif
+}
+
 /**
  * @brief Get the HDF5 data type corresponding to the template typename.
  *
@@ -241,6 +304,134 @@ template <> inline hid_t get_datatype_name< int32_t >() {
   return H5T_NATIVE_INT32;
 }
 
+/**
+ * @brief Get the HDF5 data type used to store floating point values with the
+ * given precision in a file.
+ *
+ * HDF5 automatically converts double precision values in memory to this data
+ * type when writing, and back to double precision when reading, so that the
+ * precision of a dataset is completely transparent to readers.
+ *
+ * @param precision HDF5Precision.
+ * @return hid_t handle for a copy of the data type, that should be closed using
+ * H5Tclose() after use.
+ */
+inline hid_t get_precision_datatype(const int_fast32_t precision) {
+
+  hid_t datatype = -1;
+  switch (precision) {
+  case HDF5PRECISION_DOUBLE:
+  case HDF5PRECISION_QUANTISED:
+  case HDF5PRECISION_SIGNIFICANT:
+    // quantisation is done by a filter or by rounding the values before they
+    // are written, the data type itself does not change
+    datatype = H5Tcopy(H5T_NATIVE_DOUBLE);
+    break;
+  case HDF5PRECISION_FLOAT32:
+    datatype = H5Tcopy(H5T_NATIVE_FLOAT);
+    break;
+  case HDF5PRECISION_FLOAT16:
+    // HDF5 does not have a predefined half precision type, so we construct an
+    // IEEE 754 binary16 type: 1 sign bit, 5 exponent bits and 10 mantissa bits
+    datatype = H5Tcopy(H5T_IEEE_F32LE);
+    if (datatype >= 0) {
+      if (H5Tset_fields(datatype, 15, 10, 5, 0, 10) < 0 ||
+          H5Tset_size(datatype, 2) < 0 || H5Tset_ebias(datatype, 15) < 0 ||
+          H5Tset_precision(datatype, 16) < 0 ||
+          H5Tset_norm(datatype, H5T_NORM_IMPLIED) < 0 ||
+          H5Tset_inpad(datatype, H5T_PAD_ZERO) < 0) {
+        cmac_error("Failed to set up half precision data type!");
+      }
+    }
+    break;
+  default:
+    cmac_error("Unknown HDF5Precision: %" PRIiFAST32, precision);
+  }
+  if (datatype < 0) {
+    cmac_error("Failed to create data type!");
+  }
+  return datatype;
+}
+
+/**
+ * @brief Add the filter that is required for the given precision (if any) to
+ * the given dataset creation property list.
+ *
+ * @param prop Dataset creation property list (with chunking enabled).
+ * @param name Name of the dataset (for error messages).
+ * @param precision HDF5Precision.
+ * @param decimal_digits Number of decimal digits that is kept for quantised
+ * or significant datasets.
+ */
+inline void set_precision_filter(hid_t prop, std::string name,
+                                 const int_fast32_t precision,
+                                 const int_fast32_t decimal_digits) {
+
+  if (precision != HDF5PRECISION_QUANTISED &&
+      precision != HDF5PRECISION_SIGNIFICANT) {
+    return;
+  }
+
+  if (decimal_digits < 1) {
+    cmac_error("No number of decimal digits given for reduced precision "
+               "dataset \"%s\"!",
+               name.c_str());
+  }
+
+  if (precision == HDF5PRECISION_SIGNIFICANT) {
+    // significant datasets are rounded before they are written, see
+    // round_significant_values()
+    return;
+  }
+
+#ifdef HDF5_OLD_API
+  cmac_error("Quantised datasets are not supported by this HDF5 version!");
+#else
+  const herr_t hdf5status =
+      H5Pset_scaleoffset(prop, H5Z_SO_FLOAT_DSCALE, decimal_digits);
+  if (hdf5status < 0) {
+    cmac_error("Failed to set scale-offset filter for dataset \"%s\"",
+               name.c_str());
+  }
+#endif
+}
+
+/**
+ * @brief Add the compression filters to the given dataset creation property
+ * list.
+ *
+ * The data is protected with a Fletcher32 checksum, shuffled and deflated.
+ *
+ * @param prop Dataset creation property list (with chunking enabled).
+ * @param name Name of the dataset (for error messages).
+ * @param compression_level Deflate compression level (1: fastest, 9: smallest
+ * output).
+ */
+inline void set_compression_filters(hid_t prop, std::string name,
+                                    const int_fast32_t compression_level) {
+
+  if (compression_level < 1 || compression_level > 9) {
+    cmac_error("Invalid compression level for dataset \"%s\": %" PRIiFAST32
+               " (should be in the range [1, 9])!",
+               name.c_str(), compression_level);
+  }
+
+  herr_t hdf5status = H5Pset_fletcher32(prop);
+  if (hdf5status < 0) {
+    cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
+               name.c_str());
+  }
+  hdf5status = H5Pset_shuffle(prop);
+  if (hdf5status < 0) {
+    cmac_error("Failed to set shuffle filter for dataset \"%s\"",
+               name.c_str());
+  }
+  hdf5status = H5Pset_deflate(prop, compression_level);
+  if (hdf5status < 0) {
+    cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
+  }
+}
+
 /**
  * @brief Read the attribute with the given name of the given group.
  *
@@ -1333,6 +1524,542 @@ inline HDF5Dictionary< _datatype_ > read_dictionary(hid_t group,
   return HDF5Dictionary< _datatype_ >(dictionary);
 }
 
+/**
+ * @brief Get the IEEE 754 binary16 representation of the given value.
+ *
+ * Values are rounded to the nearest representable value (ties to even), values
+ * that are too large become infinity.
+ *
+ * @param value Value.
+ * @return Bits of the corresponding half precision value.
+ */
+inline uint16_t get_half_precision_bits(const double value) {
+
+  const uint16_t sign = std::signbit(value) ? 0x8000 : 0;
+  const double abs_value = std::abs(value);
+  if (std::isnan(value)) {
+    return sign | 0x7e00;
+  }
+  // values above the midpoint between the largest half (65504) and the next
+  // (non-existent) value round to infinity
+  if (abs_value >= 65520.) {
+    return sign | 0x7c00;
+  }
+  if (abs_value < 6.103515625e-5) {
+    // subnormal value: the mantissa counts multiples of 2^-24. If it rounds to
+    // 1024, the bits automatically represent the smallest normal value
+    return sign | static_cast< uint16_t >(std::rint(abs_value * 16777216.));
+  }
+  int exponent;
+  const double mantissa = std::frexp(abs_value, &exponent);
+  // abs_value = (2 * mantissa) * 2^(exponent - 1), with 2 * mantissa in [1, 2)
+  uint_fast32_t bits = std::rint((2. * mantissa - 1.) * 1024.);
+  uint_fast32_t biased_exponent = exponent - 1 + 15;
+  if (bits == 1024) {
+    bits = 0;
+    ++biased_exponent;
+  }
+  return sign | static_cast< uint16_t >((biased_exponent << 10) | bits);
+}
+
+/**
+ * @brief Round the given value to the given number of significant decimal
+ * digits.
+ *
+ * We keep the smallest number of mantissa bits that resolves the requested
+ * number of decimal digits and round the remaining bits to the nearest value
+ * (ties away from zero). A carry into the exponent is handled automatically by
+ * the binary representation. Since the dropped bits are all zero, shuffled
+ * and deflated datasets compress almost as well as float32 or float16
+ * datasets, while the relative precision is the same for very small and very
+ * large values.
+ *
+ * @param value Value.
+ * @param significant_digits Number of significant decimal digits.
+ * @return Rounded value.
+ */
+inline double
+round_to_significant_digits(const double value,
+                            const uint_fast32_t significant_digits) {
+
+  // log2(10) = 3.32...
+  const uint_fast32_t mantissa_bits =
+      std::ceil(significant_digits * 3.321928094887362);
+  if (mantissa_bits >= 52 || !std::isfinite(value)) {
+    return value;
+  }
+  const uint_fast32_t dropped_bits = 52 - mantissa_bits;
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(double));
+  bits += uint64_t(1) << (dropped_bits - 1);
+  bits &= ~((uint64_t(1) << dropped_bits) - 1);
+  double rounded;
+  std::memcpy(&rounded, &bits, sizeof(double));
+  return rounded;
+}
+
+/**
+ * @brief Round the given values to the number of significant digits of the
+ * given dataset, if it is a HDF5PRECISION_SIGNIFICANT dataset.
+ *
+ * Only double precision datasets can have a reduced precision, so this
+ * version does nothing.
+ *
+ * @param dataset Open dataset.
+ * @param data Values to round.
+ * @param size Number of values.
+ */
+template < typename _datatype_ >
+inline void round_significant_values(hid_t dataset, _datatype_ *data,
+                                     const size_t size) {}
+
+/**
+ * @brief round_significant_values() specialization for double precision
+ * values.
+ *
+ * The number of significant digits is stored in the SignificantDigits
+ * attribute of the dataset (see create_dataset()).
+ *
+ * @param dataset Open dataset.
+ * @param data Values to round.
+ * @param size Number of values.
+ */
+template <>
+inline void round_significant_values< double >(hid_t dataset, double *data,
+                                               const size_t size) {
+
+  const htri_t has_digits = H5Aexists(dataset, "SignificantDigits");
+  if (has_digits < 0) {
+    cmac_error("Failed to check for significant digits attribute!");
+  }
+  if (has_digits == 0) {
+    return;
+  }
+  const uint32_t significant_digits =
+      read_attribute< uint32_t >(dataset, "SignificantDigits");
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = round_to_significant_digits(data[i], significant_digits);
+  }
+}
+
+/**
+ * @brief Write the given values to the given selection of the given dataset.
+ *
+ * @param dataset Open dataset.
+ * @param memspace Memory space of the values.
+ * @param filespace Selected file space of the dataset.
+ * @param data Values to write.
+ * @param size Number of values.
+ * @return Status of the HDF5 write.
+ */
+template < typename _datatype_ >
+inline herr_t write_values(hid_t dataset, hid_t memspace, hid_t filespace,
+                           const _datatype_ *data, const size_t size) {
+  return H5Dwrite(dataset, get_datatype_name< _datatype_ >(), memspace,
+                  filespace, H5P_DEFAULT, data);
+}
+
+/**
+ * @brief Write the given double precision values to the given selection of
+ * the given dataset.
+ *
+ * For half precision datasets, we do the conversion ourselves: HDF5 (at least
+ * version 1.10) occasionally loses the carry into the exponent when it rounds
+ * values to a custom floating point type, so that e.g. 1023.94 is stored as
+ * 512.
+ *
+ * @param dataset Open dataset.
+ * @param memspace Memory space of the values.
+ * @param filespace Selected file space of the dataset.
+ * @param data Values to write.
+ * @param size Number of values.
+ * @return Status of the HDF5 write.
+ */
+template <>
+inline herr_t write_values< double >(hid_t dataset, hid_t memspace,
+                                     hid_t filespace, const double *data,
+                                     const size_t size) {
+
+  const hid_t filetype = H5Dget_type(dataset);
+  if (filetype < 0) {
+    return filetype;
+  }
+  const bool half_precision =
+      H5Tget_class(filetype) == H5T_FLOAT && H5Tget_size(filetype) == 2;
+  herr_t hdf5status = H5Tclose(filetype);
+  if (hdf5status < 0) {
+    return hdf5status;
+  }
+
+  if (!half_precision) {
+    return H5Dwrite(dataset, H5T_NATIVE_DOUBLE, memspace, filespace,
+                    H5P_DEFAULT, data);
+  }
+
+  std::vector< uint16_t > half_data(size);
+  for (size_t i = 0; i < size; ++i) {
+    half_data[i] = get_half_precision_bits(data[i]);
+  }
+  // the memory type only differs from the file type in byte order (if at all)
+  const hid_t memtype = get_precision_datatype(HDF5PRECISION_FLOAT16);
+  hdf5status = H5Tset_order(memtype, H5Tget_order(H5T_NATIVE_UINT16));
+  if (hdf5status >= 0) {
+    hdf5status = H5Dwrite(dataset, memtype, memspace, filespace, H5P_DEFAULT,
+                          half_data.data());
+  }
+  const herr_t closestatus = H5Tclose(memtype);
+  return (hdf5status < 0) ? hdf5status : closestatus;
+}
+
+/**
+ * @brief Get the Fletcher32 checksum of the given data, as computed by the HDF5
+ * Fletcher32 filter.
+ *
+ * @param data Data.
+ * @param size Size of the data (in bytes).
+ * @return Checksum.
+ */
+inline uint32_t get_fletcher32_checksum(const unsigned char *data,
+                                        const size_t size) {
+
+  uint32_t sum1 = 0;
+  uint32_t sum2 = 0;
+  size_t length = size / 2;
+  while (length > 0) {
+    // the sums cannot overflow within 360 steps
+    const size_t block_length = std::min(length, size_t(360));
+    length -= block_length;
+    for (size_t i = 0; i < block_length; ++i) {
+      sum1 += (static_cast< uint32_t >(data[0]) << 8) | data[1];
+      data += 2;
+      sum2 += sum1;
+    }
+    sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+    sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  }
+  if (size % 2 == 1) {
+    sum1 += static_cast< uint32_t >(data[0]) << 8;
+    sum2 += sum1;
+    sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+    sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  }
+  sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+  sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  return (sum2 << 16) | sum1;
+}
+
+/**
+ * @brief Apply the given filter pipeline to the given chunk.
+ *
+ * Only the filters set by set_compression_filters() are supported. The result
+ * is identical to what the HDF5 library would store.
+ *
+ * @param chunk Raw chunk, replaced by the filtered chunk.
+ * @param filters Filter identifiers and their first parameter (the element size
+ * for the shuffle filter, the compression level for the deflate filter), in the
+ * order in which the filters need to be applied.
+ * @return True if the chunk was filtered successfully.
+ */
+inline bool
+filter_chunk(std::vector< unsigned char > &chunk,
+             const std::vector< std::pair< H5Z_filter_t, unsigned int > >
+                 &filters) {
+
+  std::vector< unsigned char > buffer;
+  for (size_t ifilter = 0; ifilter < filters.size(); ++ifilter) {
+    switch (filters[ifilter].first) {
+    case H5Z_FILTER_FLETCHER32: {
+      // the checksum is appended in little endian byte order
+      const uint32_t checksum =
+          get_fletcher32_checksum(chunk.data(), chunk.size());
+      for (uint_fast8_t i = 0; i < 4; ++i) {
+        chunk.push_back((checksum >> (8 * i)) & 0xff);
+      }
+      break;
+    }
+    case H5Z_FILTER_SHUFFLE: {
+      // byte j of element i is moved to position j * number_of_elements + i,
+      // trailing bytes that do not form a complete element stay where they are
+      const size_t element_size = filters[ifilter].second;
+      if (element_size > 1 && chunk.size() / element_size > 1) {
+        const size_t number_of_elements = chunk.size() / element_size;
+        buffer.assign(chunk.begin(), chunk.end());
+        for (size_t j = 0; j < element_size; ++j) {
+          for (size_t i = 0; i < number_of_elements; ++i) {
+            chunk[j * number_of_elements + i] = buffer[i * element_size + j];
+          }
+        }
+      }
+      break;
+    }
+#ifdef HDF5TOOLS_DIRECT_CHUNK_WRITE
+    case H5Z_FILTER_DEFLATE: {
+      uLongf compressed_size = compressBound(chunk.size());
+      buffer.resize(compressed_size);
+      if (compress2(buffer.data(), &compressed_size, chunk.data(),
+                    chunk.size(), filters[ifilter].second) != Z_OK) {
+        return false;
+      }
+      buffer.resize(compressed_size);
+      chunk.swap(buffer);
+      break;
+    }
+#endif
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Get the size of a single value in a dataset with the given file data
+ * type, if we can convert values of the given type to that data type
+ * ourselves.
+ *
+ * @param filetype File data type of the dataset.
+ * @return Size of a single value in the file (in bytes), or 0 if we cannot
+ * convert the values.
+ */
+template < typename _datatype_ >
+inline size_t get_file_value_size(hid_t filetype) {
+  return (H5Tequal(filetype, get_datatype_name< _datatype_ >()) > 0)
+             ? sizeof(_datatype_)
+             : 0;
+}
+
+/**
+ * @brief get_file_value_size() specialization for double precision values,
+ * which can also be stored with a reduced precision.
+ *
+ * @param filetype File data type of the dataset.
+ * @return Size of a single value in the file (in bytes), or 0 if we cannot
+ * convert the values.
+ */
+template <> inline size_t get_file_value_size< double >(hid_t filetype) {
+
+  if (H5Tequal(filetype, H5T_NATIVE_DOUBLE) > 0) {
+    return sizeof(double);
+  }
+  if (H5Tequal(filetype, H5T_NATIVE_FLOAT) > 0) {
+    return sizeof(float);
+  }
+  // half precision data type, see write_values< double >()
+  if (H5Tget_class(filetype) == H5T_FLOAT && H5Tget_size(filetype) == 2 &&
+      H5Tget_order(filetype) == H5Tget_order(H5T_NATIVE_UINT16)) {
+    return 2;
+  }
+  return 0;
+}
+
+/**
+ * @brief Convert the given values to the bytes that represent them in a
+ * dataset with a file data type with the given value size.
+ *
+ * @param data Values.
+ * @param size Number of values.
+ * @param value_size Size of a single value in the file, as returned by
+ * get_file_value_size().
+ * @param bytes Output bytes (should be large enough to store all values).
+ */
+template < typename _datatype_ >
+inline void convert_values(const _datatype_ *data, const size_t size,
+                           const size_t value_size, unsigned char *bytes) {
+  std::memcpy(bytes, data, size * sizeof(_datatype_));
+}
+
+/**
+ * @brief convert_values() specialization for double precision values.
+ *
+ * @param data Values.
+ * @param size Number of values.
+ * @param value_size Size of a single value in the file, as returned by
+ * get_file_value_size().
+ * @param bytes Output bytes (should be large enough to store all values).
+ */
+template <>
+inline void convert_values< double >(const double *data, const size_t size,
+                                     const size_t value_size,
+                                     unsigned char *bytes) {
+
+  if (value_size == sizeof(double)) {
+    std::memcpy(bytes, data, size * sizeof(double));
+  } else if (value_size == sizeof(float)) {
+    for (size_t i = 0; i < size; ++i) {
+      const float value = data[i];
+      std::memcpy(bytes + i * sizeof(float), &value, sizeof(float));
+    }
+  } else {
+    for (size_t i = 0; i < size; ++i) {
+      const uint16_t value = get_half_precision_bits(data[i]);
+      std::memcpy(bytes + i * sizeof(uint16_t), &value, sizeof(uint16_t));
+    }
+  }
+}
+
+/**
+ * @brief Write the given values to the given dataset by compressing complete
+ * chunks ourselves and writing them directly to the file.
+ *
+ * When HDF5 compresses a dataset, the entire filter pipeline runs in the
+ * thread that calls the HDF5 library. For large outputs, this is a serial
+ * bottleneck. Instead, we filter all chunks in parallel (using the OpenMP
+ * team) and only let HDF5 copy the filtered chunks to the file. The resulting
+ * dataset is indistinguishable from a dataset written using H5Dwrite().
+ *
+ * This only works if the values cover complete chunks (the last chunk of the
+ * dataset is allowed to be incomplete), if the dataset only uses the filters
+ * set by set_compression_filters() and if we know how to convert the values to
+ * the file data type ourselves. In all other cases (or if the code was
+ * compiled without zlib or with an HDF5 version that does not support direct
+ * chunk writes), nothing is written and the values need to be written using
+ * H5Dwrite().
+ *
+ * @param dataset Open dataset.
+ * @param name Name of the dataset (for error messages).
+ * @param offset Offset of the first row of values within the dataset.
+ * @param data Values to write (row by row for two dimensional datasets).
+ * @param size Number of values.
+ * @param worksize Number of shared memory threads that can be used to filter
+ * the chunks. If a negative number is given, all available threads are used.
+ * @return True if the values were written.
+ */
+template < typename _datatype_ >
+inline bool write_chunks(hid_t dataset, std::string name, const hsize_t offset,
+                         const _datatype_ *data, const size_t size,
+                         const int_fast32_t worksize = -1) {
+
+#ifdef HDF5TOOLS_DIRECT_CHUNK_WRITE
+  // retrieve the chunk layout and the filter pipeline
+  const hid_t prop = H5Dget_create_plist(dataset);
+  if (prop < 0) {
+    cmac_error("Failed to obtain creation properties of dataset \"%s\"!",
+               name.c_str());
+  }
+  int_fast32_t rank = 0;
+  hsize_t chunk[2] = {0, 1};
+  std::vector< std::pair< H5Z_filter_t, unsigned int > > filters;
+  bool supported_filters = true;
+  if (H5Pget_layout(prop) == H5D_CHUNKED) {
+    rank = H5Pget_chunk(prop, 2, chunk);
+    const int_fast32_t number_of_filters = H5Pget_nfilters(prop);
+    for (int_fast32_t i = 0; i < number_of_filters; ++i) {
+      unsigned int flags;
+      size_t number_of_values = 1;
+      unsigned int value = 0;
+      const H5Z_filter_t filter = H5Pget_filter2(
+          prop, i, &flags, &number_of_values, &value, 0, nullptr, nullptr);
+      supported_filters &= (filter == H5Z_FILTER_FLETCHER32 ||
+                            filter == H5Z_FILTER_SHUFFLE ||
+                            filter == H5Z_FILTER_DEFLATE);
+      filters.push_back(std::make_pair(filter, value));
+    }
+  }
+  herr_t hdf5status = H5Pclose(prop);
+  if (hdf5status < 0) {
+    cmac_error("Failed to close creation properties of dataset \"%s\"!",
+               name.c_str());
+  }
+  // without filters, there is nothing to gain
+  if (rank < 1 || filters.size() == 0 || !supported_filters) {
+    return false;
+  }
+
+  // check that the values cover complete chunks
+  const hid_t filespace = H5Dget_space(dataset);
+  if (filespace < 0) {
+    cmac_error("Failed to obtain file space of dataset \"%s\"!", name.c_str());
+  }
+  hsize_t dims[2] = {0, 1};
+  H5Sget_simple_extent_dims(filespace, dims, nullptr);
+  hdf5status = H5Sclose(filespace);
+  if (hdf5status < 0) {
+    cmac_error("Failed to close file space of dataset \"%s\"!", name.c_str());
+  }
+  if (chunk[1] != dims[1]) {
+    return false;
+  }
+  const size_t values_per_row = dims[1];
+  const size_t number_of_rows = size / values_per_row;
+  if (offset % chunk[0] != 0 || (number_of_rows % chunk[0] != 0 &&
+                                 offset + number_of_rows != dims[0])) {
+    return false;
+  }
+
+  // check that we can convert the values
+  const hid_t filetype = H5Dget_type(dataset);
+  if (filetype < 0) {
+    cmac_error("Failed to obtain data type of dataset \"%s\"!", name.c_str());
+  }
+  const size_t value_size = get_file_value_size< _datatype_ >(filetype);
+  hdf5status = H5Tclose(filetype);
+  if (hdf5status < 0) {
+    cmac_error("Failed to close data type of dataset \"%s\"!", name.c_str());
+  }
+  if (value_size == 0) {
+    return false;
+  }
+
+#ifdef HAVE_OPENMP
+  int_fast32_t number_of_threads = omp_get_max_threads();
+  if (worksize > 0 && worksize < number_of_threads) {
+    number_of_threads = worksize;
+  }
+#else
+  (void)worksize;
+#endif
+
+  // filter the chunks in batches, to limit the memory overhead
+  const size_t values_per_chunk = chunk[0] * values_per_row;
+  const size_t number_of_chunks =
+      number_of_rows / chunk[0] + (number_of_rows % chunk[0] > 0);
+  const size_t batch_size = 256;
+  std::vector< std::vector< unsigned char > > chunks(
+      std::min(batch_size, number_of_chunks));
+  for (size_t batch_start = 0; batch_start < number_of_chunks;
+       batch_start += batch_size) {
+    const size_t batch_end =
+        std::min(batch_start + batch_size, number_of_chunks);
+
+    int_fast32_t number_of_failures = 0;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared) num_threads(number_of_threads)        \
+    reduction(+ : number_of_failures)
+#endif
+    for (size_t ichunk = batch_start; ichunk < batch_end; ++ichunk) {
+      // chunks at the edge of the dataset are padded to the full chunk size
+      std::vector< unsigned char > &chunk_bytes = chunks[ichunk - batch_start];
+      chunk_bytes.assign(values_per_chunk * value_size, 0);
+      const size_t first_value = ichunk * values_per_chunk;
+      convert_values(data + first_value,
+                     std::min(values_per_chunk, size - first_value),
+                     value_size, chunk_bytes.data());
+      if (!filter_chunk(chunk_bytes, filters)) {
+        ++number_of_failures;
+      }
+    }
+    if (number_of_failures > 0) {
+      cmac_error("Failed to compress chunks of dataset \"%s\"!", name.c_str());
+    }
+
+    // the HDF5 library is not thread safe, so we write the chunks serially
+    for (size_t ichunk = batch_start; ichunk < batch_end; ++ichunk) {
+      const std::vector< unsigned char > &chunk_bytes =
+          chunks[ichunk - batch_start];
+      const hsize_t chunk_offset[2] = {offset + ichunk * chunk[0], 0};
+      hdf5status = H5Dwrite_chunk(dataset, H5P_DEFAULT, 0, chunk_offset,
+                                  chunk_bytes.size(), chunk_bytes.data());
+      if (hdf5status < 0) {
+        cmac_error("Failed to write chunk of dataset \"%s\"!", name.c_str());
+      }
+    }
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
 /**
  * @brief Write the dataset with the given name to the given group.
  *
@@ -1340,11 +2067,14 @@ inline HDF5Dictionary< _datatype_ > read_dictionary(hid_t group,
  * @param name Name of the dataset to write.
  * @param values std::vector containing the contents of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param compression_level Deflate compression level that is used if
+ * compression is enabled (1: fastest, 9: smallest output).
  */
 template < typename _datatype_ >
 inline void write_dataset(hid_t group, std::string name,
                           std::vector< _datatype_ > &values,
-                          const bool compress = false) {
+                          const bool compress = false,
+                          const int_fast32_t compression_level = 9) {
 
   const hid_t datatype = get_datatype_name< _datatype_ >();
 
@@ -1366,20 +2096,7 @@ inline void write_dataset(hid_t group, std::string name,
   }
 
   if (compress) {
-    hdf5status = H5Pset_fletcher32(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_deflate(prop, 9);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
-    }
+    set_compression_filters(prop, name, compression_level);
   }
 
   // create dataset
@@ -1399,10 +2116,12 @@ inline void write_dataset(hid_t group, std::string name,
   for (size_t i = 0; i < vsize; ++i) {
     data[i] = values[i];
   }
-  hdf5status =
-      H5Dwrite(dataset, datatype, H5S_ALL, filespace, H5P_DEFAULT, data);
-  if (hdf5status < 0) {
-    cmac_error("Failed to write dataset \"%s\"", name.c_str());
+  if (!write_chunks(dataset, name, 0, data, vsize)) {
+    hdf5status =
+        H5Dwrite(dataset, datatype, H5S_ALL, filespace, H5P_DEFAULT, data);
+    if (hdf5status < 0) {
+      cmac_error("Failed to write dataset \"%s\"", name.c_str());
+    }
   }
 
   // close creation properties
@@ -1434,11 +2153,14 @@ inline void write_dataset(hid_t group, std::string name,
  * @param name Name of the dataset to write.
  * @param values std::vector containing the contents of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param compression_level Deflate compression level that is used if
+ * compression is enabled (1: fastest, 9: smallest output).
  */
 template <>
 inline void write_dataset(hid_t group, std::string name,
                           std::vector< CoordinateVector<> > &values,
-                          const bool compress) {
+                          const bool compress,
+                          const int_fast32_t compression_level) {
 
   const hid_t datatype = get_datatype_name< double >();
 
@@ -1460,20 +2182,7 @@ inline void write_dataset(hid_t group, std::string name,
   }
 
   if (compress) {
-    hdf5status = H5Pset_fletcher32(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_deflate(prop, 9);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
-    }
+    set_compression_filters(prop, name, compression_level);
   }
 
 // create dataset
@@ -1495,10 +2204,12 @@ inline void write_dataset(hid_t group, std::string name,
     data[3 * i + 1] = values[i].y();
     data[3 * i + 2] = values[i].z();
   }
-  hdf5status =
-      H5Dwrite(dataset, datatype, H5S_ALL, filespace, H5P_DEFAULT, data);
-  if (hdf5status < 0) {
-    cmac_error("Failed to write dataset \"%s\"", name.c_str());
+  if (!write_chunks(dataset, name, 0, data, 3 * vsize)) {
+    hdf5status =
+        H5Dwrite(dataset, datatype, H5S_ALL, filespace, H5P_DEFAULT, data);
+    if (hdf5status < 0) {
+      cmac_error("Failed to write dataset \"%s\"", name.c_str());
+    }
   }
 
   // close creation properties
@@ -1530,11 +2241,14 @@ inline void write_dataset(hid_t group, std::string name,
  * @param name Name of the dataset to write.
  * @param values std::vector containing the contents of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param compression_level Deflate compression level that is used if
+ * compression is enabled (1: fastest, 9: smallest output).
  */
 template <>
 inline void write_dataset(hid_t group, std::string name,
                           std::vector< std::string > &values,
-                          const bool compress) {
+                          const bool compress,
+                          const int_fast32_t compression_level) {
 
   const hid_t datatype = H5Tcopy(H5T_C_S1);
   if (datatype < 0) {
@@ -1573,20 +2287,7 @@ inline void write_dataset(hid_t group, std::string name,
   }
 
   if (compress) {
-    hdf5status = H5Pset_fletcher32(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_deflate(prop, 9);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
-    }
+    set_compression_filters(prop, name, compression_level);
   }
 
 // create dataset
@@ -1647,12 +2348,28 @@ inline void write_dataset(hid_t group, std::string name,
  * @param name Name of the dataset to create.
  * @param size Size of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param precision HDF5Precision used to store the values in the file (only
+ * supported for double precision datasets).
+ * @param decimal_digits Number of decimal digits that is kept for quantised
+ * datasets, or number of significant digits that is kept for significant
+ * datasets (required for both).
+ * @param compression_level Deflate compression level that is used if
+ * compression is enabled (1: fastest, 9: smallest output).
  */
 template < typename _datatype_ >
 inline void create_dataset(hid_t group, std::string name, hsize_t size,
-                           const bool compress = false) {
-
-  const hid_t datatype = get_datatype_name< _datatype_ >();
+                           const bool compress = false,
+                           const int_fast32_t precision = HDF5PRECISION_DOUBLE,
+                           const int_fast32_t decimal_digits = 0,
+                           const int_fast32_t compression_level = 9) {
+
+  cmac_assert_message(precision == HDF5PRECISION_DOUBLE ||
+                          get_datatype_name< _datatype_ >() ==
+                              get_datatype_name< double >(),
+                      "Reduced precision only works for double datasets!");
+  const hid_t datatype = (precision == HDF5PRECISION_DOUBLE)
+                             ? get_datatype_name< _datatype_ >()
+                             : get_precision_datatype(precision);
 
   // create dataspace
   const hsize_t limit = 1 << 10;
@@ -1670,21 +2387,10 @@ inline void create_dataset(hid_t group, std::string name, hsize_t size,
     cmac_error("Failed to set chunk size for dataset \"%s\"", name.c_str());
   }
 
+  set_precision_filter(prop, name, precision, decimal_digits);
+
   if (compress) {
-    hdf5status = H5Pset_fletcher32(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_deflate(prop, 9);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
-    }
+    set_compression_filters(prop, name, compression_level);
   }
 
 // create dataset
@@ -1699,6 +2405,23 @@ inline void create_dataset(hid_t group, std::string name, hsize_t size,
     cmac_error("Failed to create dataset \"%s\"", name.c_str());
   }
 
+  // significant datasets are rounded when the values are added, see
+  // round_significant_values()
+  if (precision == HDF5PRECISION_SIGNIFICANT) {
+    uint32_t significant_digits = decimal_digits;
+    write_attribute< uint32_t >(dataset, "SignificantDigits",
+                                significant_digits);
+  }
+
+  // close the file data type if we created it
+  if (precision != HDF5PRECISION_DOUBLE) {
+    hdf5status = H5Tclose(datatype);
+    if (hdf5status < 0) {
+      cmac_error("Failed to close data type for dataset \"%s\"",
+                 name.c_str());
+    }
+  }
+
   // close creation properties
   hdf5status = H5Pclose(prop);
   if (hdf5status < 0) {
@@ -1728,13 +2451,22 @@ inline void create_dataset(hid_t group, std::string name, hsize_t size,
  * @param name Name of the dataset to create.
  * @param size Size of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param precision HDF5Precision used to store the values in the file.
+ * @param decimal_digits Number of decimal digits that is kept for quantised
+ * datasets, or number of significant digits that is kept for significant
+ * datasets (required for both).
+ * @param compression_level Deflate compression level that is used if
+ * compression is enabled (1: fastest, 9: smallest output).
  */
 template <>
-inline void create_dataset< CoordinateVector<> >(hid_t group, std::string name,
-                                                 hsize_t size,
-                                                 const bool compress) {
+inline void create_dataset< CoordinateVector<> >(
+    hid_t group, std::string name, hsize_t size, const bool compress,
+    const int_fast32_t precision, const int_fast32_t decimal_digits,
+    const int_fast32_t compression_level) {
 
-  const hid_t datatype = get_datatype_name< double >();
+  const hid_t datatype = (precision == HDF5PRECISION_DOUBLE)
+                             ? get_datatype_name< double >()
+                             : get_precision_datatype(precision);
 
   // create dataspace
   const hsize_t limit = 1 << 10;
@@ -1752,21 +2484,10 @@ inline void create_dataset< CoordinateVector<> >(hid_t group, std::string name,
     cmac_error("Failed to set chunk size for dataset \"%s\"", name.c_str());
   }
 
+  set_precision_filter(prop, name, precision, decimal_digits);
+
   if (compress) {
-    hdf5status = H5Pset_fletcher32(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_deflate(prop, 9);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
-    }
+    set_compression_filters(prop, name, compression_level);
   }
 
 // create dataset
@@ -1781,6 +2502,23 @@ inline void create_dataset< CoordinateVector<> >(hid_t group, std::string name,
     cmac_error("Failed to create dataset \"%s\"", name.c_str());
   }
 
+  // significant datasets are rounded when the values are added, see
+  // round_significant_values()
+  if (precision == HDF5PRECISION_SIGNIFICANT) {
+    uint32_t significant_digits = decimal_digits;
+    write_attribute< uint32_t >(dataset, "SignificantDigits",
+                                significant_digits);
+  }
+
+  // close the file data type if we created it
+  if (precision != HDF5PRECISION_DOUBLE) {
+    hdf5status = H5Tclose(datatype);
+    if (hdf5status < 0) {
+      cmac_error("Failed to close data type for dataset \"%s\"",
+                 name.c_str());
+    }
+  }
+
   // close creation properties
   hdf5status = H5Pclose(prop);
   if (hdf5status < 0) {
@@ -1809,12 +2547,13 @@ inline void create_dataset< CoordinateVector<> >(hid_t group, std::string name,
  * @param name Name of the dataset to append to.
  * @param offset Offset of the new data within the dataset.
  * @param values std::vector containing the data to append.
+ * @param worksize Number of shared memory threads that can be used to compress
+ * the data. If a negative number is given, all available threads are used.
  */
 template < typename _datatype_ >
 inline void append_dataset(hid_t group, std::string name, hsize_t offset,
-                           std::vector< _datatype_ > &values) {
-
-  const hid_t datatype = get_datatype_name< _datatype_ >();
+                           std::vector< _datatype_ > &values,
+                           const int_fast32_t worksize = -1) {
 
 // open dataset
 #ifdef HDF5_OLD_API
@@ -1853,10 +2592,13 @@ inline void append_dataset(hid_t group, std::string name, hsize_t offset,
   for (size_t i = 0; i < values.size(); ++i) {
     data[i] = values[i];
   }
-  hdf5status =
-      H5Dwrite(dataset, datatype, memspace, filespace, H5P_DEFAULT, data);
-  if (hdf5status < 0) {
-    cmac_error("Failed to write dataset \"%s\"", name.c_str());
+  round_significant_values(dataset, data, values.size());
+  if (!write_chunks(dataset, name, offset, data, values.size(), worksize)) {
+    hdf5status =
+        write_values(dataset, memspace, filespace, data, values.size());
+    if (hdf5status < 0) {
+      cmac_error("Failed to write dataset \"%s\"", name.c_str());
+    }
   }
 
   // close memory space
@@ -1891,12 +2633,13 @@ inline void append_dataset(hid_t group, std::string name, hsize_t offset,
  * @param name Name of the dataset to append to.
  * @param offset Offset of the new data within the dataset.
  * @param values std::vector containing the data to append.
+ * @param worksize Number of shared memory threads that can be used to compress
+ * the data. If a negative number is given, all available threads are used.
  */
 template <>
 inline void append_dataset(hid_t group, std::string name, hsize_t offset,
-                           std::vector< CoordinateVector<> > &values) {
-
-  const hid_t datatype = get_datatype_name< double >();
+                           std::vector< CoordinateVector<> > &values,
+                           const int_fast32_t worksize) {
 
 // open dataset
 #ifdef HDF5_OLD_API
@@ -1937,10 +2680,14 @@ inline void append_dataset(hid_t group, std::string name, hsize_t offset,
     data[3 * i + 1] = values[i].y();
     data[3 * i + 2] = values[i].z();
   }
-  hdf5status =
-      H5Dwrite(dataset, datatype, memspace, filespace, H5P_DEFAULT, data);
-  if (hdf5status < 0) {
-    cmac_error("Failed to write dataset \"%s\"", name.c_str());
+  round_significant_values(dataset, data, 3 * values.size());
+  if (!write_chunks(dataset, name, offset, data, 3 * values.size(),
+                    worksize)) {
+    hdf5status =
+        write_values(dataset, memspace, filespace, data, 3 * values.size());
+    if (hdf5status < 0) {
+      cmac_error("Failed to write dataset \"%s\"", name.c_str());
+    }
   }
 
   // close memory space
@@ -1976,11 +2723,14 @@ inline void append_dataset(hid_t group, std::string name, hsize_t offset,
  * @param number_of_rows Number of rows in the dataset.
  * @param number_of_columns Number of columns in the dataset.
  * @param compress Apply compression to the dataset?
+ * @param compression_level Deflate compression level that is used if
+ * compression is enabled (1: fastest, 9: smallest output).
  */
 template < typename _datatype_ >
 inline void create_datatable(hid_t group, std::string name,
                              hsize_t number_of_rows, hsize_t number_of_columns,
-                             const bool compress = false) {
+                             const bool compress = false,
+                             const int_fast32_t compression_level = 9) {
 
   const hid_t datatype = get_datatype_name< _datatype_ >();
 
@@ -2002,20 +2752,7 @@ inline void create_datatable(hid_t group, std::string name,
   }
 
   if (compress) {
-    hdf5status = H5Pset_fletcher32(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
-    }
-    hdf5status = H5Pset_deflate(prop, 9);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
-    }
+    set_compression_filters(prop, name, compression_level);
   }
 
 // create dataset
@@ -319,6 +319,139 @@ private:
     }
   }
 
+  /**
+   * @brief Vectorisable main loop of solve_for_flux_pencil().
+   *
+   * All arrays are passed on as separate restricted pointers, so that the
+   * compiler knows that they do not overlap.
+   *
+   * @param n Number of interfaces.
+   * @param nx, ny, nz Components of the interface normal.
+   * @param rhoLs, uLxs, uLys, uLzs, PLs Left state arrays.
+   * @param rhoRs, uRxs, uRys, uRzs, PRs Right state arrays.
+   * @param mfluxes, pxfluxes, pyfluxes, pzfluxes, Efluxes Output flux
+   * arrays.
+   * @param vacuum_flags Output flags for interfaces that involve vacuum.
+   */
+  inline void solve_for_flux_pencil_kernel(
+      const uint_fast32_t n, const double nx, const double ny, const double nz,
+      const double *__restrict__ rhoLs, const double *__restrict__ uLxs,
+      const double *__restrict__ uLys, const double *__restrict__ uLzs,
+      const double *__restrict__ PLs, const double *__restrict__ rhoRs,
+      const double *__restrict__ uRxs, const double *__restrict__ uRys,
+      const double *__restrict__ uRzs, const double *__restrict__ PRs,
+      double *__restrict__ mfluxes, double *__restrict__ pxfluxes,
+      double *__restrict__ pyfluxes, double *__restrict__ pzfluxes,
+      double *__restrict__ Efluxes,
+      double *__restrict__ vacuum_flags) const {
+
+    for (uint_fast32_t k = 0; k < n; ++k) {
+
+      const double rhoL = rhoLs[k];
+      const double uLx = uLxs[k];
+      const double uLy = uLys[k];
+      const double uLz = uLzs[k];
+      const double PL = PLs[k];
+      const double rhoR = rhoRs[k];
+      const double uRx = uRxs[k];
+      const double uRy = uRys[k];
+      const double uRz = uRzs[k];
+      const double PR = PRs[k];
+
+      const double rhoLinv = 1. / (rhoL + DBL_MIN);
+      const double rhoRinv = 1. / (rhoR + DBL_MIN);
+      const double PLinv = 1. / (PL + DBL_MIN);
+      const double PRinv = 1. / (PR + DBL_MIN);
+
+      // get the velocities along the surface normal of the interface
+      const double vL = uLx * nx + uLy * ny + uLz * nz;
+      const double vR = uRx * nx + uRy * ny + uRz * nz;
+
+      const double aL = std::sqrt(_gamma * PL * rhoLinv);
+      const double aR = std::sqrt(_gamma * PR * rhoRinv);
+
+      const double vdiff = vR - vL;
+      const double abar = aL + aR;
+
+      // flag the interfaces that need the vacuum solver; the values computed
+      // below for these interfaces are discarded
+      // (the flags are stored as floating point values, since mixing data
+      // types of different sizes prevents vectorisation)
+      const bool vacuum = (rhoL == 0.) | (rhoLinv > DBL_MAX) | (PL == 0.) |
+                          (PLinv > DBL_MAX) | (rhoR == 0.) |
+                          (rhoRinv > DBL_MAX) | (PR == 0.) |
+                          (PRinv > DBL_MAX) | (_tdgm1 * abar <= vdiff);
+      vacuum_flags[k] = vacuum ? 1. : 0.;
+
+      // STEP 1: pressure estimate
+      const double rhobar = rhoL + rhoR;
+      const double Pbar = PL + PR;
+      const double pPVRS = 0.5 * (Pbar - 0.25 * vdiff * rhobar * abar);
+      const double pstar = std::max(0., pPVRS);
+
+      // STEP 2: wave speed estimates
+      // note that the square root arguments are always positive, so that we
+      // can safely compute them for all interfaces
+      const double qLshock = std::sqrt(1. + _gp1d2g * (pstar * PLinv - 1.));
+      const double qRshock = std::sqrt(1. + _gp1d2g * (pstar * PRinv - 1.));
+      const double qL = (pstar > PL) ? qLshock : 1.;
+      const double qR = (pstar > PR) ? qRshock : 1.;
+
+      const double SLmvL = -aL * qL;
+      const double SRmvR = aR * qR;
+      const double Pdiff = PR - PL;
+      const double rhovSdiff = rhoL * vL * SLmvL - rhoR * vR * SRmvR;
+      const double rhoSdiff = rhoL * SLmvL - rhoR * SRmvR;
+      const double Sstar = (Pdiff + rhovSdiff) / (rhoSdiff + DBL_MIN);
+
+      // select the upwind state
+      const bool left = (Sstar >= 0.);
+      const double rho = left ? rhoL : rhoR;
+      const double rhoinv = left ? rhoLinv : rhoRinv;
+      const double ux = left ? uLx : uRx;
+      const double uy = left ? uLy : uRy;
+      const double uz = left ? uLz : uRz;
+      const double v = left ? vL : vR;
+      const double P = left ? PL : PR;
+      const double Smv = left ? SLmvL : SRmvR;
+
+      const double rhov = rho * v;
+      const double v2 = ux * ux + uy * uy + uz * uz;
+      const double e = P * _odgm1 * rhoinv + 0.5 * v2;
+      const double S = Smv + v;
+
+      const double mflux = rhov;
+      const double pxflux = rhov * ux + P * nx;
+      const double pyflux = rhov * uy + P * ny;
+      const double pzflux = rhov * uz + P * nz;
+      const double Eflux = rhov * e + P * v;
+
+      // add the star state correction if the wave moves in the right
+      // direction
+      const bool star = (left & (S < 0.)) | (!left & (S > 0.));
+      const double starfac = Smv / (S - Sstar) - 1.;
+      const double Srho = S * rho;
+      const double Sstarmv = Sstar - v;
+      const double Srhostarfac = Srho * starfac;
+      const double SrhoSstarmv = Srho * Sstarmv;
+      const double Smvinv = 1. / (Smv + DBL_MIN);
+
+      const double mflux_star = mflux + Srhostarfac;
+      const double pxflux_star = pxflux + (Srhostarfac * ux + SrhoSstarmv * nx);
+      const double pyflux_star = pyflux + (Srhostarfac * uy + SrhoSstarmv * ny);
+      const double pzflux_star = pzflux + (Srhostarfac * uz + SrhoSstarmv * nz);
+      const double Eflux_star =
+          Eflux +
+          (Srhostarfac * e + SrhoSstarmv * (Sstar + P * rhoinv * Smvinv));
+
+      mfluxes[k] = star ? mflux_star : mflux;
+      pxfluxes[k] = star ? pxflux_star : pxflux;
+      pyfluxes[k] = star ? pyflux_star : pyflux;
+      pzfluxes[k] = star ? pzflux_star : pzflux;
+      Efluxes[k] = star ? Eflux_star : Eflux;
+    }
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -512,6 +645,62 @@ public:
         Utilities::as_bytes(uR[0]), Utilities::as_bytes(uR[1]),
         Utilities::as_bytes(uR[2]), PR, Utilities::as_bytes(PR));
   }
+
+  /**
+   * @brief Solve the Riemann problem for a pencil of interfaces with a normal
+   * along the same coordinate axis and a zero interface velocity.
+   *
+   * All input and output variables are stored in separate contiguous arrays,
+   * so that the main loop can be vectorised by the compiler: the upwind state
+   * is selected without branches and the star state correction is only
+   * applied afterwards, using a selection. Interfaces that involve a vacuum
+   * state are flagged in the main loop and are solved afterwards using
+   * solve_for_flux(). The results are identical to calling solve_for_flux()
+   * for every interface.
+   *
+   * Note that the main loop only vectorises if the compiler is allowed to
+   * evaluate square roots and divisions speculatively, i.e. with
+   * -fno-math-errno and -fno-trapping-math (which are set in CMakeLists.txt).
+   *
+   * @param n Number of interfaces.
+   * @param i Coordinate axis of the interface normal: x (0), y (1) or z (2).
+   * @param WL Left state density, velocity and pressure arrays.
+   * @param WR Right state density, velocity and pressure arrays.
+   * @param fluxes Output mass, momentum and energy flux arrays.
+   * @param vacuum_flags Array used to flag vacuum interfaces (1 for vacuum, 0
+   * otherwise).
+   */
+  inline void solve_for_flux_pencil(const uint_fast32_t n, const uint_fast8_t i,
+                                    const double *const *WL,
+                                    const double *const *WR,
+                                    double *const *fluxes,
+                                    double *vacuum_flags) const {
+
+    const CoordinateVector<> normal((i == 0) ? 1. : 0., (i == 1) ? 1. : 0.,
+                                    (i == 2) ? 1. : 0.);
+
+    solve_for_flux_pencil_kernel(n, normal.x(), normal.y(), normal.z(), WL[0],
+                                 WL[1], WL[2], WL[3], WL[4], WR[0], WR[1],
+                                 WR[2], WR[3], WR[4], fluxes[0], fluxes[1],
+                                 fluxes[2], fluxes[3], fluxes[4], vacuum_flags);
+
+    // now redo the vacuum interfaces using the scalar solver
+    for (uint_fast32_t k = 0; k < n; ++k) {
+      if (vacuum_flags[k] != 0.) {
+        const CoordinateVector<> uL(WL[1][k], WL[2][k], WL[3][k]);
+        const CoordinateVector<> uR(WR[1][k], WR[2][k], WR[3][k]);
+        double mflux, Eflux;
+        CoordinateVector<> pflux;
+        solve_for_flux(WL[0][k], uL, WL[4][k], WR[0][k], uR, WR[4][k], mflux,
+                       pflux, Eflux, normal);
+        fluxes[0][k] = mflux;
+        fluxes[1][k] = pflux.x();
+        fluxes[2][k] = pflux.y();
+        fluxes[3][k] = pflux.z();
+        fluxes[4][k] = Eflux;
+      }
+    }
+  }
 };
 
 #endif // HLLCRIEMANNSOLVER_HPP
@@ -51,6 +51,7 @@ HeliumLymanContinuumSpectrum::HeliumLymanContinuumSpectrum(
   _cumulative_distribution.resize(
       HELIUMLYMANCONTINUUMSPECTRUM_NUMTEMP,
       std::vector< double >(HELIUMLYMANCONTINUUMSPECTRUM_NUMFREQ, 0.));
+  _cumulative_distribution_guide.resize(HELIUMLYMANCONTINUUMSPECTRUM_NUMTEMP);
 
   // some constants
   // 24.6 eV in Hz (1.81 x 13.6 eV)
@@ -129,7 +130,16 @@ HeliumLymanContinuumSpectrum::HeliumLymanContinuumSpectrum(
           _cumulative_distribution[iT]
                                   [HELIUMLYMANCONTINUUMSPECTRUM_NUMFREQ - 1];
     }
+
+    // set up the guide table used to sample the cumulative distribution
+    _cumulative_distribution_guide[iT].initialize(
+        _cumulative_distribution[iT].data(),
+        HELIUMLYMANCONTINUUMSPECTRUM_NUMFREQ);
   }
+
+  // set up the guide table used to locate temperatures
+  _temperature_guide.initialize(_temperature.data(),
+                                HELIUMLYMANCONTINUUMSPECTRUM_NUMTEMP);
 }
 
 /**
@@ -139,6 +149,8 @@ HeliumLymanContinuumSpectrum::HeliumLymanContinuumSpectrum(
  * generate a random uniform number and locate it in the two cumulative
  * distributions that border the temperature value. The sampled frequency is
  * then given by linear interpolation on the temperature and frequency tables.
+ * All three lookups use guide tables, so that their cost does not depend on the
+ * size of the tables.
  *
  * @param random_generator RandomGenerator to use.
  * @param temperature Temperature of the cell that reemits the photon (in K).
@@ -147,15 +159,13 @@ HeliumLymanContinuumSpectrum::HeliumLymanContinuumSpectrum(
 double HeliumLymanContinuumSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
-  const uint_fast32_t iT = Utilities::locate(
-      temperature, _temperature.data(), HELIUMLYMANCONTINUUMSPECTRUM_NUMTEMP);
+  const uint_fast32_t iT =
+      _temperature_guide.locate(temperature, _temperature.data());
   const double x = random_generator.get_uniform_random_double();
-  const uint_fast32_t inu1 =
-      Utilities::locate(x, _cumulative_distribution[iT].data(),
-                        HELIUMLYMANCONTINUUMSPECTRUM_NUMFREQ);
-  const uint_fast32_t inu2 =
-      Utilities::locate(x, _cumulative_distribution[iT + 1].data(),
-                        HELIUMLYMANCONTINUUMSPECTRUM_NUMFREQ);
+  const uint_fast32_t inu1 = _cumulative_distribution_guide[iT].locate(
+      x, _cumulative_distribution[iT].data());
+  const uint_fast32_t inu2 = _cumulative_distribution_guide[iT + 1].locate(
+      x, _cumulative_distribution[iT + 1].data());
   const double frequency =
       _frequency[inu1] + (temperature - _temperature[iT]) *
                              (_frequency[inu2] - _frequency[inu1]) /
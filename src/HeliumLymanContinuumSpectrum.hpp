@@ -26,6 +26,7 @@
 #ifndef HELIUMLYMANCONTINUUMSPECTRUM_HPP
 #define HELIUMLYMANCONTINUUMSPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 #include "RandomGenerator.hpp"
 
@@ -60,6 +61,13 @@ private:
   /*! @brief Cumulative distribution function. */
   std::vector< std::vector< double > > _cumulative_distribution;
 
+  /*! @brief Guide table used to locate temperatures. */
+  GuideTable _temperature_guide;
+
+  /*! @brief Guide tables used to sample the cumulative distribution functions
+   *  (one for every temperature). */
+  std::vector< GuideTable > _cumulative_distribution_guide;
+
 public:
   HeliumLymanContinuumSpectrum(const CrossSections &cross_sections);
 
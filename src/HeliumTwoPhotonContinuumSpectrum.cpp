@@ -98,6 +98,11 @@ HeliumTwoPhotonContinuumSpectrum::HeliumTwoPhotonContinuumSpectrum() {
     _cumulative_distribution[i] /=
         _cumulative_distribution[HELIUMTWOPHOTONCONTINUUMSPECTRUM_NUMFREQ - 1];
   }
+
+  // set up the guide table used to sample the cumulative distribution
+  _cumulative_distribution_guide.initialize(
+      _cumulative_distribution.data(),
+      HELIUMTWOPHOTONCONTINUUMSPECTRUM_NUMFREQ);
 }
 
 /**
@@ -168,9 +173,8 @@ double HeliumTwoPhotonContinuumSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
   const double x = random_generator.get_uniform_random_double();
-  const uint_fast32_t inu =
-      Utilities::locate(x, _cumulative_distribution.data(),
-                        HELIUMTWOPHOTONCONTINUUMSPECTRUM_NUMFREQ);
+  const uint_fast32_t inu = _cumulative_distribution_guide.locate(
+      x, _cumulative_distribution.data());
   const double frequency =
       _frequency[inu] +
       (_frequency[inu + 1] - _frequency[inu]) *
@@ -26,6 +26,7 @@
 #ifndef HELIUMTWOPHOTONCONTINUUMSPECTRUM_HPP
 #define HELIUMTWOPHOTONCONTINUUMSPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 #include "RandomGenerator.hpp"
 
@@ -51,6 +52,9 @@ private:
   /*! @brief Cumulative distribution function. */
   std::vector< double > _cumulative_distribution;
 
+  /*! @brief Guide table used to sample the cumulative distribution function. */
+  GuideTable _cumulative_distribution_guide;
+
 public:
   HeliumTwoPhotonContinuumSpectrum();
 
@@ -28,6 +28,7 @@
 
 #include "HLLCRiemannSolver.hpp"
 #include "HydroBoundary.hpp"
+#include "HydroPencil.hpp"
 #include "HydroVariables.hpp"
 #include "IonizationVariables.hpp"
 #include "ParameterFile.hpp"
@@ -119,35 +120,128 @@ private:
 
     const double phibar = phiL + dnrm_over_r * (phiR - phiL);
 
+    // the conditionals below are written as selections rather than branches,
+    // so that this function can be vectorised when it is called inside a loop
+    // (see do_pencil_flux_calculation())
+
     // if sign(phimax+delta1) == sign(phimax)
-    double phiplus;
-    if ((phimax + delta1) * phimax > 0.) {
-      phiplus = phimax + delta1;
-    } else {
-      const double absphimax = std::abs(phimax);
-      phiplus = phimax * absphimax / (absphimax + delta1 + DBL_MIN);
-    }
+    const double absphimax = std::abs(phimax);
+    const double phiplus_small =
+        phimax * absphimax / (absphimax + delta1 + DBL_MIN);
+    const double phiplus =
+        ((phimax + delta1) * phimax > 0.) ? phimax + delta1 : phiplus_small;
 
     // if sign(phimin-delta1) == sign(phimin)
-    double phiminus;
-    if ((phimin - delta1) * phimin > 0.) {
-      phiminus = phimin - delta1;
-    } else {
-      const double absphimin = std::abs(phimin);
-      phiminus = phimin * absphimin / (absphimin + delta1 + DBL_MIN);
-    }
+    const double absphimin = std::abs(phimin);
+    const double phiminus_small =
+        phimin * absphimin / (absphimin + delta1 + DBL_MIN);
+    const double phiminus =
+        ((phimin - delta1) * phimin > 0.) ? phimin - delta1 : phiminus_small;
+
+    const double phimid_up =
+        std::max(phiminus, std::min(phibar + delta2, phimid0));
+    const double phimid_down =
+        std::min(phiplus, std::max(phibar - delta2, phimid0));
+    const double phimid = (phiL < phiR) ? phimid_up : phimid_down;
+    return (phiL == phiR) ? phiL : phimid;
+  }
 
-    double phimid;
-    if (phiL == phiR) {
-      phimid = phiL;
-    } else {
-      if (phiL < phiR) {
-        phimid = std::max(phiminus, std::min(phibar + delta2, phimid0));
-      } else {
-        phimid = std::min(phiplus, std::max(phibar - delta2, phimid0));
-      }
+  /**
+   * @brief Apply the interface surface area and the flux limiter to the
+   * fluxes of a pencil of interfaces.
+   *
+   * Vectorisable version of the corresponding part of do_flux_calculation().
+   * All arrays are passed on as separate restricted pointers, so that the
+   * compiler knows that they do not overlap. The cell arrays contain one more
+   * element than the flux arrays.
+   *
+   * @param n Number of interfaces.
+   * @param A Surface area of the interfaces (in m^2).
+   * @param dt Current system time step, used for flux limiter (in s).
+   * @param rho Cell densities (in kg m^-3).
+   * @param P Cell pressures (in kg m^-1 s^-2).
+   * @param mass Cell masses (in kg).
+   * @param total_energy Cell total energies (in kg m^2 s^-2).
+   * @param momentum2 Squared norms of the cell momenta (in kg^2 m^2 s^-2).
+   * @param mfluxes Mass fluxes (input in kg m^-2 s^-1, output in kg s^-1).
+   * @param pxfluxes, pyfluxes, pzfluxes Momentum fluxes (input in kg m^-1
+   * s^-2, output in kg m s^-2).
+   * @param Efluxes Energy fluxes (input in kg s^-3, output in kg m^2 s^-3).
+   */
+  inline void finalize_pencil_fluxes(
+      const uint_fast32_t n, const double A, const double dt,
+      const double *__restrict__ rho, const double *__restrict__ P,
+      const double *__restrict__ mass, const double *__restrict__ total_energy,
+      const double *__restrict__ momentum2, double *__restrict__ mfluxes,
+      double *__restrict__ pxfluxes, double *__restrict__ pyfluxes,
+      double *__restrict__ pzfluxes, double *__restrict__ Efluxes) const {
+
+#ifdef FLUX_LIMITER
+    const bool limit_energy = (_gamma > 1.);
+#endif
+    for (uint_fast32_t k = 0; k < n; ++k) {
+      double mflux = mfluxes[k] * A;
+      double pxflux = pxfluxes[k] * A;
+      double pyflux = pyfluxes[k] * A;
+      double pzflux = pzfluxes[k] * A;
+      double Eflux = Efluxes[k] * A;
+
+#ifdef FLUX_LIMITER
+      // same limiter as in do_flux_calculation(), written using selections
+      // (all candidate factors are computed unconditionally, so that the
+      // compiler does not need to keep the branches)
+      const double absmflux = mflux * dt;
+      const double absEflux = Eflux * dt;
+      const double p2 = momentum2[k];
+      const double pn2 = momentum2[k + 1];
+      const double m2 = mass[k] * mass[k];
+      const double mn2 = mass[k + 1] * mass[k + 1];
+      const double pflux2 =
+          (pxflux * pxflux + pyflux * pyflux + pzflux * pzflux) * dt * dt;
+      const double fac_mL = FLUX_LIMITER * mass[k] / absmflux;
+      const double fac_mR = -FLUX_LIMITER * mass[k + 1] / absmflux;
+      const double fac_EL = FLUX_LIMITER * total_energy[k] / absEflux;
+      const double fac_ER = -FLUX_LIMITER * total_energy[k + 1] / absEflux;
+      const double fac_pL =
+          std::sqrt((FLUX_LIMITER * FLUX_LIMITER) * p2 / pflux2);
+      const double fac_pR =
+          std::sqrt((FLUX_LIMITER * FLUX_LIMITER) * pn2 / pflux2);
+
+      double fluxfac = 1.;
+      fluxfac = (absmflux > FLUX_LIMITER * mass[k]) ? fac_mL : fluxfac;
+      fluxfac = (-absmflux > FLUX_LIMITER * mass[k + 1])
+                    ? std::min(fluxfac, fac_mR)
+                    : fluxfac;
+      fluxfac = (limit_energy & (absEflux > FLUX_LIMITER * total_energy[k]))
+                    ? std::min(fluxfac, fac_EL)
+                    : fluxfac;
+      fluxfac =
+          (limit_energy & (-absEflux > FLUX_LIMITER * total_energy[k + 1]))
+              ? std::min(fluxfac, fac_ER)
+              : fluxfac;
+      // note that the right state condition uses the left state momentum, like
+      // in do_flux_calculation()
+      fluxfac = ((p2 * rho[k] > _gamma * m2 * P[k]) &
+                 (pflux2 > (FLUX_LIMITER * FLUX_LIMITER) * p2))
+                    ? std::min(fluxfac, fac_pL)
+                    : fluxfac;
+      fluxfac = ((p2 * rho[k + 1] > _gamma * mn2 * P[k + 1]) &
+                 (pflux2 > (FLUX_LIMITER * FLUX_LIMITER) * pn2))
+                    ? std::min(fluxfac, fac_pR)
+                    : fluxfac;
+      mflux *= fluxfac;
+      pxflux *= fluxfac;
+      pyflux *= fluxfac;
+      pzflux *= fluxfac;
+      Eflux *= fluxfac;
+#endif
+
+      mfluxes[k] = mflux;
+      pxfluxes[k] = pxflux;
+      pyfluxes[k] = pyflux;
+      pzfluxes[k] = pzflux;
+      Efluxes[k] = Eflux;
     }
-    return phimid;
   }
 
 public:
@@ -372,11 +466,16 @@ public:
    * @param dx Distance between left and right state midpoint (in m).
    * @param A Surface area of the interface (in m^2).
    * @param dt Current system time step, used for flux limiter (in s).
+   * @param left_weight Weight of the flux contribution to the left state (used
+   * if the left state has a longer time step than the interface).
+   * @param right_weight Weight of the flux contribution to the right state.
    */
   inline void do_flux_calculation(const uint_fast8_t i,
                                   HydroVariables &left_state,
                                   HydroVariables &right_state, const double dx,
-                                  const double A, const double dt) const {
+                                  const double A, const double dt,
+                                  const double left_weight = 1.,
+                                  const double right_weight = 1.) const {
 
     const double halfdx = 0.5 * dx;
     double rhoL = left_state.get_primitives_density() +
@@ -526,17 +625,108 @@ public:
     Eflux *= fluxfac;
 #endif
 
-    left_state.delta_conserved(0) -= mflux;
-    left_state.delta_conserved(1) -= pflux.x();
-    left_state.delta_conserved(2) -= pflux.y();
-    left_state.delta_conserved(3) -= pflux.z();
-    left_state.delta_conserved(4) -= Eflux;
+    left_state.delta_conserved(0) -= left_weight * mflux;
+    left_state.delta_conserved(1) -= left_weight * pflux.x();
+    left_state.delta_conserved(2) -= left_weight * pflux.y();
+    left_state.delta_conserved(3) -= left_weight * pflux.z();
+    left_state.delta_conserved(4) -= left_weight * Eflux;
+
+    right_state.delta_conserved(0) += right_weight * mflux;
+    right_state.delta_conserved(1) += right_weight * pflux.x();
+    right_state.delta_conserved(2) += right_weight * pflux.y();
+    right_state.delta_conserved(3) += right_weight * pflux.z();
+    right_state.delta_conserved(4) += right_weight * Eflux;
+  }
+
+  /**
+   * @brief Do the flux calculation for all interfaces in the given pencil.
+   *
+   * This is the structure-of-arrays equivalent of calling
+   * do_flux_calculation() for every pair of consecutive cells in the pencil,
+   * in order. The reconstruction, Riemann problem and flux limiter are
+   * computed in separate loops over the interfaces that can be vectorised by
+   * the compiler. The primitive variables, gradients, conserved variables and
+   * conserved variable changes of the cells need to be set in the pencil
+   * before calling this function; afterwards, the pencil contains the updated
+   * conserved variable changes.
+   *
+   * @param i Pencil direction: x (0), y (1) or z (2).
+   * @param pencil HydroPencil.
+   * @param n Number of cells in the pencil.
+   * @param dx Distance between consecutive cell midpoints (in m).
+   * @param A Surface area of the interfaces (in m^2).
+   * @param dt Current system time step, used for flux limiter (in s).
+   */
+  inline void do_pencil_flux_calculation(const uint_fast8_t i,
+                                         HydroPencil &pencil,
+                                         const uint_fast32_t n, const double dx,
+                                         const double A,
+                                         const double dt) const {
+
+    if (n < 2) {
+      return;
+    }
+    const uint_fast32_t nface = n - 1;
+
+    const double *W[5];
+    const double *dW[5];
+    double *WL[5];
+    double *WR[5];
+    double *F[5];
+    double *dQ[5];
+    for (uint_fast8_t q = 0; q < 5; ++q) {
+      W[q] = pencil.get_array(HYDROPENCIL_PRIMITIVES + q);
+      dW[q] = pencil.get_array(HYDROPENCIL_GRADIENTS + q);
+      WL[q] = pencil.get_array(HYDROPENCIL_LEFT_STATE + q);
+      WR[q] = pencil.get_array(HYDROPENCIL_RIGHT_STATE + q);
+      F[q] = pencil.get_array(HYDROPENCIL_FLUXES + q);
+      dQ[q] = pencil.get_array(HYDROPENCIL_DELTA_CONSERVED + q);
+    }
+
+    // reconstruct and limit the interface states
+    const double halfdx = 0.5 * dx;
+    for (uint_fast8_t q = 0; q < 5; ++q) {
+      const double *Wq = W[q];
+      const double *dWq = dW[q];
+      double *WLq = WL[q];
+      double *WRq = WR[q];
+      for (uint_fast32_t k = 0; k < nface; ++k) {
+        WLq[k] = limit(Wq[k] + halfdx * dWq[k], Wq[k], Wq[k + 1], 0.5);
+        WRq[k] = limit(Wq[k + 1] - halfdx * dWq[k + 1], Wq[k + 1], Wq[k], 0.5);
+      }
+    }
+
+    // make sure all densities and pressures are physical
+#ifdef SAFE_HYDRO_VARIABLES
+    for (uint_fast32_t k = 0; k < nface; ++k) {
+      WL[0][k] = std::max(WL[0][k], 0.);
+      WL[4][k] = std::max(WL[4][k], 0.);
+      WR[0][k] = std::max(WR[0][k], 0.);
+      WR[4][k] = std::max(WR[4][k], 0.);
+    }
+#endif
 
-    right_state.delta_conserved(0) += mflux;
-    right_state.delta_conserved(1) += pflux.x();
-    right_state.delta_conserved(2) += pflux.y();
-    right_state.delta_conserved(3) += pflux.z();
-    right_state.delta_conserved(4) += Eflux;
+    _riemann_solver.solve_for_flux_pencil(
+        nface, i, WL, WR, F, pencil.get_array(HYDROPENCIL_VACUUM_FLAGS));
+
+    // apply the surface area and the flux limiter
+    finalize_pencil_fluxes(
+        nface, A, dt, W[0], W[4], pencil.get_array(HYDROPENCIL_MASS),
+        pencil.get_array(HYDROPENCIL_TOTAL_ENERGY),
+        pencil.get_array(HYDROPENCIL_MOMENTUM2), F[0], F[1], F[2], F[3], F[4]);
+
+    // update the conserved variable changes; for every cell, we first add the
+    // flux through its left interface and then subtract the flux through its
+    // right interface, like in a sequence of do_flux_calculation() calls
+    for (uint_fast8_t q = 0; q < 5; ++q) {
+      const double *Fq = F[q];
+      double *dQq = dQ[q];
+      dQq[0] -= Fq[0];
+      for (uint_fast32_t k = 1; k < nface; ++k) {
+        dQq[k] = (dQq[k] + Fq[k - 1]) - Fq[k];
+      }
+      dQq[nface] += Fq[nface - 1];
+    }
   }
 
   /**
@@ -736,6 +926,44 @@ public:
     }
   }
 
+  /**
+   * @brief Do the gradient calculation for the given interface, but only
+   * update the gradients and limiters of one of the two states.
+   *
+   * This is used for interfaces between a subgrid that is active and a
+   * subgrid that is halfway a longer time step, whose gradients should not
+   * change.
+   *
+   * @param i Interface direction: x (0), y (1) or z (2).
+   * @param state State variables that are updated.
+   * @param other_state Variables of the state on the other side of the
+   * interface.
+   * @param dxinv Inverse distance between the state and the other state
+   * midpoint (in m; negative if the other state is on the left).
+   * @param Wlim State primitive variable limiters (updated; density - kg m^-3,
+   * velocity - m s^-1, pressure - kg m^-1 s^-2).
+   */
+  inline void do_one_sided_gradient_calculation(
+      const int_fast32_t i, HydroVariables &state,
+      const HydroVariables &other_state, const double dxinv,
+      double Wlim[10]) const {
+
+    for (int_fast32_t j = 0; j < 5; ++j) {
+      cmac_assert_message(state.primitives(j) == state.primitives(j),
+                          "j: %" PRIiFAST32, j);
+      cmac_assert_message(other_state.primitives(j) ==
+                              other_state.primitives(j),
+                          "j: %" PRIiFAST32, j);
+
+      const double dwdx =
+          0.5 * (state.primitives(j) + other_state.primitives(j)) * dxinv;
+
+      state.primitive_gradients(j)[i] += dwdx;
+      Wlim[2 * j] = std::min(Wlim[2 * j], other_state.primitives(j));
+      Wlim[2 * j + 1] = std::max(Wlim[2 * j + 1], other_state.primitives(j));
+    }
+  }
+
   /**
    * @brief Do the gradient calculation across a box boundary.
    *
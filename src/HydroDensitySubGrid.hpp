@@ -29,8 +29,11 @@
 #include "DensitySubGrid.hpp"
 #include "DensityValues.hpp"
 #include "Hydro.hpp"
+#include "HydroPencil.hpp"
 #include "HydroVariables.hpp"
 
+#include <algorithm>
+
 /**
  * @brief Extension of DensitySubGrid that adds hydro variables.
  */
@@ -54,6 +57,286 @@ private:
   /*! @brief Indices of the hydro tasks associated with this subgrid. */
   size_t _hydro_tasks[18];
 
+  /*! @brief Hydro time step of the subgrid on the integer time line. */
+  uint64_t _integer_timestep;
+
+  /*! @brief Integer time at the end of the current subgrid hydro time step. */
+  uint64_t _integer_end_time;
+
+  /*! @brief Hydro time step of the subgrid (in s). */
+  double _hydro_timestep;
+
+  /*! @brief Does the subgrid finish its hydro time step during the current
+   *  system time step? */
+  bool _hydro_active;
+
+  /**
+   * @brief Update the conserved variables for a single cell in the grid.
+   *
+   * @param i Index of the cell.
+   * @param timestep Integration time step size (in s).
+   */
+  inline void update_cell_conserved_variables(const int_fast32_t i,
+                                              const double timestep) {
+
+    const CoordinateVector<> a =
+        _hydro_variables[i].get_gravitational_acceleration();
+    const CoordinateVector<> p = _hydro_variables[i].get_conserved_momentum();
+    const double mdt = _hydro_variables[i].get_conserved_mass() * timestep;
+    _hydro_variables[i].conserved(1) += mdt * a.x();
+    _hydro_variables[i].conserved(2) += mdt * a.y();
+    _hydro_variables[i].conserved(3) += mdt * a.z();
+    _hydro_variables[i].conserved(4) +=
+        timestep * CoordinateVector<>::dot_product(p, a);
+    _hydro_variables[i].conserved(4) += _hydro_variables[i].get_energy_term();
+    _hydro_variables[i].set_energy_term(0.);
+    for (int_fast8_t j = 0; j < 5; ++j) {
+      _hydro_variables[i].conserved(j) +=
+          _hydro_variables[i].delta_conserved(j) * timestep;
+
+      // reset hydro variables
+      _hydro_variables[i].delta_conserved(j) = 0;
+      _hydro_variables[i].primitive_gradients(j) = CoordinateVector<>(0.);
+      _primitive_variable_limiters[10 * i + 2 * j] = DBL_MAX;
+      _primitive_variable_limiters[10 * i + 2 * j + 1] = -DBL_MAX;
+    }
+
+    cmac_assert(_hydro_variables[i].get_conserved_mass() ==
+                _hydro_variables[i].get_conserved_mass());
+    cmac_assert(_hydro_variables[i].get_conserved_momentum().x() ==
+                _hydro_variables[i].get_conserved_momentum().x());
+    cmac_assert(_hydro_variables[i].get_conserved_momentum().y() ==
+                _hydro_variables[i].get_conserved_momentum().y());
+    cmac_assert(_hydro_variables[i].get_conserved_momentum().z() ==
+                _hydro_variables[i].get_conserved_momentum().z());
+    cmac_assert(_hydro_variables[i].get_conserved_total_energy() ==
+                _hydro_variables[i].get_conserved_total_energy());
+
+#ifdef SAFE_HYDRO_VARIABLES
+    _hydro_variables[i].conserved(0) =
+        std::max(_hydro_variables[i].get_conserved_mass(), 0.);
+    _hydro_variables[i].conserved(4) =
+        std::max(_hydro_variables[i].get_conserved_total_energy(), 0.);
+#else
+    cmac_assert(_hydro_variables[i].get_conserved_mass() >= 0.);
+    cmac_assert(_hydro_variables[i].get_conserved_total_energy() >= 0.);
+#endif
+  }
+
+  /**
+   * @brief Get the coordinate axis of the given face neighbour direction, and
+   * the side of the boundary this subgrid is on.
+   *
+   * @param direction TravelDirection of the neighbour.
+   * @param i Coordinate axis perpendicular to the boundary (output variable).
+   * @param this_left Is this subgrid on the left side (lower coordinates) of
+   * the boundary (output variable)?
+   */
+  inline static void get_face_orientation(const int_fast32_t direction,
+                                          uint_fast8_t &i, bool &this_left) {
+    switch (direction) {
+    case TRAVELDIRECTION_FACE_X_P:
+      i = 0;
+      this_left = true;
+      break;
+    case TRAVELDIRECTION_FACE_X_N:
+      i = 0;
+      this_left = false;
+      break;
+    case TRAVELDIRECTION_FACE_Y_P:
+      i = 1;
+      this_left = true;
+      break;
+    case TRAVELDIRECTION_FACE_Y_N:
+      i = 1;
+      this_left = false;
+      break;
+    case TRAVELDIRECTION_FACE_Z_P:
+      i = 2;
+      this_left = true;
+      break;
+    case TRAVELDIRECTION_FACE_Z_N:
+      i = 2;
+      this_left = false;
+      break;
+    default:
+      cmac_error("Unknown hydro neighbour: %" PRIiFAST32, direction);
+      break;
+    }
+  }
+
+  /**
+   * @brief Compute the hydrodynamical fluxes for all interfaces at the boundary
+   * between this subgrid and a neighbouring subgrid on a different refinement
+   * level.
+   *
+   * The two subgrids should differ by exactly one refinement level, so that
+   * every cell on the coarse side of the boundary borders 4 cells on the fine
+   * side. We compute a flux for every fine interface, using a ghost cell that
+   * mirrors the fine cell on the coarse side. The primitive variables of the
+   * ghost cell are extrapolated from the coarse cell using its gradients.
+   * The fluxes through the 4 fine interfaces are summed onto the coarse cell,
+   * so that the scheme remains conservative.
+   *
+   * @param direction TravelDirection of the neighbour.
+   * @param hydro Hydro instance to use.
+   * @param neighbour Neighbouring DensitySubGrid.
+   * @param dt Current system time step (in s).
+   * @param this_weight Weight of the flux contributions to the cells in this
+   * subgrid.
+   * @param neighbour_weight Weight of the flux contributions to the cells in
+   * the neighbouring subgrid.
+   */
+  inline void level_boundary_flux_sweep(const int_fast32_t direction,
+                                        const Hydro &hydro,
+                                        HydroDensitySubGrid &neighbour,
+                                        const double dt,
+                                        const double this_weight,
+                                        const double neighbour_weight) {
+
+    uint_fast8_t i;
+    bool this_left;
+    get_face_orientation(direction, i, this_left);
+    const bool this_fine = _number_of_cells[0] > neighbour._number_of_cells[0];
+    HydroDensitySubGrid &fine = this_fine ? *this : neighbour;
+    HydroDensitySubGrid &coarse = this_fine ? neighbour : *this;
+    const bool fine_left = (this_fine == this_left);
+    const double fine_weight = this_fine ? this_weight : neighbour_weight;
+    const double coarse_weight = this_fine ? neighbour_weight : this_weight;
+
+    cmac_assert_message(
+        fine._number_of_cells[0] == 2 * coarse._number_of_cells[0] &&
+            fine._number_of_cells[1] == 2 * coarse._number_of_cells[1] &&
+            fine._number_of_cells[2] == 2 * coarse._number_of_cells[2],
+        "Neighbouring subgrids differ by more than one refinement level!");
+
+    const uint_fast8_t a = (i + 1) % 3;
+    const uint_fast8_t b = (i + 2) % 3;
+    CoordinateVector< int_fast32_t > fine_index, coarse_index;
+    fine_index[i] = fine_left ? fine._number_of_cells[i] - 1 : 0;
+    coarse_index[i] = fine_left ? 0 : coarse._number_of_cells[i] - 1;
+    const double dx = fine._cell_size[i];
+    const double A = fine._cell_areas[i];
+    // offset of the ghost cell midpoint w.r.t. the coarse cell midpoint: the
+    // ghost cell is half a fine cell closer to the boundary
+    CoordinateVector<> offset;
+    offset[i] = fine_left ? -0.5 * dx : 0.5 * dx;
+    for (int_fast32_t ja = 0; ja < fine._number_of_cells[a]; ++ja) {
+      fine_index[a] = ja;
+      coarse_index[a] = ja >> 1;
+      offset[a] = ((ja & 1) - 0.5) * fine._cell_size[a];
+      for (int_fast32_t jb = 0; jb < fine._number_of_cells[b]; ++jb) {
+        fine_index[b] = jb;
+        coarse_index[b] = jb >> 1;
+        offset[b] = ((jb & 1) - 0.5) * fine._cell_size[b];
+
+        HydroVariables &fine_variables =
+            fine._hydro_variables[fine.get_one_index(fine_index)];
+        HydroVariables &coarse_variables =
+            coarse._hydro_variables[coarse.get_one_index(coarse_index)];
+        HydroVariables ghost_variables;
+        ghost_variables.copy_all(coarse_variables);
+        for (uint_fast8_t q = 0; q < 5; ++q) {
+          ghost_variables.primitives(q) += CoordinateVector<>::dot_product(
+              coarse_variables.primitive_gradients(q), offset);
+          ghost_variables.delta_conserved(q) = 0.;
+        }
+        if (fine_left) {
+          hydro.do_flux_calculation(i, fine_variables, ghost_variables, dx, A,
+                                    dt, fine_weight, coarse_weight);
+        } else {
+          hydro.do_flux_calculation(i, ghost_variables, fine_variables, dx, A,
+                                    dt, coarse_weight, fine_weight);
+        }
+        for (uint_fast8_t q = 0; q < 5; ++q) {
+          coarse_variables.delta_conserved(q) +=
+              ghost_variables.delta_conserved(q);
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Compute the hydrodynamical gradients for all interfaces at the
+   * boundary between this subgrid and a neighbouring subgrid on a different
+   * refinement level.
+   *
+   * The two subgrids should differ by exactly one refinement level. Every
+   * fine cell uses the coarse cell it borders as neighbour, while every
+   * coarse cell uses the average of the 4 fine cells it borders.
+   *
+   * @param direction TravelDirection of the neighbour.
+   * @param hydro Hydro instance to use.
+   * @param neighbour Neighbouring DensitySubGrid.
+   * @param update_this Update the gradients of the cells in this subgrid?
+   * @param update_neighbour Update the gradients of the cells in the
+   * neighbouring subgrid?
+   */
+  inline void level_boundary_gradient_sweep(const int_fast32_t direction,
+                                            const Hydro &hydro,
+                                            HydroDensitySubGrid &neighbour,
+                                            const bool update_this,
+                                            const bool update_neighbour) {
+
+    uint_fast8_t i;
+    bool this_left;
+    get_face_orientation(direction, i, this_left);
+    const bool this_fine = _number_of_cells[0] > neighbour._number_of_cells[0];
+    HydroDensitySubGrid &fine = this_fine ? *this : neighbour;
+    HydroDensitySubGrid &coarse = this_fine ? neighbour : *this;
+    const bool fine_left = (this_fine == this_left);
+    const bool update_fine = this_fine ? update_this : update_neighbour;
+    const bool update_coarse = this_fine ? update_neighbour : update_this;
+
+    cmac_assert_message(
+        fine._number_of_cells[0] == 2 * coarse._number_of_cells[0] &&
+            fine._number_of_cells[1] == 2 * coarse._number_of_cells[1] &&
+            fine._number_of_cells[2] == 2 * coarse._number_of_cells[2],
+        "Neighbouring subgrids differ by more than one refinement level!");
+
+    const uint_fast8_t a = (i + 1) % 3;
+    const uint_fast8_t b = (i + 2) % 3;
+    CoordinateVector< int_fast32_t > fine_index, coarse_index;
+    fine_index[i] = fine_left ? fine._number_of_cells[i] - 1 : 0;
+    coarse_index[i] = fine_left ? 0 : coarse._number_of_cells[i] - 1;
+    // the inverse distance is negative if the other state is on the left
+    const double fine_dxinv =
+        fine_left ? fine._inv_cell_size[i] : -fine._inv_cell_size[i];
+    const double coarse_dxinv =
+        fine_left ? -coarse._inv_cell_size[i] : coarse._inv_cell_size[i];
+    for (int_fast32_t ca = 0; ca < coarse._number_of_cells[a]; ++ca) {
+      coarse_index[a] = ca;
+      for (int_fast32_t cb = 0; cb < coarse._number_of_cells[b]; ++cb) {
+        coarse_index[b] = cb;
+        const int_fast32_t coarse_cell = coarse.get_one_index(coarse_index);
+        HydroVariables &coarse_variables =
+            coarse._hydro_variables[coarse_cell];
+
+        HydroVariables average_variables;
+        for (uint_fast8_t k = 0; k < 4; ++k) {
+          fine_index[a] = 2 * ca + (k >> 1);
+          fine_index[b] = 2 * cb + (k & 1);
+          const int_fast32_t fine_cell = fine.get_one_index(fine_index);
+          HydroVariables &fine_variables = fine._hydro_variables[fine_cell];
+          for (uint_fast8_t q = 0; q < 5; ++q) {
+            average_variables.primitives(q) +=
+                0.25 * fine_variables.primitives(q);
+          }
+          if (update_fine) {
+            hydro.do_one_sided_gradient_calculation(
+                i, fine_variables, coarse_variables, fine_dxinv,
+                &fine._primitive_variable_limiters[10 * fine_cell]);
+          }
+        }
+        if (update_coarse) {
+          hydro.do_one_sided_gradient_calculation(
+              i, coarse_variables, average_variables, coarse_dxinv,
+              &coarse._primitive_variable_limiters[10 * coarse_cell]);
+        }
+      }
+    }
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -70,7 +353,9 @@ public:
         _inverse_cell_volume(1. / _cell_volume),
         _cell_areas{_cell_size[1] * _cell_size[2],
                     _cell_size[0] * _cell_size[2],
-                    _cell_size[0] * _cell_size[1]} {
+                    _cell_size[0] * _cell_size[1]},
+        _integer_timestep(0), _integer_end_time(0), _hydro_timestep(0.),
+        _hydro_active(true) {
 
     // allocate memory for data arrays
     const int_fast32_t tot_ncell = _number_of_cells[3] * ncell[0];
@@ -92,7 +377,11 @@ public:
       : DensitySubGrid(original), _cell_volume(original._cell_volume),
         _inverse_cell_volume(original._inverse_cell_volume),
         _cell_areas{original._cell_areas[0], original._cell_areas[1],
-                    original._cell_areas[2]} {
+                    original._cell_areas[2]},
+        _integer_timestep(original._integer_timestep),
+        _integer_end_time(original._integer_end_time),
+        _hydro_timestep(original._hydro_timestep),
+        _hydro_active(original._hydro_active) {
 
     const int_fast32_t tot_ncell = _number_of_cells[3] * _number_of_cells[0];
     _hydro_variables = new HydroVariables[tot_ncell];
@@ -155,48 +444,29 @@ public:
     const int_fast32_t tot_num_cells =
         _number_of_cells[0] * _number_of_cells[3];
     for (int_fast32_t i = 0; i < tot_num_cells; ++i) {
-      const CoordinateVector<> a =
-          _hydro_variables[i].get_gravitational_acceleration();
-      const CoordinateVector<> p = _hydro_variables[i].get_conserved_momentum();
-      const double mdt = _hydro_variables[i].get_conserved_mass() * timestep;
-      _hydro_variables[i].conserved(1) += mdt * a.x();
-      _hydro_variables[i].conserved(2) += mdt * a.y();
-      _hydro_variables[i].conserved(3) += mdt * a.z();
-      _hydro_variables[i].conserved(4) +=
-          timestep * CoordinateVector<>::dot_product(p, a);
-      _hydro_variables[i].conserved(4) += _hydro_variables[i].get_energy_term();
-      _hydro_variables[i].set_energy_term(0.);
-      for (int_fast8_t j = 0; j < 5; ++j) {
-        _hydro_variables[i].conserved(j) +=
-            _hydro_variables[i].delta_conserved(j) * timestep;
-
-        // reset hydro variables
-        _hydro_variables[i].delta_conserved(j) = 0;
-        _hydro_variables[i].primitive_gradients(j) = CoordinateVector<>(0.);
-        _primitive_variable_limiters[10 * i + 2 * j] = DBL_MAX;
-        _primitive_variable_limiters[10 * i + 2 * j + 1] = -DBL_MAX;
-      }
+      update_cell_conserved_variables(i, timestep);
+    }
+  }
 
-      cmac_assert(_hydro_variables[i].get_conserved_mass() ==
-                  _hydro_variables[i].get_conserved_mass());
-      cmac_assert(_hydro_variables[i].get_conserved_momentum().x() ==
-                  _hydro_variables[i].get_conserved_momentum().x());
-      cmac_assert(_hydro_variables[i].get_conserved_momentum().y() ==
-                  _hydro_variables[i].get_conserved_momentum().y());
-      cmac_assert(_hydro_variables[i].get_conserved_momentum().z() ==
-                  _hydro_variables[i].get_conserved_momentum().z());
-      cmac_assert(_hydro_variables[i].get_conserved_total_energy() ==
-                  _hydro_variables[i].get_conserved_total_energy());
+  /**
+   * @brief Update the conserved variables and then the primitive variables
+   * for all cells in the grid, in a single pass over the cells.
+   *
+   * This is equivalent to update_conserved_variables() followed by
+   * update_primitive_variables().
+   *
+   * @param hydro Hydro instance to use.
+   * @param timestep Integration time step size (in s).
+   */
+  inline void update_conserved_and_primitive_variables(const Hydro &hydro,
+                                                       const double timestep) {
 
-#ifdef SAFE_HYDRO_VARIABLES
-      _hydro_variables[i].conserved(0) =
-          std::max(_hydro_variables[i].get_conserved_mass(), 0.);
-      _hydro_variables[i].conserved(4) =
-          std::max(_hydro_variables[i].get_conserved_total_energy(), 0.);
-#else
-      cmac_assert(_hydro_variables[i].get_conserved_mass() >= 0.);
-      cmac_assert(_hydro_variables[i].get_conserved_total_energy() >= 0.);
-#endif
+    const int_fast32_t tot_num_cells =
+        _number_of_cells[0] * _number_of_cells[3];
+    for (int_fast32_t i = 0; i < tot_num_cells; ++i) {
+      update_cell_conserved_variables(i, timestep);
+      hydro.set_primitive_variables(
+          _hydro_variables[i], _ionization_variables[i], _inverse_cell_volume);
     }
   }
 
@@ -270,6 +540,29 @@ public:
     }
   }
 
+  /**
+   * @brief Apply the slope limiter to all primitive variable gradients and
+   * predict the primitive variables forward in time, in a single pass over the
+   * cells.
+   *
+   * This is equivalent to apply_slope_limiter() followed by
+   * predict_primitive_variables().
+   *
+   * @param hydro Hydro instance to use.
+   * @param timestep Half system time step (in s).
+   */
+  inline void limit_and_predict_primitive_variables(const Hydro &hydro,
+                                                    const double timestep) {
+    const int_fast32_t tot_num_cells =
+        _number_of_cells[0] * _number_of_cells[3];
+    for (int_fast32_t i = 0; i < tot_num_cells; ++i) {
+      hydro.apply_slope_limiter(_hydro_variables[i],
+                                &_primitive_variable_limiters[10 * i],
+                                _cell_size);
+      hydro.predict_primitive_variables(_hydro_variables[i], timestep);
+    }
+  }
+
   /**
    * @brief Apply the slope limiter to all primitive variable gradients.
    *
@@ -285,56 +578,96 @@ public:
     }
   }
 
+  /**
+   * @brief Compute the hydrodynamical fluxes for all interfaces in a single
+   * pencil of cells.
+   *
+   * The cell variables are copied into the structure-of-arrays pencil buffer,
+   * the fluxes are computed using Hydro::do_pencil_flux_calculation() and the
+   * updated conserved variable changes are copied back.
+   *
+   * @param i Pencil direction: x (0), y (1) or z (2).
+   * @param hydro Hydro instance to use.
+   * @param pencil HydroPencil buffer.
+   * @param start_index Index of the first cell in the pencil.
+   * @param stride Index increment between consecutive cells in the pencil.
+   * @param dt Current system time step (in s).
+   */
+  inline void pencil_flux_sweep(const uint_fast8_t i, const Hydro &hydro,
+                                HydroPencil &pencil,
+                                const int_fast32_t start_index,
+                                const int_fast32_t stride, const double dt) {
+
+    const int_fast32_t n = _number_of_cells[i];
+
+    double *W[5], *dW[5], *dQ[5];
+    for (uint_fast8_t q = 0; q < 5; ++q) {
+      W[q] = pencil.get_array(HYDROPENCIL_PRIMITIVES + q);
+      dW[q] = pencil.get_array(HYDROPENCIL_GRADIENTS + q);
+      dQ[q] = pencil.get_array(HYDROPENCIL_DELTA_CONSERVED + q);
+    }
+    double *mass = pencil.get_array(HYDROPENCIL_MASS);
+    double *total_energy = pencil.get_array(HYDROPENCIL_TOTAL_ENERGY);
+    double *momentum2 = pencil.get_array(HYDROPENCIL_MOMENTUM2);
+
+    for (int_fast32_t k = 0; k < n; ++k) {
+      const HydroVariables &variables =
+          _hydro_variables[start_index + k * stride];
+      for (uint_fast8_t q = 0; q < 5; ++q) {
+        W[q][k] = variables.primitives(q);
+        dW[q][k] = variables.primitive_gradients(q)[i];
+        dQ[q][k] = variables.delta_conserved(q);
+      }
+      mass[k] = variables.get_conserved_mass();
+      total_energy[k] = variables.get_conserved_total_energy();
+      momentum2[k] = variables.get_conserved_momentum().norm2();
+    }
+
+    hydro.do_pencil_flux_calculation(i, pencil, n, _cell_size[i],
+                                     _cell_areas[i], dt);
+
+    for (int_fast32_t k = 0; k < n; ++k) {
+      HydroVariables &variables = _hydro_variables[start_index + k * stride];
+      for (uint_fast8_t q = 0; q < 5; ++q) {
+        variables.delta_conserved(q) = dQ[q][k];
+      }
+    }
+  }
+
   /**
    * @brief Compute the hydrodynamical fluxes for all interfaces inside the
    * subgrid.
    *
+   * The interfaces are processed per pencil of cells using
+   * pencil_flux_sweep().
+   *
    * @param hydro Hydro instance to use.
    * @param dt Current system time step (in s).
    */
   inline void inner_flux_sweep(const Hydro &hydro, const double dt) {
 
-    // we do three separate sweeps: one for every coordinate direction
-    for (int_fast32_t ix = 0; ix < _number_of_cells[0] - 1; ++ix) {
-      for (int_fast32_t iy = 0; iy < _number_of_cells[1]; ++iy) {
-        for (int_fast32_t iz = 0; iz < _number_of_cells[2]; ++iz) {
-          const int_fast32_t index000 =
-              ix * _number_of_cells[3] + iy * _number_of_cells[2] + iz;
-          const int_fast32_t index100 =
-              (ix + 1) * _number_of_cells[3] + iy * _number_of_cells[2] + iz;
-          // x direction
-          hydro.do_flux_calculation(0, _hydro_variables[index000],
-                                    _hydro_variables[index100], _cell_size[0],
-                                    _cell_areas[0], dt);
-        }
+    // we do three separate sweeps, one for every coordinate direction, over
+    // pencils of cells along that direction
+    HydroPencil pencil(std::max(_number_of_cells[0],
+                                std::max(_number_of_cells[1],
+                                         _number_of_cells[2])));
+    for (int_fast32_t iy = 0; iy < _number_of_cells[1]; ++iy) {
+      for (int_fast32_t iz = 0; iz < _number_of_cells[2]; ++iz) {
+        pencil_flux_sweep(0, hydro, pencil, iy * _number_of_cells[2] + iz,
+                          _number_of_cells[3], dt);
       }
     }
     for (int_fast32_t ix = 0; ix < _number_of_cells[0]; ++ix) {
-      for (int_fast32_t iy = 0; iy < _number_of_cells[1] - 1; ++iy) {
-        for (int_fast32_t iz = 0; iz < _number_of_cells[2]; ++iz) {
-          const int_fast32_t index000 =
-              ix * _number_of_cells[3] + iy * _number_of_cells[2] + iz;
-          const int_fast32_t index010 =
-              ix * _number_of_cells[3] + (iy + 1) * _number_of_cells[2] + iz;
-          // y direction
-          hydro.do_flux_calculation(1, _hydro_variables[index000],
-                                    _hydro_variables[index010], _cell_size[1],
-                                    _cell_areas[1], dt);
-        }
+      for (int_fast32_t iz = 0; iz < _number_of_cells[2]; ++iz) {
+        pencil_flux_sweep(1, hydro, pencil, ix * _number_of_cells[3] + iz,
+                          _number_of_cells[2], dt);
       }
     }
     for (int_fast32_t ix = 0; ix < _number_of_cells[0]; ++ix) {
       for (int_fast32_t iy = 0; iy < _number_of_cells[1]; ++iy) {
-        for (int_fast32_t iz = 0; iz < _number_of_cells[2] - 1; ++iz) {
-          const int_fast32_t index000 =
-              ix * _number_of_cells[3] + iy * _number_of_cells[2] + iz;
-          const int_fast32_t index001 =
-              ix * _number_of_cells[3] + iy * _number_of_cells[2] + iz + 1;
-          // z direction
-          hydro.do_flux_calculation(2, _hydro_variables[index000],
-                                    _hydro_variables[index001], _cell_size[2],
-                                    _cell_areas[2], dt);
-        }
+        pencil_flux_sweep(
+            2, hydro, pencil,
+            ix * _number_of_cells[3] + iy * _number_of_cells[2], 1, dt);
       }
     }
   }
@@ -343,24 +676,41 @@ public:
    * @brief Compute the hydrodynamical fluxes for all interfaces at the boundary
    * between this subgrid and the given neighbouring subgrid.
    *
+   * If the neighbour is on a different refinement level, the fluxes are
+   * computed by level_boundary_flux_sweep().
+   *
    * @param direction TravelDirection of the neighbour.
    * @param hydro Hydro instance to use.
    * @param neighbour Neighbouring DensitySubGrid.
    * @param dt Current system time step (in s).
+   * @param this_weight Weight of the flux contributions to the cells in this
+   * subgrid.
+   * @param neighbour_weight Weight of the flux contributions to the cells in
+   * the neighbouring subgrid.
    */
   inline void outer_flux_sweep(const int_fast32_t direction, const Hydro &hydro,
-                               HydroDensitySubGrid &neighbour,
-                               const double dt) {
+                               HydroDensitySubGrid &neighbour, const double dt,
+                               const double this_weight = 1.,
+                               const double neighbour_weight = 1.) {
+
+    if (neighbour._number_of_cells[0] != _number_of_cells[0]) {
+      level_boundary_flux_sweep(direction, hydro, neighbour, dt, this_weight,
+                                neighbour_weight);
+      return;
+    }
 
     int_fast32_t i, start_index_left, start_index_right, row_increment,
         row_length, column_increment, column_length;
     double dx, A;
+    double left_weight, right_weight;
     HydroDensitySubGrid *left_grid, *right_grid;
     switch (direction) {
     case TRAVELDIRECTION_FACE_X_P:
       i = 0;
       left_grid = this;
       right_grid = &neighbour;
+      left_weight = this_weight;
+      right_weight = neighbour_weight;
       start_index_left = (_number_of_cells[0] - 1) * _number_of_cells[3];
       start_index_right = 0;
       row_increment = 1;
@@ -374,6 +724,8 @@ public:
       i = 0;
       left_grid = &neighbour;
       right_grid = this;
+      left_weight = neighbour_weight;
+      right_weight = this_weight;
       start_index_left = (_number_of_cells[0] - 1) * _number_of_cells[3];
       start_index_right = 0;
       row_increment = 1;
@@ -387,6 +739,8 @@ public:
       i = 1;
       left_grid = this;
       right_grid = &neighbour;
+      left_weight = this_weight;
+      right_weight = neighbour_weight;
       start_index_left = (_number_of_cells[1] - 1) * _number_of_cells[2];
       start_index_right = 0;
       row_increment = 1;
@@ -400,6 +754,8 @@ public:
       i = 1;
       left_grid = &neighbour;
       right_grid = this;
+      left_weight = neighbour_weight;
+      right_weight = this_weight;
       start_index_left = (_number_of_cells[1] - 1) * _number_of_cells[2];
       start_index_right = 0;
       row_increment = 1;
@@ -413,6 +769,8 @@ public:
       i = 2;
       left_grid = this;
       right_grid = &neighbour;
+      left_weight = this_weight;
+      right_weight = neighbour_weight;
       start_index_left = _number_of_cells[2] - 1;
       start_index_right = 0;
       row_increment = _number_of_cells[2];
@@ -426,6 +784,8 @@ public:
       i = 2;
       left_grid = &neighbour;
       right_grid = this;
+      left_weight = neighbour_weight;
+      right_weight = this_weight;
       start_index_left = _number_of_cells[2] - 1;
       start_index_right = 0;
       row_increment = _number_of_cells[2];
@@ -450,7 +810,7 @@ public:
             start_index_right + ic * column_increment + ir * row_increment;
         hydro.do_flux_calculation(i, left_grid->_hydro_variables[index_left],
                                   right_grid->_hydro_variables[index_right], dx,
-                                  A, dt);
+                                  A, dt, left_weight, right_weight);
       }
     }
   }
@@ -619,23 +979,40 @@ public:
    * @brief Compute the hydrodynamical gradients for all interfaces at the
    * boundary between this subgrid and the given neighbouring subgrid.
    *
+   * If the neighbour is on a different refinement level, the gradients are
+   * computed by level_boundary_gradient_sweep().
+   *
    * @param direction TravelDirection of the neighbour.
    * @param hydro Hydro instance to use.
    * @param neighbour Neighbouring DensitySubGrid.
+   * @param update_this Update the gradients of the cells in this subgrid?
+   * @param update_neighbour Update the gradients of the cells in the
+   * neighbouring subgrid?
    */
   inline void outer_gradient_sweep(const int_fast32_t direction,
                                    const Hydro &hydro,
-                                   HydroDensitySubGrid &neighbour) {
+                                   HydroDensitySubGrid &neighbour,
+                                   const bool update_this = true,
+                                   const bool update_neighbour = true) {
+
+    if (neighbour._number_of_cells[0] != _number_of_cells[0]) {
+      level_boundary_gradient_sweep(direction, hydro, neighbour, update_this,
+                                    update_neighbour);
+      return;
+    }
 
     int_fast32_t i, start_index_left, start_index_right, row_increment,
         row_length, column_increment, column_length;
     double dxinv;
+    bool update_left, update_right;
     HydroDensitySubGrid *left_grid, *right_grid;
     switch (direction) {
     case TRAVELDIRECTION_FACE_X_P:
       i = 0;
       left_grid = this;
       right_grid = &neighbour;
+      update_left = update_this;
+      update_right = update_neighbour;
       start_index_left = (_number_of_cells[0] - 1) * _number_of_cells[3];
       start_index_right = 0;
       row_increment = 1;
@@ -648,6 +1025,8 @@ public:
       i = 0;
       left_grid = &neighbour;
       right_grid = this;
+      update_left = update_neighbour;
+      update_right = update_this;
       start_index_left = (_number_of_cells[0] - 1) * _number_of_cells[3];
       start_index_right = 0;
       row_increment = 1;
@@ -660,6 +1039,8 @@ public:
       i = 1;
       left_grid = this;
       right_grid = &neighbour;
+      update_left = update_this;
+      update_right = update_neighbour;
       start_index_left = (_number_of_cells[1] - 1) * _number_of_cells[2];
       start_index_right = 0;
       row_increment = 1;
@@ -672,6 +1053,8 @@ public:
       i = 1;
       left_grid = &neighbour;
       right_grid = this;
+      update_left = update_neighbour;
+      update_right = update_this;
       start_index_left = (_number_of_cells[1] - 1) * _number_of_cells[2];
       start_index_right = 0;
       row_increment = 1;
@@ -684,6 +1067,8 @@ public:
       i = 2;
       left_grid = this;
       right_grid = &neighbour;
+      update_left = update_this;
+      update_right = update_neighbour;
       start_index_left = _number_of_cells[2] - 1;
       start_index_right = 0;
       row_increment = _number_of_cells[2];
@@ -696,6 +1081,8 @@ public:
       i = 2;
       left_grid = &neighbour;
       right_grid = this;
+      update_left = update_neighbour;
+      update_right = update_this;
       start_index_left = _number_of_cells[2] - 1;
       start_index_right = 0;
       row_increment = _number_of_cells[2];
@@ -717,11 +1104,23 @@ public:
             start_index_left + ic * column_increment + ir * row_increment;
         const int_fast32_t index_right =
             start_index_right + ic * column_increment + ir * row_increment;
-        hydro.do_gradient_calculation(
-            i, left_grid->_hydro_variables[index_left],
-            right_grid->_hydro_variables[index_right], dxinv,
-            &left_grid->_primitive_variable_limiters[10 * index_left],
-            &right_grid->_primitive_variable_limiters[10 * index_right]);
+        if (update_left && update_right) {
+          hydro.do_gradient_calculation(
+              i, left_grid->_hydro_variables[index_left],
+              right_grid->_hydro_variables[index_right], dxinv,
+              &left_grid->_primitive_variable_limiters[10 * index_left],
+              &right_grid->_primitive_variable_limiters[10 * index_right]);
+        } else if (update_left) {
+          hydro.do_one_sided_gradient_calculation(
+              i, left_grid->_hydro_variables[index_left],
+              right_grid->_hydro_variables[index_right], dxinv,
+              &left_grid->_primitive_variable_limiters[10 * index_left]);
+        } else if (update_right) {
+          hydro.do_one_sided_gradient_calculation(
+              i, right_grid->_hydro_variables[index_right],
+              left_grid->_hydro_variables[index_left], -dxinv,
+              &right_grid->_primitive_variable_limiters[10 * index_right]);
+        }
       }
     }
   }
@@ -851,6 +1250,59 @@ public:
     return _hydro_tasks[i];
   }
 
+  /**
+   * @brief Set the hydro time step for this subgrid.
+   *
+   * @param integer_timestep Time step on the integer time line.
+   * @param integer_end_time Integer time at the end of the time step.
+   * @param timestep Physical time step (in s).
+   */
+  inline void set_hydro_timestep(const uint64_t integer_timestep,
+                                 const uint64_t integer_end_time,
+                                 const double timestep) {
+    _integer_timestep = integer_timestep;
+    _integer_end_time = integer_end_time;
+    _hydro_timestep = timestep;
+  }
+
+  /**
+   * @brief Get the hydro time step of this subgrid on the integer time line.
+   *
+   * @return Integer time step.
+   */
+  inline uint64_t get_integer_timestep() const { return _integer_timestep; }
+
+  /**
+   * @brief Get the integer time at the end of the current hydro time step of
+   * this subgrid.
+   *
+   * @return Integer end time.
+   */
+  inline uint64_t get_integer_end_time() const { return _integer_end_time; }
+
+  /**
+   * @brief Get the hydro time step of this subgrid.
+   *
+   * @return Time step (in s).
+   */
+  inline double get_hydro_timestep() const { return _hydro_timestep; }
+
+  /**
+   * @brief Set whether or not this subgrid finishes its hydro time step during
+   * the current system time step.
+   *
+   * @param active Is the subgrid active?
+   */
+  inline void set_hydro_active(const bool active) { _hydro_active = active; }
+
+  /**
+   * @brief Does this subgrid finish its hydro time step during the current
+   * system time step?
+   *
+   * @return True if the hydro tasks for this subgrid need to be executed.
+   */
+  inline bool is_hydro_active() const { return _hydro_active; }
+
   /**
    * @brief Initialize the hydrodynamic variables for a cell in this subgrid.
    *
@@ -1062,6 +1514,10 @@ public:
     restart_writer.write(_cell_areas[0]);
     restart_writer.write(_cell_areas[1]);
     restart_writer.write(_cell_areas[2]);
+    restart_writer.write(_integer_timestep);
+    restart_writer.write(_integer_end_time);
+    restart_writer.write(_hydro_timestep);
+    restart_writer.write(_hydro_active);
     const int_fast32_t number_of_cells =
         _number_of_cells[0] * _number_of_cells[1] * _number_of_cells[2];
     for (int_fast32_t i = 0; i < number_of_cells; ++i) {
@@ -1082,6 +1538,10 @@ public:
     _cell_areas[0] = restart_reader.read< double >();
     _cell_areas[1] = restart_reader.read< double >();
     _cell_areas[2] = restart_reader.read< double >();
+    _integer_timestep = restart_reader.read< uint64_t >();
+    _integer_end_time = restart_reader.read< uint64_t >();
+    _hydro_timestep = restart_reader.read< double >();
+    _hydro_active = restart_reader.read< bool >();
     const int_fast32_t number_of_cells =
         _number_of_cells[0] * _number_of_cells[1] * _number_of_cells[2];
     _hydro_variables = new HydroVariables[number_of_cells];
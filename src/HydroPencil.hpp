@@ -0,0 +1,122 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file HydroPencil.hpp
+ *
+ * @brief Structure-of-arrays buffer for a pencil of cells along one coordinate
+ * axis, used by the vectorised hydro flux sweep.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef HYDROPENCIL_HPP
+#define HYDROPENCIL_HPP
+
+#include <cinttypes>
+#include <vector>
+
+/**
+ * @brief Arrays stored in a HydroPencil.
+ *
+ * Every array contains one value for every cell (or interface) in the pencil.
+ */
+enum HydroPencilArray {
+  /*! @brief Primitive variables (density, velocity, pressure). */
+  HYDROPENCIL_PRIMITIVES = 0,
+  /*! @brief Component of the primitive variable gradients along the pencil
+   *  axis. */
+  HYDROPENCIL_GRADIENTS = HYDROPENCIL_PRIMITIVES + 5,
+  /*! @brief Conserved variable changes. */
+  HYDROPENCIL_DELTA_CONSERVED = HYDROPENCIL_GRADIENTS + 5,
+  /*! @brief Conserved mass (used by the flux limiter). */
+  HYDROPENCIL_MASS = HYDROPENCIL_DELTA_CONSERVED + 5,
+  /*! @brief Conserved total energy (used by the flux limiter). */
+  HYDROPENCIL_TOTAL_ENERGY,
+  /*! @brief Squared norm of the conserved momentum (used by the flux
+   *  limiter). */
+  HYDROPENCIL_MOMENTUM2,
+  /*! @brief Reconstructed left state primitive variables at the interfaces. */
+  HYDROPENCIL_LEFT_STATE,
+  /*! @brief Reconstructed right state primitive variables at the
+   *  interfaces. */
+  HYDROPENCIL_RIGHT_STATE = HYDROPENCIL_LEFT_STATE + 5,
+  /*! @brief Fluxes through the interfaces. */
+  HYDROPENCIL_FLUXES = HYDROPENCIL_RIGHT_STATE + 5,
+  /*! @brief Flags marking interfaces that need the scalar Riemann solver. */
+  HYDROPENCIL_VACUUM_FLAGS = HYDROPENCIL_FLUXES + 5,
+  /*! @brief Counter. Should always be the last element! */
+  HYDROPENCIL_NUMBER
+};
+
+/**
+ * @brief Structure-of-arrays buffer for a pencil of cells along one coordinate
+ * axis.
+ *
+ * Interface @f$k@f$ of the pencil is the interface between cell @f$k@f$ and
+ * cell @f$k+1@f$, so a pencil of @f$n@f$ cells has @f$n-1@f$ interfaces.
+ */
+class HydroPencil {
+private:
+  /*! @brief Maximum number of cells in the pencil. */
+  const uint_fast32_t _maximum_size;
+
+  /*! @brief Contiguous storage for all arrays. */
+  std::vector< double > _data;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param maximum_size Maximum number of cells in the pencil.
+   */
+  inline HydroPencil(const uint_fast32_t maximum_size)
+      : _maximum_size(maximum_size),
+        _data(HYDROPENCIL_NUMBER * maximum_size, 0.) {}
+
+  /**
+   * @brief Get the maximum number of cells in the pencil.
+   *
+   * @return Maximum number of cells in the pencil.
+   */
+  inline uint_fast32_t get_maximum_size() const { return _maximum_size; }
+
+  /**
+   * @brief Access the given array.
+   *
+   * @param array HydroPencilArray (optionally with an offset added for the
+   * arrays that contain 5 variables).
+   * @return Pointer to the start of the array.
+   */
+  inline double *get_array(const int_fast32_t array) {
+    return &_data[array * _maximum_size];
+  }
+
+  /**
+   * @brief Access the given array (read only).
+   *
+   * @param array HydroPencilArray (optionally with an offset added for the
+   * arrays that contain 5 variables).
+   * @return Pointer to the start of the array.
+   */
+  inline const double *get_array(const int_fast32_t array) const {
+    return &_data[array * _maximum_size];
+  }
+
+};
+
+#endif // HYDROPENCIL_HPP
@@ -46,6 +46,7 @@ HydrogenLymanContinuumSpectrum::HydrogenLymanContinuumSpectrum(
   _cumulative_distribution.resize(
       HYDROGENLYMANCONTINUUMSPECTRUM_NUMTEMP,
       std::vector< double >(HYDROGENLYMANCONTINUUMSPECTRUM_NUMFREQ, 0.));
+  _cumulative_distribution_guide.resize(HYDROGENLYMANCONTINUUMSPECTRUM_NUMTEMP);
 
   // some constants
   // 13.6 eV in Hz
@@ -118,7 +119,16 @@ HydrogenLymanContinuumSpectrum::HydrogenLymanContinuumSpectrum(
           _cumulative_distribution[iT]
                                   [HYDROGENLYMANCONTINUUMSPECTRUM_NUMFREQ - 1];
     }
+
+    // set up the guide table used to sample the cumulative distribution
+    _cumulative_distribution_guide[iT].initialize(
+        _cumulative_distribution[iT].data(),
+        HYDROGENLYMANCONTINUUMSPECTRUM_NUMFREQ);
   }
+
+  // set up the guide table used to locate temperatures
+  _temperature_guide.initialize(_temperature.data(),
+                                HYDROGENLYMANCONTINUUMSPECTRUM_NUMTEMP);
 }
 
 /**
@@ -128,6 +138,8 @@ HydrogenLymanContinuumSpectrum::HydrogenLymanContinuumSpectrum(
  * generate a random uniform number and locate it in the two cumulative
  * distributions that border the temperature value. The sampled frequency is
  * then given by linear interpolation on the temperature and frequency tables.
+ * All three lookups use guide tables, so that their cost does not depend on the
+ * size of the tables.
  *
  * @param random_generator RandomGenerator to use.
  * @param temperature Temperature of the cell that reemits the photon (in K).
@@ -136,15 +148,13 @@ HydrogenLymanContinuumSpectrum::HydrogenLymanContinuumSpectrum(
 double HydrogenLymanContinuumSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
-  const uint_fast32_t iT = Utilities::locate(
-      temperature, _temperature.data(), HYDROGENLYMANCONTINUUMSPECTRUM_NUMTEMP);
+  const uint_fast32_t iT =
+      _temperature_guide.locate(temperature, _temperature.data());
   const double x = random_generator.get_uniform_random_double();
-  const uint_fast32_t inu1 =
-      Utilities::locate(x, _cumulative_distribution[iT].data(),
-                        HYDROGENLYMANCONTINUUMSPECTRUM_NUMFREQ);
-  const uint_fast32_t inu2 =
-      Utilities::locate(x, _cumulative_distribution[iT + 1].data(),
-                        HYDROGENLYMANCONTINUUMSPECTRUM_NUMFREQ);
+  const uint_fast32_t inu1 = _cumulative_distribution_guide[iT].locate(
+      x, _cumulative_distribution[iT].data());
+  const uint_fast32_t inu2 = _cumulative_distribution_guide[iT + 1].locate(
+      x, _cumulative_distribution[iT + 1].data());
   const double frequency =
       _frequency[inu1] + (temperature - _temperature[iT]) *
                              (_frequency[inu2] - _frequency[inu1]) /
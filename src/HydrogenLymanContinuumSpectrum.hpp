@@ -27,6 +27,7 @@
 #ifndef HYDROGENLYMANCONTINUUMSPECTRUM_HPP
 #define HYDROGENLYMANCONTINUUMSPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 #include "RandomGenerator.hpp"
 
@@ -61,6 +62,13 @@ private:
   /*! @brief Cumulative distribution function. */
   std::vector< std::vector< double > > _cumulative_distribution;
 
+  /*! @brief Guide table used to locate temperatures. */
+  GuideTable _temperature_guide;
+
+  /*! @brief Guide tables used to sample the cumulative distribution functions
+   *  (one for every temperature). */
+  std::vector< GuideTable > _cumulative_distribution_guide;
+
 public:
   HydrogenLymanContinuumSpectrum(const CrossSections &cross_sections);
 
@@ -31,6 +31,12 @@
 #include "PhotonSource.hpp"
 #include "RandomGenerator.hpp"
 
+/*! @brief Number of uniform random numbers that is drawn in bulk at the start
+ *  of every photon packet if a counter-based random generator is used. Most
+ *  photon packets only need one or two optical depths, and larger blocks waste
+ *  random numbers (see timing/timePhotonPacketRandomDraws.cpp). */
+#define IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE 2
+
 /**
  * @brief Job implementation that shoots ionizing photons through a DensityGrid.
  */
@@ -54,6 +60,42 @@ private:
   /*! @brief Number of photons to propagate through the DensityGrid. */
   uint_fast64_t _numphoton;
 
+  /*! @brief Iteration number used to select random number streams. */
+  uint_fast32_t _iteration;
+
+  /*! @brief Index of the first photon packet for the next execution of the
+   *  job (used to select random number streams). */
+  uint_fast64_t _first_photon_index;
+
+  /*! @brief Uniform random numbers drawn in bulk for the current photon
+   *  packet. */
+  double _random_block[IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE];
+
+  /*! @brief Index of the next unused element of _random_block. */
+  uint_fast32_t _random_block_index;
+
+  /**
+   * @brief Get a random optical depth for the current photon packet.
+   *
+   * For counter-based random generators, the uniform random numbers are taken
+   * from a block that is drawn in bulk from the stream of the photon packet,
+   * and that is refilled from the same stream when it runs out. For the
+   * sequential generator, we simply draw a single random number.
+   *
+   * @return Random optical depth.
+   */
+  inline double get_random_optical_depth() {
+    if (!_random_generator.is_counter_based()) {
+      return -std::log(_random_generator.get_uniform_random_double());
+    }
+    if (_random_block_index == IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE) {
+      _random_generator.get_uniform_random_doubles(
+          _random_block, IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE);
+      _random_block_index = 0;
+    }
+    return -std::log(_random_block[_random_block_index++]);
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -62,20 +104,35 @@ public:
    * @param random_seed Seed for the RandomGenerator used by this specific
    * thread.
    * @param density_grid DensityGrid through which photons are propagated.
+   * @param random_generator_type Type of random number generator to use.
    */
-  inline IonizationPhotonShootJob(const PhotonSource &photon_source,
-                                  int_fast32_t random_seed,
-                                  DensityGrid &density_grid)
-      : _photon_source(photon_source), _random_generator(random_seed),
+  inline IonizationPhotonShootJob(
+      const PhotonSource &photon_source, int_fast32_t random_seed,
+      DensityGrid &density_grid,
+      const RandomGeneratorType random_generator_type =
+          RANDOMGENERATORTYPE_RANLUX)
+      : _photon_source(photon_source),
+        _random_generator(random_seed, random_generator_type),
         _density_grid(density_grid), _totweight(0.), _typecount{0.},
-        _numphoton(0) {}
+        _numphoton(0), _iteration(0), _first_photon_index(0),
+        _random_block_index(IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE) {}
 
   /**
    * @brief Set the number of photons for the next execution of the job.
    *
    * @param numphoton New number of photons.
+   * @param iteration Iteration number (only used for counter-based random
+   * generators).
+   * @param first_photon_index Index of the first photon packet (only used for
+   * counter-based random generators).
    */
-  inline void set_numphoton(uint_fast64_t numphoton) { _numphoton = numphoton; }
+  inline void set_numphoton(uint_fast64_t numphoton,
+                            const uint_fast32_t iteration = 0,
+                            const uint_fast64_t first_photon_index = 0) {
+    _numphoton = numphoton;
+    _iteration = iteration;
+    _first_photon_index = first_photon_index;
+  }
 
   /**
    * @brief Update the given weight counters and reset the internal counters.
@@ -113,9 +170,21 @@ public:
    * is still inside the simulation box, we randomly decide whether we need to
    * reemit it or not. If so, we again draw a random optical depth and repeat
    * the whole procedure until the photon is absorbed or leaves the system.
+   *
+   * If a counter-based random generator is used, every photon packet uses its
+   * own random number stream, selected by the iteration number and the index
+   * of the photon packet, so that the result does not depend on which thread
+   * propagates which photon packet. The random numbers for the first few
+   * optical depths are then drawn in bulk.
    */
   inline void execute() {
     for (uint_fast64_t i = 0; i < _numphoton; ++i) {
+      if (_random_generator.is_counter_based()) {
+        _random_generator.set_stream(_iteration, _first_photon_index + i);
+        _random_generator.get_uniform_random_doubles(
+            _random_block, IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE);
+        _random_block_index = 0;
+      }
       Photon photon = _photon_source.get_random_photon(_random_generator);
       // if a fraction of light alpha is absorbed when the light traverses a
       // small path with length dl in the material, then the spatial change of
@@ -132,12 +201,12 @@ public:
       // distribution:
       //  tau = -ln(ksi)
       // See Steinacker, Baes & Gordon (2013), equation (25)
-      double tau = -std::log(_random_generator.get_uniform_random_double());
+      double tau = get_random_optical_depth();
       DensityGrid::iterator it = _density_grid.interact(photon, tau);
       while (it != _density_grid.end() &&
              _photon_source.reemit(photon, it.get_ionization_variables(),
                                    _random_generator)) {
-        tau = -std::log(_random_generator.get_uniform_random_double());
+        tau = get_random_optical_depth();
         it = _density_grid.interact(photon, tau);
       }
       _totweight += photon.get_weight();
@@ -54,6 +54,14 @@ private:
    *  IonizationPhotonShootJob. */
   const uint_fast64_t _jobsize;
 
+  /*! @brief Number of times the number of photons was set (used to select
+   *  random number streams). */
+  uint_fast32_t _iteration;
+
+  /*! @brief Index of the first photon packet of the next job (used to select
+   *  random number streams). */
+  uint_fast64_t _next_photon_index;
+
   /*! @brief Lock used to ensure safe access to the internal photon number
    *  counters. */
   Lock _lock;
@@ -69,20 +77,28 @@ public:
    * @param jobsize Number of photons to shoot during a single
    * IonizationPhotonShootJob.
    * @param worksize Number of threads used in the calculation.
+   * @param random_generator_type Type of random number generator to use.
    */
-  inline IonizationPhotonShootJobMarket(PhotonSource &photon_source,
-                                        int_fast32_t random_seed,
-                                        DensityGrid &density_grid,
-                                        uint_fast64_t numphoton,
-                                        uint_fast64_t jobsize,
-                                        int_fast32_t worksize)
-      : _worksize(worksize), _numphoton(numphoton), _jobsize(jobsize) {
+  inline IonizationPhotonShootJobMarket(
+      PhotonSource &photon_source, int_fast32_t random_seed,
+      DensityGrid &density_grid, uint_fast64_t numphoton, uint_fast64_t jobsize,
+      int_fast32_t worksize,
+      const RandomGeneratorType random_generator_type =
+          RANDOMGENERATORTYPE_RANLUX)
+      : _worksize(worksize), _numphoton(numphoton), _jobsize(jobsize),
+        _iteration(0), _next_photon_index(0) {
 
     // create a separate RandomGenerator for each thread.
     // create a single PhotonShootJob for each thread.
     for (int_fast32_t i = 0; i < _worksize; ++i) {
-      _jobs[i] = new IonizationPhotonShootJob(photon_source, random_seed + i,
-                                              density_grid);
+      // counter-based generators select independent streams per photon
+      // packet, so all threads need to use the same seed
+      const int_fast32_t thread_seed =
+          (random_generator_type == RANDOMGENERATORTYPE_RANLUX)
+              ? random_seed + i
+              : random_seed;
+      _jobs[i] = new IonizationPhotonShootJob(
+          photon_source, thread_seed, density_grid, random_generator_type);
     }
   }
 
@@ -111,9 +127,20 @@ public:
    * This routine can be used to reset an IonizationPhotonShootJobMarket that
    * was used before.
    *
+   * Every call selects a new set of random number streams for counter-based
+   * random generators.
+   *
    * @param numphoton New number of photons.
+   * @param first_photon_index Index of the first photon packet that is
+   * propagated by this process (for counter-based random generators, this
+   * selects the random number stream of the photon packets).
    */
-  inline void set_numphoton(uint_fast64_t numphoton) { _numphoton = numphoton; }
+  inline void set_numphoton(uint_fast64_t numphoton,
+                            const uint_fast64_t first_photon_index = 0) {
+    _numphoton = numphoton;
+    _next_photon_index = first_photon_index;
+    ++_iteration;
+  }
 
   /**
    * @brief Update the given weight counters.
@@ -142,9 +169,11 @@ public:
       jobsize = _numphoton;
     }
     _numphoton -= jobsize;
+    const uint_fast64_t first_photon_index = _next_photon_index;
+    _next_photon_index += jobsize;
     _lock.unlock();
     if (jobsize > 0) {
-      _jobs[thread_id]->set_numphoton(jobsize);
+      _jobs[thread_id]->set_numphoton(jobsize, _iteration, first_photon_index);
       return _jobs[thread_id];
     } else {
       return nullptr;
@@ -34,6 +34,7 @@
 #include "DensityGridWriterFactory.hpp"
 #include "DensityMaskFactory.hpp"
 #include "IonizationVariablesPropertyAccessors.hpp"
+#include "IterationConvergenceController.hpp"
 #include "LineCoolingData.hpp"
 #include "MPICommunicator.hpp"
 #include "ParameterFile.hpp"
@@ -84,8 +85,16 @@
  *  - output folder: Folder where all output files will be placed (default: .)
  *  - random seed: Seed used to initialize the random number generator (default:
  *    42)
+ *  - random generator: Type of random number generator to use (RANLUX/Philox,
+ *    default: RANLUX). The counter-based Philox generator uses an independent
+ *    random number stream for every photon packet, so that results do not
+ *    depend on the number of threads or processes.
  *  - enable trackers: Track photon packets travelling through specific
  *    positions? (default: no)
+ *  - adaptive iterations: Stop iterating once the neutral fractions and
+ *    temperatures have converged, and adapt the number of photon packets to
+ *    the Monte Carlo noise (see IterationConvergenceController; the number of
+ *    iterations is then the maximum number of iterations, default: no)
  *
  * @param write_output Should this process write output?
  * @param every_iteration_output Write an output file after every iteration of
@@ -198,12 +207,19 @@ IonizationSimulation::IonizationSimulation(const bool write_output,
   // create ray tracing objects
   int_fast32_t random_seed = _parameter_file.get_value< int_fast32_t >(
       "IonizationSimulation:random seed", 42);
-  // make sure every thread on every process has another random seed
-  if (_mpi_communicator) {
+  const RandomGeneratorType random_generator_type = RandomGenerator::get_type(
+      _parameter_file.get_value< std::string >(
+          "IonizationSimulation:random generator", "RANLUX"));
+  // make sure every thread on every process has another random seed (not
+  // necessary for counter-based generators, since these use a different
+  // stream for every photon packet)
+  if (_mpi_communicator &&
+      random_generator_type == RANDOMGENERATORTYPE_RANLUX) {
     random_seed += _mpi_communicator->get_rank() * _num_thread;
   }
   _ionization_photon_shoot_job_market = new IonizationPhotonShootJobMarket(
-      *_photon_source, random_seed, *_density_grid, 0, 100, _num_thread);
+      *_photon_source, random_seed, *_density_grid, 0, 100, _num_thread,
+      random_generator_type);
 
   if (_parameter_file.get_value< bool >("IonizationSimulation:enable trackers",
                                         false)) {
@@ -212,6 +228,15 @@ IonizationSimulation::IonizationSimulation(const bool write_output,
     _trackers = nullptr;
   }
 
+  if (_parameter_file.get_value< bool >(
+          "IonizationSimulation:adaptive iterations", false)) {
+    _convergence_controller = new IterationConvergenceController(
+        "IonizationSimulation", _density_grid->get_number_of_cells(),
+        _number_of_photons, _parameter_file, _log);
+  } else {
+    _convergence_controller = nullptr;
+  }
+
   // we are done reading the parameter file
   // now output all parameters (also those for which default values were used)
   // to a reference parameter file (only rank 0 does this)
@@ -356,15 +381,18 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
   // finally: the actual program loop whereby the density grid is ray traced
   // using photon packets generated by the stellar sources
   uint_fast32_t loop = 0;
-  while (loop < _number_of_iterations) {
+  // both can be changed by the convergence controller
+  uint_fast32_t number_of_iterations = _number_of_iterations;
+  uint_fast64_t number_of_photons = _number_of_photons;
+  while (loop < number_of_iterations) {
 
     if (_log) {
       _log->write_status("Starting loop ", loop, ".");
     }
 
-    uint_fast64_t lnumphoton = _number_of_photons;
+    uint_fast64_t lnumphoton = number_of_photons;
 
-    if (_trackers != nullptr && loop == _number_of_iterations - 1) {
+    if (_trackers != nullptr && loop == number_of_iterations - 1) {
       _trackers->add_trackers(*_density_grid);
       lnumphoton = std::max(lnumphoton, _trackers->get_number_of_photons());
     }
@@ -390,13 +418,18 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
     double totweight = 0.;
 
     uint_fast64_t local_numphoton = lnumphoton;
+    uint_fast64_t first_photon_index = 0;
 
     // make sure this process does only part of the total number of photons
     if (_mpi_communicator) {
-      local_numphoton = _mpi_communicator->distribute(local_numphoton);
+      const std::pair< size_t, size_t > photon_block =
+          _mpi_communicator->distribute_block(0, lnumphoton);
+      first_photon_index = photon_block.first;
+      local_numphoton = photon_block.second - photon_block.first;
     }
 
-    _ionization_photon_shoot_job_market->set_numphoton(local_numphoton);
+    _ionization_photon_shoot_job_market->set_numphoton(local_numphoton,
+                                                       first_photon_index);
     _photon_propagation_timer.start();
     start_parallel_timing_block();
     _work_distributor.do_in_parallel(*_ionization_photon_shoot_job_market);
@@ -627,6 +660,25 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
       _log->write_status("Done calculating ionization state.");
     }
 
+    if (_convergence_controller != nullptr) {
+      // all processes have the full grid, so they all take the same decision
+      for (auto it = _density_grid->begin(); it != _density_grid->end();
+           ++it) {
+        const IonizationVariables &vars = it.get_ionization_variables();
+        _convergence_controller->add_cell(
+            it.get_index(), vars.get_number_density() * it.get_volume(),
+            vars.get_ionic_fraction(ION_H_n), vars.get_temperature());
+      }
+      number_of_photons =
+          _convergence_controller->end_iteration(loop, lnumphoton);
+      if (_convergence_controller->has_converged()) {
+        // trackers are only added during the last iteration, so we need one
+        // more iteration if we have them
+        number_of_iterations = std::min(
+            number_of_iterations, (_trackers != nullptr) ? loop + 2 : loop + 1);
+      }
+    }
+
     // calculate emissivities
     // we disabled this, since we now have the post-processing Python library
     // for this
@@ -637,7 +689,7 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
     ++loop;
 
     if (_density_grid_writer && _every_iteration_output &&
-        loop < _number_of_iterations) {
+        loop < number_of_iterations) {
       _density_grid_writer->write(*_density_grid, loop, _parameter_file);
     }
   }
@@ -654,13 +706,11 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
 
   // write final snapshot
   if (_density_grid_writer) {
-    _density_grid_writer->write(*_density_grid, _number_of_iterations,
-                                _parameter_file);
+    _density_grid_writer->write(*_density_grid, loop, _parameter_file);
   }
   if (density_grid_writer) {
     _time_log.start("Reverse mapping");
-    density_grid_writer->write(*_density_grid, _number_of_iterations,
-                               _parameter_file);
+    density_grid_writer->write(*_density_grid, loop, _parameter_file);
     _time_log.end("Reverse mapping");
   }
 
@@ -731,6 +781,7 @@ IonizationSimulation::~IonizationSimulation() {
   delete _recombination_rates;
 
   delete _trackers;
+  delete _convergence_controller;
 
   delete _abundance_model;
 }
@@ -43,6 +43,7 @@ class DensityFunction;
 class DensityGrid;
 class DensityGridWriter;
 class DensityMask;
+class IterationConvergenceController;
 class Log;
 class MPICommunicator;
 class PhotonSource;
@@ -167,6 +168,10 @@ private:
   /*! @brief Optional spectrum tracker manager. */
   TrackerManager *_trackers;
 
+  /*! @brief Optional convergence based control of the number of iterations
+   *  and the number of photon packets. */
+  IterationConvergenceController *_convergence_controller;
+
   /// non pointer objects owned by the simulation
 
   /*! @brief Abundances. */
@@ -204,6 +209,20 @@ public:
   void initialize(DensityFunction *density_function = nullptr);
   void run(DensityGridWriter *density_grid_writer = nullptr);
 
+  /**
+   * @brief Get the parameters used by the simulation.
+   *
+   * @return Reference to the ParameterFile of the simulation.
+   */
+  inline ParameterFile &get_parameter_file() { return _parameter_file; }
+
+  /**
+   * @brief Get the grid used by the simulation.
+   *
+   * @return Reference to the DensityGrid of the simulation.
+   */
+  inline DensityGrid &get_density_grid() { return *_density_grid; }
+
   ~IonizationSimulation();
 };
 
@@ -62,6 +62,8 @@ IonizationStateCalculator::IonizationStateCalculator(
 /**
  * @brief Does the ionization state calculation for a single cell.
  *
+ * This is a batch of one cell for calculate_ionization_state_batch().
+ *
  * @param jfac Normalization factor for the mean intensity integrals in this
  * cell.
  * @param hfac Normalization factor for the heating integrals in this cell.
@@ -71,204 +73,252 @@ void IonizationStateCalculator::calculate_ionization_state(
     const double jfac, const double hfac,
     IonizationVariables &ionization_variables) const {
 
-  // normalize the mean intensity integrals
-  const double jH = jfac * ionization_variables.get_mean_intensity(ION_H_n);
-  cmac_assert_message(jH >= 0., "jH: %g, jfac: %g, mean_intensity: %g", jH,
-                      jfac, ionization_variables.get_mean_intensity(ION_H_n));
-
-#ifdef HAS_HELIUM
-  const double jHe = jfac * ionization_variables.get_mean_intensity(ION_He_n);
-  cmac_assert(jHe >= 0.);
-#endif
-
-  // normalize the heating integrals (for explicit heating in RHD)
-  const double hH = hfac * ionization_variables.get_heating(HEATINGTERM_H);
-  ionization_variables.set_heating(HEATINGTERM_H, hH);
-#ifdef HAS_HELIUM
-  const double hHe = hfac * ionization_variables.get_heating(HEATINGTERM_He);
-  ionization_variables.set_heating(HEATINGTERM_He, hHe);
-#endif
-
-  // get the number density
-  const double ntot = ionization_variables.get_number_density();
-  cmac_assert(ntot >= 0.);
-
-  // find the ionization equilibrium for hydrogen and helium
-  if (jH > 0. && ntot > 0.) {
-    const double T = ionization_variables.get_temperature();
-    const double alphaH =
-        _recombination_rates.get_recombination_rate(ION_H_n, T);
-
-    cmac_assert(alphaH >= 0.);
-
-#ifdef HAS_HELIUM
-#ifdef VARIABLE_ABUNDANCES
-    const double AHe =
-        ionization_variables.get_abundances().get_abundance(ELEMENT_He);
-#else
-    const double AHe = _abundances.get_abundance(ELEMENT_He);
-#endif
-    // h0find
-    double h0, he0 = 0.;
-    if (AHe != 0.) {
-      const double alphaHe =
-          _recombination_rates.get_recombination_rate(ION_He_n, T);
-      compute_ionization_states_hydrogen_helium(alphaH, alphaHe, jH, jHe, ntot,
-                                                AHe, T, h0, he0);
-    } else {
-      h0 = compute_ionization_state_hydrogen(alphaH, jH, ntot);
-    }
-#else
-    const double h0 = compute_ionization_state_hydrogen(alphaH, jH, ntot);
-#endif
+  IonizationVariables *ionization_variables_pointer = &ionization_variables;
+  calculate_ionization_state_batch(1, &jfac, &hfac,
+                                   &ionization_variables_pointer);
+}
 
-    ionization_variables.set_ionic_fraction(ION_H_n, h0);
+/**
+ * @brief Set the ionic fractions for a cell that does not receive any ionizing
+ * radiation.
+ *
+ * All ions that require ionizing radiation get an ionic fraction of 0, while
+ * the neutral ions of hydrogen, helium, nitrogen, oxygen and neon get the
+ * given neutral fraction (1 for a neutral cell, 0 for a vacuum cell).
+ *
+ * @param neutral_fraction Ionic fraction of the neutral ions.
+ * @param ionization_variables Ionization variables for the cell we operate on.
+ */
+void IonizationStateCalculator::set_neutral_ionic_fractions(
+    const double neutral_fraction, IonizationVariables &ionization_variables) {
 
-#ifdef HAS_HELIUM
-    ionization_variables.set_ionic_fraction(ION_He_n, he0);
-#endif
+  ionization_variables.set_ionic_fraction(ION_H_n, neutral_fraction);
 
-    // do the coolants
-    const double nhp = ntot * (1. - h0);
 #ifdef HAS_HELIUM
-    const double ne = ntot * (1. - h0 + AHe * (1. - he0));
-#else
-    const double ne = nhp;
+  ionization_variables.set_ionic_fraction(ION_He_n, neutral_fraction);
 #endif
-    const double T4 = T * 1.e-4;
 
-    const double j_metals[12] = {
+  // all coolants are also neutral, so their ionic fractions are 0
 #ifdef HAS_CARBON
-        ionization_variables.get_mean_intensity(ION_C_p1),
-        ionization_variables.get_mean_intensity(ION_C_p2),
-#else
-        0., 0.,
+  ionization_variables.set_ionic_fraction(ION_C_p1, 0.);
+  ionization_variables.set_ionic_fraction(ION_C_p2, 0.);
 #endif
+
 #ifdef HAS_NITROGEN
-        ionization_variables.get_mean_intensity(ION_N_n),
-        ionization_variables.get_mean_intensity(ION_N_p1),
-        ionization_variables.get_mean_intensity(ION_N_p2),
-#else
-        0., 0.,
-        0.,
+  ionization_variables.set_ionic_fraction(ION_N_n, neutral_fraction);
+  ionization_variables.set_ionic_fraction(ION_N_p1, 0.);
+  ionization_variables.set_ionic_fraction(ION_N_p2, 0.);
 #endif
+
 #ifdef HAS_OXYGEN
-        ionization_variables.get_mean_intensity(ION_O_n),
-        ionization_variables.get_mean_intensity(ION_O_p1),
-#else
-        0., 0.,
+  ionization_variables.set_ionic_fraction(ION_O_n, neutral_fraction);
+  ionization_variables.set_ionic_fraction(ION_O_p1, 0.);
 #endif
+
 #ifdef HAS_NEON
-        ionization_variables.get_mean_intensity(ION_Ne_n),
-        ionization_variables.get_mean_intensity(ION_Ne_p1),
-#else
-        0., 0.,
+  ionization_variables.set_ionic_fraction(ION_Ne_n, neutral_fraction);
+  ionization_variables.set_ionic_fraction(ION_Ne_p1, 0.);
 #endif
+
 #ifdef HAS_SULPHUR
-        ionization_variables.get_mean_intensity(ION_S_p1),
-        ionization_variables.get_mean_intensity(ION_S_p2),
-        ionization_variables.get_mean_intensity(ION_S_p3)
-#else
-        0., 0.,
-        0.
+  ionization_variables.set_ionic_fraction(ION_S_p1, 0.);
+  ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
+  ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
 #endif
-    };
+}
 
-    const double nh0 = ntot * h0;
-#ifdef HAS_HELIUM
-    const double nhe0 = ntot * he0 * AHe;
-#else
-    const double nhe0 = 0.;
-#endif
-    compute_ionization_states_metals(
-        j_metals, ne, T, T4, nh0, nhe0, nhp, _recombination_rates,
-        _charge_transfer_rates, ionization_variables);
+/**
+ * @brief Does the ionization state calculation for a batch of cells.
+ *
+ * This function gives the same result as calling calculate_ionization_state()
+ * for every cell separately, but solves the hydrogen and helium ionization
+ * balance and the metal ionization balance for all cells in the batch
+ * together, so that the arithmetic can be vectorised.
+ *
+ * @param number_of_cells Number of cells in the batch (at most
+ * IONIZATIONSTATECALCULATOR_BATCH_SIZE).
+ * @param jfac Normalization factors for the mean intensity integrals in each
+ * cell.
+ * @param hfac Normalization factors for the heating integrals in each cell.
+ * @param ionization_variables Ionization variables for the cells we operate
+ * on.
+ */
+void IonizationStateCalculator::calculate_ionization_state_batch(
+    const uint_fast32_t number_of_cells, const double *jfac,
+    const double *hfac, IonizationVariables **ionization_variables) const {
 
-  } else {
-    // either we have a vacuum cell, or the mean intensity integral for hydrogen
-    // was zero
-    if (ntot > 0.) {
-      // mean intensity for hydrogen was zero: cell is entirely neutral
-      ionization_variables.set_ionic_fraction(ION_H_n, 1.);
+  cmac_assert(number_of_cells <= IONIZATIONSTATECALCULATOR_BATCH_SIZE);
 
+  // gather the input values for all cells and sort out the cells that are
+  // neutral or empty
+  uint_fast32_t number_of_active_cells = 0;
+  uint_fast32_t active_index[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double jH[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double ntot[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double T[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double alphaH[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double h0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
 #ifdef HAS_HELIUM
-      ionization_variables.set_ionic_fraction(ION_He_n, 1.);
+  double jHe[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double AHe[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double alphaHe[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double he0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
 #endif
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    IonizationVariables &vars = *ionization_variables[i];
 
-      // all coolants are also neutral, so their ionic fractions are 0
-#ifdef HAS_CARBON
-      ionization_variables.set_ionic_fraction(ION_C_p1, 0.);
-      ionization_variables.set_ionic_fraction(ION_C_p2, 0.);
+    // normalize the mean intensity integrals
+    const double this_jH = jfac[i] * vars.get_mean_intensity(ION_H_n);
+    cmac_assert_message(this_jH >= 0., "jH: %g, jfac: %g, mean_intensity: %g",
+                        this_jH, jfac[i], vars.get_mean_intensity(ION_H_n));
+#ifdef HAS_HELIUM
+    const double this_jHe = jfac[i] * vars.get_mean_intensity(ION_He_n);
+    cmac_assert(this_jHe >= 0.);
 #endif
 
-#ifdef HAS_NITROGEN
-      ionization_variables.set_ionic_fraction(ION_N_n, 1.);
-      ionization_variables.set_ionic_fraction(ION_N_p1, 0.);
-      ionization_variables.set_ionic_fraction(ION_N_p2, 0.);
+    // normalize the heating integrals (for explicit heating in RHD)
+    vars.set_heating(HEATINGTERM_H, hfac[i] * vars.get_heating(HEATINGTERM_H));
+#ifdef HAS_HELIUM
+    vars.set_heating(HEATINGTERM_He,
+                     hfac[i] * vars.get_heating(HEATINGTERM_He));
 #endif
 
-#ifdef HAS_OXYGEN
-      ionization_variables.set_ionic_fraction(ION_O_n, 1.);
-      ionization_variables.set_ionic_fraction(ION_O_p1, 0.);
-#endif
+    // get the number density
+    const double this_ntot = vars.get_number_density();
+    cmac_assert(this_ntot >= 0.);
 
-#ifdef HAS_NEON
-      ionization_variables.set_ionic_fraction(ION_Ne_n, 1.);
-      ionization_variables.set_ionic_fraction(ION_Ne_p1, 0.);
+    if (this_jH > 0. && this_ntot > 0.) {
+      const uint_fast32_t j = number_of_active_cells;
+      active_index[j] = i;
+      jH[j] = this_jH;
+      ntot[j] = this_ntot;
+      T[j] = vars.get_temperature();
+      alphaH[j] = _recombination_rates.get_recombination_rate(ION_H_n, T[j]);
+      cmac_assert(alphaH[j] >= 0.);
+#ifdef HAS_HELIUM
+      jHe[j] = this_jHe;
+#ifdef VARIABLE_ABUNDANCES
+      AHe[j] = vars.get_abundances().get_abundance(ELEMENT_He);
+#else
+      AHe[j] = _abundances.get_abundance(ELEMENT_He);
 #endif
-
-#ifdef HAS_SULPHUR
-      ionization_variables.set_ionic_fraction(ION_S_p1, 0.);
-      ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
-      ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
+      alphaHe[j] = (AHe[j] != 0.) ? _recombination_rates.get_recombination_rate(
+                                        ION_He_n, T[j])
+                                  : 0.;
 #endif
-
+      ++number_of_active_cells;
+    } else if (this_ntot > 0.) {
+      // either we have a vacuum cell, or the mean intensity integral for
+      // hydrogen was zero
+      // mean intensity for hydrogen was zero: cell is entirely neutral
+      set_neutral_ionic_fractions(1., vars);
     } else {
       // vacuum cell: set all values to 0
-      ionization_variables.set_ionic_fraction(ION_H_n, 0.);
+      set_neutral_ionic_fractions(0., vars);
+    }
 
+#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
+    // set the mean intensity values to the values in correct physical units
+    vars.set_mean_intensity(ION_H_n, this_jH);
 #ifdef HAS_HELIUM
-      ionization_variables.set_ionic_fraction(ION_He_n, 0.);
+    vars.set_mean_intensity(ION_He_n, this_jHe);
 #endif
-
-#ifdef HAS_CARBON
-      ionization_variables.set_ionic_fraction(ION_C_p1, 0.);
-      ionization_variables.set_ionic_fraction(ION_C_p2, 0.);
 #endif
+  }
 
-#ifdef HAS_NITROGEN
-      ionization_variables.set_ionic_fraction(ION_N_n, 0.);
-      ionization_variables.set_ionic_fraction(ION_N_p1, 0.);
-      ionization_variables.set_ionic_fraction(ION_N_p2, 0.);
-#endif
+  if (number_of_active_cells == 0) {
+    return;
+  }
 
-#ifdef HAS_OXYGEN
-      ionization_variables.set_ionic_fraction(ION_O_n, 0.);
-      ionization_variables.set_ionic_fraction(ION_O_p1, 0.);
+  // find the ionization equilibrium for hydrogen and helium
+#ifdef HAS_HELIUM
+  // cells without helium use the closed expression for hydrogen, all other
+  // cells are solved together
+  uint_fast32_t number_of_helium_cells = 0;
+  uint_fast32_t helium_index[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t j = 0; j < number_of_active_cells; ++j) {
+    if (AHe[j] != 0.) {
+      helium_index[number_of_helium_cells] = j;
+      ++number_of_helium_cells;
+    } else {
+      h0[j] = compute_ionization_state_hydrogen(alphaH[j], jH[j], ntot[j]);
+      he0[j] = 0.;
+    }
+  }
+  if (number_of_helium_cells == number_of_active_cells) {
+    compute_ionization_states_hydrogen_helium_batch(
+        number_of_active_cells, alphaH, alphaHe, jH, jHe, ntot, AHe, T, h0,
+        he0);
+  } else if (number_of_helium_cells > 0) {
+    double packed[9][IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    for (uint_fast32_t k = 0; k < number_of_helium_cells; ++k) {
+      const uint_fast32_t j = helium_index[k];
+      packed[0][k] = alphaH[j];
+      packed[1][k] = alphaHe[j];
+      packed[2][k] = jH[j];
+      packed[3][k] = jHe[j];
+      packed[4][k] = ntot[j];
+      packed[5][k] = AHe[j];
+      packed[6][k] = T[j];
+    }
+    compute_ionization_states_hydrogen_helium_batch(
+        number_of_helium_cells, packed[0], packed[1], packed[2], packed[3],
+        packed[4], packed[5], packed[6], packed[7], packed[8]);
+    for (uint_fast32_t k = 0; k < number_of_helium_cells; ++k) {
+      const uint_fast32_t j = helium_index[k];
+      h0[j] = packed[7][k];
+      he0[j] = packed[8][k];
+    }
+  }
+#else
+  for (uint_fast32_t j = 0; j < number_of_active_cells; ++j) {
+    h0[j] = compute_ionization_state_hydrogen(alphaH[j], jH[j], ntot[j]);
+  }
 #endif
 
-#ifdef HAS_NEON
-      ionization_variables.set_ionic_fraction(ION_Ne_n, 0.);
-      ionization_variables.set_ionic_fraction(ION_Ne_p1, 0.);
+  // compute the densities needed for the coolants
+  double ne[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nh0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nhe0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nhp[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t j = 0; j < number_of_active_cells; ++j) {
+    nhp[j] = ntot[j] * (1. - h0[j]);
+    nh0[j] = ntot[j] * h0[j];
+#ifdef HAS_HELIUM
+    ne[j] = ntot[j] * (1. - h0[j] + AHe[j] * (1. - he0[j]));
+    nhe0[j] = ntot[j] * he0[j] * AHe[j];
+#else
+    ne[j] = nhp[j];
+    nhe0[j] = 0.;
 #endif
+  }
 
-#ifdef HAS_SULPHUR
-      ionization_variables.set_ionic_fraction(ION_S_p1, 0.);
-      ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
-      ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
+  // store the hydrogen and helium neutral fractions and gather the metal mean
+  // intensity integrals
+  IonizationVariables *active_variables[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double j_metals[IONIZATIONSTATECALCULATOR_BATCH_SIZE]
+                 [IONIZATIONSTATECALCULATOR_NUMBER_OF_METAL_IONS];
+  for (uint_fast32_t j = 0; j < number_of_active_cells; ++j) {
+    IonizationVariables &vars = *ionization_variables[active_index[j]];
+    active_variables[j] = &vars;
+    vars.set_ionic_fraction(ION_H_n, h0[j]);
+#ifdef HAS_HELIUM
+    vars.set_ionic_fraction(ION_He_n, he0[j]);
 #endif
+    double mean_intensity[NUMBER_OF_IONNAMES];
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      mean_intensity[ion] = vars.get_mean_intensity(ion);
     }
+    get_metal_mean_intensities(mean_intensity, j_metals[j]);
   }
 
-  cmac_assert(ionization_variables.get_ionic_fraction(ION_H_n) >= 0.);
+  compute_ionization_states_metals_batch(
+      number_of_active_cells, j_metals, ne, T, nh0, nhe0, nhp,
+      _recombination_rates, _charge_transfer_rates, active_variables);
 
-#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
-  // set the mean intensity values to the values in correct physical units
-  ionization_variables.set_mean_intensity(ION_H_n, jH);
-#ifdef HAS_HELIUM
-  ionization_variables.set_mean_intensity(ION_He_n, jHe);
-#endif
-#endif
+  for (uint_fast32_t j = 0; j < number_of_active_cells; ++j) {
+    cmac_assert(active_variables[j]->get_ionic_fraction(ION_H_n) >= 0.);
+  }
 }
 
 /**
@@ -309,10 +359,12 @@ void IonizationStateCalculator::calculate_ionization_state(
  *                      &=& \frac{C(X^+)}{1 + C(X^+) + C(X^+)C(X^{2+}) + ...}.
  * \f}
  *
- * @param j_metals Ionizing luminosity integrals for the metal ions (in s^-1).
+ * This is a batch of one cell for compute_ionization_states_metals_batch().
+ *
+ * @param j_metals Ionizing luminosity integrals for the metal ions (in s^-1),
+ * in the order set by get_metal_mean_intensities().
  * @param ne Number density of electrons (in m^-3).
  * @param T Temperature (in K).
- * @param T4 Temperature (in 10^4 K).
  * @param nh0 Number density of neutral hydrogen (in m^-3).
  * @param nhe0 Number density of neutral helium (in m^-3).
  * @param nhp Number density of ionized hydrogen (in m^-3).
@@ -321,182 +373,259 @@ void IonizationStateCalculator::calculate_ionization_state(
  * @param ionization_variables IonizationStateVariables to operate on.
  */
 void IonizationStateCalculator::compute_ionization_states_metals(
-    const double *j_metals, const double ne, const double T, const double T4,
-    const double nh0, const double nhe0, const double nhp,
+    const double *j_metals, const double ne, const double T, const double nh0,
+    const double nhe0, const double nhp,
     const RecombinationRates &recombination_rates,
     const ChargeTransferRates &charge_transfer_rates,
     IonizationVariables &ionization_variables) {
 
+  double j_metals_batch[1][IONIZATIONSTATECALCULATOR_NUMBER_OF_METAL_IONS];
+  for (int_fast32_t i = 0; i < IONIZATIONSTATECALCULATOR_NUMBER_OF_METAL_IONS;
+       ++i) {
+    j_metals_batch[0][i] = j_metals[i];
+  }
+  IonizationVariables *ionization_variables_pointer = &ionization_variables;
+  compute_ionization_states_metals_batch(
+      1, j_metals_batch, &ne, &T, &nh0, &nhe0, &nhp, recombination_rates,
+      charge_transfer_rates, &ionization_variables_pointer);
+}
+
+/**
+ * @brief Compute the ionization balance for the metals for a batch of cells.
+ *
+ * This is the batched version of compute_ionization_states_metals(), which
+ * explains the method: we first gather the recombination and charge transfer
+ * rates for all cells, and then compute the ionic fractions for all cells in
+ * branch-free loops that can be vectorised.
+ *
+ * @param number_of_cells Number of cells in the batch (at most
+ * IONIZATIONSTATECALCULATOR_BATCH_SIZE).
+ * @param j_metals Ionizing luminosity integrals for the metal ions in each
+ * cell (in s^-1), in the order set by get_metal_mean_intensities().
+ * @param ne Number density of electrons in each cell (in m^-3).
+ * @param T Temperature in each cell (in K).
+ * @param nh0 Number density of neutral hydrogen in each cell (in m^-3).
+ * @param nhe0 Number density of neutral helium in each cell (in m^-3).
+ * @param nhp Number density of ionized hydrogen in each cell (in m^-3).
+ * @param recombination_rates RecombinationRates.
+ * @param charge_transfer_rates ChargeTransferRates.
+ * @param ionization_variables IonizationStateVariables to operate on.
+ */
+void IonizationStateCalculator::compute_ionization_states_metals_batch(
+    const uint_fast32_t number_of_cells,
+    const double (*j_metals)[IONIZATIONSTATECALCULATOR_NUMBER_OF_METAL_IONS],
+    const double *ne, const double *T, const double *nh0, const double *nhe0,
+    const double *nhp, const RecombinationRates &recombination_rates,
+    const ChargeTransferRates &charge_transfer_rates,
+    IonizationVariables **ionization_variables) {
+
+  cmac_assert(number_of_cells <= IONIZATIONSTATECALCULATOR_BATCH_SIZE);
+
+#ifndef HAVE_HYDROGEN_ONLY
+  // total recombination rate (radiative recombination and charge transfer
+  // recombination) and total ionization rate for every ion
+  double recombination[NUMBER_OF_IONNAMES]
+                      [IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double ionization[NUMBER_OF_IONNAMES][IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  // ionic fractions
+  double fraction[NUMBER_OF_IONNAMES][IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+
+  // gather the rates (these require function calls that cannot be vectorised)
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    const double T4 = T[i] * 1.e-4;
 #ifdef HAS_CARBON
-  const double jCp1 = j_metals[0];
-  const double jCp2 = j_metals[1];
+    // the charge transfer recombination rates for C+ are negligble
+    ionization[ION_C_p1][i] = j_metals[i][0];
+    recombination[ION_C_p1][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_C_p1, T[i]);
+    ionization[ION_C_p2][i] = j_metals[i][1];
+    recombination[ION_C_p2][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_C_p2, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_C_p2, T4) +
+        nhe0[i] *
+            charge_transfer_rates.get_charge_transfer_recombination_rate_He(
+                ION_C_p2, T4);
 #endif
 
 #ifdef HAS_NITROGEN
-  const double jNn = j_metals[2];
-  const double jNp1 = j_metals[3];
-  const double jNp2 = j_metals[4];
+    ionization[ION_N_n][i] =
+        j_metals[i][2] +
+        nhp[i] * charge_transfer_rates.get_charge_transfer_ionization_rate_H(
+                     ION_N_n, T4);
+    recombination[ION_N_n][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_N_n, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_N_n, T4);
+    ionization[ION_N_p1][i] = j_metals[i][3];
+    recombination[ION_N_p1][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_N_p1, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_N_p1, T4) +
+        nhe0[i] *
+            charge_transfer_rates.get_charge_transfer_recombination_rate_He(
+                ION_N_p1, T4);
+    ionization[ION_N_p2][i] = j_metals[i][4];
+    recombination[ION_N_p2][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_N_p2, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_N_p2, T4) +
+        nhe0[i] *
+            charge_transfer_rates.get_charge_transfer_recombination_rate_He(
+                ION_N_p2, T4);
 #endif
 
 #ifdef HAS_OXYGEN
-  const double jOn = j_metals[5];
-  const double jOp1 = j_metals[6];
+    ionization[ION_O_n][i] =
+        j_metals[i][5] +
+        nhp[i] * charge_transfer_rates.get_charge_transfer_ionization_rate_H(
+                     ION_O_n, T4);
+    recombination[ION_O_n][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_O_n, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_O_n, T4);
+    ionization[ION_O_p1][i] = j_metals[i][6];
+    recombination[ION_O_p1][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_O_p1, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_O_p1, T4) +
+        nhe0[i] *
+            charge_transfer_rates.get_charge_transfer_recombination_rate_He(
+                ION_O_p1, T4);
 #endif
 
 #ifdef HAS_NEON
-  const double jNen = j_metals[7];
-  const double jNep1 = j_metals[8];
+    ionization[ION_Ne_n][i] = j_metals[i][7];
+    recombination[ION_Ne_n][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_Ne_n, T[i]);
+    ionization[ION_Ne_p1][i] = j_metals[i][8];
+    recombination[ION_Ne_p1][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_Ne_p1, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_Ne_p1, T4) +
+        nhe0[i] *
+            charge_transfer_rates.get_charge_transfer_recombination_rate_He(
+                ION_Ne_p1, T4);
 #endif
 
 #ifdef HAS_SULPHUR
-  const double jSp1 = j_metals[9];
-  const double jSp2 = j_metals[10];
-  const double jSp3 = j_metals[11];
+    ionization[ION_S_p1][i] = j_metals[i][9];
+    recombination[ION_S_p1][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_S_p1, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_S_p1, T4);
+    ionization[ION_S_p2][i] = j_metals[i][10];
+    recombination[ION_S_p2][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_S_p2, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_S_p2, T4) +
+        nhe0[i] *
+            charge_transfer_rates.get_charge_transfer_recombination_rate_He(
+                ION_S_p2, T4);
+    ionization[ION_S_p3][i] = j_metals[i][11];
+    recombination[ION_S_p3][i] =
+        ne[i] * recombination_rates.get_recombination_rate(ION_S_p3, T[i]) +
+        nh0[i] * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
+                     ION_S_p3, T4) +
+        nhe0[i] *
+            charge_transfer_rates.get_charge_transfer_recombination_rate_He(
+                ION_S_p3, T4);
 #endif
+  }
 
+  // now compute the ionic fractions (see compute_ionization_states_metals())
 #ifdef HAS_CARBON
-  const double alphaC[2] = {
-      recombination_rates.get_recombination_rate(ION_C_p1, T),
-      recombination_rates.get_recombination_rate(ION_C_p2, T)};
+  // carbon
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    const double C21 = ionization[ION_C_p1][i] / recombination[ION_C_p1][i];
+    const double C32 = ionization[ION_C_p2][i] / recombination[ION_C_p2][i];
+    const double C31 = C32 * C21;
+    const double sumC_inv = 1. / (1. + C21 + C31);
+    fraction[ION_C_p1][i] = C21 * sumC_inv;
+    fraction[ION_C_p2][i] = C31 * sumC_inv;
+  }
 #endif
 
 #ifdef HAS_NITROGEN
-  const double alphaN[3] = {
-      recombination_rates.get_recombination_rate(ION_N_n, T),
-      recombination_rates.get_recombination_rate(ION_N_p1, T),
-      recombination_rates.get_recombination_rate(ION_N_p2, T)};
+  // nitrogen
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    const double N21 = ionization[ION_N_n][i] / recombination[ION_N_n][i];
+    const double N32 = ionization[ION_N_p1][i] / recombination[ION_N_p1][i];
+    const double N43 = ionization[ION_N_p2][i] / recombination[ION_N_p2][i];
+    const double N31 = N32 * N21;
+    const double N41 = N43 * N31;
+    const double sumN_inv = 1. / (1. + N21 + N31 + N41);
+    fraction[ION_N_n][i] = N21 * sumN_inv;
+    fraction[ION_N_p1][i] = N31 * sumN_inv;
+    fraction[ION_N_p2][i] = N41 * sumN_inv;
+  }
 #endif
 
 #ifdef HAS_OXYGEN
-  const double alphaO[2] = {
-      recombination_rates.get_recombination_rate(ION_O_n, T),
-      recombination_rates.get_recombination_rate(ION_O_p1, T)};
+  // oxygen
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    const double O21 = ionization[ION_O_n][i] / recombination[ION_O_n][i];
+    const double O32 = ionization[ION_O_p1][i] / recombination[ION_O_p1][i];
+    const double O31 = O32 * O21;
+    const double sumO_inv = 1. / (1. + O21 + O31);
+    fraction[ION_O_n][i] = O21 * sumO_inv;
+    fraction[ION_O_p1][i] = O31 * sumO_inv;
+  }
 #endif
 
 #ifdef HAS_NEON
-  const double alphaNe[2] = {
-      recombination_rates.get_recombination_rate(ION_Ne_n, T),
-      recombination_rates.get_recombination_rate(ION_Ne_p1, T)};
+  // neon
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    const double Ne21 = ionization[ION_Ne_n][i] / recombination[ION_Ne_n][i];
+    const double Ne32 = ionization[ION_Ne_p1][i] / recombination[ION_Ne_p1][i];
+    const double Ne31 = Ne32 * Ne21;
+    const double sumNe_inv = 1. / (1. + Ne21 + Ne31);
+    fraction[ION_Ne_n][i] = Ne21 * sumNe_inv;
+    fraction[ION_Ne_p1][i] = Ne31 * sumNe_inv;
+  }
 #endif
 
 #ifdef HAS_SULPHUR
-  const double alphaS[3] = {
-      recombination_rates.get_recombination_rate(ION_S_p1, T),
-      recombination_rates.get_recombination_rate(ION_S_p2, T),
-      recombination_rates.get_recombination_rate(ION_S_p3, T)};
+  // sulphur
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    const double S21 = ionization[ION_S_p1][i] / recombination[ION_S_p1][i];
+    const double S32 = ionization[ION_S_p2][i] / recombination[ION_S_p2][i];
+    const double S43 = ionization[ION_S_p3][i] / recombination[ION_S_p3][i];
+    const double S31 = S32 * S21;
+    const double S41 = S43 * S31;
+    const double sumS_inv = 1. / (1. + S21 + S31 + S41);
+    fraction[ION_S_p1][i] = S21 * sumS_inv;
+    fraction[ION_S_p2][i] = S31 * sumS_inv;
+    fraction[ION_S_p3][i] = S41 * sumS_inv;
+  }
 #endif
 
+  // store the result
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    IonizationVariables &vars = *ionization_variables[i];
 #ifdef HAS_CARBON
-  // carbon
-  // the charge transfer recombination rates for C+ are negligble
-  const double C21 = jCp1 / (ne * alphaC[0]);
-  const double C32 =
-      jCp2 /
-      (ne * alphaC[1] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_C_p2, T4) +
-       nhe0 * charge_transfer_rates.get_charge_transfer_recombination_rate_He(
-                  ION_C_p2, T4));
-  const double C31 = C32 * C21;
-  const double sumC_inv = 1. / (1. + C21 + C31);
-  ionization_variables.set_ionic_fraction(ION_C_p1, C21 * sumC_inv);
-  ionization_variables.set_ionic_fraction(ION_C_p2, C31 * sumC_inv);
+    vars.set_ionic_fraction(ION_C_p1, fraction[ION_C_p1][i]);
+    vars.set_ionic_fraction(ION_C_p2, fraction[ION_C_p2][i]);
 #endif
-
 #ifdef HAS_NITROGEN
-  // nitrogen
-  const double N21 =
-      (jNn + nhp * charge_transfer_rates.get_charge_transfer_ionization_rate_H(
-                       ION_N_n, T4)) /
-      (ne * alphaN[0] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_N_n, T4));
-  const double N32 =
-      jNp1 /
-      (ne * alphaN[1] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_N_p1, T4) +
-       nhe0 * charge_transfer_rates.get_charge_transfer_recombination_rate_He(
-                  ION_N_p1, T4));
-  const double N43 =
-      jNp2 /
-      (ne * alphaN[2] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_N_p2, T4) +
-       nhe0 * charge_transfer_rates.get_charge_transfer_recombination_rate_He(
-                  ION_N_p2, T4));
-  const double N31 = N32 * N21;
-  const double N41 = N43 * N31;
-  const double sumN_inv = 1. / (1. + N21 + N31 + N41);
-  ionization_variables.set_ionic_fraction(ION_N_n, N21 * sumN_inv);
-  ionization_variables.set_ionic_fraction(ION_N_p1, N31 * sumN_inv);
-  ionization_variables.set_ionic_fraction(ION_N_p2, N41 * sumN_inv);
+    vars.set_ionic_fraction(ION_N_n, fraction[ION_N_n][i]);
+    vars.set_ionic_fraction(ION_N_p1, fraction[ION_N_p1][i]);
+    vars.set_ionic_fraction(ION_N_p2, fraction[ION_N_p2][i]);
 #endif
-
 #ifdef HAS_OXYGEN
-  // Oxygen
-  const double O21 =
-      (jOn + nhp * charge_transfer_rates.get_charge_transfer_ionization_rate_H(
-                       ION_O_n, T4)) /
-      (ne * alphaO[0] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_O_n, T4));
-  const double O32 =
-      jOp1 /
-      (ne * alphaO[1] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_O_p1, T4) +
-       nhe0 * charge_transfer_rates.get_charge_transfer_recombination_rate_He(
-                  ION_O_p1, T4));
-  const double O31 = O32 * O21;
-  const double sumO_inv = 1. / (1. + O21 + O31);
-  ionization_variables.set_ionic_fraction(ION_O_n, O21 * sumO_inv);
-  ionization_variables.set_ionic_fraction(ION_O_p1, O31 * sumO_inv);
+    vars.set_ionic_fraction(ION_O_n, fraction[ION_O_n][i]);
+    vars.set_ionic_fraction(ION_O_p1, fraction[ION_O_p1][i]);
 #endif
-
 #ifdef HAS_NEON
-  // Neon
-  const double Ne21 = jNen / (ne * alphaNe[0]);
-  const double Ne32 =
-      jNep1 /
-      (ne * alphaNe[1] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_Ne_p1, T4) +
-       nhe0 * charge_transfer_rates.get_charge_transfer_recombination_rate_He(
-                  ION_Ne_p1, T4));
-  const double Ne31 = Ne32 * Ne21;
-  const double sumNe_inv = 1. / (1. + Ne21 + Ne31);
-  ionization_variables.set_ionic_fraction(ION_Ne_n, Ne21 * sumNe_inv);
-  ionization_variables.set_ionic_fraction(ION_Ne_p1, Ne31 * sumNe_inv);
+    vars.set_ionic_fraction(ION_Ne_n, fraction[ION_Ne_n][i]);
+    vars.set_ionic_fraction(ION_Ne_p1, fraction[ION_Ne_p1][i]);
 #endif
-
 #ifdef HAS_SULPHUR
-  // Sulphur
-  const double S21 =
-      jSp1 /
-      (ne * alphaS[0] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_S_p1, T4));
-  const double S32 =
-      jSp2 /
-      (ne * alphaS[1] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_S_p2, T4) +
-       nhe0 * charge_transfer_rates.get_charge_transfer_recombination_rate_He(
-                  ION_S_p2, T4));
-  const double S43 =
-      jSp3 /
-      (ne * alphaS[2] +
-       nh0 * charge_transfer_rates.get_charge_transfer_recombination_rate_H(
-                 ION_S_p3, T4) +
-       nhe0 * charge_transfer_rates.get_charge_transfer_recombination_rate_He(
-                  ION_S_p3, T4));
-  const double S31 = S32 * S21;
-  const double S41 = S43 * S31;
-  const double sumS_inv = 1. / (1. + S21 + S31 + S41);
-  ionization_variables.set_ionic_fraction(ION_S_p1, S21 * sumS_inv);
-  ionization_variables.set_ionic_fraction(ION_S_p2, S31 * sumS_inv);
-  ionization_variables.set_ionic_fraction(ION_S_p3, S41 * sumS_inv);
+    vars.set_ionic_fraction(ION_S_p1, fraction[ION_S_p1][i]);
+    vars.set_ionic_fraction(ION_S_p2, fraction[ION_S_p2][i]);
+    vars.set_ionic_fraction(ION_S_p3, fraction[ION_S_p3][i]);
+#endif
+  }
 #endif
 }
 
@@ -532,6 +661,9 @@ void IonizationStateCalculator::calculate_ionization_state(
 /**
  * @brief Calculate the ionization state for all cells in the given subgrid.
  *
+ * The cells are processed in batches of IONIZATIONSTATECALCULATOR_BATCH_SIZE
+ * cells using calculate_ionization_state_batch().
+ *
  * @param totweight Total weight of all photon packets.
  * @param subgrid DensitySubGrid to work on.
  */
@@ -541,10 +673,26 @@ void IonizationStateCalculator::calculate_ionization_state(
   const double jfac = _luminosity / totweight;
   const double hfac =
       jfac * PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_PLANCK);
+  // process the cells in batches
+  uint_fast32_t number_of_cells = 0;
+  double jfacs[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double hfacs[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  IonizationVariables
+      *ionization_variables[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
   for (auto cellit = subgrid.begin(); cellit != subgrid.end(); ++cellit) {
-    calculate_ionization_state(jfac / cellit.get_volume(),
-                               hfac / cellit.get_volume(),
-                               cellit.get_ionization_variables());
+    jfacs[number_of_cells] = jfac / cellit.get_volume();
+    hfacs[number_of_cells] = hfac / cellit.get_volume();
+    ionization_variables[number_of_cells] = &cellit.get_ionization_variables();
+    ++number_of_cells;
+    if (number_of_cells == IONIZATIONSTATECALCULATOR_BATCH_SIZE) {
+      calculate_ionization_state_batch(number_of_cells, jfacs, hfacs,
+                                       ionization_variables);
+      number_of_cells = 0;
+    }
+  }
+  if (number_of_cells > 0) {
+    calculate_ionization_state_batch(number_of_cells, jfacs, hfacs,
+                                     ionization_variables);
   }
 }
 
@@ -636,6 +784,9 @@ void IonizationStateCalculator::calculate_ionization_state(
  * until the relative difference between the obtained neutral fractions is
  * below some tolerance value.
  *
+ * This is a batch of one cell for
+ * compute_ionization_states_hydrogen_helium_batch().
+ *
  * @param alphaH Hydrogen recombination rate (in m^3s^-1).
  * @param alphaHe Helium recombination rate (in m^3s^-1).
  * @param jH Hydrogen intensity integral (in s^-1).
@@ -651,100 +802,165 @@ void IonizationStateCalculator::compute_ionization_states_hydrogen_helium(
     const double jHe, const double nH, const double AHe, const double T,
     double &h0, double &he0) {
 
-  // make sure the input to this function is physical
-  cmac_assert(alphaH >= 0.);
-  cmac_assert(alphaHe >= 0.);
-  cmac_assert(jH >= 0.);
-  cmac_assert(jHe >= 0.);
-  cmac_assert(nH >= 0.);
-  cmac_assert(AHe >= 0.);
-  cmac_assert(T >= 0.);
-
-  // shortcut: if jH is very small, then the gas is neutral
-  if (jH < 1.e-20) {
-    h0 = 1.;
-    he0 = 1.;
-    return;
-  }
+  compute_ionization_states_hydrogen_helium_batch(1, &alphaH, &alphaHe, &jH,
+                                                  &jHe, &nH, &AHe, &T, &h0,
+                                                  &he0);
+}
 
-  // we multiplied Kenny's value with 1.e-6 to convert from cm^3s^-1 to m^3s^-1
-  // NOTE that this is a different expression from the one in Kenny's code!
-  const double alpha_e_2sP = 4.17e-20 * std::pow(T * 1.e-4, -0.861);
-  const double ch1 = alphaH * nH / jH;
-  const double ch2 = AHe * alpha_e_2sP * nH / jH;
-  double che = 0.;
-  if (jHe > 0.) {
-    che = alphaHe * nH / jHe;
-  }
-  // che should always be positive
-  cmac_assert(che >= 0.);
-
-  // initial guesses for the neutral fractions
-  double h0old = 0.99 * (1. - std::exp(-0.5 / ch1));
-  cmac_assert(h0old >= 0. && h0old <= 1.);
-
-  // by enforcing a relative difference of 10%, we make sure we have at least
-  // one iteration
-  h0 = 0.9 * h0old;
-  double he0old = 1.;
-  // we make sure che is 0 if the helium intensity integral is 0
-  if (che > 0.) {
-    he0old = 0.5 / che;
-    // make sure the neutral fraction is at most 100%
-    he0old = std::min(he0old, 1.);
-  }
-  // again, by using this value we make sure we have at least one iteration
-  he0 = 0.;
-  uint_fast8_t niter = 0;
-  while (std::abs(h0 - h0old) > 1.e-4 * h0old &&
-         std::abs(he0 - he0old) > 1.e-4 * he0old) {
-    ++niter;
-    h0old = h0;
-    if (he0 > 0.) {
-      he0old = he0;
-    } else {
-      he0old = 0.;
+/**
+ * @brief Batched version of compute_ionization_states_hydrogen_helium().
+ *
+ * All cells in the batch are iterated in lockstep. Every iteration updates the
+ * neutral fractions of all cells using branch-free arithmetic, but the update
+ * is only stored for cells that have not converged yet. Since all cells start
+ * iterating at the same time, this gives exactly the same result as calling
+ * compute_ionization_states_hydrogen_helium() for every cell separately.
+ *
+ * @param number_of_cells Number of cells in the batch (at most
+ * IONIZATIONSTATECALCULATOR_BATCH_SIZE).
+ * @param alphaH Hydrogen recombination rate in each cell (in m^3s^-1).
+ * @param alphaHe Helium recombination rate in each cell (in m^3s^-1).
+ * @param jH Hydrogen intensity integral in each cell (in s^-1).
+ * @param jHe Helium intensity integral in each cell (in s^-1).
+ * @param nH Hydrogen number density in each cell (in m^-3).
+ * @param AHe Helium abundance @f$A_{\rm{}He}@f$ in each cell (relative w.r.t.
+ * hydrogen).
+ * @param T Temperature in each cell (in K).
+ * @param h0 Array to store resulting hydrogen neutral fractions in.
+ * @param he0 Array to store resulting helium neutral fractions in.
+ */
+void IonizationStateCalculator::compute_ionization_states_hydrogen_helium_batch(
+    const uint_fast32_t number_of_cells, const double *alphaH,
+    const double *alphaHe, const double *jH, const double *jHe,
+    const double *nH, const double *AHe, const double *T, double *h0,
+    double *he0) {
+
+  cmac_assert(number_of_cells <= IONIZATIONSTATECALCULATOR_BATCH_SIZE);
+
+  double ch1[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double ch2[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double che[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double sqrtT[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double h0old[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double he0old[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  bool active[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  uint_fast32_t number_of_active_cells = 0;
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+
+    // make sure the input to this function is physical
+    cmac_assert(alphaH[i] >= 0.);
+    cmac_assert(alphaHe[i] >= 0.);
+    cmac_assert(jH[i] >= 0.);
+    cmac_assert(jHe[i] >= 0.);
+    cmac_assert(nH[i] >= 0.);
+    cmac_assert(AHe[i] >= 0.);
+    cmac_assert(T[i] >= 0.);
+
+    // shortcut: if jH is very small, then the gas is neutral
+    if (jH[i] < 1.e-20) {
+      h0[i] = 1.;
+      he0[i] = 1.;
+      active[i] = false;
+      // make sure the (unused) lockstep updates below use sensible values
+      ch1[i] = 0.;
+      ch2[i] = 0.;
+      che[i] = 0.;
+      sqrtT[i] = 1.;
+      h0old[i] = 0.5;
+      he0old[i] = 0.5;
+      continue;
     }
-    // calculate a new guess for C_H
-    const double pHots = 1. / (1. + 77. * he0old / std::sqrt(T) / h0old);
-    // make sure pHots is not NaN
-    cmac_assert(pHots == pHots);
-    const double ch = ch1 - ch2 * AHe * (1. - he0old) * pHots / (1. - h0old);
-
-    // find the helium neutral fraction
-    he0 = 1.;
-    if (che) {
-      const double bhe = (1. + 2. * AHe - h0) * che + 1.;
-      const double che_bhe = che / bhe;
-      const double opAHeh0 = 1. + AHe - h0;
-      const double t1he = 4. * AHe * opAHeh0 * che_bhe * che_bhe;
-      if (t1he < 1.e-3) {
-        // first order expansion of the square root in the exact solution of the
-        // quadratic equation
-        he0 = opAHeh0 * che_bhe;
-      } else {
-        // exact solution of the quadratic equation
-        he0 = (bhe - std::sqrt(bhe * bhe - 4. * AHe * opAHeh0 * che * che)) /
-              (2. * AHe * che);
-      }
+
+    const double alpha_e_2sP = get_alpha_e_2sP(T[i]);
+    ch1[i] = alphaH[i] * nH[i] / jH[i];
+    ch2[i] = AHe[i] * alpha_e_2sP * nH[i] / jH[i];
+    che[i] = 0.;
+    if (jHe[i] > 0.) {
+      che[i] = alphaHe[i] * nH[i] / jHe[i];
     }
-    // find the hydrogen neutral fraction
-    const double b = ch * (2. + AHe - he0 * AHe) + 1.;
-    const double ch_b = ch / b;
-    const double opAHeh0AHe = 1. + AHe - he0 * AHe;
-    const double t1 = 4. * ch_b * ch_b * opAHeh0AHe;
-    if (t1 < 1.e-3) {
-      h0 = ch_b * opAHeh0AHe;
-    } else {
-      cmac_assert_message(b * b > 4. * ch * ch * opAHeh0AHe,
-                          "T: %g, jH: %g, jHe: %g, nH: %g", T, jH, jHe, nH);
-      h0 = (b - std::sqrt(b * b - 4. * ch * ch * opAHeh0AHe)) / (2. * ch);
+    // che should always be positive
+    cmac_assert(che[i] >= 0.);
+    sqrtT[i] = std::sqrt(T[i]);
+
+    // initial guesses for the neutral fractions
+    h0old[i] = 0.99 * (1. - std::exp(-0.5 / ch1[i]));
+    cmac_assert(h0old[i] >= 0. && h0old[i] <= 1.);
+    // by enforcing a relative difference of 10%, we make sure we have at least
+    // one iteration
+    h0[i] = 0.9 * h0old[i];
+    he0old[i] = 1.;
+    // we make sure che is 0 if the helium intensity integral is 0
+    if (che[i] > 0.) {
+      // make sure the neutral fraction is at most 100%
+      he0old[i] = std::min(0.5 / che[i], 1.);
+    }
+    // again, by using this value we make sure we have at least one iteration
+    he0[i] = 0.;
+    active[i] = std::abs(h0[i] - h0old[i]) > 1.e-4 * h0old[i] &&
+                std::abs(he0[i] - he0old[i]) > 1.e-4 * he0old[i];
+    if (active[i]) {
+      ++number_of_active_cells;
     }
-    if (niter > 10) {
+  }
+
+  uint_fast8_t niter = 0;
+  while (number_of_active_cells > 0) {
+    ++niter;
+    number_of_active_cells = 0;
+    for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+      const double h0old_new = h0[i];
+      const double he0old_new = (he0[i] > 0.) ? he0[i] : 0.;
+      // calculate a new guess for C_H
+      const double pHots =
+          1. / (1. + 77. * he0old_new / sqrtT[i] / h0old_new);
+      const double ch = ch1[i] - ch2[i] * AHe[i] * (1. - he0old_new) * pHots /
+                                     (1. - h0old_new);
+
+      // find the helium neutral fraction
+      const double bhe = (1. + 2. * AHe[i] - h0[i]) * che[i] + 1.;
+      const double che_bhe = che[i] / bhe;
+      const double opAHeh0 = 1. + AHe[i] - h0[i];
+      const double t1he = 4. * AHe[i] * opAHeh0 * che_bhe * che_bhe;
+      // exact solution of the quadratic equation; we use the first order
+      // expansion of the square root in this solution if the second term is
+      // small
+      const double he0_exact =
+          (bhe - std::sqrt(std::abs(bhe * bhe - 4. * AHe[i] * opAHeh0 *
+                                                    che[i] * che[i]))) /
+          (2. * AHe[i] * che[i]);
+      const double he0_new =
+          (che[i] != 0.) ? ((t1he < 1.e-3) ? opAHeh0 * che_bhe : he0_exact)
+                         : 1.;
+
+      // find the hydrogen neutral fraction
+      const double b = ch * (2. + AHe[i] - he0_new * AHe[i]) + 1.;
+      const double ch_b = ch / b;
+      const double opAHeh0AHe = 1. + AHe[i] - he0_new * AHe[i];
+      const double t1 = 4. * ch_b * ch_b * opAHeh0AHe;
+      const double h0_exact =
+          (b - std::sqrt(std::abs(b * b - 4. * ch * ch * opAHeh0AHe))) /
+          (2. * ch);
+      const double h0_new = (t1 < 1.e-3) ? ch_b * opAHeh0AHe : h0_exact;
+
       // if we have a lot of iterations: use the mean value to speed up
       // convergence
-      h0 = 0.5 * (h0 + h0old);
-      he0 = 0.5 * (he0 + he0old);
+      const double h0_mixed =
+          (niter > 10) ? 0.5 * (h0_new + h0old_new) : h0_new;
+      const double he0_mixed =
+          (niter > 10) ? 0.5 * (he0_new + he0old_new) : he0_new;
+
+      // only update cells that have not converged yet
+      h0old[i] = active[i] ? h0old_new : h0old[i];
+      he0old[i] = active[i] ? he0old_new : he0old[i];
+      h0[i] = active[i] ? h0_mixed : h0[i];
+      he0[i] = active[i] ? he0_mixed : he0[i];
+    }
+    for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+      active[i] = active[i] && std::abs(h0[i] - h0old[i]) > 1.e-4 * h0old[i] &&
+                  std::abs(he0[i] - he0old[i]) > 1.e-4 * he0old[i];
+      if (active[i]) {
+        ++number_of_active_cells;
+      }
     }
     if (niter > 20) {
       cmac_error("Too many iterations in ionization loop!");
@@ -29,11 +29,21 @@
 
 #include "DensityGrid.hpp"
 
+#include <cmath>
+
 class Abundances;
 class ChargeTransferRates;
 class DensitySubGrid;
 class RecombinationRates;
 
+/*! @brief Number of cells that are processed together by the batched
+ *  ionization state solver. */
+#define IONIZATIONSTATECALCULATOR_BATCH_SIZE 16
+
+/*! @brief Number of metal ions for which the ionization balance is computed,
+ *  in the order C+, C++, N0, N+, N++, O0, O+, Ne0, Ne+, S+, S++, S+++. */
+#define IONIZATIONSTATECALCULATOR_NUMBER_OF_METAL_IONS 12
+
 /**
  * @brief Class that calculates the ionization state on a grid after the photon
  * shoot loop.
@@ -70,6 +80,10 @@ public:
   calculate_ionization_state(const double jfac, const double hfac,
                              IonizationVariables &ionization_variables) const;
 
+  void calculate_ionization_state_batch(
+      const uint_fast32_t number_of_cells, const double *jfac,
+      const double *hfac, IonizationVariables **ionization_variables) const;
+
   /**
    * @brief Update the total luminosity of the sources.
    *
@@ -79,8 +93,66 @@ public:
     _luminosity = luminosity;
   }
 
+  /**
+   * @brief Get the effective recombination rate of He+ to the 2^1P level of
+   * helium.
+   *
+   * Helium atoms in this level decay to the ground state by emitting a He
+   * Lyman alpha photon, which can be absorbed on the spot by hydrogen.
+   *
+   * Wood, Mathis & Ercolano (2004), equation 25. NOTE that this is a different
+   * expression from the one in Kenny's code! Kenny's expression is in units
+   * cm^3 s^-1, we multiplied by 1.e-6 to convert to m^3 s^-1.
+   *
+   * @param T Temperature (in K).
+   * @return Effective recombination rate (in m^3 s^-1).
+   */
+  inline static double get_alpha_e_2sP(const double T) {
+    return 4.17e-20 * std::pow(T * 1.e-4, -0.861);
+  }
+
+  /**
+   * @brief Gather the mean intensity integrals of the metal ions in the order
+   * used by compute_ionization_states_metals().
+   *
+   * @param j Mean intensity integrals of all ions (in s^-1).
+   * @param j_metals Array to store the mean intensity integrals of the metal
+   * ions in (0 for ions of elements that are not traced; in s^-1).
+   */
+  inline static void get_metal_mean_intensities(
+      const double j[NUMBER_OF_IONNAMES],
+      double j_metals[IONIZATIONSTATECALCULATOR_NUMBER_OF_METAL_IONS]) {
+
+    for (int_fast32_t i = 0; i < IONIZATIONSTATECALCULATOR_NUMBER_OF_METAL_IONS;
+         ++i) {
+      j_metals[i] = 0.;
+    }
+#ifdef HAS_CARBON
+    j_metals[0] = j[ION_C_p1];
+    j_metals[1] = j[ION_C_p2];
+#endif
+#ifdef HAS_NITROGEN
+    j_metals[2] = j[ION_N_n];
+    j_metals[3] = j[ION_N_p1];
+    j_metals[4] = j[ION_N_p2];
+#endif
+#ifdef HAS_OXYGEN
+    j_metals[5] = j[ION_O_n];
+    j_metals[6] = j[ION_O_p1];
+#endif
+#ifdef HAS_NEON
+    j_metals[7] = j[ION_Ne_n];
+    j_metals[8] = j[ION_Ne_p1];
+#endif
+#ifdef HAS_SULPHUR
+    j_metals[9] = j[ION_S_p1];
+    j_metals[10] = j[ION_S_p2];
+    j_metals[11] = j[ION_S_p3];
+#endif
+  }
+
   static void compute_ionization_states_metals(
-      const double *j_metals, const double ne, const double T, const double T4,
+      const double *j_metals, const double ne, const double T,
       const double nh0, const double nhe0, const double nhp,
       const RecombinationRates &recombination_rates,
       const ChargeTransferRates &charge_transfer_rates,
@@ -91,6 +163,24 @@ public:
       const double jHe, const double nH, const double AHe, const double T,
       double &h0, double &he0);
 
+  static void compute_ionization_states_metals_batch(
+      const uint_fast32_t number_of_cells,
+      const double (*j_metals)[IONIZATIONSTATECALCULATOR_NUMBER_OF_METAL_IONS],
+      const double *ne, const double *T, const double *nh0, const double *nhe0,
+      const double *nhp, const RecombinationRates &recombination_rates,
+      const ChargeTransferRates &charge_transfer_rates,
+      IonizationVariables **ionization_variables);
+
+  static void compute_ionization_states_hydrogen_helium_batch(
+      const uint_fast32_t number_of_cells, const double *alphaH,
+      const double *alphaHe, const double *jH, const double *jHe,
+      const double *nH, const double *AHe, const double *T, double *h0,
+      double *he0);
+
+  static void
+  set_neutral_ionic_fractions(const double neutral_fraction,
+                              IonizationVariables &ionization_variables);
+
   static double compute_ionization_state_hydrogen(const double alphaH,
                                                   const double jH,
                                                   const double nH);
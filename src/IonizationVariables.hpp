@@ -75,33 +75,61 @@ enum HeatingTermName {
   NUMBER_OF_HEATINGTERMS
 };
 
+/**
+ * @brief Offsets of the number density and the ionic fractions within the
+ * traversal inputs of a cell.
+ */
+enum TraversalInputOffset {
+  /*! @brief Number density. */
+  TRAVERSALINPUT_NUMBER_DENSITY = 0,
+  /*! @brief First ionic fraction. */
+  TRAVERSALINPUT_IONIC_FRACTION = 1,
+  /*! @brief Counter. Should always be the last element! */
+  NUMBER_OF_TRAVERSALINPUTS = 1 + NUMBER_OF_IONNAMES
+};
+
+class DensitySubGrid;
+
 /**
  * @brief Variables used in the ionization calculation.
+ *
+ * The number density and ionic fractions (the traversal inputs) are read
+ * during every photon traversal step, but only change when the ionization
+ * state is updated. They are accessed through a pointer and a stride, so that
+ * a DensitySubGrid can store them as one array per variable, while the other
+ * variables of its cells (including the mean intensity and heating
+ * accumulators) stay together in the IonizationVariables object. All other
+ * IonizationVariables point to their own copy of the traversal inputs.
  */
 class IonizationVariables {
 private:
-  /*! @brief Number density (in m^-3). */
-  double _number_density;
-
-  /*! @brief Temperature (in K). */
-  double _temperature;
-
-  /*! @brief Ionic fractions. For hydrogen and helium, these are the neutral
-   *  fractions. For other elements, they are the fraction of the end product
-   *  of ionization (e.g. _ionic_fraction[ION_C_p1] is the fraction of C that
-   *  is in the form of C++). */
-  double _ionic_fractions[NUMBER_OF_IONNAMES];
-
   /*! @brief Mean intensity integrals of ionizing radiation (without
    *  normalization factor, in m^3). */
   double _mean_intensity[NUMBER_OF_IONNAMES];
 
-  /*! @brief Reemission probabilities. */
-  double _reemission_probabilities[NUMBER_OF_REEMISSIONPROBABILITIES];
-
   /*! @brief Heating integrals (without normalization factor, in m^3 s^-1). */
   double _heating[NUMBER_OF_HEATINGTERMS];
 
+  /*! @brief Number density followed by the ionic fractions, stored with a
+   *  distance of _traversal_input_stride between consecutive values. */
+  double *_traversal_inputs;
+
+  /*! @brief Distance between consecutive traversal inputs in memory. */
+  size_t _traversal_input_stride;
+
+  /*! @brief Own traversal inputs, used if the traversal inputs are not stored
+   *  by a DensitySubGrid. For hydrogen and helium, the ionic fractions are the
+   *  neutral fractions. For other elements, they are the fraction of the end
+   *  product of ionization (e.g. the ionic fraction of ION_C_p1 is the
+   *  fraction of C that is in the form of C++). */
+  double _own_traversal_inputs[NUMBER_OF_TRAVERSALINPUTS];
+
+  /*! @brief Temperature (in K). */
+  double _temperature;
+
+  /*! @brief Reemission probabilities. */
+  double _reemission_probabilities[NUMBER_OF_REEMISSIONPROBABILITIES];
+
 #ifdef DO_OUTPUT_COOLING
   /*! @brief Cooling rates per element (in J s^-1). */
   double _cooling[NUMBER_OF_IONNAMES];
@@ -117,16 +145,58 @@ private:
   /*! @brief (Optional) tracker for this cell. */
   Tracker *_tracker;
 
+  /**
+   * @brief Access the traversal input with the given offset.
+   *
+   * @param offset TraversalInputOffset.
+   * @return Reference to the traversal input.
+   */
+  inline double &traversal_input(const int_fast32_t offset) {
+    return _traversal_inputs[offset * _traversal_input_stride];
+  }
+
+  /**
+   * @brief Read-only access to the traversal input with the given offset.
+   *
+   * @param offset TraversalInputOffset.
+   * @return Value of the traversal input.
+   */
+  inline double traversal_input(const int_fast32_t offset) const {
+    return _traversal_inputs[offset * _traversal_input_stride];
+  }
+
+  /**
+   * @brief Move the traversal inputs to the given location and reset them.
+   *
+   * Only used by DensitySubGrid, which owns the traversal inputs of its cells.
+   *
+   * @param traversal_inputs First traversal input.
+   * @param traversal_input_stride Distance between consecutive traversal
+   * inputs in memory.
+   */
+  inline void set_traversal_inputs(double *traversal_inputs,
+                                   const size_t traversal_input_stride) {
+    _traversal_inputs = traversal_inputs;
+    _traversal_input_stride = traversal_input_stride;
+    for (int_fast32_t i = 0; i < NUMBER_OF_TRAVERSALINPUTS; ++i) {
+      traversal_input(i) = 0.;
+    }
+  }
+
+  friend class DensitySubGrid;
+
 public:
   /**
    * @brief (Empty) constructor.
    */
   inline IonizationVariables()
-      : _number_density(0.), _temperature(0.), _cosmic_ray_factor(-1.),
-        _tracker(nullptr) {
+      : _traversal_inputs(_own_traversal_inputs), _traversal_input_stride(1),
+        _temperature(0.), _cosmic_ray_factor(-1.), _tracker(nullptr) {
 
+    for (int_fast32_t i = 0; i < NUMBER_OF_TRAVERSALINPUTS; ++i) {
+      _own_traversal_inputs[i] = 0.;
+    }
     for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-      _ionic_fractions[i] = 0.;
       _mean_intensity[i] = 0.;
     }
     for (int_fast32_t i = 0; i < NUMBER_OF_REEMISSIONPROBABILITIES; ++i) {
@@ -142,6 +212,34 @@ public:
 #endif
   }
 
+  /**
+   * @brief Copy constructor.
+   *
+   * The copy stores its own traversal inputs.
+   *
+   * @param other Other IonizationVariables instance.
+   */
+  inline IonizationVariables(const IonizationVariables &other)
+      : _traversal_inputs(_own_traversal_inputs), _traversal_input_stride(1),
+        _tracker(other._tracker) {
+    copy_all(other);
+  }
+
+  /**
+   * @brief Assignment operator.
+   *
+   * Copies the values of all variables, but keeps the traversal inputs in
+   * their current location.
+   *
+   * @param other Other IonizationVariables instance.
+   * @return Reference to this instance.
+   */
+  inline IonizationVariables &operator=(const IonizationVariables &other) {
+    copy_all(other);
+    _tracker = other._tracker;
+    return *this;
+  }
+
   /**
    * @brief Copy the contents of the given IonizationVariables instance into
    * this one.
@@ -151,7 +249,7 @@ public:
   inline void copy_all(const IonizationVariables &other) {
 
     // single variables
-    _number_density = other._number_density;
+    set_number_density(other.get_number_density());
     _temperature = other._temperature;
     _cosmic_ray_factor = other._cosmic_ray_factor;
 #ifdef VARIABLE_ABUNDANCES
@@ -160,7 +258,7 @@ public:
 
     // ionic variables
     for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-      _ionic_fractions[i] = other._ionic_fractions[i];
+      set_ionic_fraction(i, other.get_ionic_fraction(i));
       _mean_intensity[i] = other._mean_intensity[i];
 #ifdef DO_OUTPUT_COOLING
       _cooling[i] = other._cooling[i];
@@ -186,7 +284,7 @@ public:
    */
   inline void copy_ionic_fractions(const IonizationVariables &other) {
     for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-      _ionic_fractions[i] = other._ionic_fractions[i];
+      set_ionic_fraction(i, other.get_ionic_fraction(i));
     }
     _temperature = other._temperature;
   }
@@ -223,7 +321,9 @@ public:
    *
    * @return Number density (in m^-3).
    */
-  inline double get_number_density() const { return _number_density; }
+  inline double get_number_density() const {
+    return traversal_input(TRAVERSALINPUT_NUMBER_DENSITY);
+  }
 
   /**
    * @brief Set the number density.
@@ -231,7 +331,7 @@ public:
    * @param number_density New number density (in m^-3).
    */
   inline void set_number_density(const double number_density) {
-    _number_density = number_density;
+    traversal_input(TRAVERSALINPUT_NUMBER_DENSITY) = number_density;
   }
 
   /**
@@ -253,11 +353,16 @@ public:
   /**
    * @brief Get the ionic fraction of the ion with the given name.
    *
+   * For hydrogen and helium, these are the neutral fractions. For other
+   * elements, they are the fraction of the end product of ionization (e.g. the
+   * ionic fraction of ION_C_p1 is the fraction of C that is in the form of
+   * C++).
+   *
    * @param ion IonName.
    * @return Ionic fraction of that ion.
    */
   inline double get_ionic_fraction(const int_fast32_t ion) const {
-    return _ionic_fractions[ion];
+    return traversal_input(TRAVERSALINPUT_IONIC_FRACTION + ion);
   }
 
   /**
@@ -268,7 +373,7 @@ public:
    */
   inline void set_ionic_fraction(const int_fast32_t ion,
                                  const double ionic_fraction) {
-    _ionic_fractions[ion] = ionic_fraction;
+    traversal_input(TRAVERSALINPUT_IONIC_FRACTION + ion) = ionic_fraction;
   }
 
   /**
@@ -413,10 +518,10 @@ public:
    */
   inline void write_restart_file(RestartWriter &restart_writer) const {
 
-    restart_writer.write(_number_density);
+    restart_writer.write(get_number_density());
     restart_writer.write(_temperature);
     for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-      restart_writer.write(_ionic_fractions[i]);
+      restart_writer.write(get_ionic_fraction(i));
       restart_writer.write(_mean_intensity[i]);
 #ifdef DO_OUTPUT_COOLING
       restart_writer.write(_cooling[i]);
@@ -436,12 +541,13 @@ public:
    *
    * @param restart_reader Restart file to read from.
    */
-  inline IonizationVariables(RestartReader &restart_reader) {
+  inline IonizationVariables(RestartReader &restart_reader)
+      : _traversal_inputs(_own_traversal_inputs), _traversal_input_stride(1) {
 
-    _number_density = restart_reader.read< double >();
+    set_number_density(restart_reader.read< double >());
     _temperature = restart_reader.read< double >();
     for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-      _ionic_fractions[i] = restart_reader.read< double >();
+      set_ionic_fraction(i, restart_reader.read< double >());
       _mean_intensity[i] = restart_reader.read< double >();
 #ifdef DO_OUTPUT_COOLING
       _cooling[i] = restart_reader.read< double >();
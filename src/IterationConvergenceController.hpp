@@ -0,0 +1,336 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file IterationConvergenceController.hpp
+ *
+ * @brief Convergence-based control of the number of iterations and the number
+ * of photon packets of the photoionization algorithm.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef ITERATIONCONVERGENCECONTROLLER_HPP
+#define ITERATIONCONVERGENCECONTROLLER_HPP
+
+#include "Error.hpp"
+#include "Log.hpp"
+#include "ParameterFile.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+/**
+ * @brief Convergence-based control of the number of iterations and the number
+ * of photon packets of the photoionization algorithm.
+ *
+ * After every iteration, the mass weighted average absolute change in the
+ * neutral hydrogen fraction and the mass weighted average relative change in
+ * the temperature w.r.t. the previous iteration are computed. The largest of
+ * both is the change metric for that iteration.
+ *
+ * If the change is dominated by Monte Carlo noise, it is the difference of
+ * two independent estimates with a noise level that scales as
+ * \f$\sigma{}_i = \sigma{}_0/\sqrt{N_i}\f$, with \f$N_i\f$ the number of photon
+ * packets used during iteration \f$i\f$, so that the change metric
+ * \f$\Delta{}_i\f$ gives an upper limit for the noise during iteration
+ * \f$i\f$:
+ * \f[
+ *   \sigma{}_i \leq{} \frac{\Delta{}_i}{\sqrt{1 + N_i/N_{i-1}}}.
+ * \f]
+ *
+ * The algorithm is converged once the change metric drops below the
+ * tolerance (after a minimum number of iterations). If not, the number of
+ * photon packets for the next iteration is chosen to bring the noise down to
+ * half the tolerance: the number is increased (by at most a factor 4) if the
+ * change stays roughly constant (within a factor 2 of the previous change),
+ * i.e. when the change is noise dominated, and decreased (by at most a factor
+ * 2) if the upper limit on the noise is already below the target.
+ */
+class IterationConvergenceController {
+private:
+  /*! @brief Tolerance on the change metric. */
+  const double _tolerance;
+
+  /*! @brief Minimum number of iterations before the algorithm can be
+   *  considered converged. */
+  const uint_fast32_t _minimum_number_of_iterations;
+
+  /*! @brief Minimum number of photon packets per iteration. */
+  const uint_fast64_t _minimum_number_of_photons;
+
+  /*! @brief Maximum number of photon packets per iteration. */
+  const uint_fast64_t _maximum_number_of_photons;
+
+  /*! @brief Neutral fraction of each cell during the previous iteration. */
+  std::vector< double > _previous_neutral_fraction;
+
+  /*! @brief Temperature of each cell during the previous iteration (in K). */
+  std::vector< double > _previous_temperature;
+
+  /*! @brief Do we have values for a previous iteration? */
+  bool _has_previous;
+
+  /*! @brief Accumulated change metrics for the current iteration: total weight,
+   *  weighted neutral fraction change and weighted relative temperature
+   *  change. */
+  double _sums[3];
+
+  /*! @brief Change metric during the previous iteration (negative if not
+   *  available). */
+  double _previous_change;
+
+  /*! @brief Number of photon packets used during the previous iteration. */
+  uint_fast64_t _previous_number_of_photons;
+
+  /*! @brief Upper limit on the Monte Carlo noise during the last iteration
+   *  (negative if not available). */
+  double _noise;
+
+  /*! @brief Has the algorithm converged? */
+  bool _converged;
+
+  /*! @brief Log to write logging info to. */
+  Log *_log;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param number_of_cells Total number of cells in the grid.
+   * @param tolerance Tolerance on the change metric.
+   * @param minimum_number_of_iterations Minimum number of iterations before
+   * the algorithm can be considered converged.
+   * @param minimum_number_of_photons Minimum number of photon packets per
+   * iteration.
+   * @param maximum_number_of_photons Maximum number of photon packets per
+   * iteration.
+   * @param log Log to write logging info to.
+   */
+  inline IterationConvergenceController(
+      const uint_fast64_t number_of_cells, const double tolerance,
+      const uint_fast32_t minimum_number_of_iterations,
+      const uint_fast64_t minimum_number_of_photons,
+      const uint_fast64_t maximum_number_of_photons, Log *log = nullptr)
+      : _tolerance(tolerance),
+        _minimum_number_of_iterations(minimum_number_of_iterations),
+        _minimum_number_of_photons(minimum_number_of_photons),
+        _maximum_number_of_photons(maximum_number_of_photons),
+        _previous_neutral_fraction(number_of_cells, 0.),
+        _previous_temperature(number_of_cells, 0.), _has_previous(false),
+        _sums{0., 0., 0.}, _previous_change(-1.),
+        _previous_number_of_photons(0), _noise(-1.), _converged(false),
+        _log(log) {
+
+    if (_minimum_number_of_photons > _maximum_number_of_photons) {
+      cmac_error("Minimum number of photons (%" PRIuFAST64
+                 ") larger than maximum number of photons (%" PRIuFAST64 ")!",
+                 _minimum_number_of_photons, _maximum_number_of_photons);
+    }
+
+    if (_log) {
+      _log->write_status(
+          "Created IterationConvergenceController with tolerance ", _tolerance,
+          ", at least ", _minimum_number_of_iterations,
+          " iterations and between ", _minimum_number_of_photons, " and ",
+          _maximum_number_of_photons, " photon packets per iteration.");
+    }
+  }
+
+  /**
+   * @brief ParameterFile constructor.
+   *
+   * Parameters are read from the given section and are:
+   *  - convergence tolerance: Tolerance on the change in neutral fraction and
+   *    relative temperature between iterations (default: 0.01)
+   *  - minimum number of iterations: Minimum number of iterations before the
+   *    algorithm can be considered converged (default: 3)
+   *  - minimum number of photons: Minimum number of photon packets per
+   *    iteration (default: 0.1 * initial number of photons)
+   *  - maximum number of photons: Maximum number of photon packets per
+   *    iteration (default: 10 * initial number of photons)
+   *
+   * @param section Name of the parameter file section to read from.
+   * @param number_of_cells Total number of cells in the grid.
+   * @param number_of_photons Initial number of photon packets per iteration.
+   * @param params ParameterFile to read from.
+   * @param log Log to write logging info to.
+   */
+  inline IterationConvergenceController(const std::string section,
+                                        const uint_fast64_t number_of_cells,
+                                        const uint_fast64_t number_of_photons,
+                                        ParameterFile &params,
+                                        Log *log = nullptr)
+      : IterationConvergenceController(
+            number_of_cells,
+            params.get_value< double >(section + ":convergence tolerance",
+                                       0.01),
+            params.get_value< uint_fast32_t >(
+                section + ":minimum number of iterations", 3),
+            params.get_value< uint_fast64_t >(
+                section + ":minimum number of photons",
+                std::max< uint_fast64_t >(1, 0.1 * number_of_photons)),
+            params.get_value< uint_fast64_t >(
+                section + ":maximum number of photons",
+                10 * number_of_photons),
+            log) {}
+
+  /**
+   * @brief Add the current state of a cell to the change metric.
+   *
+   * This function is not thread safe.
+   *
+   * @param index Index of the cell (unique within the entire grid).
+   * @param weight Weight of the cell (e.g. its mass).
+   * @param neutral_fraction Current neutral hydrogen fraction of the cell.
+   * @param temperature Current temperature of the cell (in K).
+   */
+  inline void add_cell(const uint_fast64_t index, const double weight,
+                       const double neutral_fraction,
+                       const double temperature) {
+
+    cmac_assert_message(index < _previous_neutral_fraction.size(),
+                        "Cell index out of range!");
+
+    if (_has_previous) {
+      _sums[0] += weight;
+      _sums[1] += weight * std::abs(neutral_fraction -
+                                    _previous_neutral_fraction[index]);
+      if (_previous_temperature[index] > 0.) {
+        _sums[2] += weight *
+                    std::abs(temperature - _previous_temperature[index]) /
+                    _previous_temperature[index];
+      }
+    }
+    _previous_neutral_fraction[index] = neutral_fraction;
+    _previous_temperature[index] = temperature;
+  }
+
+#ifdef HAVE_MPI
+  /**
+   * @brief Sum the change metric contributions of all processes.
+   *
+   * Only needed if the cells are distributed over the processes; all
+   * processes need to call this function.
+   */
+  inline void reduce() {
+    MPI_Allreduce(MPI_IN_PLACE, _sums, 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  }
+#endif
+
+  /**
+   * @brief Finish an iteration: compute the change metric, check for
+   * convergence and compute the number of photon packets for the next
+   * iteration.
+   *
+   * @param iteration Index of the iteration that was just finished.
+   * @param number_of_photons Number of photon packets used during that
+   * iteration.
+   * @return Number of photon packets to use during the next iteration.
+   */
+  inline uint_fast64_t end_iteration(const uint_fast32_t iteration,
+                                     const uint_fast64_t number_of_photons) {
+
+    if (!_has_previous) {
+      _has_previous = true;
+      _previous_number_of_photons = number_of_photons;
+      if (_log) {
+        _log->write_status("Iteration ", iteration,
+                           ": no convergence estimate yet.");
+      }
+      return number_of_photons;
+    }
+
+    double neutral_fraction_change = 0.;
+    double temperature_change = 0.;
+    if (_sums[0] > 0.) {
+      neutral_fraction_change = _sums[1] / _sums[0];
+      temperature_change = _sums[2] / _sums[0];
+    }
+    _sums[0] = 0.;
+    _sums[1] = 0.;
+    _sums[2] = 0.;
+
+    const double change = std::max(neutral_fraction_change, temperature_change);
+    _noise = change / std::sqrt(1. + static_cast< double >(number_of_photons) /
+                                         _previous_number_of_photons);
+    _converged =
+        (iteration + 1 >= _minimum_number_of_iterations) && change < _tolerance;
+
+    uint_fast64_t new_number_of_photons = number_of_photons;
+    if (!_converged) {
+      const double target_noise = 0.5 * _tolerance;
+      const double factor = (_noise / target_noise) * (_noise / target_noise);
+      // a change that is still decreasing fast, or that increases a lot, is
+      // dominated by the evolution of the solution
+      const bool noise_dominated = _previous_change >= 0. &&
+                                   change > 0.5 * _previous_change &&
+                                   change < 2. * _previous_change;
+      if (_noise > target_noise && noise_dominated) {
+        new_number_of_photons = std::min(4., factor) * number_of_photons;
+      } else if (_noise < target_noise) {
+        new_number_of_photons = std::max(0.5, factor) * number_of_photons;
+      }
+      new_number_of_photons =
+          std::max(_minimum_number_of_photons,
+                   std::min(_maximum_number_of_photons, new_number_of_photons));
+    }
+
+    if (_log) {
+      _log->write_status("Iteration ", iteration,
+                         ": neutral fraction change: ", neutral_fraction_change,
+                         ", relative temperature change: ", temperature_change,
+                         ", estimated Monte Carlo noise: <", _noise, ".");
+      if (_converged) {
+        _log->write_status("Converged after ", iteration + 1, " iterations.");
+      } else if (new_number_of_photons != number_of_photons) {
+        _log->write_status("Changing number of photons from ",
+                           number_of_photons, " to ", new_number_of_photons,
+                           ".");
+      }
+    }
+
+    _previous_change = change;
+    _previous_number_of_photons = number_of_photons;
+    return new_number_of_photons;
+  }
+
+  /**
+   * @brief Has the algorithm converged?
+   *
+   * @return True if the change metric during the last iteration was below the
+   * tolerance (and enough iterations were done).
+   */
+  inline bool has_converged() const { return _converged; }
+
+  /**
+   * @brief Get the upper limit on the Monte Carlo noise during the last
+   * iteration.
+   *
+   * @return Upper limit on the Monte Carlo noise (negative if not available).
+   */
+  inline double get_noise() const { return _noise; }
+};
+
+#endif // ITERATIONCONVERGENCECONTROLLER_HPP
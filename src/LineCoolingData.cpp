@@ -1774,6 +1774,60 @@ double LineCoolingData::get_cooling(
     return 1.e-99;
   }
 
+  double cooling_per_coolant[LINECOOLINGDATA_NUMELEMENTS];
+  compute_cooling_per_coolant(temperature, electron_density, abundances,
+                              cooling_per_coolant);
+
+  double cooling = 0.;
+  for (int_fast32_t element = 0; element < LINECOOLINGDATA_NUMELEMENTS;
+       ++element) {
+    cooling += cooling_per_coolant[element];
+  }
+  return cooling;
+}
+
+/**
+ * @brief Get the radiative energy losses due to line cooling for a unit
+ * abundance of each coolant at the given temperature and electron density.
+ *
+ * See get_cooling() for more information.
+ *
+ * @param temperature Temperature (in K).
+ * @param electron_density Electron density (in m^-3).
+ * @param cooling Array to store the radiative cooling per hydrogen atom for a
+ * unit abundance of each coolant in (in kg m^2s^-3).
+ */
+void LineCoolingData::get_cooling_per_coolant(
+    const double temperature, const double electron_density,
+    double cooling[LINECOOLINGDATA_NUMELEMENTS]) const {
+
+  double unit_abundances[LINECOOLINGDATA_NUMELEMENTS];
+  for (int_fast32_t element = 0; element < LINECOOLINGDATA_NUMELEMENTS;
+       ++element) {
+    unit_abundances[element] = 1.;
+  }
+  compute_cooling_per_coolant(temperature, electron_density, unit_abundances,
+                              cooling);
+}
+
+/**
+ * @brief Compute the radiative energy losses due to line cooling of each
+ * coolant at the given temperature, electron density and coolant abundances.
+ *
+ * The abundance is applied as the first factor of each cooling rate, so that
+ * get_cooling() gives the same result as when it summed the rates directly.
+ *
+ * @param temperature Temperature (in K).
+ * @param electron_density Electron density (in m^-3).
+ * @param abundances Abundances of coolants.
+ * @param cooling Array to store the radiative cooling per hydrogen atom of each
+ * coolant in (in kg m^2s^-3).
+ */
+void LineCoolingData::compute_cooling_per_coolant(
+    const double temperature, const double electron_density,
+    const double abundances[LINECOOLINGDATA_NUMELEMENTS],
+    double cooling[LINECOOLINGDATA_NUMELEMENTS]) const {
+
   /// initialize some variables
 
   // Boltzmann constant (in J s^-1)
@@ -1789,7 +1843,6 @@ double LineCoolingData::get_cooling(
 
   /// five level elements
 
-  double cooling = 0.;
   for (int_fast32_t element = 0; element < LINECOOLINGDATA_NUMFIVELEVELELEMENTS;
        ++element) {
 
@@ -1828,7 +1881,7 @@ double LineCoolingData::get_cooling(
          _five_level_transition_probability[element][TRANSITION_3_to_4] *
              _five_level_energy_difference[element][TRANSITION_3_to_4]);
 
-    cooling += abundances[element] * kb * (cl2 + cl3 + cl4 + cl5);
+    cooling[element] = abundances[element] * kb * (cl2 + cl3 + cl4 + cl5);
   }
 
   /// 2 level atoms
@@ -1840,11 +1893,10 @@ double LineCoolingData::get_cooling(
     const int_fast32_t element = i + offset;
     const double level_population = compute_level_population(
         element, collision_strength_prefactor, temperature, Tinv, logT);
-    cooling += abundances[element] * kb * _two_level_energy_difference[i] *
-               _two_level_transition_probability[i] * level_population;
+    cooling[element] = abundances[element] * kb *
+                       _two_level_energy_difference[i] *
+                       _two_level_transition_probability[i] * level_population;
   }
-
-  return cooling;
 }
 
 /**
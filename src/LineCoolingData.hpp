@@ -241,6 +241,11 @@ private:
                                   const double T, const double Tinv,
                                   const double logT) const;
 
+  void compute_cooling_per_coolant(
+      const double temperature, const double electron_density,
+      const double abundances[LINECOOLINGDATA_NUMELEMENTS],
+      double cooling[LINECOOLINGDATA_NUMELEMENTS]) const;
+
 public:
   LineCoolingData();
 
@@ -257,6 +262,11 @@ public:
   get_cooling(const double temperature, const double electron_density,
               const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const;
 
+  void
+  get_cooling_per_coolant(const double temperature,
+                          const double electron_density,
+                          double cooling[LINECOOLINGDATA_NUMELEMENTS]) const;
+
   std::vector< std::vector< double > > get_line_strengths(
       const double temperature, const double electron_density,
       const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const;
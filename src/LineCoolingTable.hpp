@@ -0,0 +1,518 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file LineCoolingTable.hpp
+ *
+ * @brief Precomputed table of line cooling rates as a function of temperature
+ * and electron density.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef LINECOOLINGTABLE_HPP
+#define LINECOOLINGTABLE_HPP
+
+#include "Error.hpp"
+#include "LineCoolingData.hpp"
+#include "Log.hpp"
+#include "Utilities.hpp"
+
+#include <cfloat>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
+/*! @brief Number of cells for which LineCoolingTable::get_cooling() does the
+ *  table interpolation together. */
+#define LINECOOLINGTABLE_BATCH_SIZE 16
+
+/**
+ * @brief Precomputed table of line cooling rates as a function of temperature
+ * and electron density.
+ *
+ * For every coolant, we tabulate the logarithm of the cooling rate for a unit
+ * abundance (LineCoolingData::get_cooling_per_coolant()) on a regular grid in
+ * log temperature and log electron density, and use bilinear interpolation to
+ * obtain the cooling rate in between. The logarithm of the cooling rate is a
+ * smooth function of both variables, so that a coarse grid suffices.
+ *
+ * The grid is refined (by halving the grid spacing in the temperature and/or
+ * electron density direction) until the relative difference between the
+ * interpolated and the exact cooling rate of every coolant in the middle of
+ * every grid interval and grid cell is below the given tolerance. If this
+ * requires more than the maximum number of points, we abort, since the
+ * interpolated rates would not be error controlled. Values outside the
+ * tabulated range are computed exactly using the underlying LineCoolingData.
+ *
+ * Where the exact cooling rate of a coolant is below a given absolute floor,
+ * the accuracy is measured relative to the floor instead. Without this, rates
+ * that underflow to zero at low temperatures (and are tabulated as DBL_MIN)
+ * would never be considered accurate, so that the grid would always be
+ * refined up to the maximum number of points.
+ */
+class LineCoolingTable {
+private:
+  /*! @brief LineCoolingData used to compute exact cooling rates. */
+  const LineCoolingData &_line_cooling_data;
+
+  /*! @brief Natural logarithm of the minimum tabulated temperature
+   *  (T in K). */
+  const double _minimum_log_temperature;
+
+  /*! @brief Natural logarithm of the maximum tabulated temperature
+   *  (T in K). */
+  const double _maximum_log_temperature;
+
+  /*! @brief Natural logarithm of the minimum tabulated electron density
+   *  (ne in m^-3). */
+  const double _minimum_log_electron_density;
+
+  /*! @brief Natural logarithm of the maximum tabulated electron density
+   *  (ne in m^-3). */
+  const double _maximum_log_electron_density;
+
+  /*! @brief Absolute floor for the cooling rates per unit abundance used in
+   *  the accuracy check (in kg m^2 s^-3). */
+  const double _minimum_cooling;
+
+  /*! @brief Number of temperature points. */
+  uint_fast32_t _number_of_temperatures;
+
+  /*! @brief Number of electron density points. */
+  uint_fast32_t _number_of_electron_densities;
+
+  /*! @brief Inverse step in log temperature. */
+  double _inverse_log_temperature_step;
+
+  /*! @brief Inverse step in log electron density. */
+  double _inverse_log_electron_density_step;
+
+  /*! @brief Natural logarithm of the cooling rate per unit abundance (in
+   *  kg m^2 s^-3), stored as [temperature][electron density][coolant]. */
+  std::vector< double > _log_cooling;
+
+  /**
+   * @brief Get the log temperature corresponding to the given (fractional)
+   * temperature index.
+   *
+   * @param x Fractional temperature index.
+   * @return Temperature (in K).
+   */
+  inline double get_temperature(const double x) const {
+    return std::exp(_minimum_log_temperature +
+                    x / _inverse_log_temperature_step);
+  }
+
+  /**
+   * @brief Get the electron density corresponding to the given (fractional)
+   * electron density index.
+   *
+   * @param y Fractional electron density index.
+   * @return Electron density (in m^-3).
+   */
+  inline double get_electron_density(const double y) const {
+    return std::exp(_minimum_log_electron_density +
+                    y / _inverse_log_electron_density_step);
+  }
+
+  /**
+   * @brief Fill the table for the given number of grid points.
+   *
+   * @param number_of_temperatures Number of temperature points.
+   * @param number_of_electron_densities Number of electron density points.
+   */
+  inline void fill_table(const uint_fast32_t number_of_temperatures,
+                         const uint_fast32_t number_of_electron_densities) {
+
+    _number_of_temperatures = number_of_temperatures;
+    _number_of_electron_densities = number_of_electron_densities;
+    _inverse_log_temperature_step =
+        (number_of_temperatures - 1) /
+        (_maximum_log_temperature - _minimum_log_temperature);
+    _inverse_log_electron_density_step =
+        (number_of_electron_densities - 1) /
+        (_maximum_log_electron_density - _minimum_log_electron_density);
+
+    _log_cooling.resize(number_of_temperatures * number_of_electron_densities *
+                        LINECOOLINGDATA_NUMELEMENTS);
+    for (uint_fast32_t iT = 0; iT < number_of_temperatures; ++iT) {
+      const double T = get_temperature(iT);
+      for (uint_fast32_t ine = 0; ine < number_of_electron_densities; ++ine) {
+        const double ne = get_electron_density(ine);
+        double *log_cooling =
+            &_log_cooling[(iT * number_of_electron_densities + ine) *
+                          LINECOOLINGDATA_NUMELEMENTS];
+        _line_cooling_data.get_cooling_per_coolant(T, ne, log_cooling);
+        for (int_fast32_t i = 0; i < LINECOOLINGDATA_NUMELEMENTS; ++i) {
+          log_cooling[i] = std::log(std::max(log_cooling[i], DBL_MIN));
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Check if the table is accurate enough at the given (fractional)
+   * grid position.
+   *
+   * @param x Fractional temperature index.
+   * @param y Fractional electron density index.
+   * @param tolerance Required relative accuracy.
+   * @return True if the interpolated cooling rates of all coolants are within
+   * the given tolerance of the exact values (or of the cooling rate floor if
+   * the exact value is smaller).
+   */
+  inline bool is_accurate(const double x, const double y,
+                          const double tolerance) const {
+    double exact[LINECOOLINGDATA_NUMELEMENTS];
+    _line_cooling_data.get_cooling_per_coolant(get_temperature(x),
+                                               get_electron_density(y), exact);
+    double interpolated[LINECOOLINGDATA_NUMELEMENTS];
+    interpolate(x, y, interpolated);
+    for (int_fast32_t i = 0; i < LINECOOLINGDATA_NUMELEMENTS; ++i) {
+      if (std::abs(interpolated[i] - exact[i]) >
+          tolerance * std::max(exact[i], _minimum_cooling)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Check the accuracy of the table.
+   *
+   * @param tolerance Required relative accuracy.
+   * @param refine_temperature Set to true if the temperature spacing is too
+   * coarse.
+   * @param refine_electron_density Set to true if the electron density spacing
+   * is too coarse.
+   */
+  inline void check_table(const double tolerance, bool &refine_temperature,
+                          bool &refine_electron_density) const {
+
+    refine_temperature = false;
+    refine_electron_density = false;
+    for (uint_fast32_t iT = 0; iT < _number_of_temperatures; ++iT) {
+      for (uint_fast32_t ine = 0; ine < _number_of_electron_densities; ++ine) {
+        if (iT + 1 < _number_of_temperatures && !refine_temperature &&
+            !is_accurate(iT + 0.5, ine, tolerance)) {
+          refine_temperature = true;
+        }
+        if (ine + 1 < _number_of_electron_densities &&
+            !refine_electron_density &&
+            !is_accurate(iT, ine + 0.5, tolerance)) {
+          refine_electron_density = true;
+        }
+        if (iT + 1 < _number_of_temperatures &&
+            ine + 1 < _number_of_electron_densities &&
+            !(refine_temperature && refine_electron_density) &&
+            !is_accurate(iT + 0.5, ine + 0.5, tolerance)) {
+          refine_temperature = true;
+          refine_electron_density = true;
+        }
+        if (refine_temperature && refine_electron_density) {
+          return;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Get the (fractional) grid position of the given temperature and
+   * electron density.
+   *
+   * @param temperature Temperature (in K).
+   * @param electron_density Electron density (in m^-3).
+   * @param x Variable to store the fractional temperature index in.
+   * @param y Variable to store the fractional electron density index in.
+   * @return True if the position is inside the tabulated range.
+   */
+  inline bool get_position(const double temperature,
+                           const double electron_density, double &x,
+                           double &y) const {
+
+    if (!(temperature > 0. && electron_density > 0.)) {
+      return false;
+    }
+
+    x = (std::log(temperature) - _minimum_log_temperature) *
+        _inverse_log_temperature_step;
+    y = (std::log(electron_density) - _minimum_log_electron_density) *
+        _inverse_log_electron_density_step;
+    return x >= 0. && x <= _number_of_temperatures - 1 && y >= 0. &&
+           y <= _number_of_electron_densities - 1;
+  }
+
+  /**
+   * @brief Interpolate the logarithms of the cooling rates per unit abundance
+   * at the given (fractional) grid position.
+   *
+   * @param x Fractional temperature index.
+   * @param y Fractional electron density index.
+   * @param log_cooling Array to store the natural logarithms of the cooling
+   * rates per unit abundance in (cooling rates in kg m^2 s^-3).
+   */
+  inline void
+  interpolate_log(const double x, const double y,
+                  double log_cooling[LINECOOLINGDATA_NUMELEMENTS]) const {
+
+    const uint_fast32_t iT =
+        std::min< uint_fast32_t >(x, _number_of_temperatures - 2);
+    const uint_fast32_t ine =
+        std::min< uint_fast32_t >(y, _number_of_electron_densities - 2);
+    const double fT = x - iT;
+    const double fne = y - ine;
+    const double *c00 =
+        &_log_cooling[(iT * _number_of_electron_densities + ine) *
+                      LINECOOLINGDATA_NUMELEMENTS];
+    const double *c01 = c00 + LINECOOLINGDATA_NUMELEMENTS;
+    const double *c10 =
+        c00 + _number_of_electron_densities * LINECOOLINGDATA_NUMELEMENTS;
+    const double *c11 = c10 + LINECOOLINGDATA_NUMELEMENTS;
+    for (int_fast32_t i = 0; i < LINECOOLINGDATA_NUMELEMENTS; ++i) {
+      log_cooling[i] = (1. - fT) * ((1. - fne) * c00[i] + fne * c01[i]) +
+                       fT * ((1. - fne) * c10[i] + fne * c11[i]);
+    }
+  }
+
+  /**
+   * @brief Interpolate the cooling rates per unit abundance at the given
+   * (fractional) grid position.
+   *
+   * @param x Fractional temperature index.
+   * @param y Fractional electron density index.
+   * @param cooling Array to store the cooling rates per unit abundance in (in
+   * kg m^2 s^-3).
+   */
+  inline void interpolate(const double x, const double y,
+                          double cooling[LINECOOLINGDATA_NUMELEMENTS]) const {
+
+    interpolate_log(x, y, cooling);
+    for (int_fast32_t i = 0; i < LINECOOLINGDATA_NUMELEMENTS; ++i) {
+      cooling[i] = std::exp(cooling[i]);
+    }
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param line_cooling_data LineCoolingData used to compute exact cooling
+   * rates.
+   * @param minimum_temperature Minimum tabulated temperature (in K).
+   * @param maximum_temperature Maximum tabulated temperature (in K).
+   * @param minimum_electron_density Minimum tabulated electron density (in
+   * m^-3).
+   * @param maximum_electron_density Maximum tabulated electron density (in
+   * m^-3).
+   * @param tolerance Required relative accuracy of the interpolated cooling
+   * rates.
+   * @param maximum_number_of_points Maximum number of points in each
+   * dimension. The code aborts if the requested tolerance cannot be reached
+   * within this number of points.
+   * @param minimum_cooling Absolute floor for the cooling rates per unit
+   * abundance used to check the accuracy of the table (in kg m^2 s^-3).
+   * @param log Log to write logging info to.
+   */
+  inline LineCoolingTable(const LineCoolingData &line_cooling_data,
+                          const double minimum_temperature,
+                          const double maximum_temperature,
+                          const double minimum_electron_density,
+                          const double maximum_electron_density,
+                          const double tolerance,
+                          const uint_fast32_t maximum_number_of_points,
+                          const double minimum_cooling = 1.e-40,
+                          Log *log = nullptr)
+      : _line_cooling_data(line_cooling_data),
+        _minimum_log_temperature(std::log(minimum_temperature)),
+        _maximum_log_temperature(std::log(maximum_temperature)),
+        _minimum_log_electron_density(std::log(minimum_electron_density)),
+        _maximum_log_electron_density(std::log(maximum_electron_density)),
+        _minimum_cooling(minimum_cooling) {
+
+    if (!(minimum_temperature > 0. &&
+          maximum_temperature > minimum_temperature)) {
+      cmac_error("Invalid temperature range for line cooling table: [%g, %g] "
+                 "K!",
+                 minimum_temperature, maximum_temperature);
+    }
+    if (!(minimum_electron_density > 0. &&
+          maximum_electron_density > minimum_electron_density)) {
+      cmac_error("Invalid electron density range for line cooling table: [%g, "
+                 "%g] m^-3!",
+                 minimum_electron_density, maximum_electron_density);
+    }
+    if (maximum_number_of_points < 2) {
+      cmac_error("Line cooling table needs at least 2 points per dimension!");
+    }
+
+    uint_fast32_t number_of_temperatures =
+        std::min< uint_fast32_t >(33, maximum_number_of_points);
+    uint_fast32_t number_of_electron_densities =
+        std::min< uint_fast32_t >(9, maximum_number_of_points);
+    fill_table(number_of_temperatures, number_of_electron_densities);
+    bool refine_temperature, refine_electron_density;
+    check_table(tolerance, refine_temperature, refine_electron_density);
+    while (refine_temperature || refine_electron_density) {
+      const bool can_refine_temperature =
+          refine_temperature &&
+          2 * number_of_temperatures - 1 <= maximum_number_of_points;
+      const bool can_refine_electron_density =
+          refine_electron_density &&
+          2 * number_of_electron_densities - 1 <= maximum_number_of_points;
+      if (!can_refine_temperature && !can_refine_electron_density) {
+        cmac_error("Line cooling table needs more than %" PRIuFAST32
+                   " points per dimension to reach a relative accuracy of "
+                   "%g!",
+                   maximum_number_of_points, tolerance);
+      }
+      if (can_refine_temperature) {
+        number_of_temperatures = 2 * number_of_temperatures - 1;
+      }
+      if (can_refine_electron_density) {
+        number_of_electron_densities = 2 * number_of_electron_densities - 1;
+      }
+      fill_table(number_of_temperatures, number_of_electron_densities);
+      check_table(tolerance, refine_temperature, refine_electron_density);
+    }
+
+    if (log) {
+      log->write_status(
+          "Line cooling table uses ", _number_of_temperatures,
+          " temperatures and ", _number_of_electron_densities,
+          " electron densities (",
+          Utilities::human_readable_bytes(_log_cooling.size() * sizeof(double)),
+          ").");
+    }
+  }
+
+  /**
+   * @brief Get the number of temperature points in the table.
+   *
+   * @return Number of temperature points.
+   */
+  inline uint_fast32_t get_number_of_temperatures() const {
+    return _number_of_temperatures;
+  }
+
+  /**
+   * @brief Get the number of electron density points in the table.
+   *
+   * @return Number of electron density points.
+   */
+  inline uint_fast32_t get_number_of_electron_densities() const {
+    return _number_of_electron_densities;
+  }
+
+  /**
+   * @brief Get the radiative energy losses due to line cooling at the given
+   * temperature, electron density and coolant abundances.
+   *
+   * Drop-in replacement for LineCoolingData::get_cooling().
+   *
+   * @param temperature Temperature (in K).
+   * @param electron_density Electron density (in m^-3).
+   * @param abundances Abundances of coolants.
+   * @return Radiative cooling per hydrogen atom (in kg m^2s^-3).
+   */
+  inline double
+  get_cooling(const double temperature, const double electron_density,
+              const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const {
+
+    double x, y;
+    if (!get_position(temperature, electron_density, x, y)) {
+      return _line_cooling_data.get_cooling(temperature, electron_density,
+                                            abundances);
+    }
+
+    double cooling_per_coolant[LINECOOLINGDATA_NUMELEMENTS];
+    interpolate(x, y, cooling_per_coolant);
+    double cooling = 0.;
+    for (int_fast32_t i = 0; i < LINECOOLINGDATA_NUMELEMENTS; ++i) {
+      cooling += abundances[i] * cooling_per_coolant[i];
+    }
+    return cooling;
+  }
+
+  /**
+   * @brief Get the radiative energy losses due to line cooling for a batch of
+   * cells.
+   *
+   * Gives the same result as calling get_cooling() for every cell separately,
+   * but interpolates the logarithms of the cooling rates of all cells first,
+   * and then exponentiates them in a single loop over all cells and coolants.
+   *
+   * @param number_of_cells Number of cells.
+   * @param temperature Temperature of each cell (in K).
+   * @param electron_density Electron density of each cell (in m^-3).
+   * @param abundances Abundances of coolants in each cell.
+   * @param cooling Array to store the radiative cooling per hydrogen atom of
+   * each cell in (in kg m^2s^-3).
+   */
+  inline void
+  get_cooling(const uint_fast32_t number_of_cells, const double *temperature,
+              const double *electron_density,
+              const double (*abundances)[LINECOOLINGDATA_NUMELEMENTS],
+              double *cooling) const {
+
+    for (uint_fast32_t offset = 0; offset < number_of_cells;
+         offset += LINECOOLINGTABLE_BATCH_SIZE) {
+      const uint_fast32_t batch_size = std::min< uint_fast32_t >(
+          LINECOOLINGTABLE_BATCH_SIZE, number_of_cells - offset);
+
+      bool in_table[LINECOOLINGTABLE_BATCH_SIZE];
+      double cooling_per_coolant[LINECOOLINGTABLE_BATCH_SIZE *
+                                 LINECOOLINGDATA_NUMELEMENTS];
+      for (uint_fast32_t i = 0; i < batch_size; ++i) {
+        double x, y;
+        in_table[i] = get_position(temperature[offset + i],
+                                   electron_density[offset + i], x, y);
+        if (in_table[i]) {
+          interpolate_log(
+              x, y, &cooling_per_coolant[i * LINECOOLINGDATA_NUMELEMENTS]);
+        } else {
+          // the cooling rate of this cell is computed exactly below
+          for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+            cooling_per_coolant[i * LINECOOLINGDATA_NUMELEMENTS + j] = 0.;
+          }
+        }
+      }
+
+      for (uint_fast32_t i = 0; i < batch_size * LINECOOLINGDATA_NUMELEMENTS;
+           ++i) {
+        cooling_per_coolant[i] = std::exp(cooling_per_coolant[i]);
+      }
+
+      for (uint_fast32_t i = 0; i < batch_size; ++i) {
+        const uint_fast32_t icell = offset + i;
+        if (in_table[i]) {
+          cooling[icell] = 0.;
+          for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+            cooling[icell] +=
+                abundances[icell][j] *
+                cooling_per_coolant[i * LINECOOLINGDATA_NUMELEMENTS + j];
+          }
+        } else {
+          cooling[icell] = _line_cooling_data.get_cooling(
+              temperature[icell], electron_density[icell], abundances[icell]);
+        }
+      }
+    }
+  }
+};
+
+#endif // LINECOOLINGTABLE_HPP
@@ -194,6 +194,13 @@ public:
     }
   }
 
+  /**
+   * @brief Is live output enabled?
+   *
+   * @return True if live output is enabled.
+   */
+  inline bool is_enabled() const { return _enabled; }
+
   /**
    * @brief Write output at the current time?
    *
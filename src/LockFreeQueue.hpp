@@ -0,0 +1,211 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file LockFreeQueue.hpp
+ *
+ * @brief Bounded multi-producer multi-consumer lock-free queue of indices.
+ *
+ * The implementation follows the bounded MPMC queue of Dmitry Vyukov: every
+ * slot in the ring has its own sequence number that tells producers and
+ * consumers whether the slot is free, so that a single compare-and-swap on the
+ * global position counter suffices to claim a slot.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef LOCKFREEQUEUE_HPP
+#define LOCKFREEQUEUE_HPP
+
+#include <atomic>
+#include <cinttypes>
+
+/**
+ * @brief Bounded multi-producer multi-consumer lock-free queue of indices.
+ */
+class LockFreeQueue {
+private:
+  /**
+   * @brief Single slot in the ring.
+   */
+  struct Slot {
+    /*! @brief Sequence number of the slot. */
+    std::atomic< size_t > _sequence;
+
+    /*! @brief Value stored in the slot. */
+    size_t _value;
+  };
+
+  /*! @brief Ring of slots. */
+  Slot *_slots;
+
+  /*! @brief Bit mask used to map positions onto the ring (size of the ring
+   *  minus one, the size is a power of 2). */
+  const size_t _mask;
+
+  /*! @brief Position of the next element that will be added. */
+  std::atomic< size_t > _push_position;
+
+  /*! @brief Position of the next element that will be removed. */
+  std::atomic< size_t > _pop_position;
+
+  /**
+   * @brief Get the smallest power of 2 that is larger than or equal to the
+   * given size.
+   *
+   * @param size Requested size.
+   * @return Smallest power of 2 that can hold the requested size.
+   */
+  inline static size_t get_ring_size(const size_t size) {
+    size_t ring_size = 2;
+    while (ring_size < size) {
+      ring_size <<= 1;
+    }
+    return ring_size;
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param size Minimum number of elements the queue should be able to hold.
+   */
+  inline LockFreeQueue(const size_t size)
+      : _mask(get_ring_size(size) - 1), _push_position(0), _pop_position(0) {
+
+    _slots = new Slot[_mask + 1];
+    for (size_t i = 0; i < _mask + 1; ++i) {
+      _slots[i]._sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Destructor.
+   */
+  inline ~LockFreeQueue() { delete[] _slots; }
+
+  /**
+   * @brief Add an element to the end of the queue.
+   *
+   * @param value Element to add.
+   * @return True if the element was added, false if the queue is full.
+   */
+  inline bool push(const size_t value) {
+
+    size_t position = _push_position.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &_slots[position & _mask];
+      const size_t sequence = slot->_sequence.load(std::memory_order_acquire);
+      const intptr_t difference =
+          static_cast< intptr_t >(sequence) - static_cast< intptr_t >(position);
+      if (difference == 0) {
+        if (_push_position.compare_exchange_weak(position, position + 1,
+                                                 std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // the slot is still occupied: either the queue is full, or a consumer
+        // that claimed the slot a full cycle ago has not finished reading it
+        // yet (in which case we wait for it)
+        if (position - _pop_position.load(std::memory_order_relaxed) >=
+            _mask + 1) {
+          return false;
+        }
+        position = _push_position.load(std::memory_order_relaxed);
+      } else {
+        position = _push_position.load(std::memory_order_relaxed);
+      }
+    }
+    slot->_value = value;
+    slot->_sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Remove the element at the front of the queue.
+   *
+   * If another thread has claimed the front slot but is still writing its
+   * element, this function waits for that element rather than reporting an
+   * empty queue, so that a pop that starts after a push has returned never
+   * misses the pushed element.
+   *
+   * @param value Variable to store the removed element in.
+   * @return True if an element was removed, false if the queue was empty.
+   */
+  inline bool pop(size_t &value) {
+
+    size_t position = _pop_position.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &_slots[position & _mask];
+      const size_t sequence = slot->_sequence.load(std::memory_order_acquire);
+      const intptr_t difference = static_cast< intptr_t >(sequence) -
+                                  static_cast< intptr_t >(position + 1);
+      if (difference == 0) {
+        if (_pop_position.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // the slot has not been filled yet. The queue is only empty if no
+        // producer has claimed the slot; if one did, it is still writing its
+        // element and we need to wait for it
+        if (_push_position.load(std::memory_order_relaxed) == position) {
+          return false;
+        }
+        position = _pop_position.load(std::memory_order_relaxed);
+      } else {
+        position = _pop_position.load(std::memory_order_relaxed);
+      }
+    }
+    value = slot->_value;
+    slot->_sequence.store(position + _mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Get the (approximate) number of elements in the queue.
+   *
+   * The value is only exact if no other thread is modifying the queue.
+   *
+   * @return Number of elements in the queue.
+   */
+  inline size_t size() const {
+    const size_t pop_position = _pop_position.load(std::memory_order_relaxed);
+    const size_t push_position = _push_position.load(std::memory_order_relaxed);
+    return (push_position > pop_position) ? push_position - pop_position : 0;
+  }
+
+  /**
+   * @brief Get the maximum number of elements the queue can hold.
+   *
+   * @return Capacity of the queue.
+   */
+  inline size_t capacity() const { return _mask + 1; }
+
+  /**
+   * @brief Get the size in memory of the queue.
+   *
+   * @return Size in memory of the queue (in bytes).
+   */
+  inline size_t get_memory_size() const {
+    return sizeof(LockFreeQueue) + (_mask + 1) * sizeof(Slot);
+  }
+};
+
+#endif // LOCKFREEQUEUE_HPP
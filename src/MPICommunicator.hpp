@@ -102,12 +102,21 @@ public:
 #ifdef HAVE_MPI
     // MPI_Init is known to cause memory leak detections, so we disable the
     // address sanitizer for all allocations made by it
+    // the distributed task-based algorithm communicates from within parallel
+    // regions, but only from one thread at a time
     NO_LEAK_CHECK_BEGIN
-    int_fast32_t status = MPI_Init(&argc, &argv);
+    int provided;
+    int_fast32_t status =
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
     NO_LEAK_CHECK_END
     if (status != MPI_SUCCESS) {
       cmac_error("Failed to initialize MPI!");
     }
+    if (provided < MPI_THREAD_SERIALIZED) {
+      cmac_warning("MPI library does not support MPI calls from multiple "
+                   "threads. Distributed task-based runs should only use a "
+                   "single thread per process!");
+    }
 
     // make sure errors are handled by us, not by the MPI library
     MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
@@ -83,6 +83,10 @@ MaskedPhotonSourceSpectrum::MaskedPhotonSourceSpectrum(
     _cumulative_distribution[i] *= norm_inv;
   }
 
+  // set up the guide table used to sample the cumulative distribution
+  _cumulative_distribution_guide.initialize(_cumulative_distribution.data(),
+                                            number_of_bins);
+
   // apply the mask to the total ionizing flux
   _ionizing_flux =
       norm * unmasked_spectrum->get_total_flux() / number_of_samples;
@@ -124,8 +128,8 @@ double MaskedPhotonSourceSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
   const double x = random_generator.get_uniform_random_double();
-  const uint_fast32_t inu = Utilities::locate(
-      x, _cumulative_distribution.data(), _frequency_bins.size());
+  const uint_fast32_t inu = _cumulative_distribution_guide.locate(
+      x, _cumulative_distribution.data());
   const double frequency =
       _frequency_bins[inu] +
       (_frequency_bins[inu + 1] - _frequency_bins[inu]) *
@@ -26,6 +26,7 @@
 #ifndef MASKEDPHOTONSOURCESPECTRUM_HPP
 #define MASKEDPHOTONSOURCESPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 
 #include <cstdint>
@@ -47,6 +48,9 @@ private:
   /*! @brief Cumulative distribution in each bin. */
   std::vector< double > _cumulative_distribution;
 
+  /*! @brief Guide table used to sample the cumulative distribution function. */
+  GuideTable _cumulative_distribution_guide;
+
   /*! @brief Total ionizing flux of the spectrum (in m^-2 s^-1). */
   double _ionizing_flux;
 
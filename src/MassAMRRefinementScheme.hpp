@@ -41,6 +41,24 @@ private:
   /*! @brief Target number of particles. */
   const double _target_npart;
 
+  /**
+   * @brief Decide whether the cell at the given level, with the given midpoint
+   * and values, should be refined.
+   *
+   * @tparam _cell_iterator_ Cell iterator type.
+   * @param level Depth level of the cell.
+   * @param cell Iterator pointing to a cell (DensityGrid::iterator or
+   * DensitySubGrid::iterator).
+   * @return True if the cell should be split into 8 smaller cells.
+   */
+  template < typename _cell_iterator_ >
+  inline bool refine_cell(uint_fast8_t level, _cell_iterator_ &cell) const {
+
+    return cell.get_volume() *
+               cell.get_ionization_variables().get_number_density() >
+           _target_npart;
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -84,10 +102,20 @@ public:
    * @return True if the cell should be split into 8 smaller cells.
    */
   virtual bool refine(uint_fast8_t level, DensityGrid::iterator &cell) const {
+    return refine_cell(level, cell);
+  }
 
-    return cell.get_volume() *
-               cell.get_ionization_variables().get_number_density() >
-           _target_npart;
+  /**
+   * @brief Decide whether the cell at the given level, with the given midpoint
+   * and values, should be refined.
+   *
+   * @param level Depth level of the cell.
+   * @param cell DensitySubGrid::iterator pointing to a cell.
+   * @return True if the cell should be split into 8 smaller cells.
+   */
+  virtual bool refine(uint_fast8_t level,
+                      DensitySubGrid::iterator &cell) const {
+    return refine_cell(level, cell);
   }
 };
 
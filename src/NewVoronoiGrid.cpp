@@ -152,6 +152,8 @@ NewVoronoiGrid::NewVoronoiGrid(
   // (notice that the first range is closed, while the other range is half open)
   max_anchor -= min_anchor;
   max_anchor *= (1. + DBL_EPSILON);
+  _rescale_anchor = min_anchor;
+  _rescale_sides = max_anchor;
 
   const double box_bottom_anchor_x =
       1. + (box.get_anchor().x() - min_anchor.x()) / max_anchor.x();
@@ -179,10 +181,7 @@ NewVoronoiGrid::NewVoronoiGrid(
   const size_t psize = positions.size();
   _real_rescaled_positions.resize(psize);
   for (size_t i = 0; i < psize; ++i) {
-    const double x = 1. + (positions[i].x() - min_anchor.x()) / max_anchor.x();
-    const double y = 1. + (positions[i].y() - min_anchor.y()) / max_anchor.y();
-    const double z = 1. + (positions[i].z() - min_anchor.z()) / max_anchor.z();
-    _real_rescaled_positions[i] = CoordinateVector<>(x, y, z);
+    _real_rescaled_positions[i] = rescale(positions[i]);
   }
 }
 
@@ -202,13 +201,107 @@ void NewVoronoiGrid::compute_grid(int_fast32_t worksize) {
   const size_t psize = _real_generator_positions.size();
   _cells.resize(psize);
 
+  compute_cells(nullptr, worksize);
+
+  _reference_positions = _real_generator_positions;
+
+  newvoronoigrid_check_volume();
+}
+
+/**
+ * @brief Compute the cells with the given indices.
+ *
+ * @param indices Indices of the cells to compute (nullptr to compute all
+ * cells).
+ * @param worksize Number of shared memory threads to use.
+ */
+void NewVoronoiGrid::compute_cells(const std::vector< uint_fast32_t > *indices,
+                                   int_fast32_t worksize) {
+
   WorkDistributor< NewVoronoiGridConstructionJobMarket,
                    NewVoronoiGridConstructionJob >
       workers(worksize);
-  NewVoronoiGridConstructionJobMarket jobs(*this, 100);
+  NewVoronoiGridConstructionJobMarket jobs(*this, 100, indices);
   workers.do_in_parallel(jobs);
+}
+
+/**
+ * @brief Update the grid after the generator positions have moved.
+ *
+ * The PointLocations are updated in place and only the cells that are
+ * affected by the movement are recomputed: the cells of generators that moved,
+ * and the cells that were neighbours of these generators before or after the
+ * movement. Since Voronoi neighbour relations are symmetric, this covers all
+ * cells that change, so that the result is the same as a full reconstruction.
+ *
+ * @param worksize Number of shared memory threads to use during the update.
+ * @return True, unless the grid was never computed or the number of generators
+ * changed, in which case the grid needs to be reconstructed.
+ */
+bool NewVoronoiGrid::update_grid(int_fast32_t worksize) {
+
+  const size_t psize = _real_generator_positions.size();
+  if (_cells.size() != psize || _reference_positions.size() != psize) {
+    return false;
+  }
+
+  for (size_t i = 0; i < psize; ++i) {
+    _real_rescaled_positions[i] = rescale(_real_generator_positions[i]);
+  }
+  _point_locations.update_positions();
+
+  std::vector< uint_fast32_t > moved;
+  for (size_t i = 0; i < psize; ++i) {
+    if (_real_generator_positions[i] != _reference_positions[i]) {
+      moved.push_back(i);
+    }
+  }
+
+  // first pass: moved cells and their old neighbours
+  std::vector< bool > flagged(psize, false);
+  for (size_t i = 0; i < moved.size(); ++i) {
+    flagged[moved[i]] = true;
+    const std::vector< VoronoiFace > &faces = _cells[moved[i]].get_faces();
+    for (auto faceit = faces.begin(); faceit != faces.end(); ++faceit) {
+      const uint_fast32_t ngb = faceit->get_neighbour();
+      if (is_real_neighbour(ngb)) {
+        flagged[ngb] = true;
+      }
+    }
+  }
+  std::vector< uint_fast32_t > indices;
+  for (size_t i = 0; i < psize; ++i) {
+    if (flagged[i]) {
+      indices.push_back(i);
+    }
+  }
+  if (!indices.empty()) {
+    compute_cells(&indices, worksize);
+  }
+
+  // second pass: new neighbours of the moved cells
+  indices.clear();
+  for (size_t i = 0; i < moved.size(); ++i) {
+    const std::vector< VoronoiFace > &faces = _cells[moved[i]].get_faces();
+    for (auto faceit = faces.begin(); faceit != faces.end(); ++faceit) {
+      const uint_fast32_t ngb = faceit->get_neighbour();
+      if (is_real_neighbour(ngb) && !flagged[ngb]) {
+        flagged[ngb] = true;
+        indices.push_back(ngb);
+      }
+    }
+  }
+  if (!indices.empty()) {
+    compute_cells(&indices, worksize);
+  }
+
+  for (size_t i = 0; i < moved.size(); ++i) {
+    _reference_positions[moved[i]] = _real_generator_positions[moved[i]];
+  }
 
   newvoronoigrid_check_volume();
+
+  return true;
 }
 
 /**
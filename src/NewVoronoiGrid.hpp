@@ -68,9 +68,38 @@ private:
   /*! @brief PointLocations object used to speed up neighbour searching. */
   PointLocations _point_locations;
 
+  /*! @brief Anchor of the range that is mapped to [1,2[ (in m). */
+  CoordinateVector<> _rescale_anchor;
+
+  /*! @brief Side lengths of the range that is mapped to [1,2[ (in m). */
+  CoordinateVector<> _rescale_sides;
+
+  /*! @brief Generator positions during the last update of their cell (in m).
+   *  Used to decide which cells need to be recomputed by update_grid(). */
+  std::vector< CoordinateVector<> > _reference_positions;
+
+  /**
+   * @brief Map the given position to the range [1,2[.
+   *
+   * @param position Position (in m).
+   * @return Rescaled position.
+   */
+  inline CoordinateVector<> rescale(const CoordinateVector<> &position) const {
+    const double x =
+        1. + (position.x() - _rescale_anchor.x()) / _rescale_sides.x();
+    const double y =
+        1. + (position.y() - _rescale_anchor.y()) / _rescale_sides.y();
+    const double z =
+        1. + (position.z() - _rescale_anchor.z()) / _rescale_sides.z();
+    return CoordinateVector<>(x, y, z);
+  }
+
   NewVoronoiCell compute_cell(uint_fast32_t index,
                               NewVoronoiCellConstructor &constructor) const;
 
+  void compute_cells(const std::vector< uint_fast32_t > *indices,
+                     int_fast32_t worksize);
+
   /**
    * @brief Job that constructs part of the Voronoi grid.
    */
@@ -79,6 +108,10 @@ private:
     /*! @brief Reference to the NewVoronoiGrid we are constructing. */
     NewVoronoiGrid &_grid;
 
+    /*! @brief Indices of the cells that need to be constructed (nullptr if
+     *  all cells need to be constructed). */
+    const std::vector< uint_fast32_t > *_indices;
+
     /*! @brief Index of the first cell that this job will construct. */
     uint_fast32_t _first_index;
 
@@ -93,9 +126,14 @@ private:
      * @brief Constructor.
      *
      * @param grid Reference to the NewVoronoiGrid we are constructing.
+     * @param indices Indices of the cells that need to be constructed (nullptr
+     * if all cells need to be constructed). Job ranges refer to positions in
+     * this list.
      */
-    inline NewVoronoiGridConstructionJob(NewVoronoiGrid &grid)
-        : _grid(grid), _first_index(0), _last_index(0) {}
+    inline NewVoronoiGridConstructionJob(
+        NewVoronoiGrid &grid,
+        const std::vector< uint_fast32_t > *indices = nullptr)
+        : _grid(grid), _indices(indices), _first_index(0), _last_index(0) {}
 
     /**
      * @brief Update the cell range that will be constructed during the next run
@@ -124,7 +162,8 @@ private:
      */
     inline void execute() {
       for (uint_fast32_t i = _first_index; i < _last_index; ++i) {
-        _grid._cells[i] = _grid.compute_cell(i, _constructor);
+        const uint_fast32_t index = (_indices != nullptr) ? (*_indices)[i] : i;
+        _grid._cells[index] = _grid.compute_cell(index, _constructor);
       }
     }
 
@@ -144,6 +183,10 @@ private:
     /*! @brief Reference to the NewVoronoiGrid we want to construct. */
     NewVoronoiGrid &_grid;
 
+    /*! @brief Indices of the cells that need to be constructed (nullptr if
+     *  all cells need to be constructed). */
+    const std::vector< uint_fast32_t > *_indices;
+
     /*! @brief Per thread NewVoronoiGridConstructionJob. */
     NewVoronoiGridConstructionJob *_jobs[MAX_NUM_THREADS];
 
@@ -162,10 +205,14 @@ private:
      *
      * @param grid NewVoronoiGrid we want to construct.
      * @param jobsize Number of cell constructed by a single job.
+     * @param indices Indices of the cells that need to be constructed (nullptr
+     * if all cells need to be constructed).
      */
-    inline NewVoronoiGridConstructionJobMarket(NewVoronoiGrid &grid,
-                                               uint_fast32_t jobsize)
-        : _grid(grid), _current_index(0), _jobsize(jobsize) {
+    inline NewVoronoiGridConstructionJobMarket(
+        NewVoronoiGrid &grid, uint_fast32_t jobsize,
+        const std::vector< uint_fast32_t > *indices = nullptr)
+        : _grid(grid), _indices(indices), _current_index(0),
+          _jobsize(jobsize) {
 
       for (uint_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
         _jobs[i] = nullptr;
@@ -191,7 +238,7 @@ private:
      */
     inline void set_worksize(int_fast32_t worksize) {
       for (int_fast32_t i = 0; i < worksize; ++i) {
-        _jobs[i] = new NewVoronoiGridConstructionJob(_grid);
+        _jobs[i] = new NewVoronoiGridConstructionJob(_grid, _indices);
       }
     }
 
@@ -203,7 +250,8 @@ private:
      * NewVoronoiGridConstructionJob.
      */
     inline NewVoronoiGridConstructionJob *get_job(int_fast32_t thread_id) {
-      const uint_fast32_t cellsize = _grid._cells.size();
+      const uint_fast32_t cellsize =
+          (_indices != nullptr) ? _indices->size() : _grid._cells.size();
       if (_current_index == cellsize) {
         return nullptr;
       }
@@ -236,6 +284,7 @@ public:
   /// grid computation methods
 
   virtual void compute_grid(int_fast32_t worksize = -1);
+  virtual bool update_grid(int_fast32_t worksize = -1);
 
   /// cell/grid property access
 
@@ -44,6 +44,33 @@ private:
   /*! @brief Maximum allowed refinement level. */
   const uint_least8_t _max_level;
 
+  /**
+   * @brief Decide if the given cell should be refined or not.
+   *
+   * @tparam _cell_iterator_ Cell iterator type.
+   * @param level Current refinement level of the cell.
+   * @param cell Iterator pointing to a cell (DensityGrid::iterator or
+   * DensitySubGrid::iterator).
+   * @return True if the cell should be refined.
+   */
+  template < typename _cell_iterator_ >
+  inline bool refine_cell(uint_fast8_t level, _cell_iterator_ &cell) const {
+
+#ifdef HAS_OXYGEN
+    const double volume = cell.get_volume();
+    const IonizationVariables &ioniziation_variables =
+        cell.get_ionization_variables();
+    const double On_frac = ioniziation_variables.get_ionic_fraction(ION_O_n);
+    const double Op1_frac = ioniziation_variables.get_ionic_fraction(ION_O_p1);
+    const double nH = ioniziation_variables.get_number_density();
+    return volume * On_frac * Op1_frac * nH > _target_N && level < _max_level;
+#else
+    (void)_max_level;
+    (void)_target_N;
+    return false;
+#endif
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -85,20 +112,19 @@ public:
    * @return True if the cell should be refined.
    */
   virtual bool refine(uint_fast8_t level, DensityGrid::iterator &cell) const {
+    return refine_cell(level, cell);
+  }
 
-#ifdef HAS_OXYGEN
-    const double volume = cell.get_volume();
-    const IonizationVariables &ioniziation_variables =
-        cell.get_ionization_variables();
-    const double On_frac = ioniziation_variables.get_ionic_fraction(ION_O_n);
-    const double Op1_frac = ioniziation_variables.get_ionic_fraction(ION_O_p1);
-    const double nH = ioniziation_variables.get_number_density();
-    return volume * On_frac * Op1_frac * nH > _target_N && level < _max_level;
-#else
-    (void)_max_level;
-    (void)_target_N;
-    return false;
-#endif
+  /**
+   * @brief Decide if the given cell should be refined or not.
+   *
+   * @param level Current refinement level of the cell.
+   * @param cell DensitySubGrid::iterator pointing to a cell.
+   * @return True if the cell should be refined.
+   */
+  virtual bool refine(uint_fast8_t level,
+                      DensitySubGrid::iterator &cell) const {
+    return refine_cell(level, cell);
   }
 };
 
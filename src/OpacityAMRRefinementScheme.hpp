@@ -43,6 +43,31 @@ private:
   /*! @brief Maximum refinement level. */
   const uint_least8_t _max_level;
 
+  /**
+   * @brief Decide if the given cell should be refined or not.
+   *
+   * @tparam _cell_iterator_ Cell iterator type.
+   * @param level Current refinement level of the cell.
+   * @param cell Iterator pointing to a cell (DensityGrid::iterator or
+   * DensitySubGrid::iterator).
+   * @return True if the cell should be refined.
+   */
+  template < typename _cell_iterator_ >
+  inline bool refine_cell(uint_fast8_t level, _cell_iterator_ &cell) const {
+
+    // we assume an ionizing cross section of 1.e-18 cm^2
+    const double xsecH = 1.e-22;
+
+    const IonizationVariables &ioniziation_variables =
+        cell.get_ionization_variables();
+
+    const double opacity = ioniziation_variables.get_number_density() *
+                           ioniziation_variables.get_ionic_fraction(ION_H_n) *
+                           xsecH;
+
+    return opacity > _target_opacity && level < _max_level;
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -88,18 +113,19 @@ public:
    * @return True if the cell should be refined.
    */
   virtual bool refine(uint_fast8_t level, DensityGrid::iterator &cell) const {
+    return refine_cell(level, cell);
+  }
 
-    // we assume an ionizing cross section of 1.e-18 cm^2
-    const double xsecH = 1.e-22;
-
-    const IonizationVariables &ioniziation_variables =
-        cell.get_ionization_variables();
-
-    const double opacity = ioniziation_variables.get_number_density() *
-                           ioniziation_variables.get_ionic_fraction(ION_H_n) *
-                           xsecH;
-
-    return opacity > _target_opacity && level < _max_level;
+  /**
+   * @brief Decide if the given cell should be refined or not.
+   *
+   * @param level Current refinement level of the cell.
+   * @param cell DensitySubGrid::iterator pointing to a cell.
+   * @return True if the cell should be refined.
+   */
+  virtual bool refine(uint_fast8_t level,
+                      DensitySubGrid::iterator &cell) const {
+    return refine_cell(level, cell);
   }
 };
 
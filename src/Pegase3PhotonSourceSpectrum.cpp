@@ -238,6 +238,10 @@ Pegase3PhotonSourceSpectrum::Pegase3PhotonSourceSpectrum(
         _cumulative_distribution[PEGASE3PHOTONSOURCESPECTRUM_NUMFREQ - 1];
   }
 
+  // set up the guide table used to sample the cumulative distribution
+  _cumulative_distribution_guide.initialize(
+      _cumulative_distribution.data(), PEGASE3PHOTONSOURCESPECTRUM_NUMFREQ);
+
   if (log) {
     log->write_status(
         "Constructed Pegase3PhotonSourceSpectrum with total ionizing flux ",
@@ -279,8 +283,8 @@ double Pegase3PhotonSourceSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
   const double x = random_generator.get_uniform_random_double();
-  const uint_fast32_t inu = Utilities::locate(
-      x, _cumulative_distribution.data(), PEGASE3PHOTONSOURCESPECTRUM_NUMFREQ);
+  const uint_fast32_t inu = _cumulative_distribution_guide.locate(
+      x, _cumulative_distribution.data());
   const double frequency =
       _frequencies[inu] +
       (_frequencies[inu + 1] - _frequencies[inu]) *
@@ -31,6 +31,7 @@
 #include "AtomicValue.hpp"
 #include "Configuration.hpp"
 #include "Error.hpp"
+#include "MPITypes.hpp"
 #include "PhotonPacket.hpp"
 #include "ThreadLock.hpp"
 
@@ -80,8 +81,10 @@ public:
    */
   inline void pack(char buffer[PHOTONBUFFER_MPI_SIZE]) {
     int buffer_position = 0;
-    MPI_Pack(&_subgrid_index, 1, MPI_UNSIGNED, buffer, PHOTONBUFFER_MPI_SIZE,
-             &buffer_position, MPI_COMM_WORLD);
+    // subgrid indices always fit in 32 bits, but _subgrid_index is a size_t
+    const uint_least32_t subgrid_index = _subgrid_index;
+    MPI_Pack(&subgrid_index, 1, MPI_UINT_LEAST32_T, buffer,
+             PHOTONBUFFER_MPI_SIZE, &buffer_position, MPI_COMM_WORLD);
     MPI_Pack(&_direction, 1, MPI_INT, buffer, PHOTONBUFFER_MPI_SIZE,
              &buffer_position, MPI_COMM_WORLD);
     MPI_Pack(&_actual_size, 1, MPI_UNSIGNED, buffer, PHOTONBUFFER_MPI_SIZE,
@@ -101,8 +104,10 @@ public:
    */
   inline void unpack(char buffer[PHOTONBUFFER_MPI_SIZE]) {
     int buffer_position = 0;
-    MPI_Unpack(buffer, PHOTONBUFFER_MPI_SIZE, &buffer_position, &_subgrid_index,
-               1, MPI_UNSIGNED, MPI_COMM_WORLD);
+    uint_least32_t subgrid_index;
+    MPI_Unpack(buffer, PHOTONBUFFER_MPI_SIZE, &buffer_position, &subgrid_index,
+               1, MPI_UINT_LEAST32_T, MPI_COMM_WORLD);
+    _subgrid_index = subgrid_index;
     MPI_Unpack(buffer, PHOTONBUFFER_MPI_SIZE, &buffer_position, &_direction, 1,
                MPI_INT, MPI_COMM_WORLD);
     MPI_Unpack(buffer, PHOTONBUFFER_MPI_SIZE, &buffer_position, &_actual_size,
@@ -0,0 +1,272 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file PhotonBufferCommunicator.hpp
+ *
+ * @brief Class responsible for shipping photon buffers between the MPI
+ * processes of a distributed task-based simulation.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef PHOTONBUFFERCOMMUNICATOR_HPP
+#define PHOTONBUFFERCOMMUNICATOR_HPP
+
+#include "AtomicValue.hpp"
+#include "DensitySubGridCreator.hpp"
+#include "MPITypes.hpp"
+#include "MemorySpace.hpp"
+#include "Task.hpp"
+#include "TaskQueue.hpp"
+#include "ThreadLock.hpp"
+
+#include <vector>
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+/*! @brief MPI tag used for photon buffer messages. */
+#define PHOTONBUFFERCOMMUNICATOR_TAG 20100
+
+/**
+ * @brief Class responsible for shipping photon buffers between the MPI
+ * processes of a distributed task-based simulation.
+ *
+ * Photon buffers that are destined for a subgrid owned by another process are
+ * packed and sent asynchronously. Incoming buffers are turned into photon
+ * traversal tasks for the corresponding local subgrid.
+ *
+ * The photon propagation step is finished when the number of photon packets
+ * that were terminated, summed over all processes, equals the total number of
+ * photon packets that was emitted. Photon packets that are in transit have not
+ * been terminated, so this condition can only be met if no photon buffers are
+ * left anywhere. The sum is computed using a sequence of non-blocking
+ * reductions, so that all processes see the same sums in the same order and
+ * stop after the same reduction.
+ *
+ * All MPI calls are protected by a single lock, so that only one thread at a
+ * time communicates (MPI_THREAD_SERIALIZED).
+ */
+template < typename _subgrid_type_ > class PhotonBufferCommunicator {
+private:
+  /*! @brief Photon buffer array. */
+  MemorySpace &_buffers;
+
+  /*! @brief Grid creator. */
+  DensitySubGridCreator< _subgrid_type_ > &_grid_creator;
+
+  /*! @brief Task space. */
+  ThreadSafeVector< Task > &_tasks;
+
+  /*! @brief Queues per thread. */
+  std::vector< TaskQueue * > &_queues;
+
+  /*! @brief Total number of photon packets emitted by all processes. */
+  const uint_fast64_t _total_number_of_photons;
+
+  /*! @brief Lock that serialises all MPI calls. */
+  ThreadLock _lock;
+
+  /*! @brief Flag signalling that all processes are done. */
+  AtomicValue< bool > _finished;
+
+#ifdef HAVE_MPI
+  /*! @brief Outgoing MPI communication buffers. */
+  std::vector< char * > _send_buffers;
+
+  /*! @brief Requests for the outgoing messages. */
+  std::vector< MPI_Request > _send_requests;
+
+  /*! @brief Incoming MPI communication buffer. */
+  char _receive_buffer[PHOTONBUFFER_MPI_SIZE];
+
+  /*! @brief Request for the active termination reduction. */
+  MPI_Request _termination_request;
+
+  /*! @brief Local number of terminated photon packets contributed to the
+   *  active termination reduction. */
+  uint_least64_t _local_number_done;
+
+  /*! @brief Global number of terminated photon packets computed by the
+   *  active termination reduction. */
+  uint_least64_t _global_number_done;
+#endif
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param buffers Photon buffer array.
+   * @param grid_creator Grid creator.
+   * @param tasks Task space.
+   * @param queues Queues per thread.
+   * @param total_number_of_photons Total number of photon packets emitted by
+   * all processes during this propagation step.
+   */
+  inline PhotonBufferCommunicator(
+      MemorySpace &buffers,
+      DensitySubGridCreator< _subgrid_type_ > &grid_creator,
+      ThreadSafeVector< Task > &tasks, std::vector< TaskQueue * > &queues,
+      const uint_fast64_t total_number_of_photons)
+      : _buffers(buffers), _grid_creator(grid_creator), _tasks(tasks),
+        _queues(queues), _total_number_of_photons(total_number_of_photons),
+        _finished(false) {
+
+#ifdef HAVE_MPI
+    // a NULL request is always complete, so that the first call to
+    // communicate() starts the first reduction
+    _termination_request = MPI_REQUEST_NULL;
+    _local_number_done = 0;
+    _global_number_done = 0;
+#else
+    cmac_error("Distributed photon propagation requires MPI!");
+#endif
+  }
+
+  /**
+   * @brief Destructor.
+   *
+   * Waits for all outgoing messages to complete.
+   */
+  inline ~PhotonBufferCommunicator() {
+#ifdef HAVE_MPI
+    if (!_send_requests.empty()) {
+      MPI_Waitall(_send_requests.size(), &_send_requests[0],
+                  MPI_STATUSES_IGNORE);
+    }
+    for (size_t i = 0; i < _send_buffers.size(); ++i) {
+      delete[] _send_buffers[i];
+    }
+#endif
+  }
+
+  /**
+   * @brief Send the photon buffer with the given index to the process that
+   * owns its subgrid.
+   *
+   * The buffer is freed after it has been packed.
+   *
+   * @param buffer_index Index of a non-empty photon buffer.
+   */
+  inline void send(const size_t buffer_index) {
+
+#ifdef HAVE_MPI
+    PhotonBuffer &buffer = _buffers[buffer_index];
+    cmac_assert_message(buffer.size() > 0, "Sending empty photon buffer!");
+    const int_fast32_t rank =
+        _grid_creator.get_rank(buffer.get_subgrid_index());
+
+    _lock.lock();
+    // look for a send buffer whose previous message was delivered
+    size_t slot = _send_requests.size();
+    for (size_t i = 0; i < _send_requests.size(); ++i) {
+      int flag = 1;
+      if (_send_requests[i] != MPI_REQUEST_NULL) {
+        MPI_Test(&_send_requests[i], &flag, MPI_STATUS_IGNORE);
+      }
+      if (flag) {
+        slot = i;
+        break;
+      }
+    }
+    if (slot == _send_requests.size()) {
+      _send_buffers.push_back(new char[PHOTONBUFFER_MPI_SIZE]);
+      _send_requests.push_back(MPI_REQUEST_NULL);
+    }
+    buffer.pack(_send_buffers[slot]);
+    MPI_Isend(_send_buffers[slot], PHOTONBUFFER_MPI_SIZE, MPI_PACKED, rank,
+              PHOTONBUFFERCOMMUNICATOR_TAG, MPI_COMM_WORLD,
+              &_send_requests[slot]);
+    _lock.unlock();
+#endif
+
+    _buffers.free_buffer(buffer_index);
+  }
+
+  /**
+   * @brief Receive incoming photon buffers and advance the termination
+   * detection.
+   *
+   * Received buffers are added as photon traversal tasks to the queue of the
+   * thread that owns the target subgrid. This function returns immediately if
+   * another thread is already communicating.
+   *
+   * @param num_photon_done Number of photon packets terminated on this
+   * process.
+   */
+  inline void communicate(const AtomicValue< uint_fast32_t > &num_photon_done) {
+
+    if (_finished.value() || !_lock.try_lock()) {
+      return;
+    }
+
+#ifdef HAVE_MPI
+    int flag;
+    MPI_Status status;
+    MPI_Iprobe(MPI_ANY_SOURCE, PHOTONBUFFERCOMMUNICATOR_TAG, MPI_COMM_WORLD,
+               &flag, &status);
+    while (flag) {
+      MPI_Recv(_receive_buffer, PHOTONBUFFER_MPI_SIZE, MPI_PACKED,
+               status.MPI_SOURCE, PHOTONBUFFERCOMMUNICATOR_TAG, MPI_COMM_WORLD,
+               MPI_STATUS_IGNORE);
+      const size_t buffer_index = _buffers.get_free_buffer();
+      PhotonBuffer &buffer = _buffers[buffer_index];
+      buffer.unpack(_receive_buffer);
+
+      const size_t subgrid_index = buffer.get_subgrid_index();
+      cmac_assert_message(_grid_creator.is_local(subgrid_index),
+                          "Received photon buffer for non-local subgrid!");
+      _subgrid_type_ &subgrid = *_grid_creator.get_subgrid(subgrid_index);
+      const size_t task_index = _tasks.get_free_element();
+      Task &task = _tasks[task_index];
+      task.set_subgrid(subgrid_index);
+      task.set_buffer(buffer_index);
+      task.set_type(TASKTYPE_PHOTON_TRAVERSAL);
+      task.set_dependency(subgrid.get_dependency());
+      _queues[subgrid.get_owning_thread()]->add_task(task_index);
+
+      MPI_Iprobe(MPI_ANY_SOURCE, PHOTONBUFFERCOMMUNICATOR_TAG, MPI_COMM_WORLD,
+                 &flag, &status);
+    }
+
+    MPI_Test(&_termination_request, &flag, MPI_STATUS_IGNORE);
+    if (flag) {
+      if (_global_number_done == _total_number_of_photons) {
+        _finished.set(true);
+      } else {
+        _local_number_done = num_photon_done.value();
+        MPI_Iallreduce(&_local_number_done, &_global_number_done, 1,
+                       MPI_UINT_LEAST64_T, MPI_SUM, MPI_COMM_WORLD,
+                       &_termination_request);
+      }
+    }
+#endif
+
+    _lock.unlock();
+  }
+
+  /**
+   * @brief Check if all processes finished the photon propagation step.
+   *
+   * @return True if all photon packets on all processes have been terminated.
+   */
+  inline bool is_finished() const { return _finished.value(); }
+};
+
+#endif // PHOTONBUFFERCOMMUNICATOR_HPP
@@ -27,7 +27,7 @@
 #define PHOTONPACKET_HPP
 
 /*! @brief Size of the MPI buffer necessary to store a single Photon. */
-#define PHOTON_MPI_SIZE ((9 + NUMBER_OF_IONNAMES) * sizeof(double))
+#define PHOTON_MPI_SIZE ((10 + NUMBER_OF_IONNAMES) * sizeof(double))
 
 #include "Configuration.hpp"
 #include "CoordinateVector.hpp"
@@ -70,6 +70,9 @@ private:
   /*! @brief Tracer for the number of scatterings the photon experiences */
   uint_fast32_t _scatter_counter;
 
+  /*! @brief Index of the random number stream used by the photon packet. */
+  uint64_t _stream_index;
+
 public:
 #ifdef HAVE_MPI
   /**
@@ -93,6 +96,8 @@ public:
              MPI_COMM_WORLD);
     MPI_Pack(&_weight, 1, MPI_DOUBLE, buffer, PHOTON_MPI_SIZE, &buffer_position,
              MPI_COMM_WORLD);
+    MPI_Pack(&_stream_index, 1, MPI_UINT64_T, buffer, PHOTON_MPI_SIZE,
+             &buffer_position, MPI_COMM_WORLD);
   }
 
   /**
@@ -124,6 +129,8 @@ public:
                MPI_DOUBLE, MPI_COMM_WORLD);
     MPI_Unpack(buffer, PHOTON_MPI_SIZE, &buffer_position, &_weight, 1,
                MPI_DOUBLE, MPI_COMM_WORLD);
+    MPI_Unpack(buffer, PHOTON_MPI_SIZE, &buffer_position, &_stream_index, 1,
+               MPI_UINT64_T, MPI_COMM_WORLD);
   }
 #endif
 
@@ -155,6 +162,8 @@ public:
     }
     cmac_assert_message(_energy == other._energy, "Energies do not match!");
     cmac_assert_message(_weight == other._weight, "Weights do not match!");
+    cmac_assert_message(_stream_index == other._stream_index,
+                        "Stream indices do not match!");
   }
 
   /**
@@ -301,6 +310,24 @@ public:
   inline void set_scatter_counter(uint_fast32_t scatter_counter) {
     _scatter_counter = scatter_counter;
   }
+
+  /**
+   * @brief Get the index of the random number stream used by the photon
+   * packet.
+   *
+   * @return Stream index (see RandomGenerator::set_stream()).
+   */
+  inline uint_fast64_t get_stream_index() const { return _stream_index; }
+
+  /**
+   * @brief Set the index of the random number stream used by the photon
+   * packet.
+   *
+   * @param stream_index Stream index (see RandomGenerator::set_stream()).
+   */
+  inline void set_stream_index(const uint_fast64_t stream_index) {
+    _stream_index = stream_index;
+  }
 };
 
 #endif // PHOTONPACKET_HPP
@@ -68,6 +68,9 @@ private:
   /*! @brief Number of photon packets that has been terminated. */
   AtomicValue< uint_fast32_t > &_num_photon_done;
 
+  /*! @brief Iteration number, used to select random number streams. */
+  const uint_fast32_t _iteration;
+
 public:
   /**
    * @brief Constructor.
@@ -80,6 +83,7 @@ public:
    * @param grid_creator Grid creator.
    * @param tasks Task space.
    * @param num_photon_done Number of photon packets that has been terminated.
+   * @param iteration Iteration number, used to select random number streams.
    */
   inline PhotonReemitTaskContext(
       MemorySpace &buffers, std::vector< RandomGenerator > &random_generators,
@@ -87,11 +91,13 @@ public:
       const Abundances &abundances, const CrossSections &cross_sections,
       DensitySubGridCreator< _subgrid_type_ > &grid_creator,
       ThreadSafeVector< Task > &tasks,
-      AtomicValue< uint_fast32_t > &num_photon_done)
+      AtomicValue< uint_fast32_t > &num_photon_done,
+      const uint_fast32_t iteration = 0)
       : _buffers(buffers), _random_generators(random_generators),
         _reemission_handler(reemission_handler), _abundances(abundances),
         _cross_sections(cross_sections), _grid_creator(grid_creator),
-        _tasks(tasks), _num_photon_done(num_photon_done) {}
+        _tasks(tasks), _num_photon_done(num_photon_done),
+        _iteration(iteration) {}
 
   /**
    * @brief Execute a photon reemission task.
@@ -133,6 +139,11 @@ public:
 #else
       const double AHe = 0.;
 #endif
+      // every reemission event uses its own part of the random number stream
+      // of the photon packet (only has an effect for counter-based generators)
+      const uint_fast64_t stream_index = old_photon.get_stream_index();
+      _random_generators[thread_id].set_stream(
+          _iteration, stream_index, old_photon.get_scatter_counter() + 1);
       PhotonType new_type;
       const double new_frequency =
           _reemission_handler.reemit(old_photon, AHe, ionization_variables,
@@ -141,6 +152,7 @@ public:
         PhotonPacket &new_photon = buffer[index];
         new_photon.set_type(new_type);
         new_photon.set_scatter_counter(old_photon.get_scatter_counter() + 1);
+        new_photon.set_stream_index(stream_index);
         new_photon.set_position(old_photon.get_position());
         new_photon.set_weight(old_photon.get_weight());
 
@@ -32,6 +32,7 @@
 #include "DensitySubGridCreator.hpp"
 #include "DiffuseReemissionHandler.hpp"
 #include "MemorySpace.hpp"
+#include "PhotonBufferCommunicator.hpp"
 #include "PhotonPacketStatistics.hpp"
 #include "PhotonSourceSpectrum.hpp"
 #include "PhotonTraversalThreadContext.hpp"
@@ -64,6 +65,19 @@ private:
   /*! @brief Whether or not to store absorbed photon packets for reemission. */
   const bool _do_reemission;
 
+  /*! @brief Whether or not to traverse the photon packets in a buffer in
+   *  batches (see DensitySubGrid::interact_batch()). */
+  const bool _batch_traversal;
+
+  /*! @brief Whether or not to run the batch traversal in verification mode,
+   *  which produces results that are bit-compatible with the scalar
+   *  traversal. */
+  const bool _verify_batch_traversal;
+
+  /*! @brief Communicator used to ship photon buffers to subgrids owned by
+   *  other MPI processes (can be a nullptr if the grid is not distributed). */
+  PhotonBufferCommunicator< _subgrid_type_ > *_communicator;
+
 public:
   /**
    * @brief Constructor.
@@ -75,16 +89,27 @@ public:
    * @param statistics Statistical information about photon packets.
    * @param do_reemission Whether or not to store absorbed photon packets for
    * reemission.
+   * @param batch_traversal Whether or not to traverse the photon packets in a
+   * buffer in batches.
+   * @param verify_batch_traversal Whether or not to run the batch traversal in
+   * verification mode.
+   * @param communicator Communicator used to ship photon buffers to subgrids
+   * owned by other MPI processes (only required if the grid is distributed).
    */
   inline PhotonTraversalTaskContext(
       MemorySpace &buffers,
       DensitySubGridCreator< _subgrid_type_ > &grid_creator,
       ThreadSafeVector< Task > &tasks,
       AtomicValue< uint_fast32_t > &num_photon_done,
-      PhotonPacketStatistics *statistics, const bool do_reemission)
+      PhotonPacketStatistics *statistics, const bool do_reemission,
+      const bool batch_traversal = false,
+      const bool verify_batch_traversal = false,
+      PhotonBufferCommunicator< _subgrid_type_ > *communicator = nullptr)
       : _buffers(buffers), _grid_creator(grid_creator), _tasks(tasks),
         _num_photon_done(num_photon_done), _statistics(statistics),
-        _do_reemission(do_reemission) {}
+        _do_reemission(do_reemission), _batch_traversal(batch_traversal),
+        _verify_batch_traversal(verify_batch_traversal),
+        _communicator(communicator) {}
 
   /**
    * @brief Execute a photon traversal task.
@@ -122,8 +147,16 @@ public:
     // keep track of the original number of photons
     uint_fast32_t num_photon_done_now = photon_buffer.size();
 
+    // in batch mode, traverse all photons at once
+    int_fast32_t results[PHOTONBUFFER_SIZE];
+    if (_batch_traversal && photon_buffer.size() > 0) {
+      this_grid.interact_batch(&photon_buffer[0], photon_buffer.size(),
+                               photon_buffer.get_direction(), results,
+                               _verify_batch_traversal);
+    }
+
     // now loop over the input buffer photons and traverse them one by
-    // one
+    // one (if that was not done yet)
     for (uint_fast32_t i = 0; i < photon_buffer.size(); ++i) {
 
       // active photon
@@ -136,8 +169,10 @@ public:
                           "size: %" PRIuFAST32, photon_buffer.size());
 
       // traverse the photon through the active subgrid
-      const int_fast32_t result =
-          this_grid.interact(photon, photon_buffer.get_direction());
+      if (!_batch_traversal) {
+        results[i] = this_grid.interact(photon, photon_buffer.get_direction());
+      }
+      const int_fast32_t result = results[i];
 
       // check that the photon ended up in a valid output buffer
       cmac_assert_message(result >= 0 && result < TRAVELDIRECTION_NUMBER,
@@ -212,7 +247,11 @@ public:
           // internal buffer were absorbed and could be reemitted,
           // photon packets in the other buffers left the subgrid and
           // need to be traversed in the neighbouring subgrid
-          if (i > 0) {
+          if (i > 0 && !_grid_creator.is_local(ngb)) {
+            // the neighbouring subgrid lives on another process: ship the
+            // photon packets to that process
+            _communicator->send(new_index);
+          } else if (i > 0) {
             DensitySubGrid &subgrid = *_grid_creator.get_subgrid(
                 _buffers[new_index].get_subgrid_index());
             const size_t task_index = _tasks.get_free_element();
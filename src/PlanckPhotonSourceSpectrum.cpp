@@ -102,6 +102,10 @@ PlanckPhotonSourceSpectrum::PlanckPhotonSourceSpectrum(double temperature,
     _log_frequency[i] = std::log10(frequency[i]);
   }
 
+  // set up the guide table used to sample the cumulative distribution
+  _cumulative_distribution_guide.initialize(_cumulative_distribution.data(),
+                                            PLANCKPHOTONSOURCESPECTRUM_NUMFREQ);
+
   if (log) {
     log->write_status("Set up a Planck black body spectrum with temperature ",
                       temperature, " K.");
@@ -150,8 +154,8 @@ double PlanckPhotonSourceSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
   double x = random_generator.get_uniform_random_double();
 
-  uint_fast32_t ix = Utilities::locate(x, _cumulative_distribution.data(),
-                                       PLANCKPHOTONSOURCESPECTRUM_NUMFREQ);
+  uint_fast32_t ix = _cumulative_distribution_guide.locate(
+      x, _cumulative_distribution.data());
   double log_random_frequency =
       (std::log10(x) - _log_cumulative_distribution[ix]) /
           (_log_cumulative_distribution[ix + 1] -
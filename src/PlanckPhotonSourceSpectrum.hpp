@@ -27,6 +27,7 @@
 #ifndef PLANCKPHOTONSOURCESPECTRUM_HPP
 #define PLANCKPHOTONSOURCESPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 
 #include <string>
@@ -56,6 +57,9 @@ private:
   /*! @brief Cumulative distribution in each bin. */
   std::vector< double > _cumulative_distribution;
 
+  /*! @brief Guide table used to sample the cumulative distribution function. */
+  GuideTable _cumulative_distribution_guide;
+
   /*! @brief Base 10 logarithm of the cumulative distribution in each bin. */
   std::vector< double > _log_cumulative_distribution;
 
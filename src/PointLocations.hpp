@@ -52,6 +52,9 @@ private:
   /*! @brief Side lengths of a single cell of the grid (in m). */
   CoordinateVector<> _grid_cell_sides;
 
+  /*! @brief Side lengths of the entire grid (in m). */
+  CoordinateVector<> _grid_sides;
+
   /*! @brief Reference to the underlying positions. */
   const std::vector< CoordinateVector<> > &_positions;
 
@@ -103,6 +106,7 @@ public:
     // set up the geometrical quantities
     _grid_anchor = minpos;
     _grid_cell_sides = maxpos / ncell_1D;
+    _grid_sides = maxpos;
 
     // set up the positions grid
     _grid.resize(ncell_1D);
@@ -116,22 +120,66 @@ public:
     // add the positions to the positions grid
     _cell_map.resize(positions_size);
     for (uint_fast32_t i = 0; i < positions_size; ++i) {
-      cmac_assert(positions[i].x() >= minpos.x() &&
-                  positions[i].x() <= maxpos.x());
-      cmac_assert(positions[i].y() >= minpos.y() &&
-                  positions[i].y() <= maxpos.y());
-      cmac_assert(positions[i].z() >= minpos.z() &&
-                  positions[i].z() <= maxpos.z());
-      const uint_fast32_t ix =
-          (positions[i].x() - minpos.x()) / maxpos.x() * ncell_1D;
-      const uint_fast32_t iy =
-          (positions[i].y() - minpos.y()) / maxpos.y() * ncell_1D;
-      const uint_fast32_t iz =
-          (positions[i].z() - minpos.z()) / maxpos.z() * ncell_1D;
-      _grid[ix][iy][iz].push_back(i);
-      _cell_map[i] =
-          std::tuple< uint_least32_t, uint_least32_t, uint_least32_t >(ix, iy,
-                                                                       iz);
+      _cell_map[i] = get_grid_cell(positions[i]);
+      _grid[std::get< 0 >(_cell_map[i])][std::get< 1 >(_cell_map[i])]
+           [std::get< 2 >(_cell_map[i])]
+               .push_back(i);
+    }
+  }
+
+  /**
+   * @brief Get the indices of the grid cell that contains the given position.
+   *
+   * @param position Position (in m).
+   * @return Indices of the grid cell containing that position.
+   */
+  inline std::tuple< uint_least32_t, uint_least32_t, uint_least32_t >
+  get_grid_cell(const CoordinateVector<> &position) const {
+    cmac_assert(position.x() >= _grid_anchor.x() &&
+                position.x() <= _grid_anchor.x() + _grid_sides.x());
+    cmac_assert(position.y() >= _grid_anchor.y() &&
+                position.y() <= _grid_anchor.y() + _grid_sides.y());
+    cmac_assert(position.z() >= _grid_anchor.z() &&
+                position.z() <= _grid_anchor.z() + _grid_sides.z());
+    const uint_fast32_t ncell_1D = _grid.size();
+    const uint_fast32_t ix =
+        (position.x() - _grid_anchor.x()) / _grid_sides.x() * ncell_1D;
+    const uint_fast32_t iy =
+        (position.y() - _grid_anchor.y()) / _grid_sides.y() * ncell_1D;
+    const uint_fast32_t iz =
+        (position.z() - _grid_anchor.z()) / _grid_sides.z() * ncell_1D;
+    return std::tuple< uint_least32_t, uint_least32_t, uint_least32_t >(
+        ix, iy, iz);
+  }
+
+  /**
+   * @brief Update the grid after the underlying positions have moved.
+   *
+   * Only positions that moved to a different grid cell are moved; the grid
+   * geometry and the memory allocated for the grid cells are reused. The
+   * positions need to stay within the range of the original grid.
+   */
+  inline void update_positions() {
+    const uint_fast32_t positions_size = _positions.size();
+    for (uint_fast32_t i = 0; i < positions_size; ++i) {
+      const std::tuple< uint_least32_t, uint_least32_t, uint_least32_t >
+          new_cell = get_grid_cell(_positions[i]);
+      if (new_cell != _cell_map[i]) {
+        std::vector< uint_least32_t > &old_list =
+            _grid[std::get< 0 >(_cell_map[i])][std::get< 1 >(_cell_map[i])]
+                 [std::get< 2 >(_cell_map[i])];
+        for (size_t j = 0; j < old_list.size(); ++j) {
+          if (old_list[j] == i) {
+            old_list[j] = old_list.back();
+            old_list.pop_back();
+            break;
+          }
+        }
+        _grid[std::get< 0 >(new_cell)][std::get< 1 >(new_cell)]
+             [std::get< 2 >(new_cell)]
+                 .push_back(i);
+        _cell_map[i] = new_cell;
+      }
     }
   }
 
@@ -28,6 +28,7 @@
 
 #include "DensitySubGridCreator.hpp"
 #include "MemorySpace.hpp"
+#include "PhotonBufferCommunicator.hpp"
 #include "Task.hpp"
 #include "TaskQueue.hpp"
 
@@ -51,6 +52,10 @@ private:
   /*! @brief General shared queue. */
   TaskQueue &_shared_queue;
 
+  /*! @brief Communicator used to ship photon buffers to subgrids owned by
+   *  other MPI processes (can be a nullptr if the grid is not distributed). */
+  PhotonBufferCommunicator< _subgrid_type_ > *_communicator;
+
 public:
   /**
    * @brief Constructor.
@@ -60,14 +65,18 @@ public:
    * @param tasks Task space.
    * @param queues Thread queues.
    * @param shared_queue Shared queue.
+   * @param communicator Communicator used to ship photon buffers to subgrids
+   * owned by other MPI processes (only required if the grid is distributed).
    */
   inline PrematureLaunchTaskContext(
       MemorySpace &buffers,
       DensitySubGridCreator< _subgrid_type_ > &grid_creator,
       ThreadSafeVector< Task > &tasks, std::vector< TaskQueue * > &queues,
-      TaskQueue &shared_queue)
+      TaskQueue &shared_queue,
+      PhotonBufferCommunicator< _subgrid_type_ > *communicator = nullptr)
       : _buffers(buffers), _grid_creator(grid_creator), _tasks(tasks),
-        _queues(queues), _shared_queue(shared_queue) {}
+        _queues(queues), _shared_queue(shared_queue),
+        _communicator(communicator) {}
 
   /**
    * @brief Execute a premature launch task.
@@ -79,6 +88,9 @@ public:
       threshold_size >>= 1;
       for (auto gridit = _grid_creator.begin();
            gridit != _grid_creator.all_end(); ++gridit) {
+        if (!_grid_creator.is_local(gridit.get_index())) {
+          continue;
+        }
         DensitySubGrid &this_subgrid = *gridit;
         if (this_subgrid.get_largest_buffer_size() > threshold_size &&
             this_subgrid.get_dependency()->try_lock()) {
@@ -91,24 +103,32 @@ public:
                 this_subgrid.get_active_buffer(largest_index);
             this_subgrid.set_active_buffer(largest_index, NEIGHBOUR_OUTSIDE);
 
-            const size_t task_index = _tasks.get_free_element();
-            Task &new_task = _tasks[task_index];
-            new_task.set_subgrid(_buffers[non_full_index].get_subgrid_index());
-            new_task.set_buffer(non_full_index);
-            if (largest_index > 0) {
-              DensitySubGrid &subgrid = *_grid_creator.get_subgrid(
-                  _buffers[non_full_index].get_subgrid_index());
-              new_task.set_type(TASKTYPE_PHOTON_TRAVERSAL);
-
-              // add dependency
-              new_task.set_dependency(subgrid.get_dependency());
-
-              const uint_fast32_t queue_index = subgrid.get_owning_thread();
-              _queues[queue_index]->add_task(task_index);
+            if (largest_index > 0 &&
+                !_grid_creator.is_local(
+                    _buffers[non_full_index].get_subgrid_index())) {
+              // the target subgrid lives on another process
+              _communicator->send(non_full_index);
             } else {
-              new_task.set_type(TASKTYPE_PHOTON_REEMIT);
-              // a reemit task has no dependencies
-              _shared_queue.add_task(task_index);
+              const size_t task_index = _tasks.get_free_element();
+              Task &new_task = _tasks[task_index];
+              new_task.set_subgrid(
+                  _buffers[non_full_index].get_subgrid_index());
+              new_task.set_buffer(non_full_index);
+              if (largest_index > 0) {
+                DensitySubGrid &subgrid = *_grid_creator.get_subgrid(
+                    _buffers[non_full_index].get_subgrid_index());
+                new_task.set_type(TASKTYPE_PHOTON_TRAVERSAL);
+
+                // add dependency
+                new_task.set_dependency(subgrid.get_dependency());
+
+                const uint_fast32_t queue_index = subgrid.get_owning_thread();
+                _queues[queue_index]->add_task(task_index);
+              } else {
+                new_task.set_type(TASKTYPE_PHOTON_REEMIT);
+                // a reemit task has no dependencies
+                _shared_queue.add_task(task_index);
+              }
             }
 
             // set the new largest index
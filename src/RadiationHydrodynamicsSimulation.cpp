@@ -121,6 +121,9 @@ void RadiationHydrodynamicsSimulation::add_command_line_parameters(
  *    value is given, the radiation field is updated every time step. (default:
  *    -1. s: update every time step)
  *  - random seed: Seed for the random number generator (default: 42)
+ *  - random generator: Type of random number generator to use (RANLUX/Philox,
+ *    default: RANLUX). The counter-based Philox generator uses an independent
+ *    random number stream for every photon packet.
  *  - output folder: Folder where all output files will be placed (default: .)
  *  - number of iterations: Number of iterations of the photoionization
  *    algorithm (default: 10)
@@ -270,6 +273,9 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
     // make sure we do not use the same random seed as used initially...
     random_seed = restart_reader->read< int_fast32_t >();
   }
+  const RandomGeneratorType random_generator_type =
+      RandomGenerator::get_type(params->get_value< std::string >(
+          "RadiationHydrodynamicsSimulation:random generator", "RANLUX"));
   PhotonSourceSpectrum *spectrum = PhotonSourceSpectrumFactory::generate(
       "PhotonSourceSpectrum", *params, log);
 
@@ -444,8 +450,8 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
                       workdistributor.get_worksize_string(),
                       " for photon shooting.");
   }
-  IonizationPhotonShootJobMarket photonshootjobs(source, random_seed, *grid, 0,
-                                                 100, worksize);
+  IonizationPhotonShootJobMarket photonshootjobs(
+      source, random_seed, *grid, 0, 100, worksize, random_generator_type);
 
   if (restart_reader == nullptr) {
     // initialize the hydro variables (before we write the initial snapshot)
@@ -26,18 +26,45 @@
 #ifndef RANDOMGENERATOR_HPP
 #define RANDOMGENERATOR_HPP
 
+#include "Error.hpp"
 #include "RestartReader.hpp"
 #include "RestartWriter.hpp"
 
 #include <cstdint>
+#include <string>
 
 /**
- * @brief Own implementation of the GSL ranlxd2 random generator.
+ * @brief Types of random number generator backends.
+ */
+enum RandomGeneratorType {
+  /*! @brief Sequential ranlxd2 generator (default). */
+  RANDOMGENERATORTYPE_RANLUX = 0,
+  /*! @brief Counter-based Philox4x32-10 generator. */
+  RANDOMGENERATORTYPE_PHILOX
+};
+
+/**
+ * @brief Own implementation of the GSL ranlxd2 random generator, with an
+ * optional counter-based Philox4x32-10 backend.
+ *
+ * The ranlxd2 implementation is based on
+ * http://git.savannah.gnu.org/cgit/gsl.git/tree/rng/ranlxd.c.
  *
- * Based on http://git.savannah.gnu.org/cgit/gsl.git/tree/rng/ranlxd.c.
+ * The Philox4x32-10 generator is the counter-based generator of Salmon, J. K.,
+ * Moraes, M. A., Dror, R. O. & Shaw, D. E. 2011, Proceedings of SC11
+ * (https://doi.org/10.1145/2063384.2063405). Its output is a pure function of
+ * a 64-bit key and a 128-bit counter, so that independent streams can be
+ * selected by simply setting the counter (see set_stream()). We use the key to
+ * store the seed and the iteration number, and the counter to store the
+ * stream index, the event index within that stream and the block index within
+ * the event. Random numbers drawn after a call to set_stream() hence only
+ * depend on the arguments of that call and not on the thread that draws them.
  */
 class RandomGenerator {
 private:
+  /*! @brief Type of generator that is used. */
+  RandomGeneratorType _type;
+
   /*! @brief ranlxd2 state variables. */
   double _xdbl[12];
 
@@ -56,6 +83,53 @@ private:
   /*! @brief ranlxd2 state variables. */
   uint_fast32_t _pr;
 
+  /*! @brief Philox key: seed and iteration number. */
+  uint32_t _philox_key[2];
+
+  /*! @brief Philox counter: block index, event index and stream index. */
+  uint32_t _philox_counter[4];
+
+  /*! @brief Second random number generated by the last Philox block (if
+   *  still available). */
+  double _philox_next;
+
+  /*! @brief Is _philox_next still available? */
+  bool _philox_has_next;
+
+  /**
+   * @brief Convert two 32-bit random integers into a random double precision
+   * floating point value in the range (0., 1.).
+   *
+   * We use the upper 53 bits of the combined 64-bit integer and shift the
+   * result by half a unit in the last place, so that 0. is never returned.
+   *
+   * @param high Random integer that provides the most significant bits.
+   * @param low Random integer that provides the least significant bits.
+   * @return Random double precision floating point value.
+   */
+  static inline double philox_to_double(const uint32_t high,
+                                        const uint32_t low) {
+    const uint64_t bits =
+        (static_cast< uint64_t >(high) << 32) | static_cast< uint64_t >(low);
+    return ((bits >> 11) + 0.5) * (1. / 9007199254740992.);
+  }
+
+  /**
+   * @brief Generate the next pair of Philox random numbers and increment the
+   * block counter.
+   *
+   * @return First random number of the pair; the second one is stored in
+   * _philox_next.
+   */
+  inline double increment_philox_state() {
+    uint32_t output[4];
+    get_philox_block(_philox_counter, _philox_key, output);
+    ++_philox_counter[0];
+    _philox_next = philox_to_double(output[2], output[3]);
+    _philox_has_next = true;
+    return philox_to_double(output[0], output[1]);
+  }
+
   /**
    * @brief GSL RANLUX_STEP macro.
    *
@@ -153,12 +227,81 @@ private:
   }
 
 public:
+  /**
+   * @brief Apply the Philox4x32-10 bijection to the given counter.
+   *
+   * This function is branch free and has no side effects, so that many blocks
+   * can be generated independently.
+   *
+   * @param counter 128-bit counter.
+   * @param key 64-bit key.
+   * @param output Array to store the 128 resulting random bits in.
+   */
+  static inline void get_philox_block(const uint32_t counter[4],
+                                      const uint32_t key[2],
+                                      uint32_t output[4]) {
+    uint32_t c0 = counter[0];
+    uint32_t c1 = counter[1];
+    uint32_t c2 = counter[2];
+    uint32_t c3 = counter[3];
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    for (uint_fast8_t i = 0; i < 10; ++i) {
+      const uint64_t product0 = static_cast< uint64_t >(0xD2511F53u) * c0;
+      const uint64_t product1 = static_cast< uint64_t >(0xCD9E8D57u) * c2;
+      const uint32_t hi0 = static_cast< uint32_t >(product0 >> 32);
+      const uint32_t lo0 = static_cast< uint32_t >(product0);
+      const uint32_t hi1 = static_cast< uint32_t >(product1 >> 32);
+      const uint32_t lo1 = static_cast< uint32_t >(product1);
+      c0 = hi1 ^ c1 ^ k0;
+      c1 = lo1;
+      c2 = hi0 ^ c3 ^ k1;
+      c3 = lo0;
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+    output[0] = c0;
+    output[1] = c1;
+    output[2] = c2;
+    output[3] = c3;
+  }
+
+  /**
+   * @brief Get the RandomGeneratorType that corresponds to the given name.
+   *
+   * @param name Name of a generator type ("RANLUX" or "Philox").
+   * @return Corresponding RandomGeneratorType.
+   */
+  static inline RandomGeneratorType get_type(const std::string name) {
+    if (name == "RANLUX") {
+      return RANDOMGENERATORTYPE_RANLUX;
+    } else if (name == "Philox") {
+      return RANDOMGENERATORTYPE_PHILOX;
+    } else {
+      cmac_error("Unknown random generator type: \"%s\"!", name.c_str());
+      return RANDOMGENERATORTYPE_RANLUX;
+    }
+  }
+
   /**
    * @brief Set a new seed for the random generator.
    *
+   * For the Philox generator, this also resets the stream to the default
+   * stream for iteration 0.
+   *
    * @param seed New seed.
    */
   inline void set_seed(int_fast32_t seed) {
+
+    _philox_key[0] = static_cast< uint32_t >(seed);
+    _philox_key[1] = 0;
+    _philox_counter[0] = 0;
+    _philox_counter[1] = 0;
+    _philox_counter[2] = 0;
+    _philox_counter[3] = 0;
+    _philox_next = 0.;
+    _philox_has_next = false;
+
     int_fast32_t ibit, jbit, i, k, m, xbit[31];
     double x, y;
 
@@ -203,8 +346,82 @@ public:
    * @brief Constructor.
    *
    * @param seed Initial seed for the random number generator.
+   * @param type Type of generator to use.
    */
-  inline RandomGenerator(int_fast32_t seed = 42) { set_seed(seed); }
+  inline RandomGenerator(int_fast32_t seed = 42,
+                         RandomGeneratorType type = RANDOMGENERATORTYPE_RANLUX)
+      : _type(type) {
+    set_seed(seed);
+  }
+
+  /**
+   * @brief Get the type of generator that is used.
+   *
+   * @return RandomGeneratorType.
+   */
+  inline RandomGeneratorType get_type() const { return _type; }
+
+  /**
+   * @brief Set the type of generator to use.
+   *
+   * The state of both generators is kept, so switching back and forth does not
+   * reset either of them.
+   *
+   * @param type New RandomGeneratorType.
+   */
+  inline void set_type(const RandomGeneratorType type) { _type = type; }
+
+  /**
+   * @brief Is this a counter-based generator?
+   *
+   * @return True if set_stream() selects an independent stream.
+   */
+  inline bool is_counter_based() const {
+    return _type == RANDOMGENERATORTYPE_PHILOX;
+  }
+
+  /**
+   * @brief Select the stream of random numbers for the given iteration, stream
+   * and event.
+   *
+   * For counter-based generators, all random numbers drawn after this call
+   * are fully determined by the seed and the arguments of this call. A stream
+   * would typically be a single photon packet (identified by a source index and
+   * a photon index within that source), while the event counts the number of
+   * times the photon packet was (re)emitted. Every event has 2^33 random
+   * numbers available.
+   *
+   * For the sequential ranlxd2 generator, this function does nothing.
+   *
+   * @param iteration Iteration number.
+   * @param stream Stream index.
+   * @param event Event index within the stream.
+   */
+  inline void set_stream(const uint_fast32_t iteration,
+                         const uint_fast64_t stream,
+                         const uint_fast32_t event = 0) {
+    _philox_key[1] = static_cast< uint32_t >(iteration);
+    _philox_counter[0] = 0;
+    _philox_counter[1] = static_cast< uint32_t >(event);
+    _philox_counter[2] = static_cast< uint32_t >(stream);
+    _philox_counter[3] = static_cast< uint32_t >(stream >> 32);
+    _philox_has_next = false;
+  }
+
+  /**
+   * @brief Get the stream index for the photon packet with the given index
+   * within the given source.
+   *
+   * @param source_index Index of the source.
+   * @param photon_index Index of the photon packet within that source.
+   * @return Corresponding stream index that can be passed on to set_stream().
+   */
+  static inline uint_fast64_t
+  get_stream_index(const uint_fast32_t source_index,
+                   const uint_fast32_t photon_index) {
+    return (static_cast< uint_fast64_t >(source_index) << 32) |
+           static_cast< uint32_t >(photon_index);
+  }
 
   /**
    * @brief Get a uniform random double precision floating point value in the
@@ -215,6 +432,15 @@ public:
    * @return Random double precision floating point value.
    */
   inline double get_uniform_random_double() {
+
+    if (_type == RANDOMGENERATORTYPE_PHILOX) {
+      if (_philox_has_next) {
+        _philox_has_next = false;
+        return _philox_next;
+      }
+      return increment_philox_state();
+    }
+
     _ir = (_ir + 1) % 12;
 
     if (_ir == _ir_old) {
@@ -224,6 +450,50 @@ public:
     return _xdbl[_ir];
   }
 
+  /**
+   * @brief Fill the given array with uniform random double precision floating
+   * point values.
+   *
+   * This returns exactly the same values as the equivalent number of calls to
+   * get_uniform_random_double(). For the Philox generator, the bulk of the
+   * values is generated in independent blocks in a single loop without
+   * branches, which is significantly faster than individual calls.
+   *
+   * @param values Array to fill.
+   * @param number Number of values to generate.
+   */
+  inline void get_uniform_random_doubles(double *values, const size_t number) {
+
+    if (_type != RANDOMGENERATORTYPE_PHILOX) {
+      for (size_t i = 0; i < number; ++i) {
+        values[i] = get_uniform_random_double();
+      }
+      return;
+    }
+
+    size_t i = 0;
+    if (_philox_has_next && number > 0) {
+      values[0] = _philox_next;
+      _philox_has_next = false;
+      i = 1;
+    }
+    const size_t number_of_blocks = (number - i) / 2;
+    uint32_t counter[4] = {_philox_counter[0], _philox_counter[1],
+                           _philox_counter[2], _philox_counter[3]};
+    for (size_t iblock = 0; iblock < number_of_blocks; ++iblock) {
+      uint32_t output[4];
+      counter[0] = _philox_counter[0] + static_cast< uint32_t >(iblock);
+      get_philox_block(counter, _philox_key, output);
+      values[i + 2 * iblock] = philox_to_double(output[0], output[1]);
+      values[i + 2 * iblock + 1] = philox_to_double(output[2], output[3]);
+    }
+    _philox_counter[0] += static_cast< uint32_t >(number_of_blocks);
+    i += 2 * number_of_blocks;
+    if (i < number) {
+      values[i] = increment_philox_state();
+    }
+  }
+
   /**
    * @brief Get a random integer value.
    *
@@ -248,6 +518,16 @@ public:
     restart_writer.write(_jr);
     restart_writer.write(_ir_old);
     restart_writer.write(_pr);
+
+    restart_writer.write(static_cast< int_fast32_t >(_type));
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+      restart_writer.write(_philox_key[i]);
+    }
+    for (uint_fast8_t i = 0; i < 4; ++i) {
+      restart_writer.write(_philox_counter[i]);
+    }
+    restart_writer.write(_philox_next);
+    restart_writer.write(_philox_has_next);
   }
 
   /**
@@ -256,7 +536,8 @@ public:
    * @param restart_reader Restart file to read from.
    */
   inline RandomGenerator(RestartReader &restart_reader)
-      : _xdbl{restart_reader.read< double >(), restart_reader.read< double >(),
+      : _type(RANDOMGENERATORTYPE_RANLUX),
+        _xdbl{restart_reader.read< double >(), restart_reader.read< double >(),
               restart_reader.read< double >(), restart_reader.read< double >(),
               restart_reader.read< double >(), restart_reader.read< double >(),
               restart_reader.read< double >(), restart_reader.read< double >(),
@@ -266,7 +547,19 @@ public:
         _ir(restart_reader.read< uint_fast32_t >()),
         _jr(restart_reader.read< uint_fast32_t >()),
         _ir_old(restart_reader.read< uint_fast32_t >()),
-        _pr(restart_reader.read< uint_fast32_t >()) {}
+        _pr(restart_reader.read< uint_fast32_t >()) {
+
+    _type = static_cast< RandomGeneratorType >(
+        restart_reader.read< int_fast32_t >());
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+      _philox_key[i] = restart_reader.read< uint32_t >();
+    }
+    for (uint_fast8_t i = 0; i < 4; ++i) {
+      _philox_counter[i] = restart_reader.read< uint32_t >();
+    }
+    _philox_next = restart_reader.read< double >();
+    _philox_has_next = restart_reader.read< bool >();
+  }
 };
 
 #endif // RANDOMGENERATOR_HPP
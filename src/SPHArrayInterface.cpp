@@ -27,7 +27,17 @@
 #include "DensityGrid.hpp"
 #include "DensityGridTraversalJobMarket.hpp"
 #include "Lock.hpp"
+#include "OpenMP.hpp"
+
 #include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /**
  * @brief Constructor.
@@ -37,17 +47,24 @@
  * @param unit_length_in_SI Length unit used in the input arrays (in m).
  * @param unit_mass_in_SI Mass unit used in the input arrays (in kg).
  * @param mapping_type Type of density mapping to use.
+ * @param gridding_cache_file_name Name of the file used to cache the
+ * pre-computed gridding table in between runs (empty string to disable
+ * caching).
  */
-SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
-                                     const double unit_mass_in_SI,
-                                     const std::string mapping_type)
+SPHArrayInterface::SPHArrayInterface(
+    const double unit_length_in_SI, const double unit_mass_in_SI,
+    const std::string mapping_type, const std::string gridding_cache_file_name)
     : DensityGridWriter("", false, DensityGridWriterFields(false), nullptr),
       _unit_length_in_SI(unit_length_in_SI), _unit_mass_in_SI(unit_mass_in_SI),
       _is_periodic(false), _mapping_type(get_mapping_type(mapping_type)),
-      _octree(nullptr) {
-
-  if (_mapping_type == SPHARRAY_MAPPING_PETKOVA) {
-    gridding();
+      _density_values_pointer(nullptr), _gridding_cache_mapping(nullptr),
+      _gridding_cache_mapping_size(0), _octree(nullptr),
+      _positions_changed(true), _smoothing_lengths_changed(true),
+      _scatter_offset(0) {
+
+  if (_mapping_type == SPHARRAY_MAPPING_PETKOVA ||
+      _mapping_type == SPHARRAY_MAPPING_PETKOVA_SCATTER) {
+    gridding(gridding_cache_file_name);
   }
   _time_log.output("time-log-file.txt", true);
 }
@@ -64,16 +81,21 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
  * @param box_sides Side lengths of the simulation box (in the given length
  * unit).
  * @param mapping_type Type of density mapping to use.
+ * @param gridding_cache_file_name Name of the file used to cache the
+ * pre-computed gridding table in between runs (empty string to disable
+ * caching).
  */
-SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
-                                     const double unit_mass_in_SI,
-                                     const double *box_anchor,
-                                     const double *box_sides,
-                                     const std::string mapping_type)
+SPHArrayInterface::SPHArrayInterface(
+    const double unit_length_in_SI, const double unit_mass_in_SI,
+    const double *box_anchor, const double *box_sides,
+    const std::string mapping_type, const std::string gridding_cache_file_name)
     : DensityGridWriter("", false, DensityGridWriterFields(false), nullptr),
       _unit_length_in_SI(unit_length_in_SI), _unit_mass_in_SI(unit_mass_in_SI),
       _is_periodic(true), _mapping_type(get_mapping_type(mapping_type)),
-      _octree(nullptr) {
+      _density_values_pointer(nullptr), _gridding_cache_mapping(nullptr),
+      _gridding_cache_mapping_size(0), _octree(nullptr),
+      _positions_changed(true), _smoothing_lengths_changed(true),
+      _scatter_offset(0) {
 
   _box.get_anchor()[0] = box_anchor[0] * _unit_length_in_SI;
   _box.get_anchor()[1] = box_anchor[1] * _unit_length_in_SI;
@@ -82,8 +104,9 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
   _box.get_sides()[1] = box_sides[1] * _unit_length_in_SI;
   _box.get_sides()[2] = box_sides[2] * _unit_length_in_SI;
 
-  if (_mapping_type == SPHARRAY_MAPPING_PETKOVA) {
-    gridding();
+  if (_mapping_type == SPHARRAY_MAPPING_PETKOVA ||
+      _mapping_type == SPHARRAY_MAPPING_PETKOVA_SCATTER) {
+    gridding(gridding_cache_file_name);
   }
   _time_log.output("time-log-file.txt", true);
 }
@@ -100,16 +123,21 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
  * @param box_sides Side lengths of the simulation box (in the given length
  * unit).
  * @param mapping_type Type of density mapping to use.
+ * @param gridding_cache_file_name Name of the file used to cache the
+ * pre-computed gridding table in between runs (empty string to disable
+ * caching).
  */
-SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
-                                     const double unit_mass_in_SI,
-                                     const float *box_anchor,
-                                     const float *box_sides,
-                                     const std::string mapping_type)
+SPHArrayInterface::SPHArrayInterface(
+    const double unit_length_in_SI, const double unit_mass_in_SI,
+    const float *box_anchor, const float *box_sides,
+    const std::string mapping_type, const std::string gridding_cache_file_name)
     : DensityGridWriter("", false, DensityGridWriterFields(false), nullptr),
       _unit_length_in_SI(unit_length_in_SI), _unit_mass_in_SI(unit_mass_in_SI),
       _is_periodic(true), _mapping_type(get_mapping_type(mapping_type)),
-      _octree(nullptr) {
+      _density_values_pointer(nullptr), _gridding_cache_mapping(nullptr),
+      _gridding_cache_mapping_size(0), _octree(nullptr),
+      _positions_changed(true), _smoothing_lengths_changed(true),
+      _scatter_offset(0) {
 
   _box.get_anchor()[0] = box_anchor[0] * _unit_length_in_SI;
   _box.get_anchor()[1] = box_anchor[1] * _unit_length_in_SI;
@@ -118,8 +146,9 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
   _box.get_sides()[1] = box_sides[1] * _unit_length_in_SI;
   _box.get_sides()[2] = box_sides[2] * _unit_length_in_SI;
 
-  if (_mapping_type == SPHARRAY_MAPPING_PETKOVA) {
-    gridding();
+  if (_mapping_type == SPHARRAY_MAPPING_PETKOVA ||
+      _mapping_type == SPHARRAY_MAPPING_PETKOVA_SCATTER) {
+    gridding(gridding_cache_file_name);
   }
   _time_log.output("time-log-file.txt", true);
 }
@@ -127,10 +156,14 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
 /**
  * @brief Destructor.
  *
- * Frees up memory used by the internal Octree.
+ * Frees up memory used by the internal Octree and unmaps the gridding cache
+ * file.
  */
 SPHArrayInterface::~SPHArrayInterface() {
   delete _octree;
+  if (_gridding_cache_mapping != nullptr) {
+    munmap(_gridding_cache_mapping, _gridding_cache_mapping_size);
+  }
   _time_log.output("time-log-file.txt", true);
 }
 
@@ -147,33 +180,8 @@ SPHArrayInterface::~SPHArrayInterface() {
 void SPHArrayInterface::reset(const double *x, const double *y, const double *z,
                               const double *h, const double *m,
                               const size_t npart) {
-
-  delete _octree;
-
-  _positions.resize(npart);
-  _smoothing_lengths.resize(npart, 0.);
-  _masses.resize(npart, 0.);
-  _neutral_fractions.resize(npart, 0.);
-  for (size_t i = 0; i < npart; ++i) {
-    _positions[i][0] = x[i] * _unit_length_in_SI;
-    _positions[i][1] = y[i] * _unit_length_in_SI;
-    _positions[i][2] = z[i] * _unit_length_in_SI;
-    _smoothing_lengths[i] = h[i] * _unit_length_in_SI;
-    _masses[i] = m[i] * _unit_mass_in_SI;
-  }
-
-  if (!_is_periodic) {
-    CoordinateVector<> minpos(DBL_MAX);
-    CoordinateVector<> maxpos(-DBL_MAX);
-    for (size_t i = 0; i < npart; ++i) {
-      minpos = CoordinateVector<>::min(minpos, _positions[i]);
-      maxpos = CoordinateVector<>::max(maxpos, _positions[i]);
-    }
-
-    maxpos -= minpos;
-    _box.get_anchor() = minpos - 0.005 * maxpos;
-    _box.get_sides() = 1.01 * maxpos;
-  }
+  set_number_of_particles(npart);
+  update_particles(0, x, y, z, h, m, npart);
 }
 
 /**
@@ -191,33 +199,8 @@ void SPHArrayInterface::reset(const double *x, const double *y, const double *z,
 void SPHArrayInterface::reset(const double *x, const double *y, const double *z,
                               const float *h, const float *m,
                               const size_t npart) {
-
-  delete _octree;
-
-  _positions.resize(npart);
-  _smoothing_lengths.resize(npart, 0.);
-  _masses.resize(npart, 0.);
-  _neutral_fractions.resize(npart, 0.);
-  for (size_t i = 0; i < npart; ++i) {
-    _positions[i][0] = x[i] * _unit_length_in_SI;
-    _positions[i][1] = y[i] * _unit_length_in_SI;
-    _positions[i][2] = z[i] * _unit_length_in_SI;
-    _smoothing_lengths[i] = h[i] * _unit_length_in_SI;
-    _masses[i] = m[i] * _unit_mass_in_SI;
-  }
-
-  if (!_is_periodic) {
-    CoordinateVector<> minpos(DBL_MAX);
-    CoordinateVector<> maxpos(-DBL_MAX);
-    for (size_t i = 0; i < npart; ++i) {
-      minpos = CoordinateVector<>::min(minpos, _positions[i]);
-      maxpos = CoordinateVector<>::max(maxpos, _positions[i]);
-    }
-
-    maxpos -= minpos;
-    _box.get_anchor() = minpos - 0.005 * maxpos;
-    _box.get_sides() = 1.01 * maxpos;
-  }
+  set_number_of_particles(npart);
+  update_particles(0, x, y, z, h, m, npart);
 }
 
 /**
@@ -235,33 +218,29 @@ void SPHArrayInterface::reset(const double *x, const double *y, const double *z,
 void SPHArrayInterface::reset(const float *x, const float *y, const float *z,
                               const float *h, const float *m,
                               const size_t npart) {
+  set_number_of_particles(npart);
+  update_particles(0, x, y, z, h, m, npart);
+}
 
-  delete _octree;
+/**
+ * @brief Set the number of particles.
+ *
+ * Existing particles keep their data values; new particles need to be set
+ * using update_particles(). A change in the number of particles forces the
+ * Octree to be rebuilt during the next initialize().
+ *
+ * @param npart New number of particles.
+ */
+void SPHArrayInterface::set_number_of_particles(const size_t npart) {
 
+  if (npart == _positions.size()) {
+    return;
+  }
   _positions.resize(npart);
   _smoothing_lengths.resize(npart, 0.);
   _masses.resize(npart, 0.);
   _neutral_fractions.resize(npart, 0.);
-  for (size_t i = 0; i < npart; ++i) {
-    _positions[i][0] = x[i] * _unit_length_in_SI;
-    _positions[i][1] = y[i] * _unit_length_in_SI;
-    _positions[i][2] = z[i] * _unit_length_in_SI;
-    _smoothing_lengths[i] = h[i] * _unit_length_in_SI;
-    _masses[i] = m[i] * _unit_mass_in_SI;
-  }
-
-  if (!_is_periodic) {
-    CoordinateVector<> minpos(DBL_MAX);
-    CoordinateVector<> maxpos(-DBL_MAX);
-    for (size_t i = 0; i < npart; ++i) {
-      minpos = CoordinateVector<>::min(minpos, _positions[i]);
-      maxpos = CoordinateVector<>::max(maxpos, _positions[i]);
-    }
-
-    maxpos -= minpos;
-    _box.get_anchor() = minpos - 0.005 * maxpos;
-    _box.get_sides() = 1.01 * maxpos;
-  }
+  _positions_changed = true;
 }
 
 /**
@@ -275,20 +254,251 @@ Octree *SPHArrayInterface::get_octree() { return _octree; }
  * @brief Initialize the internal Octree.
  */
 void SPHArrayInterface::initialize() {
-  _octree = new Octree(_positions, _box, _is_periodic);
-  _octree->set_auxiliaries(_smoothing_lengths, Octree::max< double >);
+
+  if (_octree == nullptr || _positions_changed) {
+    if (!_is_periodic) {
+      CoordinateVector<> minpos(DBL_MAX);
+      CoordinateVector<> maxpos(-DBL_MAX);
+      for (size_t i = 0; i < _positions.size(); ++i) {
+        minpos = CoordinateVector<>::min(minpos, _positions[i]);
+        maxpos = CoordinateVector<>::max(maxpos, _positions[i]);
+      }
+
+      maxpos -= minpos;
+      _box.get_anchor() = minpos - 0.005 * maxpos;
+      _box.get_sides() = 1.01 * maxpos;
+    }
+
+    delete _octree;
+    _octree = new Octree(_positions, _box, _is_periodic);
+    _octree->set_auxiliaries(_smoothing_lengths, Octree::max< double >);
+  } else if (_smoothing_lengths_changed) {
+    // the tree structure only depends on the positions
+    _octree->set_auxiliaries(_smoothing_lengths, Octree::max< double >);
+  }
+  _positions_changed = false;
+  _smoothing_lengths_changed = false;
   //_dens_map = new DensityMapping();
+
+  // any scattered cell masses belong to a previous grid initialization
+  _scatter_masses.clear();
+  _scatter_offset = 0;
+}
+
+/**
+ * @brief Prepare the density mapping for the given block of cells.
+ *
+ * Only does something for the SPHARRAY_MAPPING_PETKOVA_SCATTER mapping. In
+ * this case, we loop over the particles and add the mass contribution of every
+ * particle to all cells it overlaps with. A particle overlaps with a cell if
+ * the distance between the particle and the cell midpoint is smaller than the
+ * sum of the particle smoothing length and the radius of the cell, which is
+ * exactly the same criterion used by the gather mapping.
+ *
+ * To limit the memory usage, the block is processed in sub-blocks of at most
+ * SPHARRAYINTERFACE_SCATTER_BLOCK_SIZE cells (see scatter_sub_block()). Only
+ * the cell masses for the full block are kept until the cells are initialized.
+ *
+ * @param grid DensityGrid that is being initialized.
+ * @param block Range of cell indices that will be initialized.
+ * @param worksize Number of shared memory threads that can be used. If a
+ * negative number is given, all available threads are used.
+ */
+void SPHArrayInterface::prepare(DensityGrid &grid,
+                                const std::pair< size_t, size_t > &block,
+                                const int_fast32_t worksize) {
+
+  if (_mapping_type != SPHARRAY_MAPPING_PETKOVA_SCATTER) {
+    return;
+  }
+
+  _time_log.start("Scatter_mapping");
+
+  int_fast32_t number_of_threads = 1;
+#ifdef HAVE_OPENMP
+  number_of_threads = omp_get_max_threads();
+  if (worksize > 0 && worksize < number_of_threads) {
+    number_of_threads = worksize;
+  }
+#endif
+
+  const size_t number_of_cells = block.second - block.first;
+  _scatter_offset = block.first;
+  _scatter_masses.assign(number_of_cells, 0.);
+  for (size_t first_cell = 0; first_cell < number_of_cells;
+       first_cell += SPHARRAYINTERFACE_SCATTER_BLOCK_SIZE) {
+    scatter_sub_block(
+        grid, first_cell,
+        std::min(number_of_cells - first_cell,
+                 size_t(SPHARRAYINTERFACE_SCATTER_BLOCK_SIZE)),
+        number_of_threads);
+  }
+
+  _time_log.end("Scatter_mapping");
+}
+
+/**
+ * @brief Scatter the particle masses onto a sub-block of the block of cells
+ * that is being prepared.
+ *
+ * We build an Octree on top of the cell midpoints of the sub-block, and only
+ * loop over the particles that can overlap with the sphere that contains all
+ * cells of the sub-block. The faces of every cell are only computed once.
+ *
+ * Particles are distributed over the available threads; every thread
+ * accumulates its contributions in its own copy of the sub-block cell masses,
+ * which are summed at the end.
+ *
+ * @param grid DensityGrid that is being initialized.
+ * @param first_cell Offset of the first cell of the sub-block within the block
+ * of cells that is being prepared.
+ * @param number_of_cells Number of cells in the sub-block.
+ * @param number_of_threads Number of shared memory threads to use.
+ */
+void SPHArrayInterface::scatter_sub_block(
+    DensityGrid &grid, const size_t first_cell, const size_t number_of_cells,
+    const int_fast32_t number_of_threads) {
+
+  std::vector< CoordinateVector<> > midpoints(number_of_cells);
+  std::vector< double > radii(number_of_cells, 0.);
+  std::vector< std::vector< Face > > faces(number_of_cells);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared) num_threads(number_of_threads)
+#endif
+  for (size_t i = 0; i < number_of_cells; ++i) {
+    DensityGrid::iterator cell(_scatter_offset + first_cell + i, grid);
+    midpoints[i] = cell.get_cell_midpoint();
+    faces[i] = cell.get_faces();
+    radii[i] = get_cell_radius(midpoints[i], faces[i]);
+  }
+
+  CoordinateVector<> minpos(DBL_MAX);
+  CoordinateVector<> maxpos(-DBL_MAX);
+  double max_radius = 0.;
+  for (size_t i = 0; i < number_of_cells; ++i) {
+    minpos = CoordinateVector<>::min(minpos, midpoints[i]);
+    maxpos = CoordinateVector<>::max(maxpos, midpoints[i]);
+    max_radius = std::max(max_radius, radii[i]);
+  }
+
+  // the cell tree uses the same periodic box as the particle tree, so that
+  // distances are computed in the same way. Without periodic boundaries, the
+  // particle box does not necessarily contain all cells, so we use a box that
+  // contains all midpoints of the sub-block
+  Box<> cell_box(_box);
+  if (!_is_periodic) {
+    cell_box = Box<>(minpos - CoordinateVector<>(max_radius),
+                     maxpos - minpos + CoordinateVector<>(2. * max_radius));
+  }
+  Octree cell_tree(midpoints, cell_box, _is_periodic);
+  cell_tree.set_auxiliaries(radii, Octree::max< double >);
+
+  // only particles that overlap with the sphere around the sub-block can
+  // overlap with its cells
+  const CoordinateVector<> centre = 0.5 * (minpos + maxpos);
+  double sub_block_radius = 0.;
+  for (size_t i = 0; i < number_of_cells; ++i) {
+    double r;
+    if (_is_periodic) {
+      r = _box.periodic_distance(midpoints[i], centre).norm();
+    } else {
+      r = (midpoints[i] - centre).norm();
+    }
+    sub_block_radius = std::max(sub_block_radius, r + radii[i]);
+  }
+  const std::vector< uint_fast32_t > particles =
+      _octree->get_ngbs_sphere(centre, sub_block_radius);
+
+  const size_t number_of_particles = particles.size();
+#ifdef HAVE_OPENMP
+#pragma omp parallel default(shared) num_threads(number_of_threads)
+#endif
+  {
+    std::vector< double > thread_masses(number_of_cells, 0.);
+#ifdef HAVE_OPENMP
+#pragma omp for
+#endif
+    for (size_t i = 0; i < number_of_particles; ++i) {
+      const uint_fast32_t ipart = particles[i];
+      const CoordinateVector<> particle = _positions[ipart];
+      const std::vector< uint_fast32_t > ngbs =
+          cell_tree.get_ngbs_sphere(particle, _smoothing_lengths[ipart]);
+      const double h = 0.5 * _smoothing_lengths[ipart];
+      for (size_t j = 0; j < ngbs.size(); ++j) {
+        const uint_fast32_t icell = ngbs[j];
+        thread_masses[icell] +=
+            mass_contribution(faces[icell], particle, h) * _masses[ipart];
+      }
+    }
+#ifdef HAVE_OPENMP
+#pragma omp critical
+#endif
+    {
+      for (size_t i = 0; i < number_of_cells; ++i) {
+        _scatter_masses[first_cell + i] += thread_masses[i];
+      }
+    }
+  }
+}
+
+/**
+ * @brief Get the mass of the given cell by gathering the mass contributions of
+ * all particles that overlap with it.
+ *
+ * @param cell Geometrical information about the cell.
+ * @return Mass of the cell (in kg).
+ */
+double SPHArrayInterface::get_gathered_cell_mass(const Cell &cell) const {
+
+  const CoordinateVector<> position = cell.get_cell_midpoint();
+
+  // Find the vertex that is furthest away from the cell midpoint.
+  const std::vector< Face > face_vector = cell.get_faces();
+  const double radius = get_cell_radius(position, face_vector);
+
+  // Find the neighbours that are contained inside of a sphere of centre the
+  // cell midpoint and radius given by the distance to the furthest vertex.
+  const std::vector< uint_fast32_t > ngbs =
+      _octree->get_ngbs_sphere(position, radius);
+  const size_t numngbs = ngbs.size();
+
+  // Loop over all the neighbouring particles and calculate their mass
+  // contributions.
+  double mass = 0.;
+  for (size_t i = 0; i < numngbs; i++) {
+    const unsigned int index = ngbs[i];
+    const double h = _smoothing_lengths[index] / 2.0;
+    const CoordinateVector<> particle = _positions[index];
+    if (h < 0)
+      cmac_warning("h < 0: %g, %u", h, index);
+    mass += mass_contribution(face_vector, particle, h) * _masses[index];
+  }
+  return mass;
 }
 
 /**
  * @brief Initialize the pre-computed array of density values.
+ *
+ * The table is stored in a single contiguous array. Different radial bins are
+ * independent and are computed in parallel.
+ *
+ * If a cache file name is given, we first try to memory-map the table from
+ * that file. If the file does not exist or is not valid (wrong version or
+ * size, or checksum mismatch), the table is computed and written to the cache
+ * file for later use.
+ *
+ * @param cache_file_name Name of the gridding cache file (empty string to
+ * disable caching).
  */
-void SPHArrayInterface::gridding() {
-  double phi, r0, R_0, mu0;
-  int_fast32_t i, j, k;
+void SPHArrayInterface::gridding(const std::string cache_file_name) {
 
   _time_log.start("Gridding");
 
+  if (!cache_file_name.empty() && read_gridding_cache(cache_file_name)) {
+    _time_log.end("Gridding");
+    return;
+  }
+
   const double h = 1.0;
   const int_fast32_t n = 150;
   const int_fast32_t nr1 = 50;
@@ -297,100 +507,209 @@ void SPHArrayInterface::gridding() {
   const double mul = 0.98;
   const double cphil = 0.98;
 
-  _density_values.resize(nr1 + nr2 + 2);
-  for (i = 0; i <= nr1 + nr2 + 1; ++i) {
-    _density_values[i].resize(2 * n + 1);
-    for (j = 0; j <= 2 * n; ++j) {
-      _density_values[i][j].resize(2 * n + 1, 0.);
+  const size_t size_angle = SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE;
+  const size_t size_r = SPHARRAYINTERFACE_GRIDDING_SIZE_R;
+  cmac_assert(size_r == static_cast< size_t >(nr1 + nr2 + 2));
+  cmac_assert(size_angle == static_cast< size_t >(2 * n + 1));
+
+  _density_values.assign(size_r * size_angle * size_angle, 0.);
+  double *density_values = _density_values.data();
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared) schedule(dynamic)
+#endif
+  for (int_fast32_t i = 1; i <= nr1 + nr2; ++i) {
+    double r0;
+    if (i <= nr1) {
+      r0 = (rl / nr1) * i * h;
+    } else {
+      r0 = rl + ((2.0 - rl) / nr2) * (i - nr1) * h;
     }
-  }
+    double *values = density_values + i * size_angle * size_angle;
 
-  for (i = 0; i < nr1; ++i) {
-    r0 = (rl / nr1) * (i + 1) * h;
-    for (j = 0; j < n; ++j) {
-      mu0 = (mul / (n - 1)) * j;
-      R_0 = r0 * (std::sqrt(1.0 - mu0 * mu0)) / mu0;
-      for (k = 0; k < n; ++k) {
+    for (int_fast32_t j = 0; j < n; ++j) {
+      const double mu0 = (mul / (n - 1)) * j;
+      const double R_0 = r0 * (std::sqrt(1.0 - mu0 * mu0)) / mu0;
+      for (int_fast32_t k = 0; k < n; ++k) {
         const double cosphi = (cphil / (n - 1)) * k;
-        phi = std::acos(cosphi);
-        _density_values[i + 1][j][k] = full_integral(phi, cosphi, r0, R_0, h);
+        const double phi = std::acos(cosphi);
+        values[j * size_angle + k] = full_integral(phi, cosphi, r0, R_0, h);
       }
 
-      for (k = 1; k <= n; ++k) {
+      for (int_fast32_t k = 1; k <= n; ++k) {
         const double cosphi = cphil + ((1.0 - cphil) / n) * k;
-        phi = std::acos(cosphi);
-        _density_values[i + 1][j][n + k - 1] =
+        const double phi = std::acos(cosphi);
+        values[j * size_angle + n + k - 1] =
             full_integral(phi, cosphi, r0, R_0, h);
       }
     }
 
-    for (j = 1; j <= n; ++j) {
-      mu0 = mul + ((1.0 - mul) / n) * j;
-      R_0 = r0 * (std::sqrt(1.0 - mu0 * mu0)) / mu0;
-      for (k = 0; k < n; ++k) {
+    for (int_fast32_t j = 1; j <= n; ++j) {
+      const double mu0 = mul + ((1.0 - mul) / n) * j;
+      const double R_0 = r0 * (std::sqrt(1.0 - mu0 * mu0)) / mu0;
+      for (int_fast32_t k = 0; k < n; ++k) {
         const double cosphi = (cphil / (n - 1)) * k;
-        phi = std::acos(cosphi);
-        _density_values[i + 1][n + j - 1][k] =
+        const double phi = std::acos(cosphi);
+        values[(n + j - 1) * size_angle + k] =
             full_integral(phi, cosphi, r0, R_0, h);
       }
 
-      for (k = 1; k <= n; ++k) {
+      for (int_fast32_t k = 1; k <= n; ++k) {
         const double cosphi = cphil + ((1.0 - cphil) / n) * k;
-        phi = std::acos(cosphi);
-        _density_values[i + 1][n + j - 1][n + k - 1] =
+        const double phi = std::acos(cosphi);
+        values[(n + j - 1) * size_angle + n + k - 1] =
             full_integral(phi, cosphi, r0, R_0, h);
       }
     }
   }
 
-  for (i = 1; i <= nr2; ++i) {
-    r0 = rl + ((2.0 - rl) / nr2) * i * h;
-    for (j = 0; j < n; ++j) {
-      mu0 = (mul / (n - 1)) * j;
-      R_0 = r0 * (std::sqrt(1.0 - mu0 * mu0)) / mu0;
+  const int_fast32_t i = nr1 + nr2;
+  for (int_fast32_t j = 0; j < 2 * n; ++j) {
+    for (int_fast32_t k = 0; k < 2 * n; ++k) {
+      density_values[((i + 1) * size_angle + j) * size_angle + k] =
+          density_values[(i * size_angle + j) * size_angle + k];
+    }
+  }
 
-      for (k = 0; k < n; ++k) {
-        const double cosphi = (cphil / (n - 1)) * k;
-        phi = std::acos(cosphi);
-        _density_values[nr1 + i][j][k] = full_integral(phi, cosphi, r0, R_0, h);
-      }
+  _density_values_pointer = density_values;
 
-      for (k = 1; k <= n; ++k) {
-        const double cosphi = cphil + ((1.0 - cphil) / n) * k;
-        phi = std::acos(cosphi);
-        _density_values[nr1 + i][j][n + k - 1] =
-            full_integral(phi, cosphi, r0, R_0, h);
-      }
-    }
+  if (!cache_file_name.empty()) {
+    write_gridding_cache(cache_file_name);
+  }
 
-    for (j = 1; j <= n; ++j) {
-      mu0 = mul + ((1.0 - mul) / n) * j;
-      R_0 = r0 * (std::sqrt(1.0 - mu0 * mu0)) / mu0;
+  _time_log.end("Gridding");
+}
 
-      for (k = 0; k < n; ++k) {
-        const double cosphi = (cphil / (n - 1)) * k;
-        phi = std::acos(cosphi);
-        _density_values[nr1 + i][n + j - 1][k] =
-            full_integral(phi, cosphi, r0, R_0, h);
-      }
+/**
+ * @brief Compute the checksum of the given gridding table.
+ *
+ * We use the 64-bit FNV-1a hash of the binary representation of the values.
+ *
+ * @param values Gridding table values.
+ * @param size Number of values.
+ * @return Checksum.
+ */
+uint_fast64_t SPHArrayInterface::get_gridding_checksum(const double *values,
+                                                       const size_t size) {
+
+  uint64_t checksum = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    uint64_t word;
+    std::memcpy(&word, &values[i], sizeof(uint64_t));
+    checksum ^= word;
+    checksum *= 1099511628211ull;
+  }
+  return checksum;
+}
 
-      for (k = 1; k <= n; ++k) {
-        const double cosphi = cphil + ((1.0 - cphil) / n) * k;
-        phi = std::acos(cosphi);
-        _density_values[nr1 + i][n + j - 1][n + k - 1] =
-            full_integral(phi, cosphi, r0, R_0, h);
-      }
-    }
+/**
+ * @brief Try to memory-map the gridding table from the given cache file.
+ *
+ * The cache file consists of a 32 byte header containing an 8 character
+ * identifier ("CMIGRID"), the file format version, the radial and angular
+ * size of the table, 4 bytes of padding and the checksum of the table,
+ * followed by the table values.
+ *
+ * @param cache_file_name Name of the gridding cache file.
+ * @return True if the table was successfully mapped from the file.
+ */
+bool SPHArrayInterface::read_gridding_cache(const std::string cache_file_name) {
+
+  const size_t number_of_values = SPHARRAYINTERFACE_GRIDDING_SIZE_R *
+                                  SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE *
+                                  SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE;
+  const size_t file_size = 32 + number_of_values * sizeof(double);
+
+  const int file = open(cache_file_name.c_str(), O_RDONLY);
+  if (file < 0) {
+    // no cache file (yet)
+    return false;
+  }
+  struct stat file_stats;
+  if (fstat(file, &file_stats) != 0 ||
+      static_cast< size_t >(file_stats.st_size) != file_size) {
+    close(file);
+    cmac_warning("Gridding cache file \"%s\" has the wrong size, ignoring it!",
+                 cache_file_name.c_str());
+    return false;
+  }
+  void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, file, 0);
+  // the mapping stays valid after the file is closed
+  close(file);
+  if (mapping == MAP_FAILED) {
+    cmac_warning("Unable to map gridding cache file \"%s\"!",
+                 cache_file_name.c_str());
+    return false;
   }
 
-  i = nr1 + nr2;
-  for (j = 0; j < 2 * n; ++j) {
-    for (k = 0; k < 2 * n; ++k) {
-      _density_values[i + 1][j][k] = _density_values[i][j][k];
-    }
+  const char *header = reinterpret_cast< const char * >(mapping);
+  uint32_t version, size_r, size_angle;
+  uint64_t checksum;
+  std::memcpy(&version, header + 8, sizeof(uint32_t));
+  std::memcpy(&size_r, header + 12, sizeof(uint32_t));
+  std::memcpy(&size_angle, header + 16, sizeof(uint32_t));
+  std::memcpy(&checksum, header + 24, sizeof(uint64_t));
+  const double *values = reinterpret_cast< const double * >(header + 32);
+  if (std::strncmp(header, "CMIGRID", 8) != 0 ||
+      version != SPHARRAYINTERFACE_GRIDDING_CACHE_VERSION ||
+      size_r != SPHARRAYINTERFACE_GRIDDING_SIZE_R ||
+      size_angle != SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE ||
+      checksum != get_gridding_checksum(values, number_of_values)) {
+    munmap(mapping, file_size);
+    cmac_warning("Gridding cache file \"%s\" is not valid, ignoring it!",
+                 cache_file_name.c_str());
+    return false;
   }
 
-  _time_log.end("Gridding");
+  _gridding_cache_mapping = mapping;
+  _gridding_cache_mapping_size = file_size;
+  _density_values_pointer = values;
+  return true;
+}
+
+/**
+ * @brief Write the gridding table to the given cache file.
+ *
+ * The table is first written to a temporary file that is then renamed, so that
+ * other processes never see an incomplete cache file.
+ *
+ * @param cache_file_name Name of the gridding cache file.
+ */
+void SPHArrayInterface::write_gridding_cache(
+    const std::string cache_file_name) const {
+
+  cmac_assert(_density_values_pointer != nullptr);
+
+  std::stringstream temporary_name;
+  temporary_name << cache_file_name << ".tmp" << getpid();
+
+  char header[32];
+  std::memset(header, 0, 32);
+  std::strncpy(header, "CMIGRID", 8);
+  const uint32_t version = SPHARRAYINTERFACE_GRIDDING_CACHE_VERSION;
+  const uint32_t size_r = SPHARRAYINTERFACE_GRIDDING_SIZE_R;
+  const uint32_t size_angle = SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE;
+  const size_t number_of_values = SPHARRAYINTERFACE_GRIDDING_SIZE_R *
+                                  SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE *
+                                  SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE;
+  const uint64_t checksum =
+      get_gridding_checksum(_density_values_pointer, number_of_values);
+  std::memcpy(header + 8, &version, sizeof(uint32_t));
+  std::memcpy(header + 12, &size_r, sizeof(uint32_t));
+  std::memcpy(header + 16, &size_angle, sizeof(uint32_t));
+  std::memcpy(header + 24, &checksum, sizeof(uint64_t));
+
+  std::ofstream file(temporary_name.str(), std::ios::binary);
+  file.write(header, 32);
+  file.write(reinterpret_cast< const char * >(_density_values_pointer),
+             number_of_values * sizeof(double));
+  file.close();
+  if (!file.good() ||
+      std::rename(temporary_name.str().c_str(), cache_file_name.c_str()) != 0) {
+    std::remove(temporary_name.str().c_str());
+    cmac_warning("Unable to write gridding cache file \"%s\"!",
+                 cache_file_name.c_str());
+  }
 }
 
 /**
@@ -739,14 +1058,31 @@ double SPHArrayInterface::full_integral(const double phi, const double cosphi,
 double SPHArrayInterface::mass_contribution(const Cell &cell,
                                             const CoordinateVector<> particle,
                                             const double h) const {
+  return mass_contribution(cell.get_faces(), particle, h);
+}
+
+/**
+ * @brief Function that calculates the mass contribution of a particle
+ * towards the total mass of a cell with the given faces.
+ *
+ * This version can be used to avoid recomputing the faces of a cell when the
+ * contributions of multiple particles to the same cell are required.
+ *
+ * @param face_vector Faces of the cell.
+ * @param particle The particle position.
+ * @param h The kernel smoothing length of the particle.
+ * @return The mass contribution of the particle to the cell.
+ */
+double
+SPHArrayInterface::mass_contribution(const std::vector< Face > &face_vector,
+                                     const CoordinateVector<> particle,
+                                     const double h) const {
 
   double M, Msum;
 
   Msum = 0.;
   M = 0.;
 
-  std::vector< Face > face_vector = cell.get_faces();
-
   // Loop over each face of a cell.
   for (size_t i = 0; i < face_vector.size(); i++) {
 
@@ -933,8 +1269,6 @@ DensityValues SPHArrayInterface::operator()(const Cell &cell) {
 
   // time_log.start("Density_mapping");
 
-  DensityValues values;
-
   const CoordinateVector<> position = cell.get_cell_midpoint();
   double density = 0.;
 
@@ -957,43 +1291,52 @@ DensityValues SPHArrayInterface::operator()(const Cell &cell) {
       const double splineval = m * CubicSplineKernel::kernel_evaluate(u, h);
       density += splineval;
     }
-  } else if (_mapping_type == SPHARRAY_MAPPING_PETKOVA) {
-    CoordinateVector<> position = cell.get_cell_midpoint();
-
-    // Find the vertex that is furthest away from the cell midpoint.
-    std::vector< Face > face_vector = cell.get_faces();
-    double radius = 0.0;
-    for (unsigned int i = 0; i < face_vector.size(); i++) {
-      for (Face::Vertices j = face_vector[i].first_vertex();
-           j != face_vector[i].last_vertex(); ++j) {
-        double distance = (j.get_position() - position).norm();
-        if (distance > radius)
-          radius = distance;
-      }
-    }
+  } else if (_mapping_type == SPHARRAY_MAPPING_PETKOVA ||
+             _mapping_type == SPHARRAY_MAPPING_PETKOVA_SCATTER) {
+    // Divide the cell mass by the cell volume to get density. Cells that were
+    // not prepared by the scatter mapping fall back to the gather algorithm.
+    density = get_gathered_cell_mass(cell) / cell.get_volume();
+  }
 
-    // Find the neighbours that are contained inside of a sphere of centre the
-    // cell midpoint
-    // and radius given by the distance to the furthest vertex.
-    std::vector< uint_fast32_t > ngbs =
-        _octree->get_ngbs_sphere(position, radius);
-    const unsigned int numngbs = ngbs.size();
-
-    // Loop over all the neighbouring particles and calculate their mass
-    // contributions.
-    for (unsigned int i = 0; i < numngbs; i++) {
-      const unsigned int index = ngbs[i];
-      const double h = _smoothing_lengths[index] / 2.0;
-      const CoordinateVector<> particle = _positions[index];
-      if (h < 0)
-        cmac_warning("h < 0: %g, %u", h, index);
-      density += SPHArrayInterface::mass_contribution(cell, particle, h) *
-                 _masses[index];
-    }
+  return get_density_values(cell, density);
+}
 
-    // Divide the cell mass by the cell volume to get density.
-    density = density / cell.get_volume();
+/**
+ * @brief Function that gives the density for the cell with the given index in
+ * the DensityGrid that was last passed on to prepare().
+ *
+ * For the scatter mapping, this uses the cell mass computed by prepare() if
+ * the cell was part of the prepared block. All other cells are handled by
+ * operator().
+ *
+ * @param cell Geometrical information about the cell.
+ * @param index Index of the cell in the DensityGrid.
+ * @return Initial physical field values for that cell.
+ */
+DensityValues SPHArrayInterface::get_prepared_values(const Cell &cell,
+                                                     const size_t index) {
+
+  if (_mapping_type == SPHARRAY_MAPPING_PETKOVA_SCATTER &&
+      index >= _scatter_offset &&
+      index - _scatter_offset < _scatter_masses.size()) {
+    return get_density_values(
+        cell, _scatter_masses[index - _scatter_offset] / cell.get_volume());
   }
+  return (*this)(cell);
+}
+
+/**
+ * @brief Get the initial physical field values for a cell with the given
+ * density.
+ *
+ * @param cell Geometrical information about the cell.
+ * @param density Mass density of the cell (in kg m^-3).
+ * @return Initial physical field values for that cell.
+ */
+DensityValues SPHArrayInterface::get_density_values(const Cell &cell,
+                                                    double density) const {
+
+  DensityValues values;
 
   // Ensure that the density > 0
   if (density <= 0.0)
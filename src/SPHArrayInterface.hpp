@@ -34,6 +34,21 @@
 #include "Octree.hpp"
 #include "TimeLogger.hpp"
 
+/*! @brief Number of radial bins in the pre-computed gridding table. */
+#define SPHARRAYINTERFACE_GRIDDING_SIZE_R (50 + 199 + 2)
+
+/*! @brief Number of bins in each angular direction of the pre-computed
+ *  gridding table. */
+#define SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE (2 * 150 + 1)
+
+/*! @brief Maximum number of cells for which the scatter mapping stores cell
+ *  faces and per thread cell masses at the same time. */
+#define SPHARRAYINTERFACE_SCATTER_BLOCK_SIZE (1 << 10)
+
+/*! @brief Version number of the gridding table cache file format. Needs to be
+ *  increased whenever the gridding table or the file format changes. */
+#define SPHARRAYINTERFACE_GRIDDING_CACHE_VERSION 1
+
 /**
  * @brief Types of mapping that can be used to map SPH particles to grid cells.
  */
@@ -46,7 +61,11 @@ enum SPHArrayMappingType {
   SPHARRAY_MAPPING_CENTROID,
   /*! @brief Densities are assigned using the Petkova et al. (2018) algorithm
    *  that explicitly conserves mass. */
-  SPHARRAY_MAPPING_PETKOVA
+  SPHARRAY_MAPPING_PETKOVA,
+  /*! @brief Same as SPHARRAY_MAPPING_PETKOVA, but the mass contributions are
+   *  scattered from the particles onto the cells instead of gathered by the
+   *  cells from the particles. */
+  SPHARRAY_MAPPING_PETKOVA_SCATTER
 };
 
 /**
@@ -84,12 +103,40 @@ private:
   /*! @brief Neutral fractions on the positions of the SPH particles. */
   std::vector< double > _neutral_fractions;
 
-  /*! @brief Grid of pre-computed cell densities. */
-  std::vector< std::vector< std::vector< double > > > _density_values;
+  /*! @brief Grid of pre-computed cell densities, stored as one contiguous
+   *  array (radial index varies slowest). Empty if the grid was read from a
+   *  memory-mapped cache file. */
+  std::vector< double > _density_values;
+
+  /*! @brief Pointer to the grid of pre-computed cell densities (points to
+   *  either _density_values or to the memory-mapped cache file). */
+  const double *_density_values_pointer;
+
+  /*! @brief Start of the memory-mapped gridding cache file (nullptr if no
+   *  cache file is mapped). */
+  void *_gridding_cache_mapping;
+
+  /*! @brief Size of the memory-mapped gridding cache file (in bytes). */
+  size_t _gridding_cache_mapping_size;
 
   /*! @brief Octree used to speed up neighbour searching. */
   Octree *_octree;
 
+  /*! @brief Did the particle positions change since the Octree was built? */
+  bool _positions_changed;
+
+  /*! @brief Did the particle smoothing lengths change since the Octree was
+   *  built? */
+  bool _smoothing_lengths_changed;
+
+  /*! @brief Cell masses computed by the scatter mapping for the block of cells
+   *  that is currently being initialized (in kg). */
+  std::vector< double > _scatter_masses;
+
+  /*! @brief Index of the first cell in the block of cells that is currently
+   *  being initialized by the scatter mapping. */
+  size_t _scatter_offset;
+
   /*! @brief Time log used to register time consumption in various parts of the
    *  algorithm. */
   TimeLogger _time_log;
@@ -99,7 +146,7 @@ private:
    * string.
    *
    * @param type_name Type name string (valid options are: M_over_V, centroid,
-   * Petkova).
+   * Petkova, Petkova_scatter).
    * @return Corresponding SPHArrayMappingType.
    */
   inline static SPHArrayMappingType
@@ -111,12 +158,43 @@ private:
       return SPHARRAY_MAPPING_CENTROID;
     } else if (type_name == "Petkova") {
       return SPHARRAY_MAPPING_PETKOVA;
+    } else if (type_name == "Petkova_scatter") {
+      return SPHARRAY_MAPPING_PETKOVA_SCATTER;
     } else {
       cmac_error("Unknown SPHArrayMappingType: \"%s\"!", type_name.c_str());
       return SPHARRAY_MAPPING_PETKOVA;
     }
   }
 
+  /**
+   * @brief Get the radius of the sphere around the given cell midpoint that
+   * contains all vertices of the cell.
+   *
+   * @param midpoint Midpoint of the cell (in m).
+   * @param face_vector Faces of the cell.
+   * @return Distance between the midpoint and the furthest vertex (in m).
+   */
+  inline static double get_cell_radius(const CoordinateVector<> midpoint,
+                                       const std::vector< Face > &face_vector) {
+    double radius = 0.;
+    for (size_t i = 0; i < face_vector.size(); ++i) {
+      for (Face::Vertices j = face_vector[i].first_vertex();
+           j != face_vector[i].last_vertex(); ++j) {
+        const double distance = (j.get_position() - midpoint).norm();
+        if (distance > radius) {
+          radius = distance;
+        }
+      }
+    }
+    return radius;
+  }
+
+  double get_gathered_cell_mass(const Cell &cell) const;
+  DensityValues get_density_values(const Cell &cell, double density) const;
+  void scatter_sub_block(DensityGrid &grid, const size_t first_cell,
+                         const size_t number_of_cells,
+                         const int_fast32_t number_of_threads);
+
   /**
    * @brief Functor for the inverse mapping.
    */
@@ -197,7 +275,9 @@ private:
                cell.get_ionization_variables().get_ionic_fraction(ION_H_n));
           _locks[index].unlock();
         }
-      } else if (_array_interface._mapping_type == SPHARRAY_MAPPING_PETKOVA) {
+      } else if (_array_interface._mapping_type == SPHARRAY_MAPPING_PETKOVA ||
+                 _array_interface._mapping_type ==
+                     SPHARRAY_MAPPING_PETKOVA_SCATTER) {
         const CoordinateVector<> position = cell.get_cell_midpoint();
         // Find the vertex that is furthest away from the cell midpoint.
         std::vector< Face > face_vector = cell.get_faces();
@@ -252,13 +332,16 @@ private:
 public:
   SPHArrayInterface(const double unit_length_in_SI,
                     const double unit_mass_in_SI,
-                    const std::string mapping_type);
+                    const std::string mapping_type,
+                    const std::string gridding_cache_file_name = "");
   SPHArrayInterface(const double unit_length_in_SI,
                     const double unit_mass_in_SI, const double *box_anchor,
-                    const double *box_sides, const std::string mapping_type);
+                    const double *box_sides, const std::string mapping_type,
+                    const std::string gridding_cache_file_name = "");
   SPHArrayInterface(const double unit_length_in_SI,
                     const double unit_mass_in_SI, const float *box_anchor,
-                    const float *box_sides, const std::string mapping_type);
+                    const float *box_sides, const std::string mapping_type,
+                    const std::string gridding_cache_file_name = "");
   ~SPHArrayInterface();
 
   // DensityFunction functionality
@@ -270,14 +353,77 @@ public:
   void reset(const float *x, const float *y, const float *z, const float *h,
              const float *m, const size_t npart);
 
+  /**
+   * @brief Get the number of particles.
+   *
+   * @return Number of particles.
+   */
+  inline size_t get_number_of_particles() const { return _positions.size(); }
+
+  void set_number_of_particles(const size_t npart);
+
+  /**
+   * @brief Update the data values of the given range of particles.
+   *
+   * Only particles whose positions or smoothing lengths actually change force
+   * the Octree to be updated during the next initialize(): if no positions
+   * changed, the existing Octree is reused, and if no smoothing lengths changed
+   * either, the tree does not need to be touched at all.
+   *
+   * @param offset Index of the first particle to update.
+   * @param x Array containing x coordinates (in the given length unit).
+   * @param y Array containing y coordinates (in the given length unit).
+   * @param z Array containing z coordinates (in the given length unit).
+   * @param h Array containing smoothing lengths (in the given length unit).
+   * @param m Array containing masses (in the given mass unit).
+   * @param npart Number of elements in each of the arrays.
+   */
+  template < typename _position_type_, typename _property_type_ >
+  inline void update_particles(const size_t offset, const _position_type_ *x,
+                               const _position_type_ *y,
+                               const _position_type_ *z,
+                               const _property_type_ *h,
+                               const _property_type_ *m, const size_t npart) {
+
+    cmac_assert_message(offset + npart <= _positions.size(),
+                        "Particle range out of bounds!");
+
+    for (size_t i = 0; i < npart; ++i) {
+      const size_t index = offset + i;
+      const CoordinateVector<> position(x[i] * _unit_length_in_SI,
+                                        y[i] * _unit_length_in_SI,
+                                        z[i] * _unit_length_in_SI);
+      if (!(position == _positions[index])) {
+        _positions[index] = position;
+        _positions_changed = true;
+      }
+      const double smoothing_length = h[i] * _unit_length_in_SI;
+      if (smoothing_length != _smoothing_lengths[index]) {
+        _smoothing_lengths[index] = smoothing_length;
+        _smoothing_lengths_changed = true;
+      }
+      _masses[index] = m[i] * _unit_mass_in_SI;
+    }
+  }
+
   Octree *get_octree();
 
   // DensityMapping get_dens_map(){return _dens_map;}
 
   virtual void initialize();
+  virtual void prepare(DensityGrid &grid,
+                       const std::pair< size_t, size_t > &block,
+                       const int_fast32_t worksize);
   virtual DensityValues operator()(const Cell &cell);
+  virtual DensityValues get_prepared_values(const Cell &cell,
+                                            const size_t index);
 
-  void gridding();
+  void gridding(const std::string cache_file_name = "");
+
+  bool read_gridding_cache(const std::string cache_file_name);
+  void write_gridding_cache(const std::string cache_file_name) const;
+  static uint_fast64_t get_gridding_checksum(const double *values,
+                                             const size_t size);
 
   double gridded_integral(const double phi, const double cosphi,
                           const double r0_old, const double R_0_old,
@@ -289,6 +435,9 @@ public:
 
   double mass_contribution(const Cell &cell, const CoordinateVector<> particle,
                            const double h) const;
+  double mass_contribution(const std::vector< Face > &face_vector,
+                           const CoordinateVector<> particle,
+                           const double h) const;
 
   // DensityGridWriter functionality
 
@@ -310,7 +459,10 @@ public:
   inline double get_gridded_density_value(const uint_fast32_t i,
                                           const uint_fast32_t j,
                                           const uint_fast32_t k) const {
-    return _density_values[i][j][k];
+    return _density_values_pointer
+        [(i * SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE + j) *
+             SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE +
+         k];
   }
 
   virtual void write(DensitySubGridCreator< DensitySubGrid > &grid_creator,
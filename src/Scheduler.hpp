@@ -26,17 +26,53 @@
 #ifndef SCHEDULER_HPP
 #define SCHEDULER_HPP
 
+#include "AlignedAllocator.hpp"
+#include "StealPolicy.hpp"
 #include "TaskQueue.hpp"
 #include "ThreadSafeVector.hpp"
-#include "Utilities.hpp"
+#include "TravelDirections.hpp"
 
+#include <algorithm>
 #include <vector>
 
 /**
  * @brief Task scheduler responsible for scheduling and retrieving tasks.
+ *
+ * When a thread runs out of tasks in its own queue, it tries to steal a task
+ * from the queue of another thread. The order in which the other queues are
+ * tried is set by the StealPolicy:
+ *  - LargestQueue: try the queues in order of decreasing size.
+ *  - Random: try the queues in a fixed order, but starting from a random
+ *    victim.
+ *  - NUMA: try the queues of threads in the same NUMA domain first (threads
+ *    are assumed to be numbered contiguously within a domain).
+ *  - SubgridAdjacency: try the queues of threads that own the most subgrids
+ *    adjacent to subgrids owned by the stealing thread first.
+ * For all policies but LargestQueue, the victim order for each thread is
+ * computed once, and the last queue that was stolen from successfully is
+ * retried first during the next steal attempt. None of the policies allocates
+ * memory during the steal attempt.
  */
 class Scheduler {
 private:
+  /**
+   * @brief Stealing state of a single thread.
+   *
+   * The state is padded to and aligned on a cache line to avoid false
+   * sharing between threads.
+   */
+  struct alignas(64) ThreadState {
+    /*! @brief Random generator state. */
+    uint_fast64_t _random_state;
+
+    /*! @brief Queue we last stole from successfully (or the number of queues
+     *  if no such queue is known). */
+    uint_fast32_t _hint;
+
+    /*! @brief Padding. */
+    char _padding[64 - sizeof(uint_fast64_t) - sizeof(uint_fast32_t)];
+  };
+
   /*! @brief Task space. */
   ThreadSafeVector< Task > &_tasks;
 
@@ -46,6 +82,142 @@ private:
   /*! @brief General shared queue. */
   TaskQueue &_shared_queue;
 
+  /*! @brief Policy used to select the queue to steal from. */
+  const StealPolicy _steal_policy;
+
+  /*! @brief Number of thread queues. */
+  const uint_fast32_t _number_of_queues;
+
+  /*! @brief Number of elements in the block of victims of a single thread
+   *  (_number_of_queues - 1, padded to a multiple of the cache line size). */
+  const uint_fast32_t _victims_stride;
+
+  /*! @brief Number of elements in the block of queue sizes of a single
+   *  thread (_number_of_queues, padded to a multiple of the cache line
+   *  size). */
+  const uint_fast32_t _queue_sizes_stride;
+
+  /*! @brief Victim queues for each thread, in order of preference (every
+   *  thread has a block of _victims_stride elements). */
+  std::vector< uint_fast32_t, AlignedAllocator< uint_fast32_t, 64 > >
+      _victims;
+
+  /*! @brief Stealing state for each thread. */
+  std::vector< ThreadState, AlignedAllocator< ThreadState, 64 > >
+      _thread_states;
+
+  /*! @brief Scratch space used to store the queue sizes for the LargestQueue
+   *  policy (every thread has a block of _queue_sizes_stride elements). */
+  std::vector< size_t, AlignedAllocator< size_t, 64 > > _queue_sizes;
+
+  /**
+   * @brief Get the number of elements of the given type that fit in the
+   * smallest multiple of the cache line size that can hold the given number of
+   * elements.
+   *
+   * Per thread blocks of this size that start on a cache line boundary do not
+   * share cache lines with the blocks of other threads.
+   *
+   * @param number_of_elements Number of elements.
+   * @return Padded number of elements.
+   */
+  template < typename _type_ >
+  inline static uint_fast32_t
+  get_padded_size(const uint_fast32_t number_of_elements) {
+    const uint_fast32_t elements_per_line = 64 / sizeof(_type_);
+    return ((number_of_elements + elements_per_line - 1) / elements_per_line) *
+           elements_per_line;
+  }
+
+  /**
+   * @brief Get a random 64-bit integer for the given thread.
+   *
+   * Uses a xorshift64* generator.
+   *
+   * @param thread_id Calling thread.
+   * @return Random 64-bit integer.
+   */
+  inline uint_fast64_t get_random_integer(const int_fast32_t thread_id) {
+    uint_fast64_t &x = _thread_states[thread_id]._random_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    return x * 2685821657736338717ull;
+  }
+
+  /**
+   * @brief Try the queues in order of decreasing size.
+   *
+   * @param thread_id Calling thread.
+   * @return Index of a locked task, or NO_TASK if no task could be stolen.
+   */
+  inline uint_fast32_t steal_from_largest_queue(const int_fast32_t thread_id) {
+
+    // insertion sort of the queues by size
+    // we only store the queue indices; the sizes are cached in the scratch
+    // space
+    uint_fast32_t *order = &_victims[thread_id * _victims_stride];
+    size_t *sizes = &_queue_sizes[thread_id * _queue_sizes_stride];
+    uint_fast32_t number_of_victims = 0;
+    for (uint_fast32_t i = 0; i < _number_of_queues; ++i) {
+      sizes[i] = _queues[i]->size();
+      if (i != static_cast< uint_fast32_t >(thread_id) && sizes[i] > 0) {
+        uint_fast32_t j = number_of_victims;
+        while (j > 0 && sizes[order[j - 1]] < sizes[i]) {
+          order[j] = order[j - 1];
+          --j;
+        }
+        order[j] = i;
+        ++number_of_victims;
+      }
+    }
+
+    uint_fast32_t task_index = NO_TASK;
+    for (uint_fast32_t i = 0; i < number_of_victims && task_index == NO_TASK;
+         ++i) {
+      task_index = _queues[order[i]]->try_get_task(_tasks);
+    }
+    return task_index;
+  }
+
+  /**
+   * @brief Try the queues in the precomputed victim order for the given
+   * thread, starting with the last queue we successfully stole from.
+   *
+   * @param thread_id Calling thread.
+   * @return Index of a locked task, or NO_TASK if no task could be stolen.
+   */
+  inline uint_fast32_t steal_from_victims(const int_fast32_t thread_id) {
+
+    ThreadState &state = _thread_states[thread_id];
+    const uint_fast32_t hint = state._hint;
+    if (hint < _number_of_queues && _queues[hint]->size() > 0) {
+      const uint_fast32_t task_index = _queues[hint]->try_get_task(_tasks);
+      if (task_index != NO_TASK) {
+        return task_index;
+      }
+    }
+
+    const uint_fast32_t number_of_victims = _number_of_queues - 1;
+    const uint_fast32_t *victims = &_victims[thread_id * _victims_stride];
+    const uint_fast32_t offset =
+        (_steal_policy == STEALPOLICY_RANDOM)
+            ? get_random_integer(thread_id) % number_of_victims
+            : 0;
+    for (uint_fast32_t i = 0; i < number_of_victims; ++i) {
+      const uint_fast32_t victim = victims[(offset + i) % number_of_victims];
+      if (victim != hint && _queues[victim]->size() > 0) {
+        const uint_fast32_t task_index = _queues[victim]->try_get_task(_tasks);
+        if (task_index != NO_TASK) {
+          state._hint = victim;
+          return task_index;
+        }
+      }
+    }
+    state._hint = _number_of_queues;
+    return NO_TASK;
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -53,10 +225,150 @@ public:
    * @param tasks Task space.
    * @param queues Thread queues.
    * @param shared_queue Shared queue.
+   * @param steal_policy Policy used to select the queue to steal from.
+   * @param threads_per_domain Number of threads per NUMA domain (only used for
+   * the NUMA policy; 0 means all threads are in the same domain).
    */
   inline Scheduler(ThreadSafeVector< Task > &tasks,
-                   std::vector< TaskQueue * > &queues, TaskQueue &shared_queue)
-      : _tasks(tasks), _queues(queues), _shared_queue(shared_queue) {}
+                   std::vector< TaskQueue * > &queues, TaskQueue &shared_queue,
+                   const StealPolicy steal_policy = STEALPOLICY_LARGEST_QUEUE,
+                   const uint_fast32_t threads_per_domain = 0)
+      : _tasks(tasks), _queues(queues), _shared_queue(shared_queue),
+        _steal_policy(steal_policy), _number_of_queues(queues.size()),
+        _victims_stride(get_padded_size< uint_fast32_t >(
+            (_number_of_queues > 0) ? _number_of_queues - 1 : 0)),
+        _queue_sizes_stride(get_padded_size< size_t >(_number_of_queues)) {
+
+    if (_number_of_queues < 2) {
+      return;
+    }
+
+    _victims.resize(_number_of_queues * _victims_stride, 0);
+    _thread_states.resize(_number_of_queues);
+    if (_steal_policy == STEALPOLICY_LARGEST_QUEUE) {
+      _queue_sizes.resize(_number_of_queues * _queue_sizes_stride, 0);
+    }
+
+    const uint_fast32_t domain_size =
+        (threads_per_domain > 0) ? threads_per_domain : _number_of_queues;
+    for (uint_fast32_t ithread = 0; ithread < _number_of_queues; ++ithread) {
+      uint_fast32_t *victims = &_victims[ithread * _victims_stride];
+      if (_steal_policy == STEALPOLICY_NUMA) {
+        // threads in the same domain first, then the other domains, in order
+        // of increasing distance along the thread ring
+        uint_fast32_t ivictim = 0;
+        for (uint_fast32_t i = 1; i < _number_of_queues; ++i) {
+          const uint_fast32_t victim = (ithread + i) % _number_of_queues;
+          if (victim / domain_size == ithread / domain_size) {
+            victims[ivictim] = victim;
+            ++ivictim;
+          }
+        }
+        for (uint_fast32_t i = 1; i < _number_of_queues; ++i) {
+          const uint_fast32_t victim = (ithread + i) % _number_of_queues;
+          if (victim / domain_size != ithread / domain_size) {
+            victims[ivictim] = victim;
+            ++ivictim;
+          }
+        }
+      } else {
+        for (uint_fast32_t i = 1; i < _number_of_queues; ++i) {
+          victims[i - 1] = (ithread + i) % _number_of_queues;
+        }
+      }
+
+      // seed the random generator using a SplitMix64 step on the thread index
+      uint_fast64_t seed = (ithread + 1) * 0x9e3779b97f4a7c15ull;
+      seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ull;
+      seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebull;
+      _thread_states[ithread]._random_state = (seed ^ (seed >> 31)) | 1;
+      _thread_states[ithread]._hint = _number_of_queues;
+    }
+  }
+
+  /**
+   * @brief Order the victims for each thread based on the ownership of
+   * adjacent subgrids.
+   *
+   * Only has an effect for the SubgridAdjacency policy. Should be called
+   * again if the ownership of the subgrids changes significantly.
+   *
+   * @param grid_creator Grid creator containing the subgrids.
+   */
+  template < typename _grid_creator_type_ >
+  inline void set_subgrid_adjacency(_grid_creator_type_ &grid_creator) {
+
+    if (_steal_policy != STEALPOLICY_SUBGRID_ADJACENCY ||
+        _number_of_queues < 2) {
+      return;
+    }
+
+    // count the number of neighbour relations between subgrids owned by
+    // different threads
+    std::vector< uint_fast32_t > number_of_links(
+        _number_of_queues * _number_of_queues, 0);
+    const uint_fast32_t number_of_subgrids =
+        grid_creator.number_of_original_subgrids();
+    for (uint_fast32_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+      // subgrids owned by other MPI processes are not stored locally
+      if (!grid_creator.is_local(igrid)) {
+        continue;
+      }
+      const uint_fast32_t owner =
+          (*grid_creator.get_subgrid(igrid)).get_owning_thread();
+      if (owner >= _number_of_queues) {
+        continue;
+      }
+      for (int_fast32_t i = 1; i < TRAVELDIRECTION_NUMBER; ++i) {
+        const uint_fast32_t ngb =
+            (*grid_creator.get_subgrid(igrid)).get_neighbour(i);
+        if (ngb < number_of_subgrids && grid_creator.is_local(ngb)) {
+          const uint_fast32_t ngb_owner =
+              (*grid_creator.get_subgrid(ngb)).get_owning_thread();
+          if (ngb_owner != owner && ngb_owner < _number_of_queues) {
+            ++number_of_links[owner * _number_of_queues + ngb_owner];
+          }
+        }
+      }
+    }
+
+    // sort the victims: most links first, ties are broken by the distance
+    // along the thread ring
+    const uint_fast32_t number_of_victims = _number_of_queues - 1;
+    for (uint_fast32_t ithread = 0; ithread < _number_of_queues; ++ithread) {
+      uint_fast32_t *victims = &_victims[ithread * _victims_stride];
+      for (uint_fast32_t i = 1; i < _number_of_queues; ++i) {
+        victims[i - 1] = (ithread + i) % _number_of_queues;
+      }
+      const uint_fast32_t *links =
+          &number_of_links[ithread * _number_of_queues];
+      std::stable_sort(victims, victims + number_of_victims,
+                       [links](const uint_fast32_t a, const uint_fast32_t b) {
+                         return links[a] > links[b];
+                       });
+      _thread_states[ithread]._hint = _number_of_queues;
+    }
+  }
+
+  /**
+   * @brief Try to steal a task from the queue of another thread.
+   *
+   * @param thread_id Calling thread.
+   * @return Index of a locked task that is ready for execution, or NO_TASK if
+   * no eligible task could be found.
+   */
+  inline uint_fast32_t steal_task(const int_fast32_t thread_id) {
+
+    if (_number_of_queues < 2) {
+      return NO_TASK;
+    }
+
+    if (_steal_policy == STEALPOLICY_LARGEST_QUEUE) {
+      return steal_from_largest_queue(thread_id);
+    } else {
+      return steal_from_victims(thread_id);
+    }
+  }
 
   /**
    * @brief Get a task from one of the queues.
@@ -71,22 +383,8 @@ public:
     if (task_index == NO_TASK) {
 
       // try to steal a task from another thread's queue
+      task_index = steal_task(thread_id);
 
-      // sort the queues by size
-      std::vector< size_t > queue_sizes(_queues.size(), 0);
-      for (size_t i = 0; i < _queues.size(); ++i) {
-        queue_sizes[i] = _queues[i]->size();
-      }
-      std::vector< uint_fast32_t > sorti = Utilities::argsort(queue_sizes);
-
-      // now try to steal from the largest queue first
-      uint_fast32_t i = 0;
-      while (task_index == NO_TASK && i < queue_sizes.size() &&
-             queue_sizes[sorti[queue_sizes.size() - i - 1]] > 0) {
-        task_index =
-            _queues[sorti[queue_sizes.size() - i - 1]]->try_get_task(_tasks);
-        ++i;
-      }
       if (task_index == NO_TASK) {
         // get a task from the shared queue
         task_index = _shared_queue.get_task(_tasks);
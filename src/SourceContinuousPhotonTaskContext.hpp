@@ -91,6 +91,9 @@ private:
   /*! @brief Locks for the buffers. */
   std::vector< ThreadLock > &_continuous_source_lock;
 
+  /*! @brief Iteration number, used to select random number streams. */
+  const uint_fast32_t _iteration;
+
 public:
   /**
    * @brief Constructor.
@@ -111,6 +114,7 @@ public:
    * @param number_of_continuous_photons Number of continuous photon packets
    * to emit.
    * @param continuous_source_lock Locks for the buffers.
+   * @param iteration Iteration number, used to select random number streams.
    */
   inline SourceContinuousPhotonTaskContext(
       ContinuousPhotonSource &continuous_photon_source, MemorySpace &buffers,
@@ -123,7 +127,8 @@ public:
       std::vector< std::vector< PhotonBuffer > > &continuous_buffers,
       std::vector< TaskQueue * > &queues, TaskQueue &shared_queue,
       const uint_fast32_t number_of_continuous_photons,
-      std::vector< ThreadLock > &continuous_source_lock)
+      std::vector< ThreadLock > &continuous_source_lock,
+      const uint_fast32_t iteration = 0)
       : _continuous_photon_source(continuous_photon_source), _buffers(buffers),
         _random_generators(random_generators),
         _continuous_photon_weight(continuous_photon_weight),
@@ -134,7 +139,8 @@ public:
         _shared_queue(shared_queue),
         _number_of_continuous_photons(number_of_continuous_photons),
         _continuous_photons_flushed(0),
-        _continuous_source_lock(continuous_source_lock) {}
+        _continuous_source_lock(continuous_source_lock),
+        _iteration(iteration) {}
 
   /**
    * @brief Execute a continuous photon source task.
@@ -154,10 +160,19 @@ public:
 
     const uint_fast32_t source_copy = task.get_subgrid();
     const size_t num_photon_this_loop = task.get_buffer();
+    const size_t photon_offset = task.get_photon_offset();
 
     // draw random photons and store them in the continuous buffers
     for (uint_fast32_t i = 0; i < num_photon_this_loop; ++i) {
 
+      // select the random number stream for this photon packet (only has an
+      // effect for counter-based generators); continuous photon packets use
+      // the largest possible source index, which is never used by discrete
+      // sources
+      const uint_fast64_t stream_index =
+          RandomGenerator::get_stream_index(0xffffffff, photon_offset + i);
+      _random_generators[thread_id].set_stream(_iteration, stream_index);
+
       auto posdir = _continuous_photon_source.get_random_incoming_direction(
           _random_generators[thread_id]);
 
@@ -172,6 +187,7 @@ public:
 
       photon.set_type(PHOTONTYPE_PRIMARY);
       photon.set_scatter_counter(0);
+      photon.set_stream_index(stream_index);
 
       // initial position: we currently assume a single source at the
       // origin
@@ -68,6 +68,9 @@ private:
   /*! @brief Task space. */
   ThreadSafeVector< Task > &_tasks;
 
+  /*! @brief Iteration number, used to select random number streams. */
+  const uint_fast32_t _iteration;
+
 public:
   /**
    * @brief Constructor.
@@ -82,6 +85,7 @@ public:
    * @param cross_sections Cross sections for photoionization.
    * @param grid_creator Grid creator.
    * @param tasks Task space.
+   * @param iteration Iteration number, used to select random number streams.
    */
   inline SourceDiscretePhotonTaskContext(
       DistributedPhotonSource< _subgrid_type_ > &photon_source,
@@ -90,13 +94,13 @@ public:
       PhotonSourceSpectrum &photon_source_spectrum,
       const Abundances &abundances, CrossSections &cross_sections,
       DensitySubGridCreator< _subgrid_type_ > &grid_creator,
-      ThreadSafeVector< Task > &tasks)
+      ThreadSafeVector< Task > &tasks, const uint_fast32_t iteration = 0)
       : _photon_source(photon_source), _buffers(buffers),
         _random_generators(random_generators),
         _discrete_photon_weight(discrete_photon_weight),
         _photon_source_spectrum(photon_source_spectrum),
         _abundances(abundances), _cross_sections(cross_sections),
-        _grid_creator(grid_creator), _tasks(tasks) {}
+        _grid_creator(grid_creator), _tasks(tasks), _iteration(iteration) {}
 
   /**
    * @brief Execute a discrete photon source task.
@@ -117,6 +121,7 @@ public:
     const size_t source_index = task.get_subgrid();
 
     const size_t num_photon_this_loop = task.get_buffer();
+    const size_t photon_offset = task.get_photon_offset();
     const size_t subgrid_index = _photon_source.get_subgrid(source_index);
 
     // get a free photon buffer in the central queue
@@ -136,6 +141,13 @@ public:
 
       PhotonPacket &photon = input_buffer[i];
 
+      // select the random number stream for this photon packet (only has an
+      // effect for counter-based generators)
+      const uint_fast64_t stream_index =
+          RandomGenerator::get_stream_index(source_index, photon_offset + i);
+      _random_generators[thread_id].set_stream(_iteration, stream_index);
+      photon.set_stream_index(stream_index);
+
       photon.set_type(PHOTONTYPE_PRIMARY);
       photon.set_scatter_counter(0);
 
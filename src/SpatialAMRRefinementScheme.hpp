@@ -44,6 +44,30 @@ private:
   /*! @brief Maximum refinement level. */
   const uint_fast8_t _max_level;
 
+  /**
+   * @brief Check if the given cell should be refined.
+   *
+   * @tparam _cell_iterator_ Cell iterator type.
+   * @param level Current refinement level of the cell.
+   * @param cell Iterator pointing to a cell (DensityGrid::iterator or
+   * DensitySubGrid::iterator).
+   * @return True if the cell should be refined.
+   */
+  template < typename _cell_iterator_ >
+  inline bool refine_cell(uint_fast8_t level, _cell_iterator_ &cell) const {
+
+    const CoordinateVector<> midpoint = cell.get_cell_midpoint();
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+      if (midpoint[i] < _refinement_zone.get_anchor()[i] ||
+          midpoint[i] > _refinement_zone.get_anchor()[i] +
+                            _refinement_zone.get_sides()[i]) {
+        return false;
+      }
+    }
+
+    return level < _max_level;
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -101,17 +125,19 @@ public:
    * @return True if the cell should be refined.
    */
   virtual bool refine(uint_fast8_t level, DensityGrid::iterator &cell) const {
+    return refine_cell(level, cell);
+  }
 
-    const CoordinateVector<> midpoint = cell.get_cell_midpoint();
-    for (uint_fast8_t i = 0; i < 3; ++i) {
-      if (midpoint[i] < _refinement_zone.get_anchor()[i] ||
-          midpoint[i] > _refinement_zone.get_anchor()[i] +
-                            _refinement_zone.get_sides()[i]) {
-        return false;
-      }
-    }
-
-    return level < _max_level;
+  /**
+   * @brief Check if the given cell should be refined.
+   *
+   * @param level Current refinement level of the cell.
+   * @param cell DensitySubGrid::iterator pointing to a cell.
+   * @return True if the cell should be refined.
+   */
+  virtual bool refine(uint_fast8_t level,
+                      DensitySubGrid::iterator &cell) const {
+    return refine_cell(level, cell);
   }
 };
 
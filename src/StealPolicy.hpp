@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file StealPolicy.hpp
+ *
+ * @brief Policies used by the Scheduler to select the queue to steal from.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef STEALPOLICY_HPP
+#define STEALPOLICY_HPP
+
+#include "Error.hpp"
+
+#include <string>
+
+/**
+ * @brief Policies used by the Scheduler to select the queue to steal from.
+ */
+enum StealPolicy {
+  /*! @brief Try the queues in order of decreasing size (original behaviour).
+   */
+  STEALPOLICY_LARGEST_QUEUE = 0,
+  /*! @brief Try the queues starting from a random victim. */
+  STEALPOLICY_RANDOM,
+  /*! @brief Try the queues of threads in the same NUMA domain first. */
+  STEALPOLICY_NUMA,
+  /*! @brief Try the queues of threads that own subgrids adjacent to the
+   *  subgrids owned by the stealing thread first. */
+  STEALPOLICY_SUBGRID_ADJACENCY,
+  /*! @brief StealPolicy counter. */
+  STEALPOLICY_NUMBER
+};
+
+/**
+ * @brief Get the StealPolicy corresponding to the given name.
+ *
+ * @param name Name of a steal policy, as it appears in the parameter file.
+ * @return Corresponding StealPolicy.
+ */
+static inline StealPolicy get_steal_policy(const std::string name) {
+
+  if (name == "LargestQueue") {
+    return STEALPOLICY_LARGEST_QUEUE;
+  } else if (name == "Random") {
+    return STEALPOLICY_RANDOM;
+  } else if (name == "NUMA") {
+    return STEALPOLICY_NUMA;
+  } else if (name == "SubgridAdjacency") {
+    return STEALPOLICY_SUBGRID_ADJACENCY;
+  } else {
+    cmac_error("Unknown steal policy: %s!", name.c_str());
+    return STEALPOLICY_NUMBER;
+  }
+}
+
+#endif // STEALPOLICY_HPP
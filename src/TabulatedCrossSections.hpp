@@ -0,0 +1,254 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file TabulatedCrossSections.hpp
+ *
+ * @brief CrossSections implementation that interpolates on a precomputed table
+ * of another CrossSections implementation.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef TABULATEDCROSSSECTIONS_HPP
+#define TABULATEDCROSSSECTIONS_HPP
+
+#include "CrossSections.hpp"
+#include "Error.hpp"
+#include "Log.hpp"
+#include "ParameterFile.hpp"
+
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief CrossSections implementation that interpolates on a precomputed table
+ * of another CrossSections implementation.
+ *
+ * The cross sections for all ions are tabulated on a regular frequency grid
+ * and linearly interpolated. The grid is refined (by repeatedly halving the
+ * grid spacing) until the relative difference between the interpolated and
+ * the exact cross section in the middle of each interval is below the given
+ * tolerance. Intervals where this is not possible, because the exact cross
+ * section is discontinuous (e.g. at ionization thresholds), are flagged and
+ * use the exact cross section instead. Frequencies outside the tabulated
+ * range also use the exact cross section. The table size is capped so that it
+ * stays cache resident; the constructor aborts if the tolerance cannot be
+ * reached within that cap.
+ */
+class TabulatedCrossSections : public CrossSections {
+private:
+  /*! @brief Exact cross sections. */
+  const CrossSections *_exact_cross_sections;
+
+  /*! @brief Minimum tabulated frequency (in Hz). */
+  const double _minimum_frequency;
+
+  /*! @brief Maximum tabulated frequency (in Hz). */
+  const double _maximum_frequency;
+
+  /*! @brief Number of frequency points in the table. */
+  uint_fast32_t _number_of_points;
+
+  /*! @brief Inverse frequency spacing of the table (in Hz^-1). */
+  double _inverse_frequency_step;
+
+  /*! @brief Tabulated cross sections (ion major order, in m^2). */
+  std::vector< double > _cross_sections;
+
+  /*! @brief Flags for intervals that use the exact cross section instead of
+   *  interpolation (ion major order). */
+  std::vector< bool > _use_exact;
+
+  /**
+   * @brief Fill the table and interval flags for the given number of points.
+   *
+   * @param number_of_points Number of frequency points.
+   * @param tolerance Required relative accuracy in the middle of an interval.
+   * @return Number of intervals that did not reach the required accuracy.
+   */
+  inline uint_fast32_t fill_table(const uint_fast32_t number_of_points,
+                                  const double tolerance) {
+
+    _number_of_points = number_of_points;
+    const double frequency_step =
+        (_maximum_frequency - _minimum_frequency) / (number_of_points - 1);
+    _inverse_frequency_step = 1. / frequency_step;
+
+    _cross_sections.resize(NUMBER_OF_IONNAMES * number_of_points);
+    _use_exact.assign(NUMBER_OF_IONNAMES * (number_of_points - 1), false);
+    uint_fast32_t number_of_bad_intervals = 0;
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      double *table = &_cross_sections[ion * number_of_points];
+      for (uint_fast32_t i = 0; i < number_of_points; ++i) {
+        table[i] = _exact_cross_sections->get_cross_section(
+            ion, _minimum_frequency + i * frequency_step);
+      }
+      for (uint_fast32_t i = 0; i < number_of_points - 1; ++i) {
+        const double exact = _exact_cross_sections->get_cross_section(
+            ion, _minimum_frequency + (i + 0.5) * frequency_step);
+        const double interpolated = 0.5 * (table[i] + table[i + 1]);
+        if (std::abs(interpolated - exact) > tolerance * std::abs(exact)) {
+          _use_exact[ion * (number_of_points - 1) + i] = true;
+          ++number_of_bad_intervals;
+        }
+      }
+    }
+    return number_of_bad_intervals;
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param exact_cross_sections Exact cross sections. Memory management for
+   * this pointer is taken over by this class.
+   * @param minimum_frequency Minimum tabulated frequency (in Hz).
+   * @param maximum_frequency Maximum tabulated frequency (in Hz).
+   * @param tolerance Required relative accuracy of the interpolated cross
+   * sections.
+   * @param maximum_number_of_points Maximum number of frequency points in the
+   * table. It is an error if the tolerance requires more points.
+   * @param log Log to write logging info to.
+   */
+  inline TabulatedCrossSections(const CrossSections *exact_cross_sections,
+                                const double minimum_frequency,
+                                const double maximum_frequency,
+                                const double tolerance,
+                                const uint_fast32_t maximum_number_of_points,
+                                Log *log = nullptr)
+      : _exact_cross_sections(exact_cross_sections),
+        _minimum_frequency(minimum_frequency),
+        _maximum_frequency(maximum_frequency) {
+
+    if (maximum_frequency <= minimum_frequency) {
+      cmac_error("Invalid frequency range for tabulated cross sections: [%g, "
+                 "%g] Hz!",
+                 minimum_frequency, maximum_frequency);
+    }
+    if (maximum_number_of_points < 2) {
+      cmac_error("Tabulated cross sections need at least 2 points!");
+    }
+
+    // refine the table until all intervals are accurate enough, or until
+    // refining no longer reduces the number of inaccurate intervals: those
+    // contain discontinuities and use the exact cross section
+    // if refining beyond the maximum number of points would still help, the
+    // requested accuracy cannot be reached within the table size limit
+    uint_fast32_t number_of_points =
+        std::min< uint_fast32_t >(1001, maximum_number_of_points);
+    uint_fast32_t number_of_bad_intervals =
+        fill_table(number_of_points, tolerance);
+    while (number_of_bad_intervals > 0) {
+      const uint_fast32_t old_number_of_bad_intervals =
+          number_of_bad_intervals;
+      const uint_fast32_t refined_number_of_points = 2 * number_of_points - 1;
+      number_of_bad_intervals =
+          fill_table(refined_number_of_points, tolerance);
+      if (number_of_bad_intervals >= old_number_of_bad_intervals) {
+        break;
+      }
+      if (refined_number_of_points > maximum_number_of_points) {
+        cmac_error("Tabulated cross sections need more than %" PRIuFAST32
+                   " frequency points to reach a relative accuracy of %g!",
+                   maximum_number_of_points, tolerance);
+      }
+      number_of_points = refined_number_of_points;
+    }
+    if (_number_of_points != number_of_points) {
+      // the last refinement did not help: go back to the coarser table
+      number_of_bad_intervals = fill_table(number_of_points, tolerance);
+    }
+
+    if (log) {
+      log->write_status("Tabulated cross sections using ", _number_of_points,
+                        " frequency points, ", number_of_bad_intervals,
+                        " intervals use exact cross sections.");
+    }
+  }
+
+  /**
+   * @brief ParameterFile constructor.
+   *
+   * Parameters are:
+   *  - minimum frequency: Minimum tabulated frequency (default: 13.6 eV)
+   *  - maximum frequency: Maximum tabulated frequency (default: 54.4 eV)
+   *  - tolerance: Required relative accuracy of the interpolated cross
+   *    sections (default: 1.e-4)
+   *  - maximum number of points: Maximum number of frequency points in the
+   *    table; the run aborts if the tolerance requires more points (default:
+   *    4001, i.e. 32 KB per ion)
+   *
+   * @param exact_cross_sections Exact cross sections. Memory management for
+   * this pointer is taken over by this class.
+   * @param params ParameterFile to read from.
+   * @param log Log to write logging info to.
+   */
+  inline TabulatedCrossSections(const CrossSections *exact_cross_sections,
+                                ParameterFile &params, Log *log = nullptr)
+      : TabulatedCrossSections(
+            exact_cross_sections,
+            params.get_physical_value< QUANTITY_FREQUENCY >(
+                "CrossSections:minimum frequency", "13.6 eV"),
+            params.get_physical_value< QUANTITY_FREQUENCY >(
+                "CrossSections:maximum frequency", "54.4 eV"),
+            params.get_value< double >("CrossSections:tolerance", 1.e-4),
+            params.get_value< uint_fast32_t >(
+                "CrossSections:maximum number of points", 4001),
+            log) {}
+
+  /**
+   * @brief Destructor.
+   */
+  virtual ~TabulatedCrossSections() { delete _exact_cross_sections; }
+
+  /**
+   * @brief Get the number of frequency points in the table.
+   *
+   * @return Number of frequency points.
+   */
+  inline uint_fast32_t get_number_of_points() const {
+    return _number_of_points;
+  }
+
+  /**
+   * @brief Get the photoionization cross section for the given ion at the
+   * given photon energy.
+   *
+   * @param ion IonName for a valid ion.
+   * @param energy Photon frequency (in Hz).
+   * @return Photoionization cross section (in m^2).
+   */
+  virtual double get_cross_section(const int_fast32_t ion,
+                                   const double energy) const {
+
+    const double x = (energy - _minimum_frequency) * _inverse_frequency_step;
+    if (x < 0. || x >= _number_of_points - 1) {
+      return _exact_cross_sections->get_cross_section(ion, energy);
+    }
+    const uint_fast32_t i = x;
+    if (_use_exact[ion * (_number_of_points - 1) + i]) {
+      return _exact_cross_sections->get_cross_section(ion, energy);
+    }
+    const double f = x - i;
+    const double *table = &_cross_sections[ion * _number_of_points];
+    return (1. - f) * table[i] + f * table[i + 1];
+  }
+};
+
+#endif // TABULATEDCROSSSECTIONS_HPP
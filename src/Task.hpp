@@ -73,6 +73,11 @@ enum TaskType {
   TASKTYPE_UPDATE_CONSERVED,
   /*! @brief Do a primitive variable update sweep. */
   TASKTYPE_UPDATE_PRIMITIVES,
+  /*! @brief Do a fused slope limiter, primitive variable prediction and
+   *  internal flux sweep. */
+  TASKTYPE_LIMIT_PREDICT_FLUXSWEEP_INTERNAL,
+  /*! @brief Do a fused conserved and primitive variable update sweep. */
+  TASKTYPE_UPDATE_CONSERVED_PRIMITIVES,
   /*! @brief Flush the continuous source photon buffers at the end of the photon
    *  packet creation phase of the iteration. */
   TASKTYPE_FLUSH_CONTINUOUS_PHOTON_BUFFERS,
@@ -97,6 +102,10 @@ private:
   /*! @brief Direction of interaction (used by hydro tasks). */
   int_least8_t _interaction_direction;
 
+  /*! @brief Index of the first photon packet generated by this task (used by
+   *  photon source tasks). */
+  size_t _photon_offset;
+
   /*! @brief Number of unfinished parent tasks. */
   AtomicValue< uint_least8_t > _number_of_unfinished_parents;
 
@@ -372,6 +381,22 @@ public:
     _interaction_direction = interaction_direction;
   }
 
+  /**
+   * @brief Get the index of the first photon packet generated by this task.
+   *
+   * @return Photon offset.
+   */
+  inline size_t get_photon_offset() const { return _photon_offset; }
+
+  /**
+   * @brief Set the index of the first photon packet generated by this task.
+   *
+   * @param photon_offset Photon offset.
+   */
+  inline void set_photon_offset(const size_t photon_offset) {
+    _photon_offset = photon_offset;
+  }
+
 #ifdef TASK_PLOT
   /**
    * @brief Get all information necessary to write the task to an output file.
@@ -25,6 +25,7 @@
  */
 
 #include "TaskBasedIonizationSimulation.hpp"
+#include "AMRRefinementSchemeFactory.hpp"
 #include "AbundanceModelFactory.hpp"
 #include "ContinuousPhotonSourceFactory.hpp"
 #include "CrossSectionsFactory.hpp"
@@ -35,9 +36,12 @@
 #include "DiffuseReemissionHandlerFactory.hpp"
 #include "DistributedPhotonSource.hpp"
 #include "FlushContinuousPhotonBuffersTaskContext.hpp"
+#include "IterationConvergenceController.hpp"
+#include "MPICommunicator.hpp"
 #include "MemorySpace.hpp"
 #include "OpenMP.hpp"
 #include "ParameterFile.hpp"
+#include "PhotonBufferCommunicator.hpp"
 #include "PhotonPacketStatistics.hpp"
 #include "PhotonReemitTaskContext.hpp"
 #include "PhotonSourceDistributionFactory.hpp"
@@ -55,6 +59,7 @@
 #include "TemperatureCalculator.hpp"
 #include "ThreadStats.hpp"
 #include "TrackerManager.hpp"
+#include "Utilities.hpp"
 
 #include <fstream>
 #include <sstream>
@@ -72,6 +77,37 @@
 /*! @brief Uncomment to enable stop condition output. */
 //#define OUTPUT_STOP_CONDITION
 
+/**
+ * @brief Get the name of an output file that is written by every process.
+ *
+ * If more than one MPI process is used, the rank of the process is added to
+ * the file name, so that processes do not overwrite each other's files.
+ *
+ * @param filename Name of the file.
+ * @param rank Rank of the local MPI process.
+ * @param size Total number of MPI processes.
+ * @return Name of the file for the local process.
+ */
+inline std::string get_process_filename(const std::string filename,
+                                        const int_fast32_t rank,
+                                        const int_fast32_t size) {
+
+  if (size == 1) {
+    return filename;
+  }
+
+  const size_t extension_position = filename.rfind('.');
+  std::stringstream process_filename;
+  process_filename << filename.substr(0, extension_position) << "_rank";
+  process_filename.fill('0');
+  process_filename.width(3);
+  process_filename << rank;
+  if (extension_position != std::string::npos) {
+    process_filename << filename.substr(extension_position);
+  }
+  return process_filename.str();
+}
+
 /**
  * @brief Write a file with the start and end times of all tasks.
  *
@@ -80,11 +116,14 @@
  * @param iteration_start Start CPU cycle count of the iteration on this
  * process.
  * @param iteration_end End CPU cycle count of the iteration on this process.
+ * @param rank Rank of the local MPI process.
+ * @param size Total number of MPI processes.
  */
 inline void output_tasks(const uint_fast32_t iloop,
                          ThreadSafeVector< Task > &tasks,
                          const uint_fast64_t iteration_start,
-                         const uint_fast64_t iteration_end) {
+                         const uint_fast64_t iteration_end,
+                         const int_fast32_t rank, const int_fast32_t size) {
 
   {
     // compose the file name
@@ -96,14 +135,16 @@ inline void output_tasks(const uint_fast32_t iloop,
     filename << ".txt";
 
     // now open the file
-    std::ofstream ofile(filename.str(), std::ofstream::trunc);
+    std::ofstream ofile(get_process_filename(filename.str(), rank, size),
+                        std::ofstream::trunc);
 
     ofile << "# rank\tthread\tstart\tstop\ttype\n";
 
     // write the start and end CPU cycle count
     // this is a dummy task executed by thread 0 (so that the min or max
     // thread count is not affected), but with non-existing type -1
-    ofile << "0\t0\t" << iteration_start << "\t" << iteration_end << "\t-1\n";
+    ofile << rank << "\t0\t" << iteration_start << "\t" << iteration_end
+          << "\t-1\n";
 
     // write the task info
     const size_t tsize = tasks.size();
@@ -114,8 +155,8 @@ inline void output_tasks(const uint_fast32_t iloop,
       int_fast32_t thread_id;
       uint_fast64_t start, end;
       task.get_timing_information(type, thread_id, start, end);
-      ofile << "0\t" << thread_id << "\t" << start << "\t" << end << "\t"
-            << static_cast< int_fast32_t >(type) << "\n";
+      ofile << rank << "\t" << thread_id << "\t" << start << "\t" << end
+            << "\t" << static_cast< int_fast32_t >(type) << "\n";
     }
   }
 }
@@ -126,10 +167,13 @@ inline void output_tasks(const uint_fast32_t iloop,
  * @param iloop Iteration number (added to file names).
  * @param queues Per thread queues.
  * @param general_queue General queue.
+ * @param rank Rank of the local MPI process.
+ * @param size Total number of MPI processes.
  */
 inline void output_queues(const unsigned int iloop,
                           std::vector< TaskQueue * > &queues,
-                          TaskQueue &general_queue) {
+                          TaskQueue &general_queue, const int_fast32_t rank,
+                          const int_fast32_t size) {
 
   // first compose the file name
   std::stringstream filename;
@@ -141,18 +185,19 @@ inline void output_queues(const unsigned int iloop,
 
   // now output
   // open the file
-  std::ofstream ofile(filename.str(), std::ofstream::trunc);
+  std::ofstream ofile(get_process_filename(filename.str(), rank, size),
+                      std::ofstream::trunc);
 
   ofile << "# rank\tqueue\tsize\n";
 
   // start with the general queue (-1)
-  ofile << "0\t-1\t" << general_queue.get_max_queue_size() << "\n";
+  ofile << rank << "\t-1\t" << general_queue.get_max_queue_size() << "\n";
   general_queue.reset_max_queue_size();
 
   // now do the other queues
   for (size_t i = 0; i < queues.size(); ++i) {
     TaskQueue &queue = *queues[i];
-    ofile << "0\t" << i << "\t" << queue.get_max_queue_size() << "\n";
+    ofile << rank << "\t" << i << "\t" << queue.get_max_queue_size() << "\n";
     queue.reset_max_queue_size();
   }
 }
@@ -166,9 +211,24 @@ inline void output_queues(const unsigned int iloop,
  *  - queue size per thread: Size of the queue for a single thread (default:
  *    10000)
  *  - shared queue size: Size of the shared queue (default: 100000)
+ *  - steal policy: Policy used to select the queue to steal from when a thread
+ *    runs out of tasks (LargestQueue/Random/NUMA/SubgridAdjacency, default:
+ *    LargestQueue)
+ *  - threads per NUMA domain: Number of consecutive threads that share a NUMA
+ *    domain, used by the NUMA steal policy (default: number of threads)
+ *  - batch photon traversal: Traverse the photon packets in a buffer in
+ *    lockstep batches rather than one by one (default: false)
+ *  - verify batch photon traversal: Run the batch traversal in verification
+ *    mode, producing results that are bit-compatible with the one by one
+ *    traversal (default: false)
  *  - number of tasks: Number of tasks to allocate in memory (default: 500000)
  *  - random seed: Seed used to initialize the random number generator (default:
  *    42)
+ *  - random generator: Type of random number generator to use (RANLUX/Philox,
+ *    default: RANLUX). The counter-based Philox generator uses an independent
+ *    random number stream for every photon packet, so that results do not
+ *    depend on the number of threads or the order in which tasks are executed
+ *    (on a single process)
  *  - number of iterations: Number of iterations of the photoionization
  *    algorithm to perform (default: 10)
  *  - number of photons: Number of photon packets to use for each iteration of
@@ -177,19 +237,44 @@ inline void output_queues(const unsigned int iloop,
  *  - diffuse field: Should the diffuse field be tracked? (default: false)
  *  - source copy level: Copy level for subgrids that contain a source (default:
  *    4)
+ *  - adaptive copies: Redistribute the subgrid copies and the thread ownership
+ *    of the subgrids between iterations, based on the computational cost of
+ *    the previous iteration (default: false)
+ *  - maximum copy level: Maximum copy level for adaptive copies (default:
+ *    source copy level)
+ *  - copy cost fraction: Maximum expected cost of a single subgrid copy in
+ *    adaptive mode, as a fraction of the average thread load (default: 0.5)
  *  - enable trackers: Track photon packets travelling through specific
  *    positions? (default: no)
+ *  - adaptive iterations: Stop iterating once the neutral fractions and
+ *    temperatures have converged, and adapt the number of photon packets to
+ *    the Monte Carlo noise (see IterationConvergenceController; the number of
+ *    iterations is then the maximum number of iterations, default: false)
+ *
+ * If an AMRRefinementScheme is specified (DensityGrid:AMRRefinementScheme),
+ * the refinement level of every subgrid is set using that scheme (see
+ * DensitySubGridCreator::initialize()).
+ *
+ * If an MPI communicator with more than one process is given, the subgrids are
+ * distributed over the processes (see
+ * DensitySubGridCreator::set_domain_decomposition()) and photon buffers that
+ * cross a process boundary are sent to the process that owns the target
+ * subgrid. Continuous photon sources and trackers are not supported in this
+ * mode.
  *
  * @param num_thread Number of shared memory parallel threads to use.
  * @param parameterfile_name Name of the parameter file to use.
  * @param task_plot Output task plot information?
  * @param output_initial_snapshot Output a snapshot before the initial
  * iteration?
+ * @param mpi_communicator MPI communicator object (can be a nullptr for serial
+ * runs).
  * @param log Log to write logging info to.
  */
 TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
     const int_fast32_t num_thread, const std::string parameterfile_name,
-    const bool task_plot, const bool output_initial_snapshot, Log *log)
+    const bool task_plot, const bool output_initial_snapshot,
+    MPICommunicator *mpi_communicator, Log *log)
     : _parameter_file(parameterfile_name),
       _number_of_iterations(_parameter_file.get_value< uint_fast32_t >(
           "TaskBasedIonizationSimulation:number of iterations", 10)),
@@ -199,7 +284,10 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
           "TaskBasedIonizationSimulation:source copy level", 4)),
       _simulation_box(_parameter_file),
       _abundance_model(AbundanceModelFactory::generate(_parameter_file, log)),
-      _abundances(_abundance_model->get_abundances()), _log(log),
+      _abundances(_abundance_model->get_abundances()),
+      _mpi_rank(mpi_communicator ? mpi_communicator->get_rank() : 0),
+      _mpi_size(mpi_communicator ? mpi_communicator->get_size() : 1),
+      _log(log),
       _task_plot(task_plot), _output_initial_snapshot(output_initial_snapshot) {
 
   set_number_of_threads(num_thread);
@@ -230,7 +318,8 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
   for (int_fast8_t ithread = 0; ithread < num_thread; ++ithread) {
     std::stringstream queue_name;
     queue_name << "Queue for Thread " << static_cast< int_fast32_t >(ithread);
-    _queues[ithread] = new TaskQueue(queue_size_per_thread, queue_name.str());
+    _queues[ithread] =
+        new TaskQueue(queue_size_per_thread, queue_name.str(), true);
   }
   _memory_log.finalize_entry();
   _time_log.end("thread queues");
@@ -243,6 +332,27 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
   _memory_log.finalize_entry();
   _time_log.end("shared queue");
 
+  _steal_policy = get_steal_policy(_parameter_file.get_value< std::string >(
+      "TaskBasedIonizationSimulation:steal policy", "LargestQueue"));
+  _threads_per_numa_domain = _parameter_file.get_value< uint_fast32_t >(
+      "TaskBasedIonizationSimulation:threads per NUMA domain", num_thread);
+  _batch_traversal = _parameter_file.get_value< bool >(
+      "TaskBasedIonizationSimulation:batch photon traversal", false);
+  _verify_batch_traversal = _parameter_file.get_value< bool >(
+      "TaskBasedIonizationSimulation:verify batch photon traversal", false);
+  _adaptive_copies = _parameter_file.get_value< bool >(
+      "TaskBasedIonizationSimulation:adaptive copies", false);
+  if (_adaptive_copies) {
+    _maximum_copy_level = _parameter_file.get_value< uint_fast32_t >(
+        "TaskBasedIonizationSimulation:maximum copy level",
+        _source_copy_level);
+    _copy_cost_fraction = _parameter_file.get_value< double >(
+        "TaskBasedIonizationSimulation:copy cost fraction", 0.5);
+  } else {
+    _maximum_copy_level = _source_copy_level;
+    _copy_cost_fraction = 0.5;
+  }
+
   _time_log.start("tasks");
   const size_t number_of_tasks = _parameter_file.get_value< size_t >(
       "TaskBasedIonizationSimulation:number of tasks", 500000);
@@ -254,19 +364,35 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
   _random_generators.resize(num_thread);
   const int_fast32_t random_seed = _parameter_file.get_value< int_fast32_t >(
       "TaskBasedIonizationSimulation:random seed", 42);
+  const RandomGeneratorType random_generator_type = RandomGenerator::get_type(
+      _parameter_file.get_value< std::string >(
+          "TaskBasedIonizationSimulation:random generator", "RANLUX"));
   for (uint_fast8_t ithread = 0; ithread < num_thread; ++ithread) {
-    _random_generators[ithread].set_seed(random_seed + ithread);
+    _random_generators[ithread].set_type(random_generator_type);
+    // counter-based generators select independent streams per photon packet,
+    // so all threads need to use the same seed
+    if (_random_generators[ithread].is_counter_based()) {
+      _random_generators[ithread].set_seed(random_seed);
+    } else {
+      _random_generators[ithread].set_seed(random_seed + ithread);
+    }
   }
 
   _time_log.start("grid creator");
   _grid_creator = new DensitySubGridCreator< DensitySubGrid >(
       _simulation_box.get_box(), _parameter_file);
+  if (_mpi_size > 1) {
+    _grid_creator->set_domain_decomposition(_mpi_rank, _mpi_size);
+  }
   _time_log.end("grid creator");
 
   _time_log.start("density function");
   _density_function = DensityFunctionFactory::generate(_parameter_file, _log);
   _time_log.end("density function");
 
+  _refinement_scheme =
+      AMRRefinementSchemeFactory::generate(_parameter_file, _log);
+
   // set up output
   std::string output_folder =
       Utilities::get_absolute_path(_parameter_file.get_value< std::string >(
@@ -352,14 +478,41 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
     _trackers = nullptr;
   }
 
+  if (_parameter_file.get_value< bool >(
+          "TaskBasedIonizationSimulation:adaptive iterations", false)) {
+    _convergence_controller = new IterationConvergenceController(
+        "TaskBasedIonizationSimulation", _grid_creator->number_of_cells(),
+        _number_of_photons, _parameter_file, _log);
+  } else {
+    _convergence_controller = nullptr;
+  }
+
+  if (_mpi_size > 1) {
+    if (_continuous_photon_source != nullptr) {
+      cmac_error("Continuous photon sources are not supported for distributed "
+                 "task-based simulations!");
+    }
+    if (_trackers != nullptr) {
+      cmac_error("Trackers are not supported for distributed task-based "
+                 "simulations!");
+    }
+    if (_density_grid_writer != nullptr &&
+        !_density_grid_writer->supports_distributed_output()) {
+      cmac_error("The chosen DensityGridWriter cannot write snapshots for "
+                 "distributed task-based simulations!");
+    }
+  }
+
   // we are done reading the parameter file
   // now output all parameters (also those for which default values were used)
-  const std::string usedvaluename = parameterfile_name + ".used-values";
-  std::ofstream pfile(usedvaluename);
-  _parameter_file.print_contents(pfile);
-  pfile.close();
-  if (_log) {
-    _log->write_status("Wrote used parameters to ", usedvaluename, ".");
+  if (_mpi_rank == 0) {
+    const std::string usedvaluename = parameterfile_name + ".used-values";
+    std::ofstream pfile(usedvaluename);
+    _parameter_file.print_contents(pfile);
+    pfile.close();
+    if (_log) {
+      _log->write_status("Wrote used parameters to ", usedvaluename, ".");
+    }
   }
 
   _memory_log.add_entry("parameters done");
@@ -397,18 +550,21 @@ TaskBasedIonizationSimulation::~TaskBasedIonizationSimulation() {
   }
 
   if (_task_plot) {
-    std::ofstream pfile("program_time.txt");
+    std::ofstream pfile(
+        get_process_filename("program_time.txt", _mpi_rank, _mpi_size));
     pfile << "# rank\tstart\tstop\ttime\n";
-    pfile << "0\t" << _program_start << "\t" << program_end << "\t"
-          << _total_timer.value() << "\n";
+    pfile << _mpi_rank << "\t" << _program_start << "\t" << program_end
+          << "\t" << _total_timer.value() << "\n";
   }
 
   {
-    std::ofstream mfile("memory_timeline.txt");
+    std::ofstream mfile(
+        get_process_filename("memory_timeline.txt", _mpi_rank, _mpi_size));
     _memory_log.print(mfile, true);
   }
 
-  _time_log.output("time_log.txt", false);
+  _time_log.output(get_process_filename("time_log.txt", _mpi_rank, _mpi_size),
+                   false);
 
   delete _buffers;
   for (uint_fast8_t ithread = 0; ithread < _queues.size(); ++ithread) {
@@ -418,6 +574,9 @@ TaskBasedIonizationSimulation::~TaskBasedIonizationSimulation() {
   delete _tasks;
   delete _grid_creator;
   delete _density_function;
+  if (_refinement_scheme != nullptr) {
+    delete _refinement_scheme;
+  }
   delete _density_grid_writer;
   delete _photon_source_distribution;
   delete _photon_source_spectrum;
@@ -428,6 +587,7 @@ TaskBasedIonizationSimulation::~TaskBasedIonizationSimulation() {
   delete _recombination_rates;
   delete _reemission_handler;
   delete _trackers;
+  delete _convergence_controller;
   delete _abundance_model;
 }
 
@@ -454,8 +614,12 @@ void TaskBasedIonizationSimulation::initialize(
   _time_log.start("grid");
   _memory_log.add_entry("grid");
   start_parallel_timing_block();
-  _grid_creator->initialize(*density_function);
+  _grid_creator->initialize(*density_function, _refinement_scheme);
   stop_parallel_timing_block();
+  if (_log && _refinement_scheme != nullptr) {
+    _log->write_status("Refined grid contains ",
+                       _grid_creator->number_of_cells(), " cells.");
+  }
 
   if (_log) {
     _log->write_status("Task-based structure sizes:");
@@ -463,7 +627,7 @@ void TaskBasedIonizationSimulation::initialize(
                        Utilities::human_readable_bytes(
                            (*_grid_creator->begin()).get_memory_size()));
     _log->write_status("Single cell: ", Utilities::human_readable_bytes(
-                                            sizeof(IonizationVariables)));
+                                            DENSITYSUBGRID_ELEMENT_SIZE));
     _log->write_status("PhotonBuffer: ",
                        Utilities::human_readable_bytes(sizeof(PhotonBuffer)));
   }
@@ -471,6 +635,9 @@ void TaskBasedIonizationSimulation::initialize(
 #ifdef VARIABLE_ABUNDANCES
   for (auto gridit = _grid_creator->begin();
        gridit != _grid_creator->original_end(); ++gridit) {
+    if (!_grid_creator->is_local(gridit.get_index())) {
+      continue;
+    }
     for (auto cellit = (*gridit).begin(); cellit != (*gridit).end(); ++cellit) {
       cellit.get_ionization_variables().get_abundances().set_abundances(
           _abundances);
@@ -503,7 +670,7 @@ void TaskBasedIonizationSimulation::run(
   // we are not in library mode)
   if (_density_grid_writer && _output_initial_snapshot) {
     _time_log.start("snapshot");
-    _density_grid_writer->write(*_grid_creator, 0, _parameter_file);
+    write_snapshot(*_density_grid_writer, 0);
     _time_log.end("snapshot");
   }
 
@@ -531,29 +698,7 @@ void TaskBasedIonizationSimulation::run(
   }
 
   // impose copy restrictions
-  {
-    uint_fast8_t max_level = 0;
-    const size_t levelsize = levels.size();
-    for (size_t i = 0; i < levelsize; ++i) {
-      max_level = std::max(max_level, levels[i]);
-    }
-
-    size_t ngbs[6];
-    while (max_level > 0) {
-      for (size_t i = 0; i < levelsize; ++i) {
-        if (levels[i] == max_level) {
-          const uint_fast8_t numngbs = _grid_creator->get_neighbours(i, ngbs);
-          for (uint_fast8_t ingb = 0; ingb < numngbs; ++ingb) {
-            const size_t ngbi = ngbs[ingb];
-            if (levels[ngbi] < levels[i] - 1) {
-              levels[ngbi] = levels[i] - 1;
-            }
-          }
-        }
-      }
-      --max_level;
-    }
-  }
+  _grid_creator->impose_copy_restrictions(levels);
   _memory_log.add_entry("subgrid copies");
   _grid_creator->create_copies(levels);
   _memory_log.finalize_entry();
@@ -569,7 +714,8 @@ void TaskBasedIonizationSimulation::run(
     if (_log) {
       _log->write_status("Outputting memory allocation stats to memory.txt.");
     }
-    std::ofstream mfile("memory.txt");
+    std::ofstream mfile(
+        get_process_filename("memory.txt", _mpi_rank, _mpi_size));
     _memory_log.print(mfile, false);
   }
 
@@ -609,8 +755,10 @@ void TaskBasedIonizationSimulation::run(
     continuous_photon_weight = 2. * luminosity_ratio / (luminosity_ratio + 1.);
   }
 
-  const uint_fast32_t fixed_number_of_continuous_photons =
+  uint_fast32_t fixed_number_of_continuous_photons =
       number_of_continuous_photons;
+  // number of photon packets the sources were set up for
+  uint_fast64_t source_number_of_photons = _number_of_photons;
 
   if (_photon_source_distribution != nullptr) {
     photon_source = new DistributedPhotonSource< DensitySubGrid >(
@@ -627,7 +775,8 @@ void TaskBasedIonizationSimulation::run(
 #endif
     while (igrid.value() < _grid_creator->number_of_actual_subgrids()) {
       const size_t this_igrid = igrid.post_increment();
-      if (this_igrid < _grid_creator->number_of_actual_subgrids()) {
+      if (this_igrid < _grid_creator->number_of_actual_subgrids() &&
+          _grid_creator->is_local(this_igrid)) {
         DensitySubGrid &subgrid = *_grid_creator->get_subgrid(this_igrid);
         for (int ingb = 0; ingb < TRAVELDIRECTION_NUMBER; ++ingb) {
           subgrid.set_active_buffer(ingb, NEIGHBOUR_OUTSIDE);
@@ -640,7 +789,9 @@ void TaskBasedIonizationSimulation::run(
   _time_log.end("subgrid initialisation");
 
   _time_log.start("photoionization loop");
-  for (uint_fast32_t iloop = 0; iloop < _number_of_iterations; ++iloop) {
+  // can be reduced by the convergence controller
+  uint_fast32_t number_of_iterations = _number_of_iterations;
+  for (uint_fast32_t iloop = 0; iloop < number_of_iterations; ++iloop) {
 
     std::stringstream iloopstr;
     iloopstr << "loop " << iloop;
@@ -663,7 +814,7 @@ void TaskBasedIonizationSimulation::run(
     // define photon scattering stats
     PhotonPacketStatistics statistics(5);
 
-    if (_trackers != nullptr && iloop == _number_of_iterations - 1) {
+    if (_trackers != nullptr && iloop == number_of_iterations - 1) {
       if (_log) {
         _log->write_status("Adding trackers...");
       }
@@ -675,6 +826,25 @@ void TaskBasedIonizationSimulation::run(
       }
     }
 
+    // the number of photon packets can change in between iterations (because
+    // of trackers or adaptive iterations): redistribute them over the sources
+    if (_number_of_photons != source_number_of_photons) {
+      source_number_of_photons = _number_of_photons;
+      if (photon_source != nullptr) {
+        number_of_discrete_photons = (_continuous_photon_source != nullptr)
+                                         ? (_number_of_photons >> 1)
+                                         : _number_of_photons;
+        delete photon_source;
+        photon_source = new DistributedPhotonSource< DensitySubGrid >(
+            number_of_discrete_photons, *_photon_source_distribution,
+            *_grid_creator);
+      }
+      if (_continuous_photon_source != nullptr) {
+        fixed_number_of_continuous_photons =
+            _number_of_photons - number_of_discrete_photons;
+      }
+    }
+
     // reset mean intensity counters
     {
       AtomicValue< size_t > igrid(0);
@@ -684,7 +854,8 @@ void TaskBasedIonizationSimulation::run(
 #endif
       while (igrid.value() < _grid_creator->number_of_actual_subgrids()) {
         const size_t this_igrid = igrid.post_increment();
-        if (this_igrid < _grid_creator->number_of_actual_subgrids()) {
+        if (this_igrid < _grid_creator->number_of_actual_subgrids() &&
+            _grid_creator->is_local(this_igrid)) {
           auto gridit = _grid_creator->get_subgrid(this_igrid);
           (*gridit).reset_intensities();
         }
@@ -702,7 +873,8 @@ void TaskBasedIonizationSimulation::run(
 #endif
       while (igrid.value() < _grid_creator->number_of_actual_subgrids()) {
         const size_t this_igrid = igrid.post_increment();
-        if (this_igrid < _grid_creator->number_of_actual_subgrids()) {
+        if (this_igrid < _grid_creator->number_of_actual_subgrids() &&
+            _grid_creator->is_local(this_igrid)) {
           auto gridit = _grid_creator->get_subgrid(this_igrid);
           for (auto cellit = (*gridit).begin(); cellit != (*gridit).end();
                ++cellit) {
@@ -718,6 +890,10 @@ void TaskBasedIonizationSimulation::run(
     _time_log.start("photon source tasks");
     size_t number_of_photons_done = 0;
     if (photon_source) {
+      // index of the next photon packet for each source, used to select
+      // random number streams
+      std::vector< size_t > photon_offsets(
+          photon_source->get_number_of_sources(), 0);
       while (number_of_photons_done < number_of_discrete_photons) {
         for (size_t isrc = 0; isrc < photon_source->get_number_of_sources();
              ++isrc) {
@@ -725,11 +901,17 @@ void TaskBasedIonizationSimulation::run(
           const size_t number_of_photons_this_batch =
               photon_source->get_photon_batch(isrc, PHOTONBUFFER_SIZE);
           if (number_of_photons_this_batch > 0) {
-            const size_t new_task = _tasks->get_free_element();
-            (*_tasks)[new_task].set_type(TASKTYPE_SOURCE_DISCRETE_PHOTON);
-            (*_tasks)[new_task].set_subgrid(isrc);
-            (*_tasks)[new_task].set_buffer(number_of_photons_this_batch);
-            _shared_queue->add_task(new_task);
+            // sources in subgrids owned by other processes are emitted by
+            // those processes
+            if (_grid_creator->is_local(photon_source->get_subgrid(isrc))) {
+              const size_t new_task = _tasks->get_free_element();
+              (*_tasks)[new_task].set_type(TASKTYPE_SOURCE_DISCRETE_PHOTON);
+              (*_tasks)[new_task].set_subgrid(isrc);
+              (*_tasks)[new_task].set_buffer(number_of_photons_this_batch);
+              (*_tasks)[new_task].set_photon_offset(photon_offsets[isrc]);
+              _shared_queue->add_task(new_task);
+            }
+            photon_offsets[isrc] += number_of_photons_this_batch;
             number_of_photons_done += number_of_photons_this_batch;
           }
         }
@@ -745,6 +927,7 @@ void TaskBasedIonizationSimulation::run(
         const size_t new_task = _tasks->get_free_element();
         (*_tasks)[new_task].set_type(TASKTYPE_SOURCE_CONTINUOUS_PHOTON);
         (*_tasks)[new_task].set_buffer(batch_size);
+        (*_tasks)[new_task].set_photon_offset(ibatch * batch_size);
         (*_tasks)[new_task].set_subgrid(block_index %
                                         number_of_continuous_blocks);
         (*_tasks)[new_task].set_dependency(
@@ -759,6 +942,7 @@ void TaskBasedIonizationSimulation::run(
         const size_t new_task = _tasks->get_free_element();
         (*_tasks)[new_task].set_type(TASKTYPE_SOURCE_CONTINUOUS_PHOTON);
         (*_tasks)[new_task].set_buffer(num_last_batch);
+        (*_tasks)[new_task].set_photon_offset(num_batches * batch_size);
         (*_tasks)[new_task].set_subgrid(block_index %
                                         number_of_continuous_blocks);
         (*_tasks)[new_task].set_dependency(
@@ -778,6 +962,14 @@ void TaskBasedIonizationSimulation::run(
     bool global_run_flag = true;
     AtomicValue< uint_fast32_t > num_photon_done(0);
 
+    // photon buffers that leave the subgrids owned by this process are shipped
+    // to the owning process
+    PhotonBufferCommunicator< DensitySubGrid > *communicator = nullptr;
+    if (_grid_creator->is_distributed()) {
+      communicator = new PhotonBufferCommunicator< DensitySubGrid >(
+          *_buffers, *_grid_creator, *_tasks, _queues, _number_of_photons);
+    }
+
     // create task contexts
     TaskContext *task_contexts[TASKTYPE_NUMBER] = {nullptr};
 
@@ -786,7 +978,7 @@ void TaskBasedIonizationSimulation::run(
           new SourceDiscretePhotonTaskContext< DensitySubGrid >(
               *photon_source, *_buffers, _random_generators,
               discrete_photon_weight, *_photon_source_spectrum, _abundances,
-              *_cross_sections, *_grid_creator, *_tasks);
+              *_cross_sections, *_grid_creator, *_tasks, iloop);
     }
 
     if (_continuous_photon_source) {
@@ -796,7 +988,7 @@ void TaskBasedIonizationSimulation::run(
               continuous_photon_weight, *_continuous_photon_source_spectrum,
               _abundances, *_cross_sections, *_grid_creator, *_tasks,
               continuous_buffers, _queues, *_shared_queue,
-              number_of_continuous_photons, continuous_source_lock);
+              number_of_continuous_photons, continuous_source_lock, iloop);
       task_contexts[TASKTYPE_FLUSH_CONTINUOUS_PHOTON_BUFFERS] =
           new FlushContinuousPhotonBuffersTaskContext(
               *_buffers, *_grid_creator, *_tasks, continuous_buffers, _queues);
@@ -806,18 +998,23 @@ void TaskBasedIonizationSimulation::run(
       task_contexts[TASKTYPE_PHOTON_REEMIT] =
           new PhotonReemitTaskContext< DensitySubGrid >(
               *_buffers, _random_generators, *_reemission_handler, _abundances,
-              *_cross_sections, *_grid_creator, *_tasks, num_photon_done);
+              *_cross_sections, *_grid_creator, *_tasks, num_photon_done,
+              iloop);
     }
 
     task_contexts[TASKTYPE_PHOTON_TRAVERSAL] =
         new PhotonTraversalTaskContext< DensitySubGrid >(
             *_buffers, *_grid_creator, *_tasks, num_photon_done, &statistics,
-            _reemission_handler != nullptr);
+            _reemission_handler != nullptr, _batch_traversal,
+            _verify_batch_traversal, communicator);
 
     PrematureLaunchTaskContext< DensitySubGrid > premature_launch(
-        *_buffers, *_grid_creator, *_tasks, _queues, *_shared_queue);
+        *_buffers, *_grid_creator, *_tasks, _queues, *_shared_queue,
+        communicator);
 
-    Scheduler scheduler(*_tasks, _queues, *_shared_queue);
+    Scheduler scheduler(*_tasks, _queues, *_shared_queue, _steal_policy,
+                        _threads_per_numa_domain);
+    scheduler.set_subgrid_adjacency(*_grid_creator);
 
     start_parallel_timing_block();
 #ifdef HAVE_OPENMP
@@ -838,6 +1035,9 @@ void TaskBasedIonizationSimulation::run(
       while (global_run_flag) {
 
         if (current_index == NO_TASK) {
+          if (communicator != nullptr) {
+            communicator->communicate(num_photon_done);
+          }
           premature_launch.execute();
           current_index = scheduler.get_task(thread_id);
         }
@@ -881,8 +1081,12 @@ void TaskBasedIonizationSimulation::run(
           current_index = scheduler.get_task(thread_id);
         }
 
+        // for distributed runs, the photon packets that were terminated on
+        // this process are only a part of the total
         if (_buffers->is_empty() &&
-            num_photon_done.value() == _number_of_photons) {
+            ((communicator == nullptr &&
+              num_photon_done.value() == _number_of_photons) ||
+             (communicator != nullptr && communicator->is_finished()))) {
           global_run_flag = false;
         } else {
           current_index = scheduler.get_task(thread_id);
@@ -894,6 +1098,7 @@ void TaskBasedIonizationSimulation::run(
       }
     } // parallel region
     stop_parallel_timing_block();
+    delete communicator;
     _time_log.end("photon propagation");
 
     _time_log.start("update copies");
@@ -901,7 +1106,7 @@ void TaskBasedIonizationSimulation::run(
     _grid_creator->update_original_counters();
     stop_parallel_timing_block();
     _time_log.end("update copies");
-    if (iloop == _number_of_iterations - 1) {
+    if (iloop == number_of_iterations - 1) {
       statistics.print_stats();
     }
     _photon_propagation_timer.stop();
@@ -920,7 +1125,8 @@ void TaskBasedIonizationSimulation::run(
 #endif
       while (igrid.value() < _grid_creator->number_of_original_subgrids()) {
         const size_t this_igrid = igrid.post_increment();
-        if (this_igrid < _grid_creator->number_of_original_subgrids()) {
+        if (this_igrid < _grid_creator->number_of_original_subgrids() &&
+            _grid_creator->is_local(this_igrid)) {
           auto gridit = _grid_creator->get_subgrid(this_igrid);
 
           const size_t itask = _tasks->get_free_element();
@@ -966,6 +1172,44 @@ void TaskBasedIonizationSimulation::run(
 
     _cell_update_timer.stop();
 
+    if (_convergence_controller != nullptr) {
+      _time_log.start("convergence check");
+      // refined subgrids contain more cells, so we cannot assume that all
+      // subgrids have the same number of cells
+      const std::vector< uint_fast64_t > cell_offsets =
+          _grid_creator->get_cell_offsets();
+      for (auto gridit = _grid_creator->begin();
+           gridit != _grid_creator->original_end(); ++gridit) {
+        if (!_grid_creator->is_local(gridit.get_index())) {
+          continue;
+        }
+        const uint_fast64_t offset = cell_offsets[gridit.get_index()];
+        for (auto cellit = (*gridit).begin(); cellit != (*gridit).end();
+             ++cellit) {
+          const IonizationVariables &vars = cellit.get_ionization_variables();
+          _convergence_controller->add_cell(
+              offset + cellit.get_index(),
+              vars.get_number_density() * cellit.get_volume(),
+              vars.get_ionic_fraction(ION_H_n), vars.get_temperature());
+        }
+      }
+#ifdef HAVE_MPI
+      if (_grid_creator->is_distributed()) {
+        _convergence_controller->reduce();
+      }
+#endif
+      _number_of_photons =
+          _convergence_controller->end_iteration(iloop, _number_of_photons);
+      if (_convergence_controller->has_converged()) {
+        // trackers are only added during the last iteration, so we need one
+        // more iteration if we have them
+        number_of_iterations =
+            std::min(number_of_iterations,
+                     (_trackers != nullptr) ? iloop + 2 : iloop + 1);
+      }
+      _time_log.end("convergence check");
+    }
+
     // output diagnostic information
     {
       uint_fast64_t early_iteration_end;
@@ -979,7 +1223,9 @@ void TaskBasedIonizationSimulation::run(
       filename << ".txt";
 
       // now open the file
-      std::ofstream ofile(filename.str(), std::ofstream::trunc);
+      std::ofstream ofile(
+          get_process_filename(filename.str(), _mpi_rank, _mpi_size),
+          std::ofstream::trunc);
       ofile << "iteration:\n";
       ofile << "  start: " << iteration_start << "\n";
       ofile << "  end: " << early_iteration_end << "\n";
@@ -1028,9 +1274,56 @@ void TaskBasedIonizationSimulation::run(
       ofile << "subgrids:\n";
       for (auto it = _grid_creator->begin(); it != _grid_creator->all_end();
            ++it) {
+        if (!_grid_creator->is_local(it.get_index())) {
+          continue;
+        }
         ofile << "  subgrid " << it.get_index() << ": "
               << (*it).get_computational_cost() << "\n";
-        (*it).reset_computational_cost();
+      }
+    }
+
+    // redistribute the subgrid copies for the next iteration
+    if (_adaptive_copies && iloop < number_of_iterations - 1) {
+      _time_log.start("copy rebalancing");
+      double old_imbalance, new_imbalance;
+      const bool copies_changed = _grid_creator->rebalance_copies(
+          _maximum_copy_level, _copy_cost_fraction, _queues.size(),
+          old_imbalance, new_imbalance);
+      if (copies_changed) {
+        // the photon source stores the copy indices of the source subgrids
+        if (photon_source != nullptr) {
+          delete photon_source;
+          photon_source = new DistributedPhotonSource< DensitySubGrid >(
+              number_of_discrete_photons, *_photon_source_distribution,
+              *_grid_creator);
+        }
+        // new copies have no active buffers yet
+        for (size_t igrid = _grid_creator->number_of_original_subgrids();
+             igrid < _grid_creator->number_of_actual_subgrids(); ++igrid) {
+          if (_grid_creator->is_local(igrid)) {
+            DensitySubGrid &subgrid = *_grid_creator->get_subgrid(igrid);
+            for (int ingb = 0; ingb < TRAVELDIRECTION_NUMBER; ++ingb) {
+              subgrid.set_active_buffer(ingb, NEIGHBOUR_OUTSIDE);
+            }
+          }
+        }
+      }
+      if (_log) {
+        _log->write_status(
+            "Rebalanced subgrid copies: ",
+            _grid_creator->number_of_actual_subgrids() -
+                _grid_creator->number_of_original_subgrids(),
+            " copies, load imbalance ", 100. * old_imbalance, "% -> ",
+            100. * new_imbalance, "% (expected).");
+      }
+      _time_log.end("copy rebalancing");
+    }
+
+    // reset the computational cost counters
+    for (size_t igrid = 0; igrid < _grid_creator->number_of_actual_subgrids();
+         ++igrid) {
+      if (_grid_creator->is_local(igrid)) {
+        (*_grid_creator->get_subgrid(igrid)).reset_computational_cost();
       }
     }
 
@@ -1041,7 +1334,7 @@ void TaskBasedIonizationSimulation::run(
     cmac_assert_message(_buffers->is_empty(), "Number of active buffers: %zu",
                         _buffers->get_number_of_active_buffers());
 
-    if (_trackers != nullptr && iloop == _number_of_iterations - 1) {
+    if (_trackers != nullptr && iloop == number_of_iterations - 1) {
       _trackers->normalize(_total_luminosity / _number_of_photons);
     }
 
@@ -1055,8 +1348,9 @@ void TaskBasedIonizationSimulation::run(
     if (_task_plot) {
       _time_log.start("task output");
       cpucycle_tick(iteration_end);
-      output_tasks(iloop, *_tasks, iteration_start, iteration_end);
-      output_queues(iloop, _queues, *_shared_queue);
+      output_tasks(iloop, *_tasks, iteration_start, iteration_end, _mpi_rank,
+                   _mpi_size);
+      output_queues(iloop, _queues, *_shared_queue, _mpi_rank, _mpi_size);
       _time_log.end("task output");
     }
 
@@ -1088,9 +1382,22 @@ void TaskBasedIonizationSimulation::run(
   }
 
   _time_log.start("snapshot");
-  _density_grid_writer->write(*_grid_creator, _number_of_iterations,
-                              _parameter_file);
+  write_snapshot(*_density_grid_writer, number_of_iterations);
   _time_log.end("snapshot");
 
   _time_log.end("main run");
 }
+
+/**
+ * @brief Write a snapshot of the current state of the grid.
+ *
+ * For distributed runs, every process writes its own subgrids to a separate
+ * file, so that the grid is never collected on a single process.
+ *
+ * @param writer DensityGridWriter to use.
+ * @param counter Counter value to add to the snapshot file name.
+ */
+void TaskBasedIonizationSimulation::write_snapshot(
+    DensityGridWriter &writer, const uint_fast32_t counter) {
+  writer.write(*_grid_creator, counter, _parameter_file);
+}
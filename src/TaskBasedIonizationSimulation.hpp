@@ -35,12 +35,14 @@
 #include "ParameterFile.hpp"
 #include "RandomGenerator.hpp"
 #include "SimulationBox.hpp"
+#include "StealPolicy.hpp"
 #include "Task.hpp"
 #include "ThreadSafeVector.hpp"
 #include "TimeLogger.hpp"
 
 #include <vector>
 
+class AMRRefinementScheme;
 class ContinuousPhotonSource;
 class CrossSections;
 class DensityFunction;
@@ -48,7 +50,9 @@ class DensityGridWriter;
 class DensitySubGrid;
 template < class _subgrid_type_ > class DensitySubGridCreator;
 class DiffuseReemissionHandler;
+class IterationConvergenceController;
 class MemorySpace;
+class MPICommunicator;
 class PhotonSourceDistribution;
 class PhotonSourceSpectrum;
 class RecombinationRates;
@@ -74,6 +78,18 @@ private:
   /*! @brief Task space. */
   ThreadSafeVector< Task > *_tasks;
 
+  /*! @brief Policy used to select the queue to steal tasks from. */
+  StealPolicy _steal_policy;
+
+  /*! @brief Number of threads per NUMA domain (for the NUMA steal policy). */
+  uint_fast32_t _threads_per_numa_domain;
+
+  /*! @brief Traverse photon packets in batches? */
+  bool _batch_traversal;
+
+  /*! @brief Run the batch traversal in (bit-compatible) verification mode? */
+  bool _verify_batch_traversal;
+
   /*! @brief Random number generator per thread. */
   std::vector< RandomGenerator > _random_generators;
 
@@ -90,6 +106,17 @@ private:
   /*! @brief Copy level for subgrids that contain a source. */
   const uint_fast8_t _source_copy_level;
 
+  /*! @brief Redistribute subgrid copies between iterations based on their
+   *  computational cost? */
+  bool _adaptive_copies;
+
+  /*! @brief Maximum copy level for adaptive subgrid copies. */
+  uint_fast8_t _maximum_copy_level;
+
+  /*! @brief Maximum cost of a single adaptive subgrid copy, as a fraction of
+   *  the average thread load. */
+  double _copy_cost_fraction;
+
   /*! @brief Simulation box (in m). */
   SimulationBox _simulation_box;
 
@@ -99,6 +126,10 @@ private:
   /*! @brief DensityFunction that sets the density field. */
   DensityFunction *_density_function;
 
+  /*! @brief AMRRefinementScheme that sets the refinement level of the
+   *  subgrids (can be a nullptr). */
+  AMRRefinementScheme *_refinement_scheme;
+
   /*! @brief DensityGridWriter used for snapshots. */
   DensityGridWriter *_density_grid_writer;
 
@@ -143,12 +174,22 @@ private:
   /*! @brief Reemission handler. */
   DiffuseReemissionHandler *_reemission_handler;
 
+  /*! @brief Rank of the local MPI process. */
+  int_fast32_t _mpi_rank;
+
+  /*! @brief Total number of MPI processes. */
+  int_fast32_t _mpi_size;
+
   /*! @brief Log to write logging info to. */
   Log *_log;
 
   /*! @brief Optional spectrum tracker manager. */
   TrackerManager *_trackers;
 
+  /*! @brief Optional convergence based control of the number of iterations
+   *  and the number of photon packets. */
+  IterationConvergenceController *_convergence_controller;
+
   /*! @brief Timer for the total simulation time. */
   Timer _total_timer;
 
@@ -179,11 +220,14 @@ private:
   /*! @brief Output a snapshot before the initial iteration? */
   const bool _output_initial_snapshot;
 
+  void write_snapshot(DensityGridWriter &writer, const uint_fast32_t counter);
+
 public:
   TaskBasedIonizationSimulation(const int_fast32_t num_thread,
                                 const std::string parameterfile_name,
                                 const bool task_plot = false,
                                 const bool output_initial_snapshot = false,
+                                MPICommunicator *mpi_communicator = nullptr,
                                 Log *log = nullptr);
   ~TaskBasedIonizationSimulation();
 
@@ -25,6 +25,7 @@
  */
 
 #include "TaskBasedRadiationHydrodynamicsSimulation.hpp"
+#include "AMRRefinementSchemeFactory.hpp"
 #include "AlveliusTurbulenceForcing.hpp"
 #include "ChargeTransferRates.hpp"
 #include "CommandLineParser.hpp"
@@ -39,6 +40,7 @@
 #include "HydroBoundaryManager.hpp"
 #include "HydroDensitySubGrid.hpp"
 #include "HydroMaskFactory.hpp"
+#include "IterationConvergenceController.hpp"
 #include "LineCoolingData.hpp"
 #include "LiveOutputManager.hpp"
 #include "MemoryLogger.hpp"
@@ -60,6 +62,7 @@
 #include "TemperatureCalculator.hpp"
 #include "TimeLine.hpp"
 #include "TimeLogger.hpp"
+#include "Utilities.hpp"
 
 /*! @brief Stop the serial time timer and start the parallel time timer. */
 #define start_parallel_timing_block()                                          \
@@ -79,11 +82,15 @@
  * @param iteration_start Start CPU cycle count of the iteration on this
  * process.
  * @param iteration_end End CPU cycle count of the iteration on this process.
+ * @param skip_inactive Skip tasks that were not executed during this
+ * iteration (the hydro tasks of inactive subgrids if hierarchical time steps
+ * are used).
  */
 inline void output_tasks(const uint_fast32_t iloop,
                          ThreadSafeVector< Task > &tasks,
                          const uint_fast64_t iteration_start,
-                         const uint_fast64_t iteration_end) {
+                         const uint_fast64_t iteration_end,
+                         const bool skip_inactive = false) {
 
   {
     // compose the file name
@@ -108,11 +115,21 @@ inline void output_tasks(const uint_fast32_t iloop,
     const size_t tsize = tasks.size();
     for (size_t i = 0; i < tsize; ++i) {
       const Task &task = tasks[i];
-      cmac_assert_message(task.done(), "Task was never executed!");
       int_fast8_t type;
       int_fast32_t thread_id;
       uint_fast64_t start, end;
-      task.get_timing_information(type, thread_id, start, end);
+      if (skip_inactive) {
+        if (!task.done()) {
+          continue;
+        }
+        task.get_timing_information(type, thread_id, start, end);
+        if (start < iteration_start) {
+          continue;
+        }
+      } else {
+        cmac_assert_message(task.done(), "Task was never executed!");
+        task.get_timing_information(type, thread_id, start, end);
+      }
       ofile << "0\t" << thread_id << "\t" << start << "\t" << end << "\t"
             << static_cast< int_fast32_t >(type) << "\n";
     }
@@ -122,13 +139,21 @@ inline void output_tasks(const uint_fast32_t iloop,
 /**
  * @brief Make the hydro tasks for the given subgrid.
  *
+ * If fused tasks are requested, the slope limiter, primitive variable
+ * prediction and internal flux sweep are combined into a single task, and so
+ * are the conserved and primitive variable updates. These stages then run
+ * back-to-back while the subgrid is still in cache. Only the gradient and flux
+ * sweeps across subgrid boundaries remain separate tasks.
+ *
  * @param tasks Task vector.
  * @param igrid Index of the subgrid.
  * @param grid_creator Subgrids.
+ * @param fused Create fused hydro tasks?
  */
 inline void
 make_hydro_tasks(ThreadSafeVector< Task > &tasks, const uint_fast32_t igrid,
-                 DensitySubGridCreator< HydroDensitySubGrid > &grid_creator) {
+                 DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+                 const bool fused) {
 
   HydroDensitySubGrid &this_grid = *grid_creator.get_subgrid(igrid);
   const unsigned int ngbx = this_grid.get_neighbour(TRAVELDIRECTION_FACE_X_P);
@@ -261,36 +286,48 @@ make_hydro_tasks(ThreadSafeVector< Task > &tasks, const uint_fast32_t igrid,
   } else {
     this_grid.set_hydro_task(6, NO_TASK);
   }
-  // slope limiter
-  {
+  if (fused) {
+    // slope limiter, primitive variable prediction and internal flux sweep
     const size_t next_task = tasks.get_free_element();
     Task &task = tasks[next_task];
-    task.set_type(TASKTYPE_SLOPE_LIMITER);
+    task.set_type(TASKTYPE_LIMIT_PREDICT_FLUXSWEEP_INTERNAL);
     task.set_dependency(this_grid.get_dependency());
     task.set_subgrid(igrid);
     this_grid.set_hydro_task(7, next_task);
-  }
-  // primitive variable prediction
-  {
-    const size_t next_task = tasks.get_free_element();
-    Task &task = tasks[next_task];
-    task.set_type(TASKTYPE_PREDICT_PRIMITIVES);
-    task.set_dependency(this_grid.get_dependency());
-    task.set_subgrid(igrid);
-    this_grid.set_hydro_task(8, next_task);
+    this_grid.set_hydro_task(8, NO_TASK);
+    this_grid.set_hydro_task(9, NO_TASK);
+  } else {
+    // slope limiter
+    {
+      const size_t next_task = tasks.get_free_element();
+      Task &task = tasks[next_task];
+      task.set_type(TASKTYPE_SLOPE_LIMITER);
+      task.set_dependency(this_grid.get_dependency());
+      task.set_subgrid(igrid);
+      this_grid.set_hydro_task(7, next_task);
+    }
+    // primitive variable prediction
+    {
+      const size_t next_task = tasks.get_free_element();
+      Task &task = tasks[next_task];
+      task.set_type(TASKTYPE_PREDICT_PRIMITIVES);
+      task.set_dependency(this_grid.get_dependency());
+      task.set_subgrid(igrid);
+      this_grid.set_hydro_task(8, next_task);
+    }
+    // internal flux sweep
+    {
+      const size_t next_task = tasks.get_free_element();
+      Task &task = tasks[next_task];
+      task.set_type(TASKTYPE_FLUXSWEEP_INTERNAL);
+      task.set_dependency(this_grid.get_dependency());
+      task.set_subgrid(igrid);
+      this_grid.set_hydro_task(9, next_task);
+    }
   }
 
   /// flux exchange and primitive variable update
 
-  // internal flux sweep
-  {
-    const size_t next_task = tasks.get_free_element();
-    Task &task = tasks[next_task];
-    task.set_type(TASKTYPE_FLUXSWEEP_INTERNAL);
-    task.set_dependency(this_grid.get_dependency());
-    task.set_subgrid(igrid);
-    this_grid.set_hydro_task(9, next_task);
-  }
   // external flux sweeps
   // x
   // positive: always do flux exchange
@@ -406,23 +443,34 @@ make_hydro_tasks(ThreadSafeVector< Task > &tasks, const uint_fast32_t igrid,
   } else {
     this_grid.set_hydro_task(15, NO_TASK);
   }
-  // conserved variable update
-  {
+  if (fused) {
+    // conserved and primitive variable update
     const size_t next_task = tasks.get_free_element();
     Task &task = tasks[next_task];
-    task.set_type(TASKTYPE_UPDATE_CONSERVED);
+    task.set_type(TASKTYPE_UPDATE_CONSERVED_PRIMITIVES);
     task.set_dependency(this_grid.get_dependency());
     task.set_subgrid(igrid);
     this_grid.set_hydro_task(16, next_task);
-  }
-  // primitive variable update
-  {
-    const size_t next_task = tasks.get_free_element();
-    Task &task = tasks[next_task];
-    task.set_type(TASKTYPE_UPDATE_PRIMITIVES);
-    task.set_dependency(this_grid.get_dependency());
-    task.set_subgrid(igrid);
-    this_grid.set_hydro_task(17, next_task);
+    this_grid.set_hydro_task(17, NO_TASK);
+  } else {
+    // conserved variable update
+    {
+      const size_t next_task = tasks.get_free_element();
+      Task &task = tasks[next_task];
+      task.set_type(TASKTYPE_UPDATE_CONSERVED);
+      task.set_dependency(this_grid.get_dependency());
+      task.set_subgrid(igrid);
+      this_grid.set_hydro_task(16, next_task);
+    }
+    // primitive variable update
+    {
+      const size_t next_task = tasks.get_free_element();
+      Task &task = tasks[next_task];
+      task.set_type(TASKTYPE_UPDATE_PRIMITIVES);
+      task.set_dependency(this_grid.get_dependency());
+      task.set_subgrid(igrid);
+      this_grid.set_hydro_task(17, next_task);
+    }
   }
 }
 
@@ -473,14 +521,23 @@ set_dependencies(const uint_fast32_t igrid,
   tasks[igzp].add_child(isl);
   tasks[igzn].add_child(isl);
 
+  // in fused mode, the slope limiter task also does the prediction and the
+  // internal flux sweep
+  const bool fused =
+      (tasks[isl].get_type() == TASKTYPE_LIMIT_PREDICT_FLUXSWEEP_INTERNAL);
+
   // the slope limiter task unlocks the gradient prediction task
-  const size_t ipp = this_grid.get_hydro_task(8);
-  tasks[isl].add_child(ipp);
+  size_t ipp = isl;
+  size_t iff = NO_TASK;
+  if (!fused) {
+    ipp = this_grid.get_hydro_task(8);
+    tasks[isl].add_child(ipp);
 
-  // the gradient prediction task unlocks the flux task for this cell and all
-  // neighbouring cell pair flux tasks
-  const size_t iff = this_grid.get_hydro_task(9);
-  tasks[ipp].add_child(iff);
+    // the gradient prediction task unlocks the flux task for this cell and all
+    // neighbouring cell pair flux tasks
+    iff = this_grid.get_hydro_task(9);
+    tasks[ipp].add_child(iff);
+  }
   // neighbours: the positive one is (always) stored in this subgrid
   const size_t ifxp = this_grid.get_hydro_task(10);
   tasks[ipp].add_child(ifxp);
@@ -514,7 +571,9 @@ set_dependencies(const uint_fast32_t igrid,
 
   // the flux tasks unlock the conserved variable update
   const size_t icu = this_grid.get_hydro_task(16);
-  tasks[iff].add_child(icu);
+  if (iff != NO_TASK) {
+    tasks[iff].add_child(icu);
+  }
   tasks[ifxp].add_child(icu);
   tasks[ifxn].add_child(icu);
   tasks[ifyp].add_child(icu);
@@ -523,18 +582,48 @@ set_dependencies(const uint_fast32_t igrid,
   tasks[ifzn].add_child(icu);
 
   // the conserved variable update unlocks the primitive variable update
-  const size_t ipu = this_grid.get_hydro_task(17);
-  tasks[icu].add_child(ipu);
+  if (!fused) {
+    const size_t ipu = this_grid.get_hydro_task(17);
+    tasks[icu].add_child(ipu);
+  }
+}
+
+/**
+ * @brief Get the number of active subgrids involved in the given hydro task.
+ *
+ * @param task Hydro task.
+ * @param grid_creator Subgrids.
+ * @return Number of active subgrids: 0, 1 or 2 (for neighbour tasks).
+ */
+inline uint_fast8_t get_number_of_active_subgrids(
+    const Task &task,
+    DensitySubGridCreator< HydroDensitySubGrid > &grid_creator) {
+
+  uint_fast8_t number_of_active_subgrids =
+      (*grid_creator.get_subgrid(task.get_subgrid())).is_hydro_active();
+  if (task.get_type() == TASKTYPE_GRADIENTSWEEP_EXTERNAL_NEIGHBOUR ||
+      task.get_type() == TASKTYPE_FLUXSWEEP_EXTERNAL_NEIGHBOUR) {
+    number_of_active_subgrids +=
+        (*grid_creator.get_subgrid(task.get_buffer())).is_hydro_active();
+  }
+  return number_of_active_subgrids;
 }
 
 /**
  * @brief Reset the hydro tasks for the given subgrid.
  *
+ * Flux exchanges with a neighbouring subgrid only wait for the primitive
+ * variable prediction of the subgrids that are active. The tasks of inactive
+ * subgrids are never unlocked.
+ *
  * @param tasks Tasks.
  * @param this_grid Subgrid.
+ * @param grid_creator Subgrids.
  */
-inline void reset_hydro_tasks(ThreadSafeVector< Task > &tasks,
-                              HydroDensitySubGrid &this_grid) {
+inline void
+reset_hydro_tasks(ThreadSafeVector< Task > &tasks,
+                  HydroDensitySubGrid &this_grid,
+                  DensitySubGridCreator< HydroDensitySubGrid > &grid_creator) {
 
   // gradient sweeps
   // internal
@@ -553,20 +642,27 @@ inline void reset_hydro_tasks(ThreadSafeVector< Task > &tasks,
     tasks[this_grid.get_hydro_task(6)].set_number_of_unfinished_parents(0);
   }
 
-  // slope limiter
+  // slope limiter (fused with the prediction and internal flux sweep in
+  // fused mode)
   tasks[this_grid.get_hydro_task(7)].set_number_of_unfinished_parents(7);
-  // primitive variable prediction
-  tasks[this_grid.get_hydro_task(8)].set_number_of_unfinished_parents(1);
+  const bool fused = (this_grid.get_hydro_task(8) == NO_TASK);
+  if (!fused) {
+    // primitive variable prediction
+    tasks[this_grid.get_hydro_task(8)].set_number_of_unfinished_parents(1);
+
+    // internal flux sweep
+    tasks[this_grid.get_hydro_task(9)].set_number_of_unfinished_parents(1);
+  }
 
   // flux sweeps
-  // internal
-  tasks[this_grid.get_hydro_task(9)].set_number_of_unfinished_parents(1);
   // external
   if (tasks[this_grid.get_hydro_task(10)].get_type() ==
       TASKTYPE_FLUXSWEEP_EXTERNAL_BOUNDARY) {
     tasks[this_grid.get_hydro_task(10)].set_number_of_unfinished_parents(1);
   } else {
-    tasks[this_grid.get_hydro_task(10)].set_number_of_unfinished_parents(2);
+    tasks[this_grid.get_hydro_task(10)].set_number_of_unfinished_parents(
+        get_number_of_active_subgrids(tasks[this_grid.get_hydro_task(10)],
+                                      grid_creator));
   }
   if (this_grid.get_hydro_task(11) != NO_TASK) {
     tasks[this_grid.get_hydro_task(11)].set_number_of_unfinished_parents(1);
@@ -575,7 +671,9 @@ inline void reset_hydro_tasks(ThreadSafeVector< Task > &tasks,
       TASKTYPE_FLUXSWEEP_EXTERNAL_BOUNDARY) {
     tasks[this_grid.get_hydro_task(12)].set_number_of_unfinished_parents(1);
   } else {
-    tasks[this_grid.get_hydro_task(12)].set_number_of_unfinished_parents(2);
+    tasks[this_grid.get_hydro_task(12)].set_number_of_unfinished_parents(
+        get_number_of_active_subgrids(tasks[this_grid.get_hydro_task(12)],
+                                      grid_creator));
   }
   if (this_grid.get_hydro_task(13) != NO_TASK) {
     tasks[this_grid.get_hydro_task(13)].set_number_of_unfinished_parents(1);
@@ -584,49 +682,41 @@ inline void reset_hydro_tasks(ThreadSafeVector< Task > &tasks,
       TASKTYPE_FLUXSWEEP_EXTERNAL_BOUNDARY) {
     tasks[this_grid.get_hydro_task(14)].set_number_of_unfinished_parents(1);
   } else {
-    tasks[this_grid.get_hydro_task(14)].set_number_of_unfinished_parents(2);
+    tasks[this_grid.get_hydro_task(14)].set_number_of_unfinished_parents(
+        get_number_of_active_subgrids(tasks[this_grid.get_hydro_task(14)],
+                                      grid_creator));
   }
   if (this_grid.get_hydro_task(15) != NO_TASK) {
     tasks[this_grid.get_hydro_task(15)].set_number_of_unfinished_parents(1);
   }
 
-  // conserved variable update
-  tasks[this_grid.get_hydro_task(16)].set_number_of_unfinished_parents(7);
-  // primitive variable update
-  tasks[this_grid.get_hydro_task(17)].set_number_of_unfinished_parents(1);
+  if (fused) {
+    // conserved and primitive variable update: the internal flux sweep is
+    // part of the slope limiter task, which precedes all external flux sweeps
+    tasks[this_grid.get_hydro_task(16)].set_number_of_unfinished_parents(6);
+  } else {
+    // conserved variable update
+    tasks[this_grid.get_hydro_task(16)].set_number_of_unfinished_parents(7);
+    // primitive variable update
+    tasks[this_grid.get_hydro_task(17)].set_number_of_unfinished_parents(1);
+  }
 }
 
 /**
  * @brief Steal a task from another queue.
  *
  * @param thread_id Id of the active thread.
- * @param num_threads Total number of threads.
- * @param queues Thread queues.
+ * @param scheduler Scheduler that selects the queue to steal from.
  * @param tasks Task space.
  * @param grid_creator Subgrids.
  * @return Index of an available task, or NO_TASK if no tasks are available.
  */
 inline uint_fast32_t
-steal_task(const int_fast32_t thread_id, const int_fast32_t num_threads,
-           std::vector< TaskQueue * > &queues, ThreadSafeVector< Task > &tasks,
+steal_task(const int_fast32_t thread_id, Scheduler &scheduler,
+           ThreadSafeVector< Task > &tasks,
            DensitySubGridCreator< HydroDensitySubGrid > &grid_creator) {
 
-  // sort the queues by size
-  std::vector< uint_fast32_t > queue_sizes(queues.size(), 0);
-  for (uint_fast32_t i = 0; i < queues.size(); ++i) {
-    queue_sizes[i] = queues[i]->size();
-  }
-  std::vector< uint_fast32_t > sorti = Utilities::argsort(queue_sizes);
-
-  // now try to steal from the largest queue first
-  uint_fast32_t current_index = NO_TASK;
-  uint_fast32_t i = 0;
-  while (current_index == NO_TASK && i < queue_sizes.size() &&
-         queue_sizes[sorti[queue_sizes.size() - i - 1]] > 0) {
-    current_index =
-        queues[sorti[queue_sizes.size() - i - 1]]->try_get_task(tasks);
-    ++i;
-  }
+  const uint_fast32_t current_index = scheduler.steal_task(thread_id);
   if (current_index != NO_TASK) {
     // stealing means transferring ownership...
     (*grid_creator.get_subgrid(tasks[current_index].get_subgrid()))
@@ -642,26 +732,32 @@ steal_task(const int_fast32_t thread_id, const int_fast32_t num_threads,
  * @param itask Task index.
  * @param grid_creator Subgrids.
  * @param tasks Tasks.
- * @param timestep System time step (in s).
  * @param hydro Hydro instance to use.
  * @param boundary_manager HydroBoundaryManager to use.
  */
 inline void
 execute_task(const size_t itask,
              DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
-             ThreadSafeVector< Task > &tasks, const double timestep,
-             const Hydro &hydro, const HydroBoundaryManager &boundary_manager) {
+             ThreadSafeVector< Task > &tasks, const Hydro &hydro,
+             const HydroBoundaryManager &boundary_manager) {
 
   const Task &task = tasks[itask];
   HydroDensitySubGrid &subgrid = *grid_creator.get_subgrid(task.get_subgrid());
+  const double timestep = subgrid.get_hydro_timestep();
   switch (task.get_type()) {
   case TASKTYPE_GRADIENTSWEEP_INTERNAL:
     subgrid.inner_gradient_sweep(hydro);
     break;
-  case TASKTYPE_GRADIENTSWEEP_EXTERNAL_NEIGHBOUR:
+  case TASKTYPE_GRADIENTSWEEP_EXTERNAL_NEIGHBOUR: {
+    // the gradients of an inactive subgrid are kept fixed until the end of its
+    // time step
+    HydroDensitySubGrid &neighbour =
+        *grid_creator.get_subgrid(task.get_buffer());
     subgrid.outer_gradient_sweep(task.get_interaction_direction(), hydro,
-                                 *grid_creator.get_subgrid(task.get_buffer()));
+                                 neighbour, subgrid.is_hydro_active(),
+                                 neighbour.is_hydro_active());
     break;
+  }
   case TASKTYPE_GRADIENTSWEEP_EXTERNAL_BOUNDARY:
     subgrid.outer_ghost_gradient_sweep(task.get_interaction_direction(), hydro,
                                        boundary_manager.get_boundary_condition(
@@ -676,11 +772,20 @@ execute_task(const size_t itask,
   case TASKTYPE_FLUXSWEEP_INTERNAL:
     subgrid.inner_flux_sweep(hydro, timestep);
     break;
-  case TASKTYPE_FLUXSWEEP_EXTERNAL_NEIGHBOUR:
+  case TASKTYPE_FLUXSWEEP_EXTERNAL_NEIGHBOUR: {
+    // the flux is integrated over the shortest of both time steps; a subgrid
+    // with a longer time step accumulates the fluxes of all shorter steps
+    // that fit in its own step, so that the exchange remains conservative
+    HydroDensitySubGrid &neighbour =
+        *grid_creator.get_subgrid(task.get_buffer());
+    const double neighbour_timestep = neighbour.get_hydro_timestep();
+    const double interface_timestep = std::min(timestep, neighbour_timestep);
     subgrid.outer_flux_sweep(task.get_interaction_direction(), hydro,
-                             *grid_creator.get_subgrid(task.get_buffer()),
-                             timestep);
+                             neighbour, interface_timestep,
+                             interface_timestep / timestep,
+                             interface_timestep / neighbour_timestep);
     break;
+  }
   case TASKTYPE_FLUXSWEEP_EXTERNAL_BOUNDARY:
     subgrid.outer_ghost_flux_sweep(task.get_interaction_direction(), hydro,
                                    boundary_manager.get_boundary_condition(
@@ -693,11 +798,118 @@ execute_task(const size_t itask,
   case TASKTYPE_UPDATE_PRIMITIVES:
     subgrid.update_primitive_variables(hydro);
     break;
+  case TASKTYPE_LIMIT_PREDICT_FLUXSWEEP_INTERNAL:
+    subgrid.limit_and_predict_primitive_variables(hydro, 0.5 * timestep);
+    subgrid.inner_flux_sweep(hydro, timestep);
+    break;
+  case TASKTYPE_UPDATE_CONSERVED_PRIMITIVES:
+    subgrid.update_conserved_and_primitive_variables(hydro, timestep);
+    break;
   default:
     cmac_error("Unknown hydro task: %" PRIiFAST32, task.get_type());
   }
 }
 
+/**
+ * @brief Assign new hierarchical hydro time steps to all subgrids that start
+ * a new time step at the current time on the time line.
+ *
+ * Every subgrid gets the largest power of two integer time step that is
+ * smaller than its requested time step and that is at most twice as large as
+ * the time step of any of its face neighbours. Subgrids that are halfway a
+ * longer time step keep their time step.
+ *
+ * The neighbour limit is evaluated at every synchronisation point, but can
+ * only shorten the time step of subgrids that start a new step: a subgrid that
+ * is halfway its step cannot end it early, since its gradients and the
+ * weighted boundary fluxes it already accumulated assume the full step
+ * length. This means that a neighbour that starts a much shorter step
+ * next to a subgrid that is halfway a long step can temporarily be more than
+ * one level apart. This is enough, because
+ *  - the boundary fluxes are weighted with the ratio of the interface time
+ *    step and the subgrid time step, which keeps the exchange conservative
+ *    for any ratio of time steps, and
+ *  - the long subgrid is limited by its shorter neighbour as soon as its own
+ *    step ends, which is at most one long step later.
+ *
+ * @param grid_creator Subgrids.
+ * @param timeline TimeLine.
+ * @param requested_timesteps Requested time step for each subgrid (in s).
+ * @return Integer time of the next synchronisation point, i.e. the end of the
+ * next system time step (0 if a subgrid requests a time step that does not fit
+ * on the time line).
+ */
+uint64_t
+TaskBasedRadiationHydrodynamicsSimulation::assign_hierarchical_timesteps(
+    DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+    const TimeLine &timeline,
+    const std::vector< double > &requested_timesteps) {
+
+  const uint64_t current_time = timeline.get_current_integer_time();
+  const size_t number_of_subgrids = grid_creator.number_of_original_subgrids();
+
+  std::vector< uint64_t > integer_timesteps(number_of_subgrids);
+  std::vector< bool > starts_timestep(number_of_subgrids);
+  for (size_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+    const HydroDensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+    starts_timestep[igrid] = (subgrid.get_integer_end_time() == current_time);
+    if (starts_timestep[igrid]) {
+      integer_timesteps[igrid] =
+          timeline.get_integer_timestep(requested_timesteps[igrid]);
+      if (integer_timesteps[igrid] == 0) {
+        cmac_warning("Time step smaller than absolute limit: %g! Prematurely "
+                     "stopping simulation...",
+                     requested_timesteps[igrid]);
+        return 0;
+      }
+    } else {
+      integer_timesteps[igrid] = subgrid.get_integer_timestep();
+    }
+  }
+
+  // limit the time step difference between neighbouring subgrids to a single
+  // level. Since time steps can only decrease, this converges.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+      if (!starts_timestep[igrid]) {
+        continue;
+      }
+      const HydroDensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+      for (int_fast32_t direction = TRAVELDIRECTION_FACE_X_P;
+           direction <= TRAVELDIRECTION_FACE_Z_N; ++direction) {
+        const uint_fast32_t ngb = subgrid.get_neighbour(direction);
+        if (ngb != NEIGHBOUR_OUTSIDE &&
+            integer_timesteps[igrid] / 2 > integer_timesteps[ngb]) {
+          // a smaller power of two is still a divisor of the current time
+          integer_timesteps[igrid] = 2 * integer_timesteps[ngb];
+          changed = true;
+        }
+      }
+    }
+  }
+
+  uint64_t next_time = UINT64_MAX;
+  for (size_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+    HydroDensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+    if (starts_timestep[igrid]) {
+      subgrid.set_hydro_timestep(
+          integer_timesteps[igrid], current_time + integer_timesteps[igrid],
+          timeline.get_physical_timestep(integer_timesteps[igrid]));
+    }
+    next_time = std::min(next_time, subgrid.get_integer_end_time());
+  }
+
+  // only subgrids that reach the end of their time step are active
+  for (size_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+    HydroDensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+    subgrid.set_hydro_active(subgrid.get_integer_end_time() == next_time);
+  }
+
+  return next_time;
+}
+
 /**
  * @brief Add RHD simulation specific command line options to the command line
  * parser.
@@ -864,6 +1076,9 @@ inline static void do_cooling(IonizationVariables &ionization_variables,
  *    value is given, the radiation field is updated every time step. (default:
  *    -1. s: update every time step)
  *  - random seed: Seed for the random number generator (default: 42)
+ *  - random generator: Type of random number generator to use (RANLUX/Philox,
+ *    default: RANLUX). The counter-based Philox generator uses an independent
+ *    random number stream for every photon packet
  *  - output folder: Folder where all output files will be placed (default: .)
  *  - number of iterations: Number of iterations of the photoionization
  *    algorithm (default: 10)
@@ -883,6 +1098,33 @@ inline static void do_cooling(IonizationVariables &ionization_variables,
  *  - do radiation: Enable radiation? (default: yes)
  *  - do radiative cooling: Enable radiative cooling? (default: no)
  *  - do stellar feedback: Enable stellar feedback? (default: no)
+ *  - source copy level: Copy level for subgrids that contain a source
+ *    (default: 4)
+ *  - adaptive copies: Redistribute the subgrid copies and the thread ownership
+ *    of the subgrids after every radiation step, based on the computational
+ *    cost of that step (default: no)
+ *  - maximum copy level: Maximum copy level for adaptive copies (default:
+ *    source copy level)
+ *  - copy cost fraction: Maximum expected cost of a single subgrid copy in
+ *    adaptive mode, as a fraction of the average thread load (default: 0.5)
+ *  - adaptive iterations: Stop the iterations of a radiation step once the
+ *    neutral fractions and temperatures have converged, and adapt the number
+ *    of photon packets for the next radiation step to the Monte Carlo noise
+ *    (see IterationConvergenceController; the number of iterations is then
+ *    the maximum number of iterations per radiation step, default: no)
+ *  - hierarchical timesteps: Give every subgrid its own power of two hydro
+ *    time step on the integer time line, so that only the subgrids that reach
+ *    the end of their time step are integrated during a system time step
+ *    (default: no)
+ *  - fused hydro tasks: Run the slope limiter, prediction and internal flux
+ *    sweep of a subgrid as a single task, and likewise the conserved and
+ *    primitive variable updates, so that fewer passes over the subgrid memory
+ *    are needed per hydro step (default: no)
+ *
+ * If an AMRRefinementScheme is specified (DensityGrid:AMRRefinementScheme),
+ * the refinement level of every subgrid is set using that scheme (see
+ * DensitySubGridCreator::initialize()). Turbulent forcing and live output
+ * require all subgrids to be on the same level.
  *
  * @param parser CommandLineParser that contains the parsed command line
  * arguments.
@@ -1041,16 +1283,37 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
       "TaskBasedRadiationHydrodynamicsSimulation:shared queue size", 100000);
   const size_t number_of_tasks = params->get_value< size_t >(
       "TaskBasedRadiationHydrodynamicsSimulation:number of tasks", 500000);
+  const StealPolicy steal_policy =
+      get_steal_policy(params->get_value< std::string >(
+          "TaskBasedRadiationHydrodynamicsSimulation:steal policy",
+          "LargestQueue"));
+  const uint_fast32_t threads_per_numa_domain =
+      params->get_value< uint_fast32_t >(
+          "TaskBasedRadiationHydrodynamicsSimulation:threads per NUMA domain",
+          num_thread);
+  const bool batch_traversal = params->get_value< bool >(
+      "TaskBasedRadiationHydrodynamicsSimulation:batch photon traversal",
+      false);
+  const bool verify_batch_traversal = params->get_value< bool >(
+      "TaskBasedRadiationHydrodynamicsSimulation:verify batch photon "
+      "traversal",
+      false);
   int_fast32_t random_seed = params->get_value< int_fast32_t >(
       "TaskBasedRadiationHydrodynamicsSimulation:random seed", 42);
   if (restart_reader != nullptr) {
     random_seed = restart_reader->read< int_fast32_t >();
   }
+  const RandomGeneratorType random_generator_type = RandomGenerator::get_type(
+      params->get_value< std::string >(
+          "TaskBasedRadiationHydrodynamicsSimulation:random generator",
+          "RANLUX"));
   time_logger.start("density grid creation");
   DensitySubGridCreator< HydroDensitySubGrid > *grid_creator = nullptr;
+  AMRRefinementScheme *refinement_scheme = nullptr;
   if (restart_reader == nullptr) {
     grid_creator = new DensitySubGridCreator< HydroDensitySubGrid >(
         simulation_box.get_box(), *params);
+    refinement_scheme = AMRRefinementSchemeFactory::generate(*params, log);
   } else {
     grid_creator =
         new DensitySubGridCreator< HydroDensitySubGrid >(*restart_reader);
@@ -1136,11 +1399,39 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   uint_fast64_t numphoton = params->get_value< uint_fast64_t >(
       "TaskBasedRadiationHydrodynamicsSimulation:number of photons", 1e6);
 
+  IterationConvergenceController *convergence_controller = nullptr;
+  if (params->get_value< bool >(
+          "TaskBasedRadiationHydrodynamicsSimulation:adaptive iterations",
+          false)) {
+    convergence_controller = new IterationConvergenceController(
+        "TaskBasedRadiationHydrodynamicsSimulation",
+        grid_creator->number_of_cells(), numphoton, *params, log);
+  }
+  // number of photon packets for the next radiation step (can be changed by
+  // the convergence controller)
+  uint_fast64_t next_numphoton = numphoton;
+
   const double CFL = params->get_value< double >(
       "TaskBasedRadiationHydrodynamicsSimulation:CFL", 0.2);
+  const bool hierarchical_timesteps = params->get_value< bool >(
+      "TaskBasedRadiationHydrodynamicsSimulation:hierarchical timesteps",
+      false);
+  const bool fused_hydro_tasks = params->get_value< bool >(
+      "TaskBasedRadiationHydrodynamicsSimulation:fused hydro tasks", false);
 
   const double source_copy_level = params->get_value< double >(
       "TaskBasedRadiationHydrodynamicsSimulation:source copy level", 4);
+  const bool adaptive_copies = params->get_value< bool >(
+      "TaskBasedRadiationHydrodynamicsSimulation:adaptive copies", false);
+  uint_fast8_t maximum_copy_level = source_copy_level;
+  double copy_cost_fraction = 0.5;
+  if (adaptive_copies) {
+    maximum_copy_level = params->get_value< uint_fast32_t >(
+        "TaskBasedRadiationHydrodynamicsSimulation:maximum copy level",
+        maximum_copy_level);
+    copy_cost_fraction = params->get_value< double >(
+        "TaskBasedRadiationHydrodynamicsSimulation:copy cost fraction", 0.5);
+  }
 
   Hydro hydro(*params);
   HydroBoundaryManager hydro_boundary_manager(*params);
@@ -1202,8 +1493,20 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
     }
     memory_logger.add_entry("grid");
     start_parallel_timing_block();
-    grid_creator->initialize(*density_function);
+    grid_creator->initialize(*density_function, refinement_scheme);
     stop_parallel_timing_block();
+    if (refinement_scheme != nullptr) {
+      delete refinement_scheme;
+      if (log) {
+        log->write_status("Refined grid contains ",
+                          grid_creator->number_of_cells(), " cells.");
+      }
+      if (grid_creator->is_refined() &&
+          (turbulence_forcing != nullptr || live_output_manager.is_enabled())) {
+        cmac_error("Turbulent forcing and live output are not supported for "
+                   "grids with multiple refinement levels!");
+      }
+    }
 
 #ifdef VARIABLE_ABUNDANCES
     for (auto gridit = grid_creator->begin();
@@ -1261,7 +1564,8 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   for (int_fast8_t ithread = 0; ithread < num_thread; ++ithread) {
     std::stringstream queue_name;
     queue_name << "Queue for Thread " << static_cast< int_fast32_t >(ithread);
-    queues[ithread] = new TaskQueue(queue_size_per_thread, queue_name.str());
+    queues[ithread] =
+        new TaskQueue(queue_size_per_thread, queue_name.str(), true);
   }
   memory_logger.finalize_entry();
   if (log) {
@@ -1269,7 +1573,14 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   }
   std::vector< RandomGenerator > random_generators(num_thread);
   for (uint_fast8_t ithread = 0; ithread < num_thread; ++ithread) {
-    random_generators[ithread].set_seed(random_seed + ithread);
+    random_generators[ithread].set_type(random_generator_type);
+    // counter-based generators select independent streams per photon packet,
+    // so all threads need to use the same seed
+    if (random_generators[ithread].is_counter_based()) {
+      random_generators[ithread].set_seed(random_seed);
+    } else {
+      random_generators[ithread].set_seed(random_seed + ithread);
+    }
   }
   if (log) {
     log->write_status("Done initializing task-based structures.");
@@ -1294,7 +1605,8 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   time_logger.start("hydro task creation");
   for (auto cellit = grid_creator->begin();
        cellit != grid_creator->original_end(); ++cellit) {
-    make_hydro_tasks(*tasks, cellit.get_index(), *grid_creator);
+    make_hydro_tasks(*tasks, cellit.get_index(), *grid_creator,
+                     fused_hydro_tasks);
   }
   for (auto cellit = grid_creator->begin();
        cellit != grid_creator->original_end(); ++cellit) {
@@ -1391,14 +1703,17 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
     maximum_timestep = std::min(maximum_timestep, hydro_radtime);
   }
 
+  // requested time step for each subgrid
+  std::vector< double > requested_timestep_list(
+      grid_creator->number_of_original_subgrids(), DBL_MAX);
   if (restart_reader == nullptr) {
     time_logger.start("first time step");
     requested_timestep = DBL_MAX;
     {
       // first figure out the time step for each subgrid, then do the global
       // time step
-      std::vector< double > requested_timestep_list(
-          grid_creator->number_of_original_subgrids(), DBL_MAX);
+      std::fill(requested_timestep_list.begin(),
+                requested_timestep_list.end(), DBL_MAX);
       AtomicValue< size_t > igrid(0);
       start_parallel_timing_block();
 #ifdef HAVE_OPENMP
@@ -1448,29 +1763,7 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
     }
 
     // impose copy restrictions
-    {
-      uint_fast8_t max_level = 0;
-      const size_t levelsize = levels.size();
-      for (size_t i = 0; i < levelsize; ++i) {
-        max_level = std::max(max_level, levels[i]);
-      }
-
-      size_t ngbs[6];
-      while (max_level > 0) {
-        for (size_t i = 0; i < levelsize; ++i) {
-          if (levels[i] == max_level) {
-            const uint_fast8_t numngbs = grid_creator->get_neighbours(i, ngbs);
-            for (uint_fast8_t ingb = 0; ingb < numngbs; ++ingb) {
-              const size_t ngbi = ngbs[ingb];
-              if (levels[ngbi] < levels[i] - 1) {
-                levels[ngbi] = levels[i] - 1;
-              }
-            }
-          }
-        }
-        --max_level;
-      }
-    }
+    grid_creator->impose_copy_restrictions(levels);
     memory_logger.add_entry("subgrid copies");
     grid_creator->create_copies(levels);
     memory_logger.finalize_entry();
@@ -1493,8 +1786,19 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   if (restart_reader == nullptr) {
     timeline = new TimeLine(0., hydro_total_time, hydro_minimum_timestep,
                             maximum_timestep, log);
-    has_next_step =
-        timeline->advance(requested_timestep, actual_timestep, current_time);
+    if (hierarchical_timesteps) {
+      for (uint_fast32_t i = 0; i < requested_timestep_list.size(); ++i) {
+        requested_timestep_list[i] *= CFL;
+      }
+      const uint64_t next_time = assign_hierarchical_timesteps(
+          *grid_creator, *timeline, requested_timestep_list);
+      has_next_step = next_time > 0 &&
+                      timeline->advance_to(next_time, actual_timestep,
+                                           current_time);
+    } else {
+      has_next_step =
+          timeline->advance(requested_timestep, actual_timestep, current_time);
+    }
   } else {
     timeline = new TimeLine(*restart_reader);
     num_step = restart_reader->read< uint_fast32_t >();
@@ -1510,6 +1814,12 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
 
   time_logger.output("time_log.txt");
 
+  // the victim order used for stealing only depends on the subgrid layout, so
+  // we set up the scheduler once for all radiation and hydro steps
+  Scheduler scheduler(*tasks, queues, *shared_queue, steal_policy,
+                      threads_per_numa_domain);
+  scheduler.set_subgrid_adjacency(*grid_creator);
+
   bool stop_simulation = false;
   while (has_next_step && !stop_simulation) {
 
@@ -1584,30 +1894,7 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
         }
 
         // impose copy restrictions
-        {
-          uint_fast8_t max_level = 0;
-          const size_t levelsize = levels.size();
-          for (size_t i = 0; i < levelsize; ++i) {
-            max_level = std::max(max_level, levels[i]);
-          }
-
-          size_t ngbs[6];
-          while (max_level > 0) {
-            for (size_t i = 0; i < levelsize; ++i) {
-              if (levels[i] == max_level) {
-                const uint_fast8_t numngbs =
-                    grid_creator->get_neighbours(i, ngbs);
-                for (uint_fast8_t ingb = 0; ingb < numngbs; ++ingb) {
-                  const size_t ngbi = ngbs[ingb];
-                  if (levels[ngbi] < levels[i] - 1) {
-                    levels[ngbi] = levels[i] - 1;
-                  }
-                }
-              }
-            }
-            --max_level;
-          }
-        }
+        grid_creator->impose_copy_restrictions(levels);
         grid_creator->update_copies(levels);
 
         time_logger.end("source update");
@@ -1634,6 +1921,7 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
           stop_parallel_timing_block();
         }
 
+        numphoton = next_numphoton;
         DistributedPhotonSource< HydroDensitySubGrid > photon_source(
             numphoton, *sourcedistribution, *grid_creator);
         {
@@ -1708,6 +1996,8 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
           }
 
           size_t number_of_photons_done = 0;
+          std::vector< size_t > photon_offsets(
+              photon_source.get_number_of_sources(), 0);
           while (number_of_photons_done < numphoton) {
             for (size_t isrc = 0; isrc < photon_source.get_number_of_sources();
                  ++isrc) {
@@ -1719,6 +2009,8 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
                 (*tasks)[new_task].set_type(TASKTYPE_SOURCE_DISCRETE_PHOTON);
                 (*tasks)[new_task].set_subgrid(isrc);
                 (*tasks)[new_task].set_buffer(number_of_photons_this_batch);
+                (*tasks)[new_task].set_photon_offset(photon_offsets[isrc]);
+                photon_offsets[isrc] += number_of_photons_this_batch;
                 shared_queue->add_task(new_task);
                 number_of_photons_done += number_of_photons_this_batch;
               }
@@ -1730,28 +2022,31 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
           AtomicValue< uint_fast32_t > num_photon_done(0);
 
           // create task contexts
+          // random number streams are selected per photon packet, radiation
+          // step and iteration
+          const uint_fast32_t stream_iteration = num_step * nloop + iloop;
           TaskContext *task_contexts[TASKTYPE_NUMBER] = {nullptr};
           task_contexts[TASKTYPE_SOURCE_DISCRETE_PHOTON] =
               new SourceDiscretePhotonTaskContext< HydroDensitySubGrid >(
                   photon_source, *buffers, random_generators, 1., *spectrum,
-                  abundances, *cross_sections, *grid_creator, *tasks);
+                  abundances, *cross_sections, *grid_creator, *tasks,
+                  stream_iteration);
           if (reemission_handler) {
             task_contexts[TASKTYPE_PHOTON_REEMIT] =
                 new PhotonReemitTaskContext< HydroDensitySubGrid >(
                     *buffers, random_generators, *reemission_handler,
                     abundances, *cross_sections, *grid_creator, *tasks,
-                    num_photon_done);
+                    num_photon_done, stream_iteration);
           }
           task_contexts[TASKTYPE_PHOTON_TRAVERSAL] =
               new PhotonTraversalTaskContext< HydroDensitySubGrid >(
                   *buffers, *grid_creator, *tasks, num_photon_done, nullptr,
-                  reemission_handler != nullptr);
+                  reemission_handler != nullptr, batch_traversal,
+                  verify_batch_traversal);
 
           PrematureLaunchTaskContext< HydroDensitySubGrid > premature_launch(
               *buffers, *grid_creator, *tasks, queues, *shared_queue);
 
-          Scheduler scheduler(*tasks, queues, *shared_queue);
-
           start_parallel_timing_block();
 #ifdef HAVE_OPENMP
 #pragma omp parallel default(shared)
@@ -1891,6 +2186,56 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
           }
 
           worktimer.stop();
+
+          if (convergence_controller != nullptr) {
+            // refined subgrids contain more cells, so we cannot assume that
+            // all subgrids have the same number of cells
+            const std::vector< uint_fast64_t > cell_offsets =
+                grid_creator->get_cell_offsets();
+            for (auto gridit = grid_creator->begin();
+                 gridit != grid_creator->original_end(); ++gridit) {
+              const uint_fast64_t offset = cell_offsets[gridit.get_index()];
+              for (auto cellit = (*gridit).begin(); cellit != (*gridit).end();
+                   ++cellit) {
+                const IonizationVariables &vars =
+                    cellit.get_ionization_variables();
+                convergence_controller->add_cell(
+                    offset + cellit.get_index(),
+                    vars.get_number_density() * cellit.get_volume(),
+                    vars.get_ionic_fraction(ION_H_n), vars.get_temperature());
+              }
+            }
+            next_numphoton =
+                convergence_controller->end_iteration(iloop, numphoton);
+            if (convergence_controller->has_converged()) {
+              break;
+            }
+          }
+        }
+
+        // redistribute the subgrid copies for the next radiation step, so
+        // that they follow the regions where the work is done
+        if (adaptive_copies) {
+          time_logger.start("copy rebalancing");
+          double old_imbalance, new_imbalance;
+          grid_creator->rebalance_copies(maximum_copy_level,
+                                         copy_cost_fraction, num_thread,
+                                         old_imbalance, new_imbalance);
+          // the subgrids were reassigned to threads
+          scheduler.set_subgrid_adjacency(*grid_creator);
+          for (auto gridit = grid_creator->begin();
+               gridit != grid_creator->all_end(); ++gridit) {
+            (*gridit).reset_computational_cost();
+          }
+          if (log) {
+            log->write_status(
+                "Rebalanced subgrid copies: ",
+                grid_creator->number_of_actual_subgrids() -
+                    grid_creator->number_of_original_subgrids(),
+                " copies, load imbalance ", 100. * old_imbalance, "% -> ",
+                100. * new_imbalance, "% (expected).");
+          }
+          time_logger.end("copy rebalancing");
         }
 
         time_logger.end("radiation transfer");
@@ -2061,15 +2406,27 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
       time_logger.end("turbulence");
     }
 
+    // without hierarchical time steps, all subgrids use the system time step
+    if (!hierarchical_timesteps) {
+      for (auto cellit = grid_creator->begin();
+           cellit != grid_creator->original_end(); ++cellit) {
+        (*cellit).set_hydro_timestep(0, 0, actual_timestep);
+        (*cellit).set_hydro_active(true);
+      }
+    }
+
     // reset the hydro tasks and add them to the queue
+    // only tasks that involve at least one active subgrid are queued
     AtomicValue< uint_fast32_t > number_of_tasks;
     for (auto cellit = grid_creator->begin();
          cellit != grid_creator->original_end(); ++cellit) {
-      reset_hydro_tasks(*tasks, *cellit);
+      reset_hydro_tasks(*tasks, *cellit, *grid_creator);
       for (int_fast8_t i = 0; i < 18; ++i) {
         const size_t itask = (*cellit).get_hydro_task(i);
         if (itask != NO_TASK &&
-            (*tasks)[itask].get_number_of_unfinished_parents() == 0) {
+            (*tasks)[itask].get_number_of_unfinished_parents() == 0 &&
+            get_number_of_active_subgrids((*tasks)[itask], *grid_creator) >
+                0) {
           queues[(*cellit).get_owning_thread()]->add_task(itask);
           number_of_tasks.pre_increment();
         }
@@ -2085,8 +2442,7 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
       while (number_of_tasks.value() > 0) {
         size_t current_task = queues[thread_id]->get_task(*tasks);
         if (current_task == NO_TASK) {
-          current_task =
-              steal_task(thread_id, num_thread, queues, *tasks, *grid_creator);
+          current_task = steal_task(thread_id, scheduler, *tasks, *grid_creator);
         }
         if (current_task != NO_TASK) {
           (*tasks)[current_task].start(thread_id);
@@ -2094,8 +2450,8 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
           uint_fast64_t task_start, task_stop;
           cpucycle_tick(task_start);
 
-          execute_task(current_task, *grid_creator, *tasks, actual_timestep,
-                       hydro, hydro_boundary_manager);
+          execute_task(current_task, *grid_creator, *tasks, hydro,
+                       hydro_boundary_manager);
           (*tasks)[current_task].stop();
 
           cpucycle_tick(task_stop);
@@ -2197,7 +2553,8 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
       if (log) {
         log->write_status("Writing task plot file...");
       }
-      output_tasks(task_plot_i, *tasks, iteration_start, iteration_end);
+      output_tasks(task_plot_i, *tasks, iteration_start, iteration_end,
+                   hierarchical_timesteps);
       if (log) {
         log->write_status("Done writing task plot file.");
       }
@@ -2242,8 +2599,8 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
     {
       // first figure out the time step for each subgrid, then do the global
       // time step
-      std::vector< double > requested_timestep_list(
-          grid_creator->number_of_original_subgrids(), DBL_MAX);
+      std::fill(requested_timestep_list.begin(),
+                requested_timestep_list.end(), DBL_MAX);
       AtomicValue< size_t > igrid(0);
       start_parallel_timing_block();
 #ifdef HAVE_OPENMP
@@ -2253,6 +2610,11 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
         const size_t this_igrid = igrid.post_increment();
         if (this_igrid < grid_creator->number_of_original_subgrids()) {
           HydroDensitySubGrid &subgrid = *grid_creator->get_subgrid(this_igrid);
+          // subgrids that are halfway a hierarchical time step keep their
+          // current time step
+          if (hierarchical_timesteps && !subgrid.is_hydro_active()) {
+            continue;
+          }
           for (auto cellit = subgrid.hydro_begin();
                cellit != subgrid.hydro_end(); ++cellit) {
             requested_timestep_list[this_igrid] =
@@ -2270,8 +2632,19 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
       }
     }
     requested_timestep *= CFL;
-    has_next_step =
-        timeline->advance(requested_timestep, actual_timestep, current_time);
+    if (hierarchical_timesteps) {
+      for (uint_fast32_t i = 0; i < requested_timestep_list.size(); ++i) {
+        requested_timestep_list[i] *= CFL;
+      }
+      const uint64_t next_time = assign_hierarchical_timesteps(
+          *grid_creator, *timeline, requested_timestep_list);
+      has_next_step = next_time > 0 &&
+                      timeline->advance_to(next_time, actual_timestep,
+                                           current_time);
+    } else {
+      has_next_step =
+          timeline->advance(requested_timestep, actual_timestep, current_time);
+    }
     time_logger.end("time step");
 
     random_seed = restart_generator.get_random_integer();
@@ -2423,6 +2796,7 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   delete shared_queue;
   delete tasks;
   delete grid_creator;
+  delete convergence_controller;
 
   return 0;
 }
@@ -26,8 +26,14 @@
 #ifndef TASKBASEDRADIATIONHYDRODYNAMICSSIMULATION_HPP
 #define TASKBASEDRADIATIONHYDRODYNAMICSSIMULATION_HPP
 
+#include <cstdint>
+#include <vector>
+
 class CommandLineParser;
+template < class _subgrid_type_ > class DensitySubGridCreator;
+class HydroDensitySubGrid;
 class Log;
+class TimeLine;
 class Timer;
 
 /**
@@ -39,6 +45,11 @@ public:
 
   static int do_simulation(CommandLineParser &parser, bool write_output,
                            Timer &programtimer, Log *log = nullptr);
+
+  static uint64_t assign_hierarchical_timesteps(
+      DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+      const TimeLine &timeline,
+      const std::vector< double > &requested_timesteps);
 };
 
 #endif // TASKBASEDRADIATIONHYDRODYNAMICSSIMULATION_HPP
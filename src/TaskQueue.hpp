@@ -27,11 +27,17 @@
 #define TASKQUEUE_HPP
 
 #include "AtomicValue.hpp"
+#include "Configuration.hpp"
 #include "Error.hpp"
 #include "Task.hpp"
 #include "ThreadLock.hpp"
 #include "ThreadSafeVector.hpp"
 
+#ifdef USE_WORK_STEALING_QUEUE
+#include "LockFreeQueue.hpp"
+#include "WorkStealingDeque.hpp"
+#endif
+
 /*! @brief Index used to signal queue is out of tasks. */
 #define NO_TASK 0xffffffff
 
@@ -47,22 +53,61 @@
 
 /**
  * @brief Task queue.
+ *
+ * Two implementations are available, selected at configuration time:
+ *  - the default implementation stores the tasks in an array that is protected
+ *    by a lock. Tasks are taken from the end of the array, and the tasks that
+ *    come after the retrieved task are shifted to close the gap.
+ *  - the work-stealing implementation (activated by the WORK_STEALING_QUEUE
+ *    CMake option) does not use any locks. Newly added tasks end up in a
+ *    lock-free incoming queue. The owner of the queue moves them into a
+ *    Chase-Lev deque, from which it takes the newest tasks, while other
+ *    threads steal the oldest tasks. Tasks whose dependency is busy are moved
+ *    to a separate lock-free queue that is checked after the deque is empty.
+ *    Retrieving a task hence no longer scales with the size of the queue.
  */
 class TaskQueue {
 private:
+#ifdef USE_WORK_STEALING_QUEUE
+  /*! @brief Tasks that were added but not yet picked up by the owner. */
+  LockFreeQueue _incoming_queue;
+
+  /*! @brief Deque from which the owner takes and other threads steal. */
+  WorkStealingDeque _deque;
+
+  /*! @brief Tasks whose dependency could not be locked when they were
+   *  retrieved. */
+  LockFreeQueue _busy_queue;
+
+  /*! @brief Does this queue have an owner thread? */
+  const bool _has_owner;
+#else
   /*! @brief Queue. */
   size_t *_queue;
 
   /*! @brief Current size of the queue. */
   size_t _current_queue_size;
 
+  /*! @brief Lock that protects the queue. */
+  ThreadLock _queue_lock;
+#endif
+
   /*! @brief Size of the queues. */
   const size_t _size;
 
-  /*! @brief Lock that protects the queue. */
-  ThreadLock _queue_lock;
+#if defined(QUEUE_STATS) && defined(USE_WORK_STEALING_QUEUE)
+  /*! @brief Maximum size of the queue at any given time. */
+  AtomicValue< size_t > _max_queue_size;
 
-#ifdef QUEUE_STATS
+  /*! @brief Total number of tasks stored in the queue. */
+  AtomicValue< size_t > _total_queue_size;
+
+  /*! @brief Average queue size accumulator. */
+  AtomicValue< uint_fast64_t > _avg_queue_size;
+
+  /*! @brief Average queue size evaluation counter. */
+  AtomicValue< uint_fast64_t > _avg_queue_size_count;
+#elif defined(QUEUE_STATS)
   /*! @brief Maximum size of the queue at any given time. */
   size_t _max_queue_size;
 
@@ -85,22 +130,129 @@ public:
    *
    * @param size Size of the queue.
    * @param label Label to identify this queue in error messages.
+   * @param has_owner Is this queue owned by a single thread? Only the owner
+   * is allowed to call get_task() on an owned queue, other threads need to use
+   * try_get_task(). This is only used by the work-stealing implementation.
    */
-  inline TaskQueue(const size_t size, const std::string label = "")
+  inline TaskQueue(const size_t size, const std::string label = "",
+                   const bool has_owner = false)
+#ifdef USE_WORK_STEALING_QUEUE
+      : _incoming_queue(size), _deque(size), _busy_queue(size),
+        _has_owner(has_owner), _size(size), _label(label) {
+#else
       : _current_queue_size(0), _size(size), _label(label) {
     _queue = new size_t[size];
+#endif
 #ifdef QUEUE_STATS
+#ifdef USE_WORK_STEALING_QUEUE
+    _max_queue_size.set(0);
+    _total_queue_size.set(0);
+    _avg_queue_size.set(0);
+    _avg_queue_size_count.set(0);
+#else
     _max_queue_size = 0;
     _total_queue_size = 0;
     _avg_queue_size = 0;
     _avg_queue_size_count = 0;
+#endif
 #endif
   }
 
   /**
    * @brief Destructor.
    */
-  inline ~TaskQueue() { delete[] _queue; }
+  inline ~TaskQueue() {
+#ifndef USE_WORK_STEALING_QUEUE
+    delete[] _queue;
+#endif
+  }
+
+#ifdef USE_WORK_STEALING_QUEUE
+private:
+  /**
+   * @brief Update the queue statistics after an interaction with the queue.
+   *
+   * @param number_added Number of tasks that was added during the interaction.
+   */
+  inline void update_statistics(const size_t number_added) {
+#ifdef QUEUE_STATS
+    const size_t current_queue_size = size();
+    _max_queue_size.max(current_queue_size);
+    _total_queue_size.post_add(number_added);
+    _avg_queue_size.post_add(current_queue_size);
+    _avg_queue_size_count.pre_increment();
+#endif
+  }
+
+  /**
+   * @brief Check if the dependency of the given task can be locked, and move
+   * the task to the busy queue if that is not the case.
+   *
+   * @param task Task.
+   * @param tasks Task space.
+   * @return True if the dependency of the task was locked.
+   */
+  inline bool check_task(const size_t task, ThreadSafeVector< Task > &tasks) {
+    if (tasks[task].lock_dependency()) {
+      return true;
+    } else {
+      if (!_busy_queue.push(task)) {
+        cmac_error("Too many busy tasks in queue! (%s)", _label.c_str());
+      }
+      return false;
+    }
+  }
+
+  /**
+   * @brief Try to get a task whose dependency was busy before.
+   *
+   * Every task that is in the busy queue when this function is called is
+   * tried at most once.
+   *
+   * @param tasks Task space.
+   * @return Task, or NO_TASK if no task is available.
+   */
+  inline size_t get_busy_task(ThreadSafeVector< Task > &tasks) {
+    const size_t number_of_busy_tasks = _busy_queue.size();
+    size_t task;
+    for (size_t i = 0; i < number_of_busy_tasks; ++i) {
+      if (!_busy_queue.pop(task)) {
+        return NO_TASK;
+      }
+      if (check_task(task, tasks)) {
+        return task;
+      }
+    }
+    return NO_TASK;
+  }
+
+  /**
+   * @brief Try to steal a task from the queue.
+   *
+   * Only the oldest task in the deque and incoming queue is considered.
+   *
+   * @param tasks Task space.
+   * @param retry Keep trying to steal from the deque as long as it contains
+   * tasks (rather than giving up when another thread wins the race for the
+   * oldest task)?
+   * @return Task, or NO_TASK if no task is available.
+   */
+  inline size_t steal_task(ThreadSafeVector< Task > &tasks, const bool retry) {
+    size_t task;
+    bool found = _deque.steal(task);
+    while (!found && retry && _deque.size() > 0) {
+      found = _deque.steal(task);
+    }
+    if (found || _incoming_queue.pop(task)) {
+      if (check_task(task, tasks)) {
+        return task;
+      }
+    }
+    return get_busy_task(tasks);
+  }
+
+public:
+#endif
 
   /**
    * @brief Add a task to the queue.
@@ -108,6 +260,12 @@ public:
    * @param task Task to add.
    */
   inline void add_task(const size_t task) {
+#ifdef USE_WORK_STEALING_QUEUE
+    if (!_incoming_queue.push(task)) {
+      cmac_error("Too many tasks in queue (%zu)! (%s)", _size, _label.c_str());
+    }
+    update_statistics(1);
+#else
     _queue_lock.lock();
     cmac_assert_message(_current_queue_size < _size,
                         "Too many tasks in queue (%zu < %zu)! (%s)",
@@ -121,6 +279,7 @@ public:
     ++_avg_queue_size_count;
 #endif
     _queue_lock.unlock();
+#endif
   }
 
   /**
@@ -135,6 +294,15 @@ public:
                         "Too many tasks for queue (%zu < %zu)! (%s)", task_end,
                         _size, _label.c_str());
 
+#ifdef USE_WORK_STEALING_QUEUE
+    for (size_t itask = task_start; itask < task_end; ++itask) {
+      if (!_incoming_queue.push(itask)) {
+        cmac_error("Too many tasks in queue (%zu)! (%s)", _size,
+                   _label.c_str());
+      }
+    }
+    update_statistics(task_end - task_start);
+#else
     _queue_lock.lock();
     const size_t new_task_count = task_end - task_start;
 #ifdef HAVE_OPENMP
@@ -152,6 +320,7 @@ public:
     _avg_queue_size_count += new_task_count;
 #endif
     _queue_lock.unlock();
+#endif
   }
 
   /**
@@ -159,11 +328,41 @@ public:
    *
    * This version locks the queue.
    *
+   * For the work-stealing implementation, this function takes the newest task
+   * from the deque if this queue has an owner (in which case the function
+   * should only be called by that owner). For queues without owner, the oldest
+   * task is stolen, and the function keeps trying as long as tasks are
+   * available.
+   *
    * @param tasks Task space.
    * @return Task, or NO_TASK if no task is available.
    */
   inline size_t get_task(ThreadSafeVector< Task > &tasks) {
 
+#ifdef USE_WORK_STEALING_QUEUE
+    size_t task = NO_TASK;
+    if (_has_owner) {
+      // move all newly added tasks into the deque
+      size_t new_task;
+      while (_incoming_queue.pop(new_task)) {
+        _deque.push(new_task);
+      }
+      // now take the newest task whose dependency can be locked
+      bool found = false;
+      while (!found && _deque.pop(new_task)) {
+        found = check_task(new_task, tasks);
+      }
+      if (found) {
+        task = new_task;
+      } else {
+        task = get_busy_task(tasks);
+      }
+    } else {
+      task = steal_task(tasks, true);
+    }
+    update_statistics(0);
+    return task;
+#else
     // initialize an empty task
     size_t task = NO_TASK;
 
@@ -196,6 +395,7 @@ public:
 
     // return the task
     return task;
+#endif
   }
 
   /**
@@ -204,11 +404,19 @@ public:
    * This version tries to lock the queue and bails out if another thread is
    * accessing it.
    *
+   * For the work-stealing implementation, this function steals the oldest
+   * task and bails out if another thread steals the same task first.
+   *
    * @param tasks Task space.
    * @return Task, or NO_TASK if no task is available.
    */
   inline size_t try_get_task(ThreadSafeVector< Task > &tasks) {
 
+#ifdef USE_WORK_STEALING_QUEUE
+    const size_t task = steal_task(tasks, false);
+    update_statistics(0);
+    return task;
+#else
     // initialize an empty task
     size_t task = NO_TASK;
 
@@ -243,14 +451,24 @@ public:
 
     // return the task
     return task;
+#endif
   }
 
   /**
    * @brief Get the current size of the queue.
    *
+   * For the work-stealing implementation, this value is only approximate if
+   * other threads are accessing the queue.
+   *
    * @return Current size of the queue.
    */
-  inline size_t size() const { return _current_queue_size; }
+  inline size_t size() const {
+#ifdef USE_WORK_STEALING_QUEUE
+    return _incoming_queue.size() + _deque.size() + _busy_queue.size();
+#else
+    return _current_queue_size;
+#endif
+  }
 
   /**
    * @brief Get the size in memory of the queue.
@@ -258,7 +476,12 @@ public:
    * @return Size in memory of the queue (in bytes).
    */
   inline size_t get_memory_size() const {
+#ifdef USE_WORK_STEALING_QUEUE
+    return QUEUE_FIXED_SIZE + _incoming_queue.get_memory_size() +
+           _deque.get_memory_size() + _busy_queue.get_memory_size();
+#else
     return QUEUE_FIXED_SIZE + _size * QUEUE_ELEMENT_SIZE;
+#endif
   }
 
 /**
@@ -267,7 +490,13 @@ public:
  * @return Maximum size of the queue.
  */
 #ifdef QUEUE_STATS
-  inline size_t get_max_queue_size() const { return _max_queue_size; }
+  inline size_t get_max_queue_size() const {
+#ifdef USE_WORK_STEALING_QUEUE
+    return _max_queue_size.value();
+#else
+    return _max_queue_size;
+#endif
+  }
 #endif
 
 /**
@@ -276,7 +505,13 @@ public:
  * @return Total number of tasks stored in the queue.
  */
 #ifdef QUEUE_STATS
-  inline size_t get_total_queue_size() const { return _total_queue_size; }
+  inline size_t get_total_queue_size() const {
+#ifdef USE_WORK_STEALING_QUEUE
+    return _total_queue_size.value();
+#else
+    return _total_queue_size;
+#endif
+  }
 #endif
 
   /**
@@ -286,7 +521,12 @@ public:
    */
 #ifdef QUEUE_STATS
   inline double get_average_queue_size() const {
+#ifdef USE_WORK_STEALING_QUEUE
+    return static_cast< double >(_avg_queue_size.value()) /
+           _avg_queue_size_count.value();
+#else
     return _avg_queue_size / _avg_queue_size_count;
+#endif
   }
 #endif
 
@@ -294,14 +534,26 @@ public:
  * @brief Reset the maximum size of the queue counter.
  */
 #ifdef QUEUE_STATS
-  inline void reset_max_queue_size() { _max_queue_size = 0; }
+  inline void reset_max_queue_size() {
+#ifdef USE_WORK_STEALING_QUEUE
+    _max_queue_size.set(0);
+#else
+    _max_queue_size = 0;
+#endif
+  }
 #endif
 
 /**
  * @brief Reset the counter for the total number of tasks in the queue.
  */
 #ifdef QUEUE_STATS
-  inline void reset_total_queue_size() { _total_queue_size = 0; }
+  inline void reset_total_queue_size() {
+#ifdef USE_WORK_STEALING_QUEUE
+    _total_queue_size.set(0);
+#else
+    _total_queue_size = 0;
+#endif
+  }
 #endif
 
 /**
@@ -309,8 +561,13 @@ public:
  */
 #ifdef QUEUE_STATS
   inline void reset_average_queue_size() {
+#ifdef USE_WORK_STEALING_QUEUE
+    _avg_queue_size.set(0);
+    _avg_queue_size_count.set(0);
+#else
     _avg_queue_size = 0;
     _avg_queue_size_count = 0;
+#endif
   }
 #endif
 };
@@ -33,6 +33,7 @@
 #include "DensityValues.hpp"
 #include "IonizationStateCalculator.hpp"
 #include "LineCoolingData.hpp"
+#include "LineCoolingTable.hpp"
 #include "PhysicalConstants.hpp"
 #include "RecombinationRates.hpp"
 #include "WorkDistributor.hpp"
@@ -78,7 +79,7 @@ TemperatureCalculator::TemperatureCalculator(
     const ChargeTransferRates &charge_transfer_rates, Log *log)
     : _luminosity(luminosity), _abundances(abundances), _pahfac(pahfac),
       _crfac(crfac), _crlim(crlim), _crscale(crscale),
-      _line_cooling_data(line_cooling_data),
+      _line_cooling_data(line_cooling_data), _line_cooling_table(nullptr),
       _recombination_rates(recombination_rates),
       _charge_transfer_rates(charge_transfer_rates),
       _ionization_state_calculator(luminosity, abundances, recombination_rates,
@@ -118,6 +119,28 @@ TemperatureCalculator::TemperatureCalculator(
  *    (default: 1.33333 kpc)
  *  - minimum ionized temperature: Temperature below which gas is assumed to be
  *    neutral (default: 4000. K).
+ *  - tabulate line cooling: Use a precomputed table to compute line cooling
+ *    rates instead of solving the level population equations for every cell
+ *    (default: false)
+ *  - line cooling table minimum temperature: Minimum temperature in the line
+ *    cooling table (default: 500. K)
+ *  - line cooling table maximum temperature: Maximum temperature in the line
+ *    cooling table (default: 1.e5 K)
+ *  - line cooling table minimum electron density: Minimum electron density in
+ *    the line cooling table (default: 1.e-2 cm^-3)
+ *  - line cooling table maximum electron density: Maximum electron density in
+ *    the line cooling table (default: 1.e8 cm^-3)
+ *  - line cooling table tolerance: Maximum relative difference between the
+ *    tabulated and exact line cooling rate of every coolant (default: 1.e-3)
+ *  - line cooling table maximum number of points: Maximum number of points in
+ *    each dimension of the line cooling table; the code aborts if the
+ *    tolerance cannot be reached with this number of points (default: 1025)
+ *  - line cooling table minimum cooling rate: Cooling rate per unit abundance
+ *    below which the line cooling table only needs to be accurate relative to
+ *    this value (in kg m^2 s^-3, default: 1.e-40)
+ *
+ * Outside the range of the line cooling table, the line cooling rates are
+ * computed exactly.
  *
  * @param luminosity Total ionizing luminosity of all photon sources (in s^-1).
  * @param abundances Abundances.
@@ -157,7 +180,267 @@ TemperatureCalculator::TemperatureCalculator(
               "1.33333 kpc"),
           params.get_physical_value< QUANTITY_TEMPERATURE >(
               "TemperatureCalculator:minimum ionized temperature", "4000. K"),
-          line_cooling_data, recombination_rates, charge_transfer_rates, log) {}
+          line_cooling_data, recombination_rates, charge_transfer_rates, log) {
+
+  if (params.get_value< bool >("TemperatureCalculator:tabulate line cooling",
+                               false)) {
+    _line_cooling_table = new LineCoolingTable(
+        line_cooling_data,
+        params.get_physical_value< QUANTITY_TEMPERATURE >(
+            "TemperatureCalculator:line cooling table minimum temperature",
+            "500. K"),
+        params.get_physical_value< QUANTITY_TEMPERATURE >(
+            "TemperatureCalculator:line cooling table maximum temperature",
+            "1.e5 K"),
+        params.get_physical_value< QUANTITY_NUMBER_DENSITY >(
+            "TemperatureCalculator:line cooling table minimum electron density",
+            "1.e-2 cm^-3"),
+        params.get_physical_value< QUANTITY_NUMBER_DENSITY >(
+            "TemperatureCalculator:line cooling table maximum electron density",
+            "1.e8 cm^-3"),
+        params.get_value< double >(
+            "TemperatureCalculator:line cooling table tolerance", 1.e-3),
+        params.get_value< uint_fast32_t >(
+            "TemperatureCalculator:line cooling table maximum number of points",
+            1025),
+        params.get_value< double >(
+            "TemperatureCalculator:line cooling table minimum cooling rate",
+            1.e-40),
+        log);
+  }
+}
+
+/**
+ * @brief Destructor.
+ *
+ * Frees up memory used by the line cooling table.
+ */
+TemperatureCalculator::~TemperatureCalculator() {
+  if (_line_cooling_table != nullptr) {
+    delete _line_cooling_table;
+  }
+}
+
+/**
+ * @brief Set the ionic fractions of all coolants to 0.
+ *
+ * @param ionization_variables Ionization variables of the cell.
+ */
+void TemperatureCalculator::reset_coolant_ionic_fractions(
+    IonizationVariables &ionization_variables) {
+
+#ifdef HAS_CARBON
+  ionization_variables.set_ionic_fraction(ION_C_p1, 0.);
+  ionization_variables.set_ionic_fraction(ION_C_p2, 0.);
+#endif
+
+#ifdef HAS_NITROGEN
+  ionization_variables.set_ionic_fraction(ION_N_n, 0.);
+  ionization_variables.set_ionic_fraction(ION_N_p1, 0.);
+  ionization_variables.set_ionic_fraction(ION_N_p2, 0.);
+#endif
+
+#ifdef HAS_OXYGEN
+  ionization_variables.set_ionic_fraction(ION_O_n, 0.);
+  ionization_variables.set_ionic_fraction(ION_O_p1, 0.);
+#endif
+
+#ifdef HAS_NEON
+  ionization_variables.set_ionic_fraction(ION_Ne_n, 0.);
+  ionization_variables.set_ionic_fraction(ION_Ne_p1, 0.);
+#endif
+
+#ifdef HAS_SULPHUR
+  ionization_variables.set_ionic_fraction(ION_S_p1, 0.);
+  ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
+  ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
+#endif
+}
+
+/**
+ * @brief Put a cell in the neutral state: a temperature of 500 K, neutral
+ * hydrogen and helium, coolants in the ground state and no heating.
+ *
+ * @param ionization_variables Ionization variables of the cell.
+ */
+void TemperatureCalculator::set_neutral_state(
+    IonizationVariables &ionization_variables) {
+
+  ionization_variables.set_temperature(500.);
+
+  ionization_variables.set_ionic_fraction(ION_H_n, 1.);
+
+#ifdef HAS_HELIUM
+  ionization_variables.set_ionic_fraction(ION_He_n, 1.);
+#endif
+
+  reset_coolant_ionic_fractions(ionization_variables);
+
+  // set the heating term values to zero
+  for (int_fast32_t heating_term = 0; heating_term < NUMBER_OF_HEATINGTERMS;
+       ++heating_term) {
+    ionization_variables.set_heating(heating_term, 0.);
+  }
+}
+
+/**
+ * @brief Get the abundances of the coolant ions in a cell for which the ionic
+ * fractions of the coolants have been computed, in the form required by
+ * LineCoolingData.
+ *
+ * @param input_abundances Abundances.
+ * @param ionization_variables Ionization variables of the cell.
+ * @param abund Array to store the LINECOOLINGDATA_NUMELEMENTS coolant
+ * abundances in.
+ */
+void TemperatureCalculator::get_coolant_abundances(
+    const Abundances &input_abundances,
+    const IonizationVariables &ionization_variables, double *abund) {
+
+#ifndef HAVE_HYDROGEN_ONLY
+#ifdef VARIABLE_ABUNDANCES
+  const Abundances &abundances = ionization_variables.get_abundances();
+#else
+  const Abundances &abundances = input_abundances;
+#endif
+#endif
+
+  for (int_fast32_t i = 0; i < LINECOOLINGDATA_NUMELEMENTS; ++i) {
+    abund[i] = 0.;
+  }
+
+#ifdef HAS_CARBON
+  // carbon
+  // we assume that all carbon is either C+, C++, or C+++
+  // we only use C+ and C++
+  // note that the ionic fraction of C_p1 corresponds to the fraction of ionized
+  // C+, i.e. the fraction of C++
+  abund[CII] = abundances.get_abundance(ELEMENT_C) *
+               (1. - ionization_variables.get_ionic_fraction(ION_C_p1) -
+                ionization_variables.get_ionic_fraction(ION_C_p2));
+  abund[CIII] = abundances.get_abundance(ELEMENT_C) *
+                ionization_variables.get_ionic_fraction(ION_C_p1);
+#endif
+
+#ifdef HAS_NITROGEN
+  // nitrogen
+  // we assume all nitrogen is either N0, N+, N++ or N+++
+  // we only use N0, N+ and N++
+  abund[NI] = abundances.get_abundance(ELEMENT_N) *
+              (1. - ionization_variables.get_ionic_fraction(ION_N_n) -
+               ionization_variables.get_ionic_fraction(ION_N_p1) -
+               ionization_variables.get_ionic_fraction(ION_N_p2));
+  abund[NII] = abundances.get_abundance(ELEMENT_N) *
+               ionization_variables.get_ionic_fraction(ION_N_n);
+  abund[NIII] = abundances.get_abundance(ELEMENT_N) *
+                ionization_variables.get_ionic_fraction(ION_N_p1);
+#endif
+
+#ifdef HAS_OXYGEN
+  // oxygen
+  // we assume all oxygen is either O0, O+ or O++
+  // we use all of them
+  abund[OI] = abundances.get_abundance(ELEMENT_O) *
+              (1. - ionization_variables.get_ionic_fraction(ION_O_n) -
+               ionization_variables.get_ionic_fraction(ION_O_p1));
+  abund[OII] = abundances.get_abundance(ELEMENT_O) *
+               ionization_variables.get_ionic_fraction(ION_O_n);
+  abund[OIII] = abundances.get_abundance(ELEMENT_O) *
+                ionization_variables.get_ionic_fraction(ION_O_p1);
+#endif
+
+#ifdef HAS_NEON
+  // neon
+  // we make no assumptions on the relative abundances of different neon ions
+  // we only use Ne+ and Ne++
+  abund[NeII] = abundances.get_abundance(ELEMENT_Ne) *
+                ionization_variables.get_ionic_fraction(ION_Ne_n);
+  abund[NeIII] = abundances.get_abundance(ELEMENT_Ne) *
+                 ionization_variables.get_ionic_fraction(ION_Ne_p1);
+#endif
+
+#ifdef HAS_SULPHUR
+  // sulphur
+  // we assume all sulphur is either S+, S++, S+++ or S++++
+  // we only use S+ and S++
+  abund[SII] = abundances.get_abundance(ELEMENT_S) *
+               (1. - ionization_variables.get_ionic_fraction(ION_S_p1) -
+                ionization_variables.get_ionic_fraction(ION_S_p2) -
+                ionization_variables.get_ionic_fraction(ION_S_p3));
+  abund[SIII] = abundances.get_abundance(ELEMENT_S) *
+                ionization_variables.get_ionic_fraction(ION_S_p1);
+  abund[SIV] = abundances.get_abundance(ELEMENT_S) *
+               ionization_variables.get_ionic_fraction(ION_S_p2);
+#endif
+}
+
+#ifdef DO_OUTPUT_COOLING
+/**
+ * @brief Compute the line cooling rate for a cell for which the ionic
+ * fractions of the coolants have been computed, and store the cooling rate of
+ * each coolant ion in the cell.
+ *
+ * @param T Temperature (in K).
+ * @param ne Number density of free electrons (in m^-3).
+ * @param n Number density in the cell (in m^-3).
+ * @param input_abundances Abundances.
+ * @param ionization_variables Ionization variables of the cell.
+ * @param line_cooling_data LineCoolingData used to calculate line cooling.
+ * @return Line cooling rate (in J m^-3 s^-1).
+ */
+double TemperatureCalculator::compute_line_cooling(
+    const double T, const double ne, const double n,
+    const Abundances &input_abundances,
+    IonizationVariables &ionization_variables,
+    const LineCoolingData &line_cooling_data) {
+
+  // get the abundances required by LineCoolingData and feed them to that class
+  double abund[LINECOOLINGDATA_NUMELEMENTS];
+  get_coolant_abundances(input_abundances, ionization_variables, abund);
+
+  double loss = 0.;
+  std::vector< std::vector< double > > lines =
+      line_cooling_data.get_line_strengths(T, ne, abund);
+  std::vector< double > cooling(lines.size());
+  for (size_t i = 0; i < lines.size(); ++i) {
+    cooling[i] = 0.;
+    for (size_t j = 0; j < lines[i].size(); ++j) {
+      cooling[i] += lines[i][j];
+    }
+    cooling[i] *= n;
+    loss += cooling[i];
+  }
+
+#ifdef HAS_CARBON
+  ionization_variables.set_cooling(ION_C_p1, cooling[CII]);
+  ionization_variables.set_cooling(ION_C_p2, cooling[CIII]);
+#endif
+
+#ifdef HAS_NITROGEN
+  ionization_variables.set_cooling(ION_N_n, cooling[NI]);
+  ionization_variables.set_cooling(ION_N_p1, cooling[NII]);
+  ionization_variables.set_cooling(ION_N_p2, cooling[NIII]);
+#endif
+
+#ifdef HAS_OXYGEN
+  ionization_variables.set_cooling(ION_O_n, cooling[OII]);
+  ionization_variables.set_cooling(ION_O_p1, cooling[OIII]);
+#endif
+
+#ifdef HAS_NEON
+  ionization_variables.set_cooling(ION_Ne_n, cooling[NeII]);
+  ionization_variables.set_cooling(ION_Ne_p1, cooling[NeIII]);
+#endif
+
+#ifdef HAS_SULPHUR
+  ionization_variables.set_cooling(ION_S_p1, cooling[SII]);
+  ionization_variables.set_cooling(ION_S_p2, cooling[SIII]);
+  ionization_variables.set_cooling(ION_S_p3, cooling[SIV]);
+#endif
+
+  return loss;
+}
+#endif
 
 /**
  * @brief Function that calculates the cooling and heating rate for a given
@@ -182,6 +465,8 @@ TemperatureCalculator::TemperatureCalculator(
  * In the fourth and final step, we use our knowledge of the ionization state of
  * the coolants to compute actual cooling rates.
  *
+ * This is a batch of one cell for compute_cooling_and_heating_balance_batch().
+ *
  * @param h0 Variable to store the hydrogen neutral fraction in.
  * @param he0 Variable to store the helium neutral fraction in.
  * @param gain Total energy gain due to heating.
@@ -203,6 +488,9 @@ TemperatureCalculator::TemperatureCalculator(
  * fractions.
  * @param charge_transfer_rates ChargeTransferRates used to calculate ionic
  * fractions.
+ * @param line_cooling_table Optional precomputed table of line cooling rates
+ * (if not nullptr, this table is used instead of line_cooling_data to compute
+ * the total line cooling rate).
  */
 void TemperatureCalculator::compute_cooling_and_heating_balance(
     double &h0, double &he0, double &gain, double &loss, double T,
@@ -212,78 +500,112 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
     double pahfac, double crfac, double crscale,
     const LineCoolingData &line_cooling_data,
     const RecombinationRates &recombination_rates,
-    const ChargeTransferRates &charge_transfer_rates) {
+    const ChargeTransferRates &charge_transfer_rates,
+    const LineCoolingTable *line_cooling_table) {
 
-  /// step 0: initialize some variables
+  double j_batch[1][NUMBER_OF_IONNAMES];
+  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+    j_batch[0][ion] = j[ion];
+  }
+  double h_batch[1][NUMBER_OF_HEATINGTERMS];
+  for (int_fast32_t heating_term = 0; heating_term < NUMBER_OF_HEATINGTERMS;
+       ++heating_term) {
+    h_batch[0][heating_term] = h[heating_term];
+  }
+  IonizationVariables *ionization_variables_pointer = &ionization_variables;
+  compute_cooling_and_heating_balance_batch(
+      1, &h0, &he0, &gain, &loss, &T, &ionization_variables_pointer,
+      &cell_midpoint, j_batch, input_abundances, h_batch, pahfac, &crfac,
+      crscale, line_cooling_data, recombination_rates, charge_transfer_rates,
+      line_cooling_table);
+}
 
-  // get the recombination rates of all elements at the selected temperature
-  const double alphaH = recombination_rates.get_recombination_rate(ION_H_n, T);
-#ifdef HAS_HELIUM
-  const double alphaHe =
-      recombination_rates.get_recombination_rate(ION_He_n, T);
-#else
-  const double alphaHe = 0.;
-#endif
+/**
+ * @brief Batched version of compute_cooling_and_heating_balance().
+ *
+ * The four steps are done for all cells in the batch at once: the hydrogen and
+ * helium ionization balance and the coolant ionization balance use the batched
+ * IonizationStateCalculator functions, the line cooling rates are looked up in
+ * the line cooling table for all cells together (if there is a table), and the
+ * heating and the free-free and recombination cooling are computed in plain
+ * loops over the batch that the compiler can vectorise.
+ *
+ * @param number_of_cells Number of cells in the batch (at most
+ * IONIZATIONSTATECALCULATOR_BATCH_SIZE).
+ * @param h0 Array to store the hydrogen neutral fractions in.
+ * @param he0 Array to store the helium neutral fractions in.
+ * @param gain Array to store the total energy gain due to heating in.
+ * @param loss Array to store the total energy loss due to cooling in.
+ * @param T Temperature for each cell (in K).
+ * @param ionization_variables Ionization variables for the cells.
+ * @param cell_midpoint Midpoints of the cells.
+ * @param j Mean ionizing intensity integrals for each cell (in s^-1).
+ * @param input_abundances Abundances.
+ * @param h Heating integrals for each cell (in J s^-1).
+ * @param pahfac Normalization factor for PAH heating.
+ * @param crfac Normalization factor for cosmic ray heating in each cell.
+ * @param crscale Scale height of the cosmic ray heating term (0 for a constant
+ * heating term; in m).
+ * @param line_cooling_data LineCoolingData used to calculate line cooling.
+ * @param recombination_rates RecombinationRates used to calculate ionic
+ * fractions.
+ * @param charge_transfer_rates ChargeTransferRates used to calculate ionic
+ * fractions.
+ * @param line_cooling_table Optional precomputed table of line cooling rates
+ * (if not nullptr, this table is used instead of line_cooling_data to compute
+ * the total line cooling rate).
+ */
+void TemperatureCalculator::compute_cooling_and_heating_balance_batch(
+    const uint_fast32_t number_of_cells, double *h0, double *he0, double *gain,
+    double *loss, const double *T, IonizationVariables **ionization_variables,
+    const CoordinateVector<> *cell_midpoint,
+    const double (*j)[NUMBER_OF_IONNAMES], const Abundances &input_abundances,
+    const double (*h)[NUMBER_OF_HEATINGTERMS], const double pahfac,
+    const double *crfac, const double crscale,
+    const LineCoolingData &line_cooling_data,
+    const RecombinationRates &recombination_rates,
+    const ChargeTransferRates &charge_transfer_rates,
+    const LineCoolingTable *line_cooling_table) {
 
-  // mean intensity integrals
-  const double jH = j[ION_H_n];
-#ifdef HAS_HELIUM
-  const double jHe = j[ION_He_n];
-#else
-  const double jHe = 0.;
-#endif
+  cmac_assert(number_of_cells <= IONIZATIONSTATECALCULATOR_BATCH_SIZE);
 
-  // heating integrals
-  const double hH = h[HEATINGTERM_H];
+  /// step 0: initialize some variables
+  // the arrays are initialized to keep the compiler from warning about the
+  // unused entries beyond number_of_cells
+  double alphaH[IONIZATIONSTATECALCULATOR_BATCH_SIZE] = {0.};
+  double alphaHe[IONIZATIONSTATECALCULATOR_BATCH_SIZE] = {0.};
+  double jH[IONIZATIONSTATECALCULATOR_BATCH_SIZE] = {0.};
+  double jHe[IONIZATIONSTATECALCULATOR_BATCH_SIZE] = {0.};
+  double n[IONIZATIONSTATECALCULATOR_BATCH_SIZE] = {0.};
+  double AHe[IONIZATIONSTATECALCULATOR_BATCH_SIZE] = {0.};
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    // get the recombination rates of all elements at the selected temperature
+    alphaH[i] = recombination_rates.get_recombination_rate(ION_H_n, T[i]);
+    // mean intensity integrals
+    jH[i] = j[i][ION_H_n];
+    // number density in the cell
+    n[i] = ionization_variables[i]->get_number_density();
 #ifdef HAS_HELIUM
-  const double hHe = h[HEATINGTERM_He];
-#else
-  const double hHe = 0.;
-#endif
-
-  // number density in the cell
-  const double n = ionization_variables.get_number_density();
-
-  // some frequently used expressions involving the temperature
-  // we precompute them here to increase the efficiency
-  const double T4 = T * 1.e-4;
-  const double sqrtT = std::sqrt(T);
-  const double logT = std::log(T);
-
-#ifndef HAVE_HYDROGEN_ONLY
+    alphaHe[i] = recombination_rates.get_recombination_rate(ION_He_n, T[i]);
+    jHe[i] = j[i][ION_He_n];
+    // helium abundance. Used to scale the helium number density.
 #ifdef VARIABLE_ABUNDANCES
-  const Abundances &abundances = ionization_variables.get_abundances();
+    AHe[i] =
+        ionization_variables[i]->get_abundances().get_abundance(ELEMENT_He);
 #else
-  const Abundances &abundances = input_abundances;
-#endif
+    AHe[i] = input_abundances.get_abundance(ELEMENT_He);
 #endif
-
-#ifdef HAS_HELIUM
-  // helium abundance. Used to scale the helium number density.
-  const double AHe = abundances.get_abundance(ELEMENT_He);
 #else
-  const double AHe = 0.;
+    alphaHe[i] = 0.;
+    jHe[i] = 0.;
+    AHe[i] = 0.;
 #endif
+  }
 
   /// step 1: get the ionization equilibrium for hydrogen and helium
 
-  IonizationStateCalculator::compute_ionization_states_hydrogen_helium(
-      alphaH, alphaHe, jH, jHe, n, AHe, T, h0, he0);
-
-  // the ionization equilibrium gives us the electron density (we neglect free
-  // electrons coming from ionization of coolants)
-  const double ne = n * (1. - h0 + AHe * (1. - he0));
-
-  // make sure the electron density is a number
-  cmac_assert(ne == ne);
-
-  // we also need the number densities of H+ and He+
-  const double nhp = n * (1. - h0);
-  const double nhep = (1. - he0) * n * AHe;
-
-  // we precompute some frequently used products of number densities
-  const double nenhp = ne * nhp;
-  const double nenhep = ne * nhep;
+  IonizationStateCalculator::compute_ionization_states_hydrogen_helium_batch(
+      number_of_cells, alphaH, alphaHe, jH, jHe, n, AHe, T, h0, he0);
 
   /// step 2: heating
   // the heating consists of 4 terms:
@@ -293,55 +615,93 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   //  - PAH heating (if active)
   //  - cosmic ray heating (if active)
 
-  // ionization heating
-  gain = n * (hH * h0 + hHe * AHe * he0);
-
-  // He Lyman alpha on the spot heating
-  // Wood, Mathis & Ercolano (2004), equation 25
-  // NOTE that this is a different expression from the one in Kenny's code!
-  // Kenny's expression is in units cm^3 s^-1, we multiplied by 1.e-6 to convert
-  // to m^3 s^-1
-  const double alpha_e_2sP = 4.17e-20 * std::pow(T4, -0.861);
-  // Wood, Mathis & Ercolano (2004), equation 17
-  // we extracted the factor 10^4 from the square root and multiplied it with
-  // the constant 0.77
-  const double pHots = 1. / (1. + 77. * he0 / (sqrtT * h0));
-  // the constant factor is the energy gain due to a helium Lyman alpha photon
-  // being absorbed by hydrogen: (21.2 eV - 13.6 eV) = 1.21765423e-18 J
-  gain += pHots * 1.21765423e-18 * alpha_e_2sP * nenhep;
-
-  // PAH heating
-  // the numerical factors were estimated from Weingartner, J. C. & Draine, B.
-  // T. 2001, ApJS, 134, 263 (http://adsabs.harvard.edu/abs/2001ApJS..134..263W)
-  // as the net heating-cooling rate for a full black body star (tables 4 and 5)
-  // we multiplied Kenny's value with 1.e-12 to convert densities to m^-3
-  // we then multiplied with 0.1 to convert to J m^-3s^-1
-  gain += 1.5e-37 * n * ne * pahfac;
-
-  // cosmic ray heating
-  // erg/cm^(9/2)/s --> J/m^(9/2)/s ==> 1.2e-27 --> 1.2e-25
-  // value comes from equation (53) in Wiener, J., Zweibel, E. G. & Oh, S. P.
-  // 2013, ApJ, 767, 87 (http://adsabs.harvard.edu/abs/2013ApJ...767...87W)
-  double heatcr = 0.;
-  if (crfac > 0.) {
-    heatcr = crfac * 1.2e-25 / std::sqrt(ne);
-    if (crscale > 0.) {
-      heatcr *= std::exp(-std::abs(cell_midpoint.z()) / crscale);
+  double ne[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nhp[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nh0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nhe0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nenhp[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nenhep[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    const double sqrtT = std::sqrt(T[i]);
+
+    // the ionization equilibrium gives us the electron density (we neglect
+    // free electrons coming from ionization of coolants)
+    ne[i] = n[i] * (1. - h0[i] + AHe[i] * (1. - he0[i]));
+
+    // make sure the electron density is a number
+    cmac_assert(ne[i] == ne[i]);
+
+    // we also need the number densities of H+ and He+
+    nhp[i] = n[i] * (1. - h0[i]);
+    const double nhep = (1. - he0[i]) * n[i] * AHe[i];
+
+    // we precompute some frequently used products of number densities
+    nenhp[i] = ne[i] * nhp[i];
+    nenhep[i] = ne[i] * nhep;
+
+    // heating integrals
+    const double hH = h[i][HEATINGTERM_H];
+#ifdef HAS_HELIUM
+    const double hHe = h[i][HEATINGTERM_He];
+#else
+    const double hHe = 0.;
+#endif
+
+    // ionization heating
+    gain[i] = n[i] * (hH * h0[i] + hHe * AHe[i] * he0[i]);
+
+    // He Lyman alpha on the spot heating
+    const double alpha_e_2sP =
+        IonizationStateCalculator::get_alpha_e_2sP(T[i]);
+    // Wood, Mathis & Ercolano (2004), equation 17
+    // we extracted the factor 10^4 from the square root and multiplied it with
+    // the constant 0.77
+    const double pHots = 1. / (1. + 77. * he0[i] / (sqrtT * h0[i]));
+    // the constant factor is the energy gain due to a helium Lyman alpha
+    // photon being absorbed by hydrogen: (21.2 eV - 13.6 eV) = 1.21765423e-18 J
+    gain[i] += pHots * 1.21765423e-18 * alpha_e_2sP * nenhep[i];
+
+    // PAH heating
+    // the numerical factors were estimated from Weingartner, J. C. & Draine,
+    // B. T. 2001, ApJS, 134, 263
+    // (http://adsabs.harvard.edu/abs/2001ApJS..134..263W) as the net
+    // heating-cooling rate for a full black body star (tables 4 and 5)
+    // we multiplied Kenny's value with 1.e-12 to convert densities to m^-3
+    // we then multiplied with 0.1 to convert to J m^-3s^-1
+    gain[i] += 1.5e-37 * n[i] * ne[i] * pahfac;
+
+    // cosmic ray heating
+    // erg/cm^(9/2)/s --> J/m^(9/2)/s ==> 1.2e-27 --> 1.2e-25
+    // value comes from equation (53) in Wiener, J., Zweibel, E. G. & Oh, S. P.
+    // 2013, ApJ, 767, 87 (http://adsabs.harvard.edu/abs/2013ApJ...767...87W)
+    double heatcr = 0.;
+    if (crfac[i] > 0.) {
+      heatcr = crfac[i] * 1.2e-25 / std::sqrt(ne[i]);
+      if (crscale > 0.) {
+        heatcr *= std::exp(-std::abs(cell_midpoint[i].z()) / crscale);
+      }
     }
+    gain[i] += heatcr;
+
+    // we precompute the number density of neutral hydrogen and neutral helium
+    // for the next step
+    nh0[i] = n[i] * h0[i];
+    nhe0[i] = n[i] * he0[i] * AHe[i];
   }
-  gain += heatcr;
 
   /// step 3: ionization balance of coolants
 
   // we first compute the ionic fractions of the different ions of the coolants
   // they are then used as input for the line cooling routine
 
-  // we precompute the number density of neutral hydrogen and neutral helium
-  const double nh0 = n * h0;
-  const double nhe0 = n * he0 * AHe;
+  double j_metals[IONIZATIONSTATECALCULATOR_BATCH_SIZE]
+                 [IONIZATIONSTATECALCULATOR_NUMBER_OF_METAL_IONS];
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    IonizationStateCalculator::get_metal_mean_intensities(j[i], j_metals[i]);
+  }
 
-  IonizationStateCalculator::compute_ionization_states_metals(
-      &j[2], ne, T, T4, nh0, nhe0, nhp, recombination_rates,
+  IonizationStateCalculator::compute_ionization_states_metals_batch(
+      number_of_cells, j_metals, ne, T, nh0, nhe0, nhp, recombination_rates,
       charge_transfer_rates, ionization_variables);
 
   /// step 4: cooling
@@ -351,153 +711,335 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   //  - cooling due to recombination of hydrogen and helium
 
   // coolants
-  // get the abundances required by LineCoolingData and feed them to that class
-  double abund[LINECOOLINGDATA_NUMELEMENTS];
-
-#ifdef HAS_CARBON
-  // carbon
-  // we assume that all carbon is either C+, C++, or C+++
-  // we only use C+ and C++
-  // note that the ionic fraction of C_p1 corresponds to the fraction of ionized
-  // C+, i.e. the fraction of C++
-  abund[CII] = abundances.get_abundance(ELEMENT_C) *
-               (1. - ionization_variables.get_ionic_fraction(ION_C_p1) -
-                ionization_variables.get_ionic_fraction(ION_C_p2));
-  abund[CIII] = abundances.get_abundance(ELEMENT_C) *
-                ionization_variables.get_ionic_fraction(ION_C_p1);
+#ifdef DO_OUTPUT_COOLING
+  // we need the cooling rates of the individual coolants, which are only
+  // available from the exact line strengths
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    loss[i] =
+        compute_line_cooling(T[i], ne[i], n[i], input_abundances,
+                             *ionization_variables[i], line_cooling_data);
+  }
+#else
+  double abund[IONIZATIONSTATECALCULATOR_BATCH_SIZE]
+              [LINECOOLINGDATA_NUMELEMENTS];
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    get_coolant_abundances(input_abundances, *ionization_variables[i],
+                           abund[i]);
+  }
+  if (line_cooling_table != nullptr) {
+    line_cooling_table->get_cooling(number_of_cells, T, ne, abund, loss);
+  } else {
+    for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+      loss[i] = line_cooling_data.get_cooling(T[i], ne[i], abund[i]);
+    }
+  }
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    loss[i] *= n[i];
+  }
 #endif
 
-#ifdef HAS_NITROGEN
-  // nitrogen
-  // we assume all nitrogen is either N0, N+, N++ or N+++
-  // we only use N0, N+ and N++
-  abund[NI] = abundances.get_abundance(ELEMENT_N) *
-              (1. - ionization_variables.get_ionic_fraction(ION_N_n) -
-               ionization_variables.get_ionic_fraction(ION_N_p1) -
-               ionization_variables.get_ionic_fraction(ION_N_p2));
-  abund[NII] = abundances.get_abundance(ELEMENT_N) *
-               ionization_variables.get_ionic_fraction(ION_N_n);
-  abund[NIII] = abundances.get_abundance(ELEMENT_N) *
-                ionization_variables.get_ionic_fraction(ION_N_p1);
-#endif
+  double Lhp[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double Lhep[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    // some frequently used expressions involving the temperature
+    const double sqrtT = std::sqrt(T[i]);
+    const double logT = std::log(T[i]);
+
+    // free-free cooling (bremsstrahlung)
+
+    // fit to the free-free emission Gaunt factor from Katz, N., Weinberg,
+    // D. H. & Hernquist, L. 1996, ApJS, 105, 19
+    // (http://adsabs.harvard.edu/abs/1996ApJS..105...19K), equation 23
+    const double c = 5.5 - logT;
+    const double gff = 1.1 + 0.34 * std::exp(-c * c / 3.);
+    // Wood, Mathis & Ercolano (2004), equation 22
+    // based on section 3.4 of Osterbrock, D. E. & Ferland, G. J. 2006,
+    // Astrophysics of Gaseous Nebulae and Active Galactic Nuclei, 2nd edition
+    // (http://adsabs.harvard.edu/abs/2006agna.book.....O)
+    loss[i] += 1.42e-40 * gff * sqrtT * (nenhp[i] + nenhep[i]);
+
+    // cooling due to recombination of hydrogen and helium
+
+    // we multiplied Kenny's value with 1.e-12 to convert the densities into
+    // m^-3
+    // we then multiplied with 0.1 to convert them to J m^-3s^-1
+    // expressions come from Black (1981), table 3
+    // valid in the range [5,000 K; 50,000 K]
+    // NOTE that the expression for helium is different from that in Kenny's
+    // code (it is the same as the commented out expression in Kenny's code)
+    Lhp[i] = 2.85e-40 * nenhp[i] * sqrtT *
+             (5.914 - 0.5 * logT + 0.01184 * std::cbrt(T[i]));
+    Lhep[i] = 1.55e-39 * nenhep[i] * std::pow(T[i], 0.3647);
+    loss[i] += Lhp[i] + Lhep[i];
+
+    // make sure losses are losses and gains are gains
+    loss[i] = std::max(loss[i], 0.);
+    gain[i] = std::max(gain[i], 0.);
+  }
 
-#ifdef HAS_OXYGEN
-  // oxygen
-  // we assume all oxygen is either O0, O+ or O++
-  // we use all of them
-  abund[OI] = abundances.get_abundance(ELEMENT_O) *
-              (1. - ionization_variables.get_ionic_fraction(ION_O_n) -
-               ionization_variables.get_ionic_fraction(ION_O_p1));
-  abund[OII] = abundances.get_abundance(ELEMENT_O) *
-               ionization_variables.get_ionic_fraction(ION_O_n);
-  abund[OIII] = abundances.get_abundance(ELEMENT_O) *
-                ionization_variables.get_ionic_fraction(ION_O_p1);
+#ifdef DO_OUTPUT_COOLING
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    ionization_variables[i]->set_cooling(ION_H_n, Lhp[i]);
+#ifdef HAS_HELIUM
+    ionization_variables[i]->set_cooling(ION_He_n, Lhep[i]);
+#endif
+  }
 #endif
+}
 
-#ifdef HAS_NEON
-  // neon
-  // we make no assumptions on the relative abundances of different neon ions
-  // we only use Ne+ and Ne++
-  abund[NeII] = abundances.get_abundance(ELEMENT_Ne) *
-                ionization_variables.get_ionic_fraction(ION_Ne_n);
-  abund[NeIII] = abundances.get_abundance(ELEMENT_Ne) *
-                 ionization_variables.get_ionic_fraction(ION_Ne_p1);
+
+/**
+ * @brief Prepare the temperature calculation for the given cell.
+ *
+ * Cells that do not receive ionizing radiation, and cells that are not ionized
+ * enough to be affected by cosmic ray heating, are put in the neutral state
+ * and do not need a temperature iteration.
+ *
+ * @param ionization_variables Ionization variables of the cell.
+ * @param jfac Normalization factor for the mean intensity integrals.
+ * @param hfac Normalization factor for the heating integrals.
+ * @param T0 Variable to store the initial temperature guess in (in K).
+ * @param j Array to store the normalized mean intensity integrals in (in s^-1).
+ * @param h Array to store the normalized heating integrals in (in J s^-1).
+ * @param crfac Variable to store the cosmic ray heating factor for the cell in.
+ * @return True if the cell needs a temperature iteration.
+ */
+bool TemperatureCalculator::initialize_temperature_calculation(
+    IonizationVariables &ionization_variables, const double jfac,
+    const double hfac, double &T0, double j[NUMBER_OF_IONNAMES],
+    double h[NUMBER_OF_HEATINGTERMS], double &crfac) const {
+
+  const double jH = jfac * ionization_variables.get_mean_intensity(ION_H_n);
+#ifdef HAS_HELIUM
+  const double jHe = jfac * ionization_variables.get_mean_intensity(ION_He_n);
+#else
+  const double jHe = 0.;
 #endif
 
-#ifdef HAS_SULPHUR
-  // sulphur
-  // we assume all sulphur is either S+, S++, S+++ or S++++
-  // we only use S+ and S++
-  abund[SII] = abundances.get_abundance(ELEMENT_S) *
-               (1. - ionization_variables.get_ionic_fraction(ION_S_p1) -
-                ionization_variables.get_ionic_fraction(ION_S_p2) -
-                ionization_variables.get_ionic_fraction(ION_S_p3));
-  abund[SIII] = abundances.get_abundance(ELEMENT_S) *
-                ionization_variables.get_ionic_fraction(ION_S_p1);
-  abund[SIV] = abundances.get_abundance(ELEMENT_S) *
-               ionization_variables.get_ionic_fraction(ION_S_p2);
+  // if the ionizing intensity is 0, the gas is trivially neutral and all
+  // coolants are in the ground state
+  if ((jH == 0. && jHe == 0.) ||
+      ionization_variables.get_number_density() == 0.) {
+    set_neutral_state(ionization_variables);
+    return false;
+  }
+
+  crfac = _crfac * ionization_variables.get_cosmic_ray_factor();
+  if (crfac < 0.) {
+    crfac = _crfac;
+  }
+
+  // if cosmic ray heating is active, check if the gas is ionized enough
+  // if it is not, we just assume the gas is neutral and do not apply heating
+  if (crfac > 0.) {
+    const double alphaH =
+        _recombination_rates.get_recombination_rate(ION_H_n, 8000.);
+#ifdef HAS_HELIUM
+    const double alphaHe =
+        _recombination_rates.get_recombination_rate(ION_He_n, 8000.);
+#else
+    const double alphaHe = 0.;
+#endif
+    const double nH = ionization_variables.get_number_density();
+#ifdef HAS_HELIUM
+#ifdef VARIABLE_ABUNDANCES
+    const double AHe =
+        ionization_variables.get_abundances().get_abundance(ELEMENT_He);
+#else
+    const double AHe = _abundances.get_abundance(ELEMENT_He);
+#endif
+#else
+    const double AHe = 0.;
 #endif
+    double h0, he0;
+    IonizationStateCalculator::compute_ionization_states_hydrogen_helium(
+        alphaH, alphaHe, jH, jHe, nH, AHe, 8000., h0, he0);
+    if (h0 > _crlim) {
+      // assume fully neutral
+      set_neutral_state(ionization_variables);
+      return false;
+    }
+  }
 
-#ifdef DO_OUTPUT_COOLING
-  loss = 0.;
-  std::vector< std::vector< double > > lines =
-      line_cooling_data.get_line_strengths(T, ne, abund);
-  std::vector< double > cooling(lines.size());
-  for (size_t i = 0; i < lines.size(); ++i) {
-    cooling[i] = 0.;
-    for (size_t j = 0; j < lines[i].size(); ++j) {
-      cooling[i] += lines[i][j];
+  // we make sure our initial temperature guess is high enough
+  T0 = ionization_variables.get_temperature();
+  if (ionization_variables.get_temperature() <= 4000.) {
+    T0 = 8000.;
+  }
+
+  // normalize the mean intensity integrals
+  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+    j[ion] = jfac * ionization_variables.get_mean_intensity(ion);
+  }
+
+  // normalize the heating integrals
+  for (int_fast32_t heating_term = 0; heating_term < NUMBER_OF_HEATINGTERMS;
+       ++heating_term) {
+    h[heating_term] = hfac * ionization_variables.get_heating(heating_term);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Do a single secant step of the temperature iteration.
+ *
+ * See calculate_temperature() for the underlying equations.
+ *
+ * @param T0 Current temperature guess, updated to the new guess (in K).
+ * @param T1 Upper temperature that was used for the secant step (in K).
+ * @param h0 Hydrogen neutral fraction at the current temperature guess,
+ * updated if the gas turns out to be completely neutral or ionized.
+ * @param he0 Helium neutral fraction at the current temperature guess, updated
+ * if the gas turns out to be completely neutral or ionized.
+ * @param gain0 Heating at the current temperature guess, forced to the
+ * converged value if the iteration needs to stop.
+ * @param loss0 Cooling at the current temperature guess, forced to the
+ * converged value if the iteration needs to stop.
+ * @param gain1 Heating at the upper temperature.
+ * @param loss1 Cooling at the upper temperature.
+ * @param gain2 Heating at the lower temperature.
+ * @param loss2 Cooling at the lower temperature.
+ */
+void TemperatureCalculator::update_temperature_guess(
+    double &T0, const double T1, double &h0, double &he0, double &gain0,
+    double &loss0, const double gain1, const double loss1, const double gain2,
+    const double loss2) const {
+
+  // funny detail: this value is actually constant :p
+  static const double logtt = std::log(1.1 / 0.9);
+  double expgain;
+  if (gain2 > 0.) {
+    if (gain1 > 0.) {
+      expgain = std::log(gain1 / gain2);
+    } else {
+      // expgain = std::log(0.) = std::log(very small number) = -99.
+      expgain = -99.;
     }
-    cooling[i] *= n;
-    loss += cooling[i];
+  } else {
+    if (gain1 > 0.) {
+      // expgain = -std::log(gain2 / gain1) = -std::log(0.) =
+      // -std::log(very small number) = 99.
+      expgain = 99.;
+    } else {
+      // expgain = std::log(0. / 0.) = (assume) = std::log(1.) = 0.
+      expgain = 0.;
+    }
+  }
+  double exploss;
+  if (loss2 > 0.) {
+    if (loss1 > 0.) {
+      exploss = std::log(loss1 / loss2);
+    } else {
+      // exploss = std::log(0.) = std::log(very small number) = -99.
+      exploss = -99.;
+    }
+  } else {
+    if (loss1 > 0.) {
+      // exploss = -std::log(loss2 / loss1) = -std::log(0.) =
+      // -std::log(very small number) = 99.
+      exploss = 99.;
+    } else {
+      // exploss = std::log(0. / 0.) = (assume) = std::log(1.) = 0.
+      exploss = 0.;
+    }
+  }
+  const double expdiff = expgain - exploss;
+  if (gain0 > 0. && expdiff != 0.) {
+    T0 *= std::pow(loss0 / gain0, logtt / expdiff);
+  } else {
+    // cooling and heating are behaving very weirdly
+    // try again with a different temperature
+    T0 = T1;
+  }
+
+  if (T0 < _minimum_ionized_temperature) {
+    // gas is neutral, temperature is 500 K
+    T0 = 500.;
+    h0 = 1.;
+    he0 = 1.;
+    // force exit out of loop
+    gain0 = 1.;
+    loss0 = 1.;
+  }
+
+  if (T0 > 1.e10) {
+    // gas is ionized, temperature is 10^10 K (should probably be a lower
+    // value)
+    T0 = 1.e10;
+    h0 = 1.e-10;
+    he0 = 1.e-10;
+    // force exit out of loop
+    gain0 = 1.;
+    loss0 = 1.;
+  }
+}
+
+/**
+ * @brief Store the result of the temperature iteration for the given cell.
+ *
+ * @param ionization_variables Ionization variables of the cell.
+ * @param T0 Final temperature (in K).
+ * @param h0 Final hydrogen neutral fraction.
+ * @param he0 Final helium neutral fraction.
+ * @param j Normalized mean intensity integrals (in s^-1).
+ * @param h Normalized heating integrals (in J s^-1).
+ */
+void TemperatureCalculator::finalize_temperature_calculation(
+    IonizationVariables &ionization_variables, double T0, double h0,
+    double he0, const double j[NUMBER_OF_IONNAMES],
+    const double h[NUMBER_OF_HEATINGTERMS]) {
+
+  // cap the temperature at 30,000 K, since helium charge transfer rates are
+  // only valid until 30,000 K
+  T0 = std::min(30000., T0);
+
+  // update the ionic fractions and temperature
+  ionization_variables.set_temperature(T0);
+
+  // now make sure the results make physical sense: if the mean ionizing
+  // intensity for hydrogen or helium was zero, then that element should be
+  // completely neutral
+  if (ionization_variables.get_mean_intensity(ION_H_n) == 0.) {
+    h0 = 1.;
   }
 
-#ifdef HAS_CARBON
-  ionization_variables.set_cooling(ION_C_p1, cooling[CII]);
-  ionization_variables.set_cooling(ION_C_p2, cooling[CIII]);
+#ifdef HAS_HELIUM
+  if (ionization_variables.get_mean_intensity(ION_He_n) == 0.) {
+    he0 = 1.;
+  }
 #endif
 
-#ifdef HAS_NITROGEN
-  ionization_variables.set_cooling(ION_N_n, cooling[NI]);
-  ionization_variables.set_cooling(ION_N_p1, cooling[NII]);
-  ionization_variables.set_cooling(ION_N_p2, cooling[NIII]);
-#endif
+  ionization_variables.set_ionic_fraction(ION_H_n, h0);
 
-#ifdef HAS_OXYGEN
-  ionization_variables.set_cooling(ION_O_n, cooling[OII]);
-  ionization_variables.set_cooling(ION_O_p1, cooling[OIII]);
+#ifdef HAS_HELIUM
+  ionization_variables.set_ionic_fraction(ION_He_n, he0);
 #endif
 
-#ifdef HAS_NEON
-  ionization_variables.set_cooling(ION_Ne_n, cooling[NeII]);
-  ionization_variables.set_cooling(ION_Ne_p1, cooling[NeIII]);
-#endif
+  // if hydrogen is completely neutral, then we assume that all coolants are
+  // neutral as well
+  if (h0 == 1.) {
+    reset_coolant_ionic_fractions(ionization_variables);
+  }
 
-#ifdef HAS_SULPHUR
-  ionization_variables.set_cooling(ION_S_p1, cooling[SII]);
-  ionization_variables.set_cooling(ION_S_p2, cooling[SIII]);
-  ionization_variables.set_cooling(ION_S_p3, cooling[SIV]);
-#endif
+  // if hydrogen is completely ionized, then we assume that all coolants are
+  // in very high ionization states as well
+  if (h0 <= 1.e-10) {
+    reset_coolant_ionic_fractions(ionization_variables);
+  }
 
-#else
-  loss = line_cooling_data.get_cooling(T, ne, abund) * n;
-#endif
-
-  // free-free cooling (bremsstrahlung)
-
-  // fit to the free-free emission Gaunt factor from Katz, N., Weinberg, D. H. &
-  // Hernquist, L. 1996, ApJS, 105, 19
-  // (http://adsabs.harvard.edu/abs/1996ApJS..105...19K), equation 23
-  const double c = 5.5 - logT;
-  const double gff = 1.1 + 0.34 * std::exp(-c * c / 3.);
-  // Wood, Mathis & Ercolano (2004), equation 22
-  // based on section 3.4 of Osterbrock, D. E. & Ferland, G. J. 2006,
-  // Astrophysics of Gaseous Nebulae and Active Galactic Nuclei, 2nd edition
-  // (http://adsabs.harvard.edu/abs/2006agna.book.....O)
-  loss += 1.42e-40 * gff * sqrtT * (nenhp + nenhep);
-
-  // cooling due to recombination of hydrogen and helium
-
-  // we multiplied Kenny's value with 1.e-12 to convert the densities into m^-3
-  // we then multiplied with 0.1 to convert them to J m^-3s^-1
-  // expressions come from Black (1981), table 3
-  // valid in the range [5,000 K; 50,000 K]
-  // NOTE that the expression for helium is different from that in Kenny's code
-  // (it is the same as the commented out expression in Kenny's code)
-  const double Lhp =
-      2.85e-40 * nenhp * sqrtT * (5.914 - 0.5 * logT + 0.01184 * std::cbrt(T));
-  const double Lhep = 1.55e-39 * nenhep * std::pow(T, 0.3647);
-#ifdef DO_OUTPUT_COOLING
-  ionization_variables.set_cooling(ION_H_n, Lhp);
-#ifdef HAS_HELIUM
-  ionization_variables.set_cooling(ION_He_n, Lhep);
-#endif
+#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
+  // set the mean intensity values to the actual physical values
+  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+    ionization_variables.set_mean_intensity(ion, j[ion]);
+  }
 #endif
-  loss += Lhp + Lhep;
 
-  // make sure losses are losses and gains are gains
-  loss = std::max(loss, 0.);
-  gain = std::max(gain, 0.);
+  // set the heating term values to the actual physical values
+  for (int_fast32_t heating_term = 0; heating_term < NUMBER_OF_HEATINGTERMS;
+       ++heating_term) {
+    ionization_variables.set_heating(heating_term, h[heating_term]);
+  }
 }
 
 /**
@@ -568,152 +1110,12 @@ void TemperatureCalculator::calculate_temperature(
     IonizationVariables &ionization_variables, const double jfac,
     const double hfac, const CoordinateVector<> cell_midpoint) const {
 
-  const double jH = jfac * ionization_variables.get_mean_intensity(ION_H_n);
-#ifdef HAS_HELIUM
-  const double jHe = jfac * ionization_variables.get_mean_intensity(ION_He_n);
-#else
-  const double jHe = 0.;
-#endif
-
-  // if the ionizing intensity is 0, the gas is trivially neutral and all
-  // coolants are in the ground state
-  if ((jH == 0. && jHe == 0.) ||
-      ionization_variables.get_number_density() == 0.) {
-    ionization_variables.set_temperature(500.);
-
-    ionization_variables.set_ionic_fraction(ION_H_n, 1.);
-
-#ifdef HAS_HELIUM
-    ionization_variables.set_ionic_fraction(ION_He_n, 1.);
-#endif
-
-#ifdef HAS_CARBON
-    ionization_variables.set_ionic_fraction(ION_C_p1, 0.);
-    ionization_variables.set_ionic_fraction(ION_C_p2, 0.);
-#endif
-
-#ifdef HAS_NITROGEN
-    ionization_variables.set_ionic_fraction(ION_N_n, 0.);
-    ionization_variables.set_ionic_fraction(ION_N_p1, 0.);
-    ionization_variables.set_ionic_fraction(ION_N_p2, 0.);
-#endif
-
-#ifdef HAS_OXYGEN
-    ionization_variables.set_ionic_fraction(ION_O_n, 0.);
-    ionization_variables.set_ionic_fraction(ION_O_p1, 0.);
-#endif
-
-#ifdef HAS_NEON
-    ionization_variables.set_ionic_fraction(ION_Ne_n, 0.);
-    ionization_variables.set_ionic_fraction(ION_Ne_p1, 0.);
-#endif
-
-#ifdef HAS_SULPHUR
-    ionization_variables.set_ionic_fraction(ION_S_p1, 0.);
-    ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
-    ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
-#endif
-    // set the heating term values to zero
-    for (int_fast32_t heating_term = 0; heating_term < NUMBER_OF_HEATINGTERMS;
-         ++heating_term) {
-      ionization_variables.set_heating(heating_term, 0.);
-    }
-
-    return;
-  }
-
-  double crfac = _crfac * ionization_variables.get_cosmic_ray_factor();
-  if (crfac < 0.) {
-    crfac = _crfac;
-  }
-
-  // if cosmic ray heating is active, check if the gas is ionized enough
-  // if it is not, we just assume the gas is neutral and do not apply heating
-  double h0, he0;
-  if (crfac > 0.) {
-    const double alphaH =
-        _recombination_rates.get_recombination_rate(ION_H_n, 8000.);
-#ifdef HAS_HELIUM
-    const double alphaHe =
-        _recombination_rates.get_recombination_rate(ION_He_n, 8000.);
-#else
-    const double alphaHe = 0.;
-#endif
-    const double nH = ionization_variables.get_number_density();
-#ifdef HAS_HELIUM
-#ifdef VARIABLE_ABUNDANCES
-    const double AHe =
-        ionization_variables.get_abundances().get_abundance(ELEMENT_He);
-#else
-    const double AHe = _abundances.get_abundance(ELEMENT_He);
-#endif
-#else
-    const double AHe = 0.;
-#endif
-    IonizationStateCalculator::compute_ionization_states_hydrogen_helium(
-        alphaH, alphaHe, jH, jHe, nH, AHe, 8000., h0, he0);
-    if (crfac > 0. && h0 > _crlim) {
-      // assume fully neutral
-      ionization_variables.set_temperature(500.);
-      ionization_variables.set_ionic_fraction(ION_H_n, 1.);
-
-#ifdef HAS_HELIUM
-      ionization_variables.set_ionic_fraction(ION_He_n, 1.);
-#endif
-
-#ifdef HAS_CARBON
-      ionization_variables.set_ionic_fraction(ION_C_p1, 0.);
-      ionization_variables.set_ionic_fraction(ION_C_p2, 0.);
-#endif
-
-#ifdef HAS_NITROGEN
-      ionization_variables.set_ionic_fraction(ION_N_n, 0.);
-      ionization_variables.set_ionic_fraction(ION_N_p1, 0.);
-      ionization_variables.set_ionic_fraction(ION_N_p2, 0.);
-#endif
-
-#ifdef HAS_OXYGEN
-      ionization_variables.set_ionic_fraction(ION_O_n, 0.);
-      ionization_variables.set_ionic_fraction(ION_O_p1, 0.);
-#endif
-
-#ifdef HAS_NEON
-      ionization_variables.set_ionic_fraction(ION_Ne_n, 0.);
-      ionization_variables.set_ionic_fraction(ION_Ne_p1, 0.);
-#endif
-
-#ifdef HAS_SULPHUR
-      ionization_variables.set_ionic_fraction(ION_S_p1, 0.);
-      ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
-      ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
-#endif
-      // set the heating term values to zero
-      for (int_fast32_t heating_term = 0; heating_term < NUMBER_OF_HEATINGTERMS;
-           ++heating_term) {
-        ionization_variables.set_heating(heating_term, 0.);
-      }
-
-      return;
-    }
-  }
-
-  // we make sure our initial temperature guess is high enough
-  double T0 = ionization_variables.get_temperature();
-  if (ionization_variables.get_temperature() <= 4000.) {
-    T0 = 8000.;
-  }
-
-  // normalize the mean intensity integrals
+  double T0, crfac;
   double j[NUMBER_OF_IONNAMES];
-  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-    j[ion] = jfac * ionization_variables.get_mean_intensity(ion);
-  }
-
-  // normalize the heating integrals
   double h[NUMBER_OF_HEATINGTERMS];
-  for (int_fast32_t heating_term = 0; heating_term < NUMBER_OF_HEATINGTERMS;
-       ++heating_term) {
-    h[heating_term] = hfac * ionization_variables.get_heating(heating_term);
+  if (!initialize_temperature_calculation(ionization_variables, jfac, hfac, T0,
+                                          j, h, crfac)) {
+    return;
   }
 
   // iteratively find the equilibrium temperature by starting from a guess and
@@ -725,8 +1127,8 @@ void TemperatureCalculator::calculate_temperature(
   uint_fast32_t niter = 0;
   double gain0 = 1.;
   double loss0 = 0.;
-  h0 = 0.;
-  he0 = 0.;
+  double h0 = 0.;
+  double he0 = 0.;
   while (std::abs(gain0 - loss0) > _epsilon_convergence * gain0 &&
          niter < _maximum_number_of_iterations) {
     ++niter;
@@ -736,7 +1138,7 @@ void TemperatureCalculator::calculate_temperature(
     compute_cooling_and_heating_balance(
         h01, he01, gain1, loss1, T1, ionization_variables, cell_midpoint, j,
         _abundances, h, _pahfac, crfac, _crscale, _line_cooling_data,
-        _recombination_rates, _charge_transfer_rates);
+        _recombination_rates, _charge_transfer_rates, _line_cooling_table);
 
     const double T2 = 0.9 * T0;
     // ioneng
@@ -744,81 +1146,16 @@ void TemperatureCalculator::calculate_temperature(
     compute_cooling_and_heating_balance(
         h02, he02, gain2, loss2, T2, ionization_variables, cell_midpoint, j,
         _abundances, h, _pahfac, crfac, _crscale, _line_cooling_data,
-        _recombination_rates, _charge_transfer_rates);
+        _recombination_rates, _charge_transfer_rates, _line_cooling_table);
 
     // ioneng - this one sets h0, he0, gain0 and loss0
     compute_cooling_and_heating_balance(
         h0, he0, gain0, loss0, T0, ionization_variables, cell_midpoint, j,
         _abundances, h, _pahfac, crfac, _crscale, _line_cooling_data,
-        _recombination_rates, _charge_transfer_rates);
-
-    // funny detail: this value is actually constant :p
-    static const double logtt = std::log(1.1 / 0.9);
-    double expgain;
-    if (gain2 > 0.) {
-      if (gain1 > 0.) {
-        expgain = std::log(gain1 / gain2);
-      } else {
-        // expgain = std::log(0.) = std::log(very small number) = -99.
-        expgain = -99.;
-      }
-    } else {
-      if (gain1 > 0.) {
-        // expgain = -std::log(gain2 / gain1) = -std::log(0.) =
-        // -std::log(very small number) = 99.
-        expgain = 99.;
-      } else {
-        // expgain = std::log(0. / 0.) = (assume) = std::log(1.) = 0.
-        expgain = 0.;
-      }
-    }
-    double exploss;
-    if (loss2 > 0.) {
-      if (loss1 > 0.) {
-        exploss = std::log(loss1 / loss2);
-      } else {
-        // exploss = std::log(0.) = std::log(very small number) = -99.
-        exploss = -99.;
-      }
-    } else {
-      if (loss1 > 0.) {
-        // exploss = -std::log(loss2 / loss1) = -std::log(0.) =
-        // -std::log(very small number) = 99.
-        exploss = 99.;
-      } else {
-        // exploss = std::log(0. / 0.) = (assume) = std::log(1.) = 0.
-        exploss = 0.;
-      }
-    }
-    const double expdiff = expgain - exploss;
-    if (gain0 > 0. && expdiff != 0.) {
-      T0 *= std::pow(loss0 / gain0, logtt / expdiff);
-    } else {
-      // cooling and heating are behaving very weirdly
-      // try again with a different temperature
-      T0 = T1;
-    }
-
-    if (T0 < _minimum_ionized_temperature) {
-      // gas is neutral, temperature is 500 K
-      T0 = 500.;
-      h0 = 1.;
-      he0 = 1.;
-      // force exit out of loop
-      gain0 = 1.;
-      loss0 = 1.;
-    }
+        _recombination_rates, _charge_transfer_rates, _line_cooling_table);
 
-    if (T0 > 1.e10) {
-      // gas is ionized, temperature is 10^10 K (should probably be a lower
-      // value)
-      T0 = 1.e10;
-      h0 = 1.e-10;
-      he0 = 1.e-10;
-      // force exit out of loop
-      gain0 = 1.;
-      loss0 = 1.;
-    }
+    update_temperature_guess(T0, T1, h0, he0, gain0, loss0, gain1, loss1,
+                             gain2, loss2);
   }
   if (_log != nullptr && niter == _maximum_number_of_iterations) {
     _log->write_info(
@@ -828,105 +1165,139 @@ void TemperatureCalculator::calculate_temperature(
         std::abs(loss0 - gain0) / gain0, ", aim: ", _epsilon_convergence, ")!");
   }
 
-  // cap the temperature at 30,000 K, since helium charge transfer rates are
-  // only valid until 30,000 K
-  T0 = std::min(30000., T0);
-
-  // update the ionic fractions and temperature
-  ionization_variables.set_temperature(T0);
-
-  // now make sure the results make physical sense: if the mean ionizing
-  // intensity for hydrogen or helium was zero, then that element should be
-  // completely neutral
-  if (ionization_variables.get_mean_intensity(ION_H_n) == 0.) {
-    h0 = 1.;
-  }
+  finalize_temperature_calculation(ionization_variables, T0, h0, he0, j, h);
+}
 
-#ifdef HAS_HELIUM
-  if (ionization_variables.get_mean_intensity(ION_He_n) == 0.) {
-    he0 = 1.;
+/**
+ * @brief Calculate a new temperature for a batch of cells.
+ *
+ * This function gives the same result as calling calculate_temperature() for
+ * every cell separately, but iterates all cells in the batch in lockstep, so
+ * that the cooling and heating balance can be computed for all cells together
+ * using compute_cooling_and_heating_balance_batch(). Cells drop out of the
+ * iteration as soon as they are converged.
+ *
+ * @param number_of_cells Number of cells in the batch (at most
+ * IONIZATIONSTATECALCULATOR_BATCH_SIZE).
+ * @param jfac Normalization factors for the mean intensity integrals in each
+ * cell.
+ * @param hfac Normalization factors for the heating integrals in each cell.
+ * @param ionization_variables Ionization variables for the cells we operate
+ * on.
+ * @param cell_midpoint Midpoints of the cells.
+ */
+void TemperatureCalculator::calculate_temperature_batch(
+    const uint_fast32_t number_of_cells, const double *jfac,
+    const double *hfac, IonizationVariables **ionization_variables,
+    const CoordinateVector<> *cell_midpoint) const {
+
+  cmac_assert(number_of_cells <= IONIZATIONSTATECALCULATOR_BATCH_SIZE);
+
+  // gather the cells that need a temperature iteration
+  uint_fast32_t number_of_active_cells = 0;
+  IonizationVariables *active_variables[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  CoordinateVector<> active_midpoint[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double T0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double j[IONIZATIONSTATECALCULATOR_BATCH_SIZE][NUMBER_OF_IONNAMES];
+  double h[IONIZATIONSTATECALCULATOR_BATCH_SIZE][NUMBER_OF_HEATINGTERMS];
+  double crfac[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    const uint_fast32_t k = number_of_active_cells;
+    if (initialize_temperature_calculation(*ionization_variables[i], jfac[i],
+                                           hfac[i], T0[k], j[k], h[k],
+                                           crfac[k])) {
+      active_variables[k] = ionization_variables[i];
+      active_midpoint[k] = cell_midpoint[i];
+      ++number_of_active_cells;
+    }
   }
-#endif
-
-  ionization_variables.set_ionic_fraction(ION_H_n, h0);
-
-#ifdef HAS_HELIUM
-  ionization_variables.set_ionic_fraction(ION_He_n, he0);
-#endif
-
-  // if hydrogen is completely neutral, then we assume that all coolants are
-  // neutral as well
-  if (h0 == 1.) {
-#ifdef HAS_CARBON
-    ionization_variables.set_ionic_fraction(ION_C_p1, 0.);
-    ionization_variables.set_ionic_fraction(ION_C_p2, 0.);
-#endif
-
-#ifdef HAS_NITROGEN
-    ionization_variables.set_ionic_fraction(ION_N_n, 0.);
-    ionization_variables.set_ionic_fraction(ION_N_p1, 0.);
-    ionization_variables.set_ionic_fraction(ION_N_p2, 0.);
-#endif
-
-#ifdef HAS_OXYGEN
-    ionization_variables.set_ionic_fraction(ION_O_n, 0.);
-    ionization_variables.set_ionic_fraction(ION_O_p1, 0.);
-#endif
-
-#ifdef HAS_NEON
-    ionization_variables.set_ionic_fraction(ION_Ne_n, 0.);
-    ionization_variables.set_ionic_fraction(ION_Ne_p1, 0.);
-#endif
 
-#ifdef HAS_SULPHUR
-    ionization_variables.set_ionic_fraction(ION_S_p1, 0.);
-    ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
-    ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
-#endif
+  // iterate all cells in lockstep (see calculate_temperature())
+  uint_fast32_t niter[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double gain0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double loss0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double h0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double he0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t k = 0; k < number_of_active_cells; ++k) {
+    niter[k] = 0;
+    gain0[k] = 1.;
+    loss0[k] = 0.;
+    h0[k] = 0.;
+    he0[k] = 0.;
   }
+  while (true) {
+    // pack the cells that are not converged yet
+    uint_fast32_t number_of_iterating_cells = 0;
+    uint_fast32_t index[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    IonizationVariables *variables[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    CoordinateVector<> midpoint[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    double jp[IONIZATIONSTATECALCULATOR_BATCH_SIZE][NUMBER_OF_IONNAMES];
+    double hp[IONIZATIONSTATECALCULATOR_BATCH_SIZE][NUMBER_OF_HEATINGTERMS];
+    double crfacp[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    double T[3][IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    for (uint_fast32_t k = 0; k < number_of_active_cells; ++k) {
+      if (std::abs(gain0[k] - loss0[k]) > _epsilon_convergence * gain0[k] &&
+          niter[k] < _maximum_number_of_iterations) {
+        ++niter[k];
+        const uint_fast32_t l = number_of_iterating_cells;
+        index[l] = k;
+        variables[l] = active_variables[k];
+        midpoint[l] = active_midpoint[k];
+        for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+          jp[l][ion] = j[k][ion];
+        }
+        for (int_fast32_t heating_term = 0;
+             heating_term < NUMBER_OF_HEATINGTERMS; ++heating_term) {
+          hp[l][heating_term] = h[k][heating_term];
+        }
+        crfacp[l] = crfac[k];
+        T[0][l] = 1.1 * T0[k];
+        T[1][l] = 0.9 * T0[k];
+        T[2][l] = T0[k];
+        ++number_of_iterating_cells;
+      }
+    }
+    if (number_of_iterating_cells == 0) {
+      break;
+    }
 
-  // if hydrogen is completely ionized, then we assume that all coolants are
-  // in very high ionization states as well
-  if (h0 <= 1.e-10) {
-#ifdef HAS_CARBON
-    ionization_variables.set_ionic_fraction(ION_C_p1, 0.);
-    ionization_variables.set_ionic_fraction(ION_C_p2, 0.);
-#endif
-
-#ifdef HAS_NITROGEN
-    ionization_variables.set_ionic_fraction(ION_N_n, 0.);
-    ionization_variables.set_ionic_fraction(ION_N_p1, 0.);
-    ionization_variables.set_ionic_fraction(ION_N_p2, 0.);
-#endif
-
-#ifdef HAS_OXYGEN
-    ionization_variables.set_ionic_fraction(ION_O_n, 0.);
-    ionization_variables.set_ionic_fraction(ION_O_p1, 0.);
-#endif
-
-#ifdef HAS_NEON
-    ionization_variables.set_ionic_fraction(ION_Ne_n, 0.);
-    ionization_variables.set_ionic_fraction(ION_Ne_p1, 0.);
-#endif
-
-#ifdef HAS_SULPHUR
-    ionization_variables.set_ionic_fraction(ION_S_p1, 0.);
-    ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
-    ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
-#endif
-  }
+    // compute the balance at the upper, lower and current temperature; the
+    // last one sets the ionic fractions of the coolants
+    double h0p[3][IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    double he0p[3][IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    double gain[3][IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    double loss[3][IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    for (uint_fast8_t itemp = 0; itemp < 3; ++itemp) {
+      compute_cooling_and_heating_balance_batch(
+          number_of_iterating_cells, h0p[itemp], he0p[itemp], gain[itemp],
+          loss[itemp], T[itemp], variables, midpoint, jp, _abundances, hp,
+          _pahfac, crfacp, _crscale, _line_cooling_data, _recombination_rates,
+          _charge_transfer_rates, _line_cooling_table);
+    }
 
-#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
-  // set the mean intensity values to the actual physical values
-  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-    ionization_variables.set_mean_intensity(ion, j[ion]);
+    for (uint_fast32_t l = 0; l < number_of_iterating_cells; ++l) {
+      const uint_fast32_t k = index[l];
+      h0[k] = h0p[2][l];
+      he0[k] = he0p[2][l];
+      gain0[k] = gain[2][l];
+      loss0[k] = loss[2][l];
+      update_temperature_guess(T0[k], T[0][l], h0[k], he0[k], gain0[k],
+                               loss0[k], gain[0][l], loss[0][l], gain[1][l],
+                               loss[1][l]);
+    }
   }
-#endif
 
-  // set the heating term values to the actual physical values
-  for (int_fast32_t heating_term = 0; heating_term < NUMBER_OF_HEATINGTERMS;
-       ++heating_term) {
-    ionization_variables.set_heating(heating_term, h[heating_term]);
+  for (uint_fast32_t k = 0; k < number_of_active_cells; ++k) {
+    if (_log != nullptr && niter[k] == _maximum_number_of_iterations) {
+      _log->write_info("Maximum number of iterations (", niter[k],
+                       ") reached (temperature: ", T0[k],
+                       ","
+                       "relative difference cooling/heating: ",
+                       std::abs(loss0[k] - gain0[k]) / gain0[k],
+                       ", aim: ", _epsilon_convergence, ")!");
+    }
+    finalize_temperature_calculation(*active_variables[k], T0[k], h0[k], he0[k],
+                                     j[k], h[k]);
   }
 }
 
@@ -973,6 +1344,9 @@ void TemperatureCalculator::calculate_temperature(
  * @brief Calculate the temperature and ionization balance for all cells in the
  * given subgrid.
  *
+ * The cells are processed in batches of IONIZATIONSTATECALCULATOR_BATCH_SIZE
+ * cells using calculate_temperature_batch().
+ *
  * @param loop Iteration number.
  * @param totweight Total weight of all photon packets.
  * @param subgrid DensitySubGrid to operate on.
@@ -990,10 +1364,29 @@ void TemperatureCalculator::calculate_temperature(
     // we do this by multiplying with the Planck constant (in Js)
     const double hfac = jfac * PhysicalConstants::get_physical_constant(
                                    PHYSICALCONSTANT_PLANCK);
+    // process the cells in batches
+    uint_fast32_t number_of_cells = 0;
+    double jfacs[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    double hfacs[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    IonizationVariables
+        *ionization_variables[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    CoordinateVector<> cell_midpoints[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
     for (auto cellit = subgrid.begin(); cellit != subgrid.end(); ++cellit) {
-      calculate_temperature(
-          cellit.get_ionization_variables(), jfac / cellit.get_volume(),
-          hfac / cellit.get_volume(), cellit.get_cell_midpoint());
+      jfacs[number_of_cells] = jfac / cellit.get_volume();
+      hfacs[number_of_cells] = hfac / cellit.get_volume();
+      ionization_variables[number_of_cells] =
+          &cellit.get_ionization_variables();
+      cell_midpoints[number_of_cells] = cellit.get_cell_midpoint();
+      ++number_of_cells;
+      if (number_of_cells == IONIZATIONSTATECALCULATOR_BATCH_SIZE) {
+        calculate_temperature_batch(number_of_cells, jfacs, hfacs,
+                                    ionization_variables, cell_midpoints);
+        number_of_cells = 0;
+      }
+    }
+    if (number_of_cells > 0) {
+      calculate_temperature_batch(number_of_cells, jfacs, hfacs,
+                                  ionization_variables, cell_midpoints);
     }
   } else {
     _ionization_state_calculator.calculate_ionization_state(totweight, subgrid);
@@ -34,6 +34,7 @@
 class Abundances;
 class ChargeTransferRates;
 class LineCoolingData;
+class LineCoolingTable;
 class Log;
 class RecombinationRates;
 
@@ -81,6 +82,10 @@ private:
   /*! @brief LineCoolingData used to calculate cooling due to line emission. */
   const LineCoolingData &_line_cooling_data;
 
+  /*! @brief Optional precomputed table of line cooling rates (nullptr if line
+   *  cooling rates are computed exactly). */
+  const LineCoolingTable *_line_cooling_table;
+
   /*! @brief RecombinationRates used to calculate ionic fractions. */
   const RecombinationRates &_recombination_rates;
 
@@ -111,6 +116,39 @@ private:
   /*! @brief Log to write logging info to. */
   Log *_log;
 
+  static void
+  reset_coolant_ionic_fractions(IonizationVariables &ionization_variables);
+
+  static void set_neutral_state(IonizationVariables &ionization_variables);
+
+  static void
+  get_coolant_abundances(const Abundances &input_abundances,
+                         const IonizationVariables &ionization_variables,
+                         double *abund);
+
+#ifdef DO_OUTPUT_COOLING
+  static double
+  compute_line_cooling(const double T, const double ne, const double n,
+                       const Abundances &input_abundances,
+                       IonizationVariables &ionization_variables,
+                       const LineCoolingData &line_cooling_data);
+#endif
+
+  bool initialize_temperature_calculation(
+      IonizationVariables &ionization_variables, const double jfac,
+      const double hfac, double &T0, double j[NUMBER_OF_IONNAMES],
+      double h[NUMBER_OF_HEATINGTERMS], double &crfac) const;
+
+  void update_temperature_guess(double &T0, const double T1, double &h0,
+                                double &he0, double &gain0, double &loss0,
+                                const double gain1, const double loss1,
+                                const double gain2, const double loss2) const;
+
+  static void finalize_temperature_calculation(
+      IonizationVariables &ionization_variables, double T0, double h0,
+      double he0, const double j[NUMBER_OF_IONNAMES],
+      const double h[NUMBER_OF_HEATINGTERMS]);
+
 public:
   TemperatureCalculator(
       bool do_temperature_computation, uint_fast32_t minimum_iteration_number,
@@ -128,6 +166,22 @@ public:
                         const ChargeTransferRates &charge_transfer_rates,
                         ParameterFile &params, Log *log = nullptr);
 
+  ~TemperatureCalculator();
+
+  /**
+   * @brief Copy constructor.
+   *
+   * Deleted, since the line cooling table is owned by the calculator.
+   */
+  TemperatureCalculator(const TemperatureCalculator &) = delete;
+
+  /**
+   * @brief Copy assignment operator.
+   *
+   * Deleted, since the line cooling table is owned by the calculator.
+   */
+  TemperatureCalculator &operator=(const TemperatureCalculator &) = delete;
+
   static void compute_cooling_and_heating_balance(
       double &h0, double &he0, double &gain, double &loss, double T,
       IonizationVariables &ionization_variables,
@@ -136,12 +190,31 @@ public:
       const double h[NUMBER_OF_HEATINGTERMS], double pahfac, double crfac,
       double crscale, const LineCoolingData &line_cooling_data,
       const RecombinationRates &recombination_rates,
-      const ChargeTransferRates &charge_transfer_rates);
+      const ChargeTransferRates &charge_transfer_rates,
+      const LineCoolingTable *line_cooling_table = nullptr);
+
+  static void compute_cooling_and_heating_balance_batch(
+      const uint_fast32_t number_of_cells, double *h0, double *he0,
+      double *gain, double *loss, const double *T,
+      IonizationVariables **ionization_variables,
+      const CoordinateVector<> *cell_midpoint,
+      const double (*j)[NUMBER_OF_IONNAMES], const Abundances &input_abundances,
+      const double (*h)[NUMBER_OF_HEATINGTERMS], const double pahfac,
+      const double *crfac, const double crscale,
+      const LineCoolingData &line_cooling_data,
+      const RecombinationRates &recombination_rates,
+      const ChargeTransferRates &charge_transfer_rates,
+      const LineCoolingTable *line_cooling_table = nullptr);
 
   void calculate_temperature(IonizationVariables &ionization_variables,
                              const double jfac, const double hfac,
                              const CoordinateVector<> cell_midpoint) const;
 
+  void calculate_temperature_batch(
+      const uint_fast32_t number_of_cells, const double *jfac,
+      const double *hfac, IonizationVariables **ionization_variables,
+      const CoordinateVector<> *cell_midpoint) const;
+
   /**
    * @brief Update the total luminosity of the sources.
    *
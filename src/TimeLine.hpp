@@ -213,6 +213,87 @@ public:
     return _current_time < TIMELINE_MAX_INTEGER_TIMELINE_SIZE;
   }
 
+  /**
+   * @brief Get the current integer time.
+   *
+   * @return Current position on the integer time line.
+   */
+  inline uint64_t get_current_integer_time() const { return _current_time; }
+
+  /**
+   * @brief Convert the given integer time step to a physical time step.
+   *
+   * @param integer_timestep Integer time step.
+   * @return Corresponding physical time step (in s).
+   */
+  inline double get_physical_timestep(const uint64_t integer_timestep) const {
+    return to_physical_time_interval(integer_timestep);
+  }
+
+  /**
+   * @brief Get the integer time step that corresponds to the given requested
+   * physical time step and that can start at the current integer time.
+   *
+   * This is used for hierarchical time stepping, where different parts of the
+   * system take different power of two steps on the same integer time line.
+   * Since the returned step is a divisor of the current integer time, all
+   * parts that are halfway a longer time step are synchronised with the end
+   * of this step.
+   *
+   * @param requested_timestep Maximum time step that can be taken (in s).
+   * @return Largest power of two integer time step that is smaller than or
+   * equal to both the requested and the maximum time step and that is a
+   * divisor of the current integer time (0 if no such time step exists).
+   */
+  inline uint64_t get_integer_timestep(const double requested_timestep) const {
+
+    uint64_t integer_timestep = _maximum_timestep;
+    while (integer_timestep > 0 &&
+           (to_physical_time_interval(integer_timestep) > requested_timestep ||
+            _current_time % integer_timestep > 0)) {
+      integer_timestep >>= 1;
+    }
+    return integer_timestep;
+  }
+
+  /**
+   * @brief Advance the time line forward to the given integer time.
+   *
+   * @param next_integer_time Integer time at the end of the step. Should be
+   * larger than the current integer time.
+   * @param actual_timestep Actual time step that was taken (in s). Is set by
+   * this function.
+   * @param current_time Current time in the physical time line at the end of
+   * the step (in s). Is set by this function.
+   * @return True if there are still valid time steps after this step, false if
+   * the end of the time line was reached or if the step is smaller than the
+   * minimum time step.
+   */
+  inline bool advance_to(const uint64_t next_integer_time,
+                         double &actual_timestep, double &current_time) {
+
+    cmac_assert(next_integer_time > _current_time);
+    cmac_assert(next_integer_time <= TIMELINE_MAX_INTEGER_TIMELINE_SIZE);
+
+    const uint64_t integer_timestep = next_integer_time - _current_time;
+    if (integer_timestep < _minimum_timestep) {
+      cmac_warning("Time step wants to be smaller than minimum time step: %g "
+                   "(minimum: %g)! Prematurely stopping simulation...",
+                   to_physical_time_interval(integer_timestep),
+                   to_physical_time_interval(_minimum_timestep));
+      actual_timestep = to_physical_time_interval(integer_timestep);
+      current_time = to_physical_time(_current_time);
+      return false;
+    }
+
+    _current_time = next_integer_time;
+
+    actual_timestep = to_physical_time_interval(integer_timestep);
+    current_time = to_physical_time(_current_time);
+
+    return _current_time < TIMELINE_MAX_INTEGER_TIMELINE_SIZE;
+  }
+
   /**
    * @brief Dump the time line to the given restart file.
    *
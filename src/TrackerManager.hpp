@@ -245,6 +245,7 @@ public:
         cmac_error("Tracker is not inside grid!");
       }
       auto gridit = grid.get_subgrid(_tracker_positions[i]);
+      (*gridit).enable_trackers();
       {
         auto cellit = (*gridit).get_cell(_tracker_positions[i]);
         _trackers[i]->normalize_for_cell(cellit);
@@ -276,6 +277,7 @@ public:
           _copies[i] = _trackers.size() - 1;
           first = false;
         }
+        (*copyit).enable_trackers();
         IonizationVariables &ionization_variables =
             (*copyit)
                 .get_cell(_tracker_positions[i])
@@ -213,10 +213,7 @@ void VoronoiDensityGrid::initialize(std::pair< cellsize_t, cellsize_t > &block,
       for (generatornumber_t i = 0; i < numcell; ++i) {
         _generator_positions[i] = _voronoi_grid->get_centroid(i);
       }
-      delete _voronoi_grid;
-      _voronoi_grid = VoronoiGridFactory::generate(
-          _voronoi_grid_type, _generator_positions, _box, _periodicity_flags);
-      _voronoi_grid->compute_grid();
+      update_voronoi_grid();
     }
 
     if (_log) {
@@ -227,6 +224,8 @@ void VoronoiDensityGrid::initialize(std::pair< cellsize_t, cellsize_t > &block,
     time_log->end("Lloyd iterations");
   }
 
+  build_face_table();
+
   DensityGrid::initialize(block, density_function);
 
   if (time_log) {
@@ -242,6 +241,96 @@ void VoronoiDensityGrid::initialize(std::pair< cellsize_t, cellsize_t > &block,
   }
 }
 
+/**
+ * @brief Update the Voronoi grid after the generator positions have changed.
+ *
+ * Grids that support incremental updates only recompute the cells that are
+ * affected by the movement; other grids are reconstructed from scratch.
+ */
+void VoronoiDensityGrid::update_voronoi_grid() {
+  if (!_voronoi_grid->update_grid()) {
+    delete _voronoi_grid;
+    _voronoi_grid = VoronoiGridFactory::generate(
+        _voronoi_grid_type, _generator_positions, _box, _periodicity_flags);
+    _voronoi_grid->compute_grid();
+  }
+}
+
+/**
+ * @brief Build the face table used during photon traversal.
+ *
+ * The table stores the faces of all cells contiguously, with for every face
+ * the neighbour index, the outward unit normal and the midpoint of the face.
+ * This needs to be called whenever the Voronoi grid changes.
+ */
+void VoronoiDensityGrid::build_face_table() {
+
+  const uint_fast32_t numcell = _generator_positions.size();
+  _face_offsets.resize(numcell + 1);
+  _face_neighbours.clear();
+  _face_normals.clear();
+  _face_midpoints.clear();
+  _face_offsets[0] = 0;
+  for (uint_fast32_t i = 0; i < numcell; ++i) {
+    const std::vector< VoronoiFace > faces = _voronoi_grid->get_faces(i);
+    for (auto it = faces.begin(); it != faces.end(); ++it) {
+      const uint_fast32_t ngb = it->get_neighbour();
+      CoordinateVector<> normal;
+      if (_voronoi_grid->is_real_neighbour(ngb)) {
+        normal = _generator_positions[ngb] - _generator_positions[i];
+        normal /= normal.norm();
+      } else {
+        normal = _voronoi_grid->get_wall_normal(ngb);
+      }
+      _face_neighbours.push_back(ngb);
+      _face_normals.push_back(normal);
+      _face_midpoints.push_back(it->get_midpoint());
+    }
+    _face_offsets[i + 1] = _face_neighbours.size();
+  }
+}
+
+/**
+ * @brief Find the first face of the cell with the given index that is hit by a
+ * ray with the given position and direction.
+ *
+ * @param index Index of the cell.
+ * @param position Position of the ray (in m).
+ * @param direction Direction of the ray.
+ * @param next_index Variable to store the index of the neighbour on the other
+ * side of the face in.
+ * @return Distance along the ray to the face (in m), or a negative or zero
+ * value if no valid face was found.
+ */
+double VoronoiDensityGrid::get_next_face(const uint_fast32_t index,
+                                         const CoordinateVector<> &position,
+                                         const CoordinateVector<> &direction,
+                                         uint_fast32_t &next_index) const {
+
+  double mins = -1.;
+  for (size_t i = _face_offsets[index]; i < _face_offsets[index + 1]; ++i) {
+    const CoordinateVector<> &normal = _face_normals[i];
+    const double nk = CoordinateVector<>::dot_product(normal, direction);
+    if (nk > 0) {
+      // in principle, the distance to the plane should always be positive (as
+      // 'position' is supposed to lie inside the cell)
+      // however, due to roundoff, it could happen that 'position' actually is
+      // marginally outside the cell, making the distance negative. To resolve
+      // this issue, we take the absolute value; this guarantees that the sign
+      // of 'sngb' is set by the sign of 'nk', as is the case in a perfect
+      // world without roundoff
+      const double sngb = std::abs(CoordinateVector<>::dot_product(
+                              normal, _face_midpoints[i] - position)) /
+                          nk;
+      if (mins < 0. || (sngb > 0. && sngb < mins)) {
+        mins = sngb;
+        next_index = _face_neighbours[i];
+      }
+    }
+  }
+  return mins;
+}
+
 /**
  * @brief Evolve the grid by moving the grid generators.
  *
@@ -267,10 +356,8 @@ void VoronoiDensityGrid::evolve(double timestep) {
 
     voronoidensitygrid_print_generators();
 
-    delete _voronoi_grid;
-    _voronoi_grid = VoronoiGridFactory::generate(
-        _voronoi_grid_type, _generator_positions, _box, _periodicity_flags);
-    _voronoi_grid->compute_grid();
+    update_voronoi_grid();
+    build_face_table();
 
     if (_log) {
       _log->write_status("Done evolving Voronoi grid.");
@@ -494,48 +581,16 @@ DensityGrid::iterator VoronoiDensityGrid::interact(Photon &photon,
 
   uint_fast32_t index = _voronoi_grid->get_index(photon_origin);
   while (_voronoi_grid->is_real_neighbour(index) && optical_depth > 0.) {
-    CoordinateVector<> ipos = _generator_positions[index];
     uint_fast32_t next_index = 0;
     uint_fast32_t loopcount = 0;
     double mins = -1.;
     while (mins <= 0.) {
-      mins = -1;
-      auto faces = _voronoi_grid->get_faces(index);
-      for (auto it = faces.begin(); it != faces.end(); ++it) {
-        const VoronoiFace &face = *it;
-        const uint_fast32_t ngb = face.get_neighbour();
-        CoordinateVector<> normal;
-        if (_voronoi_grid->is_real_neighbour(ngb)) {
-          normal = _generator_positions[ngb] - ipos;
-        } else {
-          normal = _voronoi_grid->get_wall_normal(ngb);
-        }
-        const double nk =
-            CoordinateVector<>::dot_product(normal, photon_direction);
-        if (nk > 0) {
-          const CoordinateVector<> point = face.get_midpoint();
-          // in principle, the dot product should always be positive (as
-          // 'photon_origin' is supposed to lie inside the cell)
-          // however, due to roundoff, it could happen that 'photon_origin'
-          // actually is marginally outside the cell, making the dot product
-          // negative. To resolve this issue, we take the absolute value of the
-          // dot product; this guarantees that the sign of 'sngb' is set by the
-          // sign of 'nk', as is the case in a perfect world without roundoff
-          const double sngb = std::abs(CoordinateVector<>::dot_product(
-                                  normal, (point - photon_origin))) /
-                              nk;
-          if (mins < 0. || (sngb > 0. && sngb < mins)) {
-            mins = sngb;
-            next_index = ngb;
-          }
-        }
-      }
+      mins = get_next_face(index, photon_origin, photon_direction, next_index);
       ++loopcount;
       cmac_assert_message(loopcount < 100, "mins: %g", mins);
       if (mins <= 0.) {
         photon_origin += _epsilon * photon_direction;
         index = _voronoi_grid->get_index(photon_origin);
-        ipos = _generator_positions[index];
       }
     }
     if (!_voronoi_grid->is_real_neighbour(index)) {
@@ -597,40 +652,16 @@ double VoronoiDensityGrid::get_total_emission(CoordinateVector<> origin,
 
   uint_fast32_t index = _voronoi_grid->get_index(origin);
   while (_voronoi_grid->is_real_neighbour(index)) {
-    CoordinateVector<> ipos = _generator_positions[index];
     uint_fast32_t next_index = 0;
     uint_fast32_t loopcount = 0;
     double mins = -1.;
     while (mins <= 0.) {
-      mins = -1;
-      auto faces = _voronoi_grid->get_faces(index);
-      for (auto it = faces.begin(); it != faces.end(); ++it) {
-        const VoronoiFace &face = *it;
-        const uint_fast32_t ngb = face.get_neighbour();
-        CoordinateVector<> normal;
-        if (_voronoi_grid->is_real_neighbour(ngb)) {
-          normal = _generator_positions[ngb] - ipos;
-        } else {
-          normal = _voronoi_grid->get_wall_normal(ngb);
-        }
-        const double nk = CoordinateVector<>::dot_product(normal, direction);
-        if (nk > 0) {
-          const CoordinateVector<> point = face.get_midpoint();
-          const double sngb = std::abs(CoordinateVector<>::dot_product(
-                                  normal, (point - origin))) /
-                              nk;
-          if (mins < 0. || (sngb > 0. && sngb < mins)) {
-            mins = sngb;
-            next_index = ngb;
-          }
-        }
-      }
+      mins = get_next_face(index, origin, direction, next_index);
       ++loopcount;
       cmac_assert_message(loopcount < 100, "mins: %g", mins);
       if (mins <= 0.) {
         origin += _epsilon * direction;
         index = _voronoi_grid->get_index(origin);
-        ipos = _generator_positions[index];
       }
     }
     if (!_voronoi_grid->is_real_neighbour(index)) {
@@ -68,6 +68,26 @@ private:
   /*! @brief Use a co-moving Voronoi grid? */
   bool _comoving;
 
+  /*! @brief Offset of the first face of each cell in the face table (the
+   *  faces of cell i are stored in [_face_offsets[i], _face_offsets[i+1][). */
+  std::vector< size_t > _face_offsets;
+
+  /*! @brief Index of the neighbouring cell (or wall) for each face. */
+  std::vector< uint_fast32_t > _face_neighbours;
+
+  /*! @brief Outward unit normal of each face. */
+  std::vector< CoordinateVector<> > _face_normals;
+
+  /*! @brief Midpoint of each face (in m). */
+  std::vector< CoordinateVector<> > _face_midpoints;
+
+  void update_voronoi_grid();
+  void build_face_table();
+  double get_next_face(const uint_fast32_t index,
+                       const CoordinateVector<> &position,
+                       const CoordinateVector<> &direction,
+                       uint_fast32_t &next_index) const;
+
 public:
   VoronoiDensityGrid(
       VoronoiGeneratorDistribution *position_generator,
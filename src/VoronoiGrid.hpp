@@ -48,6 +48,21 @@ public:
    */
   virtual void compute_grid(int_fast32_t worksize = -1) = 0;
 
+  /**
+   * @brief Update the Voronoi grid after the generator positions have moved.
+   *
+   * Implementations that support this only recompute the cells that are
+   * affected by the movement. The default implementation does nothing and
+   * signals that the grid needs to be reconstructed from scratch.
+   *
+   * @param worksize Number of shared memory threads to use during the update.
+   * @return True if the grid was updated, false if it needs to be
+   * reconstructed.
+   */
+  virtual bool update_grid(int_fast32_t worksize = -1) {
+    return false;
+  }
+
   /**
    * @brief Get the volume of the Voronoi cell with the given index.
    *
@@ -156,6 +156,10 @@ WMBasicPhotonSourceSpectrum::WMBasicPhotonSourceSpectrum(double temperature,
         _cumulative_distribution[WMBASICPHOTONSOURCESPECTRUM_NUMFREQ - 1];
   }
 
+  // set up the guide table used to sample the cumulative distribution
+  _cumulative_distribution_guide.initialize(
+      _cumulative_distribution.data(), WMBASICPHOTONSOURCESPECTRUM_NUMFREQ);
+
   if (log) {
     log->write_status(
         "Constructed WMBasicPhotonSourceSpectrum with temperature ",
@@ -237,8 +241,8 @@ double WMBasicPhotonSourceSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
   const double x = random_generator.get_uniform_random_double();
-  const uint_fast32_t inu = Utilities::locate(
-      x, _cumulative_distribution.data(), WMBASICPHOTONSOURCESPECTRUM_NUMFREQ);
+  const uint_fast32_t inu = _cumulative_distribution_guide.locate(
+      x, _cumulative_distribution.data());
   const double frequency =
       _frequencies[inu] +
       (_frequencies[inu + 1] - _frequencies[inu]) *
@@ -0,0 +1,186 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file WorkStealingDeque.hpp
+ *
+ * @brief Fixed size Chase-Lev work-stealing deque of indices.
+ *
+ * The deque has a single owner that adds and removes elements at the bottom
+ * end, while any number of other threads can steal elements from the top end.
+ * The owner only needs a compare-and-swap when it competes with a thief for
+ * the last element; thieves use a single compare-and-swap per steal attempt.
+ * The memory orderings follow Le et al. (2013), "Correct and Efficient
+ * Work-Stealing for Weak Memory Models". Unlike the original algorithm, the
+ * storage is not grown dynamically: the caller guarantees that the deque never
+ * holds more elements than requested in the constructor.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef WORKSTEALINGDEQUE_HPP
+#define WORKSTEALINGDEQUE_HPP
+
+#include "Error.hpp"
+
+#include <atomic>
+#include <cinttypes>
+
+/**
+ * @brief Fixed size Chase-Lev work-stealing deque of indices.
+ */
+class WorkStealingDeque {
+private:
+  /*! @brief Element storage. */
+  std::atomic< size_t > *_elements;
+
+  /*! @brief Bit mask used to map positions onto the storage (size of the
+   *  storage minus one, the size is a power of 2). */
+  const int_fast64_t _mask;
+
+  /*! @brief Top of the deque: position of the oldest element (changed by
+   *  thieves and by the owner when it takes the last element). */
+  std::atomic< int_fast64_t > _top;
+
+  /*! @brief Bottom of the deque: position after the newest element (only
+   *  changed by the owner). */
+  std::atomic< int_fast64_t > _bottom;
+
+  /**
+   * @brief Get the smallest power of 2 that is larger than or equal to the
+   * given size.
+   *
+   * @param size Requested size.
+   * @return Smallest power of 2 that can hold the requested size.
+   */
+  inline static int_fast64_t get_storage_size(const size_t size) {
+    int_fast64_t storage_size = 2;
+    while (storage_size < static_cast< int_fast64_t >(size)) {
+      storage_size <<= 1;
+    }
+    return storage_size;
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param size Maximum number of elements in the deque.
+   */
+  inline WorkStealingDeque(const size_t size)
+      : _mask(get_storage_size(size) - 1), _top(0), _bottom(0) {
+    _elements = new std::atomic< size_t >[_mask + 1];
+  }
+
+  /**
+   * @brief Destructor.
+   */
+  inline ~WorkStealingDeque() { delete[] _elements; }
+
+  /**
+   * @brief Add an element to the bottom of the deque.
+   *
+   * Should only be called by the owner of the deque.
+   *
+   * @param value Element to add.
+   */
+  inline void push(const size_t value) {
+    const int_fast64_t bottom = _bottom.load(std::memory_order_relaxed);
+    const int_fast64_t top = _top.load(std::memory_order_acquire);
+    if (bottom - top > _mask) {
+      cmac_error("Work-stealing deque overflow!");
+    }
+    _elements[bottom & _mask].store(value, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Remove the newest element from the bottom of the deque.
+   *
+   * Should only be called by the owner of the deque.
+   *
+   * @param value Variable to store the removed element in.
+   * @return True if an element was removed, false if the deque was empty (or a
+   * thief took the last element).
+   */
+  inline bool pop(size_t &value) {
+    const int_fast64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int_fast64_t top = _top.load(std::memory_order_relaxed);
+    bool success = false;
+    if (top <= bottom) {
+      value = _elements[bottom & _mask].load(std::memory_order_relaxed);
+      success = true;
+      if (top == bottom) {
+        // last element: compete with the thieves
+        success = _top.compare_exchange_strong(top, top + 1,
+                                               std::memory_order_seq_cst,
+                                               std::memory_order_relaxed);
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+      }
+    } else {
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return success;
+  }
+
+  /**
+   * @brief Steal the oldest element from the top of the deque.
+   *
+   * Can be called by any thread.
+   *
+   * @param value Variable to store the stolen element in.
+   * @return True if an element was stolen, false if the deque was empty or
+   * another thread won the race for the top element.
+   */
+  inline bool steal(size_t &value) {
+    int_fast64_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int_fast64_t bottom = _bottom.load(std::memory_order_acquire);
+    if (top < bottom) {
+      value = _elements[top & _mask].load(std::memory_order_relaxed);
+      return _top.compare_exchange_strong(top, top + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed);
+    }
+    return false;
+  }
+
+  /**
+   * @brief Get the (approximate) number of elements in the deque.
+   *
+   * @return Number of elements in the deque.
+   */
+  inline size_t size() const {
+    const int_fast64_t bottom = _bottom.load(std::memory_order_relaxed);
+    const int_fast64_t top = _top.load(std::memory_order_relaxed);
+    return (bottom > top) ? bottom - top : 0;
+  }
+
+  /**
+   * @brief Get the size in memory of the deque.
+   *
+   * @return Size in memory of the deque (in bytes).
+   */
+  inline size_t get_memory_size() const {
+    return sizeof(WorkStealingDeque) + (_mask + 1) * sizeof(size_t);
+  }
+};
+
+#endif // WORKSTEALINGDEQUE_HPP
@@ -138,5 +138,20 @@ int main(int argc, char **argv) {
   }
   assert_condition(ncell == grid.get_number_of_cells());
 
+  // photon traversal through the refined part of the grid: a photon with a
+  // very large optical depth leaves the box through the top wall
+  CoordinateVector<> photon_direction(0.1, 0.2, 1.);
+  photon_direction /= photon_direction.norm();
+  Photon photon(CoordinateVector<>(0.3, 0.4, 0.1), photon_direction, 1.);
+  photon.set_cross_section(ION_H_n, 1.);
+#ifdef HAS_HELIUM
+  photon.set_cross_section(ION_He_n, 1.);
+#endif
+  DensityGrid::iterator inside = grid.interact(photon, 1.e99);
+  assert_condition(inside == grid.end());
+  assert_values_equal_rel(photon.get_position().x(), 0.39, 1.e-12);
+  assert_values_equal_rel(photon.get_position().y(), 0.58, 1.e-12);
+  assert_values_equal_rel(photon.get_position().z(), 1., 1.e-12);
+
   return 0;
 }
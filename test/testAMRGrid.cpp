@@ -27,6 +27,7 @@
 #include "Assert.hpp"
 #include "Box.hpp"
 #include "CoordinateVector.hpp"
+#include "Utilities.hpp"
 #include <cinttypes>
 #include <fstream>
 
@@ -350,5 +351,49 @@ int main(int argc, char **argv) {
   assert_condition(testbox.get_sides().y() == 0.125);
   assert_condition(testbox.get_sides().z() == 0.125);
 
+  /// flattened storage
+
+  grid.flatten();
+  assert_condition(grid.get_number_of_flat_cells() ==
+                   grid.get_number_of_cells());
+  // the flat cells are stored in Morton order
+  key = grid.get_first_key();
+  for (amrflatindex_t i = 0; i < grid.get_number_of_flat_cells(); ++i) {
+    assert_condition(&grid.get_flat_cell(i) == &grid[key]);
+    key = grid.get_next_key(key);
+  }
+  assert_condition(key == grid.get_max_key());
+
+  // flat position lookups agree with the tree
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    const CoordinateVector<> position(2. * Utilities::random_double(),
+                                      Utilities::random_double(),
+                                      Utilities::random_double());
+    const amrflatindex_t flat_index = grid.get_flat_index(position);
+    assert_condition(grid.get_flat_cell(flat_index).value() ==
+                     grid.get_cell(position));
+  }
+
+  // flat neighbours agree with a direct lookup on the other side of the face
+  for (amrflatindex_t i = 0; i < grid.get_number_of_flat_cells(); ++i) {
+    const CoordinateVector<> midpoint =
+        grid.get_flat_anchor(i) + 0.5 * grid.get_flat_sides(i);
+    for (uint_fast8_t j = 0; j < 6; ++j) {
+      CoordinateVector<> ngb_position = midpoint;
+      const uint_fast8_t dim = j / 2;
+      const double sign = (j % 2) ? 1. : -1.;
+      ngb_position[dim] += sign * 0.6 * grid.get_flat_sides(i)[dim];
+      const amrflatindex_t ngb =
+          grid.get_flat_ngb(i, static_cast< AMRNgbPosition >(j), ngb_position);
+      if (ngb_position.x() < 0. || ngb_position.x() > 2. ||
+          ngb_position.y() < 0. || ngb_position.y() > 1. ||
+          ngb_position.z() < 0. || ngb_position.z() > 1.) {
+        assert_condition(ngb == AMRGRID_FLAT_NONE);
+      } else {
+        assert_condition(ngb == grid.get_flat_index(ngb_position));
+      }
+    }
+  }
+
   return 0;
 }
@@ -97,6 +97,15 @@ int main(int argc, char **argv) {
   /* run the simulation */
   cmi_compute_neutral_fraction_dp(x, y, z, h, m, nH, TEST_CMICLIBRARY_NPART3D);
 
+  /* run the simulation again on a background thread and wait for it */
+  cmi_compute_neutral_fraction_async_dp(x, y, z, h, m, nH,
+                                        TEST_CMICLIBRARY_NPART3D);
+  cmi_wait();
+  if (!cmi_test()) {
+    printf("Asynchronous computation did not finish!\n");
+    return 1;
+  }
+
   /* write an output file for visual checking */
   file = fopen("test_CMI_C_library.txt", "w");
   for (i = 0; i < TEST_CMICLIBRARY_NPART3D; ++i) {
@@ -34,7 +34,8 @@ program testCMIFortranLibrary
   use cmi_fortran_library
   implicit none
 
-  real*8 x(1000), y(1000), z(1000), h(1000), m(1000), nH(1000)
+  real*8 x(1000), y(1000), z(1000), h(1000), m(1000)
+  real*8, asynchronous :: nH(1000)
   real*8 box_anchor(3), box_sides(3)
   real*8 pc
   integer i, ix, iy, iz
@@ -70,6 +71,13 @@ program testCMIFortranLibrary
   ! run the simulation
   call cmi_compute_neutral_fraction_dp(x, y, z, h, m, nH, int8(1000))
 
+  ! run the simulation again in the background and poll until it is done
+  call cmi_compute_neutral_fraction_async_dp(x, y, z, h, m, nH, int8(1000))
+  do while (cmi_test() == 0)
+    call sleep(1)
+  end do
+  call cmi_wait()
+
   ! write an output file for visual checking
   open(unit = 1, file = "test_CMI_fortran_library.txt")
   do i = 1, 1000
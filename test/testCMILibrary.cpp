@@ -24,6 +24,7 @@
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
 
+#include "Assert.hpp"
 #include "CMILibrary.hpp"
 
 #include <fstream>
@@ -77,6 +78,53 @@ int main(int argc, char **argv) {
   }
   ofile.close();
 
+  // run the simulation again on a background thread, starting from the
+  // ionization state at the end of the first run
+  std::vector< double > nH_async(1000, -1.);
+  cmi_compute_neutral_fraction_async_dp(x.data(), y.data(), z.data(), h.data(),
+                                        m.data(), nH_async.data(), 1000);
+  // the particle data were copied, so we are free to change them
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    x[i] = 0.;
+  }
+  cmi_wait();
+  assert_condition(cmi_test() == 1);
+
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    assert_condition(nH_async[i] >= 0. && nH_async[i] <= 1.);
+  }
+
+  // push the same particles in two halves and start a computation on them
+  std::vector< double > x_push(1000);
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    x_push[i] = box_anchor[0] + 0.1 * (i / 100 + 0.5) * box_sides[0];
+  }
+  std::vector< double > nH_push(1000, -1.);
+  cmi_set_number_of_particles(1000);
+  cmi_push_particles_dp(0, x_push.data(), y.data(), z.data(), h.data(),
+                        m.data(), 500);
+  cmi_push_particles_dp(500, &x_push[500], &y[500], &z[500], &h[500], &m[500],
+                        500);
+  cmi_start_computation_dp(nH_push.data());
+  // pushing the next step does not affect the running computation
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    m[i] *= 0.5;
+  }
+  cmi_push_particles_dp(0, x_push.data(), y.data(), z.data(), h.data(),
+                        m.data(), 1000);
+  cmi_wait();
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    assert_condition(nH_push[i] >= 0. && nH_push[i] <= 1.);
+  }
+
+  // the second step only changes masses and reuses the neighbour search tree
+  std::vector< double > nH_push2(1000, -1.);
+  cmi_start_computation_dp(nH_push2.data());
+  cmi_wait();
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    assert_condition(nH_push2[i] >= 0. && nH_push2[i] <= 1.);
+  }
+
   // clean up the library
   cmi_destroy();
 
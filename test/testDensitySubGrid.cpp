@@ -30,6 +30,7 @@
 #include "RandomGenerator.hpp"
 
 #include <fstream>
+#include <vector>
 
 /**
  * @brief Unit test for the DensitySubGrid class.
@@ -95,6 +96,160 @@ int main(int argc, char **argv) {
     }
   }
 
+  /// check that the batch traversal matches the scalar traversal
+  {
+    DensitySubGrid scalar_grid(grid);
+    DensitySubGrid verify_grid(grid);
+    DensitySubGrid batch_grid(grid);
+    scalar_grid.reset_intensities();
+    verify_grid.reset_intensities();
+    batch_grid.reset_intensities();
+
+    const uint_fast32_t number_of_photons = 1000;
+    std::vector< PhotonPacket > scalar_photons(number_of_photons);
+    for (uint_fast32_t i = 0; i < number_of_photons; ++i) {
+      PhotonPacket &photon = scalar_photons[i];
+      photon.set_energy(3.288e15 *
+                        (1. + random_generator.get_uniform_random_double()));
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        photon.set_photoionization_cross_section(ion, 0.);
+      }
+      photon.set_photoionization_cross_section(
+          ION_H_n, 6.3e-22 * random_generator.get_uniform_random_double());
+#ifdef HAS_HELIUM
+      photon.set_photoionization_cross_section(
+          ION_He_n, 7.4e-22 * random_generator.get_uniform_random_double());
+#endif
+      const double cost =
+          2. * random_generator.get_uniform_random_double() - 1.;
+      const double phi =
+          2. * M_PI * random_generator.get_uniform_random_double();
+      const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+      photon.set_direction(
+          CoordinateVector<>(sint * std::cos(phi), sint * std::sin(phi), cost));
+      // half of the photon packets start in the same (central) cell
+      if (i % 2 == 0) {
+        photon.set_position(CoordinateVector<>(0.));
+      } else {
+        photon.set_position(CoordinateVector<>(
+            3.e17 * (random_generator.get_uniform_random_double() - 0.5),
+            3.e17 * (random_generator.get_uniform_random_double() - 0.5),
+            3.e17 * (random_generator.get_uniform_random_double() - 0.5)));
+      }
+      photon.set_weight(random_generator.get_uniform_random_double());
+      photon.set_target_optical_depth(
+          -std::log(random_generator.get_uniform_random_double()));
+    }
+    std::vector< PhotonPacket > verify_photons(scalar_photons);
+    std::vector< PhotonPacket > batch_photons(scalar_photons);
+
+    std::vector< int_fast32_t > scalar_results(number_of_photons);
+    for (uint_fast32_t i = 0; i < number_of_photons; ++i) {
+      scalar_results[i] =
+          scalar_grid.interact(scalar_photons[i], TRAVELDIRECTION_INSIDE);
+    }
+    std::vector< int_fast32_t > verify_results(number_of_photons);
+    verify_grid.interact_batch(&verify_photons[0], number_of_photons,
+                               TRAVELDIRECTION_INSIDE, &verify_results[0],
+                               true);
+    std::vector< int_fast32_t > batch_results(number_of_photons);
+    batch_grid.interact_batch(&batch_photons[0], number_of_photons,
+                              TRAVELDIRECTION_INSIDE, &batch_results[0]);
+
+    for (uint_fast32_t i = 0; i < number_of_photons; ++i) {
+      assert_condition(verify_results[i] == scalar_results[i]);
+      assert_condition(batch_results[i] == scalar_results[i]);
+      for (uint_fast8_t j = 0; j < 3; ++j) {
+        assert_condition(verify_photons[i].get_position()[j] ==
+                         scalar_photons[i].get_position()[j]);
+        assert_condition(batch_photons[i].get_position()[j] ==
+                         scalar_photons[i].get_position()[j]);
+      }
+      assert_condition(verify_photons[i].get_target_optical_depth() ==
+                       scalar_photons[i].get_target_optical_depth());
+      assert_condition(batch_photons[i].get_target_optical_depth() ==
+                       scalar_photons[i].get_target_optical_depth());
+    }
+
+    auto scalar_it = scalar_grid.begin();
+    auto verify_it = verify_grid.begin();
+    auto batch_it = batch_grid.begin();
+    while (scalar_it != scalar_grid.end()) {
+      const IonizationVariables &scalar_vars =
+          scalar_it.get_ionization_variables();
+      const IonizationVariables &verify_vars =
+          verify_it.get_ionization_variables();
+      const IonizationVariables &batch_vars =
+          batch_it.get_ionization_variables();
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        // verification mode needs to be bit-compatible
+        assert_condition(verify_vars.get_mean_intensity(ion) ==
+                         scalar_vars.get_mean_intensity(ion));
+        // the normal batch mode adds contributions in a different order
+        assert_values_equal_rel(batch_vars.get_mean_intensity(ion),
+                                scalar_vars.get_mean_intensity(ion), 1.e-12);
+      }
+      assert_condition(verify_vars.get_heating(HEATINGTERM_H) ==
+                       scalar_vars.get_heating(HEATINGTERM_H));
+      assert_values_equal_rel(batch_vars.get_heating(HEATINGTERM_H),
+                              scalar_vars.get_heating(HEATINGTERM_H), 1.e-12);
+      ++scalar_it;
+      ++verify_it;
+      ++batch_it;
+    }
+  }
+
+  /// check the operations that act on all cell variables of a subgrid copy
+  {
+    DensitySubGrid copy(grid);
+    auto it = grid.begin();
+    auto copy_it = copy.begin();
+    while (it != grid.end()) {
+      const IonizationVariables &vars = it.get_ionization_variables();
+      IonizationVariables &copy_vars = copy_it.get_ionization_variables();
+      assert_condition(copy_vars.get_number_density() ==
+                       vars.get_number_density());
+      assert_condition(copy_vars.get_ionic_fraction(ION_H_n) ==
+                       vars.get_ionic_fraction(ION_H_n));
+      assert_condition(copy_vars.get_mean_intensity(ION_H_n) ==
+                       vars.get_mean_intensity(ION_H_n));
+      copy_vars.set_mean_intensity(ION_H_n, copy_it.get_index());
+      copy_vars.set_heating(HEATINGTERM_H, 2. * copy_it.get_index());
+      ++it;
+      ++copy_it;
+    }
+
+    DensitySubGrid sum(grid);
+    sum.update_intensities(copy);
+    it = grid.begin();
+    auto sum_it = sum.begin();
+    while (it != grid.end()) {
+      const IonizationVariables &vars = it.get_ionization_variables();
+      const IonizationVariables &sum_vars = sum_it.get_ionization_variables();
+      assert_condition(sum_vars.get_mean_intensity(ION_H_n) ==
+                       vars.get_mean_intensity(ION_H_n) + it.get_index());
+      assert_condition(sum_vars.get_heating(HEATINGTERM_H) ==
+                       vars.get_heating(HEATINGTERM_H) + 2. * it.get_index());
+      assert_condition(sum_vars.get_number_density() ==
+                       vars.get_number_density());
+      ++it;
+      ++sum_it;
+    }
+
+    for (auto cellit = sum.begin(); cellit != sum.end(); ++cellit) {
+      cellit.get_ionization_variables().set_number_density(2.e8);
+      cellit.get_ionization_variables().set_ionic_fraction(ION_H_n, 0.5);
+    }
+    copy.update_neutral_fractions(sum);
+    for (auto cellit = copy.begin(); cellit != copy.end(); ++cellit) {
+      const IonizationVariables &vars = cellit.get_ionization_variables();
+      assert_condition(vars.get_number_density() == 2.e8);
+      assert_condition(vars.get_ionic_fraction(ION_H_n) == 0.5);
+      assert_condition(vars.get_mean_intensity(ION_H_n) == 0.);
+      assert_condition(vars.get_heating(HEATINGTERM_H) == 0.);
+    }
+  }
+
   /// write a restart file
   {
     RestartWriter writer("test_densitysubgrid.restart");
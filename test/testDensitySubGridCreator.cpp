@@ -27,7 +27,9 @@
 #include "Assert.hpp"
 #include "DensitySubGridCreator.hpp"
 #include "HomogeneousDensityFunction.hpp"
+#include "SpatialAMRRefinementScheme.hpp"
 
+#include <cmath>
 #include <fstream>
 #include <vector>
 
@@ -361,5 +363,113 @@ int main(int argc, char **argv) {
   assert_condition(grid131.get_neighbour(TRAVELDIRECTION_FACE_Z_N) == 128);
   assert_condition(grid131.get_neighbour(TRAVELDIRECTION_FACE_Z_P) == 84);
 
+  /// adaptive copies
+  // make subgrid 0 very expensive and put all the work on thread 0
+  for (auto gridit = grid_creator.begin(); gridit != grid_creator.all_end();
+       ++gridit) {
+    (*gridit).reset_computational_cost();
+    (*gridit).set_owning_thread(0);
+    if (gridit.get_index() < grid_creator.number_of_original_subgrids()) {
+      (*gridit).add_computational_cost(1);
+    }
+  }
+  (*grid_creator.get_subgrid(0)).add_computational_cost(999);
+  double old_imbalance, new_imbalance;
+  assert_condition(grid_creator.rebalance_copies(3, 0.5, 4, old_imbalance,
+                                                 new_imbalance));
+  assert_condition(old_imbalance == 3.);
+  assert_condition(new_imbalance < 0.1);
+  // subgrid 0 gets the maximum level, its neighbours are restricted
+  assert_condition(grid_creator.get_copy_level(0) == 3);
+  assert_condition(grid_creator.get_copy_level(1) == 2);
+  assert_condition(grid_creator.get_copy_level(8) == 2);
+  assert_condition(grid_creator.get_copy_level(32) == 2);
+  assert_condition(grid_creator.get_copy_level(2) == 1);
+  assert_condition(grid_creator.get_copy_level(64) == 1);
+  // the copies of 82 and 83 were removed
+  assert_condition(grid_creator.get_copy_level(82) == 0);
+  assert_condition(grid_creator.get_copy_level(83) == 0);
+  assert_condition(grid_creator.get_subgrid(83).get_copies().first ==
+                   grid_creator.all_end());
+  assert_condition(grid_creator.number_of_actual_subgrids() == 150);
+  // the copies of subgrid 0 are spread over all threads
+  {
+    auto copies = grid_creator.get_subgrid(0).get_copies();
+    std::vector< uint_fast32_t > threads(4, 0);
+    ++threads[(*grid_creator.get_subgrid(0)).get_owning_thread()];
+    for (auto it = copies.first; it != copies.second; ++it) {
+      ++threads[(*it).get_owning_thread()];
+    }
+    for (uint_fast32_t i = 0; i < 4; ++i) {
+      assert_condition(threads[i] == 2);
+    }
+  }
+
+  // the same costs lead to the same layout
+  for (auto gridit = grid_creator.begin(); gridit != grid_creator.all_end();
+       ++gridit) {
+    (*gridit).reset_computational_cost();
+  }
+  for (auto gridit = grid_creator.begin();
+       gridit != grid_creator.original_end(); ++gridit) {
+    (*gridit).add_computational_cost(1);
+  }
+  (*grid_creator.get_subgrid(0)).add_computational_cost(999);
+  assert_condition(!grid_creator.rebalance_copies(3, 0.5, 4, old_imbalance,
+                                                  new_imbalance));
+
+  /// refined subgrids
+  {
+    DensitySubGridCreator< DensitySubGrid > refined_creator(
+        Box<>(box_anchor, box_sides), CoordinateVector< int_fast32_t >(16),
+        CoordinateVector< int_fast32_t >(4), CoordinateVector< bool >(false),
+        2);
+    // refine the region around the corner of the box
+    SpatialAMRRefinementScheme refinement_scheme(
+        Box<>(box_anchor, CoordinateVector<>(0.1)), 2);
+    refined_creator.initialize(density_function, &refinement_scheme);
+
+    assert_condition(refined_creator.is_refined());
+    assert_condition(refined_creator.get_refinement_level(0) == 2);
+    assert_condition((*refined_creator.get_subgrid(0)).get_number_of_cells() ==
+                     64 * 64);
+    assert_condition(refined_creator.get_refinement_level(63) == 0);
+
+    uint_fast64_t total_number_of_cells = 0;
+    size_t ngbs[6];
+    for (size_t i = 0; i < refined_creator.number_of_original_subgrids();
+         ++i) {
+      total_number_of_cells +=
+          (*refined_creator.get_subgrid(i)).get_number_of_cells();
+      // neighbouring levels differ by at most one
+      const uint_fast8_t numngbs = refined_creator.get_neighbours(i, ngbs);
+      for (uint_fast8_t ingb = 0; ingb < numngbs; ++ingb) {
+        const int_fast32_t level = refined_creator.get_refinement_level(i);
+        const int_fast32_t ngb_level =
+            refined_creator.get_refinement_level(ngbs[ingb]);
+        assert_condition(std::abs(level - ngb_level) <= 1);
+      }
+    }
+    assert_condition(total_number_of_cells ==
+                     refined_creator.number_of_cells());
+
+    {
+      RestartWriter writer("test_densitysubgridcreator_refined.restart");
+      refined_creator.write_restart_file(writer);
+    }
+    {
+      RestartReader reader("test_densitysubgridcreator_refined.restart");
+      DensitySubGridCreator< DensitySubGrid > refined_creator2(reader);
+      for (size_t i = 0; i < refined_creator.number_of_original_subgrids();
+           ++i) {
+        assert_condition(refined_creator.get_refinement_level(i) ==
+                         refined_creator2.get_refinement_level(i));
+        assert_condition(
+            (*refined_creator.get_subgrid(i)).get_number_of_cells() ==
+            (*refined_creator2.get_subgrid(i)).get_number_of_cells());
+      }
+    }
+  }
+
   return 0;
 }
@@ -68,10 +68,18 @@ int main(int argc, char **argv) {
   for (auto cellit = test_grid.begin(); cellit != test_grid.end(); ++cellit) {
     IonizationVariables &variables = cellit.get_ionization_variables();
     variables.set_number_density(random_generator.get_uniform_random_double());
-    variables.set_ionic_fraction(ION_H_n,
-                                 random_generator.get_uniform_random_double());
-    variables.set_mean_intensity(ION_H_n,
-                                 random_generator.get_uniform_random_double());
+    variables.set_temperature(random_generator.get_uniform_random_double());
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      variables.set_ionic_fraction(
+          ion, random_generator.get_uniform_random_double());
+      variables.set_mean_intensity(
+          ion, random_generator.get_uniform_random_double());
+    }
+    for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
+         ++heating) {
+      variables.set_heating(heating,
+                            random_generator.get_uniform_random_double());
+    }
   }
 
   // now communicate:
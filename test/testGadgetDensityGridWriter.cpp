@@ -28,10 +28,13 @@
 #include "CartesianDensityGrid.hpp"
 #include "CoordinateVector.hpp"
 #include "DensityFunction.hpp"
+#include "DensitySubGridCreator.hpp"
 #include "GadgetDensityGridWriter.hpp"
 #include "HDF5Tools.hpp"
 #include "HomogeneousDensityFunction.hpp"
+#include "HydroDensitySubGrid.hpp"
 #include "TerminalLog.hpp"
+#include "Utilities.hpp"
 #include <vector>
 
 /**
@@ -213,5 +216,161 @@ int main(int argc, char **argv) {
     HDF5Tools::close_file(file);
   }
 
+  // asynchronous output for a split grid with hydro should produce exactly the
+  // same snapshot as synchronous output
+  {
+    DensitySubGridCreator< HydroDensitySubGrid > grid_creator(
+        Box<>(CoordinateVector<>(-0.5), CoordinateVector<>(1.)),
+        CoordinateVector< int_fast32_t >(8),
+        CoordinateVector< int_fast32_t >(2),
+        CoordinateVector< bool >(false));
+    HomogeneousDensityFunction density_function;
+    density_function.initialize();
+    grid_creator.initialize(density_function);
+
+    uint_fast32_t fields[DENSITYGRIDFIELD_NUMBER];
+    for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
+         ++property) {
+      fields[property] = 0;
+    }
+    fields[DENSITYGRIDFIELD_COORDINATES] = true;
+    fields[DENSITYGRIDFIELD_NUMBER_DENSITY] = true;
+    fields[DENSITYGRIDFIELD_TEMPERATURE] = true;
+    fields[DENSITYGRIDFIELD_NEUTRAL_FRACTION] = 1;
+
+    ParameterFile params("test.param");
+    GadgetDensityGridWriter sync_writer("testgrid_sync", ".", true,
+                                        DensityGridWriterFields(fields));
+    sync_writer.write(grid_creator, 0, params, 1.);
+
+    // we write two snapshots to make sure both staging areas are used
+    GadgetDensityGridWriter async_writer("testgrid_async", ".", true,
+                                         DensityGridWriterFields(fields),
+                                         nullptr, 3, true, true);
+    async_writer.write(grid_creator, 0, params, 1.);
+    async_writer.write(grid_creator, 1, params, 2.);
+    async_writer.wait_for_output();
+
+    HDF5Tools::HDF5File sync_file = HDF5Tools::open_file(
+        "testgrid_sync000.hdf5", HDF5Tools::HDF5FILEMODE_READ);
+    HDF5Tools::HDF5Group sync_group =
+        HDF5Tools::open_group(sync_file, "PartType0");
+    std::vector< CoordinateVector<> > sync_coords =
+        HDF5Tools::read_dataset< CoordinateVector<> >(sync_group,
+                                                      "Coordinates");
+    std::vector< double > sync_ntot =
+        HDF5Tools::read_dataset< double >(sync_group, "NumberDensity");
+    std::vector< double > sync_nfracH =
+        HDF5Tools::read_dataset< double >(sync_group, "NeutralFractionH");
+    HDF5Tools::close_group(sync_group);
+    HDF5Tools::close_file(sync_file);
+
+    assert_condition(sync_coords.size() == 512);
+
+    for (uint_fast32_t counter = 0; counter < 2; ++counter) {
+      const std::string filename = Utilities::compose_filename(
+          ".", "testgrid_async", "hdf5", counter, 3);
+      HDF5Tools::HDF5File file =
+          HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_READ);
+
+      HDF5Tools::HDF5Group group = HDF5Tools::open_group(file, "Header");
+      double time = HDF5Tools::read_attribute< double >(group, "Time");
+      assert_condition(time == counter + 1.);
+      std::vector< uint32_t > numpart_file =
+          HDF5Tools::read_attribute< std::vector< uint32_t > >(
+              group, "NumPart_ThisFile");
+      assert_condition(numpart_file[0] == 512);
+      HDF5Tools::close_group(group);
+
+      group = HDF5Tools::open_group(file, "PartType0");
+      std::vector< CoordinateVector<> > coords =
+          HDF5Tools::read_dataset< CoordinateVector<> >(group, "Coordinates");
+      std::vector< double > ntot =
+          HDF5Tools::read_dataset< double >(group, "NumberDensity");
+      std::vector< double > nfracH =
+          HDF5Tools::read_dataset< double >(group, "NeutralFractionH");
+      HDF5Tools::close_group(group);
+      HDF5Tools::close_file(file);
+
+      assert_condition(coords.size() == sync_coords.size());
+      for (uint_fast32_t i = 0; i < sync_coords.size(); ++i) {
+        assert_condition(coords[i] == sync_coords[i]);
+        assert_condition(ntot[i] == sync_ntot[i]);
+        assert_condition(nfracH[i] == sync_nfracH[i]);
+      }
+    }
+  }
+
+  // reduced precision output and coordinates that are only written once
+  {
+    DensitySubGridCreator< HydroDensitySubGrid > grid_creator(
+        Box<>(CoordinateVector<>(-0.5), CoordinateVector<>(1.)),
+        CoordinateVector< int_fast32_t >(8),
+        CoordinateVector< int_fast32_t >(2),
+        CoordinateVector< bool >(false));
+    HomogeneousDensityFunction density_function;
+    density_function.initialize();
+    grid_creator.initialize(density_function);
+
+    uint_fast32_t flags[DENSITYGRIDFIELD_NUMBER];
+    for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
+         ++property) {
+      flags[property] = 0;
+    }
+    flags[DENSITYGRIDFIELD_COORDINATES] = true;
+    flags[DENSITYGRIDFIELD_NUMBER_DENSITY] = true;
+    flags[DENSITYGRIDFIELD_TEMPERATURE] = true;
+    flags[DENSITYGRIDFIELD_NEUTRAL_FRACTION] = 1;
+    DensityGridWriterFields fields(flags);
+    fields.set_field_precision(DENSITYGRIDFIELD_COORDINATES,
+                               DENSITYGRIDFIELDPRECISION_FLOAT32);
+    fields.set_field_precision(DENSITYGRIDFIELD_NUMBER_DENSITY,
+                               DENSITYGRIDFIELDPRECISION_FLOAT32);
+    fields.set_field_precision(DENSITYGRIDFIELD_TEMPERATURE,
+                               DENSITYGRIDFIELDPRECISION_FLOAT16);
+    fields.set_field_precision(DENSITYGRIDFIELD_NEUTRAL_FRACTION,
+                               DENSITYGRIDFIELDPRECISION_SIGNIFICANT, 3);
+
+    ParameterFile params("test.param");
+    GadgetDensityGridWriter writer("testgrid_precision", ".", true, fields,
+                                   nullptr, 3, true, false, true);
+    writer.write(grid_creator, 0, params, 0.);
+    writer.write(grid_creator, 1, params, 1.);
+
+    std::vector< CoordinateVector<> > first_coords;
+    for (uint_fast32_t counter = 0; counter < 2; ++counter) {
+      const std::string filename = Utilities::compose_filename(
+          ".", "testgrid_precision", "hdf5", counter, 3);
+      HDF5Tools::HDF5File file =
+          HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_READ);
+      HDF5Tools::HDF5Group group = HDF5Tools::open_group(file, "PartType0");
+      // the second snapshot links to the coordinates in the first one
+      std::vector< CoordinateVector<> > coords =
+          HDF5Tools::read_dataset< CoordinateVector<> >(group, "Coordinates");
+      std::vector< double > ntot =
+          HDF5Tools::read_dataset< double >(group, "NumberDensity");
+      std::vector< double > temperature =
+          HDF5Tools::read_dataset< double >(group, "Temperature");
+      std::vector< double > nfracH =
+          HDF5Tools::read_dataset< double >(group, "NeutralFractionH");
+      HDF5Tools::close_group(group);
+      HDF5Tools::close_file(file);
+
+      if (counter == 0) {
+        first_coords = coords;
+      }
+      assert_condition(coords.size() == 512);
+      for (uint_fast32_t i = 0; i < coords.size(); ++i) {
+        assert_condition(coords[i] == first_coords[i]);
+        assert_condition(ntot[i] == 1.);
+        // 8000 is exactly representable in half precision
+        assert_condition(temperature[i] == 8000.);
+        // the neutral fraction keeps its relative precision, while quantisation
+        // with the same number of digits would store 0
+        assert_values_equal_rel(nfracH[i], 1.e-6, 5.e-4);
+      }
+    }
+  }
+
   return 0;
 }
@@ -0,0 +1,114 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testGuideTable.cpp
+ *
+ * @brief Unit test for the GuideTable class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "GuideTable.hpp"
+#include "Utilities.hpp"
+
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Unit test for the GuideTable class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// cumulative distribution with a very uneven distribution and flat parts
+  {
+    const uint_fast32_t length = 1000;
+    std::vector< double > cumulative_distribution(length, 0.);
+    for (uint_fast32_t i = 1; i < length; ++i) {
+      // the first 100 and every tenth bin are empty
+      if (i > 100 && i % 10 != 0) {
+        const double x = 0.01 * i;
+        cumulative_distribution[i] = x * x * x * std::exp(-x);
+      }
+      cumulative_distribution[i] += cumulative_distribution[i - 1];
+    }
+    for (uint_fast32_t i = 0; i < length; ++i) {
+      cumulative_distribution[i] /= cumulative_distribution[length - 1];
+    }
+
+    // try a few different guide table sizes
+    const uint_fast32_t number_of_guides[3] = {0, 1, 10 * length};
+    for (uint_fast8_t iguide = 0; iguide < 3; ++iguide) {
+      const GuideTable guide_table(cumulative_distribution.data(), length,
+                                   number_of_guides[iguide]);
+
+      for (uint_fast32_t i = 0; i < 100000; ++i) {
+        const double x = Utilities::random_double();
+        assert_condition(
+            guide_table.locate(x, cumulative_distribution.data()) ==
+            Utilities::locate(x, cumulative_distribution.data(), length));
+      }
+      // values that are exactly equal to table values or outside the table
+      for (uint_fast32_t i = 0; i < length; ++i) {
+        const double x = cumulative_distribution[i];
+        assert_condition(
+            guide_table.locate(x, cumulative_distribution.data()) ==
+            Utilities::locate(x, cumulative_distribution.data(), length));
+      }
+      assert_condition(
+          guide_table.locate(-1., cumulative_distribution.data()) == 0);
+      assert_condition(guide_table.locate(2., cumulative_distribution.data()) ==
+                       length - 2);
+    }
+  }
+
+  /// regular temperature table with a value range outside [0, 1]
+  {
+    const uint_fast32_t length = 100;
+    std::vector< double > temperature(length);
+    for (uint_fast32_t i = 0; i < length; ++i) {
+      temperature[i] = 1500. + (i + 0.5) * 13500. / length;
+    }
+    GuideTable guide_table;
+    guide_table.initialize(temperature.data(), length);
+
+    for (uint_fast32_t i = 0; i < 100000; ++i) {
+      const double T = 1000. + 15000. * Utilities::random_double();
+      assert_condition(guide_table.locate(T, temperature.data()) ==
+                       Utilities::locate(T, temperature.data(), length));
+    }
+  }
+
+  /// degenerate table with only equal values
+  {
+    const double values[3] = {1., 1., 1.};
+    const GuideTable guide_table(values, 3);
+    assert_condition(guide_table.locate(0.5, values) ==
+                     Utilities::locate(0.5, values, 3));
+    assert_condition(guide_table.locate(1., values) ==
+                     Utilities::locate(1., values, 3));
+    assert_condition(guide_table.locate(1.5, values) ==
+                     Utilities::locate(1.5, values, 3));
+  }
+
+  return 0;
+}
@@ -26,6 +26,7 @@
 #include "Assert.hpp"
 #include "CoordinateVector.hpp"
 #include "HDF5Tools.hpp"
+#include <cmath>
 #include <vector>
 
 /**
@@ -240,6 +241,74 @@ int main(int argc, char **argv) {
     HDF5Tools::append_dataset(group, "VectorBlockTest", 0, vpart1);
     HDF5Tools::append_dataset(group, "VectorBlockTest", 50, vpart2);
 
+    // reduced precision test: the values just below a power of 2 round up to
+    // the next power of 2 in half precision, which is where the HDF5 internal
+    // conversion sometimes fails
+    std::vector< double > precision_values(4);
+    precision_values[0] = 1023.9360579714842;
+    precision_values[1] = 0.1;
+    precision_values[2] = 4095.229852245815;
+    precision_values[3] = 12.3456789;
+    HDF5Tools::create_dataset< double >(group, "Float32Test", 4, true,
+                                        HDF5Tools::HDF5PRECISION_FLOAT32);
+    HDF5Tools::append_dataset(group, "Float32Test", 0, precision_values);
+    HDF5Tools::create_dataset< double >(group, "Float16Test", 4, false,
+                                        HDF5Tools::HDF5PRECISION_FLOAT16);
+    HDF5Tools::append_dataset(group, "Float16Test", 0, precision_values);
+    HDF5Tools::create_dataset< double >(group, "QuantisedTest", 4, true,
+                                        HDF5Tools::HDF5PRECISION_QUANTISED, 2);
+    HDF5Tools::append_dataset(group, "QuantisedTest", 0, precision_values);
+    // significant digits test: unlike quantised datasets, values that span
+    // many orders of magnitude (like neutral fractions) keep their relative
+    // precision. 2048 values cover complete chunks, so that the values are
+    // compressed by HDF5Tools itself.
+    std::vector< double > significant_values(2048);
+    for (uint_fast32_t i = 0; i < 2048; ++i) {
+      significant_values[i] =
+          std::pow(10., -8. + 12. * i / 2048.) * (1. + 0.1 * std::sin(1. * i));
+    }
+    HDF5Tools::create_dataset< double >(group, "SignificantTest", 2048, true,
+                                        HDF5Tools::HDF5PRECISION_SIGNIFICANT,
+                                        3);
+    HDF5Tools::append_dataset(group, "SignificantTest", 0,
+                              significant_values);
+
+    // compression test: datasets that consist of multiple chunks, with an
+    // incomplete last chunk. Blocks that cover complete chunks are compressed
+    // by HDF5Tools itself, other blocks are compressed by the HDF5 library.
+    // Both should be transparent to readers.
+    std::vector< double > compressed_values(2500);
+    std::vector< CoordinateVector<> > compressed_vectors(2500);
+    for (uint_fast32_t i = 0; i < 2500; ++i) {
+      compressed_values[i] = std::sin(0.01 * i) * i;
+      compressed_vectors[i] = CoordinateVector<>(0.1 * i, std::cos(0.01 * i),
+                                                 compressed_values[i]);
+    }
+    std::vector< double > chunk_block1(compressed_values.begin(),
+                                       compressed_values.begin() + 2048);
+    std::vector< double > chunk_block2(compressed_values.begin() + 2048,
+                                       compressed_values.end());
+    HDF5Tools::create_dataset< double >(group, "CompressedChunkTest", 2500,
+                                        true, HDF5Tools::HDF5PRECISION_DOUBLE,
+                                        3, 1);
+    HDF5Tools::append_dataset(group, "CompressedChunkTest", 0, chunk_block1);
+    HDF5Tools::append_dataset(group, "CompressedChunkTest", 2048,
+                              chunk_block2);
+    std::vector< double > block1(compressed_values.begin(),
+                                 compressed_values.begin() + 1000);
+    std::vector< double > block2(compressed_values.begin() + 1000,
+                                 compressed_values.end());
+    HDF5Tools::create_dataset< double >(group, "CompressedBlockTest", 2500,
+                                        true);
+    HDF5Tools::append_dataset(group, "CompressedBlockTest", 0, block1);
+    HDF5Tools::append_dataset(group, "CompressedBlockTest", 1000, block2);
+    HDF5Tools::write_dataset(group, "CompressedVectorTest", compressed_vectors,
+                             true, 5);
+    HDF5Tools::create_dataset< double >(group, "CompressedFloat16Test", 2500,
+                                        true, HDF5Tools::HDF5PRECISION_FLOAT16);
+    HDF5Tools::append_dataset(group, "CompressedFloat16Test", 0,
+                              compressed_values);
+
     HDF5Tools::close_group(group);
 
     HDF5Tools::close_file(file);
@@ -312,6 +381,63 @@ int main(int argc, char **argv) {
       assert_condition(vblocktest[i].z() == 0.3 * icorr);
     }
 
+    std::vector< double > float32test =
+        HDF5Tools::read_dataset< double >(group, "Float32Test");
+    assert_condition(float32test[0] == float(1023.9360579714842));
+    assert_condition(float32test[1] == float(0.1));
+    assert_condition(float32test[2] == float(4095.229852245815));
+    assert_condition(float32test[3] == float(12.3456789));
+
+    std::vector< double > float16test =
+        HDF5Tools::read_dataset< double >(group, "Float16Test");
+    assert_condition(float16test[0] == 1024.);
+    assert_condition(float16test[1] == 0.0999755859375);
+    assert_condition(float16test[2] == 4096.);
+    assert_condition(float16test[3] == 12.34375);
+
+    std::vector< double > quantisedtest =
+        HDF5Tools::read_dataset< double >(group, "QuantisedTest");
+    assert_values_equal_tol(quantisedtest[0], 1023.94, 1.e-10);
+    assert_values_equal_tol(quantisedtest[1], 0.1, 1.e-10);
+    assert_values_equal_tol(quantisedtest[2], 4095.23, 1.e-10);
+    assert_values_equal_tol(quantisedtest[3], 12.35, 1.e-10);
+
+    std::vector< double > significanttest =
+        HDF5Tools::read_dataset< double >(group, "SignificantTest");
+    assert_condition(significanttest.size() == 2048);
+    for (uint_fast32_t i = 0; i < 2048; ++i) {
+      const double value =
+          std::pow(10., -8. + 12. * i / 2048.) * (1. + 0.1 * std::sin(1. * i));
+      assert_values_equal_rel(significanttest[i], value, 5.e-4);
+    }
+    assert_condition(HDF5Tools::round_to_significant_digits(1023.94, 3) ==
+                     1024.);
+    assert_condition(HDF5Tools::round_to_significant_digits(-0.1, 3) ==
+                     -0.0999755859375);
+
+    std::vector< double > compressedchunktest =
+        HDF5Tools::read_dataset< double >(group, "CompressedChunkTest");
+    std::vector< double > compressedblocktest =
+        HDF5Tools::read_dataset< double >(group, "CompressedBlockTest");
+    std::vector< CoordinateVector<> > compressedvectortest =
+        HDF5Tools::read_dataset< CoordinateVector<> >(group,
+                                                      "CompressedVectorTest");
+    std::vector< double > compressedfloat16test =
+        HDF5Tools::read_dataset< double >(group, "CompressedFloat16Test");
+    assert_condition(compressedchunktest.size() == 2500);
+    assert_condition(compressedblocktest.size() == 2500);
+    assert_condition(compressedvectortest.size() == 2500);
+    assert_condition(compressedfloat16test.size() == 2500);
+    for (uint_fast32_t i = 0; i < 2500; ++i) {
+      const double value = std::sin(0.01 * i) * i;
+      assert_condition(compressedchunktest[i] == value);
+      assert_condition(compressedblocktest[i] == value);
+      assert_condition(compressedvectortest[i].x() == 0.1 * i);
+      assert_condition(compressedvectortest[i].y() == std::cos(0.01 * i));
+      assert_condition(compressedvectortest[i].z() == value);
+      assert_values_equal_rel(compressedfloat16test[i], value, 1.e-3);
+    }
+
     HDF5Tools::close_group(group);
 
     HDF5Tools::close_file(file);
@@ -27,6 +27,7 @@
 #include "Assert.hpp"
 #include "HydroDensitySubGrid.hpp"
 
+#include <cmath>
 #include <fstream>
 
 /**
@@ -38,6 +39,218 @@
  */
 int main(int argc, char **argv) {
 
+  /// check that the vectorised pencil flux sweep gives exactly the same
+  /// result as calling Hydro::do_flux_calculation() for every interface
+  {
+    const double box[6] = {0., 0., 0., 1., 1., 1.};
+    const CoordinateVector< int_fast32_t > ncell(5, 6, 7);
+    HydroDensitySubGrid pencil_grid(box, ncell);
+    const Hydro hydro(5. / 3., 100., 1.e4, 1.e99, false);
+    for (auto cellit = pencil_grid.hydro_begin();
+         cellit != pencil_grid.hydro_end(); ++cellit) {
+      HydroVariables &variables = cellit.get_hydro_variables();
+      // make sure we have some vacuum cells
+      if (Utilities::random_double() < 0.05) {
+        variables.set_primitives_density(0.);
+      } else {
+        variables.set_primitives_density(0.1 + Utilities::random_double());
+      }
+      variables.set_primitives_velocity(
+          CoordinateVector<>(10. * (Utilities::random_double() - 0.5),
+                             10. * (Utilities::random_double() - 0.5),
+                             10. * (Utilities::random_double() - 0.5)));
+      variables.set_primitives_pressure(0.1 + Utilities::random_double());
+      for (uint_fast8_t q = 0; q < 5; ++q) {
+        variables.primitive_gradients(q) =
+            CoordinateVector<>(Utilities::random_double() - 0.5,
+                               Utilities::random_double() - 0.5,
+                               Utilities::random_double() - 0.5);
+      }
+    }
+    pencil_grid.initialize_hydrodynamic_variables(hydro, false);
+    HydroDensitySubGrid reference_grid(pencil_grid);
+
+    // a large time step, so that the flux limiter kicks in
+    const double pencil_dt = 0.1;
+    pencil_grid.inner_flux_sweep(hydro, pencil_dt);
+
+    const double dx = 1. / ncell.x();
+    const double dy = 1. / ncell.y();
+    const double dz = 1. / ncell.z();
+    const int_fast32_t nxstride = ncell.y() * ncell.z();
+    for (int_fast32_t ix = 0; ix < ncell.x() - 1; ++ix) {
+      for (int_fast32_t iy = 0; iy < ncell.y(); ++iy) {
+        for (int_fast32_t iz = 0; iz < ncell.z(); ++iz) {
+          const int_fast32_t index = ix * nxstride + iy * ncell.z() + iz;
+          hydro.do_flux_calculation(
+              0, (reference_grid.hydro_begin() + index).get_hydro_variables(),
+              (reference_grid.hydro_begin() + index + nxstride)
+                  .get_hydro_variables(),
+              dx, dy * dz, pencil_dt);
+        }
+      }
+    }
+    for (int_fast32_t ix = 0; ix < ncell.x(); ++ix) {
+      for (int_fast32_t iy = 0; iy < ncell.y() - 1; ++iy) {
+        for (int_fast32_t iz = 0; iz < ncell.z(); ++iz) {
+          const int_fast32_t index = ix * nxstride + iy * ncell.z() + iz;
+          hydro.do_flux_calculation(
+              1, (reference_grid.hydro_begin() + index).get_hydro_variables(),
+              (reference_grid.hydro_begin() + index + ncell.z())
+                  .get_hydro_variables(),
+              dy, dx * dz, pencil_dt);
+        }
+      }
+    }
+    for (int_fast32_t ix = 0; ix < ncell.x(); ++ix) {
+      for (int_fast32_t iy = 0; iy < ncell.y(); ++iy) {
+        for (int_fast32_t iz = 0; iz < ncell.z() - 1; ++iz) {
+          const int_fast32_t index = ix * nxstride + iy * ncell.z() + iz;
+          hydro.do_flux_calculation(
+              2, (reference_grid.hydro_begin() + index).get_hydro_variables(),
+              (reference_grid.hydro_begin() + index + 1).get_hydro_variables(),
+              dz, dx * dy, pencil_dt);
+        }
+      }
+    }
+
+    auto it = pencil_grid.hydro_begin();
+    auto it2 = reference_grid.hydro_begin();
+    while (it != pencil_grid.hydro_end()) {
+      for (uint_fast8_t q = 0; q < 5; ++q) {
+        assert_condition(it.get_hydro_variables().delta_conserved(q) ==
+                         it2.get_hydro_variables().delta_conserved(q));
+      }
+      ++it;
+      ++it2;
+    }
+  }
+
+  /// check that the fused hydro stages give exactly the same result as the
+  /// separate stages
+  {
+    const double box[6] = {0., 0., 0., 1., 1., 1.};
+    const CoordinateVector< int_fast32_t > ncell(4, 5, 6);
+    HydroDensitySubGrid fused_grid(box, ncell);
+    const Hydro hydro(5. / 3., 100., 1.e4, 1.e99, false);
+    for (auto cellit = fused_grid.hydro_begin();
+         cellit != fused_grid.hydro_end(); ++cellit) {
+      HydroVariables &variables = cellit.get_hydro_variables();
+      variables.set_primitives_density(0.1 + Utilities::random_double());
+      variables.set_primitives_velocity(
+          CoordinateVector<>(Utilities::random_double() - 0.5,
+                             Utilities::random_double() - 0.5,
+                             Utilities::random_double() - 0.5));
+      variables.set_primitives_pressure(0.1 + Utilities::random_double());
+    }
+    fused_grid.initialize_hydrodynamic_variables(hydro, false);
+    HydroDensitySubGrid staged_grid(fused_grid);
+
+    const double dt = 0.01;
+    fused_grid.inner_gradient_sweep(hydro);
+    fused_grid.limit_and_predict_primitive_variables(hydro, 0.5 * dt);
+    fused_grid.inner_flux_sweep(hydro, dt);
+    fused_grid.update_conserved_and_primitive_variables(hydro, dt);
+
+    staged_grid.inner_gradient_sweep(hydro);
+    staged_grid.apply_slope_limiter(hydro);
+    staged_grid.predict_primitive_variables(hydro, 0.5 * dt);
+    staged_grid.inner_flux_sweep(hydro, dt);
+    staged_grid.update_conserved_variables(dt);
+    staged_grid.update_primitive_variables(hydro);
+
+    auto it = fused_grid.hydro_begin();
+    auto it2 = staged_grid.hydro_begin();
+    while (it != fused_grid.hydro_end()) {
+      for (uint_fast8_t q = 0; q < 5; ++q) {
+        assert_condition(it.get_hydro_variables().primitives(q) ==
+                         it2.get_hydro_variables().primitives(q));
+        assert_condition(it.get_hydro_variables().conserved(q) ==
+                         it2.get_hydro_variables().conserved(q));
+      }
+      ++it;
+      ++it2;
+    }
+  }
+
+  /// check that the flux exchange between a coarse and a refined subgrid is
+  /// conservative, irrespective of the side from which it is done
+  {
+    const double coarse_box[6] = {0., 0., 0., 1., 1., 1.};
+    const double fine_box[6] = {1., 0., 0., 1., 1., 1.};
+    HydroDensitySubGrid coarse_grid(coarse_box,
+                                    CoordinateVector< int_fast32_t >(4));
+    HydroDensitySubGrid fine_grid(fine_box,
+                                  CoordinateVector< int_fast32_t >(8));
+    const Hydro hydro(5. / 3., 100., 1.e4, 1.e99, false);
+    HydroDensitySubGrid *grids[2] = {&coarse_grid, &fine_grid};
+    for (uint_fast8_t igrid = 0; igrid < 2; ++igrid) {
+      for (auto cellit = grids[igrid]->hydro_begin();
+           cellit != grids[igrid]->hydro_end(); ++cellit) {
+        HydroVariables &variables = cellit.get_hydro_variables();
+        variables.set_primitives_density(0.1 + Utilities::random_double());
+        variables.set_primitives_velocity(
+            CoordinateVector<>(Utilities::random_double() - 0.5,
+                               Utilities::random_double() - 0.5,
+                               Utilities::random_double() - 0.5));
+        variables.set_primitives_pressure(0.1 + Utilities::random_double());
+      }
+      grids[igrid]->initialize_hydrodynamic_variables(hydro, false);
+      grids[igrid]->inner_gradient_sweep(hydro);
+    }
+    coarse_grid.outer_gradient_sweep(TRAVELDIRECTION_FACE_X_P, hydro,
+                                     fine_grid);
+    coarse_grid.apply_slope_limiter(hydro);
+    fine_grid.apply_slope_limiter(hydro);
+
+    HydroDensitySubGrid coarse_grid2(coarse_grid);
+    HydroDensitySubGrid fine_grid2(fine_grid);
+
+    const double level_dt = 0.01;
+    coarse_grid.outer_flux_sweep(TRAVELDIRECTION_FACE_X_P, hydro, fine_grid,
+                                 level_dt);
+    fine_grid2.outer_flux_sweep(TRAVELDIRECTION_FACE_X_N, hydro, coarse_grid2,
+                                level_dt);
+
+    double total[5] = {0., 0., 0., 0., 0.};
+    double total2[5] = {0., 0., 0., 0., 0.};
+    double norm[5] = {0., 0., 0., 0., 0.};
+    HydroDensitySubGrid *all_grids[4] = {&coarse_grid, &fine_grid,
+                                         &coarse_grid2, &fine_grid2};
+    for (uint_fast8_t igrid = 0; igrid < 4; ++igrid) {
+      for (auto cellit = all_grids[igrid]->hydro_begin();
+           cellit != all_grids[igrid]->hydro_end(); ++cellit) {
+        for (uint_fast8_t q = 0; q < 5; ++q) {
+          const double dq = cellit.get_hydro_variables().delta_conserved(q);
+          if (igrid < 2) {
+            total[q] += dq;
+          } else {
+            total2[q] += dq;
+          }
+          norm[q] += std::abs(dq);
+        }
+      }
+    }
+    for (uint_fast8_t q = 0; q < 5; ++q) {
+      assert_condition(norm[q] > 0.);
+      assert_condition(std::abs(total[q]) < 1.e-13 * norm[q]);
+      assert_condition(std::abs(total2[q]) < 1.e-13 * norm[q]);
+    }
+
+    // both sides give the same fluxes
+    auto it = coarse_grid.hydro_begin();
+    auto it2 = coarse_grid2.hydro_begin();
+    while (it != coarse_grid.hydro_end()) {
+      for (uint_fast8_t q = 0; q < 5; ++q) {
+        assert_values_equal_rel(it.get_hydro_variables().delta_conserved(q),
+                                it2.get_hydro_variables().delta_conserved(q),
+                                1.e-12);
+      }
+      ++it;
+      ++it2;
+    }
+  }
+
   const double box1[6] = {-0.5, -0.25, -0.25, 0.5, 0.5, 0.5};
   const double box2[6] = {0., -0.25, -0.25, 0.5, 0.5, 0.5};
   const CoordinateVector< int_fast32_t > ncell(50, 3, 3);
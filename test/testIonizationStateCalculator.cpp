@@ -35,6 +35,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 /**
  * @brief Unit test for the IonizationStateCalculator class.
@@ -63,6 +64,10 @@ int main(int argc, char **argv) {
   cell.get_ionization_variables().get_abundances().set_abundances(abundances);
 #endif
 
+  // input and output values for the batched calculation test
+  std::vector< IonizationVariables > batch_input;
+  std::vector< IonizationVariables > batch_reference;
+
   // test find_H0
   std::ifstream file("h0_testdata.txt");
   std::string line;
@@ -132,10 +137,14 @@ int main(int argc, char **argv) {
         UnitConverter::to_SI< QUANTITY_NUMBER_DENSITY >(ntot, "cm^-3"));
     ionization_variables.set_temperature(T);
 
+    batch_input.push_back(ionization_variables);
+
     // calculate the ionization state of the cell
     calculator.calculate_ionization_state(1., 1.,
                                           cell.get_ionization_variables());
 
+    batch_reference.push_back(ionization_variables);
+
     h0 = ionization_variables.get_ionic_fraction(ION_H_n);
 
     he0 = ionization_variables.get_ionic_fraction(ION_He_n);
@@ -218,6 +227,46 @@ int main(int argc, char **argv) {
         UnitConverter::to_SI< QUANTITY_NUMBER_DENSITY >(ntot, "cm^-3"));
     assert_values_equal_tol(h0, h0s, 1.e-4);
   }
+
+  // add a neutral and a vacuum cell
+  batch_input.push_back(batch_input[0]);
+  batch_input.back().set_mean_intensity(ION_H_n, 0.);
+  batch_input.push_back(batch_input[0]);
+  batch_input.back().set_number_density(0.);
+  for (uint_fast32_t i = batch_input.size() - 2; i < batch_input.size(); ++i) {
+    batch_reference.push_back(batch_input[i]);
+    calculator.calculate_ionization_state(1., 1., batch_reference.back());
+  }
+
+  // the batched calculation should give exactly the same result as the
+  // scalar calculation
+  for (uint_fast32_t ibatch = 0; ibatch < batch_input.size();
+       ibatch += IONIZATIONSTATECALCULATOR_BATCH_SIZE) {
+    const uint_fast32_t number_of_cells =
+        std::min< uint_fast32_t >(IONIZATIONSTATECALCULATOR_BATCH_SIZE,
+                                  batch_input.size() - ibatch);
+    double jfac[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    double hfac[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    IonizationVariables *variables[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+    for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+      jfac[i] = 1.;
+      hfac[i] = 1.;
+      variables[i] = &batch_input[ibatch + i];
+    }
+    calculator.calculate_ionization_state_batch(number_of_cells, jfac, hfac,
+                                                variables);
+  }
+  for (uint_fast32_t i = 0; i < batch_input.size(); ++i) {
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      assert_condition(batch_input[i].get_ionic_fraction(ion) ==
+                       batch_reference[i].get_ionic_fraction(ion));
+    }
+    for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
+         ++heating) {
+      assert_condition(batch_input[i].get_heating(heating) ==
+                       batch_reference[i].get_heating(heating));
+    }
+  }
 #endif
 
   return 0;
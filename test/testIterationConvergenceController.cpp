@@ -0,0 +1,159 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testIterationConvergenceController.cpp
+ *
+ * @brief Unit test for the IterationConvergenceController class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "DensitySubGridCreator.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "IterationConvergenceController.hpp"
+#include "SpatialAMRRefinementScheme.hpp"
+
+/**
+ * @brief Add a homogeneous grid with the given neutral fraction and
+ * temperature to the given controller.
+ *
+ * @param controller IterationConvergenceController.
+ * @param neutral_fraction Neutral fraction for all cells.
+ * @param temperature Temperature for all cells (in K).
+ */
+void add_grid(IterationConvergenceController &controller,
+              const double neutral_fraction, const double temperature) {
+  for (uint_fast32_t i = 0; i < 100; ++i) {
+    controller.add_cell(i, 1., neutral_fraction, temperature);
+  }
+}
+
+/**
+ * @brief Unit test for the IterationConvergenceController class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// increasing the number of photons and convergence
+  {
+    IterationConvergenceController controller(100, 1.e-3, 3, 100, 10000);
+
+    // no estimate for the first iteration
+    add_grid(controller, 0.5, 8000.);
+    assert_condition(controller.end_iteration(0, 1000) == 1000);
+    assert_condition(!controller.has_converged());
+    assert_condition(controller.get_noise() < 0.);
+
+    // large, systematic change: we keep the number of photons
+    add_grid(controller, 0.49, 8000.);
+    assert_condition(controller.end_iteration(1, 1000) == 1000);
+    assert_condition(!controller.has_converged());
+    assert_values_equal_rel(controller.get_noise(), 0.01 / std::sqrt(2.),
+                            1.e-10);
+
+    // the change no longer decreases: noise dominated, so we increase the
+    // number of photons as much as allowed
+    add_grid(controller, 0.482, 8000.);
+    assert_condition(controller.end_iteration(2, 1000) == 4000);
+    assert_condition(!controller.has_converged());
+
+    // the temperature change is taken into account as well
+    add_grid(controller, 0.482, 8080.);
+    assert_condition(controller.end_iteration(3, 4000) == 10000);
+    assert_condition(!controller.has_converged());
+
+    // small change: converged
+    add_grid(controller, 0.4821, 8080.);
+    assert_condition(controller.end_iteration(4, 10000) == 10000);
+    assert_condition(controller.has_converged());
+  }
+
+  /// decreasing the number of photons and minimum number of iterations
+  {
+    IterationConvergenceController controller(100, 0.1, 3, 600, 10000);
+
+    add_grid(controller, 0.5, 8000.);
+    assert_condition(controller.end_iteration(0, 1000) == 1000);
+
+    // the change is below the tolerance, but we did not do enough iterations
+    // yet; the noise is well below the target, so we use fewer photons
+    add_grid(controller, 0.49, 8000.);
+    assert_condition(controller.end_iteration(1, 1000) == 600);
+    assert_condition(!controller.has_converged());
+
+    add_grid(controller, 0.489, 8000.);
+    controller.end_iteration(2, 600);
+    assert_condition(controller.has_converged());
+  }
+
+  /// refined grid: 2 subgrids of 8 cells, the second one is refined once, so
+  /// that the grid contains 8 + 64 = 72 cells. The cell indices should be
+  /// unique and cover the entire grid.
+  {
+    DensitySubGridCreator< DensitySubGrid > grid_creator(
+        Box<>(CoordinateVector<>(0.), CoordinateVector<>(1.)),
+        CoordinateVector< int_fast32_t >(4, 2, 2),
+        CoordinateVector< int_fast32_t >(2, 1, 1),
+        CoordinateVector< bool >(false), 1);
+    HomogeneousDensityFunction density_function;
+    SpatialAMRRefinementScheme refinement_scheme(
+        Box<>(CoordinateVector<>(0.6, 0., 0.), CoordinateVector<>(0.4, 1., 1.)),
+        1);
+    grid_creator.initialize(density_function, &refinement_scheme);
+    assert_condition(grid_creator.get_refinement_level(0) == 0);
+    assert_condition(grid_creator.get_refinement_level(1) == 1);
+    assert_condition(grid_creator.number_of_cells() == 72);
+
+    const std::vector< uint_fast64_t > cell_offsets =
+        grid_creator.get_cell_offsets();
+    assert_condition(cell_offsets.size() == 2);
+    assert_condition(cell_offsets[0] == 0);
+    assert_condition(cell_offsets[1] == 8);
+
+    IterationConvergenceController controller(grid_creator.number_of_cells(),
+                                              1.e-3, 3, 100, 10000);
+    for (uint_fast32_t iteration = 0; iteration < 2; ++iteration) {
+      std::vector< bool > cell_seen(grid_creator.number_of_cells(), false);
+      for (auto gridit = grid_creator.begin();
+           gridit != grid_creator.original_end(); ++gridit) {
+        // during the second iteration, only the refined subgrid changes
+        const double neutral_fraction =
+            (iteration == 1 && gridit.get_index() == 1) ? 0.4 : 0.5;
+        const uint_fast64_t offset = cell_offsets[gridit.get_index()];
+        for (auto cellit = (*gridit).begin(); cellit != (*gridit).end();
+             ++cellit) {
+          const uint_fast64_t index = offset + cellit.get_index();
+          assert_condition(index < grid_creator.number_of_cells());
+          assert_condition(!cell_seen[index]);
+          cell_seen[index] = true;
+          controller.add_cell(index, 1., neutral_fraction, 8000.);
+        }
+      }
+      controller.end_iteration(iteration, 1000);
+    }
+    // 64 out of 72 cells changed by 0.1
+    assert_values_equal_rel(controller.get_noise(),
+                            64. * 0.1 / 72. / std::sqrt(2.), 1.e-10);
+  }
+
+  return 0;
+}
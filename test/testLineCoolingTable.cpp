@@ -0,0 +1,149 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testLineCoolingTable.cpp
+ *
+ * @brief Unit test for the LineCoolingTable class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "LineCoolingData.hpp"
+#include "LineCoolingTable.hpp"
+#include "RandomGenerator.hpp"
+
+#include <vector>
+
+/**
+ * @brief Unit test for the LineCoolingTable class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  LineCoolingData line_cooling_data;
+  RandomGenerator random_generator(42);
+
+  const double minimum_temperature = 500.;
+  const double maximum_temperature = 1.e5;
+  const double minimum_electron_density = 1.e4;
+  const double maximum_electron_density = 1.e14;
+
+  const double tolerances[2] = {1.e-1, 1.e-2};
+  for (uint_fast8_t itol = 0; itol < 2; ++itol) {
+    const double tolerance = tolerances[itol];
+    LineCoolingTable table(line_cooling_data, minimum_temperature,
+                           maximum_temperature, minimum_electron_density,
+                           maximum_electron_density, tolerance, 257);
+
+    // check random temperatures and electron densities in and just outside the
+    // tabulated range, for random abundances
+    for (uint_fast32_t i = 0; i < 10000; ++i) {
+      const double T =
+          0.9 * minimum_temperature *
+          std::pow(1.2 * maximum_temperature / minimum_temperature,
+                   random_generator.get_uniform_random_double());
+      const double ne =
+          0.9 * minimum_electron_density *
+          std::pow(1.2 * maximum_electron_density / minimum_electron_density,
+                   random_generator.get_uniform_random_double());
+      double abundances[LINECOOLINGDATA_NUMELEMENTS];
+      for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+        abundances[j] = 1.e-4 * random_generator.get_uniform_random_double();
+      }
+      const double exact = line_cooling_data.get_cooling(T, ne, abundances);
+      const double tabulated = table.get_cooling(T, ne, abundances);
+      // the tolerance is only guaranteed in the middle of each interval and
+      // cell, so we allow for a somewhat larger error elsewhere
+      assert_condition(std::abs(tabulated - exact) <=
+                       2. * tolerance * std::abs(exact));
+    }
+  }
+
+  // values outside the table and zero electron densities need to be exact
+  LineCoolingTable table(line_cooling_data, minimum_temperature,
+                         maximum_temperature, minimum_electron_density,
+                         maximum_electron_density, 1.e-1, 257);
+  double abundances[LINECOOLINGDATA_NUMELEMENTS];
+  for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+    abundances[j] = 1.e-4;
+  }
+  assert_condition(table.get_cooling(1.e4, 0., abundances) ==
+                   line_cooling_data.get_cooling(1.e4, 0., abundances));
+  assert_condition(table.get_cooling(100., 1.e8, abundances) ==
+                   line_cooling_data.get_cooling(100., 1.e8, abundances));
+  assert_condition(table.get_cooling(1.e4, 1.e16, abundances) ==
+                   line_cooling_data.get_cooling(1.e4, 1.e16, abundances));
+
+  // the batched lookup should give exactly the same result as the single cell
+  // lookup, both inside and outside the table (we use more cells than fit in
+  // a single batch)
+  const uint_fast32_t number_of_cells = 2 * LINECOOLINGTABLE_BATCH_SIZE + 3;
+  std::vector< double > batch_T(number_of_cells);
+  std::vector< double > batch_ne(number_of_cells);
+  std::vector< double > batch_cooling(number_of_cells);
+  double batch_abundances[number_of_cells][LINECOOLINGDATA_NUMELEMENTS];
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    batch_T[i] = 0.9 * minimum_temperature *
+                 std::pow(1.2 * maximum_temperature / minimum_temperature,
+                          random_generator.get_uniform_random_double());
+    batch_ne[i] =
+        0.9 * minimum_electron_density *
+        std::pow(1.2 * maximum_electron_density / minimum_electron_density,
+                 random_generator.get_uniform_random_double());
+    for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+      batch_abundances[i][j] =
+          1.e-4 * random_generator.get_uniform_random_double();
+    }
+  }
+  batch_ne[0] = 0.;
+  table.get_cooling(number_of_cells, batch_T.data(), batch_ne.data(),
+                    batch_abundances, batch_cooling.data());
+  for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+    assert_condition(
+        batch_cooling[i] ==
+        table.get_cooling(batch_T[i], batch_ne[i], batch_abundances[i]));
+  }
+
+  // a stricter tolerance needs a finer table
+  LineCoolingTable coarse(line_cooling_data, minimum_temperature,
+                          maximum_temperature, minimum_electron_density,
+                          maximum_electron_density, 1.e-1, 257);
+  LineCoolingTable fine(line_cooling_data, minimum_temperature,
+                        maximum_temperature, minimum_electron_density,
+                        maximum_electron_density, 1.e-2, 257);
+  assert_condition(coarse.get_number_of_temperatures() *
+                       coarse.get_number_of_electron_densities() <
+                   fine.get_number_of_temperatures() *
+                       fine.get_number_of_electron_densities());
+
+  // rates below the cooling rate floor only need to be accurate relative to
+  // the floor: a floor above all cooling rates means no refinement is needed
+  LineCoolingTable floored(line_cooling_data, minimum_temperature,
+                           maximum_temperature, minimum_electron_density,
+                           maximum_electron_density, 1.e-2, 257, 1.e-10);
+  assert_condition(floored.get_number_of_temperatures() *
+                       floored.get_number_of_electron_densities() <
+                   coarse.get_number_of_temperatures() *
+                       coarse.get_number_of_electron_densities());
+
+  return 0;
+}
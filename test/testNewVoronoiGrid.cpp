@@ -1300,5 +1300,57 @@ int main(int argc, char **argv) {
         timer.value(), time_per_cell);
   }
 
+  /// test incremental NewVoronoiGrid update
+  {
+    const uint_fast32_t ncell = 1000;
+    std::vector< CoordinateVector<> > positions(ncell);
+    for (uint_fast32_t i = 0; i < ncell; ++i) {
+      positions[i] =
+          CoordinateVector<>(0.1) + 0.8 * Utilities::random_position();
+    }
+
+    Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+    NewVoronoiGrid grid(positions, box);
+    grid.compute_grid();
+
+    // move part of the generators, first some of them over a large distance,
+    // then a different subset by a tiny amount: every move, however small,
+    // needs to be picked up by the update
+    for (uint_fast32_t iround = 0; iround < 2; ++iround) {
+      const double displacement = (iround == 0) ? 0.02 : 1.e-7;
+      for (uint_fast32_t i = iround; i < ncell; i += 7) {
+        positions[i] += displacement * (Utilities::random_position() -
+                                        CoordinateVector<>(0.5));
+      }
+      if (iround == 0) {
+        positions[42] = CoordinateVector<>(0.5);
+      }
+      assert_condition(grid.update_grid());
+
+      std::vector< CoordinateVector<> > reference_positions(positions);
+      NewVoronoiGrid reference_grid(reference_positions, box);
+      reference_grid.compute_grid();
+
+      double total_volume = 0.;
+      for (uint_fast32_t i = 0; i < ncell; ++i) {
+        assert_values_equal_rel(grid.get_volume(i),
+                                reference_grid.get_volume(i), 1.e-12);
+        const CoordinateVector<> centroid = grid.get_centroid(i);
+        const CoordinateVector<> reference_centroid =
+            reference_grid.get_centroid(i);
+        assert_values_equal_rel(centroid.x(), reference_centroid.x(), 1.e-12);
+        assert_values_equal_rel(centroid.y(), reference_centroid.y(), 1.e-12);
+        assert_values_equal_rel(centroid.z(), reference_centroid.z(), 1.e-12);
+        assert_condition(grid.get_faces(i).size() ==
+                         reference_grid.get_faces(i).size());
+        total_volume += grid.get_volume(i);
+        assert_condition(grid.get_index(positions[i]) == i);
+      }
+      assert_values_equal_rel(total_volume, 1., 1.e-12);
+    }
+
+    cmac_status("Incremental grid update works!");
+  }
+
   return 0;
 }
@@ -79,6 +79,7 @@ int main(int argc, char **argv) {
                            random_generator.get_uniform_random_double(),
                            random_generator.get_uniform_random_double()));
     photon.set_weight(random_generator.get_uniform_random_double());
+    photon.set_stream_index(random_generator.get_random_integer());
     photon.set_target_optical_depth(
         random_generator.get_uniform_random_double());
   }
@@ -83,5 +83,136 @@ int main(int argc, char **argv) {
     }
   }
 
+  /// Philox known answer test (Random123 kat_vectors)
+  {
+    uint32_t output[4];
+
+    const uint32_t counter_zero[4] = {0, 0, 0, 0};
+    const uint32_t key_zero[2] = {0, 0};
+    RandomGenerator::get_philox_block(counter_zero, key_zero, output);
+    assert_condition(output[0] == 0x6627e8d5u);
+    assert_condition(output[1] == 0xe169c58du);
+    assert_condition(output[2] == 0xbc57ac4cu);
+    assert_condition(output[3] == 0x9b00dbd8u);
+
+    const uint32_t counter_max[4] = {0xffffffffu, 0xffffffffu, 0xffffffffu,
+                                     0xffffffffu};
+    const uint32_t key_max[2] = {0xffffffffu, 0xffffffffu};
+    RandomGenerator::get_philox_block(counter_max, key_max, output);
+    assert_condition(output[0] == 0x408f276du);
+    assert_condition(output[1] == 0x41c83b0eu);
+    assert_condition(output[2] == 0xa20bc7c6u);
+    assert_condition(output[3] == 0x6d5451fdu);
+
+    const uint32_t counter_pi[4] = {0x243f6a88u, 0x85a308d3u, 0x13198a2eu,
+                                    0x03707344u};
+    const uint32_t key_pi[2] = {0xa4093822u, 0x299f31d0u};
+    RandomGenerator::get_philox_block(counter_pi, key_pi, output);
+    assert_condition(output[0] == 0xd16cfe09u);
+    assert_condition(output[1] == 0x94fdccebu);
+    assert_condition(output[2] == 0x5001e420u);
+    assert_condition(output[3] == 0x24126ea1u);
+  }
+
+  /// Philox basic test
+  {
+    RandomGenerator generator(42, RANDOMGENERATORTYPE_PHILOX);
+
+    double mean_random = 0.;
+    uint_fast32_t num = 1000000;
+    double weight = 1. / num;
+    for (uint_fast32_t i = 0; i < num; ++i) {
+      const double x = generator.get_uniform_random_double();
+      assert_condition(x > 0. && x < 1.);
+      mean_random += weight * x;
+    }
+    assert_values_equal_tol(mean_random, 0.5, 1.e-3);
+  }
+
+  /// Philox stream test: streams only depend on the seed and stream arguments
+  {
+    RandomGenerator generator_A(42, RANDOMGENERATORTYPE_PHILOX);
+    RandomGenerator generator_B(42, RANDOMGENERATORTYPE_PHILOX);
+
+    // advance generator B to make sure its history does not matter
+    for (uint_fast32_t i = 0; i < 1001; ++i) {
+      generator_B.get_uniform_random_double();
+    }
+    generator_B.set_stream(3, RandomGenerator::get_stream_index(1, 7), 2);
+    generator_B.get_uniform_random_double();
+
+    generator_A.set_stream(3, RandomGenerator::get_stream_index(1, 7), 2);
+    generator_B.set_stream(3, RandomGenerator::get_stream_index(1, 7), 2);
+    for (uint_fast32_t i = 0; i < 100; ++i) {
+      assert_condition(generator_A.get_uniform_random_double() ==
+                       generator_B.get_uniform_random_double());
+    }
+
+    // changing any of the stream arguments should change the stream
+    generator_A.set_stream(3, RandomGenerator::get_stream_index(1, 7), 2);
+    const double reference = generator_A.get_uniform_random_double();
+    generator_B.set_stream(4, RandomGenerator::get_stream_index(1, 7), 2);
+    assert_condition(generator_B.get_uniform_random_double() != reference);
+    generator_B.set_stream(3, RandomGenerator::get_stream_index(2, 7), 2);
+    assert_condition(generator_B.get_uniform_random_double() != reference);
+    generator_B.set_stream(3, RandomGenerator::get_stream_index(1, 8), 2);
+    assert_condition(generator_B.get_uniform_random_double() != reference);
+    generator_B.set_stream(3, RandomGenerator::get_stream_index(1, 7), 3);
+    assert_condition(generator_B.get_uniform_random_double() != reference);
+    RandomGenerator generator_C(43, RANDOMGENERATORTYPE_PHILOX);
+    generator_C.set_stream(3, RandomGenerator::get_stream_index(1, 7), 2);
+    assert_condition(generator_C.get_uniform_random_double() != reference);
+  }
+
+  /// bulk generation test: bulk generation should give the same values as
+  /// individual draws
+  {
+    const RandomGeneratorType types[2] = {RANDOMGENERATORTYPE_RANLUX,
+                                          RANDOMGENERATORTYPE_PHILOX};
+    for (uint_fast8_t itype = 0; itype < 2; ++itype) {
+      RandomGenerator generator_A(42, types[itype]);
+      RandomGenerator generator_B(42, types[itype]);
+
+      double values[101];
+      // odd sizes make sure we test the buffered second value of a block
+      const size_t sizes[4] = {1, 101, 0, 100};
+      for (uint_fast8_t isize = 0; isize < 4; ++isize) {
+        generator_A.get_uniform_random_doubles(values, sizes[isize]);
+        for (size_t i = 0; i < sizes[isize]; ++i) {
+          assert_condition(values[i] ==
+                           generator_B.get_uniform_random_double());
+        }
+      }
+    }
+  }
+
+  /// Philox restart test
+  {
+    RandomGenerator generator_A(42, RANDOMGENERATORTYPE_PHILOX);
+    generator_A.set_stream(2, 5, 1);
+
+    // odd number of draws: the buffered value needs to be restarted as well
+    double sum = 0.;
+    for (uint_fast32_t i = 0; i < 1001; ++i) {
+      sum += generator_A.get_uniform_random_double();
+    }
+
+    {
+      RestartWriter restart_writer("randomgenerator_philox.dump");
+      generator_A.write_restart_file(restart_writer);
+    }
+
+    {
+      RestartReader restart_reader("randomgenerator_philox.dump");
+      RandomGenerator generator_B(restart_reader);
+
+      assert_condition(generator_B.get_type() == RANDOMGENERATORTYPE_PHILOX);
+      for (uint_fast32_t i = 0; i < 1e3; ++i) {
+        assert_condition(generator_A.get_uniform_random_double() ==
+                         generator_B.get_uniform_random_double());
+      }
+    }
+  }
+
   return 0;
 }
@@ -30,6 +30,9 @@
 #include "SPHArrayInterface.hpp"
 #include "Utilities.hpp"
 
+#include <cstdio>
+#include <fstream>
+
 /**
  * @brief Test DensityFunction.
  */
@@ -201,5 +204,158 @@ int main(int argc, char **argv) {
     //    }
   }
 
+  /// scatter mapping
+  {
+    std::vector< double > x(1000, 0.);
+    std::vector< double > y(1000, 0.);
+    std::vector< double > z(1000, 0.);
+    std::vector< double > h(1000, 0.);
+    std::vector< double > m(1000, 0.);
+    for (size_t i = 0; i < 1000; ++i) {
+      x[i] = Utilities::random_double();
+      y[i] = Utilities::random_double();
+      z[i] = Utilities::random_double();
+      h[i] = 0.1 + 0.1 * Utilities::random_double();
+      m[i] = 0.001;
+    }
+
+    interface.reset(x.data(), y.data(), z.data(), h.data(), m.data(), 1000);
+    interface.initialize();
+    grid.initialize(block, interface);
+
+    // reuse the gridding table of the gather interface
+    std::remove("test_SPH_array_scatter.cache");
+    interface.write_gridding_cache("test_SPH_array_scatter.cache");
+    SPHArrayInterface scatter_interface(1., 1., "Petkova_scatter",
+                                        "test_SPH_array_scatter.cache");
+    const double box_anchor[3] = {0., 0., 0.};
+    const double box_sides[3] = {1., 1., 1.};
+    SPHArrayInterface periodic_interface(1., 1., box_anchor, box_sides,
+                                         "Petkova",
+                                         "test_SPH_array_scatter.cache");
+    SPHArrayInterface periodic_scatter_interface(
+        1., 1., box_anchor, box_sides, "Petkova_scatter",
+        "test_SPH_array_scatter.cache");
+    std::remove("test_SPH_array_scatter.cache");
+    scatter_interface.reset(x.data(), y.data(), z.data(), h.data(), m.data(),
+                            1000);
+    scatter_interface.initialize();
+    CartesianDensityGrid scatter_grid(box, 16);
+    scatter_grid.initialize(block, scatter_interface);
+
+    // both mappings find the same particle-cell pairs, so the cell densities
+    // should only differ because of round off
+    cmac_status("Ntot: %g (gather), %g (scatter).",
+                grid.get_total_hydrogen_number(),
+                scatter_grid.get_total_hydrogen_number());
+    assert_values_equal_rel(scatter_grid.get_total_hydrogen_number(),
+                            grid.get_total_hydrogen_number(), 1.e-12);
+    for (auto it = grid.begin(), scatter_it = scatter_grid.begin();
+         it != grid.end(); ++it, ++scatter_it) {
+      assert_values_equal_rel(
+          scatter_it.get_ionization_variables().get_number_density(),
+          it.get_ionization_variables().get_number_density(), 1.e-12);
+    }
+
+    // the same should be true for a periodic box. The grid has more cells than
+    // the scatter mapping processes at once, so that cells in different
+    // sub-blocks are covered as well
+    periodic_interface.reset(x.data(), y.data(), z.data(), h.data(), m.data(),
+                             1000);
+    periodic_interface.initialize();
+    CartesianDensityGrid periodic_grid(box, 16);
+    periodic_grid.initialize(block, periodic_interface);
+    periodic_scatter_interface.reset(x.data(), y.data(), z.data(), h.data(),
+                                     m.data(), 1000);
+    periodic_scatter_interface.initialize();
+    CartesianDensityGrid periodic_scatter_grid(box, 16);
+    periodic_scatter_grid.initialize(block, periodic_scatter_interface);
+    assert_condition(periodic_grid.get_number_of_cells() >
+                     SPHARRAYINTERFACE_SCATTER_BLOCK_SIZE);
+    cmac_status("Ntot: %g (periodic gather), %g (periodic scatter).",
+                periodic_grid.get_total_hydrogen_number(),
+                periodic_scatter_grid.get_total_hydrogen_number());
+    for (auto it = periodic_grid.begin(),
+              scatter_it = periodic_scatter_grid.begin();
+         it != periodic_grid.end(); ++it, ++scatter_it) {
+      assert_values_equal_rel(
+          scatter_it.get_ionization_variables().get_number_density(),
+          it.get_ionization_variables().get_number_density(), 1.e-12);
+    }
+
+    // changing only the masses reuses the existing Octree
+    const Octree *octree = periodic_interface.get_octree();
+    std::vector< double > m_double(1000, 0.002);
+    periodic_interface.update_particles(0, x.data(), y.data(), z.data(),
+                                        h.data(), m_double.data(), 1000);
+    periodic_interface.initialize();
+    assert_condition(periodic_interface.get_octree() == octree);
+    CartesianDensityGrid periodic_grid_double(box, 16);
+    periodic_grid_double.initialize(block, periodic_interface);
+    assert_values_equal_rel(periodic_grid_double.get_total_hydrogen_number(),
+                            2. * periodic_grid.get_total_hydrogen_number(),
+                            1.e-12);
+
+    // moving a particle changes the density field again
+    const double old_x = x[0];
+    x[0] = 0.5 * x[0] + 0.25;
+    periodic_interface.update_particles(0, x.data(), y.data(), z.data(),
+                                        h.data(), m.data(), 1);
+    periodic_interface.initialize();
+    x[0] = old_x;
+    periodic_interface.update_particles(0, x.data(), y.data(), z.data(),
+                                        h.data(), m.data(), 1000);
+    periodic_interface.initialize();
+    CartesianDensityGrid periodic_grid_reset(box, 16);
+    periodic_grid_reset.initialize(block, periodic_interface);
+    for (auto it = periodic_grid.begin(),
+              reset_it = periodic_grid_reset.begin();
+         it != periodic_grid.end(); ++it, ++reset_it) {
+      assert_values_equal_rel(
+          reset_it.get_ionization_variables().get_number_density(),
+          it.get_ionization_variables().get_number_density(), 1.e-12);
+    }
+  }
+
+  /// gridding table cache
+  {
+    std::remove("test_SPH_array_gridding.cache");
+    interface.write_gridding_cache("test_SPH_array_gridding.cache");
+
+    // the cached table should be mapped and be identical to the computed one
+    SPHArrayInterface cached_interface(1., 1., "Petkova",
+                                       "test_SPH_array_gridding.cache");
+    for (uint_fast32_t i = 0; i < SPHARRAYINTERFACE_GRIDDING_SIZE_R; ++i) {
+      for (uint_fast32_t j = 0; j < SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE;
+           ++j) {
+        for (uint_fast32_t k = 0; k < SPHARRAYINTERFACE_GRIDDING_SIZE_ANGLE;
+             ++k) {
+          assert_condition(cached_interface.get_gridded_density_value(i, j,
+                                                                      k) ==
+                           interface.get_gridded_density_value(i, j, k));
+        }
+      }
+    }
+
+    // a corrupted cache file should be rejected
+    SPHArrayInterface other_interface(1., 1., "M_over_V");
+    assert_condition(
+        other_interface.read_gridding_cache("test_SPH_array_gridding.cache"));
+    {
+      std::fstream file("test_SPH_array_gridding.cache",
+                        std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(1000);
+      const double corrupt_value = 42.;
+      file.write(reinterpret_cast< const char * >(&corrupt_value),
+                 sizeof(double));
+    }
+    SPHArrayInterface corrupt_interface(1., 1., "M_over_V");
+    assert_condition(!corrupt_interface.read_gridding_cache(
+        "test_SPH_array_gridding.cache"));
+    assert_condition(
+        !corrupt_interface.read_gridding_cache("nonexistent_file.cache"));
+    std::remove("test_SPH_array_gridding.cache");
+  }
+
   return 0;
 }
@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testScheduler.cpp
+ *
+ * @brief Unit test for the Scheduler class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "Scheduler.hpp"
+
+/*! @brief Number of thread queues used during the test. */
+#define TESTSCHEDULER_NQUEUE 4
+
+/**
+ * @brief Minimal subgrid that only has an owner and neighbours.
+ */
+class TestSubgrid {
+public:
+  /*! @brief Owning thread. */
+  int_fast32_t _owner;
+
+  /*! @brief Neighbours. */
+  uint_fast32_t _ngbs[TRAVELDIRECTION_NUMBER];
+
+  /**
+   * @brief Get the owning thread.
+   *
+   * @return Owning thread.
+   */
+  inline int_fast32_t get_owning_thread() const { return _owner; }
+
+  /**
+   * @brief Get the neighbour in the given direction.
+   *
+   * @param direction TravelDirection.
+   * @return Neighbour index.
+   */
+  inline uint_fast32_t get_neighbour(const int_fast32_t direction) const {
+    return _ngbs[direction];
+  }
+};
+
+/**
+ * @brief Minimal grid creator: a 1D chain of 4 subgrids owned by threads
+ * 0, 2, 3 and 1.
+ */
+class TestGridCreator {
+public:
+  /*! @brief Subgrids. */
+  TestSubgrid _subgrids[TESTSCHEDULER_NQUEUE];
+
+  /**
+   * @brief Constructor.
+   */
+  TestGridCreator() {
+    const int_fast32_t owners[TESTSCHEDULER_NQUEUE] = {0, 2, 3, 1};
+    for (uint_fast32_t i = 0; i < TESTSCHEDULER_NQUEUE; ++i) {
+      _subgrids[i]._owner = owners[i];
+      for (int_fast32_t j = 0; j < TRAVELDIRECTION_NUMBER; ++j) {
+        _subgrids[i]._ngbs[j] = 0xffffffff;
+      }
+      if (i > 0) {
+        _subgrids[i]._ngbs[TRAVELDIRECTION_FACE_X_N] = i - 1;
+      }
+      if (i < TESTSCHEDULER_NQUEUE - 1) {
+        _subgrids[i]._ngbs[TRAVELDIRECTION_FACE_X_P] = i + 1;
+      }
+    }
+  }
+
+  /**
+   * @brief Get the number of original subgrids.
+   *
+   * @return Number of subgrids.
+   */
+  inline uint_fast32_t number_of_original_subgrids() const {
+    return TESTSCHEDULER_NQUEUE;
+  }
+
+  /**
+   * @brief Check if the subgrid with the given index is stored locally.
+   *
+   * @param index Index.
+   * @return True, since the test grid is not distributed.
+   */
+  inline bool is_local(const uint_fast32_t index) const { return true; }
+
+  /**
+   * @brief Get the subgrid with the given index.
+   *
+   * @param index Index.
+   * @return Pointer to the subgrid.
+   */
+  inline TestSubgrid *get_subgrid(const uint_fast32_t index) {
+    return &_subgrids[index];
+  }
+};
+
+/**
+ * @brief Fill the given queues with one task for queues 1 and 3 and two tasks
+ * for queue 2 (queue 0 is left empty).
+ *
+ * The task buffer variable is set to the index of the queue.
+ *
+ * @param tasks Task space.
+ * @param queues Queues.
+ */
+void fill_queues(ThreadSafeVector< Task > &tasks,
+                 std::vector< TaskQueue * > &queues) {
+  const uint_fast32_t queue_indices[4] = {1, 2, 2, 3};
+  for (uint_fast32_t i = 0; i < 4; ++i) {
+    const size_t itask = tasks.get_free_element();
+    tasks[itask].set_type(0);
+    tasks[itask].set_buffer(queue_indices[i]);
+    queues[queue_indices[i]]->add_task(itask);
+  }
+}
+
+/**
+ * @brief Unit test for the Scheduler class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  for (int_fast32_t ipolicy = 0; ipolicy < STEALPOLICY_NUMBER; ++ipolicy) {
+
+    ThreadSafeVector< Task > tasks(100);
+    std::vector< TaskQueue * > queues(TESTSCHEDULER_NQUEUE);
+    for (uint_fast32_t i = 0; i < TESTSCHEDULER_NQUEUE; ++i) {
+      queues[i] = new TaskQueue(100, "", true);
+    }
+    TaskQueue shared_queue(100);
+
+    // NUMA domains: {0, 1} and {2, 3}
+    Scheduler scheduler(tasks, queues, shared_queue,
+                        static_cast< StealPolicy >(ipolicy), 2);
+    TestGridCreator grid_creator;
+    scheduler.set_subgrid_adjacency(grid_creator);
+
+    fill_queues(tasks, queues);
+
+    // check the first victim for thread 0
+    const uint_fast32_t itask = scheduler.get_task(0);
+    assert_condition(itask != NO_TASK);
+    const size_t victim = tasks[itask].get_buffer();
+    switch (ipolicy) {
+    case STEALPOLICY_LARGEST_QUEUE:
+      assert_condition(victim == 2);
+      break;
+    case STEALPOLICY_NUMA:
+      assert_condition(victim == 1);
+      break;
+    case STEALPOLICY_SUBGRID_ADJACENCY:
+      // subgrid 0 (thread 0) only borders subgrid 1 (thread 2)
+      assert_condition(victim == 2);
+      break;
+    default:
+      break;
+    }
+    tasks[itask].unlock_dependency();
+
+    // all other tasks should be retrieved exactly once
+    uint_fast32_t number_of_tasks = 1;
+    uint_fast32_t next_task = scheduler.get_task(0);
+    while (next_task != NO_TASK) {
+      ++number_of_tasks;
+      tasks[next_task].unlock_dependency();
+      next_task = scheduler.get_task(0);
+    }
+    assert_condition(number_of_tasks == 4);
+    for (uint_fast32_t i = 0; i < TESTSCHEDULER_NQUEUE; ++i) {
+      assert_condition(queues[i]->size() == 0);
+    }
+
+    // the shared queue is used as a last resort
+    shared_queue.add_task(tasks.get_free_element());
+    assert_condition(scheduler.get_task(3) != NO_TASK);
+    assert_condition(scheduler.get_task(3) == NO_TASK);
+
+    for (uint_fast32_t i = 0; i < TESTSCHEDULER_NQUEUE; ++i) {
+      delete queues[i];
+    }
+  }
+
+  return 0;
+}
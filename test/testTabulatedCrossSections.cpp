@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testTabulatedCrossSections.cpp
+ *
+ * @brief Unit test for the TabulatedCrossSections class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "ElementNames.hpp"
+#include "RandomGenerator.hpp"
+#include "TabulatedCrossSections.hpp"
+#include "UnitConverter.hpp"
+#include "VernerCrossSections.hpp"
+
+/**
+ * @brief Unit test for the TabulatedCrossSections class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  const double minimum_frequency =
+      UnitConverter::to_SI< QUANTITY_FREQUENCY >(13.6, "eV");
+  const double maximum_frequency =
+      UnitConverter::to_SI< QUANTITY_FREQUENCY >(54.4, "eV");
+
+  VernerCrossSections exact_cross_sections;
+  RandomGenerator random_generator(42);
+
+  const double tolerances[2] = {1.e-3, 1.e-5};
+  for (uint_fast8_t itol = 0; itol < 2; ++itol) {
+    const double tolerance = tolerances[itol];
+    TabulatedCrossSections cross_sections(new VernerCrossSections(),
+                                          minimum_frequency, maximum_frequency,
+                                          tolerance, 1000000);
+
+    // check random frequencies in and just outside the tabulated range
+    for (uint_fast32_t i = 0; i < 100000; ++i) {
+      const double frequency =
+          0.9 * minimum_frequency +
+          (1.1 * maximum_frequency - 0.9 * minimum_frequency) *
+              random_generator.get_uniform_random_double();
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        const double exact =
+            exact_cross_sections.get_cross_section(ion, frequency);
+        const double tabulated =
+            cross_sections.get_cross_section(ion, frequency);
+        // the tolerance is only guaranteed in the middle of each interval, so
+        // we allow for a somewhat larger error elsewhere
+        assert_condition(std::abs(tabulated - exact) <=
+                         2. * tolerance * std::abs(exact));
+      }
+    }
+
+    // frequencies outside the table need to be exact
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      assert_condition(
+          cross_sections.get_cross_section(ion, 0.5 * minimum_frequency) ==
+          exact_cross_sections.get_cross_section(ion,
+                                                 0.5 * minimum_frequency));
+      assert_condition(
+          cross_sections.get_cross_section(ion, 2. * maximum_frequency) ==
+          exact_cross_sections.get_cross_section(ion,
+                                                 2. * maximum_frequency));
+    }
+  }
+
+  // a stricter tolerance needs a finer table
+  TabulatedCrossSections coarse(new VernerCrossSections(), minimum_frequency,
+                                maximum_frequency, 1.e-2, 1000000);
+  TabulatedCrossSections fine(new VernerCrossSections(), minimum_frequency,
+                              maximum_frequency, 1.e-6, 1000000);
+  assert_condition(coarse.get_number_of_points() <
+                   fine.get_number_of_points());
+
+  return 0;
+}
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testTaskBasedIonizationSimulation_MPI.cpp
+ *
+ * @brief Unit test for the distributed TaskBasedIonizationSimulation.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+
+#include "Assert.hpp"
+#include "MPICommunicator.hpp"
+#include "TaskBasedIonizationSimulation.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+/**
+ * @brief Unit test for the distributed TaskBasedIonizationSimulation.
+ *
+ * The subgrids are distributed over all processes, so that the photon packets
+ * emitted by the central source need to cross process boundaries. The subgrid
+ * copies are redistributed between iterations, which requires all processes
+ * to agree on the new copy hierarchy. We check that the photon propagation
+ * terminates, that the per-process snapshot files together contain all cells,
+ * and that they contain a Stromgren sphere.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  MPICommunicator comm(argc, argv);
+
+  // make sure we have at least 2 processes
+  assert_condition(comm.get_size() > 1);
+
+  {
+    TaskBasedIonizationSimulation simulation(
+        1, "test_taskbasedionizationsimulation_MPI.param", false, false,
+        &comm);
+    simulation.initialize(nullptr);
+    simulation.run(nullptr);
+  }
+
+  // make sure all processes have written their snapshot file
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  if (comm.get_rank() == 0) {
+    // analytic Stromgren radius for the test setup: 4.4 pc
+    const double pc = 3.086e16;
+    uint_fast32_t number_of_cells = 0;
+    for (int_fast32_t rank = 0; rank < comm.get_size(); ++rank) {
+      std::stringstream filename;
+      filename << "test_taskbasedionizationsimulation_MPI010." << rank
+               << ".txt";
+      std::ifstream ifile(filename.str());
+      assert_condition(ifile.good());
+      std::string line;
+      // skip the header
+      std::getline(ifile, line);
+      uint_fast32_t number_of_process_cells = 0;
+      while (std::getline(ifile, line)) {
+        std::istringstream linestream(line);
+        double x, y, z, n, V, xH;
+        linestream >> x >> y >> z >> n >> V >> xH;
+        assert_values_equal_rel(n, 1.e8, 1.e-10);
+        const double r = std::sqrt(x * x + y * y + z * z);
+        if (r < 2. * pc) {
+          assert_condition(xH < 0.1);
+        } else if (r > 7. * pc) {
+          assert_condition(xH > 0.5);
+        }
+        ++number_of_process_cells;
+      }
+      // every process owns part of the grid
+      assert_condition(number_of_process_cells > 0);
+      number_of_cells += number_of_process_cells;
+    }
+    assert_condition(number_of_cells == 16 * 16 * 16);
+    cmac_status("Test successful.");
+  }
+
+  return 0;
+}
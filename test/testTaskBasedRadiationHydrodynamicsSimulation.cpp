@@ -0,0 +1,325 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testTaskBasedRadiationHydrodynamicsSimulation.cpp
+ *
+ * @brief Unit test for the hierarchical time stepping in the
+ * TaskBasedRadiationHydrodynamicsSimulation.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+
+#include "Assert.hpp"
+#include "DensitySubGridCreator.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "HydroDensitySubGrid.hpp"
+#include "TaskBasedRadiationHydrodynamicsSimulation.hpp"
+#include "TimeLine.hpp"
+
+#include <vector>
+
+/**
+ * @brief Create a grid of subgrids along the x axis that contains a Sod shock
+ * tube with the discontinuity in the middle of the box.
+ *
+ * @param number_of_subgrids Number of subgrids along the x axis.
+ * @param hydro Hydro instance to use.
+ * @return Pointer to a newly created DensitySubGridCreator. Memory management
+ * for the pointer is transferred to the caller.
+ */
+static DensitySubGridCreator< HydroDensitySubGrid > *
+create_sod_grid(const int_fast32_t number_of_subgrids, const Hydro &hydro) {
+
+  DensitySubGridCreator< HydroDensitySubGrid > *grid_creator =
+      new DensitySubGridCreator< HydroDensitySubGrid >(
+          Box<>(CoordinateVector<>(0.), CoordinateVector<>(1.)),
+          CoordinateVector< int_fast32_t >(16, 4, 4),
+          CoordinateVector< int_fast32_t >(number_of_subgrids, 1, 1),
+          CoordinateVector< bool >(false));
+  HomogeneousDensityFunction density_function;
+  density_function.initialize();
+  grid_creator->initialize(density_function);
+
+  for (auto gridit = grid_creator->begin();
+       gridit != grid_creator->original_end(); ++gridit) {
+    for (auto cellit = (*gridit).hydro_begin();
+         cellit != (*gridit).hydro_end(); ++cellit) {
+      HydroVariables &variables = cellit.get_hydro_variables();
+      variables.set_primitives_velocity(CoordinateVector<>(0.));
+      if (cellit.get_cell_midpoint().x() < 0.5) {
+        variables.set_primitives_density(1.);
+        variables.set_primitives_pressure(1.);
+      } else {
+        variables.set_primitives_density(0.125);
+        variables.set_primitives_pressure(0.1);
+      }
+    }
+    (*gridit).initialize_hydrodynamic_variables(hydro, false);
+  }
+  return grid_creator;
+}
+
+/**
+ * @brief Do a single first order hydro step for all active subgrids.
+ *
+ * This mimics the hydro tasks of the simulation: only the fluxes that involve
+ * at least one active subgrid are computed, and the flux across a subgrid
+ * boundary is integrated over the shortest of both time steps and weighted
+ * with the ratio of that interface time step and the subgrid time step.
+ *
+ * @param grid_creator Subgrids.
+ * @param hydro Hydro instance to use.
+ */
+static void
+do_hydro_step(DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+              const Hydro &hydro) {
+
+  const size_t number_of_subgrids = grid_creator.number_of_original_subgrids();
+  for (size_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+    HydroDensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+    if (subgrid.is_hydro_active()) {
+      subgrid.inner_flux_sweep(hydro, subgrid.get_hydro_timestep());
+    }
+  }
+  for (size_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+    HydroDensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+    for (int_fast32_t direction :
+         {TRAVELDIRECTION_FACE_X_P, TRAVELDIRECTION_FACE_Y_P,
+          TRAVELDIRECTION_FACE_Z_P}) {
+      const uint_fast32_t ngb = subgrid.get_neighbour(direction);
+      if (ngb == NEIGHBOUR_OUTSIDE) {
+        continue;
+      }
+      HydroDensitySubGrid &neighbour = *grid_creator.get_subgrid(ngb);
+      if (!subgrid.is_hydro_active() && !neighbour.is_hydro_active()) {
+        continue;
+      }
+      const double timestep = subgrid.get_hydro_timestep();
+      const double neighbour_timestep = neighbour.get_hydro_timestep();
+      const double interface_timestep = std::min(timestep, neighbour_timestep);
+      subgrid.outer_flux_sweep(direction, hydro, neighbour, interface_timestep,
+                               interface_timestep / timestep,
+                               interface_timestep / neighbour_timestep);
+    }
+  }
+  for (size_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+    HydroDensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+    if (subgrid.is_hydro_active()) {
+      subgrid.update_conserved_and_primitive_variables(
+          hydro, subgrid.get_hydro_timestep());
+    }
+  }
+}
+
+/**
+ * @brief Get the total mass and total energy in the grid.
+ *
+ * @param grid_creator Subgrids.
+ * @param mass Total mass (output).
+ * @param energy Total energy (output).
+ */
+static void
+get_totals(DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+           double &mass, double &energy) {
+  mass = 0.;
+  energy = 0.;
+  for (auto gridit = grid_creator.begin();
+       gridit != grid_creator.original_end(); ++gridit) {
+    for (auto cellit = (*gridit).hydro_begin();
+         cellit != (*gridit).hydro_end(); ++cellit) {
+      mass += cellit.get_hydro_variables().get_conserved_mass();
+      energy += cellit.get_hydro_variables().get_conserved_total_energy();
+    }
+  }
+}
+
+/**
+ * @brief Unit test for the hierarchical time stepping in the
+ * TaskBasedRadiationHydrodynamicsSimulation.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  const Hydro hydro(5. / 3., 100., 1.e4, 1.e99, false);
+
+  /// a two level setup: the high pressure half of a Sod shock tube takes
+  /// twice as long time steps as the low pressure half. The weighted fluxes
+  /// across the subgrid boundary should conserve mass and energy
+  {
+    DensitySubGridCreator< HydroDensitySubGrid > *grid_creator =
+        create_sod_grid(2, hydro);
+    double initial_mass, initial_energy;
+    get_totals(*grid_creator, initial_mass, initial_energy);
+
+    TimeLine timeline(0., 0.1, 1.e-6, 0.1);
+    const std::vector< double > requested_timesteps = {0.01, 0.005};
+    uint_fast32_t number_of_steps[2] = {0, 0};
+    uint_fast32_t number_of_synchronisations = 0;
+    double actual_timestep, current_time;
+    uint64_t next_time = TaskBasedRadiationHydrodynamicsSimulation::
+        assign_hierarchical_timesteps(*grid_creator, timeline,
+                                      requested_timesteps);
+    bool has_next_step =
+        next_time > 0 &&
+        timeline.advance_to(next_time, actual_timestep, current_time);
+    while (has_next_step) {
+      do_hydro_step(*grid_creator, hydro);
+
+      bool all_active = true;
+      for (uint_fast32_t igrid = 0; igrid < 2; ++igrid) {
+        if ((*grid_creator->get_subgrid(igrid)).is_hydro_active()) {
+          ++number_of_steps[igrid];
+        } else {
+          all_active = false;
+        }
+      }
+      // all pending fluxes have been applied at a synchronisation point
+      if (all_active) {
+        ++number_of_synchronisations;
+        double mass, energy;
+        get_totals(*grid_creator, mass, energy);
+        assert_values_equal_rel(mass, initial_mass, 1.e-12);
+        assert_values_equal_rel(energy, initial_energy, 1.e-12);
+      }
+
+      next_time = TaskBasedRadiationHydrodynamicsSimulation::
+          assign_hierarchical_timesteps(*grid_creator, timeline,
+                                        requested_timesteps);
+      // neighbouring subgrids are at most one level apart
+      const uint64_t timestep0 =
+          (*grid_creator->get_subgrid(0)).get_integer_timestep();
+      const uint64_t timestep1 =
+          (*grid_creator->get_subgrid(1)).get_integer_timestep();
+      assert_condition(timestep0 <= 2 * timestep1 &&
+                       timestep1 <= 2 * timestep0);
+      has_next_step =
+          next_time > 0 &&
+          timeline.advance_to(next_time, actual_timestep, current_time);
+    }
+
+    cmac_status("Steps: %" PRIuFAST32 " (coarse), %" PRIuFAST32 " (fine).",
+                number_of_steps[0], number_of_steps[1]);
+    // like in the simulation, the step that reaches the end of the time line
+    // is not executed
+    assert_condition(current_time == 0.1);
+    assert_condition(number_of_steps[0] == 15);
+    assert_condition(number_of_steps[1] == 31);
+    assert_condition(number_of_synchronisations == 15);
+
+    delete grid_creator;
+  }
+
+  /// if all subgrids request the same time step, hierarchical time stepping
+  /// should give exactly the same result as uniform time stepping
+  {
+    DensitySubGridCreator< HydroDensitySubGrid > *hierarchical_grid =
+        create_sod_grid(2, hydro);
+    DensitySubGridCreator< HydroDensitySubGrid > *uniform_grid =
+        create_sod_grid(2, hydro);
+    const std::vector< double > requested_timesteps = {0.005, 0.005};
+
+    TimeLine hierarchical_timeline(0., 0.1, 1.e-6, 0.1);
+    double actual_timestep, current_time;
+    uint64_t next_time = TaskBasedRadiationHydrodynamicsSimulation::
+        assign_hierarchical_timesteps(*hierarchical_grid, hierarchical_timeline,
+                                      requested_timesteps);
+    bool has_next_step =
+        next_time > 0 && hierarchical_timeline.advance_to(
+                             next_time, actual_timestep, current_time);
+    uint_fast32_t number_of_hierarchical_steps = 0;
+    while (has_next_step) {
+      do_hydro_step(*hierarchical_grid, hydro);
+      ++number_of_hierarchical_steps;
+      next_time = TaskBasedRadiationHydrodynamicsSimulation::
+          assign_hierarchical_timesteps(*hierarchical_grid,
+                                        hierarchical_timeline,
+                                        requested_timesteps);
+      has_next_step = next_time > 0 && hierarchical_timeline.advance_to(
+                                           next_time, actual_timestep,
+                                           current_time);
+    }
+
+    TimeLine uniform_timeline(0., 0.1, 1.e-6, 0.1);
+    has_next_step =
+        uniform_timeline.advance(0.005, actual_timestep, current_time);
+    uint_fast32_t number_of_uniform_steps = 0;
+    while (has_next_step) {
+      for (auto gridit = uniform_grid->begin();
+           gridit != uniform_grid->original_end(); ++gridit) {
+        (*gridit).set_hydro_timestep(0, 0, actual_timestep);
+        (*gridit).set_hydro_active(true);
+      }
+      do_hydro_step(*uniform_grid, hydro);
+      ++number_of_uniform_steps;
+      has_next_step =
+          uniform_timeline.advance(0.005, actual_timestep, current_time);
+    }
+
+    assert_condition(number_of_hierarchical_steps == 31);
+    assert_condition(number_of_uniform_steps == number_of_hierarchical_steps);
+    for (auto hierarchical_gridit = hierarchical_grid->begin(),
+              uniform_gridit = uniform_grid->begin();
+         hierarchical_gridit != hierarchical_grid->original_end();
+         ++hierarchical_gridit, ++uniform_gridit) {
+      for (auto hierarchical_cellit = (*hierarchical_gridit).hydro_begin(),
+                uniform_cellit = (*uniform_gridit).hydro_begin();
+           hierarchical_cellit != (*hierarchical_gridit).hydro_end();
+           ++hierarchical_cellit, ++uniform_cellit) {
+        for (uint_fast8_t i = 0; i < 5; ++i) {
+          assert_condition(
+              hierarchical_cellit.get_hydro_variables().conserved(i) ==
+              uniform_cellit.get_hydro_variables().conserved(i));
+        }
+      }
+    }
+
+    delete hierarchical_grid;
+    delete uniform_grid;
+  }
+
+  /// a short time step propagates to the neighbouring subgrids, one level per
+  /// subgrid
+  {
+    DensitySubGridCreator< HydroDensitySubGrid > *grid_creator =
+        create_sod_grid(4, hydro);
+    TimeLine timeline(0., 1., 1.e-6, 1.);
+    const std::vector< double > requested_timesteps = {1., 1., 1., 0.01};
+    const uint64_t next_time = TaskBasedRadiationHydrodynamicsSimulation::
+        assign_hierarchical_timesteps(*grid_creator, timeline,
+                                      requested_timesteps);
+    const double expected_timesteps[4] = {0.0625, 0.03125, 0.015625,
+                                          0.0078125};
+    for (uint_fast32_t igrid = 0; igrid < 4; ++igrid) {
+      const HydroDensitySubGrid &subgrid = *grid_creator->get_subgrid(igrid);
+      assert_condition(subgrid.get_hydro_timestep() ==
+                       expected_timesteps[igrid]);
+      // only the subgrid with the shortest time step ends at the next
+      // synchronisation point
+      assert_condition(subgrid.is_hydro_active() == (igrid == 3));
+    }
+    assert_condition(next_time ==
+                     (*grid_creator->get_subgrid(3)).get_integer_timestep());
+    delete grid_creator;
+  }
+
+  return 0;
+}
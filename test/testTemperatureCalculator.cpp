@@ -36,6 +36,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 /**
  * @brief DensityFunction implementation that returns a SILCC disc like
@@ -349,6 +350,11 @@ int main(int argc, char **argv) {
     }
 #endif
 
+    // input and output values for the batched calculation test
+    std::vector< IonizationVariables > batch_input;
+    std::vector< IonizationVariables > batch_reference;
+    std::vector< CoordinateVector<> > batch_midpoints;
+
     std::ofstream ofile("test_temperaturecalculator_cr.txt");
     ofile << "# z (m)\tn (m^-3)\tT (K)\n";
     for (auto it = grid.begin(); it != grid.end(); ++it) {
@@ -412,9 +418,14 @@ int main(int argc, char **argv) {
           HEATINGTERM_He, std::pow(10., -8.280e-59 * z3 + (2.779e-39) * z2 +
                                             (-1.078e-19) * z + (-2.954e+01)));
 
+      batch_input.push_back(ionization_variables);
+      batch_midpoints.push_back(it.get_cell_midpoint());
+
       calculator.calculate_temperature(ionization_variables, 1., 1.,
                                        it.get_cell_midpoint());
 
+      batch_reference.push_back(ionization_variables);
+
       ofile << z << "\t" << ionization_variables.get_number_density() << "\t"
             << ionization_variables.get_temperature() << "\n";
       ofile.flush();
@@ -423,6 +434,54 @@ int main(int argc, char **argv) {
                   ionization_variables.get_temperature());
     }
     ofile.close();
+
+    // add a neutral and a vacuum cell
+    batch_input.push_back(batch_input[0]);
+    batch_input.back().set_mean_intensity(ION_H_n, 0.);
+    batch_input.back().set_mean_intensity(ION_He_n, 0.);
+    batch_midpoints.push_back(batch_midpoints[0]);
+    batch_input.push_back(batch_input[0]);
+    batch_input.back().set_number_density(0.);
+    batch_midpoints.push_back(batch_midpoints[0]);
+    for (uint_fast32_t i = batch_input.size() - 2; i < batch_input.size();
+         ++i) {
+      batch_reference.push_back(batch_input[i]);
+      calculator.calculate_temperature(batch_reference.back(), 1., 1.,
+                                       batch_midpoints[i]);
+    }
+
+    // the batched calculation should give exactly the same result as the
+    // scalar calculation
+    for (uint_fast32_t ibatch = 0; ibatch < batch_input.size();
+         ibatch += IONIZATIONSTATECALCULATOR_BATCH_SIZE) {
+      const uint_fast32_t number_of_cells =
+          std::min< uint_fast32_t >(IONIZATIONSTATECALCULATOR_BATCH_SIZE,
+                                    batch_input.size() - ibatch);
+      double jfac[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+      double hfac[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+      IonizationVariables *variables[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+      for (uint_fast32_t i = 0; i < number_of_cells; ++i) {
+        jfac[i] = 1.;
+        hfac[i] = 1.;
+        variables[i] = &batch_input[ibatch + i];
+      }
+      calculator.calculate_temperature_batch(number_of_cells, jfac, hfac,
+                                             variables,
+                                             &batch_midpoints[ibatch]);
+    }
+    for (uint_fast32_t i = 0; i < batch_input.size(); ++i) {
+      assert_condition(batch_input[i].get_temperature() ==
+                       batch_reference[i].get_temperature());
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        assert_condition(batch_input[i].get_ionic_fraction(ion) ==
+                         batch_reference[i].get_ionic_fraction(ion));
+      }
+      for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
+           ++heating) {
+        assert_condition(batch_input[i].get_heating(heating) ==
+                         batch_reference[i].get_heating(heating));
+      }
+    }
   }
 
 #endif
@@ -120,5 +120,63 @@ int main(int argc, char **argv) {
     }
   }
 
+  /// hierarchical time steps
+  {
+    cmac_status("Hierarchical time line test...");
+    TimeLine timeline(0., 1., 0.001, 0.1);
+
+    // the maximum time step is rounded down to 1/16
+    assert_condition(timeline.get_physical_timestep(
+                         timeline.get_integer_timestep(1.)) == 0.0625);
+
+    // two parts of the system with different time step requirements
+    const double requested_timesteps[2] = {0.02, 0.005};
+    uint64_t integer_timesteps[2] = {0, 0};
+    uint64_t end_times[2] = {0, 0};
+    uint_fast32_t numsteps[2] = {0, 0};
+    uint_fast32_t numstep = 0;
+    double actual_timestep, current_time;
+    bool has_next_step = true;
+    while (has_next_step) {
+      uint64_t next_time = UINT64_MAX;
+      for (uint_fast8_t i = 0; i < 2; ++i) {
+        if (end_times[i] == timeline.get_current_integer_time()) {
+          integer_timesteps[i] =
+              timeline.get_integer_timestep(requested_timesteps[i]);
+          end_times[i] += integer_timesteps[i];
+          ++numsteps[i];
+        }
+        next_time = std::min(next_time, end_times[i]);
+      }
+      has_next_step =
+          timeline.advance_to(next_time, actual_timestep, current_time);
+      assert_condition(actual_timestep == 0.00390625);
+      ++numstep;
+    }
+    assert_condition(current_time == 1.);
+    assert_condition(timeline.get_physical_timestep(integer_timesteps[0]) ==
+                     0.015625);
+    assert_condition(timeline.get_physical_timestep(integer_timesteps[1]) ==
+                     0.00390625);
+    assert_condition(numsteps[0] == 64);
+    assert_condition(numsteps[1] == 256);
+    assert_condition(numstep == 256);
+
+    // a longer step can only start at a time that is a multiple of its size
+    TimeLine offset_timeline(0., 1., 0.001, 0.1);
+    offset_timeline.advance_to(offset_timeline.get_integer_timestep(0.005),
+                               actual_timestep, current_time);
+    assert_condition(offset_timeline.get_physical_timestep(
+                         offset_timeline.get_integer_timestep(0.02)) ==
+                     0.00390625);
+
+    // steps smaller than the minimum time step are refused
+    assert_condition(!offset_timeline.advance_to(
+        offset_timeline.get_current_integer_time() +
+            offset_timeline.get_integer_timestep(1.e-4),
+        actual_timestep, current_time));
+    cmac_status("Done.");
+  }
+
   return 0;
 }
@@ -53,6 +53,21 @@ int main(int argc, char **argv) {
 
     assert_values_equal(1., grid.get_total_hydrogen_number());
     assert_values_equal(2000., grid.get_average_temperature());
+
+    // a photon with a very large optical depth leaves the box through the top
+    // wall
+    CoordinateVector<> photon_direction(0.1, 0.2, 1.);
+    photon_direction /= photon_direction.norm();
+    Photon photon(CoordinateVector<>(0.3, 0.4, 0.1), photon_direction, 1.);
+    photon.set_cross_section(ION_H_n, 1.);
+#ifdef HAS_HELIUM
+    photon.set_cross_section(ION_He_n, 1.);
+#endif
+    DensityGrid::iterator inside = grid.interact(photon, 1.e99);
+    assert_condition(inside == grid.end());
+    assert_values_equal_rel(photon.get_position().x(), 0.39, 1.e-10);
+    assert_values_equal_rel(photon.get_position().y(), 0.58, 1.e-10);
+    assert_values_equal_rel(photon.get_position().z(), 1., 1.e-10);
   }
 
   /// regular generators
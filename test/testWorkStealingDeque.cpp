@@ -0,0 +1,158 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testWorkStealingDeque.cpp
+ *
+ * @brief Unit test for the WorkStealingDeque and LockFreeQueue classes.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "AtomicValue.hpp"
+#include "LockFreeQueue.hpp"
+#include "WorkStealingDeque.hpp"
+
+#include <omp.h>
+#include <vector>
+
+/*! @brief Number of elements used during the test. */
+#define TESTWORKSTEALINGDEQUE_NELEMENT 100000
+
+/**
+ * @brief Unit test for the WorkStealingDeque and LockFreeQueue classes.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// serial tests
+  {
+    WorkStealingDeque deque(100);
+    for (size_t i = 0; i < 100; ++i) {
+      deque.push(i);
+    }
+    assert_condition(deque.size() == 100);
+    size_t value;
+    // the owner takes the newest element
+    assert_condition(deque.pop(value));
+    assert_condition(value == 99);
+    // thieves take the oldest element
+    assert_condition(deque.steal(value));
+    assert_condition(value == 0);
+    assert_condition(deque.size() == 98);
+    while (deque.pop(value)) {
+    }
+    assert_condition(deque.size() == 0);
+    assert_condition(!deque.steal(value));
+  }
+
+  {
+    LockFreeQueue queue(100);
+    // the queue rounds up to the next power of 2
+    assert_condition(queue.capacity() == 128);
+    for (size_t i = 0; i < 128; ++i) {
+      assert_condition(queue.push(i));
+    }
+    assert_condition(!queue.push(128));
+    size_t value;
+    for (size_t i = 0; i < 128; ++i) {
+      assert_condition(queue.pop(value));
+      assert_condition(value == i);
+    }
+    assert_condition(!queue.pop(value));
+  }
+
+  /// parallel tests
+  omp_set_num_threads(8);
+
+  // thread 0 owns the deque and continuously adds elements to it and takes
+  // elements from it, while all other threads steal elements
+  // every element should be retrieved exactly once
+  {
+    WorkStealingDeque deque(TESTWORKSTEALINGDEQUE_NELEMENT);
+    std::vector< AtomicValue< uint_fast32_t > > flags(
+        TESTWORKSTEALINGDEQUE_NELEMENT);
+    AtomicValue< size_t > number_done(0);
+#pragma omp parallel default(shared)
+    {
+      const int_fast32_t thread_id = omp_get_thread_num();
+      size_t value;
+      if (thread_id == 0) {
+        size_t next = 0;
+        while (next < TESTWORKSTEALINGDEQUE_NELEMENT) {
+          for (uint_fast32_t i = 0;
+               i < 10 && next < TESTWORKSTEALINGDEQUE_NELEMENT; ++i) {
+            deque.push(next);
+            ++next;
+          }
+          if (deque.pop(value)) {
+            flags[value].pre_increment();
+            number_done.pre_increment();
+          }
+        }
+        while (deque.pop(value)) {
+          flags[value].pre_increment();
+          number_done.pre_increment();
+        }
+      }
+      while (number_done.value() < TESTWORKSTEALINGDEQUE_NELEMENT) {
+        if (deque.steal(value)) {
+          flags[value].pre_increment();
+          number_done.pre_increment();
+        }
+      }
+    }
+    for (size_t i = 0; i < TESTWORKSTEALINGDEQUE_NELEMENT; ++i) {
+      assert_condition(flags[i].value() == 1);
+    }
+  }
+
+  // all threads add elements to the queue and remove elements from it
+  {
+    LockFreeQueue queue(TESTWORKSTEALINGDEQUE_NELEMENT);
+    std::vector< AtomicValue< uint_fast32_t > > flags(
+        TESTWORKSTEALINGDEQUE_NELEMENT);
+    AtomicValue< size_t > number_done(0);
+#pragma omp parallel default(shared)
+    {
+      size_t value;
+#pragma omp for
+      for (size_t i = 0; i < TESTWORKSTEALINGDEQUE_NELEMENT; ++i) {
+        assert_condition(queue.push(i));
+        if (queue.pop(value)) {
+          flags[value].pre_increment();
+          number_done.pre_increment();
+        }
+      }
+      while (number_done.value() < TESTWORKSTEALINGDEQUE_NELEMENT) {
+        if (queue.pop(value)) {
+          flags[value].pre_increment();
+          number_done.pre_increment();
+        }
+      }
+    }
+    for (size_t i = 0; i < TESTWORKSTEALINGDEQUE_NELEMENT; ++i) {
+      assert_condition(flags[i].value() == 1);
+    }
+  }
+
+  return 0;
+}
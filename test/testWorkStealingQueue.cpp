@@ -0,0 +1,236 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testWorkStealingQueue.cpp
+ *
+ * @brief Stress test for the work-stealing TaskQueue and the LockFreeQueue it
+ * uses.
+ *
+ * The work-stealing implementation of the TaskQueue is always used by this
+ * test, independent of the WORK_STEALING_QUEUE configuration option. The test
+ * uses plain system threads, so that it also runs if OpenMP is not available.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+
+/*! @brief Always test the work-stealing TaskQueue. */
+#define USE_WORK_STEALING_QUEUE
+
+/*! @brief Number of elements pushed by every producer thread. */
+#define TESTWORKSTEALINGQUEUE_NPUSH 200000
+
+/*! @brief Number of tasks used for the TaskQueue test. */
+#define TESTWORKSTEALINGQUEUE_NTASK 20000
+
+#include "Assert.hpp"
+#include "LockFreeQueue.hpp"
+#include "TaskQueue.hpp"
+#include "ThreadSafeVector.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Unit test for the work-stealing TaskQueue and the LockFreeQueue.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// LockFreeQueue: a pop that starts after a push has returned should never
+  /// report an empty queue before the pushed element was removed
+  {
+    const uint_fast32_t number_of_producers = 4;
+    const size_t number_of_elements =
+        number_of_producers * TESTWORKSTEALINGQUEUE_NPUSH;
+    // a small queue, so that producers regularly find it full
+    LockFreeQueue queue(256);
+    std::vector< std::atomic< uint_fast32_t > > received(number_of_elements);
+    for (size_t i = 0; i < number_of_elements; ++i) {
+      received[i].store(0);
+    }
+    std::atomic< size_t > number_pushed(0);
+    std::atomic< size_t > number_of_spurious_empty(0);
+
+    std::vector< std::thread > threads;
+    for (uint_fast32_t iproducer = 0; iproducer < number_of_producers;
+         ++iproducer) {
+      threads.push_back(std::thread([&, iproducer]() {
+        for (size_t i = 0; i < TESTWORKSTEALINGQUEUE_NPUSH; ++i) {
+          while (!queue.push(iproducer * TESTWORKSTEALINGQUEUE_NPUSH + i)) {
+            std::this_thread::yield();
+          }
+          number_pushed.fetch_add(1, std::memory_order_release);
+        }
+      }));
+    }
+    // a single consumer, so that it knows exactly how many elements it has
+    // removed
+    threads.push_back(std::thread([&]() {
+      size_t number_popped = 0;
+      while (number_popped < number_of_elements) {
+        const size_t pushed = number_pushed.load(std::memory_order_acquire);
+        size_t value;
+        if (queue.pop(value)) {
+          received[value].fetch_add(1);
+          ++number_popped;
+        } else {
+          if (number_popped < pushed) {
+            number_of_spurious_empty.fetch_add(1);
+          }
+          std::this_thread::yield();
+        }
+      }
+    }));
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    assert_condition(number_of_spurious_empty.load() == 0);
+    assert_condition(queue.size() == 0);
+    for (size_t i = 0; i < number_of_elements; ++i) {
+      assert_condition(received[i].load() == 1);
+    }
+  }
+
+  /// LockFreeQueue: multiple producers and multiple consumers
+  {
+    const uint_fast32_t number_of_producers = 2;
+    const uint_fast32_t number_of_consumers = 3;
+    const size_t number_of_elements =
+        number_of_producers * TESTWORKSTEALINGQUEUE_NPUSH;
+    LockFreeQueue queue(128);
+    std::vector< std::atomic< uint_fast32_t > > received(number_of_elements);
+    for (size_t i = 0; i < number_of_elements; ++i) {
+      received[i].store(0);
+    }
+    std::atomic< size_t > number_popped(0);
+
+    std::vector< std::thread > threads;
+    for (uint_fast32_t iproducer = 0; iproducer < number_of_producers;
+         ++iproducer) {
+      threads.push_back(std::thread([&, iproducer]() {
+        for (size_t i = 0; i < TESTWORKSTEALINGQUEUE_NPUSH; ++i) {
+          while (!queue.push(iproducer * TESTWORKSTEALINGQUEUE_NPUSH + i)) {
+            std::this_thread::yield();
+          }
+        }
+      }));
+    }
+    for (uint_fast32_t iconsumer = 0; iconsumer < number_of_consumers;
+         ++iconsumer) {
+      threads.push_back(std::thread([&]() {
+        while (number_popped.load() < number_of_elements) {
+          size_t value;
+          if (queue.pop(value)) {
+            received[value].fetch_add(1);
+            number_popped.fetch_add(1);
+          } else {
+            std::this_thread::yield();
+          }
+        }
+      }));
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    assert_condition(queue.size() == 0);
+    for (size_t i = 0; i < number_of_elements; ++i) {
+      assert_condition(received[i].load() == 1);
+    }
+  }
+
+  /// TaskQueue: tasks are added by several threads while the owner takes tasks
+  /// and other threads steal them. Part of the tasks share a dependency, so
+  /// that the busy queue is used as well
+  {
+    const uint_fast32_t number_of_producers = 2;
+    const uint_fast32_t number_of_thieves = 3;
+    ThreadSafeVector< Task > tasks(TESTWORKSTEALINGQUEUE_NTASK);
+    ThreadLock dependencies[4];
+    for (uint_fast32_t i = 0; i < TESTWORKSTEALINGQUEUE_NTASK; ++i) {
+      const size_t itask = tasks.get_free_element();
+      if (i % 3 == 0) {
+        tasks[itask].set_dependency(&dependencies[i % 4]);
+      }
+    }
+    TaskQueue queue(TESTWORKSTEALINGQUEUE_NTASK, "stress test", true);
+    std::vector< std::atomic< uint_fast32_t > > executed(
+        TESTWORKSTEALINGQUEUE_NTASK);
+    for (uint_fast32_t i = 0; i < TESTWORKSTEALINGQUEUE_NTASK; ++i) {
+      executed[i].store(0);
+    }
+    std::atomic< uint_fast32_t > number_executed(0);
+
+    // execute the given task: count it and release its dependency
+    auto execute = [&](const size_t itask) {
+      executed[itask].fetch_add(1);
+      tasks[itask].unlock_dependency();
+      number_executed.fetch_add(1);
+    };
+
+    std::vector< std::thread > threads;
+    for (uint_fast32_t iproducer = 0; iproducer < number_of_producers;
+         ++iproducer) {
+      threads.push_back(std::thread([&, iproducer]() {
+        for (size_t itask = iproducer; itask < TESTWORKSTEALINGQUEUE_NTASK;
+             itask += number_of_producers) {
+          queue.add_task(itask);
+        }
+      }));
+    }
+    // only the owner is allowed to call get_task()
+    threads.push_back(std::thread([&]() {
+      while (number_executed.load() < TESTWORKSTEALINGQUEUE_NTASK) {
+        const size_t itask = queue.get_task(tasks);
+        if (itask != NO_TASK) {
+          execute(itask);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    }));
+    for (uint_fast32_t ithief = 0; ithief < number_of_thieves; ++ithief) {
+      threads.push_back(std::thread([&]() {
+        while (number_executed.load() < TESTWORKSTEALINGQUEUE_NTASK) {
+          const size_t itask = queue.try_get_task(tasks);
+          if (itask != NO_TASK) {
+            execute(itask);
+          } else {
+            std::this_thread::yield();
+          }
+        }
+      }));
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    assert_condition(queue.size() == 0);
+    for (uint_fast32_t i = 0; i < TESTWORKSTEALINGQUEUE_NTASK; ++i) {
+      assert_condition(executed[i].load() == 1);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeDensitySubGrid.cpp
+ *
+ * @brief Timing test for photon packet traversal through a DensitySubGrid.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "DensitySubGrid.hpp"
+#include "PhotonBuffer.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+
+#include <vector>
+
+/**
+ * @brief Timing test for photon packet traversal through a DensitySubGrid.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeDensitySubGrid", argc, argv);
+
+  const double box[6] = {-1.543e17, -1.543e17, -1.543e17,
+                         3.086e17,  3.086e17,  3.086e17};
+  const CoordinateVector< int_fast32_t > ncell(64, 64, 64);
+  DensitySubGrid grid(box, ncell);
+  RandomGenerator random_generator(42);
+
+  for (auto cellit = grid.begin(); cellit != grid.end(); ++cellit) {
+    IonizationVariables &ionization_variables =
+        cellit.get_ionization_variables();
+    ionization_variables.set_number_density(1.e8);
+    ionization_variables.set_ionic_fraction(
+        ION_H_n, 1.e-5 * (1. + random_generator.get_uniform_random_double()));
+#ifdef HAS_HELIUM
+    ionization_variables.set_ionic_fraction(
+        ION_He_n, 1.e-5 * (1. + random_generator.get_uniform_random_double()));
+#endif
+  }
+  grid.reset_intensities();
+
+  // set up the photon packets in advance, so that we do not time the random
+  // number generation
+  const uint_fast32_t num_photon = 100000;
+  std::vector< CoordinateVector<> > directions(num_photon);
+  std::vector< double > taus(num_photon);
+  for (uint_fast32_t i = 0; i < num_photon; ++i) {
+    const double cost = 2. * random_generator.get_uniform_random_double() - 1.;
+    const double phi = 2. * M_PI * random_generator.get_uniform_random_double();
+    const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+    directions[i] =
+        CoordinateVector<>(sint * std::cos(phi), sint * std::sin(phi), cost);
+    taus[i] = -std::log(random_generator.get_uniform_random_double());
+  }
+
+  std::vector< PhotonPacket > photons(num_photon);
+  for (uint_fast32_t i = 0; i < num_photon; ++i) {
+    PhotonPacket &photon = photons[i];
+    photon.set_energy(3.288e15);
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      photon.set_photoionization_cross_section(ion, 0.);
+    }
+    photon.set_photoionization_cross_section(ION_H_n, 6.3e-22);
+#ifdef HAS_HELIUM
+    photon.set_photoionization_cross_section(ION_He_n, 7.4e-22);
+#endif
+    photon.set_position(CoordinateVector<>(0.));
+    photon.set_direction(directions[i]);
+    photon.set_weight(1.);
+    photon.set_target_optical_depth(taus[i]);
+  }
+
+  double total_time = 0.;
+  timingtools_start_timing_block("DensitySubGrid::interact") {
+    std::vector< PhotonPacket > photons_copy(photons);
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_photon; ++i) {
+      grid.interact(photons_copy[i], TRAVELDIRECTION_INSIDE);
+    }
+    timingtools_stop_timing();
+    total_time += timingtools_timer.value();
+  }
+  timingtools_end_timing_block("DensitySubGrid::interact");
+
+  timingtools_print("Traversal throughput: %g photon packets/s.",
+                    timingtools_num_sample * num_photon / total_time);
+
+  // photon buffers contain at most PHOTONBUFFER_SIZE photon packets, so we
+  // traverse batches of that size
+  std::vector< int_fast32_t > results(num_photon);
+  total_time = 0.;
+  timingtools_start_timing_block("DensitySubGrid::interact_batch") {
+    std::vector< PhotonPacket > photons_copy(photons);
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_photon; i += PHOTONBUFFER_SIZE) {
+      const uint_fast32_t batch_size =
+          std::min< uint_fast32_t >(PHOTONBUFFER_SIZE, num_photon - i);
+      grid.interact_batch(&photons_copy[i], batch_size,
+                          TRAVELDIRECTION_INSIDE, &results[i]);
+    }
+    timingtools_stop_timing();
+    total_time += timingtools_timer.value();
+  }
+  timingtools_end_timing_block("DensitySubGrid::interact_batch");
+
+  timingtools_print("Batch traversal throughput: %g photon packets/s.",
+                    timingtools_num_sample * num_photon / total_time);
+
+  return 0;
+}
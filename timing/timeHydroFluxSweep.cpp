@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeHydroFluxSweep.cpp
+ *
+ * @brief Timing test for the inner hydro flux sweep of a HydroDensitySubGrid.
+ *
+ * The vectorised structure-of-arrays pencil sweep is compared with a reference
+ * sweep that calls Hydro::do_flux_calculation() for every interface.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "HydroDensitySubGrid.hpp"
+#include "TimingTools.hpp"
+
+/**
+ * @brief Reference flux sweep that calls Hydro::do_flux_calculation() for every
+ * interface inside the given subgrid.
+ *
+ * @param grid HydroDensitySubGrid.
+ * @param ncell Number of cells in each dimension of the subgrid.
+ * @param dx Size of a single cell (in m).
+ * @param hydro Hydro instance to use.
+ * @param dt Current system time step (in s).
+ */
+inline void reference_flux_sweep(HydroDensitySubGrid &grid,
+                                 const CoordinateVector< int_fast32_t > ncell,
+                                 const double dx, const Hydro &hydro,
+                                 const double dt) {
+
+  // the hydro variables of all cells are stored contiguously
+  HydroVariables *variables = &grid.hydro_begin().get_hydro_variables();
+  const int_fast32_t stride[3] = {ncell.y() * ncell.z(), ncell.z(), 1};
+  const double A = dx * dx;
+  // we do three separate sweeps: one for every coordinate direction
+  for (uint_fast8_t i = 0; i < 3; ++i) {
+    for (int_fast32_t ix = 0; ix < ncell.x() - (i == 0); ++ix) {
+      for (int_fast32_t iy = 0; iy < ncell.y() - (i == 1); ++iy) {
+        for (int_fast32_t iz = 0; iz < ncell.z() - (i == 2); ++iz) {
+          const int_fast32_t index =
+              ix * stride[0] + iy * stride[1] + iz * stride[2];
+          hydro.do_flux_calculation(i, variables[index],
+                                    variables[index + stride[i]], dx, A, dt);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Timing test for the inner hydro flux sweep of a HydroDensitySubGrid.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeHydroFluxSweep", argc, argv);
+
+  const double box[6] = {0., 0., 0., 1., 1., 1.};
+  const CoordinateVector< int_fast32_t > ncell(64, 64, 64);
+  HydroDensitySubGrid grid(box, ncell);
+  const Hydro hydro(5. / 3., 100., 1.e4, 1.e99, false);
+
+  for (auto cellit = grid.hydro_begin(); cellit != grid.hydro_end();
+       ++cellit) {
+    HydroVariables &variables = cellit.get_hydro_variables();
+    // densities in the range [0.125, 1.[
+    variables.set_primitives_density(0.125 +
+                                     0.875 * Utilities::random_double());
+    // velocities in the range [-1., 1.[
+    variables.set_primitives_velocity(
+        CoordinateVector<>(2. * Utilities::random_double() - 1.,
+                           2. * Utilities::random_double() - 1.,
+                           2. * Utilities::random_double() - 1.));
+    // pressures in the range [0.1, 1.[
+    variables.set_primitives_pressure(0.1 + 0.9 * Utilities::random_double());
+    for (uint_fast8_t q = 0; q < 5; ++q) {
+      variables.primitive_gradients(q) =
+          CoordinateVector<>(Utilities::random_double() - 0.5,
+                             Utilities::random_double() - 0.5,
+                             Utilities::random_double() - 0.5);
+    }
+  }
+  grid.initialize_hydrodynamic_variables(hydro, false);
+
+  const uint_fast32_t num_interface = 3 * 63 * 64 * 64;
+  const uint_fast32_t num_sweep = 10;
+  double reference_time = 0.;
+  timingtools_start_timing_block("Per interface flux sweep") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_sweep; ++i) {
+      reference_flux_sweep(grid, ncell, 1. / 64., hydro, 1.e-3);
+    }
+    timingtools_stop_timing();
+    reference_time += timingtools_timer.value();
+  }
+  timingtools_end_timing_block("Per interface flux sweep");
+
+  double total_time = 0.;
+  timingtools_start_timing_block("HydroDensitySubGrid::inner_flux_sweep") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_sweep; ++i) {
+      grid.inner_flux_sweep(hydro, 1.e-3);
+    }
+    timingtools_stop_timing();
+    total_time += timingtools_timer.value();
+  }
+  timingtools_end_timing_block("HydroDensitySubGrid::inner_flux_sweep");
+
+  // the flux sweeps run on a single thread, so this is the throughput per
+  // core
+  timingtools_print("Per interface flux sweep throughput: %g interfaces/s per "
+                    "core.",
+                    timingtools_num_sample * num_sweep * num_interface /
+                        reference_time);
+  timingtools_print("Pencil flux sweep throughput: %g interfaces/s per core.",
+                    timingtools_num_sample * num_sweep * num_interface /
+                        total_time);
+
+  return 0;
+}
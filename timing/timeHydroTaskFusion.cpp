@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeHydroTaskFusion.cpp
+ *
+ * @brief Timing test for the fused hydro task mode of the task-based
+ * radiation hydrodynamics simulation.
+ *
+ * We compare two ways of executing the subgrid local hydro stages of a single
+ * time step on a large number of independent subgrids:
+ *  - staged: every stage is executed for all subgrids before the next stage
+ *    starts, which is what the unfused task graph does in the worst case,
+ *  - fused: all stages are executed back to back for a single subgrid before
+ *    moving on to the next subgrid, which is what the fused tasks do.
+ * Apart from the wall clock time, we also report the number of bytes that
+ * need to be streamed in from main memory, assuming that a single subgrid
+ * fits in the cache but the full set of subgrids does not.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "HydroDensitySubGrid.hpp"
+#include "TimingTools.hpp"
+
+#include <vector>
+
+/**
+ * @brief Timing test for the fused hydro task mode.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeHydroTaskFusion", argc, argv);
+
+  // 512 subgrids with 8^3 cells each: a single subgrid easily fits in L2, the
+  // full grid does not fit in any cache level
+  const uint_fast32_t num_subgrid = 512;
+  const CoordinateVector< int_fast32_t > ncell(8, 8, 8);
+  const Hydro hydro(5. / 3., 100., 1.e4, 1.e99, false);
+  std::vector< HydroDensitySubGrid * > subgrids(num_subgrid, nullptr);
+  for (uint_fast32_t igrid = 0; igrid < num_subgrid; ++igrid) {
+    const double box[6] = {1. * igrid, 0., 0., 1., 1., 1.};
+    subgrids[igrid] = new HydroDensitySubGrid(box, ncell);
+    for (auto cellit = subgrids[igrid]->hydro_begin();
+         cellit != subgrids[igrid]->hydro_end(); ++cellit) {
+      HydroVariables &variables = cellit.get_hydro_variables();
+      // densities in the range [0.125, 1.[
+      variables.set_primitives_density(0.125 +
+                                       0.875 * Utilities::random_double());
+      // velocities in the range [-0.1, 0.1[
+      variables.set_primitives_velocity(
+          CoordinateVector<>(0.2 * Utilities::random_double() - 0.1,
+                             0.2 * Utilities::random_double() - 0.1,
+                             0.2 * Utilities::random_double() - 0.1));
+      // pressures in the range [0.1, 1.[
+      variables.set_primitives_pressure(0.1 +
+                                        0.9 * Utilities::random_double());
+    }
+    subgrids[igrid]->initialize_hydrodynamic_variables(hydro, false);
+  }
+
+  const double dt = 1.e-4;
+  const uint_fast32_t num_step = 5;
+
+  double staged_time = 0.;
+  timingtools_start_timing_block("staged") {
+    timingtools_start_timing();
+    for (uint_fast32_t istep = 0; istep < num_step; ++istep) {
+      for (uint_fast32_t igrid = 0; igrid < num_subgrid; ++igrid) {
+        subgrids[igrid]->inner_gradient_sweep(hydro);
+      }
+      for (uint_fast32_t igrid = 0; igrid < num_subgrid; ++igrid) {
+        subgrids[igrid]->apply_slope_limiter(hydro);
+      }
+      for (uint_fast32_t igrid = 0; igrid < num_subgrid; ++igrid) {
+        subgrids[igrid]->predict_primitive_variables(hydro, 0.5 * dt);
+      }
+      for (uint_fast32_t igrid = 0; igrid < num_subgrid; ++igrid) {
+        subgrids[igrid]->inner_flux_sweep(hydro, dt);
+      }
+      for (uint_fast32_t igrid = 0; igrid < num_subgrid; ++igrid) {
+        subgrids[igrid]->update_conserved_variables(dt);
+      }
+      for (uint_fast32_t igrid = 0; igrid < num_subgrid; ++igrid) {
+        subgrids[igrid]->update_primitive_variables(hydro);
+      }
+    }
+    timingtools_stop_timing();
+    staged_time += timingtools_timer.value();
+  }
+  timingtools_end_timing_block("staged");
+
+  double fused_time = 0.;
+  timingtools_start_timing_block("fused") {
+    timingtools_start_timing();
+    for (uint_fast32_t istep = 0; istep < num_step; ++istep) {
+      for (uint_fast32_t igrid = 0; igrid < num_subgrid; ++igrid) {
+        subgrids[igrid]->inner_gradient_sweep(hydro);
+        subgrids[igrid]->limit_and_predict_primitive_variables(hydro,
+                                                               0.5 * dt);
+        subgrids[igrid]->inner_flux_sweep(hydro, dt);
+        subgrids[igrid]->update_conserved_and_primitive_variables(hydro, dt);
+      }
+    }
+    timingtools_stop_timing();
+    fused_time += timingtools_timer.value();
+  }
+  timingtools_end_timing_block("fused");
+
+  // every stage needs the hydro variables and the slope limiters of all cells
+  const double bytes_per_pass =
+      num_subgrid * ncell.x() * ncell.y() * ncell.z() *
+      (sizeof(HydroVariables) + 10 * sizeof(double));
+  // the staged version streams the full grid once per stage, the fused
+  // version only streams every subgrid in once
+  const double staged_bytes = 6. * bytes_per_pass;
+  const double fused_bytes = bytes_per_pass;
+
+  const double num_sample_step = timingtools_num_sample * num_step;
+  timingtools_print("Staged: %g s/step, %g MB streamed/step.",
+                    staged_time / num_sample_step, staged_bytes / 1.e6);
+  timingtools_print("Fused: %g s/step, %g MB streamed/step.",
+                    fused_time / num_sample_step, fused_bytes / 1.e6);
+  timingtools_print("Memory traffic reduction: %g, speed up: %g.",
+                    staged_bytes / fused_bytes, staged_time / fused_time);
+
+  for (uint_fast32_t igrid = 0; igrid < num_subgrid; ++igrid) {
+    delete subgrids[igrid];
+  }
+
+  return 0;
+}
@@ -0,0 +1,148 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timePhotonPacketRandomDraws.cpp
+ *
+ * @brief Timing test for the random numbers drawn per photon packet in the
+ * photon shoot jobs.
+ *
+ * We mimic the random number usage of IonizationPhotonShootJob::execute():
+ * a number of draws to emit the photon packet, followed by a varying number of
+ * random optical depths. We compare the sequential ranlxd2 generator with
+ * individual draws (the old behaviour) with the Philox generator that selects
+ * a stream for every photon packet, using either individual draws or a block
+ * of random numbers drawn in bulk (the new behaviour).
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "IonizationPhotonShootJob.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+
+#include <cmath>
+
+/*! @brief Number of random numbers used to emit a photon packet (direction and
+ *  frequency). */
+#define TIMEPHOTONPACKETRANDOMDRAWS_NUMBER_OF_EMISSION_DRAWS 3
+
+/**
+ * @brief Get the number of optical depths that is drawn for the photon packet
+ * with the given index.
+ *
+ * Most photon packets are absorbed after one or two interactions, but some of
+ * them are reemitted several times.
+ *
+ * @param index Index of the photon packet.
+ * @return Number of optical depths.
+ */
+inline uint_fast32_t get_number_of_optical_depths(const uint_fast64_t index) {
+  const uint_fast32_t pattern[8] = {1, 1, 2, 1, 3, 1, 2, 6};
+  return pattern[index % 8];
+}
+
+/**
+ * @brief Timing test for the random numbers drawn per photon packet in the
+ * photon shoot jobs.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timePhotonPacketRandomDraws", argc, argv);
+
+  const uint_fast64_t num_packet = 1000000;
+  timingtools_print("Drawing random numbers for %" PRIuFAST64
+                    " photon packets per sample.",
+                    num_packet);
+
+  double sum = 0.;
+
+  RandomGenerator ranlux_generator(42);
+  timingtools_start_timing_block("RANLUX, individual draws") {
+    timingtools_start_timing();
+    for (uint_fast64_t i = 0; i < num_packet; ++i) {
+      for (uint_fast32_t j = 0;
+           j < TIMEPHOTONPACKETRANDOMDRAWS_NUMBER_OF_EMISSION_DRAWS; ++j) {
+        sum += ranlux_generator.get_uniform_random_double();
+      }
+      const uint_fast32_t number_of_optical_depths =
+          get_number_of_optical_depths(i);
+      for (uint_fast32_t j = 0; j < number_of_optical_depths; ++j) {
+        sum += -std::log(ranlux_generator.get_uniform_random_double());
+      }
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("RANLUX, individual draws");
+
+  RandomGenerator philox_generator(42, RANDOMGENERATORTYPE_PHILOX);
+  timingtools_start_timing_block("Philox streams, individual draws") {
+    timingtools_start_timing();
+    for (uint_fast64_t i = 0; i < num_packet; ++i) {
+      philox_generator.set_stream(1, i);
+      for (uint_fast32_t j = 0;
+           j < TIMEPHOTONPACKETRANDOMDRAWS_NUMBER_OF_EMISSION_DRAWS; ++j) {
+        sum += philox_generator.get_uniform_random_double();
+      }
+      const uint_fast32_t number_of_optical_depths =
+          get_number_of_optical_depths(i);
+      for (uint_fast32_t j = 0; j < number_of_optical_depths; ++j) {
+        sum += -std::log(philox_generator.get_uniform_random_double());
+      }
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("Philox streams, individual draws");
+
+  // this is what IonizationPhotonShootJob::execute() does
+  timingtools_start_timing_block("Philox streams, bulk draws") {
+    timingtools_start_timing();
+    for (uint_fast64_t i = 0; i < num_packet; ++i) {
+      philox_generator.set_stream(1, i);
+      double block[IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE];
+      philox_generator.get_uniform_random_doubles(
+          block, IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE);
+      uint_fast32_t block_index = 0;
+      for (uint_fast32_t j = 0;
+           j < TIMEPHOTONPACKETRANDOMDRAWS_NUMBER_OF_EMISSION_DRAWS; ++j) {
+        sum += philox_generator.get_uniform_random_double();
+      }
+      const uint_fast32_t number_of_optical_depths =
+          get_number_of_optical_depths(i);
+      for (uint_fast32_t j = 0; j < number_of_optical_depths; ++j) {
+        if (block_index == IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE) {
+          philox_generator.get_uniform_random_doubles(
+              block, IONIZATIONPHOTONSHOOTJOB_RANDOM_BLOCK_SIZE);
+          block_index = 0;
+        }
+        sum += -std::log(block[block_index]);
+        ++block_index;
+      }
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("Philox streams, bulk draws");
+
+  timingtools_print("Average random number: %g",
+                    sum / (3. * timingtools_num_sample * num_packet));
+
+  return 0;
+}
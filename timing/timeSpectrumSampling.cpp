@@ -0,0 +1,129 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeSpectrumSampling.cpp
+ *
+ * @brief Timing test for sampling frequencies from photon source spectra.
+ *
+ * We first compare locating uniform random numbers in a tabulated cumulative
+ * distribution function using bisection (Utilities::locate()) and using a
+ * GuideTable. Both give exactly the same result. We then time the full
+ * get_random_frequency() call for two spectra that use guide tables.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "GuideTable.hpp"
+#include "HydrogenLymanContinuumSpectrum.hpp"
+#include "PlanckPhotonSourceSpectrum.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+#include "VernerCrossSections.hpp"
+
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Timing test for sampling frequencies from photon source spectra.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeSpectrumSampling", argc, argv);
+
+  // set up a Planck black body cumulative distribution for a 40,000 K source
+  // (in units of 13.6 eV), with the same resolution as the one used by
+  // PlanckPhotonSourceSpectrum
+  const uint_fast32_t num_frequency = 1000;
+  std::vector< double > cumulative_distribution(num_frequency, 0.);
+  for (uint_fast32_t i = 1; i < num_frequency; ++i) {
+    const double nu = 1. + i * 3. / (num_frequency - 1.);
+    // h * 13.6 eV / (k * 40,000 K)
+    const double x = 3.946 * nu;
+    cumulative_distribution[i] =
+        cumulative_distribution[i - 1] + nu * nu / (std::exp(x) - 1.);
+  }
+  for (uint_fast32_t i = 0; i < num_frequency; ++i) {
+    cumulative_distribution[i] /= cumulative_distribution[num_frequency - 1];
+  }
+  const GuideTable guide_table(cumulative_distribution.data(), num_frequency);
+
+  const uint_fast32_t num_sample = 1000000;
+  std::vector< double > uniforms(num_sample);
+  RandomGenerator random_generator(42);
+  random_generator.get_uniform_random_doubles(uniforms.data(), num_sample);
+
+  uint_fast64_t index_sum_bisection = 0;
+  timingtools_start_timing_block("bisection") {
+    index_sum_bisection = 0;
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_sample; ++i) {
+      index_sum_bisection += Utilities::locate(
+          uniforms[i], cumulative_distribution.data(), num_frequency);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("bisection");
+
+  uint_fast64_t index_sum_guide = 0;
+  timingtools_start_timing_block("guide table") {
+    index_sum_guide = 0;
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_sample; ++i) {
+      index_sum_guide +=
+          guide_table.locate(uniforms[i], cumulative_distribution.data());
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("guide table");
+
+  if (index_sum_bisection != index_sum_guide) {
+    cmac_error("Bisection and guide table results do not match!");
+  }
+
+  PlanckPhotonSourceSpectrum planck_spectrum(40000.);
+  double frequency_sum = 0.;
+  timingtools_start_timing_block("PlanckPhotonSourceSpectrum") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_sample; ++i) {
+      frequency_sum += planck_spectrum.get_random_frequency(random_generator);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("PlanckPhotonSourceSpectrum");
+
+  VernerCrossSections cross_sections;
+  HydrogenLymanContinuumSpectrum lyman_continuum_spectrum(cross_sections);
+  timingtools_start_timing_block("HydrogenLymanContinuumSpectrum") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_sample; ++i) {
+      frequency_sum += lyman_continuum_spectrum.get_random_frequency(
+          random_generator, 2000. + 0.01 * (i % 1000000));
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("HydrogenLymanContinuumSpectrum");
+
+  timingtools_print("Average sampled frequency: %g Hz",
+                    frequency_sum / (2. * num_sample * timingtools_num_sample));
+
+  return 0;
+}
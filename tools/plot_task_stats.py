@@ -63,6 +63,8 @@ task_names = [
     "fluxsweep boundary",
     "update conserved",
     "update primitives",
+    "fused limiter/predict/fluxsweep internal",
+    "fused update",
     "flush continuous buffers",
 ]
 
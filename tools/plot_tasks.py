@@ -71,6 +71,8 @@ task_names = [
     "fluxsweep boundary",
     "update conserved",
     "update primitives",
+    "fused limiter/predict/fluxsweep internal",
+    "fused update",
     "flush continuous buffers",
 ]
 task_colors = pl.cm.ScalarMappable(cmap="tab20").to_rgba(